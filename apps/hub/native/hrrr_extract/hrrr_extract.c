@@ -0,0 +1,447 @@
+// Point extractor for HRRR GRIB2 files, run by services/weather_hrrr.py in
+// place of the eccodes-python message loop.
+//
+//   hrrr_extract --index-dir DIR --field NAME:SHORT[,SHORT...]:LEVEL_TYPE:LEVEL ...
+//                --point LAT,LON ... FILE.grib2
+//
+// Each message is matched on shortName/typeOfLevel/level before its data is
+// touched. The first match of a field is sampled at every point with
+// codes_get_double_elements(); later matches are skipped, and the scan stops
+// once every field has been read. Nearest grid points are searched once per
+// grid definition (md5GridSection) and kept in DIR/<md5>.txt, so a warm run
+// never repeats the neighbour search. The result is a single JSON object on
+// stdout; errors go to stderr with a non-zero exit status.
+
+#include <errno.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "eccodes.h"
+
+#define MAX_FIELDS       32
+#define MAX_SHORT_NAMES  8
+#define MAX_POINTS       1024
+#define MAX_GRIDS        4
+#define GRID_KEY_LEN     64
+
+typedef struct {
+    char *name;
+    char *short_names[MAX_SHORT_NAMES];
+    size_t short_name_count;
+    char *level_type;
+    long level;
+    bool found;
+} field_spec_t;
+
+typedef struct {
+    bool known;
+    int index;
+    double grid_lat;
+    double grid_lon;
+    double distance_km;
+} grid_point_t;
+
+typedef struct {
+    char key[GRID_KEY_LEN];
+    grid_point_t points[MAX_POINTS];
+    int indexes[MAX_POINTS];    // copy of points[].index for codes_get_double_elements
+    size_t cached;              // points that came from the index file
+    size_t searched;            // points resolved by this run
+} grid_index_t;
+
+typedef struct {
+    const char *index_dir;
+    const char *grib_path;
+    field_spec_t fields[MAX_FIELDS];
+    size_t field_count;
+    double lats[MAX_POINTS];
+    double lons[MAX_POINTS];
+    size_t point_count;
+} options_t;
+
+typedef struct {
+    double values[MAX_POINTS][MAX_FIELDS];
+    bool present[MAX_POINTS][MAX_FIELDS];
+    grid_point_t *nearest[MAX_POINTS];  // grid of the first sampled field
+    size_t messages;
+    size_t decoded;
+} result_t;
+
+static grid_index_t s_grids[MAX_GRIDS];
+static size_t s_grid_count;
+static result_t s_result;
+
+static void fail(const char *fmt, const char *detail)
+{
+    fprintf(stderr, "hrrr_extract: ");
+    fprintf(stderr, fmt, detail);
+    fputc('\n', stderr);
+    exit(1);
+}
+
+static bool valid_field_name(const char *name)
+{
+    if (!name[0]) {
+        return false;
+    }
+    for (const char *c = name; *c; ++c) {
+        if (!((*c >= 'a' && *c <= 'z') || (*c >= '0' && *c <= '9') || *c == '_')) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// --field temperature_k:2t,t,tmp:heightAboveGround:2
+static void parse_field(options_t *opts, char *arg)
+{
+    if (opts->field_count == MAX_FIELDS) {
+        fail("too many fields (max %s)", "32");
+    }
+    field_spec_t *spec = &opts->fields[opts->field_count];
+    char *save = NULL;
+    char *name = strtok_r(arg, ":", &save);
+    char *shorts = strtok_r(NULL, ":", &save);
+    char *level_type = strtok_r(NULL, ":", &save);
+    char *level = strtok_r(NULL, ":", &save);
+    char *end = NULL;
+    if (!name || !shorts || !level_type || !level || !valid_field_name(name)) {
+        fail("bad --field '%s' (want NAME:SHORT[,SHORT]:LEVEL_TYPE:LEVEL)", arg);
+    }
+    spec->level = strtol(level, &end, 10);
+    if (*end) {
+        fail("bad level in --field '%s'", name);
+    }
+    spec->name = name;
+    spec->level_type = level_type;
+    for (char *s = strtok_r(shorts, ",", &save); s; s = strtok_r(NULL, ",", &save)) {
+        if (spec->short_name_count == MAX_SHORT_NAMES) {
+            fail("too many short names in --field '%s'", name);
+        }
+        spec->short_names[spec->short_name_count++] = s;
+    }
+    opts->field_count++;
+}
+
+static void parse_point(options_t *opts, const char *arg)
+{
+    if (opts->point_count == MAX_POINTS) {
+        fail("too many points (max %s)", "1024");
+    }
+    char *end = NULL;
+    double lat = strtod(arg, &end);
+    if (end == arg || *end != ',') {
+        fail("bad --point '%s' (want LAT,LON)", arg);
+    }
+    const char *lon_arg = end + 1;
+    double lon = strtod(lon_arg, &end);
+    if (end == lon_arg || *end || !isfinite(lat) || !isfinite(lon) || lat < -90.0 || lat > 90.0) {
+        fail("bad --point '%s' (want LAT,LON)", arg);
+    }
+    opts->lats[opts->point_count] = lat;
+    opts->lons[opts->point_count] = lon;
+    opts->point_count++;
+}
+
+static void parse_args(options_t *opts, int argc, char **argv)
+{
+    for (int i = 1; i < argc; ++i) {
+        const char *arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (strcmp(arg, "--index-dir") == 0 && has_value) {
+            opts->index_dir = argv[++i];
+        } else if (strcmp(arg, "--field") == 0 && has_value) {
+            parse_field(opts, argv[++i]);
+        } else if (strcmp(arg, "--point") == 0 && has_value) {
+            parse_point(opts, argv[++i]);
+        } else if (arg[0] == '-' || opts->grib_path) {
+            fail("unexpected argument '%s'", arg);
+        } else {
+            opts->grib_path = arg;
+        }
+    }
+    if (!opts->index_dir || !opts->grib_path || opts->field_count == 0 || opts->point_count == 0) {
+        fprintf(stderr,
+                "usage: %s --index-dir DIR --field NAME:SHORT[,SHORT]:LEVEL_TYPE:LEVEL... "
+                "--point LAT,LON... FILE.grib2\n",
+                argv[0]);
+        exit(2);
+    }
+}
+
+// Index files are keyed on the query rounded to 1e-4 degrees, the same
+// rounding the hub applies to its per-point cache keys.
+static long coord_key(double value)
+{
+    return lround(value * 10000.0);
+}
+
+static void index_path(const options_t *opts, const grid_index_t *grid, char *out, size_t out_len)
+{
+    snprintf(out, out_len, "%s/%s.txt", opts->index_dir, grid->key);
+}
+
+static void load_index(const options_t *opts, grid_index_t *grid)
+{
+    char path[4096];
+    index_path(opts, grid, path, sizeof(path));
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        return;
+    }
+    long lat_key, lon_key;
+    int index;
+    double grid_lat, grid_lon, distance_km;
+    while (fscanf(f, "%ld %ld %d %lf %lf %lf", &lat_key, &lon_key, &index, &grid_lat, &grid_lon,
+                  &distance_km) == 6) {
+        for (size_t p = 0; p < opts->point_count; ++p) {
+            grid_point_t *gp = &grid->points[p];
+            if (!gp->known && index >= 0 && coord_key(opts->lats[p]) == lat_key &&
+                coord_key(opts->lons[p]) == lon_key) {
+                *gp = (grid_point_t){
+                    .known = true,
+                    .index = index,
+                    .grid_lat = grid_lat,
+                    .grid_lon = grid_lon,
+                    .distance_km = distance_km,
+                };
+                grid->cached++;
+            }
+        }
+    }
+    fclose(f);
+}
+
+// Appends the points this run searched. Rows are whole lines written in one
+// call, so two extractors racing on the same grid at worst add duplicates,
+// which load_index() tolerates.
+static void save_index(const options_t *opts, const grid_index_t *grid, const bool *searched)
+{
+    char path[4096];
+    index_path(opts, grid, path, sizeof(path));
+    FILE *f = fopen(path, "a");
+    if (!f) {
+        fprintf(stderr, "hrrr_extract: cannot write %s: %s\n", path, strerror(errno));
+        return;
+    }
+    for (size_t p = 0; p < opts->point_count; ++p) {
+        const grid_point_t *gp = &grid->points[p];
+        if (searched[p]) {
+            fprintf(f, "%ld %ld %d %.6f %.6f %.6f\n", coord_key(opts->lats[p]), coord_key(opts->lons[p]),
+                    gp->index, gp->grid_lat, gp->grid_lon, gp->distance_km);
+        }
+    }
+    fclose(f);
+}
+
+static void resolve_points(const options_t *opts, codes_handle *h, grid_index_t *grid)
+{
+    static double in_lats[MAX_POINTS], in_lons[MAX_POINTS];
+    static double out_lats[MAX_POINTS], out_lons[MAX_POINTS];
+    static double values[MAX_POINTS], distances[MAX_POINTS];
+    static int indexes[MAX_POINTS];
+    static size_t slots[MAX_POINTS];
+    static bool searched[MAX_POINTS];
+
+    long missing = 0;
+    for (size_t p = 0; p < opts->point_count; ++p) {
+        searched[p] = false;
+        if (!grid->points[p].known) {
+            in_lats[missing] = opts->lats[p];
+            in_lons[missing] = opts->lons[p];
+            slots[missing] = p;
+            missing++;
+        }
+    }
+    if (missing > 0) {
+        int err = codes_grib_nearest_find_multiple(h, 0, in_lats, in_lons, missing, out_lats, out_lons, values,
+                                                   distances, indexes);
+        if (err != CODES_SUCCESS) {
+            fail("nearest-point search failed: %s", codes_get_error_message(err));
+        }
+        for (long m = 0; m < missing; ++m) {
+            size_t p = slots[m];
+            grid->points[p] = (grid_point_t){
+                .known = true,
+                .index = indexes[m],
+                .grid_lat = out_lats[m],
+                .grid_lon = out_lons[m],
+                .distance_km = distances[m],
+            };
+            searched[p] = true;
+        }
+        grid->searched += (size_t)missing;
+        save_index(opts, grid, searched);
+    }
+    for (size_t p = 0; p < opts->point_count; ++p) {
+        grid->indexes[p] = grid->points[p].index;
+    }
+}
+
+static grid_index_t *grid_for(const options_t *opts, codes_handle *h)
+{
+    char key[GRID_KEY_LEN];
+    size_t len = sizeof(key);
+    int err = codes_get_string(h, "md5GridSection", key, &len);
+    if (err != CODES_SUCCESS) {
+        fail("cannot read grid definition: %s", codes_get_error_message(err));
+    }
+    for (size_t g = 0; g < s_grid_count; ++g) {
+        if (strcmp(s_grids[g].key, key) == 0) {
+            return &s_grids[g];
+        }
+    }
+    if (s_grid_count == MAX_GRIDS) {
+        fail("too many grid definitions in one file (max %s)", "4");
+    }
+    grid_index_t *grid = &s_grids[s_grid_count++];
+    memcpy(grid->key, key, sizeof(grid->key));
+    load_index(opts, grid);
+    resolve_points(opts, h, grid);
+    return grid;
+}
+
+static field_spec_t *match_field(options_t *opts, codes_handle *h)
+{
+    char short_name[64];
+    char level_type[64];
+    size_t len = sizeof(short_name);
+    long level = 0;
+    if (codes_get_string(h, "shortName", short_name, &len) != CODES_SUCCESS) {
+        return NULL;
+    }
+    len = sizeof(level_type);
+    if (codes_get_string(h, "typeOfLevel", level_type, &len) != CODES_SUCCESS ||
+        codes_get_long(h, "level", &level) != CODES_SUCCESS) {
+        return NULL;
+    }
+    for (size_t f = 0; f < opts->field_count; ++f) {
+        field_spec_t *spec = &opts->fields[f];
+        if (spec->found || spec->level != level || strcmp(spec->level_type, level_type) != 0) {
+            continue;
+        }
+        for (size_t s = 0; s < spec->short_name_count; ++s) {
+            if (strcmp(spec->short_names[s], short_name) == 0) {
+                return spec;
+            }
+        }
+    }
+    return NULL;
+}
+
+static void sample_field(const options_t *opts, codes_handle *h, size_t field)
+{
+    grid_index_t *grid = grid_for(opts, h);
+    static double values[MAX_POINTS];
+    int err = codes_get_double_elements(h, "values", grid->indexes, (long)opts->point_count, values);
+    if (err != CODES_SUCCESS) {
+        fail("cannot decode values: %s", codes_get_error_message(err));
+    }
+    long bitmap = 0;
+    double missing = 0.0;
+    if (codes_get_long(h, "bitmapPresent", &bitmap) != CODES_SUCCESS ||
+        codes_get_double(h, "missingValue", &missing) != CODES_SUCCESS) {
+        bitmap = 0;
+    }
+    for (size_t p = 0; p < opts->point_count; ++p) {
+        s_result.values[p][field] = values[p];
+        s_result.present[p][field] = isfinite(values[p]) && !(bitmap && values[p] == missing);
+        if (!s_result.nearest[p]) {
+            s_result.nearest[p] = &grid->points[p];
+        }
+    }
+    s_result.decoded++;
+}
+
+static void scan_file(options_t *opts)
+{
+    FILE *f = fopen(opts->grib_path, "rb");
+    if (!f) {
+        fail("cannot open GRIB file: %s", strerror(errno));
+    }
+    size_t remaining = opts->field_count;
+    while (remaining > 0) {
+        int err = CODES_SUCCESS;
+        codes_handle *h = codes_handle_new_from_file(NULL, f, PRODUCT_GRIB, &err);
+        if (!h) {
+            if (err != CODES_SUCCESS) {
+                fclose(f);
+                fail("cannot create handle: %s", codes_get_error_message(err));
+            }
+            break;
+        }
+        s_result.messages++;
+        field_spec_t *spec = match_field(opts, h);
+        if (spec) {
+            sample_field(opts, h, (size_t)(spec - opts->fields));
+            spec->found = true;
+            remaining--;
+        }
+        codes_handle_delete(h);
+    }
+    fclose(f);
+}
+
+static void print_number(double value)
+{
+    if (isfinite(value)) {
+        printf("%.9g", value);
+    } else {
+        printf("null");
+    }
+}
+
+static void print_result(const options_t *opts)
+{
+    size_t cached = 0;
+    size_t searched = 0;
+    for (size_t g = 0; g < s_grid_count; ++g) {
+        cached += s_grids[g].cached;
+        searched += s_grids[g].searched;
+    }
+    printf("{\"messages\":%zu,\"decoded\":%zu,\"index_cached\":%zu,\"index_searched\":%zu,\"points\":[",
+           s_result.messages, s_result.decoded, cached, searched);
+    for (size_t p = 0; p < opts->point_count; ++p) {
+        const grid_point_t *gp = s_result.nearest[p];
+        printf("%s{\"lat\":", p ? "," : "");
+        print_number(opts->lats[p]);
+        printf(",\"lon\":");
+        print_number(opts->lons[p]);
+        if (gp) {
+            printf(",\"grid_lat\":");
+            print_number(gp->grid_lat);
+            printf(",\"grid_lon\":");
+            print_number(gp->grid_lon);
+            printf(",\"distance_km\":");
+            print_number(gp->distance_km);
+        }
+        printf(",\"values\":{");
+        bool first = true;
+        for (size_t f = 0; f < opts->field_count; ++f) {
+            if (!s_result.present[p][f]) {
+                continue;
+            }
+            printf("%s\"%s\":", first ? "" : ",", opts->fields[f].name);
+            print_number(s_result.values[p][f]);
+            first = false;
+        }
+        printf("}}");
+    }
+    printf("]}\n");
+}
+
+int main(int argc, char **argv)
+{
+    static options_t opts;
+    parse_args(&opts, argc, argv);
+    if (access(opts.index_dir, W_OK) != 0) {
+        fail("index directory is not writable: %s", opts.index_dir);
+    }
+    scan_file(&opts);
+    print_result(&opts);
+    return fflush(stdout) == 0 ? 0 : 1;
+}
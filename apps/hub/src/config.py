@@ -127,6 +127,14 @@ class Settings(BaseSettings):
         le=48,
         description="Maximum HRRR forecast hour to request when downloading GRIB2 files.",
     )
+    hrrr_subset_downloads: bool = Field(
+        default=True,
+        description="Fetch only the decoded HRRR messages via byte ranges from the NOAA .idx inventory.",
+    )
+    hrrr_extractor_path: str | None = Field(
+        default=None,
+        description="Path to the native hrrr_extract binary (apps/hub/native/hrrr_extract); unset uses eccodes-python.",
+    )
     hrrr_default_lat: float | None = Field(
         default=None,
         description="Optional fallback latitude if HRRR requests omit coordinates.",
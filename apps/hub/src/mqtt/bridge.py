@@ -4,6 +4,7 @@ import asyncio
 import json
 import logging
 import math
+import struct
 from dataclasses import dataclass
 from datetime import datetime, timezone
 from typing import Any, Awaitable, Callable, Optional
@@ -22,6 +23,8 @@ LOGGER_NAME = "projectplant.hub.mqtt.bridge"
 LEGACY_FIRMWARE_TELEMETRY_FILTER = "projectplant/pots/+/telemetry"
 CANONICAL_SENSOR_TOPIC_FMT = "pots/{pot_id}/sensors"
 CANONICAL_SENSOR_FILTER = "pots/+/sensors"
+CANONICAL_SENSOR_BATCH_FILTER = "pots/+/sensors/batch"
+CANONICAL_SENSOR_BINARY_FILTER = "pots/+/sensors/bin"
 LEGACY_FIRMWARE_STATUS_FILTER = "projectplant/pots/+/status"
 CANONICAL_STATUS_TOPIC_FMT = "pots/{pot_id}/status"
 CANONICAL_STATUS_FILTER = "pots/+/status"
@@ -231,6 +234,12 @@ class MqttBridge:
         self._logger.info("Starting MQTT bridge")
         self._tasks.append(asyncio.create_task(self._forward_firmware(), name="mqtt-bridge-firmware"))
         self._tasks.append(asyncio.create_task(self._capture_canonical_sensors(), name="mqtt-sensor-capture"))
+        self._tasks.append(
+            asyncio.create_task(self._capture_canonical_sensor_batches(), name="mqtt-sensor-batch-capture")
+        )
+        self._tasks.append(
+            asyncio.create_task(self._capture_canonical_sensor_binary(), name="mqtt-sensor-binary-capture")
+        )
         self._tasks.append(asyncio.create_task(self._forward_status(), name="mqtt-bridge-status"))
         self._tasks.append(asyncio.create_task(self._monitor_device_state(), name="mqtt-device-state"))
 
@@ -343,6 +352,52 @@ class MqttBridge:
 
         self._logger.debug("Canonical sensor capture exiting")
 
+    async def _capture_canonical_sensor_batches(self) -> None:
+        topic_filter = CANONICAL_SENSOR_BATCH_FILTER
+        while self._started:
+            try:
+                async with self._client.messages() as messages:
+                    await self._client.subscribe(topic_filter)
+                    async for message in messages:
+                        if not _topic_matches(message.topic, topic_filter):
+                            continue
+                        await self._handle_canonical_sensor_batch_message(message)
+                        self._reset_backoff()
+            except asyncio.CancelledError:
+                raise
+            except Exception as exc:  # pragma: no cover - unexpected failures logged for observability
+                await self._handle_loop_exception("canonical sensor batch", exc)
+            finally:
+                try:
+                    await self._client.unsubscribe(topic_filter)
+                except Exception as exc:  # pragma: no cover - best effort clean-up
+                    await self._handle_unsubscribe_error("canonical sensor batch", exc)
+
+        self._logger.debug("Canonical sensor batch capture exiting")
+
+    async def _capture_canonical_sensor_binary(self) -> None:
+        topic_filter = CANONICAL_SENSOR_BINARY_FILTER
+        while self._started:
+            try:
+                async with self._client.messages() as messages:
+                    await self._client.subscribe(topic_filter)
+                    async for message in messages:
+                        if not _topic_matches(message.topic, topic_filter):
+                            continue
+                        await self._handle_canonical_sensor_binary_message(message)
+                        self._reset_backoff()
+            except asyncio.CancelledError:
+                raise
+            except Exception as exc:  # pragma: no cover - unexpected failures logged for observability
+                await self._handle_loop_exception("canonical sensor binary", exc)
+            finally:
+                try:
+                    await self._client.unsubscribe(topic_filter)
+                except Exception as exc:  # pragma: no cover - best effort clean-up
+                    await self._handle_unsubscribe_error("canonical sensor binary", exc)
+
+        self._logger.debug("Canonical sensor binary capture exiting")
+
     async def _handle_loop_exception(self, context: str, exc: Exception) -> None:
         if self._is_not_connected_error(exc):
             await self._notify_disconnect(context, exc)
@@ -471,6 +526,31 @@ class MqttBridge:
             # Skip messages that originated from the bridge to avoid duplicates
             return
 
+        await self._record_canonical_sensor_sample(pot_id, data, live=True)
+
+    async def _handle_canonical_sensor_batch_message(self, message: Message) -> None:
+        pot_id = _extract_canonical_pot_id(message.topic)
+        if not pot_id:
+            return
+        samples = expand_sensor_batch(message.payload, pot_id)
+        if not samples:
+            self._logger.debug("Ignoring unusable sensor batch payload from %s", pot_id)
+            return
+        # Batches carry buffered history, so they must not overwrite the live actuator state
+        for sample in samples:
+            await self._record_canonical_sensor_sample(pot_id, sample, live=False)
+
+    async def _handle_canonical_sensor_binary_message(self, message: Message) -> None:
+        pot_id = _extract_canonical_pot_id(message.topic)
+        if not pot_id:
+            return
+        sample = decode_binary_sensor_payload(message.payload, pot_id)
+        if sample is None:
+            self._logger.debug("Ignoring unusable binary sensor payload from %s", pot_id)
+            return
+        await self._record_canonical_sensor_sample(pot_id, sample, live=True)
+
+    async def _record_canonical_sensor_sample(self, pot_id: str, data: dict[str, Any], *, live: bool) -> None:
         timestamp_ms_float = _coerce_float(data.get("timestampMs"))
         if timestamp_ms_float is None:
             timestamp_ms_float = _coerce_float(data.get("timestamp_ms"))
@@ -593,22 +673,23 @@ class MqttBridge:
             request_id=_coerce_str(data.get("requestId")),
         )
 
-        heartbeat_snapshot = PumpStatusSnapshot(
-            pot_id=normalized_pot_id,
-            status=None,
-            pump_on=valve_open,
-            ic_zone1_on=ic_zone1_on,
-            fan_on=fan_on,
-            mister_on=mister_on,
-            light_on=light_on,
-            request_id=_coerce_str(data.get("requestId")),
-            timestamp=timestamp_iso,
-            timestamp_ms=timestamp_ms_int,
-            received_at=_utc_now_iso(),
-            device_name=device_name,
-            is_named=is_named,
-        )
-        pump_status_cache.update(heartbeat_snapshot, merge=True)
+        if live:
+            heartbeat_snapshot = PumpStatusSnapshot(
+                pot_id=normalized_pot_id,
+                status=None,
+                pump_on=valve_open,
+                ic_zone1_on=ic_zone1_on,
+                fan_on=fan_on,
+                mister_on=mister_on,
+                light_on=light_on,
+                request_id=_coerce_str(data.get("requestId")),
+                timestamp=timestamp_iso,
+                timestamp_ms=timestamp_ms_int,
+                received_at=_utc_now_iso(),
+                device_name=device_name,
+                is_named=is_named,
+            )
+            pump_status_cache.update(heartbeat_snapshot, merge=True)
 
         event_sample = dict(data)
         event_sample["potId"] = normalized_pot_id
@@ -815,6 +896,112 @@ def build_sensor_payload(raw_payload: bytes, pot_id: str) -> Optional[Normalized
     )
 
 
+_BATCH_FLAG_FIELDS = (
+    "valveOpen",
+    "icZone1On",
+    "fanOn",
+    "misterOn",
+    "lightOn",
+    "waterLow",
+    "waterCutoff",
+)
+_BATCH_SENSOR_ONLY_FLAGS = ("waterLow", "waterCutoff")
+
+
+def expand_sensor_batch(raw_payload: bytes, pot_id: str) -> list[dict[str, Any]]:
+    """Expand a compact ``pots/<id>/sensors/batch`` payload into canonical sensor samples.
+
+    Each row of ``s`` follows the column names in ``f``: ``dt`` seconds from ``t0`` (ms),
+    ``m``/``t``/``h`` moisture, temperature and humidity in hundredths, ``fl`` actuator and
+    float-switch bits, ``r`` soil raw and ``b`` battery millivolts. Unknown columns are ignored.
+    """
+    data = _decode_json_payload(raw_payload)
+    if data is None:
+        return []
+    fields = data.get("f")
+    rows = data.get("s")
+    t0 = _coerce_float(data.get("t0"))
+    if not isinstance(fields, list) or not isinstance(rows, list) or t0 is None:
+        return []
+
+    header: dict[str, Any] = {"potId": normalize_pot_id(_coerce_str(data.get("potId"))) or pot_id}
+    for key in ("deviceName", "isNamed", "sensorMode"):
+        if key in data:
+            header[key] = data[key]
+    # The float switches are only reported (with the soil columns) when sensors are enabled
+    has_sensor_columns = "r" in fields
+
+    samples: list[dict[str, Any]] = []
+    for row in rows:
+        if not isinstance(row, list) or len(row) != len(fields):
+            continue
+        columns = dict(zip(fields, row))
+        dt_s = _coerce_float(columns.get("dt"))
+        sample = dict(header)
+        sample["timestampMs"] = int(round(t0 + (dt_s or 0.0) * 1000))
+        for column, name, scale in (("m", "moisture", 100), ("t", "temperature", 100), ("h", "humidity", 100)):
+            value = _coerce_float(columns.get(column))
+            if value is not None:
+                sample[name] = value / scale
+        flags = _coerce_float(columns.get("fl"))
+        if flags is not None:
+            bits = int(flags)
+            for index, name in enumerate(_BATCH_FLAG_FIELDS):
+                if name in _BATCH_SENSOR_ONLY_FLAGS and not has_sensor_columns:
+                    continue
+                sample[name] = bool(bits & (1 << index))
+        soil_raw = _coerce_float(columns.get("r"))
+        if soil_raw is not None:
+            sample["soilRaw"] = soil_raw
+        battery_mv = _coerce_float(columns.get("b"))
+        if battery_mv is not None:
+            sample["batteryV"] = battery_mv / 1000
+        samples.append(sample)
+    return samples
+
+
+BINARY_SCHEMA_VERSION = 1
+_BINARY_KIND_READING = 1
+_BINARY_FLAG_SENSORS = 1 << 7
+_BINARY_MISSING = -32768
+# schema, kind, flags, reserved, timestampMs, soilRaw, moisture, temperature, humidity (hundredths), batteryMv
+_BINARY_READING = struct.Struct("<BBBxQHhhhH")
+
+
+def decode_binary_sensor_payload(raw_payload: bytes, pot_id: str) -> Optional[dict[str, Any]]:
+    """Decode a ``pots/<id>/sensors/bin`` reading into a canonical sensor sample.
+
+    The firmware layout is defined next to ``mqtt_encode_reading_binary`` in ``plant_mqtt.h``;
+    payloads with another schema version or kind are rejected.
+    """
+    if len(raw_payload) < _BINARY_READING.size:
+        return None
+    schema, kind, flags, timestamp_ms, soil_raw, moisture, temperature, humidity, battery_mv = (
+        _BINARY_READING.unpack_from(raw_payload)
+    )
+    if schema != BINARY_SCHEMA_VERSION or kind != _BINARY_KIND_READING:
+        return None
+
+    sensors_enabled = bool(flags & _BINARY_FLAG_SENSORS)
+    sample: dict[str, Any] = {
+        "potId": pot_id,
+        "timestampMs": timestamp_ms,
+        "sensorMode": "full" if sensors_enabled else "control_only",
+    }
+    for name, value in (("moisture", moisture), ("temperature", temperature), ("humidity", humidity)):
+        if value != _BINARY_MISSING:
+            sample[name] = value / 100
+    for index, name in enumerate(_BATCH_FLAG_FIELDS):
+        if name in _BATCH_SENSOR_ONLY_FLAGS and not sensors_enabled:
+            continue
+        sample[name] = bool(flags & (1 << index))
+    if sensors_enabled:
+        sample["soilRaw"] = soil_raw
+        if battery_mv:
+            sample["batteryV"] = battery_mv / 1000
+    return sample
+
+
 def build_status_payload(raw_payload: bytes, pot_id: str) -> Optional[PumpStatusSnapshot]:
     data = _decode_json_payload(raw_payload)
     if data is None:
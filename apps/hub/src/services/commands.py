@@ -18,6 +18,7 @@ LOGGER_NAME = "projectplant.hub.commands"
 COMMAND_TOPIC_FMT = "pots/{pot_id}/command"
 SENSORS_TOPIC_FMT = "pots/{pot_id}/sensors"
 STATUS_TOPIC_FMT = "pots/{pot_id}/status"
+SCENE_OUTPUTS = frozenset({"light", "pump", "icZone1", "mister", "fan"})
 FRESHNESS_SLACK_SECONDS = 0.5
 MIN_REAL_TIMESTAMP = datetime(2020, 1, 1, tzinfo=timezone.utc).timestamp()
 
@@ -877,6 +878,122 @@ class CommandService:
                 except MqttError:
                     self._logger.debug("Failed to unsubscribe from %s during cleanup", status_topic, exc_info=True)
 
+    async def send_scene(
+        self,
+        pot_id: str,
+        *,
+        outputs: Mapping[str, bool],
+        duration_ms: Optional[int] = None,
+        output_durations_ms: Optional[Mapping[str, int]] = None,
+        timeout: Optional[float] = None,
+    ) -> CommandAckResult:
+        pot_id = self._normalize_pot_id(pot_id)
+        if not pot_id:
+            raise ValueError("pot_id is required")
+        if not outputs:
+            raise ValueError("outputs must name at least one output")
+        unknown = set(outputs) - SCENE_OUTPUTS
+        if unknown:
+            raise ValueError(f"Unknown scene outputs: {', '.join(sorted(unknown))}")
+        if duration_ms is not None:
+            if duration_ms < 0:
+                raise ValueError("duration_ms must be non-negative")
+            duration_ms = int(duration_ms)
+        output_durations = dict(output_durations_ms or {})
+        if set(output_durations) - set(outputs):
+            raise ValueError("output_durations_ms may only name outputs in the scene")
+        if any(value < 0 for value in output_durations.values()):
+            raise ValueError("output durations must be non-negative")
+
+        manager = get_mqtt_manager()
+        if manager is None:
+            raise CommandServiceError("MQTT manager is not connected")
+
+        try:
+            client = manager.get_client()
+        except RuntimeError as exc:
+            raise CommandServiceError(str(exc)) from exc
+
+        target_timeout = timeout if timeout is not None else self._default_timeout
+        if target_timeout <= 0:
+            raise ValueError("timeout must be greater than zero")
+
+        command_topic = COMMAND_TOPIC_FMT.format(pot_id=pot_id)
+        status_topic = STATUS_TOPIC_FMT.format(pot_id=pot_id)
+        request_id = str(uuid4())
+
+        scene: dict[str, Any] = {}
+        for name, on in outputs.items():
+            state = "on" if on else "off"
+            if name in output_durations:
+                scene[name] = {"state": state, "duration_ms": int(output_durations[name])}
+            else:
+                scene[name] = state
+        payload_dict: dict[str, Any] = {
+            "requestId": request_id,
+            "scene": scene,
+        }
+        if duration_ms is not None:
+            payload_dict["duration_ms"] = duration_ms
+
+        payload = json.dumps(payload_dict, separators=(",", ":"))
+
+        start_monotonic = time.monotonic()
+
+        async with client.messages() as messages:
+            try:
+                await client.subscribe(status_topic)
+            except MqttError as exc:
+                raise CommandServiceError(f"Failed to subscribe to {status_topic}") from exc
+
+            try:
+                await client.publish(command_topic, payload, qos=1, retain=False)
+            except MqttError as exc:
+                raise CommandServiceError(f"Failed to publish scene command to {command_topic}") from exc
+
+            deadline = start_monotonic + target_timeout
+            try:
+                while True:
+                    remaining = deadline - time.monotonic()
+                    if remaining <= 0:
+                        raise CommandTimeoutError(f"Timed out waiting for status update on {status_topic}")
+
+                    try:
+                        message = await asyncio.wait_for(messages.__anext__(), timeout=remaining)
+                    except asyncio.TimeoutError as exc:
+                        raise CommandTimeoutError(
+                            f"Timed out waiting for status update on {status_topic}"
+                        ) from exc
+                    except MqttError as exc:
+                        raise CommandServiceError("MQTT error while awaiting status update") from exc
+
+                    topic_value = getattr(message, "topic", status_topic)
+                    if hasattr(topic_value, "matches"):
+                        if not topic_value.matches(status_topic):
+                            continue
+                    elif str(topic_value) != status_topic:
+                        continue
+
+                    data = self._decode_payload(message.payload)
+                    if data is None:
+                        continue
+
+                    if data.get("requestId") != request_id:
+                        self._logger.debug(
+                            "Ignoring status payload for %s with unmatched requestId %r", pot_id, data.get("requestId")
+                        )
+                        continue
+
+                    self._logger.debug(
+                        "Received scene status for %s in %.2f s", pot_id, time.monotonic() - start_monotonic
+                    )
+                    return CommandAckResult(request_id=request_id, payload=data)
+            finally:
+                try:
+                    await client.unsubscribe(status_topic)
+                except MqttError:
+                    self._logger.debug("Failed to unsubscribe from %s during cleanup", status_topic, exc_info=True)
+
     async def set_device_name(
         self,
         pot_id: str,
@@ -4,7 +4,7 @@ import asyncio
 from collections import deque
 from dataclasses import dataclass
 from datetime import datetime, timedelta, timezone
-from typing import Deque, List, Optional, Sequence
+from typing import Any, Deque, List, Optional, Sequence
 
 
 def _ensure_utc(timestamp: Optional[datetime] = None) -> datetime:
@@ -81,6 +81,24 @@ class TelemetryStore:
             self._samples.append(sample)
             self._prune_locked()
 
+    async def record_environment_many(self, samples: Sequence[dict[str, Any]]) -> None:
+        """Record several ``record_environment`` keyword sets under one lock acquisition."""
+        prepared = [
+            EnvironmentSample(
+                timestamp=_ensure_utc(kwargs.get("timestamp")),
+                temperature_c=kwargs.get("temperature_c"),
+                humidity_pct=kwargs.get("humidity_pct"),
+                pressure_hpa=kwargs.get("pressure_hpa"),
+                solar_radiation_w_m2=kwargs.get("solar_radiation_w_m2"),
+                wind_speed_m_s=kwargs.get("wind_speed_m_s"),
+                source=kwargs.get("source", "sensor"),
+            )
+            for kwargs in samples
+        ]
+        async with self._lock:
+            self._samples.extend(prepared)
+            self._prune_locked()
+
     async def update_pressure(self, pressure_hpa: Optional[float], *, timestamp: Optional[datetime] = None) -> None:
         """Attach the latest pressure reading so new samples inherit it."""
         if pressure_hpa is None:
@@ -5,12 +5,13 @@ import json
 import logging
 import math
 import os
+import subprocess
 import threading
 from collections import deque
 from dataclasses import dataclass
 from datetime import datetime, timedelta, timezone
 from pathlib import Path
-from typing import Deque, Dict, List, Optional, Tuple
+from typing import Callable, Collection, Deque, Dict, Iterable, List, Optional, Tuple, TypeVar, Union
 
 import httpx
 
@@ -72,6 +73,15 @@ except ImportError:  # pragma: no cover - surfaced via explicit guard
 
 _ECCODES_LOCK = threading.RLock()
 
+_T = TypeVar("_T")
+
+# The repo vendors the eccodes GRIB definitions; the native extractor reads
+# them unless ECCODES_DEFINITION_PATH points elsewhere.
+_VENDORED_ECCODES_DEFINITIONS = (
+    Path(__file__).resolve().parents[4] / "eccodes-2.34.0" / "eccodes-2.34.0" / "definitions"
+)
+_NATIVE_EXTRACT_TIMEOUT_S = 120.0
+
 
 def _ensure_utc(value: Optional[datetime] = None) -> datetime:
     if value is None:
@@ -210,24 +220,68 @@ class _BandSpec:
     short_names: tuple[str, ...]
     level_type: str
     level: int
+    # How the NOAA .idx inventory (wgrib2 naming) lists the same message
+    idx_variables: tuple[str, ...] = ()
+    idx_level: str = ""
 
     def matches(self, short_name: str, level_type: str, level: int) -> bool:
         return short_name in self.short_names and level_type == self.level_type and level == self.level
 
+    def matches_idx(self, variable: str, level: str) -> bool:
+        return variable in self.idx_variables and level == self.idx_level
+
+    def extractor_arg(self) -> str:
+        return f"{self.field}:{','.join(self.short_names)}:{self.level_type}:{self.level}"
+
 
 _BAND_SPECS: tuple[_BandSpec, ...] = (
-    _BandSpec("temperature_k", ("2t", "t", "tmp"), "heightAboveGround", 2),
-    _BandSpec("humidity_pct", ("2r", "r"), "heightAboveGround", 2),
-    _BandSpec("wind_u", ("10u", "u"), "heightAboveGround", 10),
-    _BandSpec("wind_v", ("10v", "v"), "heightAboveGround", 10),
-    _BandSpec("solar_down_w_m2", ("sdswrf", "dswrf", "swdn"), "surface", 0),
-    _BandSpec("solar_diffuse_w_m2", ("vddsf", "swdif", "swdifsfc"), "surface", 0),
-    _BandSpec("solar_direct_w_m2", ("vbdsf", "swdir", "swdnsfc"), "surface", 0),
-    _BandSpec("solar_clear_w_m2", ("suswrf", "csdsf", "csdssf"), "surface", 0),
-    _BandSpec("solar_clear_up_w_m2", ("sulwrf", "csusf", "csusfsfc"), "surface", 0),
-    _BandSpec("pressure_pa", ("pressfc", "sp", "pres"), "surface", 0),
+    _BandSpec("temperature_k", ("2t", "t", "tmp"), "heightAboveGround", 2, ("TMP",), "2 m above ground"),
+    _BandSpec("humidity_pct", ("2r", "r"), "heightAboveGround", 2, ("RH",), "2 m above ground"),
+    _BandSpec("wind_u", ("10u", "u"), "heightAboveGround", 10, ("UGRD",), "10 m above ground"),
+    _BandSpec("wind_v", ("10v", "v"), "heightAboveGround", 10, ("VGRD",), "10 m above ground"),
+    _BandSpec("solar_down_w_m2", ("sdswrf", "dswrf", "swdn"), "surface", 0, ("DSWRF",), "surface"),
+    _BandSpec("solar_diffuse_w_m2", ("vddsf", "swdif", "swdifsfc"), "surface", 0, ("VDDSF",), "surface"),
+    _BandSpec("solar_direct_w_m2", ("vbdsf", "swdir", "swdnsfc"), "surface", 0, ("VBDSF",), "surface"),
+    _BandSpec("solar_clear_w_m2", ("suswrf", "csdsf", "csdssf"), "surface", 0, ("USWRF", "CSDSF"), "surface"),
+    _BandSpec("solar_clear_up_w_m2", ("sulwrf", "csusf", "csusfsfc"), "surface", 0, ("ULWRF", "CSUSF"), "surface"),
+    _BandSpec("pressure_pa", ("pressfc", "sp", "pres"), "surface", 0, ("PRES",), "surface"),
 )
 
+_SUBSET_RANGE_CONCURRENCY = 4
+
+
+def _parse_idx(text: str) -> List[Tuple[int, str, str]]:
+    """Parse a wgrib2 inventory ("12:3875523:d=2025102712:TMP:2 m above ground:1 hour fcst:")."""
+    entries: List[Tuple[int, str, str]] = []
+    for line in text.splitlines():
+        parts = line.split(":")
+        if len(parts) < 5:
+            continue
+        try:
+            offset = int(parts[1])
+        except ValueError as exc:
+            raise ValueError(f"Malformed HRRR inventory line: {line!r}") from exc
+        entries.append((offset, parts[3], parts[4]))
+    entries.sort()
+    return entries
+
+
+def _subset_ranges(entries: List[Tuple[int, str, str]]) -> List[Tuple[int, Optional[int]]]:
+    """Byte ranges (inclusive, open-ended for the last message) covering the messages _BAND_SPECS decode.
+
+    A message runs up to the next message's offset; adjacent messages are merged
+    into a single range so each request pulls as much as it can.
+    """
+    ranges: List[Tuple[int, Optional[int]]] = []
+    for position, (offset, variable, level) in enumerate(entries):
+        if not any(spec.matches_idx(variable, level) for spec in _BAND_SPECS):
+            continue
+        end = entries[position + 1][0] - 1 if position + 1 < len(entries) else None
+        if ranges and ranges[-1][1] is not None and ranges[-1][1] + 1 == offset:
+            ranges[-1] = (ranges[-1][0], end)
+        else:
+            ranges.append((offset, end))
+    return ranges
 
 
 def compute_target_run(
@@ -272,6 +326,8 @@ class HrrrWeatherService:
         refresh_interval: Optional[timedelta] = None,
         http_client: Optional[httpx.AsyncClient] = None,
         fetch_history_limit: int = 200,
+        extractor_path: Optional[Path] = None,
+        subset_downloads: Optional[bool] = None,
     ) -> None:
         self._cache_dir = Path(cache_dir or settings.hrrr_cache_dir)
         self._cache_dir.mkdir(parents=True, exist_ok=True)
@@ -303,6 +359,9 @@ class HrrrWeatherService:
         self._latest_samples: Dict[Tuple[float, float], HrrrSample] = {}
         self._last_refresh: Dict[Tuple[float, float], datetime] = {}
         self._last_run_valid: Dict[Tuple[float, float], datetime] = {}
+        # Locations callers asked about, refreshed with the default by the scheduler
+        self._requested_at: Dict[Tuple[float, float], datetime] = {}
+        self._requested_ttl = timedelta(hours=24)
         self._default_location: Optional[Tuple[float, float]] = None
         self._scheduler_task: Optional[asyncio.Task[None]] = None
         self._scheduler_stop: Optional[asyncio.Event] = None
@@ -312,6 +371,14 @@ class HrrrWeatherService:
         self._fetch_history: Deque[HrrrFetchStatus] = deque(maxlen=max(fetch_history_limit, 1))
         self._fetch_history_lock = asyncio.Lock()
         self._max_backfill_runs = 12
+        extractor = extractor_path or settings.hrrr_extractor_path
+        self._extractor_path: Optional[Path] = Path(extractor) if extractor else None
+        self._grid_index_dir = self._cache_dir / "grid_index"
+        self._subset_downloads = (
+            subset_downloads if subset_downloads is not None else settings.hrrr_subset_downloads
+        )
+        # (md5GridSection, lat, lon) -> value index, for the eccodes-python path
+        self._nearest_indexes: Dict[Tuple[str, float, float], int] = {}
         self._load_fetch_history()
 
     def refresh_presets(self) -> tuple[float, ...]:
@@ -426,25 +493,16 @@ class HrrrWeatherService:
             max_forecast_hour=self._max_forecast_hour,
         )
         try:
-            attempt = 0
-            while True:
-                grib_path = await self._ensure_grib(run)
-                try:
-                    raw_values = await asyncio.to_thread(self._extract_point_fields, grib_path, lat, lon)
-                    break
-                except RuntimeError as exc:
-                    if attempt >= 1 or not self._should_retry_grib_error(exc):
-                        raise
-                    attempt += 1
-                    await asyncio.to_thread(self._invalidate_grib_cache, grib_path)
-                    continue
-
+            raw_values = await self._extract_with_retry(
+                run, lambda grib_path: self._extract_point_fields(grib_path, lat, lon)
+            )
             sample = self._convert_values(run, raw_values, lat, lon)
             finished = datetime.now(timezone.utc)
             async with self._latest_lock:
                 self._latest_samples[key] = sample
                 self._last_refresh[key] = finished
                 self._last_run_valid[key] = sample.run.valid_time
+                self._requested_at[key] = finished
             if persist:
                 await telemetry_store.record_environment(**sample.as_environment_kwargs())
             await self._log_fetch_status(
@@ -481,6 +539,107 @@ class HrrrWeatherService:
             )
             raise
 
+    async def refresh_points(
+        self,
+        points: Iterable[Tuple[float, float]],
+        *,
+        when: Optional[datetime] = None,
+        persist: Union[bool, Collection[Tuple[float, float]]] = True,
+    ) -> Dict[Tuple[float, float], HrrrSample]:
+        """Refresh many locations from one run, reading each GRIB message once.
+
+        Points are keyed like ``latest_for`` (``_round_coord``); duplicates
+        collapse to the first coordinate given. ``persist`` may also name the
+        subset of points to record. The latest-sample cache, the telemetry
+        store and the fetch log are each updated in a single step once every
+        point has been sampled.
+        """
+        coords: Dict[Tuple[float, float], Tuple[float, float]] = {}
+        for lat, lon in points:
+            coords.setdefault(_round_coord(lat, lon), (lat, lon))
+        if not coords:
+            return {}
+        keys = list(coords)
+        started = datetime.now(timezone.utc)
+        run = compute_target_run(
+            when,
+            availability_delay=self._availability_delay,
+            max_forecast_hour=self._max_forecast_hour,
+        )
+        try:
+            raw_values = await self._extract_with_retry(
+                run, lambda grib_path: self._extract_points_fields(grib_path, list(coords.values()))
+            )
+        except Exception as exc:
+            finished = datetime.now(timezone.utc)
+            await self._log_fetch_statuses(
+                [
+                    HrrrFetchStatus(
+                        timestamp=started,
+                        lat=key[0],
+                        lon=key[1],
+                        run_cycle=run.cycle,
+                        forecast_hour=run.forecast_hour,
+                        valid_time=None,
+                        status="error",
+                        detail=str(exc),
+                        persisted=False,
+                        duration_s=(finished - started).total_seconds(),
+                    )
+                    for key in keys
+                ]
+            )
+            raise
+
+        samples = {
+            key: self._convert_values(run, raw, *coords[key]) for key, raw in zip(keys, raw_values)
+        }
+        if isinstance(persist, bool):
+            persisted = set(keys) if persist else set()
+        else:
+            persisted = {_round_coord(lat, lon) for lat, lon in persist} & set(keys)
+        finished = datetime.now(timezone.utc)
+        async with self._latest_lock:
+            for key, sample in samples.items():
+                self._latest_samples[key] = sample
+                self._last_refresh[key] = finished
+                self._last_run_valid[key] = sample.run.valid_time
+        if persisted:
+            await telemetry_store.record_environment_many(
+                [sample.as_environment_kwargs() for key, sample in samples.items() if key in persisted]
+            )
+        await self._log_fetch_statuses(
+            [
+                HrrrFetchStatus(
+                    timestamp=started,
+                    lat=key[0],
+                    lon=key[1],
+                    run_cycle=sample.run.cycle,
+                    forecast_hour=sample.run.forecast_hour,
+                    valid_time=sample.run.valid_time,
+                    status="success",
+                    detail=None,
+                    persisted=key in persisted,
+                    duration_s=(finished - started).total_seconds(),
+                )
+                for key, sample in samples.items()
+            ]
+        )
+        await self._maybe_cleanup_cache()
+        return samples
+
+    async def _extract_with_retry(self, run: HrrrRun, extract: Callable[[Path], _T]) -> _T:
+        attempt = 0
+        while True:
+            grib_path = await self._ensure_grib(run)
+            try:
+                return await asyncio.to_thread(extract, grib_path)
+            except RuntimeError as exc:
+                if attempt >= 1 or not self._should_retry_grib_error(exc):
+                    raise
+                attempt += 1
+                await asyncio.to_thread(self._invalidate_grib_cache, grib_path)
+
     async def refresh_default(self, *, persist: bool = True) -> Optional[HrrrSample]:
         if self._default_location is None:
             return None
@@ -490,7 +649,21 @@ class HrrrWeatherService:
     async def latest_for(self, lat: float, lon: float) -> Optional[HrrrSample]:
         key = _round_coord(lat, lon)
         async with self._latest_lock:
-            return self._latest_samples.get(key)
+            sample = self._latest_samples.get(key)
+            if sample is not None:
+                self._requested_at[key] = datetime.now(timezone.utc)
+            return sample
+
+    async def latest_for_points(
+        self, points: Iterable[Tuple[float, float]]
+    ) -> Dict[Tuple[float, float], HrrrSample]:
+        keys = {_round_coord(lat, lon) for lat, lon in points}
+        now = datetime.now(timezone.utc)
+        async with self._latest_lock:
+            found = {key: self._latest_samples[key] for key in keys if key in self._latest_samples}
+            for key in found:
+                self._requested_at[key] = now
+            return found
 
     async def latest_default(self) -> Optional[HrrrSample]:
         if self._default_location is None:
@@ -517,7 +690,7 @@ class HrrrWeatherService:
             if self._default_location is None or self._refresh_interval is None:
                 break
             try:
-                await self._run_default_refresh_cycle()
+                await self._run_refresh_cycle()
             except HrrrDataUnavailable as exc:
                 logger.info("HRRR data unavailable for scheduled refresh: %s", exc)
             except HrrrDependencyError as exc:
@@ -533,14 +706,20 @@ class HrrrWeatherService:
                 continue
         logger.debug("HRRR scheduler loop exiting")
 
-    async def _run_default_refresh_cycle(self) -> None:
+    async def _run_refresh_cycle(self) -> None:
+        """Refresh the default location and every one requested within
+        ``_requested_ttl`` together, one GRIB pass per run. Only the default
+        is persisted: environment samples carry no location."""
         if self._default_location is None:
             return
-        lat, lon = self._default_location
-        key = _round_coord(lat, lon)
+        key = self._default_location
         now = datetime.now(timezone.utc)
         async with self._latest_lock:
             last_valid = self._last_run_valid.get(key)
+            cutoff = now - self._requested_ttl
+            for stale in [point for point, at in self._requested_at.items() if at < cutoff]:
+                del self._requested_at[stale]
+            points = [key] + [point for point in self._requested_at if point != key]
         targets: List[datetime] = []
         if last_valid is not None:
             candidate = last_valid + timedelta(hours=1)
@@ -552,7 +731,7 @@ class HrrrWeatherService:
         if not targets:
             targets.append(now)
         for target in targets:
-            await self.refresh_point(lat, lon, when=target, persist=True)
+            await self.refresh_points(points, when=target, persist=[key])
 
     async def _ensure_grib(self, run: HrrrRun) -> Path:
         target = self._cache_path(run)
@@ -584,8 +763,57 @@ class HrrrWeatherService:
         )
 
     async def _download_grib(self, run: HrrrRun, target: Path) -> None:
-        client = await self._get_client()
         target.parent.mkdir(parents=True, exist_ok=True)
+        if self._subset_downloads:
+            try:
+                if await self._download_grib_subset(run, target):
+                    return
+            except (httpx.HTTPError, ValueError) as exc:
+                logger.info("HRRR subset download failed, fetching the full file: %s", exc)
+        await self._download_grib_full(run, target)
+
+    async def _download_grib_subset(self, run: HrrrRun, target: Path) -> bool:
+        client = await self._get_client()
+        url = self._build_url(run)
+        response = await client.get(f"{url}.idx")
+        if response.status_code != 200:
+            logger.info("HRRR inventory %s.idx unavailable (HTTP %s)", url, response.status_code)
+            return False
+        ranges = _subset_ranges(_parse_idx(response.text))
+        if not ranges:
+            logger.info("HRRR inventory %s.idx lists none of the decoded fields", url)
+            return False
+
+        semaphore = asyncio.Semaphore(_SUBSET_RANGE_CONCURRENCY)
+
+        async def _fetch_range(start: int, end: Optional[int]) -> bytes:
+            header = f"bytes={start}-{'' if end is None else end}"
+            async with semaphore:
+                async with client.stream("GET", url, headers={"Range": header}) as part:
+                    # A 200 would be the whole file; bail out before reading it
+                    if part.status_code != 206:
+                        raise ValueError(f"range request {header} answered HTTP {part.status_code}")
+                    content = await part.aread()
+            if not content.startswith(b"GRIB"):
+                raise ValueError(f"range {header} does not start a GRIB message")
+            return content
+
+        logger.info("Downloading HRRR GRIB subset %s (%s ranges) -> %s", url, len(ranges), target)
+        parts = await asyncio.gather(*(_fetch_range(start, end) for start, end in ranges))
+        tmp_path = target.with_suffix(target.suffix + ".tmp")
+        try:
+            with tmp_path.open("wb") as handle:
+                for part in parts:
+                    handle.write(part)
+            tmp_path.replace(target)
+            self._write_metadata(run, target, subset_bytes=sum(len(part) for part in parts))
+        except Exception:
+            tmp_path.unlink(missing_ok=True)
+            raise
+        return True
+
+    async def _download_grib_full(self, run: HrrrRun, target: Path) -> None:
+        client = await self._get_client()
         url = self._build_url(run)
         tmp_path = target.with_suffix(target.suffix + ".tmp")
         logger.info("Downloading HRRR GRIB %s -> %s", url, target)
@@ -630,23 +858,31 @@ class HrrrWeatherService:
             self._http_client = httpx.AsyncClient(timeout=timeout)
         return self._http_client
 
-    def _write_metadata(self, run: HrrrRun, target: Path) -> None:
-        meta = {
+    def _write_metadata(self, run: HrrrRun, target: Path, *, subset_bytes: Optional[int] = None) -> None:
+        meta: Dict[str, object] = {
             "cycle": run.cycle.isoformat(timespec="seconds"),
             "forecast_hour": run.forecast_hour,
             "valid_time": run.valid_time.isoformat(timespec="seconds"),
             "filename": run.filename,
             "domain": self._domain,
             "source": "noaa_hrrr",
+            "subset": subset_bytes is not None,
         }
+        if subset_bytes is not None:
+            meta["subset_bytes"] = subset_bytes
         self._metadata_path(target).write_text(json.dumps(meta, indent=2))
 
     def _extract_point_fields(self, grib_path: Path, lat: float, lon: float) -> Dict[str, float]:
+        return self._extract_points_fields(grib_path, [(lat, lon)])[0]
+
+    def _extract_points_fields(self, grib_path: Path, points: List[Tuple[float, float]]) -> List[Dict[str, float]]:
+        if self._extractor_path is not None:
+            return self._extract_points_native(grib_path, points)
         if eccodes is None:
             raise HrrrDependencyError(
                 "eccodes-python is required to parse HRRR GRIB files. Install it via `pip install eccodes`."
             )
-        values: Dict[str, float] = {}
+        values: List[Dict[str, float]] = [{} for _ in points]
         # ecCodes has global parser state and is not thread-safe unless the library
         # is compiled with threading support. We serialize access so that concurrent
         # refreshes do not trip the fatal Flex scanner error.
@@ -662,8 +898,10 @@ class HrrrWeatherService:
                         level = int(eccodes.codes_get_long(gid, "level"))
                         for spec in _BAND_SPECS:
                             if spec.matches(short_name, level_type, level):
-                                nearest = eccodes.codes_grib_find_nearest(gid, lat, lon)[0]
-                                values[spec.field] = float(nearest.value)
+                                indexes = self._nearest_indexes_for(gid, points)
+                                sampled = eccodes.codes_get_double_elements(gid, "values", indexes)
+                                for point_values, value in zip(values, sampled):
+                                    point_values[spec.field] = float(value)
                                 break
                     except eccodes.CodesInternalError:
                         # Skip broken messages but keep the parser alive
@@ -672,6 +910,66 @@ class HrrrWeatherService:
                         eccodes.codes_release(gid)
         return values
 
+    def _nearest_indexes_for(self, gid: int, points: List[Tuple[float, float]]) -> List[int]:
+        # Every HRRR field shares one grid, so the neighbour search runs once per
+        # location rather than once per matched message.
+        grid = eccodes.codes_get_string(gid, "md5GridSection")
+        keys = [(grid, *_round_coord(lat, lon)) for lat, lon in points]
+        missing = [position for position, key in enumerate(keys) if key not in self._nearest_indexes]
+        if missing:
+            found = eccodes.codes_grib_find_nearest_multiple(
+                gid,
+                False,
+                [points[position][0] for position in missing],
+                [points[position][1] for position in missing],
+            )
+            for position, nearest in zip(missing, found):
+                self._nearest_indexes[keys[position]] = int(nearest.index)
+        return [self._nearest_indexes[key] for key in keys]
+
+    def _extract_points_native(
+        self, grib_path: Path, points: List[Tuple[float, float]]
+    ) -> List[Dict[str, float]]:
+        assert self._extractor_path is not None
+        self._grid_index_dir.mkdir(parents=True, exist_ok=True)
+        args = [str(self._extractor_path), "--index-dir", str(self._grid_index_dir)]
+        for spec in _BAND_SPECS:
+            args += ["--field", spec.extractor_arg()]
+        for lat, lon in points:
+            args += ["--point", f"{lat!r},{lon!r}"]
+        args.append(str(grib_path))
+        env = dict(os.environ)
+        if "ECCODES_DEFINITION_PATH" not in env and _VENDORED_ECCODES_DEFINITIONS.is_dir():
+            env["ECCODES_DEFINITION_PATH"] = str(_VENDORED_ECCODES_DEFINITIONS)
+        try:
+            completed = subprocess.run(
+                args,
+                stdout=subprocess.PIPE,
+                stderr=subprocess.PIPE,
+                env=env,
+                timeout=_NATIVE_EXTRACT_TIMEOUT_S,
+                check=False,
+            )
+        except OSError as exc:
+            raise HrrrDependencyError(f"HRRR extractor {self._extractor_path} cannot run: {exc}") from exc
+        except subprocess.TimeoutExpired as exc:
+            raise RuntimeError(f"HRRR extractor timed out after {exc.timeout:.0f}s") from exc
+        if completed.returncode != 0:
+            message = completed.stderr.decode(errors="replace").strip() or f"exit status {completed.returncode}"
+            raise RuntimeError(message)
+        payload = json.loads(completed.stdout)
+        logger.debug(
+            "HRRR extractor scanned %s messages (%s decoded, %s indexed points cached, %s searched)",
+            payload.get("messages"),
+            payload.get("decoded"),
+            payload.get("index_cached"),
+            payload.get("index_searched"),
+        )
+        return [
+            {field: float(value) for field, value in point["values"].items() if value is not None}
+            for point in payload["points"]
+        ]
+
     def _convert_values(self, run: HrrrRun, raw: Dict[str, float], lat: float, lon: float) -> HrrrSample:
         temperature_c = raw.get("temperature_k")
         if temperature_c is not None:
@@ -719,14 +1017,18 @@ class HrrrWeatherService:
         )
 
     async def _log_fetch_status(self, entry: HrrrFetchStatus) -> None:
+        await self._log_fetch_statuses([entry])
+
+    async def _log_fetch_statuses(self, entries: List[HrrrFetchStatus]) -> None:
         async with self._fetch_history_lock:
-            self._fetch_history.append(entry)
-        await asyncio.to_thread(self._append_fetch_log, entry)
+            self._fetch_history.extend(entries)
+        await asyncio.to_thread(self._append_fetch_log, entries)
 
-    def _append_fetch_log(self, entry: HrrrFetchStatus) -> None:
+    def _append_fetch_log(self, entries: List[HrrrFetchStatus]) -> None:
+        lines = "".join(json.dumps(entry.to_dict(), separators=(",", ":")) + "\n" for entry in entries)
         try:
             with self._fetch_log_path.open("a", encoding="utf-8") as handle:
-                handle.write(json.dumps(entry.to_dict(), separators=(",", ":")) + "\n")
+                handle.write(lines)
         except OSError as exc:  # pragma: no cover - best-effort logging
             logger.debug("Failed to append HRRR fetch log: %s", exc)
 
@@ -150,6 +150,35 @@ class PumpStatusClient(_BaseFakeClient):
         await queue.put(StubMessage(topic=status_topic, payload=status_payload.encode("utf-8")))
 
 
+class SceneStatusClient(_BaseFakeClient):
+    def __init__(self, pot_id: str) -> None:
+        super().__init__(pot_id)
+
+    async def publish(self, topic: str, payload: str, qos: int = 0, retain: bool = False) -> None:
+        self.published.append((topic, payload, qos, retain))
+        data = json.loads(payload)
+        self.request_ids.append(data["requestId"])
+        status_topic = topic.replace("/command", "/status")
+        queue = self._queues.setdefault(status_topic, asyncio.Queue())
+
+        unrelated_payload = json.dumps({"status": "fan_on", "requestId": "other"}, separators=(",", ":"))
+        await queue.put(StubMessage(topic=status_topic, payload=unrelated_payload.encode("utf-8")))
+
+        scene = {
+            name: value["state"] if isinstance(value, dict) else value for name, value in data["scene"].items()
+        }
+        status_payload = json.dumps(
+            {
+                "status": "scene_applied",
+                "requestId": data["requestId"],
+                "potId": self.pot_id,
+                "scene": scene,
+            },
+            separators=(",", ":"),
+        )
+        await queue.put(StubMessage(topic=status_topic, payload=status_payload.encode("utf-8")))
+
+
 class SilentPumpStatusClient(PumpStatusClient):
     async def publish(self, topic: str, payload: str, qos: int = 0, retain: bool = False) -> None:
         self.published.append((topic, payload, qos, retain))
@@ -381,6 +410,41 @@ async def test_send_pump_override_times_out(monkeypatch):
         await service.send_pump_override(pot_id, pump_on=False, timeout=0.1)
 
 
+@pytest.mark.anyio
+async def test_send_scene_publishes_one_command_and_waits_for_scene_ack(monkeypatch):
+    pot_id = "pot-scene"
+    fake_client = SceneStatusClient(pot_id)
+    manager = SimpleNamespace(get_client=lambda: fake_client)
+    monkeypatch.setattr(commands_module, "get_mqtt_manager", lambda: manager)
+
+    service = CommandService(default_timeout=1.0)
+    result = await service.send_scene(
+        pot_id,
+        outputs={"fan": True, "mister": True},
+        duration_ms=600000,
+        output_durations_ms={"mister": 30000},
+    )
+
+    assert len(fake_client.published) == 1
+    topic, payload, qos, retain = fake_client.published[0]
+    assert topic == f"pots/{pot_id}/command"
+    assert qos == 1
+    assert retain is False
+    published_data = json.loads(payload)
+    assert published_data["scene"] == {"fan": "on", "mister": {"state": "on", "duration_ms": 30000}}
+    assert published_data["duration_ms"] == 600000
+    assert result.request_id == published_data["requestId"]
+    assert result.payload["status"] == "scene_applied"
+    assert result.payload["scene"] == {"fan": "on", "mister": "on"}
+
+
+@pytest.mark.anyio
+async def test_send_scene_rejects_unknown_outputs(monkeypatch):
+    service = CommandService(default_timeout=1.0)
+    with pytest.raises(ValueError):
+        await service.send_scene("pot-scene", outputs={"heater": True})
+
+
 @pytest.mark.anyio
 async def test_set_device_schedule_publishes_schedule_and_waits_for_status(monkeypatch):
     pot_id = "pot-schedule"
@@ -2,7 +2,12 @@ import json
 
 import pytest
 
-from mqtt.bridge import build_sensor_payload, build_status_payload
+from mqtt.bridge import (
+    build_sensor_payload,
+    build_status_payload,
+    decode_binary_sensor_payload,
+    expand_sensor_batch,
+)
 
 
 def _encode(payload: dict) -> bytes:
@@ -58,6 +63,82 @@ def test_build_sensor_payload_handles_invalid_json():
     assert normalized is None
 
 
+def test_expand_sensor_batch_decodes_compact_rows():
+    payload = {
+        "potId": "pot-01",
+        "deviceName": "Basil",
+        "sensorMode": "full",
+        "v": 1,
+        "t0": 1_700_000_000_000,
+        "f": ["dt", "m", "t", "h", "fl", "r", "b"],
+        "s": [
+            [0, 4720, 2280, 4850, 0, 18342, 3920],
+            [-60, 4711, -350, None, 0b1000001, 18350, None],
+        ],
+    }
+    samples = expand_sensor_batch(_encode(payload), "pot-01")
+    assert len(samples) == 2
+    first, second = samples
+    assert first["potId"] == "pot-01"
+    assert first["deviceName"] == "Basil"
+    assert first["timestampMs"] == 1_700_000_000_000
+    assert first["moisture"] == pytest.approx(47.2)
+    assert first["temperature"] == pytest.approx(22.8)
+    assert first["humidity"] == pytest.approx(48.5)
+    assert first["soilRaw"] == 18342
+    assert first["batteryV"] == pytest.approx(3.92)
+    assert first["valveOpen"] is False
+    assert second["timestampMs"] == 1_699_999_940_000
+    assert second["temperature"] == pytest.approx(-3.5)
+    assert "humidity" not in second
+    assert "batteryV" not in second
+    assert second["valveOpen"] is True
+    assert second["waterCutoff"] is True
+    assert second["waterLow"] is False
+
+
+def test_expand_sensor_batch_omits_float_switches_without_sensor_columns():
+    payload = {"t0": 1_700_000_000_000, "f": ["dt", "m", "t", "h", "fl"], "s": [[0, None, None, None, 4]]}
+    samples = expand_sensor_batch(_encode(payload), "pot-02")
+    assert len(samples) == 1
+    assert samples[0]["fanOn"] is True
+    assert samples[0]["valveOpen"] is False
+    assert "moisture" not in samples[0]
+    assert "waterLow" not in samples[0]
+    assert "waterCutoff" not in samples[0]
+
+
+def test_expand_sensor_batch_rejects_malformed_payloads():
+    assert expand_sensor_batch(b"not-json", "pot-01") == []
+    assert expand_sensor_batch(_encode({"f": ["dt"], "s": [[0]]}), "pot-01") == []
+    rows = expand_sensor_batch(_encode({"t0": 0, "f": ["dt", "m"], "s": [[0], "bad", [1, 100]]}), "pot-01")
+    assert rows == [{"potId": "pot-01", "timestampMs": 1000, "moisture": 1.0}]
+
+
+def test_decode_binary_sensor_payload_matches_firmware_layout():
+    # Same bytes as test_encode_reading_binary_layout in the pot firmware tests
+    raw = bytes.fromhex("0101c1004eca348b92010000a6477012a2fe0080500f")
+    sample = decode_binary_sensor_payload(raw, "pot-01")
+    assert sample is not None
+    assert sample["potId"] == "pot-01"
+    assert sample["timestampMs"] == 1728912345678
+    assert sample["soilRaw"] == 18342
+    assert sample["moisture"] == pytest.approx(47.2)
+    assert sample["temperature"] == pytest.approx(-3.5)
+    assert "humidity" not in sample
+    assert sample["batteryV"] == pytest.approx(3.92)
+    assert sample["valveOpen"] is True
+    assert sample["waterCutoff"] is True
+    assert sample["waterLow"] is False
+
+
+def test_decode_binary_sensor_payload_rejects_unknown_schema():
+    raw = bytearray.fromhex("0101c1004eca348b92010000a6477012a2fe0080500f")
+    assert decode_binary_sensor_payload(bytes(raw[:-1]), "pot-01") is None
+    raw[0] = 2
+    assert decode_binary_sensor_payload(bytes(raw), "pot-01") is None
+
+
 def test_build_status_payload_normalizes_fields():
     payload = {
         "status": "pump_on",
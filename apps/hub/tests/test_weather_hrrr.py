@@ -1,9 +1,12 @@
+import json
 import os
+import sys
 from datetime import datetime, timedelta, timezone
 
+import httpx
 import pytest
 
-from services.weather_hrrr import HrrrRun, HrrrWeatherService, compute_target_run
+from services.weather_hrrr import HrrrRun, HrrrWeatherService, _parse_idx, _subset_ranges, compute_target_run
 
 
 def _ts(value: str) -> datetime:
@@ -131,6 +134,74 @@ async def test_refresh_point_failure_is_logged(tmp_path, monkeypatch):
     assert history[-1]["persisted"] is False
 
 
+@pytest.mark.anyio
+async def test_refresh_points_samples_all_locations_in_one_pass(tmp_path, monkeypatch):
+    service = HrrrWeatherService(cache_dir=tmp_path)
+    grib_path = tmp_path / "batch.grib2"
+    grib_path.write_bytes(b"data")
+    calls = []
+
+    async def _ensure_grib_stub(self, run):
+        return grib_path
+
+    def _extract_stub(self, grib_file, points):
+        calls.append(list(points))
+        return [{"temperature_k": 273.15 + index, "humidity_pct": 50.0} for index, _ in enumerate(points)]
+
+    monkeypatch.setattr(service, "_ensure_grib", _ensure_grib_stub.__get__(service, HrrrWeatherService))
+    monkeypatch.setattr(service, "_extract_points_fields", _extract_stub.__get__(service, HrrrWeatherService))
+
+    samples = await service.refresh_points(
+        [(38.9, -77.0), (40.7128, -74.006), (38.90001, -77.00001)], persist=False
+    )
+
+    assert calls == [[(38.9, -77.0), (40.7128, -74.006)]]
+    assert sorted(samples) == [(38.9, -77.0), (40.7128, -74.006)]
+    assert pytest.approx(samples[(40.7128, -74.006)].temperature_c) == 1.0
+    latest = await service.latest_for_points([(38.9, -77.0), (40.7128, -74.006), (0.0, 0.0)])
+    assert latest == samples
+    history = await service.fetch_history()
+    assert [entry["status"] for entry in history] == ["success", "success"]
+    assert len(service._fetch_log_path.read_text().splitlines()) == 2
+
+
+@pytest.mark.anyio
+async def test_refresh_cycle_batches_requested_locations_with_default(tmp_path, monkeypatch):
+    service = HrrrWeatherService(cache_dir=tmp_path)
+    service.configure_default_location(38.9, -77.0)
+    grib_path = tmp_path / "cycle.grib2"
+    grib_path.write_bytes(b"data")
+    calls = []
+    recorded = []
+
+    async def _ensure_grib_stub(self, run):
+        return grib_path
+
+    def _extract_stub(self, grib_file, points):
+        calls.append(list(points))
+        return [{"temperature_k": 280.0, "humidity_pct": 50.0} for _ in points]
+
+    async def _record_many(samples):
+        recorded.extend(samples)
+
+    monkeypatch.setattr(service, "_ensure_grib", _ensure_grib_stub.__get__(service, HrrrWeatherService))
+    monkeypatch.setattr(service, "_extract_points_fields", _extract_stub.__get__(service, HrrrWeatherService))
+    monkeypatch.setattr("services.weather_hrrr.telemetry_store.record_environment_many", _record_many)
+
+    now = datetime.now(timezone.utc)
+    service._requested_at[(40.7128, -74.006)] = now
+    service._requested_at[(41.0, -73.0)] = now - timedelta(days=2)
+
+    await service._run_refresh_cycle()
+
+    assert calls == [[(38.9, -77.0), (40.7128, -74.006)]]
+    assert len(recorded) == 1
+    assert (41.0, -73.0) not in service._requested_at
+    history = await service.fetch_history()
+    assert [entry["persisted"] for entry in history] == [True, False]
+    assert await service.latest_for(40.7128, -74.006) is not None
+
+
 @pytest.mark.anyio
 async def test_cache_eviction_removes_stale_files(tmp_path):
     cache_dir = tmp_path / "hrrr"
@@ -157,3 +228,86 @@ async def test_cache_eviction_removes_stale_files(tmp_path):
     assert not old_meta.exists()
     assert new_file.exists()
     assert new_meta.exists()
+
+
+def _write_fake_extractor(tmp_path, body):
+    script = tmp_path / "hrrr_extract"
+    script.write_text(f"#!{sys.executable}\nimport json, sys\n{body}\n")
+    script.chmod(0o755)
+    return script
+
+
+def test_extract_point_fields_uses_native_extractor(tmp_path):
+    argv_log = tmp_path / "argv.json"
+    extractor = _write_fake_extractor(
+        tmp_path,
+        f"json.dump(sys.argv[1:], open({str(argv_log)!r}, 'w'))\n"
+        'print(json.dumps({"messages": 3, "decoded": 2, "index_cached": 0, "index_searched": 1, "points": ['
+        '{"lat": 38.9, "lon": -77.0, "values": {"temperature_k": 295.5, "pressure_pa": 101000, "wind_u": None}}]}))',
+    )
+    service = HrrrWeatherService(cache_dir=tmp_path / "cache", extractor_path=extractor)
+    grib_path = tmp_path / "run.grib2"
+    grib_path.write_bytes(b"GRIB")
+
+    values = service._extract_point_fields(grib_path, 38.9, -77.0)
+
+    assert values == {"temperature_k": 295.5, "pressure_pa": 101000.0}
+    args = json.loads(argv_log.read_text())
+    assert args[:2] == ["--index-dir", str(tmp_path / "cache" / "grid_index")]
+    assert "temperature_k:2t,t,tmp:heightAboveGround:2" in args
+    assert args[args.index("--point") + 1] == "38.9,-77.0"
+    assert args[-1] == str(grib_path)
+
+
+def test_native_extractor_failure_keeps_retry_message(tmp_path):
+    extractor = _write_fake_extractor(
+        tmp_path, 'sys.stderr.write("hrrr_extract: cannot create handle: End of resource\\n"); sys.exit(1)'
+    )
+    service = HrrrWeatherService(cache_dir=tmp_path / "cache", extractor_path=extractor)
+
+    with pytest.raises(RuntimeError) as excinfo:
+        service._extract_point_fields(tmp_path / "broken.grib2", 38.9, -77.0)
+
+    assert HrrrWeatherService._should_retry_grib_error(excinfo.value)
+
+
+_IDX = (
+    "1:0:d=2025102712:REFC:entire atmosphere:1 hour fcst:\n"
+    "2:100:d=2025102712:TMP:2 m above ground:1 hour fcst:\n"
+    "3:160:d=2025102712:RH:2 m above ground:1 hour fcst:\n"
+    "4:200:d=2025102712:HGT:surface:1 hour fcst:\n"
+    "5:260:d=2025102712:PRES:surface:1 hour fcst:\n"
+)
+
+
+def test_subset_ranges_cover_only_decoded_messages():
+    ranges = _subset_ranges(_parse_idx(_IDX))
+    # TMP and RH are adjacent and share one request; PRES runs to the end of the file
+    assert ranges == [(100, 199), (260, None)]
+
+
+@pytest.mark.anyio
+async def test_download_grib_fetches_idx_byte_ranges(tmp_path):
+    body = b"R" * 100 + b"GRIB-tmp" + b"t" * 52 + b"GRIB-rh" + b"r" * 33 + b"H" * 60 + b"GRIB-pres" + b"p" * 11
+    requested = []
+
+    def _handler(request):
+        if request.url.path.endswith(".idx"):
+            return httpx.Response(200, text=_IDX)
+        requested.append(request.headers["Range"])
+        start, _, end = request.headers["Range"].removeprefix("bytes=").partition("-")
+        return httpx.Response(206, content=body[int(start) : int(end) + 1 if end else None])
+
+    client = httpx.AsyncClient(transport=httpx.MockTransport(_handler))
+    service = HrrrWeatherService(cache_dir=tmp_path, http_client=client, subset_downloads=True)
+    run = HrrrRun(cycle=_ts("2025-10-27T12:00:00"), forecast_hour=1)
+    target = service._cache_path(run)
+
+    await service._ensure_grib(run)
+    await client.aclose()
+
+    assert sorted(requested) == ["bytes=100-199", "bytes=260-"]
+    assert target.read_bytes() == body[100:200] + body[260:]
+    meta = json.loads(service._metadata_path(target).read_text())
+    assert meta["subset"] is True
+    assert meta["subset_bytes"] == 100 + len(body) - 260
@@ -4,6 +4,9 @@
 #include "esp_err.h"
 #include "esp_idf_version.h"
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
 #include "esp_partition.h"
 
 #ifdef CONFIG_LITTLEFS_SDMMC_SUPPORT
@@ -204,6 +207,131 @@ esp_err_t esp_littlefs_partition_info(const esp_partition_t* partition, size_t *
 esp_err_t esp_littlefs_sdmmc_info(sdmmc_card_t *sdcard, size_t *total_bytes, size_t *used_bytes);
 #endif
 
+/**
+ * Read counters for one mounted filesystem, since mount or the last reset
+ */
+typedef struct {
+    uint64_t bytes_read;        /*!< Bytes returned by read() and pread() */
+    uint64_t readahead_bytes;   /*!< Part of bytes_read copied out of read-ahead windows */
+    uint64_t flash_bytes_read;  /*!< Bytes fetched from the partition or SD card, metadata included */
+    uint32_t flash_reads;       /*!< Block device read calls */
+} esp_littlefs_read_stats_t;
+
+/**
+ * Get read counters for littlefs
+ *
+ * @param partition_label           Optional, label of the partition to get counters for.
+ * @param[out] stats                Counters
+ *
+ * @return
+ *          - ESP_OK                  if success
+ *          - ESP_ERR_INVALID_STATE   if not mounted
+ */
+esp_err_t esp_littlefs_read_stats(const char* partition_label, esp_littlefs_read_stats_t *stats);
+
+/**
+ * Reset the read counters for littlefs
+ *
+ * @param partition_label           Optional, label of the partition.
+ *
+ * @return
+ *          - ESP_OK                  if success
+ *          - ESP_ERR_INVALID_STATE   if not mounted
+ */
+esp_err_t esp_littlefs_read_stats_reset(const char* partition_label);
+
+/**
+ * Write counters for one mounted filesystem, since mount or the last reset
+ */
+typedef struct {
+    uint64_t flash_bytes_programmed;  /*!< Bytes programmed to the partition or SD card, metadata included */
+    uint32_t flash_progs;             /*!< Block device program calls */
+    uint32_t flash_erases;            /*!< Blocks physically erased, background pre-erases included */
+    uint32_t erases_skipped;          /*!< littlefs erases that found the block pre-erased */
+    uint32_t writes_deferred;         /*!< write() calls staged by CONFIG_LITTLEFS_WRITE_BEHIND and written out since */
+    uint32_t deferred_commits;        /*!< lfs_file_sync() calls the write-behind task grouped them into */
+} esp_littlefs_write_stats_t;
+
+/**
+ * Get write counters for littlefs
+ *
+ * @param partition_label           Optional, label of the partition to get counters for.
+ * @param[out] stats                Counters
+ *
+ * @return
+ *          - ESP_OK                  if success
+ *          - ESP_ERR_INVALID_STATE   if not mounted
+ */
+esp_err_t esp_littlefs_write_stats(const char* partition_label, esp_littlefs_write_stats_t *stats);
+
+/**
+ * Reset the write counters for littlefs
+ *
+ * @param partition_label           Optional, label of the partition.
+ *
+ * @return
+ *          - ESP_OK                  if success
+ *          - ESP_ERR_INVALID_STATE   if not mounted
+ */
+esp_err_t esp_littlefs_write_stats_reset(const char* partition_label);
+
+/**
+ * Commit everything written to a partition so far
+ *
+ * Writes out the data CONFIG_LITTLEFS_WRITE_BEHIND has staged and syncs every
+ * open file with uncommitted writes, so all of it survives a power loss once
+ * this returns. fsync() does the same for one descriptor.
+ *
+ * @param partition_label           Optional, label of the partition.
+ *
+ * @return
+ *          - ESP_OK                  if success
+ *          - ESP_ERR_INVALID_STATE   if not mounted
+ *          - ESP_FAIL                if a file could not be written or committed
+ */
+esp_err_t esp_littlefs_write_barrier(const char* partition_label);
+
+#ifdef CONFIG_LITTLEFS_MMAP_PARTITION
+/**
+ * Get a direct pointer to file data in the memory-mapped partition.
+ *
+ * A file's data is spread over flash blocks, so one call returns at most the
+ * rest of the block holding @p offset; call again at offset + *len for more.
+ * The file position is not changed. The pointer stays valid until the file
+ * is written, truncated or removed through any descriptor, so consume it
+ * before handing the file to a writer.
+ *
+ * On ESP_ERR_NOT_SUPPORTED, read the range with pread() instead. This happens
+ * for files small enough to be inlined in their directory entry, descriptors
+ * with unsynced writes, and mounts that are not mmapped (e.g. SD cards).
+ *
+ *     while (offset < end) {
+ *         if (esp_littlefs_file_map(fd, offset, end - offset, &data, &len) == ESP_OK) {
+ *             if (len == 0) break;            // end of file
+ *             consume(data, len);
+ *         } else {
+ *             len = pread(fd, buf, MIN(sizeof(buf), end - offset), offset);
+ *             if (len <= 0) break;
+ *             consume(buf, len);
+ *         }
+ *         offset += len;
+ *     }
+ *
+ * @param fd           open file descriptor on a littlefs mount
+ * @param offset       byte offset in the file
+ * @param size         most bytes wanted
+ * @param[out] data    start of the mapped data
+ * @param[out] len     contiguous bytes at data; 0 at or past end of file
+ *
+ * @return
+ *          - ESP_OK                  if success
+ *          - ESP_ERR_NOT_SUPPORTED   if this range has to be read with pread()
+ *          - ESP_ERR_INVALID_ARG     if fd is not an open littlefs file
+ *          - ESP_FAIL                if the file's block list is corrupt
+ */
+esp_err_t esp_littlefs_file_map(int fd, off_t offset, size_t size, const void **data, size_t *len);
+#endif
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
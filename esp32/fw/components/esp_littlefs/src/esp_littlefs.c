@@ -133,6 +133,15 @@ static esp_err_t esp_littlefs_init(const esp_vfs_littlefs_conf_t* conf, int *ind
 static esp_err_t esp_littlefs_by_label(const char* label, int * index);
 static esp_err_t esp_littlefs_by_partition(const esp_partition_t* part, int*index);
 static int esp_littlefs_file_sync(esp_littlefs_t *efs, vfs_littlefs_file_t *file);
+static void esp_littlefs_readahead_drop(esp_littlefs_t *efs, uint32_t hash);
+static int esp_littlefs_readahead_sync_pos(esp_littlefs_t *efs, vfs_littlefs_file_t *file);
+static void esp_littlefs_writebehind_drain(esp_littlefs_t *efs);
+#ifdef CONFIG_LITTLEFS_WRITE_BEHIND
+static esp_err_t esp_littlefs_writebehind_start(esp_littlefs_t *efs);
+static void esp_littlefs_writebehind_stop(esp_littlefs_t *efs, bool commit);
+static int esp_littlefs_writebehind_err(esp_littlefs_t *efs, vfs_littlefs_file_t *file, bool take);
+#endif
+static int esp_littlefs_fd_cache_resize(esp_littlefs_t *efs, uint16_t new_size);
 
 #ifdef CONFIG_LITTLEFS_SDMMC_SUPPORT
 static esp_err_t esp_littlefs_by_sdmmc_handle(sdmmc_card_t *handle, int *index);
@@ -164,6 +173,7 @@ static int vfs_littlefs_fcntl(void* ctx, int fd, int cmd, int arg);
 
 static int sem_take(esp_littlefs_t *efs);
 static int sem_give(esp_littlefs_t *efs);
+static void esp_littlefs_wait_unpinned(esp_littlefs_t *efs, vfs_littlefs_file_t *file);
 static esp_err_t format_from_efs(esp_littlefs_t *efs);
 static void get_total_and_used_bytes(esp_littlefs_t *efs, size_t *total_bytes, size_t *used_bytes);
 
@@ -194,15 +204,43 @@ static inline void * esp_littlefs_calloc(size_t __nmemb, size_t __size) {
 #endif
 }
 
+/**
+ * @brief Wait until no read or write has an open descriptor pinned, and stop
+ *        new ones from starting, so esp_littlefs_free_fds() can free them.
+ *        Unmounting while a close() of the same descriptor is still in flight
+ *        is not supported.
+ */
+static void esp_littlefs_wait_fds(esp_littlefs_t * efs) {
+    sem_take(efs);
+    for (uint16_t i = 0; i < efs->cache_size; i++) {
+        if (efs->cache[i] != NULL) {
+            esp_littlefs_wait_unpinned(efs, efs->cache[i]);
+        }
+    }
+    sem_give(efs);
+}
+
 static void esp_littlefs_free_fds(esp_littlefs_t * efs) {
     /* Need to free all files that were opened */
-    while (efs->file) {
-        vfs_littlefs_file_t * next = efs->file->next;
-        free(efs->file);
-        efs->file = next;
+    for (uint16_t i = 0; i < efs->cache_size; i++) {
+        vfs_littlefs_file_t *file = efs->cache[i];
+        if (file == NULL) {
+            continue;
+        }
+#if CONFIG_LITTLEFS_IO_CHUNK_SIZE > 0
+        vSemaphoreDelete(file->lock);
+#endif
+#if CONFIG_LITTLEFS_READAHEAD_MAX > 0
+        free(file->ra_buf);
+#endif
+        free(file);
     }
     free(efs->cache);
+    free(efs->free_fd);
+    free(efs->fd_index);
     efs->cache = 0;
+    efs->free_fd = efs->fd_index = 0;
+    efs->fd_index_mask = 0;
     efs->cache_size = efs->fd_count = 0;
 }
 
@@ -237,6 +275,14 @@ esp_err_t format_from_efs(esp_littlefs_t *efs)
         int res;
         ESP_LOGV(ESP_LITTLEFS_TAG, "Partition was mounted. Unmounting...");
         was_mounted = true;
+        esp_littlefs_wait_fds(efs);
+#ifdef CONFIG_LITTLEFS_WRITE_BEHIND
+        /* Staged writes would land in the new filesystem */
+        esp_littlefs_writebehind_stop(efs, false);
+#endif
+#ifdef CONFIG_LITTLEFS_PREERASE
+        littlefs_esp_part_preerase_stop(efs);
+#endif
         res = lfs_unmount(efs->fs);
         if(res != LFS_ERR_OK){
             ESP_LOGE(ESP_LITTLEFS_TAG, "Failed to unmount.");
@@ -291,8 +337,22 @@ esp_err_t format_from_efs(esp_littlefs_t *efs)
             ESP_LOGE(ESP_LITTLEFS_TAG, "Failed to re-mount filesystem");
             return ESP_FAIL;
         }
-        efs->cache_size = CONFIG_LITTLEFS_FD_CACHE_MIN_SIZE;  // Initial size of cache; will resize ondemand
-        efs->cache = esp_littlefs_calloc(efs->cache_size, sizeof(*efs->cache));
+        // Initial size of cache; will resize ondemand
+        if (esp_littlefs_fd_cache_resize(efs, CONFIG_LITTLEFS_FD_CACHE_MIN_SIZE) < 0) {
+            ESP_LOGE(ESP_LITTLEFS_TAG, "Unable to allocate file cache");
+            lfs_unmount(efs->fs);
+            return ESP_ERR_NO_MEM;
+        }
+#ifdef CONFIG_LITTLEFS_PREERASE
+        if (littlefs_esp_part_preerase_start(efs) != ESP_OK) {
+            ESP_LOGW(ESP_LITTLEFS_TAG, "Unable to start the pre-erase task");
+        }
+#endif
+#ifdef CONFIG_LITTLEFS_WRITE_BEHIND
+        if (esp_littlefs_writebehind_start(efs) != ESP_OK) {
+            ESP_LOGW(ESP_LITTLEFS_TAG, "Unable to start the write-behind task; writes are not deferred");
+        }
+#endif
     }
     ESP_LOGV(ESP_LITTLEFS_TAG, "Format Success!");
 
@@ -365,6 +425,108 @@ esp_err_t esp_littlefs_partition_info(const esp_partition_t* partition, size_t *
     return ESP_OK;
 }
 
+esp_err_t esp_littlefs_read_stats(const char* partition_label, esp_littlefs_read_stats_t *stats){
+    int index;
+    esp_err_t err;
+
+    if(!stats) return ESP_ERR_INVALID_ARG;
+    err = esp_littlefs_by_label(partition_label, &index);
+    if(err != ESP_OK) return err;
+    sem_take(_efs[index]);
+    *stats = _efs[index]->read_stats;
+    sem_give(_efs[index]);
+
+    return ESP_OK;
+}
+
+esp_err_t esp_littlefs_read_stats_reset(const char* partition_label){
+    int index;
+    esp_err_t err;
+
+    err = esp_littlefs_by_label(partition_label, &index);
+    if(err != ESP_OK) return err;
+    sem_take(_efs[index]);
+    memset(&_efs[index]->read_stats, 0, sizeof(_efs[index]->read_stats));
+    sem_give(_efs[index]);
+
+    return ESP_OK;
+}
+
+esp_err_t esp_littlefs_write_stats(const char* partition_label, esp_littlefs_write_stats_t *stats){
+    int index;
+    esp_err_t err;
+
+    if(!stats) return ESP_ERR_INVALID_ARG;
+    err = esp_littlefs_by_label(partition_label, &index);
+    if(err != ESP_OK) return err;
+    sem_take(_efs[index]);
+    *stats = _efs[index]->write_stats;
+    sem_give(_efs[index]);
+
+    return ESP_OK;
+}
+
+esp_err_t esp_littlefs_write_stats_reset(const char* partition_label){
+    int index;
+    esp_err_t err;
+
+    err = esp_littlefs_by_label(partition_label, &index);
+    if(err != ESP_OK) return err;
+    sem_take(_efs[index]);
+    memset(&_efs[index]->write_stats, 0, sizeof(_efs[index]->write_stats));
+    sem_give(_efs[index]);
+
+    return ESP_OK;
+}
+
+esp_err_t esp_littlefs_write_barrier(const char* partition_label){
+    int index;
+    esp_err_t err;
+    esp_littlefs_t *efs;
+
+    err = esp_littlefs_by_label(partition_label, &index);
+    if(err != ESP_OK) return err;
+    efs = _efs[index];
+    sem_take(efs);
+    esp_littlefs_writebehind_drain(efs);
+    for (uint16_t i = 0; i < efs->cache_size; i++) {
+        vfs_littlefs_file_t *file = efs->cache[i];
+        int res = 0;
+
+        if (file == NULL) {
+            continue;
+        }
+#if CONFIG_LITTLEFS_OPEN_DIR
+        if (file->file.flags & O_DIRECTORY) {
+            continue;
+        }
+#endif
+        if (file->file.flags & (LFS_F_DIRTY | LFS_F_WRITING)) {
+            res = esp_littlefs_file_sync(efs, file);
+        }
+#ifdef CONFIG_LITTLEFS_WRITE_BEHIND
+        file->wb_dirty = false;
+        if (res == 0) {
+            /* Left for the descriptor to report too */
+            res = esp_littlefs_writebehind_err(efs, file, false);
+        }
+#endif
+        if (res < 0) {
+#ifndef CONFIG_LITTLEFS_USE_ONLY_HASH
+            ESP_LOGE(ESP_LITTLEFS_TAG, "Failed to commit file \"%s\". Error %d",
+                    file->path, res);
+#else
+            ESP_LOGE(ESP_LITTLEFS_TAG, "Failed to commit FD %u. Error %d",
+                    (unsigned int)i, res);
+#endif
+            err = ESP_FAIL;
+        }
+    }
+    sem_give(efs);
+
+    return err;
+}
+
 #ifdef CONFIG_LITTLEFS_SDMMC_SUPPORT
 esp_err_t esp_littlefs_sdmmc_info(sdmmc_card_t *sdcard, size_t *total_bytes, size_t *used_bytes)
 {
@@ -628,6 +790,30 @@ exit:
 }
 #endif
 
+#ifdef CONFIG_LITTLEFS_MMAP_PARTITION
+esp_err_t esp_littlefs_file_map(int fd, off_t offset, size_t size, const void **data, size_t *len)
+{
+    if (!data || !len || offset < 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    esp_littlefs_map_req_t req = {
+        .offset = offset,
+        .size = size,
+    };
+    if (fcntl(fd, ESP_LITTLEFS_F_MAP, (int)(uintptr_t)&req) < 0) {
+        switch (errno) {
+            case EBADF:   return ESP_ERR_INVALID_ARG;
+            case EBADMSG: return ESP_FAIL;
+            default:      return ESP_ERR_NOT_SUPPORTED;  // includes other filesystems' ENOSYS
+        }
+    }
+    *data = req.data;
+    *len = req.len;
+    return ESP_OK;
+}
+#endif
+
 /********************
  * Static Functions *
  ********************/
@@ -731,6 +917,17 @@ static void esp_littlefs_free(esp_littlefs_t ** efs)
     if (e == NULL) return;
     *efs = NULL;
 
+    if (e->lock && e->cache_size > 0) {
+        esp_littlefs_wait_fds(e);
+    }
+
+#ifdef CONFIG_LITTLEFS_WRITE_BEHIND
+    /* lfs_unmount() does not sync open files; commit what was staged */
+    esp_littlefs_writebehind_stop(e, true);
+#endif
+#ifdef CONFIG_LITTLEFS_PREERASE
+    littlefs_esp_part_preerase_stop(e);
+#endif
     if (e->fs) {
         if(e->cache_size > 0) lfs_unmount(e->fs);
         free(e->fs);
@@ -1162,8 +1359,12 @@ static esp_err_t esp_littlefs_init(const esp_vfs_littlefs_conf_t* conf, int *ind
             err = ESP_FAIL;
             goto exit;
         }
-        efs->cache_size = 4;
-        efs->cache = esp_littlefs_calloc(efs->cache_size, sizeof(*efs->cache));
+        if (esp_littlefs_fd_cache_resize(efs, CONFIG_LITTLEFS_FD_CACHE_MIN_SIZE) < 0) {
+            ESP_LOGE(ESP_LITTLEFS_TAG, "Unable to allocate file cache");
+            lfs_unmount(efs->fs);
+            err = ESP_ERR_NO_MEM;
+            goto exit;
+        }
 
         if(conf->grow_on_mount){
 #ifdef CONFIG_LITTLEFS_SDMMC_SUPPORT
@@ -1180,6 +1381,16 @@ static esp_err_t esp_littlefs_init(const esp_vfs_littlefs_conf_t* conf, int *ind
                 goto exit;
             }
         }
+#ifdef CONFIG_LITTLEFS_PREERASE
+        if (littlefs_esp_part_preerase_start(efs) != ESP_OK) {
+            ESP_LOGW(ESP_LITTLEFS_TAG, "Unable to start the pre-erase task");
+        }
+#endif
+#ifdef CONFIG_LITTLEFS_WRITE_BEHIND
+        if (esp_littlefs_writebehind_start(efs) != ESP_OK) {
+            ESP_LOGW(ESP_LITTLEFS_TAG, "Unable to start the write-behind task; writes are not deferred");
+        }
+#endif
     }
 
     err = ESP_OK;
@@ -1224,21 +1435,234 @@ static inline int sem_give(esp_littlefs_t *efs) {
     return xSemaphoreGiveRecursive(efs->lock);
 }
 
+/**
+ * @brief Look up an open file descriptor and pin it, so it stays allocated
+ *        while the FS lock is released (close() waits for pinned descriptors).
+ * @return the file, or NULL if fd is not open or is being closed.
+ * @warning This must be called with lock taken
+ */
+static vfs_littlefs_file_t * esp_littlefs_pin_fd(esp_littlefs_t *efs, int fd) {
+    vfs_littlefs_file_t *file;
+
+    if((uint32_t)fd >= efs->cache_size) {
+        return NULL;
+    }
+    file = efs->cache[fd];
+    if(!file || file->closing) {
+        return NULL;
+    }
+    file->users++;
+    return file;
+}
+
+/**
+ * @warning This must be called with lock taken
+ */
+static inline void esp_littlefs_unpin_fd(vfs_littlefs_file_t *file) {
+    assert(file->users > 0);
+    if (--file->users == 0 && file->drained) {
+        xSemaphoreGive(file->drained);
+    }
+}
+
+/**
+ * @brief Mark a descriptor closing and block until the reads and writes that
+ *        pinned it have finished. pin_fd() refuses a closing descriptor, so
+ *        users only goes down, and the last unpin wakes the waiter.
+ * @warning This must be called with lock taken; it is released while waiting
+ */
+static void esp_littlefs_wait_unpinned(esp_littlefs_t *efs, vfs_littlefs_file_t *file) {
+    StaticSemaphore_t drained_buffer;
+
+    wb_lock(efs);
+    file->closing = true;
+    wb_unlock(efs);
+    if (file->users == 0) {
+        return;
+    }
+    file->drained = xSemaphoreCreateBinaryStatic(&drained_buffer);
+    while (file->users > 0) {
+        sem_give(efs);
+        xSemaphoreTake(file->drained, portMAX_DELAY);
+        sem_take(efs);
+    }
+    vSemaphoreDelete(file->drained);
+    file->drained = NULL;
+}
+
+/**
+ * @brief Per-descriptor I/O lock. Always taken before the FS lock, never while holding it.
+ */
+static inline void file_lock(vfs_littlefs_file_t *file) {
+#if CONFIG_LITTLEFS_IO_CHUNK_SIZE > 0
+    xSemaphoreTake(file->lock, portMAX_DELAY);
+#else
+    (void)file;
+#endif
+}
+
+static inline void file_unlock(vfs_littlefs_file_t *file) {
+#if CONFIG_LITTLEFS_IO_CHUNK_SIZE > 0
+    xSemaphoreGive(file->lock);
+#else
+    (void)file;
+#endif
+}
+
+/**
+ * @brief Staging lock of the write-behind task. write() looks descriptors up
+ *        under it instead of the FS lock, so moving the cache, freeing a
+ *        descriptor or marking it closing also takes it. Only taken with the
+ *        FS lock held (or without any other lock by write()).
+ */
+static inline void wb_lock(esp_littlefs_t *efs) {
+#ifdef CONFIG_LITTLEFS_WRITE_BEHIND
+    if (efs->wb.lock) {
+        xSemaphoreTake(efs->wb.lock, portMAX_DELAY);
+    }
+#else
+    (void)efs;
+#endif
+}
+
+static inline void wb_unlock(esp_littlefs_t *efs) {
+#ifdef CONFIG_LITTLEFS_WRITE_BEHIND
+    if (efs->wb.lock) {
+        xSemaphoreGive(efs->wb.lock);
+    }
+#else
+    (void)efs;
+#endif
+}
+
 
-/* We are using a double allocation system here, which an array and a linked list.
-   The array contains the pointer to the file descriptor (the index in the array is what's returned to the user).
-   The linked list is used for file descriptors.
-   This means that position of nodes in the list must stay consistent:
-   - Allocation is obvious (append to the list from the head, and realloc the pointers array)
-     There is still a O(N) search in the cache for a free position to store
-   - Searching is a O(1) process (good)
-   - Deallocation is more tricky. That is, for example,
-     if you need to remove node 5 in a 12 nodes list, you'll have to:
-       1) Mark the 5th position as freed (if it's the last position of the array realloc smaller)
-       2) Walk the list until finding the pointer to the node O(N) and scrub the node so the chained list stays consistent
-       3) Deallocate the node
+/* Open files are kept in three arrays, all sized from cache_size:
+   - cache holds the pointer to each file descriptor; the index in the array
+     is what's returned to the user, so lookups by FD are O(1).
+   - free_fd is a stack of the unused indices in cache, so allocating and
+     releasing a FD are O(1) too.
+   - fd_index is an open addressing (linear probing) table from path hash to
+     FD, kept at most half full, so finding the descriptors open on a path
+     does not scan the cache. FDs sharing a hash sit in the same probe run.
+   Only growing the cache is O(N): fd_index is rebuilt at its new size.
 */
 
+#define ESP_LITTLEFS_FD_INDEX_EMPTY UINT16_MAX
+
+/**
+ * @brief First fd_index slot to probe for a path hash.
+ */
+static inline uint32_t esp_littlefs_fd_index_home(const esp_littlefs_t *efs, uint32_t hash) {
+    return (hash ^ (hash >> 16)) & efs->fd_index_mask;
+}
+
+static void esp_littlefs_fd_index_insert(esp_littlefs_t *efs, uint16_t fd) {
+    uint32_t slot = esp_littlefs_fd_index_home(efs, efs->cache[fd]->hash);
+    while (efs->fd_index[slot] != ESP_LITTLEFS_FD_INDEX_EMPTY) {
+        slot = (slot + 1) & efs->fd_index_mask;
+    }
+    efs->fd_index[slot] = fd;
+}
+
+/**
+ * @brief Remove a FD from fd_index, shifting the rest of its probe run back
+ *        so lookups never need tombstones. A FD that was never indexed (its
+ *        open failed) is simply not found.
+ */
+static void esp_littlefs_fd_index_remove(esp_littlefs_t *efs, uint16_t fd) {
+    const uint32_t mask = efs->fd_index_mask;
+    uint32_t hole = esp_littlefs_fd_index_home(efs, efs->cache[fd]->hash);
+
+    while (efs->fd_index[hole] != fd) {
+        if (efs->fd_index[hole] == ESP_LITTLEFS_FD_INDEX_EMPTY) {
+            return;
+        }
+        hole = (hole + 1) & mask;
+    }
+    for (uint32_t slot = (hole + 1) & mask;
+         efs->fd_index[slot] != ESP_LITTLEFS_FD_INDEX_EMPTY;
+         slot = (slot + 1) & mask) {
+        uint32_t home = esp_littlefs_fd_index_home(efs, efs->cache[efs->fd_index[slot]]->hash);
+        /* Move the entry into the hole unless its home lies after the hole
+         * (cyclically), up to and including slot */
+        if (((slot - home) & mask) >= ((slot - hole) & mask)) {
+            efs->fd_index[hole] = efs->fd_index[slot];
+            hole = slot;
+        }
+    }
+    efs->fd_index[hole] = ESP_LITTLEFS_FD_INDEX_EMPTY;
+}
+
+/**
+ * @brief Iterate the open FDs whose path hashes to hash.
+ * @param[in,out] slot start with esp_littlefs_fd_index_home()
+ * @return the next FD, or -1 when there are no more
+ * @warning This must be called with lock taken
+ */
+static int esp_littlefs_fd_index_next(const esp_littlefs_t *efs, uint32_t hash, uint32_t *slot) {
+    uint16_t fd;
+    while ((fd = efs->fd_index[*slot]) != ESP_LITTLEFS_FD_INDEX_EMPTY) {
+        *slot = (*slot + 1) & efs->fd_index_mask;
+        if (efs->cache[fd]->hash == hash) {
+            return fd;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Grow (or first allocate) the FD cache, its free slot stack and
+ *        fd_index. On failure the cache is left as it was.
+ * @return 0 on success, -1 when out of memory
+ * @warning This must be called with lock taken
+ */
+static int esp_littlefs_fd_cache_resize(esp_littlefs_t *efs, uint16_t new_size) {
+    const uint16_t old_size = efs->cache_size;
+    const uint32_t index_size = (uint32_t)1 << lfs_npw2(2 * (uint32_t)new_size);
+
+    assert(new_size > old_size);
+
+    uint16_t *new_index = esp_littlefs_calloc(index_size, sizeof(*new_index));
+    if (!new_index) {
+        return -1;
+    }
+    /* The free stack never holds more than new_size entries */
+    uint16_t *new_free = realloc(efs->free_fd, new_size * sizeof(*new_free));
+    if (!new_free) {
+        free(new_index);
+        return -1;
+    }
+    efs->free_fd = new_free;
+    vfs_littlefs_file_t ** new_cache = realloc(efs->cache, new_size * sizeof(*efs->cache));
+    if (!new_cache) {
+        free(new_index);
+        return -1;
+    }
+    /* Zero out the new portions of the cache */
+    memset(&new_cache[old_size], 0, (new_size - old_size) * sizeof(*efs->cache));
+    efs->cache = new_cache;
+    efs->cache_size = new_size;
+
+    /* Push the new slots so the lowest index is handed out first. The stack
+     * only holds unused slots, so with old entries present it has
+     * old_size - fd_count of them below these. */
+    uint16_t n_free = old_size - efs->fd_count;
+    for (uint16_t i = new_size; i > old_size; i--) {
+        efs->free_fd[n_free++] = i - 1;
+    }
+
+    free(efs->fd_index);
+    efs->fd_index = new_index;
+    efs->fd_index_mask = index_size - 1;
+    memset(efs->fd_index, 0xff, index_size * sizeof(*efs->fd_index));
+    for (uint16_t i = 0; i < old_size; i++) {
+        if (efs->cache[i]) {
+            esp_littlefs_fd_index_insert(efs, i);
+        }
+    }
+    return 0;
+}
+
 /**
  * @brief Get a file descriptor
  * @param[in,out] efs       file system context
@@ -1246,6 +1670,8 @@ static inline int sem_give(esp_littlefs_t *efs) {
  * @param[in]     path_len  the length of the filepath in bytes (including terminating zero byte)
  * @return integer file descriptor. Returns -1 if a FD cannot be obtained.
  * @warning This must be called with lock taken
+ * @note The FD is added to fd_index by esp_littlefs_index_fd() once the
+ *       file's hash is known.
  */
 static int esp_littlefs_allocate_fd(esp_littlefs_t *efs, vfs_littlefs_file_t ** file
 #ifndef CONFIG_LITTLEFS_USE_ONLY_HASH
@@ -1253,24 +1679,24 @@ static int esp_littlefs_allocate_fd(esp_littlefs_t *efs, vfs_littlefs_file_t **
 #endif
     )
 {
-    int i = -1;
+    uint16_t i;
 
     assert( efs->fd_count < UINT16_MAX );
     assert( efs->cache_size < UINT16_MAX );
 
     /* Make sure there is enough space in the cache to store new fd */
     if (efs->fd_count + 1 > efs->cache_size) {
-        uint16_t new_size = (uint16_t)MIN(UINT16_MAX, CONFIG_LITTLEFS_FD_CACHE_REALLOC_FACTOR * efs->cache_size);
-        /* Resize the cache */
-        vfs_littlefs_file_t ** new_cache = realloc(efs->cache, new_size * sizeof(*efs->cache));
-        if (!new_cache) {
+        uint16_t new_size = (uint16_t)MIN(UINT16_MAX - 1, CONFIG_LITTLEFS_FD_CACHE_REALLOC_FACTOR * efs->cache_size);
+        int res = -1;
+        if (new_size > efs->cache_size) {
+            wb_lock(efs);
+            res = esp_littlefs_fd_cache_resize(efs, new_size);
+            wb_unlock(efs);
+        }
+        if (res < 0) {
             ESP_LOGE(ESP_LITTLEFS_TAG, "Unable to allocate file cache");
             return -1; /* If it fails here, no harm is done to the filesystem, so it's safe */
         }
-        /* Zero out the new portions of the cache */
-        memset(&new_cache[efs->cache_size], 0, (new_size - efs->cache_size) * sizeof(*efs->cache));
-        efs->cache = new_cache;
-        efs->cache_size = new_size;
     }
 
 
@@ -1292,9 +1718,9 @@ static int esp_littlefs_allocate_fd(esp_littlefs_t *efs, vfs_littlefs_file_t **
 #ifndef CONFIG_LITTLEFS_USE_ONLY_HASH
     /* The trick here is to avoid dual allocation so the path pointer
         should point to the next byte after it:
-        file => [ lfs_file | # | next | path | free_space ]
-                                            |  /\
-                                            |__/
+        file => [ lfs_file | # | path | free_space ]
+                                  |  /\
+                                  |__/
     */
     (*file)->path = (char*)(*file) + sizeof(**file);
 #endif
@@ -1308,21 +1734,25 @@ static int esp_littlefs_allocate_fd(esp_littlefs_t *efs, vfs_littlefs_file_t **
     (*file)->lfs_attr[0].size = sizeof((*file)->lfs_attr_time_buffer);
 #endif
     (*file)->lfs_file_config.attr_count = ESP_LITTLEFS_ATTR_COUNT;
+#if CONFIG_LITTLEFS_IO_CHUNK_SIZE > 0
+    (*file)->lock = xSemaphoreCreateMutexStatic(&(*file)->lock_buffer);
+#endif
 
-    /* Now find a free place in cache */
-    for(i=0; i < efs->cache_size; i++) {
-        if (efs->cache[i] == NULL) {
-            efs->cache[i] = *file;
-            break;
-        }
-    }
-    /* Save file in the list */
-    (*file)->next = efs->file;
-    efs->file = *file;
+    /* Take a free place in cache */
+    i = efs->free_fd[efs->cache_size - efs->fd_count - 1];
+    efs->cache[i] = *file;
     efs->fd_count++;
     return i;
 }
 
+/**
+ * @brief Make an open file findable by path. Its hash (and path) must be set.
+ * @warning This must be called with lock taken
+ */
+static void esp_littlefs_index_fd(esp_littlefs_t *efs, int fd) {
+    esp_littlefs_fd_index_insert(efs, (uint16_t)fd);
+}
+
 /**
  * @brief Release a file descriptor
  * @param[in,out] efs file system context
@@ -1331,70 +1761,30 @@ static int esp_littlefs_allocate_fd(esp_littlefs_t *efs, vfs_littlefs_file_t **
  * @warning This must be called with lock taken
  */
 static int esp_littlefs_free_fd(esp_littlefs_t *efs, int fd){
-    vfs_littlefs_file_t * file, * head;
+    vfs_littlefs_file_t * file;
 
-    if((uint32_t)fd >= efs->cache_size) {
-        ESP_LOGE(ESP_LITTLEFS_TAG, "FD %d must be <%d.", fd, efs->cache_size);
+    if((uint32_t)fd >= efs->cache_size || efs->cache[fd] == NULL) {
+        ESP_LOGE(ESP_LITTLEFS_TAG, "FD %d must be <%d and open.", fd, efs->cache_size);
         return -1;
     }
 
     /* Get the file descriptor to free it */
     file = efs->cache[fd];
-    head = efs->file;
-    /* Search for file in SLL to remove it */
-    if (file == head) {
-        /* Last file, can't fail */
-        efs->file = efs->file->next;
-    } else {
-        while (head && head->next != file) {
-            head = head->next;
-        }
-        if (!head) {
-            ESP_LOGE(ESP_LITTLEFS_TAG, "Inconsistent list");
-            return -1;
-        }
-        /* Transaction starts here and can't fail anymore */
-        head->next = file->next;
-    }
+    esp_littlefs_fd_index_remove(efs, (uint16_t)fd);
+    wb_lock(efs);
     efs->cache[fd] = NULL;
+    wb_unlock(efs);
     efs->fd_count--;
+    efs->free_fd[efs->cache_size - efs->fd_count - 1] = (uint16_t)fd;
 
     ESP_LOGV(ESP_LITTLEFS_TAG, "Clearing FD");
-    free(file);
-
-#if 0
-    /* Realloc smaller if its possible
-     *     * Find and realloc based on number of trailing NULL ptrs in cache
-     *     * Leave some hysteris to prevent thrashing around resize points
-     * This is disabled for now because it adds unnecessary complexity
-     * and binary size increase that outweights its ebenfits.
-     */
-    if(efs->cache_size > CONFIG_LITTLEFS_FD_CACHE_MIN_SIZE) {
-        uint16_t n_free;
-        uint16_t new_size = efs->cache_size / CONFIG_LITTLEFS_FD_CACHE_REALLOC_FACTOR;
-
-        if(new_size >= CONFIG_LITTLEFS_FD_CACHE_MIN_SIZE) {
-            /* Count number of trailing NULL ptrs */
-            for(n_free=0; n_free < efs->cache_size; n_free++) {
-                if(efs->cache[efs->cache_size - n_free - 1] != NULL) {
-                    break;
-                }
-            }
-
-            if(n_free >= (efs->cache_size - new_size)){
-                new_size += CONFIG_LITTLEFS_FD_CACHE_HYST;
-                ESP_LOGV(ESP_LITTLEFS_TAG, "Reallocating cache %i -> %i", efs->cache_size, new_size);
-                vfs_littlefs_file_t ** new_cache;
-                new_cache = realloc(efs->cache, new_size * sizeof(*efs->cache));
-                /* No harm on realloc failure, continue using the oversized cache */
-                if(new_cache) {
-                    efs->cache = new_cache;
-                    efs->cache_size = new_size;
-                }
-            }
-        }
-    }
+#if CONFIG_LITTLEFS_IO_CHUNK_SIZE > 0
+    vSemaphoreDelete(file->lock);
+#endif
+#if CONFIG_LITTLEFS_READAHEAD_MAX > 0
+    free(file->ra_buf);
 #endif
+    free(file);
 
     return 0;
 }
@@ -1425,21 +1815,18 @@ static uint32_t compute_hash(const char * path) {
  */
 static int esp_littlefs_get_fd_by_name(esp_littlefs_t *efs, const char *path){
     uint32_t hash = compute_hash(path);
+    uint32_t slot = esp_littlefs_fd_index_home(efs, hash);
+    int i;
 
-    for(uint16_t i=0, j=0; i < efs->cache_size && j < efs->fd_count; i++){
-        if (efs->cache[i]) {
-            ++j;
-
-            if (
-                efs->cache[i]->hash == hash  // Faster than strcmp
+    while ((i = esp_littlefs_fd_index_next(efs, hash, &slot)) >= 0) {
 #ifndef CONFIG_LITTLEFS_USE_ONLY_HASH
-                && strcmp(path, efs->cache[i]->path) == 0  // May as well check incase of hash collision. Usually short-circuited.
-#endif
-            ) {
-                ESP_LOGV(ESP_LITTLEFS_TAG, "Found \"%s\" at FD %d.", path, i);
-                return i;
-            }
+        /* May as well check incase of hash collision. */
+        if (strcmp(path, efs->cache[i]->path) != 0) {
+            continue;
         }
+#endif
+        ESP_LOGV(ESP_LITTLEFS_TAG, "Found \"%s\" at FD %d.", path, i);
+        return i;
     }
     ESP_LOGV(ESP_LITTLEFS_TAG, "Unable to get a find FD for \"%s\"", path);
     return -1;
@@ -1555,6 +1942,9 @@ static int vfs_littlefs_open(void* ctx, const char * path, int flags, int mode)
     if(!efs->read_only && lfs_flags != LFS_O_RDONLY)
     {
         res = esp_littlefs_file_sync(efs, file);
+#ifdef CONFIG_LITTLEFS_WRITE_BEHIND
+        file->wb_writable = true;
+#endif
     }
     if(res < 0){
         errno = lfs_errno_remap(res);
@@ -1574,192 +1964,784 @@ static int vfs_littlefs_open(void* ctx, const char * path, int flags, int mode)
 #ifndef CONFIG_LITTLEFS_USE_ONLY_HASH
     memcpy(file->path, path, path_len);
 #endif
+    esp_littlefs_index_fd(efs, fd);
+    if (lfs_flags & LFS_O_TRUNC) {
+        esp_littlefs_readahead_drop(efs, file->hash);
+    }
 
     sem_give(efs);
     ESP_LOGV(ESP_LITTLEFS_TAG, "Done opening %s", path);
     return fd;
 }
 
-static ssize_t vfs_littlefs_write(void* ctx, int fd, const void * data, size_t size) {
-    esp_littlefs_t * efs = (esp_littlefs_t *)ctx;
-    ssize_t res;
-    vfs_littlefs_file_t *file = NULL;
+/**
+ * @brief Read or write at an absolute offset and restore the file position.
+ * @warning This must be called with lock taken
+ */
+static ssize_t esp_littlefs_positional_io(esp_littlefs_t *efs, vfs_littlefs_file_t *file,
+                                          void *buf, size_t size, off_t offset, bool is_write)
+{
+    ssize_t res, save_res;
 
-    sem_take(efs);
-    if((uint32_t)fd > efs->cache_size) {
-        sem_give(efs);
-        ESP_LOGE(ESP_LITTLEFS_TAG, "FD %d must be <%d.", fd, efs->cache_size);
-        errno = EBADF;
-        return -1;
-    }
-    file = efs->cache[fd];
-    res = lfs_file_write(efs->fs, &file->file, data, size);
-#ifdef CONFIG_LITTLEFS_FLUSH_FILE_EVERY_WRITE
-    if(res > 0) {
-        vfs_littlefs_fsync(ctx, fd);
+    res = esp_littlefs_readahead_sync_pos(efs, file);
+    if (res < 0)
+    {
+        return res;
     }
-#endif
-    sem_give(efs);
 
-    if(res < 0){
-        errno = lfs_errno_remap(res);
-#ifndef CONFIG_LITTLEFS_USE_ONLY_HASH
-        ESP_LOGV(ESP_LITTLEFS_TAG, "Failed to write FD %d; path \"%s\". Error %s (%d)",
-                fd, file->path, esp_littlefs_errno(res), res);
+    off_t old_offset = lfs_file_seek(efs->fs, &file->file, 0, SEEK_CUR);
+    if (old_offset < (off_t)0)
+    {
+        return old_offset;
+    }
+
+    /* Set to wanted position.  */
+    res = lfs_file_seek(efs->fs, &file->file, offset, SEEK_SET);
+    if (res < (off_t)0)
+        return res;
+
+    /* Transfer the data.  */
+    if (is_write)
+        res = lfs_file_write(efs->fs, &file->file, buf, size);
+    else
+        res = lfs_file_read(efs->fs, &file->file, buf, size);
+
+    /* Now we have to restore the position.  If this fails we have to
+     return this as an error. But if the transfer also failed we
+     return the transfer error.  */
+    save_res = lfs_file_seek(efs->fs, &file->file, old_offset, SEEK_SET);
+    if (res >= (ssize_t)0 && save_res < (off_t)0)
+    {
+        res = save_res;
+    }
+    return res;
+}
+
+#if CONFIG_LITTLEFS_READAHEAD_MAX > 0 || defined(CONFIG_LITTLEFS_MMAP_PARTITION)
+/* lfs_ctz_index() from lfs.c: CTZ skip-list index of the block holding *off,
+ * and *off becomes the offset within that block */
+static lfs_off_t esp_littlefs_ctz_index(lfs_size_t block_size, lfs_off_t *off) {
+    lfs_off_t size = *off;
+    lfs_off_t b = block_size - 2*4;
+    lfs_off_t i = size / b;
+    if (i == 0) {
+        return 0;
+    }
+
+    i = (size - 4*(lfs_popc(i-1)+2)) / b;
+    *off = size - b*i - 4*lfs_popc(i);
+    return i;
+}
+
+/**
+ * @brief Whether the file's data is all in its committed CTZ blocks, so it
+ *        can be located and read without going through littlefs.
+ */
+static inline bool esp_littlefs_ctz_readable(const lfs_file_t *f) {
+    return !(f->flags & (LFS_F_INLINE | LFS_F_DIRTY | LFS_F_WRITING | LFS_F_ERRED));
+}
+
+/**
+ * @brief Find the block and in-block offset holding byte pos of a file.
+ *
+ * Walks the skip-list like lfs_ctz_find(), but reads the pointers with the
+ * block device callback instead of through the littlefs caches, and checks
+ * every pointer against the block count. The partition callbacks take reads
+ * of any alignment; littlefs_sdmmc_read() does not, so SD cards never get here.
+ *
+ * @return 0, or a negative lfs error (LFS_ERR_CORRUPT for a bad pointer)
+ * @warning This must be called with lock taken, for pos < file size
+ */
+static int esp_littlefs_ctz_locate(esp_littlefs_t *efs, const lfs_file_t *f, lfs_off_t pos,
+                                   lfs_block_t *block, lfs_off_t *off) {
+    const lfs_size_t block_size = efs->cfg.block_size;
+    lfs_off_t current = esp_littlefs_ctz_index(block_size, &(lfs_off_t){f->ctz.size - 1});
+    lfs_off_t target = esp_littlefs_ctz_index(block_size, &pos);
+    lfs_block_t head = f->ctz.head;
+
+    while (current > target) {
+        lfs_size_t skip = lfs_min(lfs_npw2(current-target+1) - 1, lfs_ctz(current));
+        uint32_t next;
+        int err;
+
+        if (head >= efs->fs->block_count) {
+            return LFS_ERR_CORRUPT;
+        }
+        err = efs->cfg.read(&efs->cfg, head, 4*skip, &next, sizeof(next));
+        if (err) {
+            return err;
+        }
+        head = lfs_fromle32(next);
+        current -= 1 << skip;
+    }
+    if (head >= efs->fs->block_count) {
+        return LFS_ERR_CORRUPT;
+    }
+
+    *block = head;
+    *off = pos;
+    return 0;
+}
+#endif
+
+/**
+ * @brief Forget the read-ahead windows of every descriptor open on a file,
+ *        after it was written or truncated through any of them.
+ * @warning This must be called with lock taken
+ */
+static void esp_littlefs_readahead_drop(esp_littlefs_t *efs, uint32_t hash) {
+#if CONFIG_LITTLEFS_READAHEAD_MAX > 0
+    uint32_t slot = esp_littlefs_fd_index_home(efs, hash);
+    int fd;
+    while ((fd = esp_littlefs_fd_index_next(efs, hash, &slot)) >= 0) {
+        efs->cache[fd]->ra_len = 0;
+    }
 #else
-        ESP_LOGV(ESP_LITTLEFS_TAG, "Failed to write FD %d. Error %s (%d)",
-                fd, esp_littlefs_errno(res), res);
+    (void)efs;
+    (void)hash;
 #endif
-        return -1;
+}
+
+/**
+ * @brief A window fill leaves littlefs' position at the end of the window
+ *        rather than at the descriptor's position, so that the next fill
+ *        continues without a seek (and the skip-list walk a seek costs).
+ *        Put it back before anything that uses or reports the position.
+ * @warning This must be called with lock taken
+ */
+static int esp_littlefs_readahead_sync_pos(esp_littlefs_t *efs, vfs_littlefs_file_t *file) {
+#if CONFIG_LITTLEFS_READAHEAD_MAX > 0
+    if (file->ra_pos_ahead) {
+        file->ra_pos_ahead = false;
+        lfs_soff_t res = lfs_file_seek(efs->fs, &file->file, file->ra_fpos, LFS_SEEK_SET);
+        if (res < 0) {
+            return res;
+        }
     }
+#else
+    (void)efs;
+    (void)file;
+#endif
+    return 0;
+}
 
-    return res;
+#if CONFIG_LITTLEFS_READAHEAD_MAX > 0
+#define ESP_LITTLEFS_READAHEAD_MIN MIN(2 * CONFIG_LITTLEFS_CACHE_SIZE, CONFIG_LITTLEFS_READAHEAD_MAX)
+
+/**
+ * @brief lfs_file_read() at an absolute offset; leaves the file position after the data.
+ * @warning This must be called with lock taken
+ */
+static lfs_ssize_t esp_littlefs_read_at(esp_littlefs_t *efs, vfs_littlefs_file_t *file,
+                                        lfs_off_t pos, void *dst, lfs_size_t size) {
+    if ((lfs_off_t)lfs_file_tell(efs->fs, &file->file) != pos) {
+        lfs_soff_t res = lfs_file_seek(efs->fs, &file->file, pos, LFS_SEEK_SET);
+        if (res < 0) {
+            return res;
+        }
+    }
+    return lfs_file_read(efs->fs, &file->file, dst, size);
 }
 
-static ssize_t vfs_littlefs_read(void* ctx, int fd, void * dst, size_t size) {
-    esp_littlefs_t * efs = (esp_littlefs_t *)ctx;
+/**
+ * @brief Fill the read-ahead window from pos.
+ *
+ * For committed data on a flash partition this is a single block device read
+ * of up to the rest of the block, straight into the window; littlefs reads
+ * through its caches in CONFIG_LITTLEFS_CACHE_SIZE pieces. Otherwise (unsynced
+ * writes, inline files, SD cards) the window is filled with lfs_file_read().
+ *
+ * @return bytes in the window, or a negative lfs error
+ * @warning This must be called with lock taken
+ */
+static lfs_ssize_t esp_littlefs_readahead_fill(esp_littlefs_t *efs, vfs_littlefs_file_t *file, lfs_off_t pos) {
+    const lfs_file_t *f = &file->file;
+    lfs_block_t block = 0;
+    lfs_off_t off = 0;
+    int res;
+
+    bool direct = efs->partition != NULL && esp_littlefs_ctz_readable(f);
+#ifdef CONFIG_LITTLEFS_SDMMC_SUPPORT
+    direct = direct && efs->sdcard == NULL;
+#endif
+    if (!direct) {
+        return esp_littlefs_read_at(efs, file, pos, file->ra_buf, file->ra_window);
+    }
+    if (pos >= f->ctz.size) {
+        return 0;
+    }
+
+    res = esp_littlefs_ctz_locate(efs, f, pos, &block, &off);
+    if (res < 0) {
+        return res;
+    }
+    lfs_size_t n = MIN(file->ra_window, efs->cfg.block_size - off);
+    n = MIN(n, f->ctz.size - pos);
+    res = efs->cfg.read(&efs->cfg, block, off, file->ra_buf, n);
+    return res < 0 ? res : (lfs_ssize_t)n;
+}
+
+/**
+ * @brief Read at pos through the descriptor's read-ahead window.
+ *
+ * A read that starts where the previous one ended is sequential: any part of
+ * it already in the window is copied out, and the rest is fetched as one
+ * window fill, the window doubling each time.
+ * Requests at least as large as the window, and non-sequential reads (which
+ * also reset the window), go straight to littlefs.
+ *
+ * @return bytes read, or a negative lfs error if nothing was read.
+ *         The file position is left unspecified.
+ * @warning This must be called with lock taken
+ */
+static lfs_ssize_t esp_littlefs_readahead(esp_littlefs_t *efs, vfs_littlefs_file_t *file,
+                                          lfs_off_t pos, uint8_t *dst, lfs_size_t size) {
+    const bool sequential = pos == file->ra_next;
+    lfs_size_t done = 0;
+    lfs_ssize_t res;
+
+    if (file->ra_len && pos >= file->ra_pos && pos - file->ra_pos < file->ra_len) {
+        done = MIN(size, file->ra_len - (pos - file->ra_pos));
+        memcpy(dst, file->ra_buf + (pos - file->ra_pos), done);
+        efs->read_stats.readahead_bytes += done;
+    }
+
+    if (done < size) {
+        if (!sequential) {
+            file->ra_window = 0;
+            file->ra_len = 0;
+        } else if (file->ra_window == 0) {
+            file->ra_window = ESP_LITTLEFS_READAHEAD_MIN;
+        } else {
+            file->ra_window = MIN(2 * file->ra_window, CONFIG_LITTLEFS_READAHEAD_MAX);
+        }
+
+        if (size - done < file->ra_window && file->ra_cap < file->ra_window) {
+            uint8_t *buf = realloc(file->ra_buf, file->ra_window);
+            if (buf) {
+                file->ra_buf = buf;
+                file->ra_cap = file->ra_window;
+            }
+        }
+    }
+
+    /* A fill stops at the end of a flash block, so a read can take two */
+    while (done < size) {
+        lfs_off_t at = pos + done;
+        lfs_size_t want = size - done;
+
+        if (want >= file->ra_window || file->ra_cap < file->ra_window) {
+            /* Large or random request, or no memory for the window */
+            res = esp_littlefs_read_at(efs, file, at, dst + done, want);
+            if (res < 0) {
+                return done ? (lfs_ssize_t)done : res;
+            }
+            done += res;
+            break;
+        }
+
+        res = esp_littlefs_readahead_fill(efs, file, at);
+        if (res <= 0) {
+            file->ra_len = 0;
+            if (res < 0) {
+                return done ? (lfs_ssize_t)done : res;
+            }
+            break;  // end of file
+        }
+        file->ra_pos = at;
+        file->ra_len = res;
+        lfs_size_t n = MIN(want, (lfs_size_t)res);
+        memcpy(dst + done, file->ra_buf, n);
+        efs->read_stats.readahead_bytes += n;
+        done += n;
+    }
+
+    file->ra_next = pos + done;
+    return done;
+}
+#endif // CONFIG_LITTLEFS_READAHEAD_MAX > 0
+
+/**
+ * @brief read()/pread() for one chunk.
+ * @param[in] offset  absolute offset (pread, position kept), or -1 to read at
+ *                    and advance the file position
+ * @warning This must be called with lock taken
+ */
+static ssize_t esp_littlefs_read_locked(esp_littlefs_t *efs, vfs_littlefs_file_t *file,
+                                        void *dst, size_t size, off_t offset) {
     ssize_t res;
-    vfs_littlefs_file_t *file = NULL;
+#if CONFIG_LITTLEFS_READAHEAD_MAX > 0
+    lfs_soff_t cur = file->ra_pos_ahead ? (lfs_soff_t)file->ra_fpos : lfs_file_tell(efs->fs, &file->file);
+    if (cur < 0) {
+        return cur;
+    }
+    lfs_off_t pos = offset >= 0 ? (lfs_off_t)offset : (lfs_off_t)cur;
 
-    sem_take(efs);
-    if((uint32_t)fd > efs->cache_size) {
-        sem_give(efs);
-        ESP_LOGE(ESP_LITTLEFS_TAG, "FD %d must be <%d.", fd, efs->cache_size);
-        errno = EBADF;
-        return -1;
+    res = esp_littlefs_readahead(efs, file, pos, dst, size);
+
+    /* pread keeps the position, read moves it past the data; littlefs'
+     * own position is only corrected when something needs it */
+    lfs_off_t fpos = (offset >= 0 || res < 0) ? (lfs_off_t)cur : pos + res;
+    file->ra_pos_ahead = (lfs_off_t)lfs_file_tell(efs->fs, &file->file) != fpos;
+    file->ra_fpos = fpos;
+#else
+    if (offset >= 0) {
+        res = esp_littlefs_positional_io(efs, file, dst, size, offset, false);
+    } else {
+        res = lfs_file_read(efs->fs, &file->file, dst, size);
     }
-    file = efs->cache[fd];
-    res = lfs_file_read(efs->fs, &file->file, dst, size);
-    sem_give(efs);
+#endif
+    if (res > 0) {
+        efs->read_stats.bytes_read += res;
+    }
+    return res;
+}
 
-    if(res < 0){
-        errno = lfs_errno_remap(res);
+#ifdef CONFIG_LITTLEFS_WRITE_BEHIND
+/* Task notification bits */
+#define ESP_LITTLEFS_WB_STAGED 0x1  /*!< write() staged the first bytes of an empty half */
+#define ESP_LITTLEFS_WB_COMMIT 0x2  /*!< Commit now: enough is staged, a half is full, or stop */
+
+/* Runs start pointer-aligned in their half */
+#define ESP_LITTLEFS_WB_ALIGN(x) (((x) + sizeof(void *) - 1) & ~(uint32_t)(sizeof(void *) - 1))
+
+/**
+ * @brief The pending error of a staged write on file, or 0
+ * @param[in] take  clear it: it is reported now
+ */
+static int esp_littlefs_writebehind_err(esp_littlefs_t *efs, vfs_littlefs_file_t *file, bool take) {
+    int err;
+
+    if (!efs->wb.lock) {
+        return 0;
+    }
+    xSemaphoreTake(efs->wb.lock, portMAX_DELAY);
+    err = file->wb_err;
+    if (take) {
+        file->wb_err = 0;
+    }
+    xSemaphoreGive(efs->wb.lock);
+    return err;
+}
+
+/**
+ * @brief write() without the FS lock: append the data to the fill half,
+ *        merged into the newest run if that is for the same descriptor.
+ * @return size once staged; 0 if the write has to go through littlefs now
+ *         (no task, not a writable file, too large, or the half is full);
+ *         the error of an earlier staged write on this descriptor.
+ */
+static ssize_t esp_littlefs_writebehind_stage(esp_littlefs_t *efs, int fd, const void *data, size_t size) {
+    esp_littlefs_writebehind_t *wb = &efs->wb;
+    vfs_littlefs_file_t *file;
+    esp_littlefs_wb_run_t *run = NULL;
+    uint32_t notify = 0;
+    ssize_t res = 0;
+
+    if (!wb->task || size == 0) {
+        return 0;
+    }
+
+    xSemaphoreTake(wb->lock, portMAX_DELAY);
+    file = (uint32_t)fd < efs->cache_size ? efs->cache[fd] : NULL;
+    if (!file || file->closing || !file->wb_writable) {
+        /* Let the usual path report it */
+        goto exit;
+    }
+    if (file->wb_err) {
+        res = file->wb_err;
+        file->wb_err = 0;
+        goto exit;
+    }
+
+    uint8_t *half = wb->buf + wb->fill * ESP_LITTLEFS_WB_HALF;
+    uint32_t start = wb->used;
+    if (wb->last_run != ESP_LITTLEFS_WB_NO_RUN) {
+        run = (esp_littlefs_wb_run_t *)(half + wb->last_run);
+        if (run->file != file) {
+            run = NULL;
+        }
+    }
+    if (!run) {
+        start = ESP_LITTLEFS_WB_ALIGN(wb->used) + sizeof(*run);
+    }
+    if (size > ESP_LITTLEFS_WB_HALF || start > ESP_LITTLEFS_WB_HALF - size) {
+        if (wb->used > 0) {
+            notify = ESP_LITTLEFS_WB_COMMIT;
+        }
+        goto exit;
+    }
+
+    if (!run) {
+        wb->last_run = start - sizeof(*run);
+        run = (esp_littlefs_wb_run_t *)(half + wb->last_run);
+        run->file = file;
+        run->len = 0;
+        run->writes = 0;
+    }
+    /* The newest run's data always ends at used, so merging is appending */
+    memcpy(half + start, data, size);
+    run->len += size;
+    run->writes++;
+    if (wb->used == 0) {
+        notify |= ESP_LITTLEFS_WB_STAGED;
+    }
+    wb->used = start + size;
+    if (wb->used >= CONFIG_LITTLEFS_WRITE_BEHIND_COMMIT_BYTES) {
+        notify |= ESP_LITTLEFS_WB_COMMIT;
+    }
+    res = size;
+
+exit:
+    xSemaphoreGive(wb->lock);
+    if (notify) {
+        xTaskNotify(wb->task, notify, eSetBits);
+    }
+    return res;
+}
+#endif // CONFIG_LITTLEFS_WRITE_BEHIND
+
+/**
+ * @brief Write every staged run to littlefs, in the order write() staged
+ *        them, before anything that could tell: a read, seek, stat, sync or
+ *        close on any descriptor, or a write that is not deferred.
+ *
+ * A run for a descriptor with a pending error is dropped, so the data after
+ * a failed write does not land behind a hole.
+ * @warning This must be called with lock taken
+ */
+static void esp_littlefs_writebehind_drain(esp_littlefs_t *efs) {
+#ifdef CONFIG_LITTLEFS_WRITE_BEHIND
+    esp_littlefs_writebehind_t *wb = &efs->wb;
+    uint8_t *half;
+    uint32_t used;
+
+    if (!wb->lock) {
+        return;
+    }
+    /* Switch halves; the previous one is untouched by write() until the
+     * next switch, which can only happen after this returns */
+    xSemaphoreTake(wb->lock, portMAX_DELAY);
+    half = wb->buf + wb->fill * ESP_LITTLEFS_WB_HALF;
+    used = wb->used;
+    if (used > 0) {
+        wb->fill ^= 1;
+        wb->used = 0;
+        wb->last_run = ESP_LITTLEFS_WB_NO_RUN;
+    }
+    xSemaphoreGive(wb->lock);
+
+    for (uint32_t off = 0; off < used;) {
+        esp_littlefs_wb_run_t *run = (esp_littlefs_wb_run_t *)(half + off);
+        vfs_littlefs_file_t *file = run->file;
+
+        off = ESP_LITTLEFS_WB_ALIGN(off + sizeof(*run) + run->len);
+        if (esp_littlefs_writebehind_err(efs, file, false)) {
+            continue;
+        }
+
+        lfs_ssize_t res = esp_littlefs_readahead_sync_pos(efs, file);
+        if (res == 0) {
+            res = lfs_file_write(efs->fs, &file->file, run + 1, run->len);
+        }
+        esp_littlefs_readahead_drop(efs, file->hash);
+        file->wb_dirty = true;
+        efs->write_stats.writes_deferred += run->writes;
+        if (res >= 0 && (lfs_size_t)res < run->len) {
+            res = LFS_ERR_NOSPC;
+        }
+        if (res < 0) {
 #ifndef CONFIG_LITTLEFS_USE_ONLY_HASH
-        ESP_LOGV(ESP_LITTLEFS_TAG, "Failed to read file \"%s\". Error %s (%d)",
-                file->path, esp_littlefs_errno(res), res);
+            ESP_LOGW(ESP_LITTLEFS_TAG, "Staged write to \"%s\" failed. Error %s (%d)",
+                    file->path, esp_littlefs_errno(res), (int)res);
 #else
-        ESP_LOGV(ESP_LITTLEFS_TAG, "Failed to read FD %d. Error %s (%d)",
-                fd, esp_littlefs_errno(res), res);
+            ESP_LOGW(ESP_LITTLEFS_TAG, "Staged write failed. Error %s (%d)",
+                    esp_littlefs_errno(res), (int)res);
 #endif
-        return -1;
+            xSemaphoreTake(wb->lock, portMAX_DELAY);
+            file->wb_err = res;
+            xSemaphoreGive(wb->lock);
+        }
     }
+#else
+    (void)efs;
+#endif
+}
 
-    return res;
+#ifdef CONFIG_LITTLEFS_WRITE_BEHIND
+/**
+ * @brief Write out the staged runs and commit every file they went to with
+ *        one lfs_file_sync() each.
+ * @warning This must be called with lock taken
+ */
+static void esp_littlefs_writebehind_commit(esp_littlefs_t *efs) {
+    esp_littlefs_writebehind_drain(efs);
+    for (uint16_t i = 0; i < efs->cache_size; i++) {
+        vfs_littlefs_file_t *file = efs->cache[i];
+
+        if (!file || !file->wb_dirty) {
+            continue;
+        }
+        file->wb_dirty = false;
+        int res = esp_littlefs_file_sync(efs, file);
+        efs->write_stats.deferred_commits++;
+        if (res < 0) {
+            xSemaphoreTake(efs->wb.lock, portMAX_DELAY);
+            if (!file->wb_err) {
+                file->wb_err = res;
+            }
+            xSemaphoreGive(efs->wb.lock);
+        }
+    }
 }
 
-static ssize_t vfs_littlefs_pwrite(void *ctx, int fd, const void *src, size_t size, off_t offset)
-{
-    esp_littlefs_t *efs = (esp_littlefs_t *)ctx;
-    ssize_t res, save_res;
-    vfs_littlefs_file_t *file = NULL;
+/**
+ * @brief Commits at most CONFIG_LITTLEFS_WRITE_BEHIND_COMMIT_MS after the
+ *        first write staged since the last commit, sooner when write() asks.
+ */
+static void esp_littlefs_writebehind_task(void *arg) {
+    esp_littlefs_t *efs = arg;
+    esp_littlefs_writebehind_t *wb = &efs->wb;
+    const TickType_t period = pdMS_TO_TICKS(CONFIG_LITTLEFS_WRITE_BEHIND_COMMIT_MS);
+    TickType_t first = 0;
+    bool armed = false;
+
+    while (!wb->stop) {
+        TickType_t wait = portMAX_DELAY;
+        uint32_t events = 0;
+
+        if (armed) {
+            TickType_t age = xTaskGetTickCount() - first;
+            wait = age < period ? period - age : 0;
+        }
+        xTaskNotifyWait(0, UINT32_MAX, &events, wait);
+        if ((events & ESP_LITTLEFS_WB_STAGED) && !armed) {
+            armed = true;
+            first = xTaskGetTickCount();
+        }
+        if (!armed || wb->stop) {
+            continue;
+        }
+        if (!(events & ESP_LITTLEFS_WB_COMMIT) && xTaskGetTickCount() - first < period) {
+            continue;
+        }
 
-    sem_take(efs);
-    if ((uint32_t)fd > efs->cache_size)
-    {
+        /* Writes staged from here on notify again and start a new period */
+        armed = false;
+        sem_take(efs);
+        esp_littlefs_writebehind_commit(efs);
         sem_give(efs);
-        ESP_LOGE(ESP_LITTLEFS_TAG, "FD %d must be <%d.", fd, efs->cache_size);
-        errno = EBADF;
-        return -1;
     }
-    file = efs->cache[fd];
 
-    off_t old_offset = lfs_file_seek(efs->fs, &file->file, 0, SEEK_CUR);
-    if (old_offset < (off_t)0)
-    {
-        res = old_offset;
-        goto exit;
+    xSemaphoreGive(wb->exited);
+    vTaskDelete(NULL);
+}
+
+static esp_err_t esp_littlefs_writebehind_start(esp_littlefs_t *efs) {
+    esp_littlefs_writebehind_t *wb = &efs->wb;
+
+    if (wb->task || efs->read_only) {
+        return ESP_OK;
     }
 
-    /* Set to wanted position.  */
-    res = lfs_file_seek(efs->fs, &file->file, offset, SEEK_SET);
-    if (res < (off_t)0)
-        goto exit;
+    memset(wb, 0, sizeof(*wb));
+    wb->buf = esp_littlefs_calloc(2, ESP_LITTLEFS_WB_HALF);
+    if (!wb->buf) {
+        return ESP_ERR_NO_MEM;
+    }
+    wb->last_run = ESP_LITTLEFS_WB_NO_RUN;
+    wb->lock = xSemaphoreCreateMutexStatic(&wb->lock_buffer);
+    wb->exited = xSemaphoreCreateBinaryStatic(&wb->exited_buffer);
+    /* write() only stages once task is set */
+    if (xTaskCreate(esp_littlefs_writebehind_task, "lfs_wbehind", 3072, efs,
+                CONFIG_LITTLEFS_WRITE_BEHIND_TASK_PRIORITY, &wb->task) != pdPASS) {
+        vSemaphoreDelete(wb->lock);
+        vSemaphoreDelete(wb->exited);
+        free(wb->buf);
+        memset(wb, 0, sizeof(*wb));
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
 
-    /* Write out the data.  */
-    res = lfs_file_write(efs->fs, &file->file, src, size);
+/**
+ * @param[in] commit  write out and commit what is staged; otherwise drop it
+ */
+static void esp_littlefs_writebehind_stop(esp_littlefs_t *efs, bool commit) {
+    esp_littlefs_writebehind_t *wb = &efs->wb;
 
-    /* Now we have to restore the position.  If this fails we have to
-     return this as an error. But if the writing also failed we
-     return writing error.  */
-    save_res = lfs_file_seek(efs->fs, &file->file, old_offset, SEEK_SET);
-    if (res >= (ssize_t)0 && save_res < (off_t)0)
-    {
-        res = save_res;
+    if (!wb->task) {
+        return;
+    }
+    wb->stop = true;
+    xTaskNotify(wb->task, ESP_LITTLEFS_WB_COMMIT, eSetBits);
+    xSemaphoreTake(wb->exited, portMAX_DELAY);
+
+    sem_take(efs);
+    if (commit) {
+        esp_littlefs_writebehind_commit(efs);
     }
+    vSemaphoreDelete(wb->lock);
+    vSemaphoreDelete(wb->exited);
+    free(wb->buf);
+    memset(wb, 0, sizeof(*wb));
     sem_give(efs);
+}
+#endif // CONFIG_LITTLEFS_WRITE_BEHIND
 
-exit:
-    if (res < 0)
-    {
-        errno = lfs_errno_remap(res);
+/**
+ * @brief Shared body of read/write/pread/pwrite.
+ *
+ * The transfer is split into CONFIG_LITTLEFS_IO_CHUNK_SIZE pieces and the FS
+ * lock is only held for one piece at a time, so a long read of one file does
+ * not stall stat() or an append from another task for the whole transfer.
+ * The descriptor is pinned so close() waits for it, and its own lock keeps
+ * the call atomic against other reads and writes on the same descriptor.
+ * With CONFIG_LITTLEFS_WRITE_BEHIND a write() is staged instead when it can
+ * be, and everything staged is written out before any other transfer.
+ *
+ * @param[in] offset  absolute offset (pread/pwrite), or -1 for the file position
+ * @return bytes transferred; a negative lfs error only if nothing was transferred
+ */
+static ssize_t esp_littlefs_file_io(esp_littlefs_t *efs, int fd, void *buf, size_t size,
+                                    off_t offset, bool is_write)
+{
+    vfs_littlefs_file_t *file;
+    size_t done = 0;
+    ssize_t res;
+
+#ifdef CONFIG_LITTLEFS_WRITE_BEHIND
+    if (is_write && offset < 0) {
+        res = esp_littlefs_writebehind_stage(efs, fd, buf, size);
+        if (res != 0) {
+            return res;
+        }
+    }
+#endif
+
+    sem_take(efs);
+    file = esp_littlefs_pin_fd(efs, fd);
+    sem_give(efs);
+    if (!file) {
+        ESP_LOGE(ESP_LITTLEFS_TAG, "FD %d is not open.", fd);
+        return LFS_ERR_BADF;
+    }
+
+    file_lock(file);
+    do {
+        size_t chunk = size - done;
+#if CONFIG_LITTLEFS_IO_CHUNK_SIZE > 0
+        chunk = MIN(chunk, (size_t)CONFIG_LITTLEFS_IO_CHUNK_SIZE);
+#endif
+        uint8_t *ptr = (uint8_t *)buf + done;
+
+        sem_take(efs);
+        esp_littlefs_writebehind_drain(efs);
+        if (!is_write) {
+            res = esp_littlefs_read_locked(efs, file, ptr, chunk, offset >= 0 ? offset + (off_t)done : -1);
+        } else {
+            if (offset >= 0) {
+                res = esp_littlefs_positional_io(efs, file, ptr, chunk, offset + (off_t)done, true);
+            } else {
+                res = esp_littlefs_readahead_sync_pos(efs, file);
+                if (res == 0) {
+                    res = lfs_file_write(efs->fs, &file->file, ptr, chunk);
+                }
+            }
+            esp_littlefs_readahead_drop(efs, file->hash);
+        }
+        sem_give(efs);
+
+        if (res <= 0) {
+            break;
+        }
+        done += res;
+        if ((size_t)res < chunk) {
+            break;  // end of file
+        }
+    } while (done < size);
+
+#ifdef CONFIG_LITTLEFS_FLUSH_FILE_EVERY_WRITE
+    if (is_write && offset < 0 && done > 0) {
+        sem_take(efs);
+        esp_littlefs_file_sync(efs, file);
+        sem_give(efs);
+    }
+#endif
+    file_unlock(file);
+
+    if (done == 0 && res < 0) {
 #ifndef CONFIG_LITTLEFS_USE_ONLY_HASH
-        ESP_LOGV(ESP_LITTLEFS_TAG, "Failed to write FD %d; path \"%s\". Error %s (%d)",
-                fd, file->path, esp_littlefs_errno(res), res);
+        ESP_LOGV(ESP_LITTLEFS_TAG, "Failed to %s FD %d; path \"%s\". Error %s (%d)",
+                is_write ? "write" : "read", fd, file->path, esp_littlefs_errno(res), res);
 #else
-        ESP_LOGV(ESP_LITTLEFS_TAG, "Failed to write FD %d. Error %s (%d)",
-                fd, esp_littlefs_errno(res), res);
+        ESP_LOGV(ESP_LITTLEFS_TAG, "Failed to %s FD %d. Error %s (%d)",
+                is_write ? "write" : "read", fd, esp_littlefs_errno(res), res);
 #endif
+    }
+
+    sem_take(efs);
+    esp_littlefs_unpin_fd(file);
+    sem_give(efs);
+
+    return done > 0 ? (ssize_t)done : res;
+}
+
+static ssize_t vfs_littlefs_write(void* ctx, int fd, const void * data, size_t size) {
+    esp_littlefs_t * efs = (esp_littlefs_t *)ctx;
+    ssize_t res = esp_littlefs_file_io(efs, fd, (void *)data, size, -1, true);
+
+    if(res < 0){
+        errno = lfs_errno_remap(res);
         return -1;
     }
+    return res;
+}
 
+static ssize_t vfs_littlefs_read(void* ctx, int fd, void * dst, size_t size) {
+    esp_littlefs_t * efs = (esp_littlefs_t *)ctx;
+    ssize_t res = esp_littlefs_file_io(efs, fd, dst, size, -1, false);
+
+    if(res < 0){
+        errno = lfs_errno_remap(res);
+        return -1;
+    }
     return res;
 }
 
-static ssize_t vfs_littlefs_pread(void *ctx, int fd, void *dst, size_t size, off_t offset)
+static ssize_t vfs_littlefs_pwrite(void *ctx, int fd, const void *src, size_t size, off_t offset)
 {
     esp_littlefs_t *efs = (esp_littlefs_t *)ctx;
-    ssize_t res, save_res;
-    vfs_littlefs_file_t *file = NULL;
+    ssize_t res;
 
-    sem_take(efs);
-    if ((uint32_t)fd > efs->cache_size)
-    {
-        sem_give(efs);
-        ESP_LOGE(ESP_LITTLEFS_TAG, "FD %d must be <%d.", fd, efs->cache_size);
-        errno = EBADF;
+    if (offset < 0) {
+        errno = EINVAL;
         return -1;
     }
-    file = efs->cache[fd];
-
-    off_t old_offset = lfs_file_seek(efs->fs, &file->file, 0, SEEK_CUR);
-    if (old_offset < (off_t)0)
+    res = esp_littlefs_file_io(efs, fd, (void *)src, size, offset, true);
+    if (res < 0)
     {
-        res = old_offset;
-        goto exit;
+        errno = lfs_errno_remap(res);
+        return -1;
     }
+    return res;
+}
 
-    /* Set to wanted position.  */
-    res = lfs_file_seek(efs->fs, &file->file, offset, SEEK_SET);
-    if (res < (off_t)0)
-        goto exit;
-
-    /* Read the data.  */
-    res = lfs_file_read(efs->fs, &file->file, dst, size);
+static ssize_t vfs_littlefs_pread(void *ctx, int fd, void *dst, size_t size, off_t offset)
+{
+    esp_littlefs_t *efs = (esp_littlefs_t *)ctx;
+    ssize_t res;
 
-    /* Now we have to restore the position.  If this fails we have to
-     return this as an error. But if the reading also failed we
-     return reading error.  */
-    save_res = lfs_file_seek(efs->fs, &file->file, old_offset, SEEK_SET);
-    if (res >= (ssize_t)0 && save_res < (off_t)0)
-    {
-        res = save_res;
+    if (offset < 0) {
+        errno = EINVAL;
+        return -1;
     }
-    sem_give(efs);
-
-exit:
+    res = esp_littlefs_file_io(efs, fd, dst, size, offset, false);
     if (res < 0)
     {
         errno = lfs_errno_remap(res);
-#ifndef CONFIG_LITTLEFS_USE_ONLY_HASH
-        ESP_LOGV(ESP_LITTLEFS_TAG, "Failed to read file \"%s\". Error %s (%d)",
-                 file->path, esp_littlefs_errno(res), res);
-#else
-        ESP_LOGV(ESP_LITTLEFS_TAG, "Failed to read FD %d. Error %s (%d)",
-                 fd, esp_littlefs_errno(res), res);
-#endif
         return -1;
     }
-
     return res;
 }
 
@@ -1769,15 +2751,20 @@ static int vfs_littlefs_close(void* ctx, int fd) {
     vfs_littlefs_file_t *file = NULL;
 
     sem_take(efs);
-    if((uint32_t)fd > efs->cache_size) {
+    if((uint32_t)fd >= efs->cache_size || efs->cache[fd] == NULL || efs->cache[fd]->closing) {
         sem_give(efs);
-        ESP_LOGE(ESP_LITTLEFS_TAG, "FD %d must be <%d.", fd, efs->cache_size);
+        ESP_LOGE(ESP_LITTLEFS_TAG, "FD %d is not open.", fd);
         errno = EBADF;
         return -1;
     }
 
     file = efs->cache[fd];
 
+    /* Let reads and writes that released the lock between chunks finish;
+     * closing stops new ones from starting on this descriptor. */
+    esp_littlefs_wait_unpinned(efs, file);
+    esp_littlefs_writebehind_drain(efs);
+
 #if CONFIG_LITTLEFS_OPEN_DIR
     if ((file->file.flags & O_DIRECTORY) == 0) {
 #endif
@@ -1787,6 +2774,9 @@ static int vfs_littlefs_close(void* ctx, int fd) {
     res = lfs_file_close(efs->fs, &file->file);
     if(res < 0){
         errno = lfs_errno_remap(res);
+        wb_lock(efs);
+        file->closing = false;
+        wb_unlock(efs);
         sem_give(efs);
 #ifndef CONFIG_LITTLEFS_USE_ONLY_HASH
         ESP_LOGV(ESP_LITTLEFS_TAG, "Failed to close file \"%s\". Error %s (%d)",
@@ -1803,6 +2793,14 @@ static int vfs_littlefs_close(void* ctx, int fd) {
         res = 0;
     }
 #endif
+#ifdef CONFIG_LITTLEFS_WRITE_BEHIND
+    /* The file is closed either way; a failed staged write is still news */
+    int wb_res = esp_littlefs_writebehind_err(efs, file, true);
+    if (wb_res < 0) {
+        errno = lfs_errno_remap(wb_res);
+        res = -1;
+    }
+#endif
 
     esp_littlefs_free_fd(efs, fd);
     sem_give(efs);
@@ -1833,7 +2831,11 @@ static off_t vfs_littlefs_lseek(void* ctx, int fd, off_t offset, int mode) {
         return -1;
     }
     file = efs->cache[fd];
-    res = lfs_file_seek(efs->fs, &file->file, offset, whence);
+    esp_littlefs_writebehind_drain(efs);
+    res = esp_littlefs_readahead_sync_pos(efs, file);
+    if (res == 0) {
+        res = lfs_file_seek(efs->fs, &file->file, offset, whence);
+    }
     sem_give(efs);
 
     if(res < 0){
@@ -1866,7 +2868,17 @@ static int vfs_littlefs_fsync(void* ctx, int fd)
         return -1;
     }
     file = efs->cache[fd];
+    esp_littlefs_writebehind_drain(efs);
     res = esp_littlefs_file_sync(efs, file);
+#ifdef CONFIG_LITTLEFS_WRITE_BEHIND
+    file->wb_dirty = false;
+    if (res >= 0) {
+        int wb_res = esp_littlefs_writebehind_err(efs, file, true);
+        if (wb_res < 0) {
+            res = wb_res;
+        }
+    }
+#endif
     sem_give(efs);
 
     if(res < 0){
@@ -1901,6 +2913,7 @@ static int vfs_littlefs_fstat(void* ctx, int fd, struct stat * st) {
         return -1;
     }
     file = efs->cache[fd];
+    esp_littlefs_writebehind_drain(efs);
     res = lfs_stat(efs->fs, file->path, &info);
     if (res < 0) {
         errno = lfs_errno_remap(res);
@@ -2291,7 +3304,9 @@ static ssize_t vfs_littlefs_truncate( void *ctx, const char *path, off_t size )
         return -1;
     }
     file = efs->cache[fd];
+    esp_littlefs_writebehind_drain(efs);
     res = lfs_file_truncate( efs->fs, &file->file, size );
+    esp_littlefs_readahead_drop(efs, file->hash);
     sem_give(efs);
 
     if(res < 0)
@@ -2329,7 +3344,12 @@ static int vfs_littlefs_ftruncate(void *ctx, int fd, off_t size)
         return -1;
     }
     file = efs->cache[fd];
-    res = lfs_file_truncate( efs->fs, &file->file, size );
+    esp_littlefs_writebehind_drain(efs);
+    res = esp_littlefs_readahead_sync_pos(efs, file);
+    if (res == 0) {
+        res = lfs_file_truncate( efs->fs, &file->file, size );
+    }
+    esp_littlefs_readahead_drop(efs, file->hash);
     sem_give(efs);
 
     if(res < 0)
@@ -2513,6 +3533,43 @@ static void rmdirs(esp_littlefs_t * efs, const char *dir) {
 
 #endif  // CONFIG_LITTLEFS_SPIFFS_COMPAT
 
+#ifdef CONFIG_LITTLEFS_MMAP_PARTITION
+/**
+ * @brief Resolve a file offset to its bytes in the partition mapping.
+ * @return 0 on success; LFS_ERR_INVAL if the file cannot be mapped (the caller
+ *         falls back to pread()); LFS_ERR_CORRUPT for a bad block pointer.
+ * @warning This must be called with lock taken
+ */
+static int esp_littlefs_map_locked(esp_littlefs_t *efs, vfs_littlefs_file_t *file, esp_littlefs_map_req_t *req) {
+    const lfs_file_t *f = &file->file;
+    lfs_block_t block = 0;
+    lfs_off_t off = 0;
+    int res;
+
+    if (!efs->mmap_data || !esp_littlefs_ctz_readable(f)) {
+        return LFS_ERR_INVAL;
+    }
+
+    req->data = NULL;
+    req->len = 0;
+    if (req->size == 0 || (lfs_size_t)req->offset >= f->ctz.size) {
+        return 0;
+    }
+
+    res = esp_littlefs_ctz_locate(efs, f, req->offset, &block, &off);
+    if (res < 0) {
+        return res;
+    }
+
+    size_t len = efs->cfg.block_size - off;
+    len = MIN(len, (size_t)(f->ctz.size - req->offset));
+    len = MIN(len, req->size);
+    req->data = (const uint8_t *)efs->mmap_data + block * efs->cfg.block_size + off;
+    req->len = len;
+    return 0;
+}
+#endif
+
 static int vfs_littlefs_fcntl(void* ctx, int fd, int cmd, int arg)
 {
     int result = 0;
@@ -2560,6 +3617,21 @@ static int vfs_littlefs_fcntl(void* ctx, int fd, int cmd, int arg)
             errno = EINVAL;
         }
     }
+#endif
+#ifdef CONFIG_LITTLEFS_MMAP_PARTITION
+    else if (cmd == ESP_LITTLEFS_F_MAP) {
+        esp_littlefs_map_req_t *req = (esp_littlefs_map_req_t *)(uintptr_t)arg;
+        int res;
+
+        assert(req);
+
+        esp_littlefs_writebehind_drain(efs);
+        res = esp_littlefs_map_locked(efs, file, req);
+        if (res < 0) {
+            result = -1;
+            errno = res == LFS_ERR_INVAL ? ENOTSUP : lfs_errno_remap(res);
+        }
+    }
 #endif
     else {
         result = -1;
@@ -1,6 +1,7 @@
 #ifndef ESP_LITTLEFS_API_H__
 #define ESP_LITTLEFS_API_H__
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <stddef.h>
 #include "freertos/FreeRTOS.h"
@@ -9,6 +10,7 @@
 #include "esp_vfs.h"
 #include "esp_partition.h"
 #include "littlefs/lfs.h"
+#include "esp_littlefs.h"
 #include "sdkconfig.h"
 
 #ifdef CONFIG_LITTLEFS_SDMMC_SUPPORT
@@ -27,7 +29,8 @@ extern "C" {
 
 /**
  * @brief a file descriptor
- * That's also a singly linked list used for keeping tracks of all opened file descriptor 
+ * Open descriptors are found by index in esp_littlefs_t::cache and by path
+ * hash through esp_littlefs_t::fd_index.
  *
  * Shortcomings/potential issues of 32-bit hash (when CONFIG_LITTLEFS_USE_ONLY_HASH) listed here:
  *     * unlink - If a different file is open that generates a hash collision, it will report an
@@ -53,12 +56,89 @@ typedef struct _vfs_littlefs_file_t {
 #endif
 
     uint32_t hash;
-    struct _vfs_littlefs_file_t * next;       /*!< Pointer to next file in Singly Linked List */
+    uint16_t users;                           /*!< Calls using this descriptor while the FS lock is released */
+    bool     closing;                         /*!< close() is waiting for users to drain */
+    SemaphoreHandle_t drained;                /*!< Given when users drops to 0; owned by the waiting closer */
+#if CONFIG_LITTLEFS_IO_CHUNK_SIZE > 0
+    SemaphoreHandle_t lock;                   /*!< Keeps a chunked read/write atomic on this descriptor */
+    StaticSemaphore_t lock_buffer;
+#endif
+#if CONFIG_LITTLEFS_READAHEAD_MAX > 0
+    uint8_t  * ra_buf;                        /*!< Read-ahead window, allocated on the first sequential read */
+    uint32_t   ra_cap;                        /*!< Allocated size of ra_buf */
+    uint32_t   ra_window;                     /*!< Current window size, grows while reads stay sequential */
+    uint32_t   ra_pos;                        /*!< File offset of ra_buf[0] */
+    uint32_t   ra_len;                        /*!< Valid bytes in ra_buf; 0 when empty */
+    uint32_t   ra_next;                       /*!< Offset a sequential read would start at */
+    uint32_t   ra_fpos;                       /*!< Descriptor position while ra_pos_ahead */
+    bool       ra_pos_ahead;                  /*!< littlefs' position was left at the end of a window fill */
+#endif
+#ifdef CONFIG_LITTLEFS_WRITE_BEHIND
+    bool       wb_writable;                   /*!< A regular file open for writing; write() may stage */
+    int        wb_err;                        /*!< First error of a staged write, reported once */
+    bool       wb_dirty;                      /*!< Staged writes reached littlefs and are not committed */
+#endif
 #ifndef CONFIG_LITTLEFS_USE_ONLY_HASH
     char     * path;
 #endif
 } vfs_littlefs_file_t;
 
+#ifdef CONFIG_LITTLEFS_PREERASE
+#define ESP_LITTLEFS_BLOCK_NONE ((lfs_block_t)-1)
+
+/**
+ * @brief State of the background pre-erase task of a partition
+ */
+typedef struct {
+    TaskHandle_t task;                        /*!< Pre-erase task; NULL when not running */
+    uint32_t *erased;                         /*!< Bitmap of blocks erased and not programmed since */
+    lfs_block_t block_count;                  /*!< Blocks covered by erased */
+    lfs_block_t erasing;                      /*!< Block being erased with the FS lock released */
+    esp_err_t erase_err;                      /*!< Result of the erase of erasing */
+    SemaphoreHandle_t erase_lock;             /*!< Held by the task for the duration of that erase */
+    StaticSemaphore_t erase_lock_buffer;
+    SemaphoreHandle_t exited;                 /*!< Given by the task when it stops */
+    StaticSemaphore_t exited_buffer;
+    TickType_t last_io;                       /*!< Tick of the last block device call by littlefs */
+    volatile bool stop;                       /*!< Asks the task to exit */
+} esp_littlefs_preerase_t;
+#endif
+
+#ifdef CONFIG_LITTLEFS_WRITE_BEHIND
+#define ESP_LITTLEFS_WB_HALF ((CONFIG_LITTLEFS_WRITE_BEHIND_BUFFER_SIZE / 2) & ~7)
+#define ESP_LITTLEFS_WB_NO_RUN UINT32_MAX
+
+/**
+ * @brief Header of a run of staged bytes; the bytes follow it
+ */
+typedef struct {
+    vfs_littlefs_file_t *file;                /*!< Descriptor the bytes are written to */
+    uint32_t len;                             /*!< Bytes in the run */
+    uint32_t writes;                          /*!< write() calls merged into the run */
+} esp_littlefs_wb_run_t;
+
+/**
+ * @brief State of the write-behind task of a partition
+ *
+ * write() appends runs to the fill half under lock, without the FS lock.
+ * Staged runs only move to littlefs with the FS lock taken: the writer
+ * switches halves and writes the previous one out before giving the FS lock
+ * back, so whoever holds the FS lock sees no write in flight.
+ */
+typedef struct {
+    TaskHandle_t task;                        /*!< Write-behind task; NULL when not running */
+    uint8_t *buf;                             /*!< Two halves of ESP_LITTLEFS_WB_HALF bytes */
+    uint8_t fill;                             /*!< Half write() appends to */
+    uint32_t used;                            /*!< Bytes used in the fill half */
+    uint32_t last_run;                        /*!< Offset of the newest run in the fill half, or ESP_LITTLEFS_WB_NO_RUN */
+    SemaphoreHandle_t lock;                   /*!< Staging lock; taken after the FS lock, never before */
+    StaticSemaphore_t lock_buffer;
+    SemaphoreHandle_t exited;                 /*!< Given by the task when it stops */
+    StaticSemaphore_t exited_buffer;
+    volatile bool stop;                       /*!< Asks the task to exit */
+} esp_littlefs_writebehind_t;
+#endif
+
 /**
  * @brief littlefs definition structure
  */
@@ -81,15 +161,59 @@ typedef struct {
 
     struct lfs_config cfg;                    /*!< littlefs Mount configuration */
 
-    vfs_littlefs_file_t *file;                /*!< Singly Linked List of files */
-
     vfs_littlefs_file_t **cache;              /*!< A cache of pointers to the opened files */
     uint16_t             cache_size;          /*!< The cache allocated size (in pointers) */
     uint16_t             fd_count;            /*!< The count of opened file descriptor used to speed up computation */
+    uint16_t            *free_fd;             /*!< Stack of the free slots in cache */
+    uint16_t            *fd_index;            /*!< Open addressing table from path hash to FD */
+    uint32_t             fd_index_mask;       /*!< Size of fd_index minus one; it is a power of two */
     bool                 read_only;           /*!< Filesystem is read-only */
+    esp_littlefs_read_stats_t read_stats;     /*!< Read counters, updated under the FS lock */
+    esp_littlefs_write_stats_t write_stats;   /*!< Write counters, updated under the FS lock */
+#ifdef CONFIG_LITTLEFS_PREERASE
+    esp_littlefs_preerase_t preerase;         /*!< Background pre-erase of free blocks */
+#endif
+#ifdef CONFIG_LITTLEFS_WRITE_BEHIND
+    esp_littlefs_writebehind_t wb;            /*!< Staged writes and their background writer */
+#endif
 } esp_littlefs_t;
 
+/**
+ * @brief Account a block device read. Called from the read callbacks, so
+ *        always with the FS lock taken.
+ */
+static inline void esp_littlefs_count_flash_read(esp_littlefs_t *efs, lfs_size_t size) {
+    efs->read_stats.flash_reads++;
+    efs->read_stats.flash_bytes_read += size;
+}
+
+/**
+ * @brief Account a block device program, and an erase; called like
+ *        esp_littlefs_count_flash_read().
+ */
+static inline void esp_littlefs_count_flash_prog(esp_littlefs_t *efs, lfs_size_t size) {
+    efs->write_stats.flash_progs++;
+    efs->write_stats.flash_bytes_programmed += size;
+}
+
+static inline void esp_littlefs_count_flash_erase(esp_littlefs_t *efs) {
+    efs->write_stats.flash_erases++;
+}
+
 #ifdef CONFIG_LITTLEFS_MMAP_PARTITION
+/**
+ * @brief fcntl() command behind esp_littlefs_file_map(); arg is a
+ *        esp_littlefs_map_req_t pointer.
+ */
+#define ESP_LITTLEFS_F_MAP 0x4c46
+
+typedef struct {
+    off_t offset;                             /*!< In: file offset */
+    size_t size;                              /*!< In: most bytes wanted */
+    const void *data;                         /*!< Out: mapped data */
+    size_t len;                               /*!< Out: contiguous bytes at data */
+} esp_littlefs_map_req_t;
+
 /**
  * @brief Read a region in a block, only for use with an mmapped partition.
  *
@@ -143,6 +267,24 @@ int littlefs_esp_part_erase(const struct lfs_config *c, lfs_block_t block);
  */
 int littlefs_esp_part_sync(const struct lfs_config *c);
 
+#ifdef CONFIG_LITTLEFS_PREERASE
+/**
+ * @brief Start the pre-erase task of a mounted, writable partition.
+ *
+ * Does nothing for SD cards and read-only mounts.
+ * @warning Must not be called with the FS lock taken
+ * @return ESP_OK, or ESP_ERR_NO_MEM if the task could not be created.
+ */
+esp_err_t littlefs_esp_part_preerase_start(esp_littlefs_t *efs);
+
+/**
+ * @brief Stop the pre-erase task, waiting for an erase in progress. Must be
+ *        called before the filesystem is unmounted.
+ * @warning Must not be called with the FS lock taken
+ */
+void littlefs_esp_part_preerase_stop(esp_littlefs_t *efs);
+#endif
+
 #ifdef CONFIG_LITTLEFS_SDMMC_SUPPORT
 
 /**
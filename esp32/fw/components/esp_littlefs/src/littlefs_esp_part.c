@@ -6,6 +6,7 @@
 
 //#define ESP_LOCAL_LOG_LEVEL ESP_LOG_INFO
 
+#include <string.h>
 #include "esp_log.h"
 #include "esp_partition.h"
 #include "esp_vfs.h"
@@ -13,6 +14,23 @@
 #include "esp_littlefs.h"
 #include "littlefs_api.h"
 
+#ifdef CONFIG_LITTLEFS_PREERASE
+static inline bool preerase_test(const esp_littlefs_preerase_t *p, lfs_block_t block) {
+    return p->erased && block < p->block_count && (p->erased[block / 32] & (1U << (block % 32)));
+}
+
+static inline void preerase_clear(esp_littlefs_preerase_t *p, lfs_block_t block) {
+    if (p->erased && block < p->block_count) {
+        p->erased[block / 32] &= ~(1U << (block % 32));
+    }
+}
+
+/* Called from the block device callbacks, so with the FS lock taken */
+static inline void preerase_note_io(esp_littlefs_t *efs) {
+    efs->preerase.last_io = xTaskGetTickCount();
+}
+#endif
+
 #ifdef CONFIG_LITTLEFS_MMAP_PARTITION
 int littlefs_esp_part_read_mmap(const struct lfs_config *c, lfs_block_t block,
                            lfs_off_t off, void *buffer, lfs_size_t size) {
@@ -23,6 +41,10 @@ int littlefs_esp_part_read_mmap(const struct lfs_config *c, lfs_block_t block,
         return LFS_ERR_IO;
     }
     memcpy(buffer, efs->mmap_data + part_off, size);
+    esp_littlefs_count_flash_read(efs, size);
+#ifdef CONFIG_LITTLEFS_PREERASE
+    preerase_note_io(efs);
+#endif
     return 0;
 }
 #endif
@@ -36,6 +58,10 @@ int littlefs_esp_part_read(const struct lfs_config *c, lfs_block_t block,
         ESP_LOGE(ESP_LITTLEFS_TAG, "failed to read addr %08x, size %08x, err %d", (unsigned int) part_off, (unsigned int) size, err);
         return LFS_ERR_IO;
     }
+    esp_littlefs_count_flash_read(efs, size);
+#ifdef CONFIG_LITTLEFS_PREERASE
+    preerase_note_io(efs);
+#endif
     return 0;
 }
 
@@ -43,22 +69,52 @@ int littlefs_esp_part_write(const struct lfs_config *c, lfs_block_t block,
                             lfs_off_t off, const void *buffer, lfs_size_t size) {
     esp_littlefs_t * efs = c->context;
     size_t part_off = (block * c->block_size) + off;
+#ifdef CONFIG_LITTLEFS_PREERASE
+    preerase_note_io(efs);
+    preerase_clear(&efs->preerase, block);
+#endif
     esp_err_t err = esp_partition_write(efs->partition, part_off, buffer, size);
     if (err) {
         ESP_LOGE(ESP_LITTLEFS_TAG, "failed to write addr %08x, size %08x, err %d", (unsigned int) part_off, (unsigned int) size, err);
         return LFS_ERR_IO;
     }
+    esp_littlefs_count_flash_prog(efs, size);
     return 0;
 }
 
 int littlefs_esp_part_erase(const struct lfs_config *c, lfs_block_t block) {
     esp_littlefs_t * efs = c->context;
     size_t part_off = block * c->block_size;
+#ifdef CONFIG_LITTLEFS_PREERASE
+    esp_littlefs_preerase_t *p = &efs->preerase;
+    bool erased;
+
+    preerase_note_io(efs);
+    if (p->task && block == p->erasing) {
+        /* The pre-erase task is erasing this block right now; wait for it */
+        xSemaphoreTake(p->erase_lock, portMAX_DELAY);
+        xSemaphoreGive(p->erase_lock);
+        erased = p->erase_err == ESP_OK;
+        p->erasing = ESP_LITTLEFS_BLOCK_NONE;
+    } else {
+        erased = preerase_test(p, block);
+        preerase_clear(p, block);
+    }
+    if (p->task) {
+        /* A free block was used up; top the pre-erased ones up again */
+        xTaskNotifyGive(p->task);
+    }
+    if (erased) {
+        efs->write_stats.erases_skipped++;
+        return 0;
+    }
+#endif
     esp_err_t err = esp_partition_erase_range(efs->partition, part_off, c->block_size);
     if (err) {
         ESP_LOGE(ESP_LITTLEFS_TAG, "failed to erase addr %08x, size %08x, err %d", (unsigned int) part_off, (unsigned int) c->block_size, err);
         return LFS_ERR_IO;
     }
+    esp_littlefs_count_flash_erase(efs);
     return 0;
 
 }
@@ -68,3 +124,147 @@ int littlefs_esp_part_sync(const struct lfs_config *c) {
     return 0;
 }
 
+
+#ifdef CONFIG_LITTLEFS_PREERASE
+/**
+ * @brief Next block worth erasing: one of the first
+ *        CONFIG_LITTLEFS_PREERASE_BLOCKS free blocks littlefs' allocator
+ *        will hand out, that is not erased yet.
+ *
+ * Blocks in the lookahead window past lookahead.next with a clear bit are
+ * exactly the ones lfs_alloc() returns next, in order; a block only leaves
+ * that set by being allocated, which erases it through
+ * littlefs_esp_part_erase() first.
+ * @warning This must be called with the FS lock taken
+ */
+static lfs_block_t preerase_next_block(esp_littlefs_t *efs) {
+    const lfs_t *lfs = efs->fs;
+    unsigned int free_seen = 0;
+
+    if (!lfs->lookahead.buffer || lfs->block_count == 0) {
+        return ESP_LITTLEFS_BLOCK_NONE;
+    }
+    for (lfs_block_t i = lfs->lookahead.next;
+         i < lfs->lookahead.size && free_seen < CONFIG_LITTLEFS_PREERASE_BLOCKS;
+         i++) {
+        if (lfs->lookahead.buffer[i / 8] & (1U << (i % 8))) {
+            continue;
+        }
+        free_seen++;
+        lfs_block_t block = (lfs->lookahead.start + i) % lfs->block_count;
+        if (block < efs->preerase.block_count && !preerase_test(&efs->preerase, block)) {
+            return block;
+        }
+    }
+    return ESP_LITTLEFS_BLOCK_NONE;
+}
+
+static void littlefs_esp_part_preerase_task(void *arg) {
+    esp_littlefs_t *efs = arg;
+    esp_littlefs_preerase_t *p = &efs->preerase;
+    const TickType_t idle = pdMS_TO_TICKS(CONFIG_LITTLEFS_PREERASE_IDLE_MS);
+
+    while (!p->stop) {
+        lfs_block_t block = ESP_LITTLEFS_BLOCK_NONE;
+        TickType_t quiet;
+
+        xSemaphoreTakeRecursive(efs->lock, portMAX_DELAY);
+        quiet = xTaskGetTickCount() - p->last_io;
+        if (!p->stop && quiet >= idle) {
+            block = preerase_next_block(efs);
+        }
+        if (block != ESP_LITTLEFS_BLOCK_NONE) {
+            /* Uncontended: littlefs_esp_part_erase() only takes it with the
+             * FS lock, which we hold */
+            xSemaphoreTake(p->erase_lock, portMAX_DELAY);
+            p->erasing = block;
+        }
+        xSemaphoreGiveRecursive(efs->lock);
+
+        if (block == ESP_LITTLEFS_BLOCK_NONE) {
+            /* Wait out the rest of the quiet period, or with nothing left to
+             * erase until littlefs uses up a block */
+            ulTaskNotifyTake(pdTRUE, quiet < idle ? idle - quiet : portMAX_DELAY);
+            continue;
+        }
+
+        /* The erase runs without the FS lock so filesystem calls are not
+         * held up by it; a littlefs erase of this very block waits on
+         * erase_lock instead */
+        p->erase_err = esp_partition_erase_range(efs->partition,
+                block * efs->cfg.block_size, efs->cfg.block_size);
+        xSemaphoreGive(p->erase_lock);
+
+        xSemaphoreTakeRecursive(efs->lock, portMAX_DELAY);
+        if (p->erase_err == ESP_OK) {
+            esp_littlefs_count_flash_erase(efs);
+        }
+        if (p->erasing == block) {
+            /* littlefs has not claimed the block meanwhile */
+            p->erasing = ESP_LITTLEFS_BLOCK_NONE;
+            if (p->erase_err == ESP_OK) {
+                p->erased[block / 32] |= 1U << (block % 32);
+            }
+        }
+        xSemaphoreGiveRecursive(efs->lock);
+        if (p->erase_err != ESP_OK) {
+            ESP_LOGW(ESP_LITTLEFS_TAG, "pre-erase of block %u failed: %s",
+                     (unsigned int)block, esp_err_to_name(p->erase_err));
+            ulTaskNotifyTake(pdTRUE, idle);
+        }
+    }
+
+    xSemaphoreGive(p->exited);
+    vTaskDelete(NULL);
+}
+
+esp_err_t littlefs_esp_part_preerase_start(esp_littlefs_t *efs) {
+    esp_littlefs_preerase_t *p = &efs->preerase;
+
+    if (p->task || efs->read_only || efs->partition == NULL
+#ifdef CONFIG_LITTLEFS_SDMMC_SUPPORT
+            || efs->sdcard
+#endif
+            ) {
+        return ESP_OK;
+    }
+
+    memset(p, 0, sizeof(*p));
+    p->block_count = efs->partition->size / efs->cfg.block_size;
+    p->erased = calloc((p->block_count + 31) / 32, sizeof(*p->erased));
+    if (!p->erased) {
+        return ESP_ERR_NO_MEM;
+    }
+    p->erasing = ESP_LITTLEFS_BLOCK_NONE;
+    p->last_io = xTaskGetTickCount();
+    p->erase_lock = xSemaphoreCreateMutexStatic(&p->erase_lock_buffer);
+    p->exited = xSemaphoreCreateBinaryStatic(&p->exited_buffer);
+    if (xTaskCreate(littlefs_esp_part_preerase_task, "lfs_preerase", 3072, efs,
+                CONFIG_LITTLEFS_PREERASE_TASK_PRIORITY, &p->task) != pdPASS) {
+        vSemaphoreDelete(p->erase_lock);
+        vSemaphoreDelete(p->exited);
+        free(p->erased);
+        memset(p, 0, sizeof(*p));
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+void littlefs_esp_part_preerase_stop(esp_littlefs_t *efs) {
+    esp_littlefs_preerase_t *p = &efs->preerase;
+
+    if (!p->task) {
+        return;
+    }
+    p->stop = true;
+    xTaskNotifyGive(p->task);
+    xSemaphoreTake(p->exited, portMAX_DELAY);
+
+    xSemaphoreTakeRecursive(efs->lock, portMAX_DELAY);
+    vSemaphoreDelete(p->erase_lock);
+    vSemaphoreDelete(p->exited);
+    free(p->erased);
+    memset(p, 0, sizeof(*p));
+    xSemaphoreGiveRecursive(efs->lock);
+}
+#endif
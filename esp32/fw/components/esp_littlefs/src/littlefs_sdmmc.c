@@ -21,6 +21,7 @@ int littlefs_sdmmc_read(const struct lfs_config *c, lfs_block_t block, lfs_off_t
         return LFS_ERR_IO;
     }
 
+    esp_littlefs_count_flash_read(efs, size);
     return LFS_ERR_OK;
 }
 
@@ -34,6 +35,7 @@ int littlefs_sdmmc_write(const struct lfs_config *c, lfs_block_t block, lfs_off_
         ESP_LOGE(ESP_LITTLEFS_TAG, "Failed to write addr 0x%08lx: off 0x%08lx, block 0x%08lx, size %lu, err=0x%x", part_off, off, block, size, ret);
         return LFS_ERR_IO;
     }
+    esp_littlefs_count_flash_prog(efs, size);
 
     return LFS_ERR_OK;
 }
@@ -46,6 +48,7 @@ int littlefs_sdmmc_erase(const struct lfs_config *c, lfs_block_t block)
         ESP_LOGE(ESP_LITTLEFS_TAG, "Failed to erase block %lu: ret=0x%x %s", block, ret, esp_err_to_name(ret));
         return LFS_ERR_IO;
     }
+    esp_littlefs_count_flash_erase(efs);
 
     return LFS_ERR_OK;
 }
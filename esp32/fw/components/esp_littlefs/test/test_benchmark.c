@@ -253,3 +253,355 @@ TEST_CASE("Write 5 files, read 5 files, then delete 5 files", TAG){
 
     test_benchmark_teardown();
 }
+
+#define CONTENTION_FILE_SIZE (32 * 1024)
+#define CONTENTION_DURATION_US (2 * 1000 * 1000)
+
+typedef struct {
+    const char *path;
+    volatile bool stop;
+    SemaphoreHandle_t done;
+    uint32_t reads;
+} contention_reader_t;
+
+/**
+ * @brief Reads the whole file with a single read() call until told to stop,
+ *        like a telemetry drain.
+ */
+static void contention_reader_task(void *arg) {
+    contention_reader_t *ctx = (contention_reader_t *)arg;
+    uint8_t *buf = malloc(CONTENTION_FILE_SIZE);
+
+    while (buf && !ctx->stop) {
+        int fd = open(ctx->path, O_RDONLY);
+        if (fd < 0) {
+            break;
+        }
+        ssize_t n = read(fd, buf, CONTENTION_FILE_SIZE);
+        close(fd);
+        if (n != CONTENTION_FILE_SIZE) {
+            break;
+        }
+        ctx->reads++;
+    }
+    free(buf);
+    xSemaphoreGive(ctx->done);
+    vTaskDelete(NULL);
+}
+
+/**
+ * @brief Times stat() and a small append from this task for duration_us
+ */
+static void contention_measure(const char *label, const char *stat_path, const char *append_path) {
+    const char record[16] = "0123456789abcde";
+    uint64_t stat_sum = 0, stat_max = 0, append_sum = 0, append_max = 0;
+    uint32_t n = 0;
+    struct stat sb;
+
+    uint64_t t_end = esp_timer_get_time() + CONTENTION_DURATION_US;
+    while (esp_timer_get_time() < t_end) {
+        uint64_t t0 = esp_timer_get_time();
+        TEST_ASSERT_EQUAL(0, stat(stat_path, &sb));
+        uint64_t t1 = esp_timer_get_time();
+        int fd = open(append_path, O_WRONLY | O_CREAT | O_APPEND);
+        TEST_ASSERT_GREATER_OR_EQUAL(0, fd);
+        TEST_ASSERT_EQUAL(sizeof(record), write(fd, record, sizeof(record)));
+        close(fd);
+        uint64_t t2 = esp_timer_get_time();
+
+        stat_sum += t1 - t0;
+        stat_max = MAX(stat_max, t1 - t0);
+        append_sum += t2 - t1;
+        append_max = MAX(append_max, t2 - t1);
+        n++;
+        vTaskDelay(1);
+    }
+
+    printf("%s: %u ops, stat avg %llu us max %llu us, append avg %llu us max %llu us\n",
+            label, (unsigned)n, stat_sum / n, stat_max, append_sum / n, append_max);
+}
+
+TEST_CASE("Contention: stat and append latency during a long read", TAG){
+    const char *big = littlefs_base_path "/drain.bin";
+    const char *small = littlefs_base_path "/append.bin";
+    const char *other = littlefs_base_path "/meta.txt";
+
+    setup_littlefs();
+    test_littlefs_create_file_with_text(other, littlefs_test_hello_str);
+
+    uint8_t *buf = malloc(CONTENTION_FILE_SIZE);
+    TEST_ASSERT_NOT_NULL(buf);
+    memset(buf, 0xA5, CONTENTION_FILE_SIZE);
+    FILE *f = fopen(big, "wb");
+    TEST_ASSERT_NOT_NULL(f);
+    TEST_ASSERT_EQUAL(CONTENTION_FILE_SIZE, fwrite(buf, 1, CONTENTION_FILE_SIZE, f));
+    fclose(f);
+    free(buf);
+
+    printf("CONFIG_LITTLEFS_IO_CHUNK_SIZE=%d\n", CONFIG_LITTLEFS_IO_CHUNK_SIZE);
+    contention_measure("Idle", other, small);
+
+    contention_reader_t ctx = {
+        .path = big,
+        .stop = false,
+        .done = xSemaphoreCreateBinary(),
+    };
+    TEST_ASSERT_NOT_NULL(ctx.done);
+    /* On dual core targets the reader gets the other core, so the two really overlap */
+    BaseType_t core = portNUM_PROCESSORS > 1 ? !xPortGetCoreID() : tskNO_AFFINITY;
+    TEST_ASSERT_EQUAL(pdPASS, xTaskCreatePinnedToCore(contention_reader_task, "lfs_drain", 4096,
+            &ctx, uxTaskPriorityGet(NULL), NULL, core));
+    contention_measure("During 32 KiB reads", other, small);
+    ctx.stop = true;
+    xSemaphoreTake(ctx.done, portMAX_DELAY);
+    vSemaphoreDelete(ctx.done);
+    printf("Reader completed %u full reads\n", (unsigned)ctx.reads);
+    TEST_ASSERT_GREATER_THAN(0, ctx.reads);
+
+    unlink(big);
+    unlink(small);
+    unlink(other);
+    TEST_ESP_OK(esp_vfs_littlefs_unregister("flash_test"));
+}
+
+#define SEQUENTIAL_FILE_SIZE (64 * 1024)
+#define SEQUENTIAL_RECORD 32
+
+TEST_CASE("Sequential small reads (read-ahead)", TAG){
+    const char *path = littlefs_base_path "/export.log";
+    uint8_t record[SEQUENTIAL_RECORD];
+    esp_littlefs_read_stats_t stats;
+
+    setup_littlefs();
+
+    FILE *f = fopen(path, "wb");
+    TEST_ASSERT_NOT_NULL(f);
+    for (uint32_t i = 0; i < SEQUENTIAL_FILE_SIZE / sizeof(record); i++) {
+        memset(record, (int)i, sizeof(record));
+        TEST_ASSERT_EQUAL(1, fwrite(record, sizeof(record), 1, f));
+    }
+    fclose(f);
+
+    /* Unbuffered record-by-record scan, like a log export or ring drain */
+    int fd = open(path, O_RDONLY);
+    TEST_ASSERT_GREATER_OR_EQUAL(0, fd);
+    TEST_ESP_OK(esp_littlefs_read_stats_reset("flash_test"));
+    uint64_t t_start = esp_timer_get_time();
+    uint32_t n = 0;
+    while (read(fd, record, sizeof(record)) == sizeof(record)) {
+        TEST_ASSERT_EQUAL_HEX8((uint8_t)n, record[0]);
+        n++;
+    }
+    uint64_t t_read = esp_timer_get_time() - t_start;
+    close(fd);
+    TEST_ASSERT_EQUAL(SEQUENTIAL_FILE_SIZE / sizeof(record), n);
+
+    TEST_ESP_OK(esp_littlefs_read_stats("flash_test", &stats));
+    printf("CONFIG_LITTLEFS_READAHEAD_MAX=%d\n", CONFIG_LITTLEFS_READAHEAD_MAX);
+    printf("%u x %u byte reads in %llu us (%llu KiB/s)\n", (unsigned)n, (unsigned)sizeof(record),
+            t_read, (uint64_t)SEQUENTIAL_FILE_SIZE * 1000000 / 1024 / (t_read ? t_read : 1));
+    printf("read %llu bytes (%llu from read-ahead), fetched %llu bytes in %u flash reads\n",
+            stats.bytes_read, stats.readahead_bytes, stats.flash_bytes_read, (unsigned)stats.flash_reads);
+    TEST_ASSERT_EQUAL(SEQUENTIAL_FILE_SIZE, stats.bytes_read);
+
+    unlink(path);
+    TEST_ESP_OK(esp_vfs_littlefs_unregister("flash_test"));
+}
+
+#define APPEND_RECORD 512
+#define APPEND_COUNT 128
+
+static int compare_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+TEST_CASE("Append latency percentiles (pre-erase)", TAG){
+    const char *path = littlefs_base_path "/samples.bin";
+    static uint32_t latency_us[APPEND_COUNT];
+    uint8_t record[APPEND_RECORD];
+#ifdef CONFIG_LITTLEFS_PREERASE
+    /* Leave the partition idle long enough between appends for the
+     * background task to get ahead, as a sampling logger would */
+    const TickType_t gap = pdMS_TO_TICKS(CONFIG_LITTLEFS_PREERASE_IDLE_MS + 50);
+#else
+    const TickType_t gap = pdMS_TO_TICKS(50);
+#endif
+
+    setup_littlefs();
+    unlink(path);
+
+    for (uint32_t i = 0; i < APPEND_COUNT; i++) {
+        memset(record, (int)i, sizeof(record));
+        vTaskDelay(gap);
+        uint64_t t0 = esp_timer_get_time();
+        int fd = open(path, O_WRONLY | O_CREAT | O_APPEND);
+        TEST_ASSERT_GREATER_OR_EQUAL(0, fd);
+        TEST_ASSERT_EQUAL(sizeof(record), write(fd, record, sizeof(record)));
+        TEST_ASSERT_EQUAL(0, close(fd));
+        latency_us[i] = (uint32_t)(esp_timer_get_time() - t0);
+    }
+    qsort(latency_us, APPEND_COUNT, sizeof(latency_us[0]), compare_u32);
+
+#ifdef CONFIG_LITTLEFS_PREERASE
+    printf("CONFIG_LITTLEFS_PREERASE=y\n");
+#else
+    printf("CONFIG_LITTLEFS_PREERASE=n\n");
+#endif
+    printf("%u x %u byte appends: p50 %u us, p99 %u us, max %u us\n",
+            APPEND_COUNT, APPEND_RECORD,
+            (unsigned)latency_us[APPEND_COUNT / 2],
+            (unsigned)latency_us[APPEND_COUNT * 99 / 100],
+            (unsigned)latency_us[APPEND_COUNT - 1]);
+    TEST_ASSERT_EQUAL(APPEND_COUNT * APPEND_RECORD, get_file_size(path));
+
+    unlink(path);
+    TEST_ESP_OK(esp_vfs_littlefs_unregister("flash_test"));
+}
+
+/* Telemetry ring workload, shaped like firmware/esp32_pot/main/storage.c with
+ * its default settings: 16 byte slots behind a 20 byte header, a keyframe
+ * opening every block of 32 slots, appends written in batches of 8 (blanking
+ * the rest of a block when a batch starts one), the header rewritten every 64
+ * entries, and a bulk drain in 8 slot reads. */
+#define TELEMETRY_SLOT 16
+#define TELEMETRY_HEADER 20
+#define TELEMETRY_KEYFRAME 32
+#define TELEMETRY_CAPACITY (50 * TELEMETRY_KEYFRAME)
+#define TELEMETRY_BATCH 8
+#define TELEMETRY_HEADER_SYNC 64
+#define TELEMETRY_DRAIN_CHUNK 8
+#define TELEMETRY_SAMPLES 4000  /* two and a half laps of the ring */
+#define TELEMETRY_WRITES ((TELEMETRY_SAMPLES + TELEMETRY_BATCH - 1) / TELEMETRY_BATCH)
+
+static void telemetry_commit(FILE *f) {
+    TEST_ASSERT_EQUAL(0, fflush(f));
+    TEST_ASSERT_EQUAL(0, fsync(fileno(f)));
+}
+
+static void telemetry_write_header(FILE *f, uint32_t head, uint32_t tail) {
+    uint8_t header[TELEMETRY_HEADER] = {0};
+    memcpy(&header[12], &head, sizeof(head));
+    memcpy(&header[16], &tail, sizeof(tail));
+    TEST_ASSERT_EQUAL(0, fseek(f, 0, SEEK_SET));
+    TEST_ASSERT_EQUAL(1, fwrite(header, sizeof(header), 1, f));
+    telemetry_commit(f);
+}
+
+/* Write slots [first, end) plus the blank rest of a block begun in the batch,
+ * one contiguous run per side of the ring end, then commit */
+static void telemetry_write_batch(FILE *f, uint32_t first, uint32_t end) {
+    static const uint8_t zeros[TELEMETRY_KEYFRAME * TELEMETRY_SLOT];
+    uint8_t slots[TELEMETRY_BATCH * TELEMETRY_SLOT];
+    uint32_t blank_to = end;
+
+    for (uint32_t seq = first; seq < end; seq++) {
+        memset(&slots[(seq - first) * TELEMETRY_SLOT], (int)seq, TELEMETRY_SLOT);
+        if (seq % TELEMETRY_KEYFRAME == 0) {
+            blank_to = seq + TELEMETRY_KEYFRAME;
+        }
+    }
+    for (uint32_t seq = first; seq < blank_to;) {
+        uint32_t to_ring_end = TELEMETRY_CAPACITY - seq % TELEMETRY_CAPACITY;
+        uint32_t run_end = MIN(blank_to, seq + to_ring_end);
+        TEST_ASSERT_EQUAL(0, fseek(f, TELEMETRY_HEADER + (seq % TELEMETRY_CAPACITY) * TELEMETRY_SLOT, SEEK_SET));
+        while (seq < run_end) {
+            uint32_t n;
+            if (seq < end) {
+                n = MIN(end, run_end) - seq;
+                TEST_ASSERT_EQUAL(n, fwrite(&slots[(seq - first) * TELEMETRY_SLOT], TELEMETRY_SLOT, n, f));
+            } else {
+                n = run_end - seq;
+                TEST_ASSERT_EQUAL(n, fwrite(zeros, TELEMETRY_SLOT, n, f));
+            }
+            seq += n;
+        }
+    }
+    telemetry_commit(f);
+}
+
+TEST_CASE("Telemetry ring: appends, wrap-around and drain", TAG){
+    const char *path = littlefs_base_path "/telemetry.bin";
+    static uint32_t write_us[TELEMETRY_WRITES];
+    uint8_t chunk[TELEMETRY_DRAIN_CHUNK * TELEMETRY_SLOT];
+    esp_littlefs_write_stats_t wstats;
+    esp_littlefs_read_stats_t rstats;
+
+    setup_littlefs();
+    unlink(path);
+    FILE *f = fopen(path, "w+b");
+    TEST_ASSERT_NOT_NULL(f);
+    telemetry_write_header(f, 0, 0);
+
+    /* Appends: one timed ring write per batch, the header riding along
+     * every TELEMETRY_HEADER_SYNC entries */
+    TEST_ESP_OK(esp_littlefs_write_stats_reset("flash_test"));
+    uint32_t head = 0, tail = 0, unsynced = 0, writes = 0;
+    uint64_t t_appends = esp_timer_get_time();
+    while (head < TELEMETRY_SAMPLES) {
+        uint32_t end = MIN(head + TELEMETRY_BATCH, TELEMETRY_SAMPLES);
+        uint64_t t0 = esp_timer_get_time();
+        telemetry_write_batch(f, head, end);
+        unsynced += end - head;
+        head = end;
+        /* Evict whole blocks once the ring is full */
+        while (head - tail > TELEMETRY_CAPACITY - TELEMETRY_KEYFRAME) {
+            tail += TELEMETRY_KEYFRAME;
+        }
+        if (unsynced >= TELEMETRY_HEADER_SYNC) {
+            telemetry_write_header(f, head, tail);
+            unsynced = 0;
+        }
+        write_us[writes++] = (uint32_t)(esp_timer_get_time() - t0);
+    }
+    t_appends = esp_timer_get_time() - t_appends;
+    TEST_ESP_OK(esp_littlefs_write_stats("flash_test", &wstats));
+
+    /* Drain everything still in the ring, then drop it with one header write */
+    TEST_ESP_OK(esp_littlefs_read_stats_reset("flash_test"));
+    uint64_t t_drain = esp_timer_get_time();
+    uint32_t drained = 0;
+    for (uint32_t seq = tail; seq < head;) {
+        uint32_t to_ring_end = TELEMETRY_CAPACITY - seq % TELEMETRY_CAPACITY;
+        uint32_t n = MIN(MIN(head - seq, to_ring_end), TELEMETRY_DRAIN_CHUNK);
+        TEST_ASSERT_EQUAL(0, fseek(f, TELEMETRY_HEADER + (seq % TELEMETRY_CAPACITY) * TELEMETRY_SLOT, SEEK_SET));
+        TEST_ASSERT_EQUAL(n, fread(chunk, TELEMETRY_SLOT, n, f));
+        for (uint32_t i = 0; i < n; i++) {
+            TEST_ASSERT_EQUAL_HEX8((uint8_t)(seq + i), chunk[i * TELEMETRY_SLOT]);
+        }
+        seq += n;
+        drained += n;
+    }
+    telemetry_write_header(f, head, head);
+    t_drain = esp_timer_get_time() - t_drain;
+    TEST_ESP_OK(esp_littlefs_read_stats("flash_test", &rstats));
+    fclose(f);
+
+    qsort(write_us, writes, sizeof(write_us[0]), compare_u32);
+
+    /* One line per run, so results from builds with different settings can
+     * be collected from the serial log and compared */
+    printf("TELEMETRY_BENCH {\"cache_size\":%d,\"lookahead_size\":%d,\"block_cycles\":%d,"
+            "\"preerase\":%d,\"samples\":%u,\"samples_per_s\":%llu,"
+            "\"writes\":%u,\"write_p50_us\":%u,\"write_p99_us\":%u,\"write_max_us\":%u,"
+            "\"prog_bytes_per_1k\":%llu,\"erases_per_1k\":%.2f,"
+            "\"drained\":%u,\"drain_samples_per_s\":%llu,\"drain_flash_bytes_read\":%llu}\n",
+            CONFIG_LITTLEFS_CACHE_SIZE, CONFIG_LITTLEFS_LOOKAHEAD_SIZE, CONFIG_LITTLEFS_BLOCK_CYCLES,
+#ifdef CONFIG_LITTLEFS_PREERASE
+            1,
+#else
+            0,
+#endif
+            (unsigned)TELEMETRY_SAMPLES,
+            (uint64_t)TELEMETRY_SAMPLES * 1000000 / (t_appends ? t_appends : 1),
+            (unsigned)writes, (unsigned)write_us[writes / 2], (unsigned)write_us[writes * 99 / 100],
+            (unsigned)write_us[writes - 1],
+            wstats.flash_bytes_programmed * 1000 / TELEMETRY_SAMPLES,
+            wstats.flash_erases * 1000.0 / TELEMETRY_SAMPLES,
+            (unsigned)drained, (uint64_t)drained * 1000000 / (t_drain ? t_drain : 1),
+            rstats.flash_bytes_read);
+    TEST_ASSERT_EQUAL(head - tail, drained);
+
+    unlink(path);
+    TEST_ESP_OK(esp_vfs_littlefs_unregister("flash_test"));
+}
@@ -925,6 +925,316 @@ TEST_CASE("fcntl get flags", "[littlefs]")
     test_teardown();
 }
 
+TEST_CASE("open files stay findable by path as the FD cache grows", "[littlefs]")
+{
+    /* More than CONFIG_LITTLEFS_FD_CACHE_MIN_SIZE, so the cache grows twice */
+    enum { n_files = 16 };
+    char path[32];
+    int fds[n_files];
+
+    test_setup();
+
+    for (int i = 0; i < n_files; i++) {
+        snprintf(path, sizeof(path), littlefs_base_path "/fd%d.txt", i);
+        fds[i] = open(path, O_CREAT | O_WRONLY | O_TRUNC);
+        TEST_ASSERT_GREATER_OR_EQUAL_INT(0, fds[i]);
+        for (int j = 0; j < i; j++) {
+            TEST_ASSERT_NOT_EQUAL(fds[j], fds[i]);
+        }
+    }
+
+    /* Close every other file; the rest must still refuse to be removed */
+    for (int i = 0; i < n_files; i += 2) {
+        TEST_ASSERT_EQUAL(0, close(fds[i]));
+    }
+    for (int i = 0; i < n_files; i++) {
+        snprintf(path, sizeof(path), littlefs_base_path "/fd%d.txt", i);
+        if (i % 2) {
+            TEST_ASSERT_EQUAL(-1, unlink(path));
+            TEST_ASSERT_EQUAL(EBUSY, errno);
+        } else {
+            TEST_ASSERT_EQUAL(0, unlink(path));
+        }
+    }
+
+    /* Freed descriptors are reused without disturbing the open ones */
+    snprintf(path, sizeof(path), littlefs_base_path "/fd%d.txt", 1);
+    int again = open(path, O_RDONLY);
+    TEST_ASSERT_GREATER_OR_EQUAL_INT(0, again);
+    TEST_ASSERT_EQUAL(0, close(again));
+    TEST_ASSERT_EQUAL(-1, unlink(path));
+    TEST_ASSERT_EQUAL(EBUSY, errno);
+
+    for (int i = 1; i < n_files; i += 2) {
+        TEST_ASSERT_EQUAL(0, close(fds[i]));
+        snprintf(path, sizeof(path), littlefs_base_path "/fd%d.txt", i);
+        TEST_ASSERT_EQUAL(0, unlink(path));
+    }
+
+    test_teardown();
+}
+
+TEST_CASE("read-ahead stays coherent with lseek, pread and writes", "[littlefs]")
+{
+    const char *path = littlefs_base_path "/ra.bin";
+    const size_t size = 3 * 4096;
+    uint8_t buf[16];
+
+    test_setup();
+
+    uint8_t *data = malloc(size);
+    TEST_ASSERT_NOT_NULL(data);
+    for (size_t i = 0; i < size; i++) {
+        data[i] = (uint8_t)(i * 7 + i / 251);
+    }
+    int fd = open(path, O_CREAT | O_WRONLY | O_TRUNC);
+    TEST_ASSERT_GREATER_OR_EQUAL_INT(0, fd);
+    TEST_ASSERT_EQUAL(size, write(fd, data, size));
+    TEST_ASSERT_EQUAL(0, close(fd));
+
+    int rd = open(path, O_RDWR);
+    TEST_ASSERT_GREATER_OR_EQUAL_INT(0, rd);
+    /* Small sequential reads fill a window ahead of the position */
+    for (size_t off = 0; off < 2048; off += sizeof(buf)) {
+        TEST_ASSERT_EQUAL(sizeof(buf), read(rd, buf, sizeof(buf)));
+        TEST_ASSERT_EQUAL_MEMORY(data + off, buf, sizeof(buf));
+    }
+    TEST_ASSERT_EQUAL(2048, lseek(rd, 0, SEEK_CUR));
+
+    /* pread neither moves the position nor breaks the sequence */
+    TEST_ASSERT_EQUAL(sizeof(buf), pread(rd, buf, sizeof(buf), 9000));
+    TEST_ASSERT_EQUAL_MEMORY(data + 9000, buf, sizeof(buf));
+    TEST_ASSERT_EQUAL(sizeof(buf), read(rd, buf, sizeof(buf)));
+    TEST_ASSERT_EQUAL_MEMORY(data + 2048, buf, sizeof(buf));
+
+    /* A write over data already in the window is seen on the next read */
+    memset(data + 2064, 0x5a, sizeof(buf));
+    TEST_ASSERT_EQUAL(sizeof(buf), pwrite(rd, data + 2064, sizeof(buf), 2064));
+    TEST_ASSERT_EQUAL(2064, lseek(rd, 0, SEEK_CUR));
+    TEST_ASSERT_EQUAL(sizeof(buf), read(rd, buf, sizeof(buf)));
+    TEST_ASSERT_EQUAL_MEMORY(data + 2064, buf, sizeof(buf));
+    TEST_ASSERT_EQUAL(0, fsync(rd));
+
+    /* Reading across block ends and up to EOF */
+    TEST_ASSERT_EQUAL(4000, lseek(rd, 4000, SEEK_SET));
+    for (size_t off = 4000; off < size; off += sizeof(buf)) {
+        TEST_ASSERT_EQUAL(MIN(sizeof(buf), size - off), read(rd, buf, sizeof(buf)));
+        TEST_ASSERT_EQUAL_MEMORY(data + off, buf, MIN(sizeof(buf), size - off));
+    }
+    TEST_ASSERT_EQUAL(0, read(rd, buf, sizeof(buf)));
+    TEST_ASSERT_EQUAL(0, close(rd));
+
+    free(data);
+    test_teardown();
+}
+
+TEST_CASE("small appends read back in order and survive a remount", "[littlefs]")
+{
+    const char *path = littlefs_base_path "/appends.bin";
+    const size_t count = 300;
+    uint8_t rec[12], buf[12];
+    esp_littlefs_write_stats_t stats;
+
+    test_setup();
+
+    int fd = open(path, O_CREAT | O_RDWR | O_TRUNC);
+    TEST_ASSERT_GREATER_OR_EQUAL_INT(0, fd);
+    TEST_ESP_OK(esp_littlefs_write_stats_reset(littlefs_test_partition_label));
+    for (size_t i = 0; i < count; i++) {
+        memset(rec, (uint8_t)i, sizeof(rec));
+        TEST_ASSERT_EQUAL(sizeof(rec), write(fd, rec, sizeof(rec)));
+    }
+    /* Position, size and contents already include every write */
+    TEST_ASSERT_EQUAL(count * sizeof(rec), lseek(fd, 0, SEEK_CUR));
+    struct stat st;
+    TEST_ASSERT_EQUAL(0, fstat(fd, &st));
+    TEST_ASSERT_EQUAL(count * sizeof(rec), st.st_size);
+    TEST_ASSERT_EQUAL(sizeof(buf), pread(fd, buf, sizeof(buf), 100 * sizeof(rec)));
+    TEST_ASSERT_EACH_EQUAL_UINT8(100, buf, sizeof(buf));
+
+    /* After the barrier everything written so far is committed */
+    TEST_ESP_OK(esp_littlefs_write_barrier(littlefs_test_partition_label));
+    TEST_ESP_OK(esp_littlefs_write_stats(littlefs_test_partition_label, &stats));
+#ifdef CONFIG_LITTLEFS_WRITE_BEHIND
+    TEST_ASSERT_GREATER_THAN(0, stats.writes_deferred);
+#else
+    TEST_ASSERT_EQUAL(0, stats.writes_deferred);
+#endif
+    memset(rec, 0xee, sizeof(rec));
+    TEST_ASSERT_EQUAL(sizeof(rec), write(fd, rec, sizeof(rec)));
+    TEST_ASSERT_EQUAL(0, fsync(fd));
+    TEST_ASSERT_EQUAL(0, close(fd));
+    TEST_ESP_OK(esp_littlefs_write_barrier(littlefs_test_partition_label));
+
+    TEST_ESP_OK(esp_vfs_littlefs_unregister(littlefs_test_partition_label));
+    const esp_vfs_littlefs_conf_t conf = {
+        .base_path = littlefs_base_path,
+        .partition_label = littlefs_test_partition_label,
+        .format_if_mount_failed = false
+    };
+    TEST_ESP_OK(esp_vfs_littlefs_register(&conf));
+
+    fd = open(path, O_RDONLY);
+    TEST_ASSERT_GREATER_OR_EQUAL_INT(0, fd);
+    for (size_t i = 0; i < count; i++) {
+        TEST_ASSERT_EQUAL(sizeof(buf), read(fd, buf, sizeof(buf)));
+        TEST_ASSERT_EACH_EQUAL_UINT8((uint8_t)i, buf, sizeof(buf));
+    }
+    TEST_ASSERT_EQUAL(sizeof(buf), read(fd, buf, sizeof(buf)));
+    TEST_ASSERT_EACH_EQUAL_UINT8(0xee, buf, sizeof(buf));
+    TEST_ASSERT_EQUAL(0, read(fd, buf, sizeof(buf)));
+    TEST_ASSERT_EQUAL(0, close(fd));
+
+    test_teardown();
+}
+
+typedef struct {
+    int fd;
+    uint8_t *buf;
+    size_t size;
+    ssize_t result;
+    int err;                /* errno is per task */
+    SemaphoreHandle_t started;
+    SemaphoreHandle_t done;
+} pinned_read_arg_t;
+
+static void pinned_read_task(void *param)
+{
+    pinned_read_arg_t *args = (pinned_read_arg_t *)param;
+    xSemaphoreGive(args->started);
+    args->result = read(args->fd, args->buf, args->size);
+    args->err = errno;
+    xSemaphoreGive(args->done);
+    vTaskDelete(NULL);
+}
+
+/* Starts one large read() of path on another task and returns once it runs */
+static void start_pinned_read(pinned_read_arg_t *args, const char *path, size_t size)
+{
+    args->fd = open(path, O_RDONLY);
+    TEST_ASSERT_GREATER_OR_EQUAL_INT(0, args->fd);
+    args->size = size;
+    args->result = 0;
+    xTaskCreatePinnedToCore(&pinned_read_task, "pinned_rd", 4096, args, 3, NULL, portNUM_PROCESSORS - 1);
+    TEST_ASSERT_TRUE(xSemaphoreTake(args->started, pdMS_TO_TICKS(1000)));
+}
+
+/* The read either finished before the descriptor went away or never started */
+static void check_pinned_read(pinned_read_arg_t *args)
+{
+    TEST_ASSERT_TRUE(xSemaphoreTake(args->done, pdMS_TO_TICKS(5000)));
+    if (args->result >= 0) {
+        TEST_ASSERT_EQUAL(args->size, args->result);
+        TEST_ASSERT_EACH_EQUAL_UINT8(0x5a, args->buf, args->size);
+    } else {
+        TEST_ASSERT_EQUAL(EBADF, args->err);
+    }
+}
+
+TEST_CASE("close and unmount wait for a chunked read on another task", "[littlefs]")
+{
+    const char *path = littlefs_base_path "/pinned.bin";
+    const size_t size = 32 * 1024;
+    pinned_read_arg_t args = {
+        .started = xSemaphoreCreateBinary(),
+        .done = xSemaphoreCreateBinary(),
+    };
+    uint8_t *data = malloc(size);
+    args.buf = malloc(size);
+    TEST_ASSERT_NOT_NULL(data);
+    TEST_ASSERT_NOT_NULL(args.buf);
+    memset(data, 0x5a, size);
+
+    test_setup();
+
+    int fd = open(path, O_CREAT | O_WRONLY | O_TRUNC);
+    TEST_ASSERT_GREATER_OR_EQUAL_INT(0, fd);
+    TEST_ASSERT_EQUAL(size, write(fd, data, size));
+    TEST_ASSERT_EQUAL(0, close(fd));
+
+    /* close() returns as soon as the read unpins, without a polling delay */
+    start_pinned_read(&args, path, size);
+    TEST_ASSERT_EQUAL(0, close(args.fd));
+    check_pinned_read(&args);
+
+    /* Unregistering frees the descriptor only after the read is done with it */
+    start_pinned_read(&args, path, size);
+    TEST_ESP_OK(esp_vfs_littlefs_unregister(littlefs_test_partition_label));
+    check_pinned_read(&args);
+
+    const esp_vfs_littlefs_conf_t conf = {
+        .base_path = littlefs_base_path,
+        .partition_label = littlefs_test_partition_label,
+        .format_if_mount_failed = false
+    };
+    TEST_ESP_OK(esp_vfs_littlefs_register(&conf));
+
+    vSemaphoreDelete(args.started);
+    vSemaphoreDelete(args.done);
+    free(args.buf);
+    free(data);
+    test_teardown();
+}
+
+#ifdef CONFIG_LITTLEFS_MMAP_PARTITION
+TEST_CASE("esp_littlefs_file_map returns file data in place", "[littlefs]")
+{
+    const char *path = littlefs_base_path "/mapped.bin";
+    const size_t size = 3 * 4096 + 123;  // spans several blocks
+    const void *data;
+    size_t len, offset, calls = 0;
+
+    test_setup();
+
+    uint8_t *expected = malloc(size);
+    TEST_ASSERT_NOT_NULL(expected);
+    for (size_t i = 0; i < size; i++) {
+        expected[i] = (uint8_t)(i * 7 + i / 251);
+    }
+    FILE *f = fopen(path, "wb");
+    TEST_ASSERT_NOT_NULL(f);
+    TEST_ASSERT_EQUAL(size, fwrite(expected, 1, size, f));
+    fclose(f);
+
+    int fd = open(path, O_RDONLY);
+    TEST_ASSERT_GREATER_OR_EQUAL_INT(0, fd);
+    for (offset = 0; offset < size; offset += len, calls++) {
+        TEST_ESP_OK(esp_littlefs_file_map(fd, offset, size - offset, &data, &len));
+        TEST_ASSERT_GREATER_THAN(0, len);
+        TEST_ASSERT_LESS_OR_EQUAL(4096, len);
+        TEST_ASSERT_EQUAL_MEMORY(expected + offset, data, len);
+    }
+    TEST_ASSERT_EQUAL(size, offset);
+    TEST_ASSERT_GREATER_THAN(3, calls);
+
+    /* Past the end */
+    TEST_ESP_OK(esp_littlefs_file_map(fd, size, 16, &data, &len));
+    TEST_ASSERT_EQUAL(0, len);
+    /* The file position is untouched */
+    TEST_ASSERT_EQUAL(0, lseek(fd, 0, SEEK_CUR));
+    close(fd);
+
+    /* A descriptor with unsynced writes falls back */
+    fd = open(path, O_WRONLY | O_APPEND);
+    TEST_ASSERT_GREATER_OR_EQUAL_INT(0, fd);
+    TEST_ASSERT_EQUAL(1, write(fd, "x", 1));
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_SUPPORTED, esp_littlefs_file_map(fd, 0, 16, &data, &len));
+    close(fd);
+
+    /* Inlined small files fall back too */
+    test_littlefs_create_file_with_text(littlefs_base_path "/hello.txt", littlefs_test_hello_str);
+    fd = open(littlefs_base_path "/hello.txt", O_RDONLY);
+    TEST_ASSERT_GREATER_OR_EQUAL_INT(0, fd);
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_SUPPORTED, esp_littlefs_file_map(fd, 0, 16, &data, &len));
+    close(fd);
+
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, esp_littlefs_file_map(fd, 0, 16, &data, &len));
+
+    free(expected);
+    test_teardown();
+}
+#endif
+
 /**
  * Cannot use buitin `stat` since it depends on CONFIG_VFS_SUPPORT_DIR.
  */
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Streaming JSON writer for fixed-schema MQTT payloads. Writes straight into a
+// caller-owned buffer (no tree, no malloc) and formats numbers/strings exactly
+// like cJSON_PrintUnformatted so payloads stay byte-identical.
+
+typedef struct {
+    char *buf;
+    size_t cap;
+    size_t len;
+    bool need_comma;
+    bool overflow;
+} json_writer_t;
+
+void json_writer_init(json_writer_t *w, char *buf, size_t cap);
+
+void json_writer_begin_object(json_writer_t *w);
+void json_writer_end_object(json_writer_t *w);
+// "key":{ ... close with json_writer_end_object()
+void json_writer_begin_object_key(json_writer_t *w, const char *key);
+// "key":[ ... close with json_writer_end_array(). Inside an array pass a NULL
+// key to the value writers (and here, for nested arrays).
+void json_writer_begin_array(json_writer_t *w, const char *key);
+void json_writer_end_array(json_writer_t *w);
+
+void json_writer_string(json_writer_t *w, const char *key, const char *value);
+void json_writer_bool(json_writer_t *w, const char *key, bool value);
+void json_writer_number(json_writer_t *w, const char *key, double value);
+void json_writer_null(json_writer_t *w, const char *key);
+
+// NUL-terminated payload, or NULL if the buffer was too small
+const char *json_writer_finish(json_writer_t *w);
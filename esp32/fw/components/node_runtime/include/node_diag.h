@@ -0,0 +1,14 @@
+#pragma once
+
+#include "json_writer.h"
+#include "runtime_diag.h"
+
+// Shared fields of the pots/<id>/diag payload, so every node image encodes a
+// runtime_diag_t the same way. The caller opens the object, adds its own
+// fields (identity, command queues, link quality) between the two calls and
+// closes it.
+
+// "uptimeS", "cpuIdlePct" (when CPU shares are valid) and "heap":{...}
+void node_diag_write_system(json_writer_t *w, const runtime_diag_t *diag);
+// "tasks":[{"name","cpuPct","stackFree"}], skipping tasks that are not running
+void node_diag_write_tasks(json_writer_t *w, const runtime_diag_t *diag);
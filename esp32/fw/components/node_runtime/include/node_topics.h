@@ -0,0 +1,10 @@
+#pragma once
+
+// MQTT topic tree shared by every node image (canonical schema). Each format
+// takes the device id.
+#define SENSORS_TOPIC_FMT       "pots/%s/sensors"
+#define SENSORS_BATCH_TOPIC_FMT "pots/%s/sensors/batch"
+#define STATUS_TOPIC_FMT        "pots/%s/status"
+#define COMMAND_TOPIC_FMT       "pots/%s/command"
+#define DIAG_TOPIC_FMT          "pots/%s/diag"
+#define LOGS_TOPIC_FMT          "pots/%s/logs"
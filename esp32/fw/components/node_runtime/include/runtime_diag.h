@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Runtime performance snapshot for the pots/<id>/diag topic: per-task CPU
+// share and stack headroom, heap, and the queues feeding the command task.
+// CPU shares need CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS and cover the time
+// since the previous snapshot (since boot for the first one).
+
+#define RUNTIME_DIAG_TASK_MAX 6
+#define RUNTIME_DIAG_LANE_COUNT 2   // command lanes: priority, normal
+
+typedef struct {
+    const char *name;
+    bool found;                 // false if no task of that name is running
+    uint8_t cpu_pct;
+    uint32_t stack_free_bytes;  // high-water mark: least stack ever left free
+} runtime_diag_task_t;
+
+typedef struct {
+    uint32_t uptime_s;
+    bool cpu_valid;
+    uint8_t cpu_idle_pct;       // both cores' idle tasks, averaged
+    size_t task_count;
+    runtime_diag_task_t tasks[RUNTIME_DIAG_TASK_MAX];
+    uint32_t heap_free;
+    uint32_t heap_min_free;
+    uint32_t heap_largest_free;
+    // Filled by the command task and the MQTT client's owner; nodes without
+    // command lanes leave them zero
+    struct {
+        uint32_t depth;
+        uint32_t len;
+        uint32_t drops;
+        uint32_t coalesced;
+    } command_lanes[RUNTIME_DIAG_LANE_COUNT];
+    int mqtt_outbox_bytes;      // -1 if unknown
+} runtime_diag_t;
+
+// Snapshot the named tasks (at most RUNTIME_DIAG_TASK_MAX) and the heap.
+// CPU shares are tracked per list position, so pass the same list every
+// time, always from the same task.
+void runtime_diag_collect(const char *const *task_names, size_t task_count, runtime_diag_t *out);
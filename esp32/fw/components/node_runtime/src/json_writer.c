@@ -0,0 +1,198 @@
+#include "json_writer.h"
+
+#include <float.h>
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+static void put_raw(json_writer_t *w, const char *data, size_t len)
+{
+    if (w->overflow) {
+        return;
+    }
+    // Keep one byte for the terminator
+    if (len >= w->cap - w->len) {
+        w->overflow = true;
+        return;
+    }
+    memcpy(&w->buf[w->len], data, len);
+    w->len += len;
+}
+
+static void put_byte(json_writer_t *w, char c)
+{
+    put_raw(w, &c, 1);
+}
+
+static void put_escaped(json_writer_t *w, const char *s)
+{
+    // Same escape set as cJSON print_string_ptr; bytes >= 0x80 pass through
+    put_byte(w, '"');
+    const char *run = s;
+    for (; *s; ++s) {
+        unsigned char c = (unsigned char)*s;
+        const char *esc = NULL;
+        switch (c) {
+        case '"': esc = "\\\""; break;
+        case '\\': esc = "\\\\"; break;
+        case '\b': esc = "\\b"; break;
+        case '\f': esc = "\\f"; break;
+        case '\n': esc = "\\n"; break;
+        case '\r': esc = "\\r"; break;
+        case '\t': esc = "\\t"; break;
+        default:
+            if (c >= 32) {
+                continue;
+            }
+            break;
+        }
+        put_raw(w, run, (size_t)(s - run));
+        run = s + 1;
+        if (esc) {
+            put_raw(w, esc, strlen(esc));
+        } else {
+            char hex[7];
+            snprintf(hex, sizeof(hex), "\\u%04x", c);
+            put_raw(w, hex, 6);
+        }
+    }
+    put_raw(w, run, (size_t)(s - run));
+    put_byte(w, '"');
+}
+
+// A NULL key writes a bare value (array element)
+static void put_key(json_writer_t *w, const char *key)
+{
+    if (w->need_comma) {
+        put_byte(w, ',');
+    }
+    if (key) {
+        put_escaped(w, key);
+        put_byte(w, ':');
+    }
+    w->need_comma = true;
+}
+
+static bool doubles_equal(double a, double b)
+{
+    double max_val = fabs(a) > fabs(b) ? fabs(a) : fabs(b);
+    return fabs(a - b) <= max_val * DBL_EPSILON;
+}
+
+// Same saturation as cJSON_SetNumberHelper
+static int json_valueint(double value)
+{
+    if (value >= (double)INT_MAX) {
+        return INT_MAX;
+    }
+    if (value <= (double)INT_MIN) {
+        return INT_MIN;
+    }
+    return (int)value;
+}
+
+void json_writer_init(json_writer_t *w, char *buf, size_t cap)
+{
+    w->buf = buf;
+    w->cap = cap;
+    w->len = 0;
+    w->need_comma = false;
+    w->overflow = (buf == NULL || cap == 0);
+}
+
+void json_writer_begin_object(json_writer_t *w)
+{
+    if (w->need_comma) {
+        put_byte(w, ',');
+    }
+    put_byte(w, '{');
+    w->need_comma = false;
+}
+
+void json_writer_begin_object_key(json_writer_t *w, const char *key)
+{
+    put_key(w, key);
+    put_byte(w, '{');
+    w->need_comma = false;
+}
+
+void json_writer_end_object(json_writer_t *w)
+{
+    put_byte(w, '}');
+    w->need_comma = true;
+}
+
+void json_writer_begin_array(json_writer_t *w, const char *key)
+{
+    put_key(w, key);
+    put_byte(w, '[');
+    w->need_comma = false;
+}
+
+void json_writer_end_array(json_writer_t *w)
+{
+    put_byte(w, ']');
+    w->need_comma = true;
+}
+
+void json_writer_string(json_writer_t *w, const char *key, const char *value)
+{
+    // cJSON_AddStringToObject drops the member when value is NULL
+    if (!value) {
+        return;
+    }
+    put_key(w, key);
+    put_escaped(w, value);
+}
+
+void json_writer_bool(json_writer_t *w, const char *key, bool value)
+{
+    put_key(w, key);
+    if (value) {
+        put_raw(w, "true", 4);
+    } else {
+        put_raw(w, "false", 5);
+    }
+}
+
+void json_writer_null(json_writer_t *w, const char *key)
+{
+    put_key(w, key);
+    put_raw(w, "null", 4);
+}
+
+void json_writer_number(json_writer_t *w, const char *key, double value)
+{
+    put_key(w, key);
+
+    // Mirrors cJSON print_number: integral values that fit valueint print as %d,
+    // everything else as %1.15g unless that does not round-trip.
+    char num[26];
+    int n;
+    if (isnan(value) || isinf(value)) {
+        n = snprintf(num, sizeof(num), "null");
+    } else if (value == (double)json_valueint(value)) {
+        n = snprintf(num, sizeof(num), "%d", json_valueint(value));
+    } else {
+        double check = 0.0;
+        n = snprintf(num, sizeof(num), "%1.15g", value);
+        if (sscanf(num, "%lg", &check) != 1 || !doubles_equal(check, value)) {
+            n = snprintf(num, sizeof(num), "%1.17g", value);
+        }
+    }
+    if (n < 0 || (size_t)n >= sizeof(num)) {
+        w->overflow = true;
+        return;
+    }
+    put_raw(w, num, (size_t)n);
+}
+
+const char *json_writer_finish(json_writer_t *w)
+{
+    if (w->overflow) {
+        return NULL;
+    }
+    w->buf[w->len] = '\0';
+    return w->buf;
+}
@@ -0,0 +1,36 @@
+#include "node_diag.h"
+
+#include <stddef.h>
+
+void node_diag_write_system(json_writer_t *w, const runtime_diag_t *diag)
+{
+    json_writer_number(w, "uptimeS", diag->uptime_s);
+    if (diag->cpu_valid) {
+        json_writer_number(w, "cpuIdlePct", diag->cpu_idle_pct);
+    }
+
+    json_writer_begin_object_key(w, "heap");
+    json_writer_number(w, "free", diag->heap_free);
+    json_writer_number(w, "minFree", diag->heap_min_free);
+    json_writer_number(w, "largestFree", diag->heap_largest_free);
+    json_writer_end_object(w);
+}
+
+void node_diag_write_tasks(json_writer_t *w, const runtime_diag_t *diag)
+{
+    json_writer_begin_array(w, "tasks");
+    for (size_t i = 0; i < diag->task_count; ++i) {
+        const runtime_diag_task_t *task = &diag->tasks[i];
+        if (!task->found) {
+            continue;
+        }
+        json_writer_begin_object(w);
+        json_writer_string(w, "name", task->name);
+        if (diag->cpu_valid) {
+            json_writer_number(w, "cpuPct", task->cpu_pct);
+        }
+        json_writer_number(w, "stackFree", task->stack_free_bytes);
+        json_writer_end_object(w);
+    }
+    json_writer_end_array(w);
+}
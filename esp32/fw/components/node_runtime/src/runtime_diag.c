@@ -0,0 +1,125 @@
+#include "runtime_diag.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "sdkconfig.h"
+
+#if CONFIG_FREERTOS_USE_TRACE_FACILITY && CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+#define RUNTIME_DIAG_CPU 1
+#else
+#define RUNTIME_DIAG_CPU 0
+#endif
+
+// Room for tasks created between sizing the array and taking the snapshot
+#define RUNTIME_DIAG_TASK_SLACK 4
+
+#if RUNTIME_DIAG_CPU
+// Run-time counters at the previous snapshot, per watched task name
+typedef struct {
+    configRUN_TIME_COUNTER_TYPE total;
+    configRUN_TIME_COUNTER_TYPE idle;
+    configRUN_TIME_COUNTER_TYPE task[RUNTIME_DIAG_TASK_MAX];
+} runtime_diag_prev_t;
+
+static runtime_diag_prev_t prev;
+
+static uint8_t share_pct(configRUN_TIME_COUNTER_TYPE part, configRUN_TIME_COUNTER_TYPE whole)
+{
+    if (whole == 0) {
+        return 0;
+    }
+    uint64_t pct = ((uint64_t)part * 100u + whole / 2) / whole;
+    return pct > 100 ? 100 : (uint8_t)pct;
+}
+
+static bool is_idle_task(const char *name)
+{
+    return strncmp(name, "IDLE", 4) == 0;
+}
+
+static void collect_tasks(runtime_diag_t *out)
+{
+    UBaseType_t cap = uxTaskGetNumberOfTasks() + RUNTIME_DIAG_TASK_SLACK;
+    TaskStatus_t *status = malloc(cap * sizeof(TaskStatus_t));
+    if (!status) {
+        return;
+    }
+    configRUN_TIME_COUNTER_TYPE total = 0;
+    UBaseType_t n = uxTaskGetSystemState(status, cap, &total);
+    if (n == 0) {
+        free(status);
+        return;
+    }
+
+    // The total is wall time; spread over every core it is the CPU time
+    configRUN_TIME_COUNTER_TYPE elapsed = (total - prev.total) * portNUM_PROCESSORS;
+    configRUN_TIME_COUNTER_TYPE idle = 0;
+    configRUN_TIME_COUNTER_TYPE counters[RUNTIME_DIAG_TASK_MAX] = {0};
+    for (UBaseType_t i = 0; i < n; ++i) {
+        if (is_idle_task(status[i].pcTaskName)) {
+            idle += status[i].ulRunTimeCounter;
+        }
+        for (size_t t = 0; t < out->task_count; ++t) {
+            runtime_diag_task_t *task = &out->tasks[t];
+            if (strcmp(status[i].pcTaskName, task->name) != 0) {
+                continue;
+            }
+            task->found = true;
+            task->stack_free_bytes = status[i].usStackHighWaterMark * sizeof(StackType_t);
+            counters[t] = status[i].ulRunTimeCounter;
+            task->cpu_pct = share_pct(counters[t] - prev.task[t], elapsed);
+        }
+    }
+    free(status);
+
+    out->cpu_valid = elapsed > 0;
+    out->cpu_idle_pct = share_pct(idle - prev.idle, elapsed);
+    prev.total = total;
+    prev.idle = idle;
+    memcpy(prev.task, counters, sizeof(prev.task));
+}
+#else
+static void collect_tasks(runtime_diag_t *out)
+{
+    // No run-time stats: stack headroom only, looked up by name
+    for (size_t t = 0; t < out->task_count; ++t) {
+        runtime_diag_task_t *task = &out->tasks[t];
+        TaskHandle_t handle = xTaskGetHandle(task->name);
+        if (handle) {
+            task->found = true;
+            task->stack_free_bytes = uxTaskGetStackHighWaterMark(handle) * sizeof(StackType_t);
+        }
+    }
+}
+#endif
+
+void runtime_diag_collect(const char *const *task_names, size_t task_count, runtime_diag_t *out)
+{
+    if (!out) {
+        return;
+    }
+    memset(out, 0, sizeof(*out));
+    out->mqtt_outbox_bytes = -1;
+    out->uptime_s = (uint32_t)(esp_timer_get_time() / 1000000);
+
+    if (!task_names) {
+        task_count = 0;
+    }
+    if (task_count > RUNTIME_DIAG_TASK_MAX) {
+        task_count = RUNTIME_DIAG_TASK_MAX;
+    }
+    for (size_t t = 0; t < task_count; ++t) {
+        out->tasks[t].name = task_names[t];
+    }
+    out->task_count = task_count;
+    collect_tasks(out);
+
+    out->heap_free = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+    out->heap_min_free = heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT);
+    out->heap_largest_free = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+}
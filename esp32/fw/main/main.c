@@ -9,6 +9,7 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/event_groups.h"
+#include "freertos/semphr.h"
 
 #include "esp_system.h"
 #include "esp_event.h"
@@ -30,9 +31,20 @@
 
 #include "sdkconfig.h"
 
+#include "json_writer.h"
+#include "node_diag.h"
+#include "node_topics.h"
+#include "runtime_diag.h"
+
+#include "ota_update.h"
+
 static const char *TAG = "projectplant";
 
 #define MAX_CONNECT_FAILS 5
+#define DIAG_PAYLOAD_MAX  512
+
+// Tasks reported in the diag payload
+static const char *const s_diag_tasks[] = {"telemetry", "button", "mqtt_task", "ota"};
 
 // Event group bits
 static EventGroupHandle_t s_event_group;
@@ -47,9 +59,10 @@ static int s_connect_fails = 0;
 
 // Topics and IDs
 static char s_device_id[13]; // 6 bytes MAC -> 12 hex + null
-static char s_topic_tele[64];
+static char s_topic_diag[64];
 static char s_topic_state[64];
 static char s_topic_cmd[64];
+static char s_topic_ota[64];
 
 // Forward decls
 static void start_provisioning(void);
@@ -82,6 +95,28 @@ static void button_task(void *arg);
 #define CONFIG_PROJECTPLANT_PROV_POP "plantpop"
 #endif
 
+#ifndef CONFIG_PROJECTPLANT_MQTT_V5
+#define CONFIG_PROJECTPLANT_MQTT_V5 0
+#endif
+
+#if CONFIG_PROJECTPLANT_MQTT_V5 && ESP_IDF_VERSION < ESP_IDF_VERSION_VAL(5, 0, 0)
+#error "CONFIG_PROJECTPLANT_MQTT_V5 needs the ESP-IDF v5 MQTT client"
+#endif
+
+#if CONFIG_PROJECTPLANT_MQTT_V5
+// Telemetry goes out at QoS 0 under a topic alias. Aliases last one
+// connection: the first publish after a connect carries the topic too.
+#define TELE_TOPIC_ALIAS 1
+
+// esp_mqtt5_client_set_publish_property() applies to the next publish from
+// any task, so the pair runs under s_publish_lock. The MQTT task holds the
+// client lock while it runs mqtt_event_handler and so only tries the lock.
+static SemaphoreHandle_t s_publish_lock = NULL;
+static uint32_t s_connection_serial = 0;
+static uint32_t s_tele_alias_serial = 0;
+static volatile bool s_online_pending = false;
+#endif
+
 static void get_device_id(char *out, size_t len)
 {
     uint8_t mac[6] = {0};
@@ -93,9 +128,11 @@ static void get_device_id(char *out, size_t len)
 
 static void build_topics(void)
 {
-    snprintf(s_topic_tele, sizeof(s_topic_tele), "plant/%s/tele", s_device_id);
+    // Telemetry shares the pots' diag topic and payload (node_runtime)
+    snprintf(s_topic_diag, sizeof(s_topic_diag), DIAG_TOPIC_FMT, s_device_id);
     snprintf(s_topic_state, sizeof(s_topic_state), "plant/%s/state", s_device_id);
     snprintf(s_topic_cmd, sizeof(s_topic_cmd), "plant/%s/cmd", s_device_id);
+    snprintf(s_topic_ota, sizeof(s_topic_ota), "plant/%s/ota", s_device_id);
 }
 
 static esp_err_t nvs_get_str_alloc(nvs_handle_t nvs, const char *key, char **out)
@@ -252,6 +289,26 @@ static void start_wifi(void)
     ESP_ERROR_CHECK(esp_wifi_start());
 }
 
+static void publish_ota_status(const char *status, TickType_t wait)
+{
+    if (!s_mqtt) return;
+#if CONFIG_PROJECTPLANT_MQTT_V5
+    // Keep clear of the telemetry task's property + publish pair
+    if (xSemaphoreTake(s_publish_lock, wait) != pdTRUE) return;
+    esp_mqtt_client_publish(s_mqtt, s_topic_ota, status, 0, 1, false);
+    xSemaphoreGive(s_publish_lock);
+#else
+    (void)wait;
+    esp_mqtt_client_publish(s_mqtt, s_topic_ota, status, 0, 1, false);
+#endif
+}
+
+// Status from the OTA task, which holds no other lock
+static void ota_status(const char *status)
+{
+    publish_ota_status(status, portMAX_DELAY);
+}
+
 static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_t event_id, void *event_data)
 {
     esp_mqtt_event_handle_t event = (esp_mqtt_event_handle_t) event_data;
@@ -259,10 +316,28 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
     case MQTT_EVENT_CONNECTED:
         ESP_LOGI(TAG, "MQTT connected");
         xEventGroupSetBits(s_event_group, MQTT_CONNECTED_BIT);
+        // Reaching the broker is what makes a freshly updated image good
+        ota_update_confirm();
+#if CONFIG_PROJECTPLANT_MQTT_V5
+        s_connection_serial++;
+        // A resumed session still holds the command subscription
+        if (!event->session_present) {
+            esp_mqtt_client_subscribe(s_mqtt, s_topic_cmd, 1);
+        }
+        // The telemetry task may be between its property and its publish;
+        // it then publishes the state after its own message
+        if (xSemaphoreTake(s_publish_lock, 0) == pdTRUE) {
+            esp_mqtt_client_publish(s_mqtt, s_topic_state, "online", 0, 1, true);
+            xSemaphoreGive(s_publish_lock);
+        } else {
+            s_online_pending = true;
+        }
+#else
         // Subscribe to command topic
         esp_mqtt_client_subscribe(s_mqtt, s_topic_cmd, 1);
         // Publish state online
         esp_mqtt_client_publish(s_mqtt, s_topic_state, "online", 0, 1, true);
+#endif
         break;
     case MQTT_EVENT_DISCONNECTED:
         ESP_LOGW(TAG, "MQTT disconnected");
@@ -278,7 +353,7 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
         ESP_LOGI(TAG, "MQTT data on %s: %s", topic, data);
 
         if (strcmp(topic, s_topic_cmd) == 0) {
-            // Simple commands: 'provision', 'set_broker <uri>'
+            // Simple commands: 'provision', 'set_broker <uri>', 'ota <url>'
             if (strncmp(data, "provision", 9) == 0) {
                 enter_reprovision();
             } else if (strncmp(data, "set_broker ", 11) == 0) {
@@ -288,6 +363,13 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
                 // Reconnect MQTT with new broker
                 mqtt_stop();
                 mqtt_start();
+            } else if (strncmp(data, "ota ", 4) == 0) {
+                esp_err_t err = ota_update_start(data + 4, ota_status);
+                if (err != ESP_OK) {
+                    ESP_LOGW(TAG, "OTA not started: %s", esp_err_to_name(err));
+                    // The MQTT task holds the client lock: only try s_publish_lock
+                    publish_ota_status(err == ESP_ERR_INVALID_STATE ? "error update already running" : "error bad URL", 0);
+                }
             }
         }
         break; }
@@ -321,6 +403,11 @@ static void mqtt_start(void)
             .client_id = s_device_id,
         },
     };
+#if CONFIG_PROJECTPLANT_MQTT_V5
+    // The broker keeps the session for PROJECTPLANT_MQTT_SESSION_EXPIRY_S
+    cfg.session.protocol_ver = MQTT_PROTOCOL_V_5;
+    cfg.session.disable_clean_session = true;
+#endif
 #else
     esp_mqtt_client_config_t cfg = {
         .uri = broker,
@@ -332,7 +419,20 @@ static void mqtt_start(void)
     };
 #endif
 
+#if CONFIG_PROJECTPLANT_MQTT_V5
+    if (!s_publish_lock) {
+        s_publish_lock = xSemaphoreCreateMutex();
+        ESP_ERROR_CHECK(s_publish_lock ? ESP_OK : ESP_ERR_NO_MEM);
+    }
+#endif
+
     s_mqtt = esp_mqtt_client_init(&cfg);
+#if CONFIG_PROJECTPLANT_MQTT_V5
+    esp_mqtt5_connection_property_config_t connect_property = {
+        .session_expiry_interval = CONFIG_PROJECTPLANT_MQTT_SESSION_EXPIRY_S,
+    };
+    ESP_ERROR_CHECK(esp_mqtt5_client_set_connect_property(s_mqtt, &connect_property));
+#endif
     ESP_ERROR_CHECK(esp_mqtt_client_register_event(s_mqtt, ESP_EVENT_ANY_ID, mqtt_event_handler, NULL));
     ESP_ERROR_CHECK(esp_mqtt_client_start(s_mqtt));
 
@@ -353,21 +453,57 @@ static void mqtt_stop(void)
     }
 }
 
+static void publish_telemetry(const char *payload)
+{
+#if CONFIG_PROJECTPLANT_MQTT_V5
+    xSemaphoreTake(s_publish_lock, portMAX_DELAY);
+    const char *topic = s_topic_diag;
+    esp_mqtt5_publish_property_config_t property = {
+        .topic_alias = TELE_TOPIC_ALIAS,
+    };
+    // Fails if the broker allows no topic aliases; the full topic goes out
+    bool aliased = esp_mqtt5_client_set_publish_property(s_mqtt, &property) == ESP_OK;
+    if (aliased && s_tele_alias_serial == s_connection_serial) {
+        topic = "";
+    }
+    if (esp_mqtt_client_publish(s_mqtt, topic, payload, 0, 0, false) >= 0 && aliased) {
+        s_tele_alias_serial = s_connection_serial;
+    }
+    if (s_online_pending) {
+        s_online_pending = false;
+        esp_mqtt_client_publish(s_mqtt, s_topic_state, "online", 0, 1, true);
+    }
+    xSemaphoreGive(s_publish_lock);
+#else
+    esp_mqtt_client_publish(s_mqtt, s_topic_diag, payload, 0, 0, false);
+#endif
+}
+
 static void telemetry_task(void *arg)
 {
     while (1) {
         EventBits_t bits = xEventGroupGetBits(s_event_group);
         if ((bits & MQTT_CONNECTED_BIT) != 0 && s_mqtt) {
-            // Gather simple telemetry: uptime and RSSI
-            int64_t uptime_ms = esp_timer_get_time() / 1000;
+            runtime_diag_t diag;
+            runtime_diag_collect(s_diag_tasks, sizeof(s_diag_tasks) / sizeof(s_diag_tasks[0]), &diag);
             wifi_ap_record_t ap = (wifi_ap_record_t){0};
-            int rssi = 0;
+
+            char payload[DIAG_PAYLOAD_MAX];
+            json_writer_t w;
+            json_writer_init(&w, payload, sizeof(payload));
+            json_writer_begin_object(&w);
+            json_writer_string(&w, "potId", s_device_id);
+            node_diag_write_system(&w, &diag);
             if (esp_wifi_sta_get_ap_info(&ap) == ESP_OK) {
-                rssi = ap.rssi;
+                json_writer_number(&w, "rssi", ap.rssi);
+            }
+            node_diag_write_tasks(&w, &diag);
+            json_writer_end_object(&w);
+            if (json_writer_finish(&w)) {
+                publish_telemetry(payload);
+            } else {
+                ESP_LOGW(TAG, "Diag payload exceeds %u bytes", (unsigned)sizeof(payload));
             }
-            char payload[128];
-            snprintf(payload, sizeof(payload), "uptime_ms=%lld rssi=%d", (long long)uptime_ms, rssi);
-            esp_mqtt_client_publish(s_mqtt, s_topic_tele, payload, 0, 0, false);
         }
         vTaskDelay(pdMS_TO_TICKS(CONFIG_PROJECTPLANT_TELEMETRY_SEC * 1000));
     }
@@ -411,6 +547,9 @@ void app_main(void)
 
     s_event_group = xEventGroupCreate();
 
+    // After an update: roll back unless MQTT connects in time
+    ota_update_check_pending();
+
     ESP_ERROR_CHECK(esp_netif_init());
     ESP_ERROR_CHECK(esp_event_loop_create_default());
     esp_netif_create_default_wifi_sta();
@@ -425,7 +564,7 @@ void app_main(void)
     get_device_id(s_device_id, sizeof(s_device_id));
     build_topics();
     ESP_LOGI(TAG, "Device ID: %s", s_device_id);
-    ESP_LOGI(TAG, "Topics: tele=%s state=%s cmd=%s", s_topic_tele, s_topic_state, s_topic_cmd);
+    ESP_LOGI(TAG, "Topics: diag=%s state=%s cmd=%s", s_topic_diag, s_topic_state, s_topic_cmd);
 
     // Button setup
     gpio_config_t io = {
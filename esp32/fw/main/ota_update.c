@@ -0,0 +1,469 @@
+/* ProjectPlant ESP32 firmware
+ * Streaming OTA: HTTP body -> (inflate) -> (delta) -> inactive ota_N slot
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "esp_app_format.h"
+#include "esp_http_client.h"
+#include "esp_log.h"
+#include "esp_ota_ops.h"
+#include "esp_partition.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#if CONFIG_MBEDTLS_CERTIFICATE_BUNDLE
+#include "esp_crt_bundle.h"
+#endif
+
+// tinfl from the chip ROM: inflate costs no flash
+#include "miniz.h"
+
+#include "sdkconfig.h"
+
+#include "ota_update.h"
+
+static const char *TAG = "ota";
+
+#ifndef CONFIG_PROJECTPLANT_OTA_CONFIRM_TIMEOUT_S
+#define CONFIG_PROJECTPLANT_OTA_CONFIRM_TIMEOUT_S 300
+#endif
+
+// Packed body written by tools/ota_pack.py (little-endian):
+//   "PPOT", version u8, kind u8, reserved u16, image size u32,
+//   base SHA-256 [32]: the digest idf.py appends to the base image (delta
+//   only, zero for full packs)
+// then one zlib stream. A full pack inflates to the image itself; a delta
+// inflates to ops that rebuild the image from the running slot:
+//   0x01 src u32, len u32   copy len bytes of the running slot from src
+//   0x02 len u32, bytes     len literal bytes
+#define PACK_MAGIC        "PPOT"
+#define PACK_VERSION      1
+#define PACK_KIND_FULL    1
+#define PACK_KIND_DELTA   2
+#define PACK_HEADER_LEN   44
+#define OP_COPY           0x01
+#define OP_DATA           0x02
+#define OP_COPY_LEN       9
+#define OP_DATA_LEN       5
+
+#define OTA_URL_MAX          256
+#define OTA_HTTP_BUF         2048
+#define OTA_COPY_BUF         1024
+#define OTA_HTTP_TIMEOUT_MS  15000
+#define OTA_TASK_STACK       6144
+#define OTA_REBOOT_DELAY_MS  1000
+
+typedef enum {
+    FORMAT_PENDING = 0,
+    FORMAT_RAW,
+    FORMAT_FULL,
+    FORMAT_DELTA,
+} ota_format_t;
+
+typedef struct {
+    ota_format_t format;
+    uint8_t header[PACK_HEADER_LEN];
+    size_t header_len;
+    uint32_t image_size;          // 0 for raw images: not known up front
+    uint32_t written;
+    const esp_partition_t *running;
+    const esp_partition_t *target;
+    esp_ota_handle_t handle;
+    bool begun;
+
+    tinfl_decompressor *inflator;
+    uint8_t *dict;                // TINFL_LZ_DICT_SIZE circular window
+    size_t dict_ofs;
+    bool inflate_done;
+
+    uint8_t op[OP_COPY_LEN];      // delta op header being assembled
+    size_t op_len;
+    uint32_t data_left;           // literal bytes still due for a DATA op
+    uint8_t *copy_buf;
+
+    const char *error;
+} ota_stream_t;
+
+static char s_url[OTA_URL_MAX];
+static ota_update_status_cb_t s_status_cb = NULL;
+static volatile bool s_busy = false;
+#if CONFIG_BOOTLOADER_APP_ROLLBACK_ENABLE
+static esp_timer_handle_t s_confirm_timer = NULL;
+#endif
+
+static uint32_t get_le32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static esp_err_t fail(ota_stream_t *s, const char *error, esp_err_t err)
+{
+    if (!s->error) {
+        s->error = error;
+    }
+    return err;
+}
+
+static esp_err_t image_write(ota_stream_t *s, const uint8_t *data, size_t len)
+{
+    if (s->image_size && len > s->image_size - s->written) {
+        return fail(s, "image longer than its header says", ESP_ERR_INVALID_SIZE);
+    }
+    // esp_ota_write erases sector by sector and rejects a bad first byte
+    esp_err_t err = esp_ota_write(s->handle, data, len);
+    if (err != ESP_OK) {
+        return fail(s, "flash write failed", err);
+    }
+    s->written += len;
+    return ESP_OK;
+}
+
+static esp_err_t copy_from_running(ota_stream_t *s, uint32_t src, uint32_t len)
+{
+    if (src > s->running->size || len > s->running->size - src) {
+        return fail(s, "delta copy outside the running slot", ESP_ERR_INVALID_ARG);
+    }
+    while (len) {
+        size_t n = len < OTA_COPY_BUF ? len : OTA_COPY_BUF;
+        esp_err_t err = esp_partition_read(s->running, src, s->copy_buf, n);
+        if (err != ESP_OK) {
+            return fail(s, "running slot read failed", err);
+        }
+        err = image_write(s, s->copy_buf, n);
+        if (err != ESP_OK) {
+            return err;
+        }
+        src += n;
+        len -= n;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t delta_feed(ota_stream_t *s, const uint8_t *data, size_t len)
+{
+    while (len) {
+        if (s->data_left) {
+            size_t n = len < s->data_left ? len : s->data_left;
+            esp_err_t err = image_write(s, data, n);
+            if (err != ESP_OK) {
+                return err;
+            }
+            data += n;
+            len -= n;
+            s->data_left -= n;
+            continue;
+        }
+        s->op[s->op_len++] = *data++;
+        len--;
+        size_t need = s->op[0] == OP_COPY ? OP_COPY_LEN : s->op[0] == OP_DATA ? OP_DATA_LEN : 0;
+        if (!need) {
+            return fail(s, "unknown delta op", ESP_ERR_INVALID_RESPONSE);
+        }
+        if (s->op_len < need) {
+            continue;
+        }
+        s->op_len = 0;
+        if (s->op[0] == OP_COPY) {
+            esp_err_t err = copy_from_running(s, get_le32(&s->op[1]), get_le32(&s->op[5]));
+            if (err != ESP_OK) {
+                return err;
+            }
+        } else {
+            s->data_left = get_le32(&s->op[1]);
+        }
+    }
+    return ESP_OK;
+}
+
+static esp_err_t inflate_feed(ota_stream_t *s, const uint8_t *in, size_t len)
+{
+    while (!s->inflate_done) {
+        size_t in_size = len;
+        size_t out_size = TINFL_LZ_DICT_SIZE - s->dict_ofs;
+        tinfl_status status = tinfl_decompress(s->inflator, in, &in_size, s->dict, s->dict + s->dict_ofs, &out_size,
+                                               TINFL_FLAG_PARSE_ZLIB_HEADER | TINFL_FLAG_HAS_MORE_INPUT);
+        in += in_size;
+        len -= in_size;
+        if (out_size) {
+            const uint8_t *out = s->dict + s->dict_ofs;
+            esp_err_t err = s->format == FORMAT_DELTA ? delta_feed(s, out, out_size) : image_write(s, out, out_size);
+            if (err != ESP_OK) {
+                return err;
+            }
+            s->dict_ofs = (s->dict_ofs + out_size) & (TINFL_LZ_DICT_SIZE - 1);
+        }
+        if (status == TINFL_STATUS_DONE) {
+            s->inflate_done = true;
+        } else if (status < TINFL_STATUS_DONE) {
+            return fail(s, "corrupt compressed stream", ESP_ERR_INVALID_RESPONSE);
+        } else if (status == TINFL_STATUS_NEEDS_MORE_INPUT && len == 0) {
+            return ESP_OK;
+        }
+    }
+    if (len) {
+        return fail(s, "data after the compressed stream", ESP_ERR_INVALID_SIZE);
+    }
+    return ESP_OK;
+}
+
+static esp_err_t stream_begin(ota_stream_t *s)
+{
+    if (s->format != FORMAT_RAW) {
+        if (memcmp(s->header, PACK_MAGIC, 4) != 0 || s->header[4] != PACK_VERSION ||
+            (s->header[5] != PACK_KIND_FULL && s->header[5] != PACK_KIND_DELTA)) {
+            return fail(s, "not an app image or OTA pack", ESP_ERR_INVALID_VERSION);
+        }
+        s->format = s->header[5] == PACK_KIND_DELTA ? FORMAT_DELTA : FORMAT_FULL;
+        s->image_size = get_le32(&s->header[8]);
+        if (s->image_size == 0 || s->image_size > s->target->size) {
+            return fail(s, "image does not fit the OTA slot", ESP_ERR_INVALID_SIZE);
+        }
+        if (s->format == FORMAT_DELTA) {
+            uint8_t digest[32];
+            if (esp_partition_get_sha256(s->running, digest) != ESP_OK || memcmp(digest, &s->header[12], sizeof(digest)) != 0) {
+                return fail(s, "delta was made against a different image", ESP_ERR_INVALID_STATE);
+            }
+            s->copy_buf = malloc(OTA_COPY_BUF);
+        }
+        s->inflator = malloc(sizeof(tinfl_decompressor));
+        s->dict = malloc(TINFL_LZ_DICT_SIZE);
+        if (!s->inflator || !s->dict || (s->format == FORMAT_DELTA && !s->copy_buf)) {
+            return fail(s, "out of memory", ESP_ERR_NO_MEM);
+        }
+        tinfl_init(s->inflator);
+    }
+    esp_err_t err = esp_ota_begin(s->target, OTA_WITH_SEQUENTIAL_WRITES, &s->handle);
+    if (err != ESP_OK) {
+        return fail(s, "esp_ota_begin failed", err);
+    }
+    s->begun = true;
+    ESP_LOGI(TAG, "Writing %s image to %s", s->format == FORMAT_RAW ? "plain" : s->format == FORMAT_FULL ? "compressed" : "delta",
+             s->target->label);
+    return ESP_OK;
+}
+
+static esp_err_t stream_feed(ota_stream_t *s, const uint8_t *in, size_t len)
+{
+    if (s->format == FORMAT_PENDING) {
+        if (s->header_len == 0 && in[0] == ESP_IMAGE_HEADER_MAGIC) {
+            s->format = FORMAT_RAW;
+        } else {
+            size_t n = PACK_HEADER_LEN - s->header_len;
+            n = len < n ? len : n;
+            memcpy(&s->header[s->header_len], in, n);
+            s->header_len += n;
+            in += n;
+            len -= n;
+            if (s->header_len < PACK_HEADER_LEN) {
+                return ESP_OK;
+            }
+            s->format = FORMAT_FULL;
+        }
+        esp_err_t err = stream_begin(s);
+        if (err != ESP_OK) {
+            return err;
+        }
+        if (!len) {
+            return ESP_OK;
+        }
+    }
+    return s->format == FORMAT_RAW ? image_write(s, in, len) : inflate_feed(s, in, len);
+}
+
+static esp_err_t stream_finish(ota_stream_t *s)
+{
+    if (!s->begun) {
+        return fail(s, "empty download", ESP_ERR_INVALID_SIZE);
+    }
+    if (s->format != FORMAT_RAW &&
+        (!s->inflate_done || s->op_len || s->data_left || s->written != s->image_size)) {
+        return fail(s, "download ended early", ESP_ERR_INVALID_SIZE);
+    }
+    s->begun = false;
+    // Checks the segments, checksum and appended SHA-256 (and the signature
+    // with secure boot) of what landed in flash
+    esp_err_t err = esp_ota_end(s->handle);
+    if (err != ESP_OK) {
+        return fail(s, "image verification failed", err);
+    }
+    err = esp_ota_set_boot_partition(s->target);
+    if (err != ESP_OK) {
+        return fail(s, "could not select the new slot", err);
+    }
+    return ESP_OK;
+}
+
+static void stream_release(ota_stream_t *s)
+{
+    if (s->begun) {
+        esp_ota_abort(s->handle);
+        s->begun = false;
+    }
+    free(s->inflator);
+    free(s->dict);
+    free(s->copy_buf);
+}
+
+static void report(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+
+static void report(const char *fmt, ...)
+{
+    char status[OTA_URL_MAX + 32];
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(status, sizeof(status), fmt, args);
+    va_end(args);
+    ESP_LOGI(TAG, "%s", status);
+    if (s_status_cb) {
+        s_status_cb(status);
+    }
+}
+
+static esp_err_t download(ota_stream_t *s, size_t *received)
+{
+    esp_http_client_config_t cfg = {
+        .url = s_url,
+        .timeout_ms = OTA_HTTP_TIMEOUT_MS,
+#if CONFIG_MBEDTLS_CERTIFICATE_BUNDLE
+        .crt_bundle_attach = esp_crt_bundle_attach,
+#endif
+    };
+    esp_http_client_handle_t client = esp_http_client_init(&cfg);
+    if (!client) {
+        return fail(s, "bad URL", ESP_ERR_INVALID_ARG);
+    }
+    uint8_t *buf = malloc(OTA_HTTP_BUF);
+    esp_err_t err = buf ? esp_http_client_open(client, 0) : ESP_ERR_NO_MEM;
+    if (err != ESP_OK) {
+        fail(s, buf ? "connect failed" : "out of memory", err);
+        goto out;
+    }
+    esp_http_client_fetch_headers(client);
+    int status = esp_http_client_get_status_code(client);
+    if (status != 200) {
+        ESP_LOGW(TAG, "HTTP status %d", status);
+        err = fail(s, "HTTP status not 200", ESP_ERR_INVALID_RESPONSE);
+        goto out;
+    }
+    for (;;) {
+        int n = esp_http_client_read(client, (char *)buf, OTA_HTTP_BUF);
+        if (n < 0) {
+            err = fail(s, "download failed", ESP_FAIL);
+            break;
+        }
+        if (n == 0) {
+            err = esp_http_client_is_complete_data_received(client) ? stream_finish(s)
+                                                                    : fail(s, "connection closed early", ESP_FAIL);
+            break;
+        }
+        *received += (size_t)n;
+        err = stream_feed(s, buf, (size_t)n);
+        if (err != ESP_OK) {
+            break;
+        }
+    }
+out:
+    free(buf);
+    esp_http_client_close(client);
+    esp_http_client_cleanup(client);
+    return err;
+}
+
+static void ota_task(void *arg)
+{
+    int64_t started_us = esp_timer_get_time();
+    ota_stream_t stream = {
+        .running = esp_ota_get_running_partition(),
+        .target = esp_ota_get_next_update_partition(NULL),
+    };
+    size_t received = 0;
+    report("started %s", s_url);
+
+    esp_err_t err = stream.target ? download(&stream, &received) : fail(&stream, "no OTA slot", ESP_ERR_NOT_FOUND);
+    uint32_t written = stream.written;
+    stream_release(&stream);
+    if (err != ESP_OK) {
+        report("error %s (%s)", stream.error ? stream.error : "failed", esp_err_to_name(err));
+        s_busy = false;
+        vTaskDelete(NULL);
+        return;
+    }
+    report("done in=%u out=%" PRIu32 " ms=%lld", (unsigned)received, written,
+           (long long)((esp_timer_get_time() - started_us) / 1000));
+    // Give the status publish a moment to leave before the reboot
+    vTaskDelay(pdMS_TO_TICKS(OTA_REBOOT_DELAY_MS));
+    esp_restart();
+}
+
+esp_err_t ota_update_start(const char *url, ota_update_status_cb_t status_cb)
+{
+    if (!url || !url[0] || strlen(url) >= sizeof(s_url)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_busy) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    s_busy = true;
+    strcpy(s_url, url);
+    s_status_cb = status_cb;
+    if (xTaskCreate(ota_task, "ota", OTA_TASK_STACK, NULL, 5, NULL) != pdPASS) {
+        s_busy = false;
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+#if CONFIG_BOOTLOADER_APP_ROLLBACK_ENABLE
+static bool running_pending_verify(void)
+{
+    esp_ota_img_states_t state;
+    return esp_ota_get_state_partition(esp_ota_get_running_partition(), &state) == ESP_OK &&
+           state == ESP_OTA_IMG_PENDING_VERIFY;
+}
+
+static void confirm_timeout(void *arg)
+{
+    ESP_LOGE(TAG, "New image never became healthy; rolling back");
+    esp_ota_mark_app_invalid_rollback_and_reboot();
+}
+#endif
+
+void ota_update_check_pending(void)
+{
+#if CONFIG_BOOTLOADER_APP_ROLLBACK_ENABLE
+    if (!running_pending_verify()) {
+        return;
+    }
+    ESP_LOGW(TAG, "Running a new image; rolling back unless MQTT connects within %d s",
+             CONFIG_PROJECTPLANT_OTA_CONFIRM_TIMEOUT_S);
+    const esp_timer_create_args_t args = {
+        .callback = confirm_timeout,
+        .name = "ota_confirm",
+    };
+    if (esp_timer_create(&args, &s_confirm_timer) == ESP_OK) {
+        esp_timer_start_once(s_confirm_timer, (uint64_t)CONFIG_PROJECTPLANT_OTA_CONFIRM_TIMEOUT_S * 1000000ULL);
+    }
+#endif
+}
+
+void ota_update_confirm(void)
+{
+#if CONFIG_BOOTLOADER_APP_ROLLBACK_ENABLE
+    if (!running_pending_verify()) {
+        return;
+    }
+    if (s_confirm_timer) {
+        esp_timer_stop(s_confirm_timer);
+    }
+    if (esp_ota_mark_app_valid_cancel_rollback() == ESP_OK) {
+        ESP_LOGI(TAG, "New image confirmed");
+    }
+#endif
+}
@@ -0,0 +1,29 @@
+/* ProjectPlant ESP32 firmware
+ * Streaming OTA into the inactive ota_0/ota_1 slot
+ */
+
+#pragma once
+
+#include "esp_err.h"
+
+// Called from the OTA task with one-line status text:
+//   "started <url>", "done in=<bytes> out=<bytes> ms=<ms>", "error <reason>"
+typedef void (*ota_update_status_cb_t)(const char *status);
+
+// Download url into the next OTA slot and reboot into it. The body is one
+// of (detected from its first bytes):
+//   - a plain app image as built by idf.py (magic 0xE9)
+//   - a packed image from tools/ota_pack.py: zlib compressed, either the
+//     full image or a delta against the running image
+// Everything is written to flash as it arrives; nothing is staged in RAM
+// beyond the inflate window. Returns ESP_ERR_INVALID_STATE while an update
+// is already running.
+esp_err_t ota_update_start(const char *url, ota_update_status_cb_t status_cb);
+
+// Call once the device is healthy (MQTT connected). After an update the
+// bootloader rolls back to the previous slot unless this runs within
+// CONFIG_PROJECTPLANT_OTA_CONFIRM_TIMEOUT_S of boot.
+void ota_update_confirm(void);
+
+// Arm the confirm timeout for a freshly updated image; call from app_main
+void ota_update_check_pending(void);
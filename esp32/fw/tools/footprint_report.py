@@ -0,0 +1,110 @@
+#!/usr/bin/env python3
+"""Compare per-component flash and RAM between ESP-IDF size reports.
+
+    idf.py -C esp32/fw size-components --format json > fw-before.json
+    (apply the change, rebuild)
+    idf.py -C esp32/fw size-components --format json > fw-after.json
+    footprint_report.py fw-before.json fw-after.json
+
+Takes two or more `idf.py size-components --format json` outputs (anything
+idf.py prints before the JSON object is skipped) and prints a Markdown table
+with one column pair per report: the image bytes each component adds to the
+app image (everything except .bss) and the internal RAM it takes (everything
+except flash.* sections). Components that are the same size in every report
+are left out unless named with --components. The last column is the change
+from the first report to the last.
+"""
+
+from __future__ import annotations
+
+import argparse
+import json
+import sys
+from pathlib import Path
+
+SKIPPED_KEYS = ("total", "other")
+
+
+def load_report(path: Path) -> dict[str, tuple[int, int]]:
+    text = path.read_text()
+    start = text.find("{")
+    if start < 0:
+        raise SystemExit(f"{path}: no JSON object found")
+    try:
+        data = json.loads(text[start:])
+    except json.JSONDecodeError as exc:
+        raise SystemExit(f"{path}: {exc}") from None
+
+    sizes: dict[str, tuple[int, int]] = {}
+    for archive, sections in data.items():
+        if not isinstance(sections, dict):
+            continue
+        flash = ram = 0
+        for key, value in sections.items():
+            if not isinstance(value, int) or key.lower() in SKIPPED_KEYS:
+                continue
+            key = key.lower()
+            if "bss" not in key:
+                flash += value
+            if "flash" not in key:
+                ram += value
+        sizes[component_name(archive)] = (flash, ram)
+    if not sizes:
+        raise SystemExit(f"{path}: not a size-components report")
+    return sizes
+
+
+def component_name(archive: str) -> str:
+    """libesp_littlefs.a -> esp_littlefs"""
+    name = Path(archive).name
+    if name.startswith("lib"):
+        name = name[3:]
+    if name.endswith(".a"):
+        name = name[:-2]
+    return name
+
+
+def signed(value: int) -> str:
+    return f"{value:+d}" if value else "0"
+
+
+def main(argv: list[str] | None = None) -> int:
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("reports", type=Path, nargs="+", help="size-components JSON outputs, oldest first")
+    parser.add_argument("--components", default="", help="comma-separated components to always list")
+    args = parser.parse_args(argv)
+    if len(args.reports) < 2:
+        parser.error("need at least two reports to compare")
+
+    reports = [load_report(path) for path in args.reports]
+    always = {name.strip() for name in args.components.split(",") if name.strip()}
+    names = sorted(set().union(*reports))
+    rows = []
+    for name in names:
+        sizes = [report.get(name, (0, 0)) for report in reports]
+        if name in always or len(set(sizes)) > 1:
+            rows.append((name, sizes))
+
+    header = ["component"]
+    for path in args.reports:
+        header += [f"{path.stem} flash", f"{path.stem} RAM"]
+    header += ["flash change", "RAM change"]
+    print("| " + " | ".join(header) + " |")
+    print("|" + "---|" * len(header))
+
+    def emit(name: str, sizes: list[tuple[int, int]]) -> None:
+        cells = [name]
+        for flash, ram in sizes:
+            cells += [str(flash), str(ram)]
+        cells += [signed(sizes[-1][0] - sizes[0][0]), signed(sizes[-1][1] - sizes[0][1])]
+        print("| " + " | ".join(cells) + " |")
+
+    for name, sizes in rows:
+        emit(name, sizes)
+    totals = [(sum(f for f, _ in report.values()), sum(r for _, r in report.values())) for report in reports]
+    emit("**total**", totals)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,142 @@
+#!/usr/bin/env python3
+"""Pack an app image for the firmware's streaming OTA (main/ota_update.c).
+
+    ota_pack.py full  build/projectplant_fw.bin -o fw.ppota
+    ota_pack.py delta --base old.bin build/projectplant_fw.bin -o fw-delta.ppota
+
+A full pack is the zlib-compressed image. A delta pack only applies on a
+device running exactly the --base image: it rebuilds the new image from
+COPY ops against the running slot and literal DATA, and is zlib-compressed
+as well. Serve the result over HTTP(S) and send `ota <url>` on the device's
+command topic; plain .bin files are accepted too.
+"""
+
+from __future__ import annotations
+
+import argparse
+import struct
+import sys
+import zlib
+from pathlib import Path
+
+MAGIC = b"PPOT"
+VERSION = 1
+KIND_FULL = 1
+KIND_DELTA = 2
+OP_COPY = 0x01
+OP_DATA = 0x02
+
+IMAGE_MAGIC = 0xE9
+HASH_APPENDED_OFFSET = 23  # esp_image_header_t.hash_appended
+DIGEST_LEN = 32
+
+# Matches shorter than this cost more as a COPY op than as literal bytes
+MIN_MATCH = 16
+INDEX_STEP = 4
+
+
+def check_image(data: bytes, name: str) -> None:
+    if len(data) < 24 + DIGEST_LEN or data[0] != IMAGE_MAGIC:
+        raise SystemExit(f"{name}: not an ESP app image")
+
+
+def image_digest(data: bytes, name: str) -> bytes:
+    # esp_partition_get_sha256() on the running slot returns this digest
+    if data[HASH_APPENDED_OFFSET] != 1:
+        raise SystemExit(f"{name}: image has no appended SHA-256")
+    return data[-DIGEST_LEN:]
+
+
+def header(kind: int, size: int, base_digest: bytes = bytes(DIGEST_LEN)) -> bytes:
+    return MAGIC + struct.pack("<BBHI", VERSION, kind, 0, size) + base_digest
+
+
+def delta_ops(base: bytes, target: bytes) -> bytes:
+    """Greedy COPY/DATA ops that rebuild target from base."""
+    index: dict[bytes, int] = {}
+    for pos in range(0, len(base) - MIN_MATCH + 1, INDEX_STEP):
+        index.setdefault(base[pos:pos + MIN_MATCH], pos)
+
+    ops = bytearray()
+    literal_start = 0
+    offset = 0  # base - target displacement of the last copy
+
+    def flush_literal(end: int) -> None:
+        if end > literal_start:
+            ops.extend(struct.pack("<BI", OP_DATA, end - literal_start))
+            ops.extend(target[literal_start:end])
+
+    i = 0
+    while i + MIN_MATCH <= len(target):
+        key = target[i:i + MIN_MATCH]
+        # Code that moved keeps its displacement: try that before the index
+        src = i + offset
+        if not (0 <= src and base[src:src + MIN_MATCH] == key):
+            src = index.get(key, -1)
+        if src < 0:
+            i += 1
+            continue
+        # Grow the match backwards into pending literals, then forwards
+        while i > literal_start and src > 0 and base[src - 1] == target[i - 1]:
+            i -= 1
+            src -= 1
+        length = MIN_MATCH
+        while i + length < len(target) and src + length < len(base) and target[i + length] == base[src + length]:
+            length += 1
+        flush_literal(i)
+        ops.extend(struct.pack("<BII", OP_COPY, src, length))
+        offset = src - i
+        i += length
+        literal_start = i
+    flush_literal(len(target))
+    return bytes(ops)
+
+
+def apply_ops(base: bytes, ops: bytes) -> bytes:
+    """Reference decoder, mirrors delta_feed() in main/ota_update.c."""
+    out = bytearray()
+    pos = 0
+    while pos < len(ops):
+        op = ops[pos]
+        if op == OP_COPY:
+            src, length = struct.unpack_from("<II", ops, pos + 1)
+            out.extend(base[src:src + length])
+            pos += 9
+        elif op == OP_DATA:
+            (length,) = struct.unpack_from("<I", ops, pos + 1)
+            out.extend(ops[pos + 5:pos + 5 + length])
+            pos += 5 + length
+        else:
+            raise ValueError(f"unknown op {op:#x} at {pos}")
+    return bytes(out)
+
+
+def main(argv: list[str] | None = None) -> int:
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("kind", choices=("full", "delta"))
+    parser.add_argument("image", type=Path, help="new app image (build/<project>.bin)")
+    parser.add_argument("--base", type=Path, help="image the devices run now (delta only)")
+    parser.add_argument("-o", "--output", type=Path, required=True)
+    args = parser.parse_args(argv)
+
+    image = args.image.read_bytes()
+    check_image(image, str(args.image))
+    if args.kind == "full":
+        packed = header(KIND_FULL, len(image)) + zlib.compress(image, 9)
+    else:
+        if not args.base:
+            parser.error("delta needs --base")
+        base = args.base.read_bytes()
+        check_image(base, str(args.base))
+        ops = delta_ops(base, image)
+        if apply_ops(base, ops) != image:
+            raise SystemExit("internal error: delta does not rebuild the image")
+        packed = header(KIND_DELTA, len(image), image_digest(base, str(args.base))) + zlib.compress(ops, 9)
+
+    args.output.write_bytes(packed)
+    print(f"{args.output}: {len(packed)} bytes, {100.0 * len(packed) / len(image):.1f}% of {len(image)}")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,1289 @@
+// Fleet load generator: many simulated pots, each on its own MQTT 3.1.1
+// connection to a real broker (mosquitto/mosquitto.conf), publishing what the
+// firmware publishes at configurable rates and answering commands on
+// pots/<id>/command. Payloads come from main/plant_mqtt.c itself: every
+// publish and reply is built by the mqtt_publish_*() builders against
+// plant_mqtt_host.c's capturing client, then framed and sent here, so the
+// broker and the hub see byte-for-byte firmware traffic.
+//
+// A controller connection plays the hub's command path: it sends overrides to
+// random pots and times the round trip to the requestId'd status reply.
+// Reconnect storms drop a share of the fleet at once; the pots come back
+// after esp-mqtt's reconnect timeout plus jitter, as a room of pots would
+// after an access point reboot. The report gives publish-to-PUBACK, command
+// round-trip and connect latency percentiles.
+//
+// One thread, non-blocking sockets and epoll; the process needs one file
+// descriptor per pot.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <math.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "hardware_config.h"
+#include "host_platform.h"
+#include "plant_mqtt.h"
+#include "plant_mqtt_host.h"
+
+#define FLEET_VERSION "fleet"
+#define FLEET_RX_MAX 4096
+#define FLEET_INFLIGHT_MAX 32             // esp-mqtt outbox, in messages
+#define FLEET_KEEPALIVE_S 120             // esp-mqtt's default keepalive
+#define FLEET_CONNECT_TIMEOUT_US 10000000LL
+#define FLEET_DRAIN_US 5000000LL          // after the run, for PUBACKs and replies
+#define FLEET_CONTROLLER_ID "fleet-ctl"
+#define FLEET_REQUEST_PREFIX "fleet-"
+
+#define MQTT_CONNECT 0x10
+#define MQTT_CONNACK 0x20
+#define MQTT_PUBLISH 0x30
+#define MQTT_PUBACK 0x40
+#define MQTT_SUBSCRIBE 0x82
+#define MQTT_SUBACK 0x90
+#define MQTT_PINGREQ 0xC0
+#define MQTT_PINGRESP 0xD0
+#define MQTT_DISCONNECT 0xE0
+
+typedef struct {
+    const char *host;
+    const char *port;
+    const char *username;
+    const char *password;
+    uint32_t pots;
+    double duration_s;
+    double ramp_s;
+    double sensor_interval_s;
+    double ping_interval_s;
+    double status_interval_s;
+    double commands_per_s;
+    double storm_interval_s;
+    double storm_fraction;
+    double reconnect_s;
+    double reconnect_jitter_s;
+    double p99_limit_ms;
+    uint64_t seed;
+    bool check;
+} options_t;
+
+typedef enum {
+    CONN_IDLE,       // waiting for the next connect attempt
+    CONN_TCP,        // connect() in progress
+    CONN_MQTT,       // CONNECT sent, waiting for CONNACK
+    CONN_UP,
+} conn_state_t;
+
+typedef enum {
+    PUB_SENSORS,
+    PUB_STATUS,
+    PUB_PING,
+    PUB_REPLY,       // answers to commands, any topic
+    PUB_COMMAND,     // the controller's
+    PUB_KIND_COUNT,
+} pub_kind_t;
+
+static const char *const PUB_NAMES[PUB_KIND_COUNT] = {"sensors", "status", "ping", "reply", "command"};
+
+typedef struct {
+    uint16_t packet_id;      // 0 = free
+    uint8_t kind;
+    int64_t sent_us;
+} inflight_t;
+
+typedef struct {
+    int fd;
+    conn_state_t state;
+    bool controller;
+    bool want_out;           // EPOLLOUT armed
+    char id[32];
+    uint8_t rx[FLEET_RX_MAX];
+    size_t rx_len;
+    uint8_t *tx;
+    size_t tx_len;
+    size_t tx_cap;
+    uint16_t next_packet_id;
+    inflight_t inflight[FLEET_INFLIGHT_MAX];
+    int64_t attempt_started_us;
+    int64_t last_tx_us;
+    int64_t next_attempt_us;
+    int64_t next_sensor_us;
+    int64_t next_ping_us;
+    int64_t next_status_us;
+    int64_t due_us;          // earliest of the timers above; the heap key
+    double moisture_pct;
+    bool connected_once;
+    uint32_t drops;          // connections lost after CONNACK
+} conn_t;
+
+typedef struct {
+    int64_t *values;
+    size_t count;
+    size_t cap;
+} samples_t;
+
+typedef struct {
+    int64_t due_us;
+    uint32_t conn;
+} heap_entry_t;
+
+typedef struct {
+    int64_t sent_us;
+    int64_t answered_us;     // -1 until the reply
+    uint32_t pot;
+    uint32_t pot_drops;      // the pot's drops when sent; a later drop can lose it
+} command_t;
+
+typedef struct {
+    uint64_t published[PUB_KIND_COUNT];
+    uint64_t acked;
+    uint64_t outbox_full;            // QoS 1 publish with FLEET_INFLIGHT_MAX unacked
+    uint64_t connects;
+    uint64_t connect_failures;       // refused, timed out or a CONNACK error
+    uint64_t disconnects;            // closed by the broker
+    uint64_t storm_drops;
+    uint32_t storms;
+    uint64_t commands_received;      // by pots, from anyone
+    uint64_t commands_unknown;       // parsed as MQTT_CMD_UNKNOWN, answered with nothing
+    uint64_t bytes_out;
+    uint64_t bytes_in;
+    samples_t ack_us;
+    samples_t sensors_ack_us;
+    samples_t command_rtt_us;
+    samples_t connect_us;
+} stats_t;
+
+static options_t s_opt = {
+    .host = "127.0.0.1",
+    .port = "1883",
+    .pots = 100,
+    .duration_s = 60,
+    .ramp_s = 10,
+    .sensor_interval_s = MEASUREMENT_INTERVAL_MS / 1000.0,
+    .ping_interval_s = 30,
+    .status_interval_s = 600,
+    .commands_per_s = 1,
+    .storm_fraction = 0.5,
+    .reconnect_s = 10,              // esp-mqtt's reconnect_timeout_ms
+    .reconnect_jitter_s = 2,
+    .p99_limit_ms = 250,
+    .seed = 1,
+};
+static stats_t s_stats;
+static mqtt_command_scratch_t s_scratch;
+static conn_t *s_conns;              // the pots, then the controller
+static uint32_t s_conn_count;
+static struct addrinfo *s_addr;
+static int s_epoll = -1;
+static heap_entry_t *s_heap;
+static size_t s_heap_len;
+static size_t s_heap_cap;
+static command_t *s_commands;
+static size_t s_command_count;
+static size_t s_command_cap;
+static uint32_t s_up_count;
+static volatile sig_atomic_t s_interrupted;
+
+// splitmix64, as in ring_replay.c
+static uint64_t s_rng;
+
+static uint64_t rng_next(void)
+{
+    uint64_t z = (s_rng += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+static double rng_unit(void)
+{
+    return (double)(rng_next() >> 11) / (double)(1ULL << 53);
+}
+
+static double rng_exp(double mean)
+{
+    return -mean * log(1.0 - rng_unit());
+}
+
+static int64_t now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+static uint64_t epoch_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000ULL + (uint64_t)ts.tv_nsec / 1000000ULL;
+}
+
+static int64_t seconds_us(double s)
+{
+    return (int64_t)(s * 1e6);
+}
+
+static void *grow(void *items, size_t *cap, size_t item_size)
+{
+    size_t new_cap = *cap ? *cap * 2 : 1024;
+    void *grown = realloc(items, new_cap * item_size);
+    if (!grown) {
+        fprintf(stderr, "out of memory\n");
+        exit(2);
+    }
+    *cap = new_cap;
+    return grown;
+}
+
+static void sample_add(samples_t *s, int64_t value)
+{
+    if (s->count == s->cap) {
+        s->values = grow(s->values, &s->cap, sizeof(int64_t));
+    }
+    s->values[s->count++] = value;
+}
+
+static int compare_i64(const void *a, const void *b)
+{
+    int64_t x = *(const int64_t *)a;
+    int64_t y = *(const int64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+// Sorts in place; milliseconds
+static void percentiles(samples_t *s, double *p50, double *p90, double *p99, double *max)
+{
+    *p50 = *p90 = *p99 = *max = 0;
+    if (s->count == 0) {
+        return;
+    }
+    qsort(s->values, s->count, sizeof(int64_t), compare_i64);
+    *p50 = s->values[s->count / 2] / 1000.0;
+    *p90 = s->values[s->count * 90 / 100] / 1000.0;
+    *p99 = s->values[s->count * 99 / 100] / 1000.0;
+    *max = s->values[s->count - 1] / 1000.0;
+}
+
+// Timers: a binary heap of (due, connection) with lazy deletion. A
+// connection's current entry is the one whose due matches conn->due_us.
+
+static void heap_push(int64_t due_us, uint32_t conn)
+{
+    if (s_heap_len == s_heap_cap) {
+        s_heap = grow(s_heap, &s_heap_cap, sizeof(heap_entry_t));
+    }
+    size_t i = s_heap_len++;
+    while (i > 0) {
+        size_t parent = (i - 1) / 2;
+        if (s_heap[parent].due_us <= due_us) {
+            break;
+        }
+        s_heap[i] = s_heap[parent];
+        i = parent;
+    }
+    s_heap[i] = (heap_entry_t){due_us, conn};
+}
+
+static heap_entry_t heap_pop(void)
+{
+    heap_entry_t top = s_heap[0];
+    heap_entry_t last = s_heap[--s_heap_len];
+    size_t i = 0;
+    while (true) {
+        size_t child = 2 * i + 1;
+        if (child >= s_heap_len) {
+            break;
+        }
+        if (child + 1 < s_heap_len && s_heap[child + 1].due_us < s_heap[child].due_us) {
+            child++;
+        }
+        if (s_heap[child].due_us >= last.due_us) {
+            break;
+        }
+        s_heap[i] = s_heap[child];
+        i = child;
+    }
+    if (s_heap_len > 0) {
+        s_heap[i] = last;
+    }
+    return top;
+}
+
+static int64_t min_us(int64_t a, int64_t b)
+{
+    return a < b ? a : b;
+}
+
+static void conn_schedule(conn_t *c)
+{
+    int64_t due = INT64_MAX;
+    switch (c->state) {
+    case CONN_IDLE:
+        due = c->next_attempt_us;
+        break;
+    case CONN_TCP:
+    case CONN_MQTT:
+        due = c->attempt_started_us + FLEET_CONNECT_TIMEOUT_US;
+        break;
+    case CONN_UP:
+        due = c->last_tx_us + seconds_us(FLEET_KEEPALIVE_S / 2.0);
+        if (!c->controller) {
+            due = min_us(due, min_us(c->next_sensor_us, min_us(c->next_ping_us, c->next_status_us)));
+        }
+        break;
+    }
+    if (due != c->due_us) {
+        c->due_us = due;
+        if (due != INT64_MAX) {
+            heap_push(due, (uint32_t)(c - s_conns));
+        }
+    }
+}
+
+// Wire format
+
+static void set_out(conn_t *c, bool want)
+{
+    if (c->want_out == want || c->fd < 0) {
+        return;
+    }
+    c->want_out = want;
+    struct epoll_event ev = {
+        .events = EPOLLIN | (want ? EPOLLOUT : 0),
+        .data.u32 = (uint32_t)(c - s_conns),
+    };
+    epoll_ctl(s_epoll, EPOLL_CTL_MOD, c->fd, &ev);
+}
+
+static void conn_close(conn_t *c, int64_t retry_us);
+
+static void flush(conn_t *c)
+{
+    size_t off = 0;
+    while (off < c->tx_len) {
+        ssize_t n = send(c->fd, c->tx + off, c->tx_len - off, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+            if (errno == EINTR) {
+                continue;
+            }
+            s_stats.disconnects++;
+            conn_close(c, now_us() + seconds_us(s_opt.reconnect_s));
+            return;
+        }
+        off += (size_t)n;
+        s_stats.bytes_out += (uint64_t)n;
+    }
+    memmove(c->tx, c->tx + off, c->tx_len - off);
+    c->tx_len -= off;
+    set_out(c, c->tx_len > 0);
+}
+
+static void put(conn_t *c, const void *data, size_t len)
+{
+    while (c->tx_len + len > c->tx_cap) {
+        c->tx = grow(c->tx, &c->tx_cap, 1);
+    }
+    memcpy(c->tx + c->tx_len, data, len);
+    c->tx_len += len;
+}
+
+static void put_u16(conn_t *c, uint16_t v)
+{
+    uint8_t b[2] = {(uint8_t)(v >> 8), (uint8_t)v};
+    put(c, b, 2);
+}
+
+static void put_str(conn_t *c, const char *s)
+{
+    size_t len = strlen(s);
+    put_u16(c, (uint16_t)len);
+    put(c, s, len);
+}
+
+static void put_header(conn_t *c, uint8_t type, size_t remaining)
+{
+    uint8_t b[5];
+    size_t n = 0;
+    b[n++] = type;
+    do {
+        uint8_t digit = remaining % 128;
+        remaining /= 128;
+        b[n++] = digit | (remaining ? 0x80 : 0);
+    } while (remaining && n < sizeof(b));
+    put(c, b, n);
+}
+
+static void send_connect(conn_t *c)
+{
+    // Persistent session, as the firmware (disable_clean_session)
+    uint8_t flags = 0;
+    size_t remaining = 10 + 2 + strlen(c->id);
+    if (s_opt.username) {
+        flags |= 0x80;
+        remaining += 2 + strlen(s_opt.username);
+    }
+    if (s_opt.password) {
+        flags |= 0x40;
+        remaining += 2 + strlen(s_opt.password);
+    }
+    put_header(c, MQTT_CONNECT, remaining);
+    put_str(c, "MQTT");
+    uint8_t level_flags[2] = {4, flags};
+    put(c, level_flags, 2);
+    put_u16(c, FLEET_KEEPALIVE_S);
+    put_str(c, c->id);
+    if (s_opt.username) {
+        put_str(c, s_opt.username);
+    }
+    if (s_opt.password) {
+        put_str(c, s_opt.password);
+    }
+    flush(c);
+}
+
+static uint16_t take_packet_id(conn_t *c)
+{
+    if (++c->next_packet_id == 0) {
+        c->next_packet_id = 1;
+    }
+    return c->next_packet_id;
+}
+
+static void send_subscribe(conn_t *c, const char *filter)
+{
+    put_header(c, MQTT_SUBSCRIBE, 2 + 2 + strlen(filter) + 1);
+    put_u16(c, take_packet_id(c));
+    put_str(c, filter);
+    uint8_t qos = 1;
+    put(c, &qos, 1);
+    flush(c);
+}
+
+static void send_simple(conn_t *c, uint8_t type)
+{
+    put_header(c, type, 0);
+    flush(c);
+}
+
+static void send_puback(conn_t *c, uint16_t packet_id)
+{
+    put_header(c, MQTT_PUBACK, 2);
+    put_u16(c, packet_id);
+    flush(c);
+}
+
+// False when a QoS 1 message finds the outbox full
+static bool send_publish(conn_t *c, pub_kind_t kind, const char *topic, const void *payload, size_t len, int qos,
+                         bool retain)
+{
+    if (c->state != CONN_UP) {
+        return false;
+    }
+    inflight_t *slot = NULL;
+    if (qos > 0) {
+        for (size_t i = 0; i < FLEET_INFLIGHT_MAX && !slot; ++i) {
+            if (c->inflight[i].packet_id == 0) {
+                slot = &c->inflight[i];
+            }
+        }
+        if (!slot) {
+            s_stats.outbox_full++;
+            return false;
+        }
+    }
+    size_t remaining = 2 + strlen(topic) + (qos > 0 ? 2 : 0) + len;
+    put_header(c, (uint8_t)(MQTT_PUBLISH | (qos > 0 ? 0x02 : 0) | (retain ? 0x01 : 0)), remaining);
+    put_str(c, topic);
+    int64_t t = now_us();
+    if (slot) {
+        *slot = (inflight_t){.packet_id = take_packet_id(c), .kind = (uint8_t)kind, .sent_us = t};
+        put_u16(c, slot->packet_id);
+    }
+    put(c, payload, len);
+    c->last_tx_us = t;
+    s_stats.published[kind]++;
+    flush(c);
+    return true;
+}
+
+// Whatever the firmware builder just published through plant_mqtt_host.c
+static void send_captured(conn_t *c, pub_kind_t kind, uint32_t count_before)
+{
+    const plant_mqtt_host_publish_t *pub = plant_mqtt_host_last_publish();
+    if (pub->count == count_before) {
+        return;   // the builder declined (payload too large, bad input)
+    }
+    size_t len = pub->len < sizeof(pub->payload) ? pub->len : sizeof(pub->payload);
+    send_publish(c, kind, pub->topic, pub->payload, len, pub->qos, pub->retain);
+}
+
+// Pots
+
+static void fill_reading(conn_t *c, sensor_reading_t *r)
+{
+    memset(r, 0, sizeof(*r));
+    c->moisture_pct += (rng_unit() - 0.55) * 0.4;
+    c->moisture_pct = fmax(10.0, fmin(90.0, c->moisture_pct));
+    r->timestamp_ms = epoch_ms();
+    r->soil_percent = (float)c->moisture_pct;
+    r->soil_raw = (uint16_t)(SOIL_SENSOR_RAW_DRY - c->moisture_pct / 100.0 * (SOIL_SENSOR_RAW_DRY - SOIL_SENSOR_RAW_WET));
+    r->temperature_c = (float)(21.0 + rng_unit() * 2.0);
+    r->humidity_pct = (float)(50.0 + rng_unit() * 10.0);
+    r->battery_v = (float)(3.9 + rng_unit() * 0.2);
+}
+
+static void pot_publish_reading(conn_t *c, const char *request_id, pub_kind_t kind)
+{
+    sensor_reading_t reading;
+    fill_reading(c, &reading);
+    esp_mqtt_client_handle_t client = plant_mqtt_host_client();
+    uint32_t before = plant_mqtt_host_last_publish()->count;
+    mqtt_publish_reading(client, c->id, &reading, request_id);
+    send_captured(c, kind, before);
+}
+
+static void pot_publish_status(conn_t *c, const char *status, const char *request_id, pub_kind_t kind)
+{
+    uint32_t before = plant_mqtt_host_last_publish()->count;
+    mqtt_publish_status(plant_mqtt_host_client(), c->id, FLEET_VERSION, status, request_id);
+    send_captured(c, kind, before);
+}
+
+static void pot_publish_ping(conn_t *c)
+{
+    uint32_t before = plant_mqtt_host_last_publish()->count;
+    mqtt_publish_ping(plant_mqtt_host_client(), c->id);
+    send_captured(c, PUB_PING, before);
+}
+
+// The replies app_main.c's handle_command() sends, without the outputs
+static void pot_handle_command(conn_t *c, const char *payload, size_t len)
+{
+    s_stats.commands_received++;
+    mqtt_command_t cmd = mqtt_parse_command(payload, (int)len, &s_scratch);
+    const char *request_id = cmd.request_id[0] ? cmd.request_id : NULL;
+    switch (cmd.type) {
+    case MQTT_CMD_PUMP_OVERRIDE:
+        pot_publish_status(c, cmd.pump_on ? (cmd.water_target_pct > 0 ? "watering_started" : "pump_on") : "pump_off",
+                           request_id, PUB_REPLY);
+        break;
+    case MQTT_CMD_IC_ZONE1_OVERRIDE:
+        pot_publish_status(c, cmd.ic_zone1_on ? "ic_zone1_on" : "ic_zone1_off", request_id, PUB_REPLY);
+        break;
+    case MQTT_CMD_FAN_OVERRIDE:
+        pot_publish_status(c, cmd.fan_on ? "fan_on" : "fan_off", request_id, PUB_REPLY);
+        break;
+    case MQTT_CMD_MISTER_OVERRIDE:
+        pot_publish_status(c, cmd.mister_on ? "mister_on" : "mister_off", request_id, PUB_REPLY);
+        break;
+    case MQTT_CMD_LIGHT_OVERRIDE:
+        pot_publish_status(c, cmd.light_on ? "light_on" : "light_off", request_id, PUB_REPLY);
+        break;
+    case MQTT_CMD_SENSOR_READ:
+        pot_publish_reading(c, request_id, PUB_REPLY);
+        break;
+    case MQTT_CMD_DIAG_READ: {
+        runtime_diag_t diag;
+        memset(&diag, 0, sizeof(diag));
+        diag.mqtt_outbox_bytes = -1;
+        uint32_t before = plant_mqtt_host_last_publish()->count;
+        mqtt_publish_diag(plant_mqtt_host_client(), c->id, &diag, request_id);
+        send_captured(c, PUB_REPLY, before);
+        break;
+    }
+    case MQTT_CMD_SCENE: {
+        uint32_t before = plant_mqtt_host_last_publish()->count;
+        mqtt_publish_scene_status(plant_mqtt_host_client(), c->id, FLEET_VERSION, "scene_applied", &cmd.scene,
+                                  request_id);
+        send_captured(c, PUB_REPLY, before);
+        break;
+    }
+    case MQTT_CMD_HISTORY_QUERY:
+        pot_publish_status(c, "history_started", request_id, PUB_REPLY);
+        break;
+    case MQTT_CMD_LOG_READ:
+        pot_publish_status(c, "log_read_started", request_id, PUB_REPLY);
+        break;
+    case MQTT_CMD_CONFIG_UPDATE:
+        pot_publish_status(c, cmd.has_schedule ? "schedule_updated" : "config_updated", request_id, PUB_REPLY);
+        break;
+    default:
+        s_stats.commands_unknown++;
+        break;
+    }
+}
+
+static void pot_timers(conn_t *c, int64_t t)
+{
+    if (t >= c->next_sensor_us) {
+        pot_publish_reading(c, NULL, PUB_SENSORS);
+        c->next_sensor_us += seconds_us(s_opt.sensor_interval_s);
+    }
+    if (t >= c->next_ping_us) {
+        pot_publish_ping(c);
+        c->next_ping_us += seconds_us(s_opt.ping_interval_s);
+    }
+    if (t >= c->next_status_us) {
+        pot_publish_status(c, "online", NULL, PUB_STATUS);
+        c->next_status_us += seconds_us(s_opt.status_interval_s);
+    }
+}
+
+// Controller
+
+static void controller_handle_status(const char *payload, size_t len)
+{
+    static const char key[] = "\"requestId\":\"" FLEET_REQUEST_PREFIX;
+    const char *end = payload + len;
+    const char *p = payload;
+    while (p + sizeof(key) - 1 <= end && memcmp(p, key, sizeof(key) - 1) != 0) {
+        ++p;
+    }
+    if (p + sizeof(key) - 1 > end) {
+        return;
+    }
+    size_t index = 0;
+    for (p += sizeof(key) - 1; p < end && *p >= '0' && *p <= '9'; ++p) {
+        index = index * 10 + (size_t)(*p - '0');
+    }
+    if (index < s_command_count && s_commands[index].answered_us < 0) {
+        s_commands[index].answered_us = now_us();
+        sample_add(&s_stats.command_rtt_us, s_commands[index].answered_us - s_commands[index].sent_us);
+    }
+}
+
+static conn_t *controller(void)
+{
+    return &s_conns[s_opt.pots];
+}
+
+static void controller_send_command(void)
+{
+    conn_t *ctl = controller();
+    if (ctl->state != CONN_UP || s_up_count <= 1) {
+        return;
+    }
+    conn_t *pot = NULL;
+    for (int tries = 0; tries < 16 && !pot; ++tries) {
+        conn_t *pick = &s_conns[rng_next() % s_opt.pots];
+        pot = pick->state == CONN_UP ? pick : NULL;
+    }
+    if (!pot) {
+        return;
+    }
+    if (s_command_count == s_command_cap) {
+        s_commands = grow(s_commands, &s_command_cap, sizeof(command_t));
+    }
+    size_t index = s_command_count;
+    static const char *const outputs[] = {"fan", "mister", "light", "pump"};
+    const char *output = outputs[rng_next() % 4];
+    char topic[96];
+    char payload[160];
+    snprintf(topic, sizeof(topic), COMMAND_TOPIC_FMT, pot->id);
+    int len = snprintf(payload, sizeof(payload), "{\"%s\":\"%s\",\"duration_ms\":%u,\"requestId\":\"" FLEET_REQUEST_PREFIX "%zu\"}",
+                       output, rng_next() % 4 ? "on" : "off", (unsigned)(1000 + rng_next() % 59000), index);
+    if (!send_publish(ctl, PUB_COMMAND, topic, payload, (size_t)len, 1, false)) {
+        return;
+    }
+    s_commands[s_command_count++] = (command_t){
+        .sent_us = now_us(),
+        .answered_us = -1,
+        .pot = (uint32_t)(pot - s_conns),
+        .pot_drops = pot->drops,
+    };
+}
+
+// Connections
+
+static void conn_close(conn_t *c, int64_t retry_us)
+{
+    if (c->fd >= 0) {
+        epoll_ctl(s_epoll, EPOLL_CTL_DEL, c->fd, NULL);
+        close(c->fd);
+        c->fd = -1;
+    }
+    if (c->state == CONN_UP) {
+        s_up_count--;
+        c->drops++;
+    }
+    c->state = CONN_IDLE;
+    c->want_out = false;
+    c->rx_len = 0;
+    c->tx_len = 0;
+    // esp-mqtt keeps QoS 1 messages and resends them; here they are simply
+    // lost, and only acks on the connection that sent them are timed
+    memset(c->inflight, 0, sizeof(c->inflight));
+    c->next_attempt_us = retry_us;
+    conn_schedule(c);
+}
+
+static void conn_fail(conn_t *c)
+{
+    s_stats.connect_failures++;
+    conn_close(c, now_us() + seconds_us(s_opt.reconnect_s + rng_unit() * s_opt.reconnect_jitter_s));
+}
+
+static void conn_start(conn_t *c)
+{
+    int fd = socket(s_addr->ai_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    c->attempt_started_us = now_us();
+    if (fd < 0) {
+        conn_fail(c);
+        return;
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    c->fd = fd;
+    c->want_out = true;
+    struct epoll_event ev = {.events = EPOLLIN | EPOLLOUT, .data.u32 = (uint32_t)(c - s_conns)};
+    if (epoll_ctl(s_epoll, EPOLL_CTL_ADD, fd, &ev) != 0 ||
+        (connect(fd, s_addr->ai_addr, s_addr->ai_addrlen) != 0 && errno != EINPROGRESS)) {
+        conn_fail(c);
+        return;
+    }
+    c->state = CONN_TCP;
+    conn_schedule(c);
+}
+
+static void conn_up(conn_t *c, bool session_present)
+{
+    int64_t t = now_us();
+    c->state = CONN_UP;
+    s_up_count++;
+    s_stats.connects++;
+    sample_add(&s_stats.connect_us, t - c->attempt_started_us);
+    c->last_tx_us = t;
+    c->connected_once = true;
+    if (c->controller) {
+        if (!session_present) {
+            char filter[32];
+            snprintf(filter, sizeof(filter), STATUS_TOPIC_FMT, "+");
+            send_subscribe(c, filter);
+        }
+        conn_schedule(c);
+        return;
+    }
+    if (!session_present) {
+        char filter[64];
+        snprintf(filter, sizeof(filter), COMMAND_TOPIC_FMT, c->id);
+        send_subscribe(c, filter);
+    }
+    // plant_mqtt.c on MQTT_EVENT_CONNECTED: a ping and the schedule state
+    pot_publish_ping(c);
+    uint32_t before = plant_mqtt_host_last_publish()->count;
+    mqtt_publish_schedule_state(plant_mqtt_host_client(), c->id, FLEET_VERSION);
+    send_captured(c, PUB_STATUS, before);
+    if (c->next_sensor_us == 0) {
+        // First connection: spread the periodic publishes over their intervals
+        c->next_sensor_us = t + seconds_us(rng_unit() * s_opt.sensor_interval_s);
+        c->next_ping_us = t + seconds_us(rng_unit() * s_opt.ping_interval_s);
+        c->next_status_us = t + seconds_us(rng_unit() * s_opt.status_interval_s);
+    }
+    c->next_sensor_us = c->next_sensor_us > t ? c->next_sensor_us : t;
+    c->next_ping_us = c->next_ping_us > t ? c->next_ping_us : t + seconds_us(s_opt.ping_interval_s);
+    c->next_status_us = c->next_status_us > t ? c->next_status_us : t;
+    conn_schedule(c);
+}
+
+static void handle_packet(conn_t *c, uint8_t type, const uint8_t *body, size_t len)
+{
+    switch (type & 0xF0) {
+    case MQTT_CONNACK:
+        if (c->state != CONN_MQTT || len < 2 || body[1] != 0) {
+            conn_fail(c);
+            return;
+        }
+        conn_up(c, (body[0] & 0x01) != 0);
+        break;
+    case MQTT_PUBLISH: {
+        int qos = (type >> 1) & 0x03;
+        if (len < 2) {
+            return;
+        }
+        size_t topic_len = ((size_t)body[0] << 8) | body[1];
+        size_t at = 2 + topic_len + (qos > 0 ? 2 : 0);
+        if (at > len) {
+            return;
+        }
+        if (qos > 0) {
+            send_puback(c, (uint16_t)((body[2 + topic_len] << 8) | body[3 + topic_len]));
+        }
+        if (c->controller) {
+            controller_handle_status((const char *)body + at, len - at);
+        } else {
+            pot_handle_command(c, (const char *)body + at, len - at);
+        }
+        break;
+    }
+    case MQTT_PUBACK: {
+        if (len < 2) {
+            return;
+        }
+        uint16_t packet_id = (uint16_t)((body[0] << 8) | body[1]);
+        for (size_t i = 0; i < FLEET_INFLIGHT_MAX; ++i) {
+            inflight_t *slot = &c->inflight[i];
+            if (slot->packet_id == packet_id) {
+                int64_t dt = now_us() - slot->sent_us;
+                s_stats.acked++;
+                sample_add(&s_stats.ack_us, dt);
+                if (slot->kind == PUB_SENSORS) {
+                    sample_add(&s_stats.sensors_ack_us, dt);
+                }
+                slot->packet_id = 0;
+                break;
+            }
+        }
+        break;
+    }
+    default:
+        break;   // SUBACK, PINGRESP
+    }
+}
+
+static void conn_read(conn_t *c)
+{
+    while (c->fd >= 0) {
+        ssize_t n = recv(c->fd, c->rx + c->rx_len, sizeof(c->rx) - c->rx_len, 0);
+        if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+            if (c->state == CONN_UP) {
+                s_stats.disconnects++;
+                conn_close(c, now_us() + seconds_us(s_opt.reconnect_s + rng_unit() * s_opt.reconnect_jitter_s));
+            } else {
+                conn_fail(c);
+            }
+            return;
+        }
+        if (n < 0) {
+            return;
+        }
+        s_stats.bytes_in += (uint64_t)n;
+        c->rx_len += (size_t)n;
+        size_t off = 0;
+        while (c->fd >= 0 && c->rx_len - off >= 2) {
+            size_t remaining = 0;
+            size_t pos = off + 1;
+            uint32_t shift = 0;
+            bool complete = false;
+            while (pos < c->rx_len && shift <= 21) {
+                uint8_t digit = c->rx[pos++];
+                remaining |= (size_t)(digit & 0x7F) << shift;
+                shift += 7;
+                if (!(digit & 0x80)) {
+                    complete = true;
+                    break;
+                }
+            }
+            if (!complete) {
+                break;
+            }
+            if (pos - off + remaining > sizeof(c->rx)) {
+                s_stats.disconnects++;       // nothing a pot is sent comes near this
+                conn_close(c, now_us() + seconds_us(s_opt.reconnect_s));
+                return;
+            }
+            if (c->rx_len - pos < remaining) {
+                break;
+            }
+            handle_packet(c, c->rx[off], c->rx + pos, remaining);
+            off = pos + remaining;
+        }
+        if (c->fd < 0) {
+            return;
+        }
+        memmove(c->rx, c->rx + off, c->rx_len - off);
+        c->rx_len -= off;
+    }
+}
+
+static void conn_event(conn_t *c, uint32_t events)
+{
+    if (c->state == CONN_TCP && (events & (EPOLLOUT | EPOLLERR | EPOLLHUP))) {
+        int err = 0;
+        socklen_t err_len = sizeof(err);
+        getsockopt(c->fd, SOL_SOCKET, SO_ERROR, &err, &err_len);
+        if (err != 0) {
+            conn_fail(c);
+            return;
+        }
+        c->state = CONN_MQTT;
+        send_connect(c);
+        if (c->fd < 0) {
+            return;
+        }
+        set_out(c, c->tx_len > 0);
+    } else if (events & EPOLLOUT) {
+        flush(c);
+    }
+    if (c->fd >= 0 && (events & (EPOLLIN | EPOLLERR | EPOLLHUP))) {
+        conn_read(c);
+    }
+}
+
+static void conn_timers(conn_t *c, int64_t t)
+{
+    switch (c->state) {
+    case CONN_IDLE:
+        if (t >= c->next_attempt_us) {
+            conn_start(c);
+            return;
+        }
+        break;
+    case CONN_TCP:
+    case CONN_MQTT:
+        if (t >= c->attempt_started_us + FLEET_CONNECT_TIMEOUT_US) {
+            conn_fail(c);
+            return;
+        }
+        break;
+    case CONN_UP:
+        if (!c->controller) {
+            pot_timers(c, t);
+        }
+        if (c->state == CONN_UP && t >= c->last_tx_us + seconds_us(FLEET_KEEPALIVE_S / 2.0)) {
+            c->last_tx_us = t;
+            send_simple(c, MQTT_PINGREQ);
+        }
+        break;
+    }
+    conn_schedule(c);
+}
+
+// Drop a share of the connected pots at once; they reconnect together
+static void storm(int64_t t)
+{
+    s_stats.storms++;
+    for (uint32_t i = 0; i < s_opt.pots; ++i) {
+        conn_t *c = &s_conns[i];
+        if (c->state == CONN_UP && rng_unit() < s_opt.storm_fraction) {
+            s_stats.storm_drops++;
+            conn_close(c, t + seconds_us(s_opt.reconnect_s + rng_unit() * s_opt.reconnect_jitter_s));
+        }
+    }
+}
+
+static void on_signal(int sig)
+{
+    s_interrupted = 1;
+}
+
+static void run(void)
+{
+    int64_t start_us = now_us();
+    int64_t end_us = start_us + seconds_us(s_opt.duration_s);
+    int64_t drain_end_us = end_us + FLEET_DRAIN_US;
+    int64_t next_command_us = s_opt.commands_per_s > 0 ? start_us + seconds_us(s_opt.ramp_s) : INT64_MAX;
+    int64_t next_storm_us = s_opt.storm_interval_s > 0 ? start_us + seconds_us(s_opt.storm_interval_s) : INT64_MAX;
+    bool draining = false;
+    struct epoll_event events[256];
+
+    while (!s_interrupted) {
+        int64_t t = now_us();
+        if (!draining && t >= end_us) {
+            // Stop publishing and wait for acks and replies in flight
+            draining = true;
+            next_command_us = INT64_MAX;
+            next_storm_us = INT64_MAX;
+            for (uint32_t i = 0; i < s_conn_count; ++i) {
+                s_conns[i].next_sensor_us = s_conns[i].next_ping_us = s_conns[i].next_status_us = INT64_MAX;
+                s_conns[i].next_attempt_us = INT64_MAX;
+            }
+        }
+        if (t >= drain_end_us) {
+            break;
+        }
+        while (s_heap_len > 0 && s_heap[0].due_us <= t) {
+            heap_entry_t e = heap_pop();
+            conn_t *c = &s_conns[e.conn];
+            if (e.due_us == c->due_us) {
+                c->due_us = INT64_MAX;
+                conn_timers(c, t);
+            }
+        }
+        while (next_command_us <= t) {
+            controller_send_command();
+            next_command_us += seconds_us(rng_exp(1.0 / s_opt.commands_per_s));
+        }
+        if (next_storm_us <= t) {
+            storm(t);
+            next_storm_us += seconds_us(s_opt.storm_interval_s);
+        }
+
+        int64_t wake_us = min_us(drain_end_us, min_us(next_command_us, next_storm_us));
+        if (s_heap_len > 0) {
+            wake_us = min_us(wake_us, s_heap[0].due_us);
+        }
+        if (!draining) {
+            wake_us = min_us(wake_us, end_us);
+        }
+        int64_t wait_us = wake_us - now_us();
+        int timeout_ms = wait_us <= 0 ? 0 : (int)((wait_us + 999) / 1000);
+        int n = epoll_wait(s_epoll, events, (int)(sizeof(events) / sizeof(events[0])), timeout_ms);
+        for (int i = 0; i < n; ++i) {
+            conn_event(&s_conns[events[i].data.u32], events[i].events);
+        }
+    }
+    for (uint32_t i = 0; i < s_conn_count; ++i) {
+        conn_t *c = &s_conns[i];
+        if (c->state == CONN_UP) {
+            send_simple(c, MQTT_DISCONNECT);
+        }
+        if (c->fd >= 0) {
+            close(c->fd);
+        }
+        free(c->tx);
+    }
+}
+
+static void raise_fd_limit(uint32_t needed)
+{
+    struct rlimit lim;
+    if (getrlimit(RLIMIT_NOFILE, &lim) != 0 || lim.rlim_cur >= needed) {
+        return;
+    }
+    lim.rlim_cur = lim.rlim_max < needed ? lim.rlim_max : needed;
+    setrlimit(RLIMIT_NOFILE, &lim);
+    if (lim.rlim_cur < needed) {
+        fprintf(stderr, "warning: %u file descriptors needed, the hard limit is %llu (ulimit -n)\n",
+                (unsigned)needed, (unsigned long long)lim.rlim_max);
+    }
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr,
+            "usage: %s [options]\n"
+            "  --host H                 broker address (127.0.0.1)\n"
+            "  --port P                 broker port (1883)\n"
+            "  --username U, --password P\n"
+            "                           broker credentials (mosquitto password_file)\n"
+            "  --pots N                 simulated pots, one connection each (100)\n"
+            "  --duration S             publishing time; 5 s more drains acks (60)\n"
+            "  --ramp S                 first connects spread over S seconds (10)\n"
+            "  --sensor-interval S      readings per pot, QoS 1 (%g)\n"
+            "  --ping-interval S        pings per pot, QoS 0 (30)\n"
+            "  --status-interval S      status per pot, QoS 1 retained (600)\n"
+            "  --commands-per-sec X     controller overrides to random pots, Poisson (1)\n"
+            "  --storm-interval S       drop --storm-fraction of the connected pots every S (0 = never)\n"
+            "  --storm-fraction F       share of the fleet a storm drops (0.5)\n"
+            "  --reconnect S            reconnect delay, esp-mqtt's reconnect timeout (10)\n"
+            "  --reconnect-jitter S     added uniform jitter (2)\n"
+            "  --seed N                 phase, payload and command seed (1)\n"
+            "  --check                  exit 1 when a pot never connected, a command to a pot that\n"
+            "                           stayed up went unanswered, or the ack or command p99 passes\n"
+            "                           --p99-limit-ms\n"
+            "  --p99-limit-ms MS        (250)\n"
+            "  -v                       plant_mqtt.c logs (repeat for more)\n",
+            argv0, MEASUREMENT_INTERVAL_MS / 1000.0);
+}
+
+static bool parse_options(int argc, char **argv)
+{
+    static const struct option longopts[] = {
+        {"host", required_argument, NULL, 'H'},
+        {"port", required_argument, NULL, 'P'},
+        {"username", required_argument, NULL, 'u'},
+        {"password", required_argument, NULL, 'w'},
+        {"pots", required_argument, NULL, 'n'},
+        {"duration", required_argument, NULL, 'd'},
+        {"ramp", required_argument, NULL, 'r'},
+        {"sensor-interval", required_argument, NULL, 'S'},
+        {"ping-interval", required_argument, NULL, 'p'},
+        {"status-interval", required_argument, NULL, 't'},
+        {"commands-per-sec", required_argument, NULL, 'C'},
+        {"storm-interval", required_argument, NULL, 'i'},
+        {"storm-fraction", required_argument, NULL, 'f'},
+        {"reconnect", required_argument, NULL, 'R'},
+        {"reconnect-jitter", required_argument, NULL, 'j'},
+        {"seed", required_argument, NULL, 's'},
+        {"check", no_argument, NULL, 'c'},
+        {"p99-limit-ms", required_argument, NULL, 'l'},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0},
+    };
+    int c;
+    while ((c = getopt_long(argc, argv, "vh", longopts, NULL)) != -1) {
+        switch (c) {
+        case 'H': s_opt.host = optarg; break;
+        case 'P': s_opt.port = optarg; break;
+        case 'u': s_opt.username = optarg; break;
+        case 'w': s_opt.password = optarg; break;
+        case 'n': s_opt.pots = (uint32_t)strtoul(optarg, NULL, 0); break;
+        case 'd': s_opt.duration_s = strtod(optarg, NULL); break;
+        case 'r': s_opt.ramp_s = strtod(optarg, NULL); break;
+        case 'S': s_opt.sensor_interval_s = strtod(optarg, NULL); break;
+        case 'p': s_opt.ping_interval_s = strtod(optarg, NULL); break;
+        case 't': s_opt.status_interval_s = strtod(optarg, NULL); break;
+        case 'C': s_opt.commands_per_s = strtod(optarg, NULL); break;
+        case 'i': s_opt.storm_interval_s = strtod(optarg, NULL); break;
+        case 'f': s_opt.storm_fraction = strtod(optarg, NULL); break;
+        case 'R': s_opt.reconnect_s = strtod(optarg, NULL); break;
+        case 'j': s_opt.reconnect_jitter_s = strtod(optarg, NULL); break;
+        case 's': s_opt.seed = strtoull(optarg, NULL, 0); break;
+        case 'c': s_opt.check = true; break;
+        case 'l': s_opt.p99_limit_ms = strtod(optarg, NULL); break;
+        case 'v': host_log_level = host_log_level < ESP_LOG_INFO ? ESP_LOG_INFO : ESP_LOG_DEBUG; break;
+        default:
+            usage(argv[0]);
+            return false;
+        }
+    }
+    if (optind != argc || s_opt.pots == 0 || s_opt.duration_s <= 0 || s_opt.sensor_interval_s <= 0 ||
+        s_opt.ping_interval_s <= 0 || s_opt.status_interval_s <= 0 || s_opt.commands_per_s < 0) {
+        usage(argv[0]);
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    host_log_level = ESP_LOG_ERROR;
+    if (!parse_options(argc, argv)) {
+        return 2;
+    }
+    s_rng = s_opt.seed;
+    struct addrinfo hints = {.ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM};
+    int gai = getaddrinfo(s_opt.host, s_opt.port, &hints, &s_addr);
+    if (gai != 0) {
+        fprintf(stderr, "%s:%s: %s\n", s_opt.host, s_opt.port, gai_strerror(gai));
+        return 2;
+    }
+    raise_fd_limit(s_opt.pots + 64);
+    s_epoll = epoll_create1(EPOLL_CLOEXEC);
+    s_conn_count = s_opt.pots + 1;
+    s_conns = calloc(s_conn_count, sizeof(conn_t));
+    if (s_epoll < 0 || !s_conns) {
+        fprintf(stderr, "setup failed: %s\n", strerror(errno));
+        return 2;
+    }
+    plant_mqtt_host_set_identity("Fleet Pot", true, PAYLOAD_ENCODING_JSON);
+    plant_mqtt_host_set_time_valid(true);
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+
+    int64_t start_us = now_us();
+    for (uint32_t i = 0; i < s_conn_count; ++i) {
+        conn_t *c = &s_conns[i];
+        c->fd = -1;
+        c->due_us = INT64_MAX;
+        c->controller = i == s_opt.pots;
+        if (c->controller) {
+            snprintf(c->id, sizeof(c->id), FLEET_CONTROLLER_ID);
+            c->next_attempt_us = start_us;
+        } else {
+            snprintf(c->id, sizeof(c->id), "pot-fleet-%05u", (unsigned)i);
+            c->next_attempt_us = start_us + seconds_us(s_opt.ramp_s * i / s_opt.pots);
+        }
+        c->moisture_pct = 30.0 + rng_unit() * 30.0;
+        conn_schedule(c);
+    }
+
+    run();
+    double wall_s = (now_us() - start_us) / 1e6;
+    freeaddrinfo(s_addr);
+    close(s_epoll);
+
+    uint32_t never_connected = 0;
+    for (uint32_t i = 0; i < s_conn_count; ++i) {
+        never_connected += s_conns[i].connected_once ? 0 : 1;
+    }
+    // A command whose pot was dropped before replying may be lost with the
+    // connection (QoS 1 redelivery needs the broker to keep the session and
+    // here the unacked reply is not resent); only the rest count against it
+    uint32_t unanswered = 0;
+    uint32_t lost_to_drops = 0;
+    for (size_t i = 0; i < s_command_count; ++i) {
+        const command_t *cmd = &s_commands[i];
+        if (cmd->answered_us >= 0) {
+            continue;
+        }
+        if (s_conns[cmd->pot].drops != cmd->pot_drops) {
+            lost_to_drops++;
+        } else {
+            unanswered++;
+        }
+    }
+    uint64_t published = 0;
+    for (int i = 0; i < PUB_KIND_COUNT; ++i) {
+        published += s_stats.published[i];
+    }
+    double ack[4], sensors_ack[4], rtt[4], conn[4];
+    percentiles(&s_stats.ack_us, &ack[0], &ack[1], &ack[2], &ack[3]);
+    percentiles(&s_stats.sensors_ack_us, &sensors_ack[0], &sensors_ack[1], &sensors_ack[2], &sensors_ack[3]);
+    percentiles(&s_stats.command_rtt_us, &rtt[0], &rtt[1], &rtt[2], &rtt[3]);
+    percentiles(&s_stats.connect_us, &conn[0], &conn[1], &conn[2], &conn[3]);
+
+    printf("Fleet of %u pots against %s:%s for %.1f s: %llu publishes (%.0f/s), %llu bytes out, %llu in\n",
+           (unsigned)s_opt.pots, s_opt.host, s_opt.port, wall_s, (unsigned long long)published,
+           wall_s > 0 ? published / wall_s : 0.0, (unsigned long long)s_stats.bytes_out,
+           (unsigned long long)s_stats.bytes_in);
+    printf("Published:");
+    for (int i = 0; i < PUB_KIND_COUNT; ++i) {
+        printf(" %s %llu", PUB_NAMES[i], (unsigned long long)s_stats.published[i]);
+    }
+    printf("; %llu acked, %llu refused with %d unacked\n", (unsigned long long)s_stats.acked,
+           (unsigned long long)s_stats.outbox_full, FLEET_INFLIGHT_MAX);
+    printf("Publish to PUBACK: p50 %.2f ms, p90 %.2f, p99 %.2f, max %.2f (sensors p99 %.2f)\n", ack[0], ack[1], ack[2],
+           ack[3], sensors_ack[2]);
+    printf("Command round trip: %zu sent, %u unanswered, %u lost with a dropped pot; p50 %.2f ms, p90 %.2f, "
+           "p99 %.2f, max %.2f\n",
+           s_command_count, (unsigned)unanswered, (unsigned)lost_to_drops, rtt[0], rtt[1], rtt[2], rtt[3]);
+    printf("Pots answered %llu commands (%llu not understood)\n", (unsigned long long)s_stats.commands_received,
+           (unsigned long long)s_stats.commands_unknown);
+    printf("Connections: %llu connects, %llu failed attempts, %llu dropped by the broker, %u storms dropping %llu, "
+           "%u never connected; connect p50 %.2f ms, p99 %.2f, max %.2f\n",
+           (unsigned long long)s_stats.connects, (unsigned long long)s_stats.connect_failures,
+           (unsigned long long)s_stats.disconnects, (unsigned)s_stats.storms, (unsigned long long)s_stats.storm_drops,
+           (unsigned)never_connected, conn[0], conn[2], conn[3]);
+    printf("FLEET_LOAD {\"pots\":%u,\"duration_s\":%.1f,\"sensor_interval_s\":%g,\"ping_interval_s\":%g,"
+           "\"commands_per_s\":%g,\"storm_interval_s\":%g,\"publishes\":%llu,\"publishes_per_s\":%.1f,"
+           "\"acked\":%llu,\"outbox_full\":%llu,\"ack_p50_ms\":%.3f,\"ack_p90_ms\":%.3f,\"ack_p99_ms\":%.3f,"
+           "\"ack_max_ms\":%.3f,\"sensors_ack_p99_ms\":%.3f,\"commands\":%zu,\"unanswered\":%u,\"lost_to_drops\":%u,"
+           "\"command_p50_ms\":%.3f,\"command_p90_ms\":%.3f,\"command_p99_ms\":%.3f,\"command_max_ms\":%.3f,"
+           "\"commands_received\":%llu,\"connects\":%llu,\"connect_failures\":%llu,\"disconnects\":%llu,"
+           "\"storms\":%u,\"storm_drops\":%llu,\"never_connected\":%u,\"connect_p50_ms\":%.3f,"
+           "\"connect_p99_ms\":%.3f,\"bytes_out\":%llu,\"bytes_in\":%llu}\n",
+           (unsigned)s_opt.pots, wall_s, s_opt.sensor_interval_s, s_opt.ping_interval_s, s_opt.commands_per_s,
+           s_opt.storm_interval_s, (unsigned long long)published, wall_s > 0 ? published / wall_s : 0.0,
+           (unsigned long long)s_stats.acked, (unsigned long long)s_stats.outbox_full, ack[0], ack[1], ack[2], ack[3],
+           sensors_ack[2], s_command_count, (unsigned)unanswered, (unsigned)lost_to_drops, rtt[0], rtt[1], rtt[2], rtt[3],
+           (unsigned long long)s_stats.commands_received, (unsigned long long)s_stats.connects,
+           (unsigned long long)s_stats.connect_failures, (unsigned long long)s_stats.disconnects,
+           (unsigned)s_stats.storms, (unsigned long long)s_stats.storm_drops, (unsigned)never_connected, conn[0],
+           conn[2], (unsigned long long)s_stats.bytes_out, (unsigned long long)s_stats.bytes_in);
+
+    free(s_conns);
+    free(s_heap);
+    free(s_commands);
+    free(s_stats.ack_us.values);
+    free(s_stats.sensors_ack_us.values);
+    free(s_stats.command_rtt_us.values);
+    free(s_stats.connect_us.values);
+
+    if (s_opt.check) {
+        if (never_connected > 0 || unanswered > 0 || ack[2] > s_opt.p99_limit_ms || rtt[2] > s_opt.p99_limit_ms) {
+            fprintf(stderr, "check failed: %u never connected, %u commands unanswered, ack p99 %.2f ms and "
+                    "command p99 %.2f ms (limit %.0f)\n", (unsigned)never_connected, (unsigned)unanswered, ack[2],
+                    rtt[2], s_opt.p99_limit_ms);
+            return 1;
+        }
+    }
+    return s_interrupted ? 130 : 0;
+}
@@ -0,0 +1,657 @@
+#define _GNU_SOURCE  // fopencookie()
+
+#include "host_flash.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_littlefs.h"
+#include "esp_log.h"
+#include "esp_partition.h"
+
+#include "lfs.h"
+#include "bd/lfs_emubd.h"
+
+// The esp_littlefs.h stub routes these to us; below they mean the C library
+#undef fopen
+#undef fileno
+#undef fsync
+#undef ftruncate
+
+static const char *TAG = "host_flash";
+
+#define HOST_FLASH_MAX_FILES 8
+#define HOST_FLASH_FD_BASE 0x4000      // well clear of descriptors the host hands out
+#define HOST_FLASH_CACHE_MAX 4096
+#define HOST_FLASH_LOOKAHEAD_MAX 1024
+// newlib's default stdio buffer on ESP-IDF, so flushes reach littlefs in the
+// same pieces they do on the device
+#define HOST_FLASH_STDIO_BUFSIZE 128
+
+typedef struct {
+    bool used;
+    bool alive;                         // false once power was lost under it
+    FILE *stream;
+    lfs_file_t file;
+    struct lfs_file_config file_cfg;
+    uint8_t cache[HOST_FLASH_CACHE_MAX];
+} host_file_t;
+
+static host_flash_config_t s_config;
+static struct lfs_emubd_config s_bd_cfg;
+static lfs_emubd_t s_bd;
+static struct lfs_config s_cfg;
+static lfs_t s_lfs;
+static bool s_created = false;
+static bool s_mounted = false;
+static char s_base_path[32];
+static char s_label[17];
+static uint8_t s_read_buffer[HOST_FLASH_CACHE_MAX];
+static uint8_t s_prog_buffer[HOST_FLASH_CACHE_MAX];
+static uint8_t s_lookahead_buffer[HOST_FLASH_LOOKAHEAD_MAX];
+static host_file_t s_files[HOST_FLASH_MAX_FILES];
+static esp_littlefs_write_stats_t s_write_stats;
+static uint32_t s_reads;
+static jmp_buf *s_power_loss_env = NULL;
+static uint32_t s_power_losses = 0;
+
+// The raw partition is a second lfs_emubd, byte-programmable like SPI NOR;
+// s_raw_cfg only carries the context lfs_emubd wants
+static struct lfs_emubd_config s_raw_bd_cfg;
+static lfs_emubd_t s_raw_bd;
+static struct lfs_config s_raw_cfg;
+static esp_partition_t s_raw_part;
+static bool s_raw_created = false;
+static uint32_t s_raw_reads;
+static uint32_t s_raw_progs;
+static uint32_t s_raw_erases;
+
+static int host_flash_read(const struct lfs_config *c, lfs_block_t block, lfs_off_t off, void *buffer, lfs_size_t size)
+{
+    s_reads++;
+    return lfs_emubd_read(c, block, off, buffer, size);
+}
+
+static int host_flash_prog(const struct lfs_config *c, lfs_block_t block, lfs_off_t off, const void *buffer, lfs_size_t size)
+{
+    s_write_stats.flash_progs++;
+    s_write_stats.flash_bytes_programmed += size;
+    return lfs_emubd_prog(c, block, off, buffer, size);
+}
+
+static int host_flash_erase(const struct lfs_config *c, lfs_block_t block)
+{
+    s_write_stats.flash_erases++;
+    return lfs_emubd_erase(c, block);
+}
+
+// lfs_emubd calls this once the armed operation count runs out. With
+// power_loss_ooo the longjmp() skips lfs_emubd's undo step, which leaks the
+// block it swapped out (one per power loss; LeakSanitizer reports it).
+static void host_flash_power_loss(void *data)
+{
+    (void)data;
+    s_power_losses++;
+    for (size_t i = 0; i < HOST_FLASH_MAX_FILES; ++i) {
+        s_files[i].alive = false;
+    }
+    s_mounted = false;
+    jmp_buf *env = s_power_loss_env;
+    s_power_loss_env = NULL;
+    if (!env) {
+        ESP_LOGE(TAG, "Power loss with no handler");
+        abort();
+    }
+    longjmp(*env, 1);
+}
+
+int host_flash_init(const host_flash_config_t *config)
+{
+    if (s_created || !config || config->cache_size > HOST_FLASH_CACHE_MAX ||
+        config->lookahead_size > HOST_FLASH_LOOKAHEAD_MAX) {
+        return LFS_ERR_INVAL;
+    }
+    s_config = *config;
+    s_bd_cfg = (struct lfs_emubd_config){
+        .read_size = config->read_size,
+        .prog_size = config->prog_size,
+        .erase_size = config->block_size,
+        .erase_count = config->block_count,
+        .erase_value = 0xff,
+        .erase_cycles = UINT32_MAX,  // never wears out, but makes lfs_emubd count wear
+        .powerloss_behavior = config->power_loss_ooo ? LFS_EMUBD_POWERLOSS_OOO : LFS_EMUBD_POWERLOSS_NOOP,
+        .powerloss_cb = host_flash_power_loss,
+    };
+    s_cfg = (struct lfs_config){
+        .context = &s_bd,
+        .read = host_flash_read,
+        .prog = host_flash_prog,
+        .erase = host_flash_erase,
+        .sync = lfs_emubd_sync,
+        .read_size = config->read_size,
+        .prog_size = config->prog_size,
+        .block_size = config->block_size,
+        .block_count = config->block_count,
+        .block_cycles = config->block_cycles,
+        .cache_size = config->cache_size,
+        .lookahead_size = config->lookahead_size,
+        .read_buffer = s_read_buffer,
+        .prog_buffer = s_prog_buffer,
+        .lookahead_buffer = s_lookahead_buffer,
+    };
+    int err = lfs_emubd_create(&s_cfg, &s_bd_cfg);
+    if (err != 0) {
+        return err;
+    }
+    // Formatted, as a flashed partition image would be
+    err = lfs_format(&s_lfs, &s_cfg);
+    if (err != 0) {
+        lfs_emubd_destroy(&s_cfg);
+        return err;
+    }
+    if (config->raw_label && config->raw_size) {
+        if (config->raw_size % config->block_size != 0 || strlen(config->raw_label) >= sizeof(s_raw_part.label)) {
+            lfs_emubd_destroy(&s_cfg);
+            return LFS_ERR_INVAL;
+        }
+        s_raw_bd_cfg = s_bd_cfg;
+        s_raw_bd_cfg.read_size = 1;
+        s_raw_bd_cfg.prog_size = 1;
+        s_raw_bd_cfg.erase_count = config->raw_size / config->block_size;
+        s_raw_cfg = (struct lfs_config){
+            .context = &s_raw_bd,
+            .block_size = config->block_size,
+            .block_count = s_raw_bd_cfg.erase_count,
+        };
+        err = lfs_emubd_create(&s_raw_cfg, &s_raw_bd_cfg);
+        if (err != 0) {
+            lfs_emubd_destroy(&s_cfg);
+            return err;
+        }
+        s_raw_part = (esp_partition_t){
+            .type = ESP_PARTITION_TYPE_DATA,
+            .subtype = ESP_PARTITION_SUBTYPE_ANY,
+            .address = HOST_FLASH_STORAGE_SIZE,
+            .size = config->raw_size,
+            .erase_size = config->block_size,
+        };
+        strcpy(s_raw_part.label, config->raw_label);
+        s_raw_created = true;
+    }
+    s_created = true;
+    memset(&s_write_stats, 0, sizeof(s_write_stats));
+    s_reads = 0;
+    s_raw_reads = 0;
+    s_raw_progs = 0;
+    s_raw_erases = 0;
+    s_power_losses = 0;
+    return 0;
+}
+
+void host_flash_deinit(void)
+{
+    if (!s_created) {
+        return;
+    }
+    esp_vfs_littlefs_unregister(NULL);
+    host_flash_recover();
+    lfs_emubd_destroy(&s_cfg);
+    if (s_raw_created) {
+        lfs_emubd_destroy(&s_raw_cfg);
+        s_raw_created = false;
+    }
+    s_created = false;
+}
+
+void host_flash_arm_power_loss(uint32_t ops, jmp_buf *env)
+{
+    s_power_loss_env = ops ? env : NULL;
+    lfs_emubd_setpowercycles(&s_cfg, ops);
+    if (s_raw_created) {
+        lfs_emubd_setpowercycles(&s_raw_cfg, ops);
+    }
+}
+
+void host_flash_recover(void)
+{
+    for (size_t i = 0; i < HOST_FLASH_MAX_FILES; ++i) {
+        if (s_files[i].used && !s_files[i].alive) {
+            fclose(s_files[i].stream);  // the cookie callbacks drop the writes
+        }
+    }
+    if (!s_mounted) {
+        memset(&s_lfs, 0, sizeof(s_lfs));
+    }
+}
+
+uint32_t host_flash_power_losses(void)
+{
+    return s_power_losses;
+}
+
+static void host_flash_fill_wear(const struct lfs_config *cfg, lfs_block_t count, host_flash_stats_t *out)
+{
+    uint64_t total = 0;
+    out->min_wear = UINT32_MAX;
+    for (lfs_block_t b = 0; b < count; ++b) {
+        lfs_emubd_swear_t wear = lfs_emubd_wear(cfg, b);
+        uint32_t w = wear < 0 ? 0 : (uint32_t)wear;
+        total += w;
+        out->max_wear = w > out->max_wear ? w : out->max_wear;
+        out->min_wear = w < out->min_wear ? w : out->min_wear;
+    }
+    out->mean_wear = count ? (double)total / count : 0.0;
+}
+
+void host_flash_get_stats(const char *label, host_flash_stats_t *out)
+{
+    memset(out, 0, sizeof(*out));
+    if (!s_created || !label) {
+        return;
+    }
+    if (strcmp(label, HOST_FLASH_STORAGE_LABEL) == 0) {
+        out->bytes_read = (uint64_t)lfs_emubd_readed(&s_cfg);
+        out->bytes_programmed = (uint64_t)lfs_emubd_proged(&s_cfg);
+        out->reads = s_reads;
+        out->progs = s_write_stats.flash_progs;
+        out->erases = s_write_stats.flash_erases;
+        host_flash_fill_wear(&s_cfg, s_config.block_count, out);
+    } else if (s_raw_created && strcmp(label, s_raw_part.label) == 0) {
+        out->bytes_read = (uint64_t)lfs_emubd_readed(&s_raw_cfg);
+        out->bytes_programmed = (uint64_t)lfs_emubd_proged(&s_raw_cfg);
+        out->reads = s_raw_reads;
+        out->progs = s_raw_progs;
+        out->erases = s_raw_erases;
+        host_flash_fill_wear(&s_raw_cfg, s_raw_bd_cfg.erase_count, out);
+    }
+}
+
+static bool host_flash_label_matches(const char *partition_label)
+{
+    return !partition_label || strcmp(partition_label, s_label) == 0;
+}
+
+esp_err_t esp_vfs_littlefs_register(const esp_vfs_littlefs_conf_t *conf)
+{
+    if (!conf || !conf->base_path || strlen(conf->base_path) >= sizeof(s_base_path)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!s_created) {
+        return ESP_ERR_NOT_FOUND;  // no partition
+    }
+    if (s_mounted) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    host_flash_recover();
+    int err = conf->dont_mount ? 0 : lfs_mount(&s_lfs, &s_cfg);
+    if (err != 0 && conf->format_if_mount_failed && !conf->read_only) {
+        ESP_LOGW(TAG, "mount failed, %d; formatting", err);
+        err = lfs_format(&s_lfs, &s_cfg);
+        if (err == 0) {
+            err = lfs_mount(&s_lfs, &s_cfg);
+        }
+    }
+    if (err != 0) {
+        ESP_LOGE(TAG, "mount failed, %d", err);
+        return ESP_FAIL;
+    }
+    strcpy(s_base_path, conf->base_path);
+    snprintf(s_label, sizeof(s_label), "%s", conf->partition_label ? conf->partition_label : "");
+    s_mounted = !conf->dont_mount;
+    return ESP_OK;
+}
+
+esp_err_t esp_vfs_littlefs_unregister(const char *partition_label)
+{
+    if (!s_mounted || !host_flash_label_matches(partition_label)) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    for (size_t i = 0; i < HOST_FLASH_MAX_FILES; ++i) {
+        if (s_files[i].used && s_files[i].alive) {
+            fclose(s_files[i].stream);
+        }
+    }
+    lfs_unmount(&s_lfs);
+    s_mounted = false;
+    return ESP_OK;
+}
+
+bool esp_littlefs_mounted(const char *partition_label)
+{
+    return s_mounted && host_flash_label_matches(partition_label);
+}
+
+esp_err_t esp_littlefs_format(const char *partition_label)
+{
+    if (!s_created || (s_mounted && !host_flash_label_matches(partition_label))) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    bool was_mounted = s_mounted;
+    if (was_mounted) {
+        esp_vfs_littlefs_unregister(partition_label);
+    }
+    if (lfs_format(&s_lfs, &s_cfg) != 0) {
+        return ESP_FAIL;
+    }
+    if (was_mounted) {
+        if (lfs_mount(&s_lfs, &s_cfg) != 0) {
+            return ESP_FAIL;
+        }
+        s_mounted = true;
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_littlefs_info(const char *partition_label, size_t *total_bytes, size_t *used_bytes)
+{
+    if (!esp_littlefs_mounted(partition_label)) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    lfs_ssize_t blocks = lfs_fs_size(&s_lfs);
+    if (blocks < 0) {
+        return ESP_FAIL;
+    }
+    if (total_bytes) {
+        *total_bytes = (size_t)s_config.block_size * s_config.block_count;
+    }
+    if (used_bytes) {
+        *used_bytes = (size_t)s_config.block_size * (size_t)blocks;
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_littlefs_write_stats(const char *partition_label, esp_littlefs_write_stats_t *stats)
+{
+    if (!stats) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!esp_littlefs_mounted(partition_label)) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    *stats = s_write_stats;
+    return ESP_OK;
+}
+
+esp_err_t esp_littlefs_write_stats_reset(const char *partition_label)
+{
+    if (!esp_littlefs_mounted(partition_label)) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    memset(&s_write_stats, 0, sizeof(s_write_stats));
+    return ESP_OK;
+}
+
+static int host_flash_errno(int lfs_err)
+{
+    switch (lfs_err) {
+    case LFS_ERR_NOENT: return ENOENT;
+    case LFS_ERR_EXIST: return EEXIST;
+    case LFS_ERR_ISDIR: return EISDIR;
+    case LFS_ERR_NOTDIR: return ENOTDIR;
+    case LFS_ERR_NOSPC: return ENOSPC;
+    case LFS_ERR_NOMEM: return ENOMEM;
+    case LFS_ERR_INVAL: return EINVAL;
+    case LFS_ERR_NAMETOOLONG: return ENAMETOOLONG;
+    default: return EIO;
+    }
+}
+
+static ssize_t host_file_read(void *cookie, char *buf, size_t size)
+{
+    host_file_t *f = cookie;
+    if (!f->alive) {
+        errno = EIO;
+        return -1;
+    }
+    lfs_ssize_t res = lfs_file_read(&s_lfs, &f->file, buf, size);
+    if (res < 0) {
+        errno = host_flash_errno(res);
+        return -1;
+    }
+    return res;
+}
+
+static ssize_t host_file_write(void *cookie, const char *buf, size_t size)
+{
+    host_file_t *f = cookie;
+    if (!f->alive) {
+        return (ssize_t)size;  // power is gone; nothing reaches flash
+    }
+    lfs_ssize_t res = lfs_file_write(&s_lfs, &f->file, buf, size);
+    if (res < 0) {
+        errno = host_flash_errno(res);
+        return -1;
+    }
+    return res;
+}
+
+static int host_file_seek(void *cookie, off64_t *offset, int whence)
+{
+    host_file_t *f = cookie;
+    if (!f->alive) {
+        errno = EIO;
+        return -1;
+    }
+    int lfs_whence = whence == SEEK_END ? LFS_SEEK_END : (whence == SEEK_CUR ? LFS_SEEK_CUR : LFS_SEEK_SET);
+    lfs_soff_t res = lfs_file_seek(&s_lfs, &f->file, (lfs_soff_t)*offset, lfs_whence);
+    if (res < 0) {
+        errno = host_flash_errno(res);
+        return -1;
+    }
+    *offset = res;
+    return 0;
+}
+
+static int host_file_close(void *cookie)
+{
+    host_file_t *f = cookie;
+    int res = f->alive ? lfs_file_close(&s_lfs, &f->file) : 0;
+    f->used = false;
+    f->alive = false;
+    f->stream = NULL;
+    if (res < 0) {
+        errno = host_flash_errno(res);
+        return -1;
+    }
+    return 0;
+}
+
+static const char *host_flash_mount_relative(const char *path)
+{
+    size_t len = strlen(s_base_path);
+    if (!s_mounted || strncmp(path, s_base_path, len) != 0 || path[len] != '/') {
+        return NULL;
+    }
+    return path + len;
+}
+
+static int host_flash_open_flags(const char *mode)
+{
+    bool plus = strchr(mode, '+') != NULL;
+    switch (mode[0]) {
+    case 'r': return plus ? LFS_O_RDWR : LFS_O_RDONLY;
+    case 'w': return (plus ? LFS_O_RDWR : LFS_O_WRONLY) | LFS_O_CREAT | LFS_O_TRUNC;
+    case 'a': return (plus ? LFS_O_RDWR : LFS_O_WRONLY) | LFS_O_CREAT | LFS_O_APPEND;
+    default: return -1;
+    }
+}
+
+FILE *host_flash_fopen(const char *path, const char *mode)
+{
+    const char *lfs_path = path && mode ? host_flash_mount_relative(path) : NULL;
+    if (!lfs_path) {
+        return fopen(path, mode);
+    }
+    int flags = host_flash_open_flags(mode);
+    if (flags < 0) {
+        errno = EINVAL;
+        return NULL;
+    }
+    host_file_t *f = NULL;
+    for (size_t i = 0; i < HOST_FLASH_MAX_FILES && !f; ++i) {
+        f = s_files[i].used ? NULL : &s_files[i];
+    }
+    if (!f) {
+        errno = ENFILE;
+        return NULL;
+    }
+    memset(&f->file_cfg, 0, sizeof(f->file_cfg));
+    f->file_cfg.buffer = f->cache;
+    int res = lfs_file_opencfg(&s_lfs, &f->file, lfs_path, flags, &f->file_cfg);
+    if (res < 0) {
+        errno = host_flash_errno(res);
+        return NULL;
+    }
+    cookie_io_functions_t io = {
+        .read = host_file_read,
+        .write = host_file_write,
+        .seek = host_file_seek,
+        .close = host_file_close,
+    };
+    f->used = true;
+    f->alive = true;
+    f->stream = fopencookie(f, mode, io);
+    if (!f->stream) {
+        lfs_file_close(&s_lfs, &f->file);
+        f->used = false;
+        f->alive = false;
+        return NULL;
+    }
+    setvbuf(f->stream, NULL, _IOFBF, HOST_FLASH_STDIO_BUFSIZE);
+    return f->stream;
+}
+
+static host_file_t *host_flash_file_by_fd(int fd)
+{
+    if (fd < HOST_FLASH_FD_BASE || fd >= HOST_FLASH_FD_BASE + HOST_FLASH_MAX_FILES) {
+        return NULL;
+    }
+    host_file_t *f = &s_files[fd - HOST_FLASH_FD_BASE];
+    return f->used ? f : NULL;
+}
+
+int host_flash_fileno(FILE *stream)
+{
+    for (size_t i = 0; i < HOST_FLASH_MAX_FILES; ++i) {
+        if (s_files[i].used && s_files[i].stream == stream) {
+            return HOST_FLASH_FD_BASE + (int)i;
+        }
+    }
+    return fileno(stream);
+}
+
+int host_flash_fsync(int fd)
+{
+    host_file_t *f = host_flash_file_by_fd(fd);
+    if (!f) {
+        return fsync(fd);
+    }
+    int res = f->alive ? lfs_file_sync(&s_lfs, &f->file) : LFS_ERR_IO;
+    if (res < 0) {
+        errno = host_flash_errno(res);
+        return -1;
+    }
+    return 0;
+}
+
+int host_flash_ftruncate(int fd, off_t length)
+{
+    host_file_t *f = host_flash_file_by_fd(fd);
+    if (!f) {
+        return ftruncate(fd, length);
+    }
+    int res = f->alive ? lfs_file_truncate(&s_lfs, &f->file, (lfs_off_t)length) : LFS_ERR_IO;
+    if (res < 0) {
+        errno = host_flash_errno(res);
+        return -1;
+    }
+    return 0;
+}
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype,
+                                                const char *label)
+{
+    (void)subtype;
+    if (!s_raw_created || (type != ESP_PARTITION_TYPE_DATA && type != ESP_PARTITION_TYPE_ANY)) {
+        return NULL;
+    }
+    return !label || strcmp(label, s_raw_part.label) == 0 ? &s_raw_part : NULL;
+}
+
+static bool host_flash_raw_in_range(const esp_partition_t *partition, size_t offset, size_t size)
+{
+    return partition == &s_raw_part && s_raw_created && offset <= partition->size &&
+           size <= partition->size - offset;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t *partition, size_t src_offset, void *dst, size_t size)
+{
+    if (!dst || !host_flash_raw_in_range(partition, src_offset, size)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_raw_reads++;
+    uint8_t *out = dst;
+    while (size > 0) {
+        lfs_block_t block = src_offset / partition->erase_size;
+        lfs_off_t off = src_offset % partition->erase_size;
+        size_t n = partition->erase_size - off < size ? partition->erase_size - off : size;
+        if (lfs_emubd_read(&s_raw_cfg, block, off, out, n) != 0) {
+            return ESP_FAIL;
+        }
+        out += n;
+        src_offset += n;
+        size -= n;
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t *partition, size_t dst_offset, const void *src, size_t size)
+{
+    if (!src || !host_flash_raw_in_range(partition, dst_offset, size)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_raw_progs++;
+    const uint8_t *in = src;
+    while (size > 0) {
+        lfs_block_t block = dst_offset / partition->erase_size;
+        lfs_off_t off = dst_offset % partition->erase_size;
+        size_t n = partition->erase_size - off < size ? partition->erase_size - off : size;
+        // NOR would silently AND the bits; a ring that programs a slot twice
+        // has a bug worth failing loudly on. Peeked at directly so the check
+        // does not count as reads.
+        const lfs_emubd_block_t *b = s_raw_bd.blocks[block];
+        for (size_t i = 0; b && i < n; ++i) {
+            if (b->data[off + i] != 0xff) {
+                ESP_LOGE(TAG, "write over unerased flash at 0x%x", (unsigned)(dst_offset + i));
+                return ESP_FAIL;
+            }
+        }
+        if (lfs_emubd_prog(&s_raw_cfg, block, off, in, n) != 0) {
+            return ESP_FAIL;
+        }
+        in += n;
+        dst_offset += n;
+        size -= n;
+    }
+    // SPI flash writes are done when the call returns; only a power loss
+    // inside the call may shuffle them (LFS_EMUBD_POWERLOSS_OOO)
+    lfs_emubd_sync(&s_raw_cfg);
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t *partition, size_t offset, size_t size)
+{
+    if (!host_flash_raw_in_range(partition, offset, size) ||
+        offset % partition->erase_size != 0 || size % partition->erase_size != 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (; size > 0; offset += partition->erase_size, size -= partition->erase_size) {
+        s_raw_erases++;
+        if (lfs_emubd_erase(&s_raw_cfg, offset / partition->erase_size) != 0) {
+            return ESP_FAIL;
+        }
+        lfs_emubd_sync(&s_raw_cfg);
+    }
+    return ESP_OK;
+}
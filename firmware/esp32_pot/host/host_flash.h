@@ -0,0 +1,82 @@
+#pragma once
+
+#include <setjmp.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "sdkconfig.h"
+
+// Emulated NOR flash for the host harnesses: one littlefs partition on
+// lfs_emubd, sized and shaped like the pot's "storage" partition, and
+// optionally a raw data partition behind the esp_partition.h stub. Erase and
+// program totals, per-block wear and power loss come from lfs_emubd itself.
+
+#define HOST_FLASH_STORAGE_LABEL "storage"
+
+typedef struct {
+    uint32_t block_size;       // erase block, bytes
+    uint32_t block_count;
+    uint32_t read_size;        // littlefs geometry, as CONFIG_LITTLEFS_*
+    uint32_t prog_size;
+    uint32_t cache_size;
+    uint32_t lookahead_size;
+    int32_t block_cycles;
+    bool power_loss_ooo;       // a power loss also reverts the last block written
+                               // since the previous sync (LFS_EMUBD_POWERLOSS_OOO)
+    const char *raw_label;     // raw data partition (esp_partition_*), NULL for none
+    uint32_t raw_size;         // bytes, a multiple of block_size
+} host_flash_config_t;
+
+typedef struct {
+    uint64_t bytes_read;
+    uint64_t bytes_programmed;
+    uint32_t reads;            // block device / esp_partition_* calls, littlefs metadata included
+    uint32_t progs;
+    uint32_t erases;
+    uint32_t max_wear;         // erases of the most worn block
+    uint32_t min_wear;
+    double mean_wear;
+} host_flash_stats_t;
+
+// partitions.csv, or partitions_ring.csv when the ring has its own partition
+#if CONFIG_PROJECTPLANT_RING_BACKEND_PARTITION
+#define HOST_FLASH_STORAGE_SIZE 0x60000
+#define HOST_FLASH_RAW_LABEL CONFIG_PROJECTPLANT_RING_PARTITION_LABEL
+#define HOST_FLASH_RAW_SIZE 0x10000
+#else
+#define HOST_FLASH_STORAGE_SIZE 0x70000
+#define HOST_FLASH_RAW_LABEL NULL
+#define HOST_FLASH_RAW_SIZE 0
+#endif
+
+#define HOST_FLASH_CONFIG_DEFAULT() { \
+    .block_size = CONFIG_LITTLEFS_BLOCK_SIZE, \
+    .block_count = HOST_FLASH_STORAGE_SIZE / CONFIG_LITTLEFS_BLOCK_SIZE, \
+    .read_size = CONFIG_LITTLEFS_READ_SIZE, \
+    .prog_size = CONFIG_LITTLEFS_WRITE_SIZE, \
+    .cache_size = CONFIG_LITTLEFS_CACHE_SIZE, \
+    .lookahead_size = CONFIG_LITTLEFS_LOOKAHEAD_SIZE, \
+    .block_cycles = CONFIG_LITTLEFS_BLOCK_CYCLES, \
+    .raw_label = HOST_FLASH_RAW_LABEL, \
+    .raw_size = HOST_FLASH_RAW_SIZE, \
+}
+
+// Create the device with an empty littlefs on it; esp_vfs_littlefs_register()
+// mounts it. Statistics count from here, the format included.
+int host_flash_init(const host_flash_config_t *config);
+void host_flash_deinit(void);
+
+// Cut power right after the next `ops` program/erase operations on either
+// partition (in practice, the one under test; 0 disarms): littlefs, every open
+// file and any raw partition write in progress are abandoned and control
+// longjmp()s to env. The caller then calls host_flash_recover() and reboots
+// the firmware under test, which mounts again.
+void host_flash_arm_power_loss(uint32_t ops, jmp_buf *env);
+// Close the streams a power loss abandoned (without touching flash) and
+// leave the partition unmounted
+void host_flash_recover(void);
+uint32_t host_flash_power_losses(void);
+
+// Counters for one partition, HOST_FLASH_STORAGE_LABEL or the raw label
+void host_flash_get_stats(const char *label, host_flash_stats_t *out);
@@ -0,0 +1,156 @@
+#include "host_platform.h"
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#include "esp_crc.h"
+#include "esp_err.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+
+#define HOST_SHUTDOWN_HANDLERS_MAX 8
+
+esp_log_level_t host_log_level = ESP_LOG_WARN;
+vprintf_like_t host_log_hook = NULL;
+
+static int64_t s_now_us = 0;
+static int64_t s_boot_us = 0;
+static shutdown_handler_t s_shutdown_handlers[HOST_SHUTDOWN_HANDLERS_MAX];
+
+int64_t host_clock_now_us(void)
+{
+    return s_now_us;
+}
+
+void host_clock_advance_us(int64_t delta_us)
+{
+    if (delta_us > 0) {
+        s_now_us += delta_us;
+    }
+}
+
+int64_t esp_timer_get_time(void)
+{
+    return s_now_us - s_boot_us;
+}
+
+// The level of the line being written, for the console behind the hook
+static esp_log_level_t s_log_line_level = ESP_LOG_NONE;
+
+static int host_log_console(const char *format, va_list args)
+{
+    return host_log_level >= s_log_line_level ? vfprintf(stderr, format, args) : 0;
+}
+
+vprintf_like_t esp_log_set_vprintf(vprintf_like_t func)
+{
+    vprintf_like_t previous = host_log_hook ? host_log_hook : host_log_console;
+    host_log_hook = func;
+    return previous;
+}
+
+uint32_t esp_log_timestamp(void)
+{
+    return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+void host_log_write(esp_log_level_t level, const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    s_log_line_level = level;
+    if (host_log_hook) {
+        host_log_hook(format, args);
+    }
+    va_end(args);
+}
+
+esp_err_t esp_register_shutdown_handler(shutdown_handler_t handle)
+{
+    for (size_t i = 0; i < HOST_SHUTDOWN_HANDLERS_MAX; ++i) {
+        if (s_shutdown_handlers[i] == handle) {
+            return ESP_ERR_INVALID_STATE;
+        }
+    }
+    for (size_t i = 0; i < HOST_SHUTDOWN_HANDLERS_MAX; ++i) {
+        if (!s_shutdown_handlers[i]) {
+            s_shutdown_handlers[i] = handle;
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NO_MEM;
+}
+
+esp_err_t esp_unregister_shutdown_handler(shutdown_handler_t handle)
+{
+    for (size_t i = 0; i < HOST_SHUTDOWN_HANDLERS_MAX; ++i) {
+        if (s_shutdown_handlers[i] == handle) {
+            s_shutdown_handlers[i] = NULL;
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_INVALID_STATE;
+}
+
+void host_restart(void)
+{
+    // Newest first, as esp_restart() does
+    for (size_t i = HOST_SHUTDOWN_HANDLERS_MAX; i-- > 0;) {
+        if (s_shutdown_handlers[i]) {
+            s_shutdown_handlers[i]();
+        }
+    }
+    host_power_cycle();
+}
+
+void host_power_cycle(void)
+{
+    for (size_t i = 0; i < HOST_SHUTDOWN_HANDLERS_MAX; ++i) {
+        s_shutdown_handlers[i] = NULL;
+    }
+    s_boot_us = s_now_us;
+}
+
+uint32_t esp_crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len)
+{
+    crc = ~crc;
+    for (uint32_t i = 0; i < len; ++i) {
+        crc ^= buf[i];
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1u)));
+        }
+    }
+    return ~crc;
+}
+
+uint16_t esp_crc16_le(uint16_t crc, const uint8_t *buf, uint32_t len)
+{
+    crc = (uint16_t)~crc;
+    for (uint32_t i = 0; i < len; ++i) {
+        crc ^= buf[i];
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = (uint16_t)((crc >> 1) ^ (0x8408u & (0u - (crc & 1u))));
+        }
+    }
+    return (uint16_t)~crc;
+}
+
+const char *esp_err_to_name(esp_err_t code)
+{
+    switch (code) {
+    case ESP_OK: return "ESP_OK";
+    case ESP_FAIL: return "ESP_FAIL";
+    case ESP_ERR_NO_MEM: return "ESP_ERR_NO_MEM";
+    case ESP_ERR_INVALID_ARG: return "ESP_ERR_INVALID_ARG";
+    case ESP_ERR_INVALID_STATE: return "ESP_ERR_INVALID_STATE";
+    case ESP_ERR_INVALID_SIZE: return "ESP_ERR_INVALID_SIZE";
+    case ESP_ERR_NOT_FOUND: return "ESP_ERR_NOT_FOUND";
+    case ESP_ERR_NOT_SUPPORTED: return "ESP_ERR_NOT_SUPPORTED";
+    case ESP_ERR_TIMEOUT: return "ESP_ERR_TIMEOUT";
+    case ESP_ERR_INVALID_RESPONSE: return "ESP_ERR_INVALID_RESPONSE";
+    case ESP_ERR_INVALID_CRC: return "ESP_ERR_INVALID_CRC";
+    case ESP_ERR_INVALID_VERSION: return "ESP_ERR_INVALID_VERSION";
+    default: return "UNKNOWN ERROR";
+    }
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "esp_log.h"
+
+// Simulated time and restarts for the host harnesses. The clock only moves
+// when the harness advances it, so a month of readings replays in seconds.
+
+// Microseconds since the simulated power-on; esp_timer_get_time() counts from
+// the most recent host_restart()/host_power_cycle() instead
+int64_t host_clock_now_us(void);
+void host_clock_advance_us(int64_t delta_us);
+
+// esp_restart(): run the registered shutdown handlers, then restart the
+// uptime clock. Handlers are forgotten, as firmware registers them again.
+void host_restart(void);
+// Power loss: restart the uptime clock without running any handler
+void host_power_cycle(void);
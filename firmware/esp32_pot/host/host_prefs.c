@@ -0,0 +1,85 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "preferences.h"
+
+// The harnesses' stand-in for preferences.c: an empty NVS that accepts
+// writes and keeps nothing, so every module runs on its defaults
+
+void prefs_init(void)
+{
+}
+
+esp_err_t prefs_begin(prefs_txn_t *txn, const char *nvs_namespace, bool writable)
+{
+    return txn ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t prefs_commit(prefs_txn_t *txn)
+{
+    return ESP_OK;
+}
+
+void prefs_end(prefs_txn_t *txn)
+{
+}
+
+esp_err_t prefs_txn_put_blob(prefs_txn_t *txn, const char *key, const void *value, size_t value_len)
+{
+    return ESP_OK;
+}
+
+esp_err_t prefs_txn_erase(prefs_txn_t *txn, const char *key)
+{
+    return ESP_OK;
+}
+
+esp_err_t prefs_txn_get_i32(prefs_txn_t *txn, const char *key, int32_t *out_value, int32_t default_value)
+{
+    *out_value = default_value;
+    return ESP_ERR_NVS_NOT_FOUND;
+}
+
+esp_err_t prefs_txn_get_u32(prefs_txn_t *txn, const char *key, uint32_t *out_value, uint32_t default_value)
+{
+    *out_value = default_value;
+    return ESP_ERR_NVS_NOT_FOUND;
+}
+
+esp_err_t prefs_txn_get_u64(prefs_txn_t *txn, const char *key, uint64_t *out_value, uint64_t default_value)
+{
+    *out_value = default_value;
+    return ESP_ERR_NVS_NOT_FOUND;
+}
+
+esp_err_t prefs_txn_get_bool(prefs_txn_t *txn, const char *key, bool *out_value, bool default_value)
+{
+    *out_value = default_value;
+    return ESP_ERR_NVS_NOT_FOUND;
+}
+
+esp_err_t prefs_get_blob(const char *nvs_namespace, const char *key, void *out_value, size_t *in_out_value_len)
+{
+    return ESP_ERR_NVS_NOT_FOUND;
+}
+
+esp_err_t prefs_defer_blob(const char *nvs_namespace, const char *key, const void *value, size_t value_len)
+{
+    return ESP_OK;
+}
+
+uint32_t prefs_commits_last_hour(void)
+{
+    return 0;
+}
+
+esp_err_t put_char(const char *key, unsigned char value)
+{
+    return ESP_OK;
+}
+
+char get_char(const char *key, unsigned char default_value)
+{
+    return (char)default_value;
+}
@@ -0,0 +1,23 @@
+// The single-threaded harnesses' semaphores (stubs/freertos/semphr.h): one
+// shared non-NULL handle. The node simulator brings real ones (sim_rtos.c).
+#include "freertos/semphr.h"
+
+struct host_semaphore {
+    int unused;
+};
+static struct host_semaphore s_semaphore;
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    return &s_semaphore;
+}
+
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex(void)
+{
+    return &s_semaphore;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t sem)
+{
+    (void)sem;
+}
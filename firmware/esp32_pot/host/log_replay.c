@@ -0,0 +1,683 @@
+// Replays a stream of ESP_LOG lines against the log ring (main/log_ring.c) on
+// an emulated flash, with restarts, deep sleep flushes, power cuts and bursts
+// that overrun the RAM queue, and reads the ring back through log_read the
+// way a hub would: every block is inflated with zlib and every record checked.
+//
+// Each line names its own index and boot, so a line read back is checked for
+// order, level, uptime and boot; a line missing from the middle of an upload
+// has to be explained by a power cut after it or by a dropped-lines record.
+
+#include <getopt.h>
+#include <math.h>
+#include <setjmp.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <zlib.h>
+
+#include "esp_littlefs.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "sdkconfig.h"
+
+#include "host_flash.h"
+#include "host_platform.h"
+#include "log_ring_host.h"
+#include "plant_mqtt_host.h"
+
+#define REPLAY_TAG "replay"
+#define REPLAY_DEVICE_ID "replay-pot"
+#define REPLAY_EPOCH_MS 1767225600000ULL   // plant_mqtt_host.c's clock at uptime 0
+#define REPLAY_BURST_LINES 200             // logged back to back, without the log task running
+#define REPLAY_BUSY_STEPS 5                // passes an upload sees a full outbox
+#define REPLAY_BLOCK_MAX CONFIG_LITTLEFS_BLOCK_SIZE
+
+typedef struct {
+    uint32_t lines;
+    double restarts;           // per 1000 lines
+    double power_losses;
+    double flushes;
+    double bursts;
+    uint32_t uploads;          // log_reads during the run, plus one at the end
+    uint64_t seed;
+    bool check;
+} options_t;
+
+typedef enum {
+    ENTRY_LINE,
+    ENTRY_CLOCK,
+    ENTRY_DROPPED,
+    ENTRY_OTHER,               // the ring's own lines and anything else
+} entry_kind_t;
+
+typedef struct {
+    entry_kind_t kind;
+    uint32_t index;
+    uint32_t harness_boot;
+    uint16_t boot;
+    uint8_t level;
+    uint32_t uptime_ms;
+    uint64_t value;
+} entry_t;
+
+typedef struct {
+    bool active;
+    bool done;
+    esp_err_t result;
+    size_t blocks_reported;
+    size_t blocks;
+    uint32_t last_seq;
+    bool saw_last;
+    char request_id[MQTT_REQUEST_ID_MAX_LEN];
+    entry_t *entries;
+    size_t count;
+    size_t cap;
+    uint32_t publishes_seen;
+} upload_t;
+
+typedef struct {
+    uint32_t emitted;
+    uint8_t *levels;           // per line index
+    uint32_t *uptimes;
+    uint8_t *lost;             // not known to be written when power was cut
+    uint32_t durable_upto;     // every line below was written
+    uint32_t harness_boot;
+    int64_t next_step_us;
+    uint32_t restarts;
+    uint32_t flushes;
+    uint32_t bursts;
+    uint32_t lost_count;
+    uint32_t uploads;
+    uint32_t uploads_interrupted;
+    uint32_t blocks;
+    uint64_t raw_bytes;
+    uint64_t compressed_bytes;
+    uint32_t captured;         // lines in the final upload
+    uint32_t clock_records;
+    uint64_t dropped;          // as the final upload's records count them
+    uint32_t busy_steps;
+    uint32_t errors;
+} sim_t;
+
+static options_t s_opt = {
+    .lines = 50000,
+    .restarts = 1.0,
+    .power_losses = 1.0,
+    .flushes = 4.0,
+    .bursts = 0.5,
+    .uploads = 8,
+    .seed = 1,
+};
+static sim_t s_sim;
+static upload_t s_up;
+static jmp_buf s_power_loss;
+static uint64_t s_rng;
+
+static const char *const PHRASES[] = {
+    "Soil moisture 41.2%% (raw 1873), temp 22.5C, RH 48%%",
+    "Published reading msg_id=%u",
+    "Pump on for 5000 ms (requestId=req-%u)",
+    "Wi-Fi RSSI -67 dBm, channel 6",
+    "MQTT outbox %u bytes",
+    "Light schedule 06:00-18:30 active",
+    "History query answered with %u readings",
+    "Water level low, pump locked out",
+};
+
+static uint64_t rng_next(void)
+{
+    uint64_t z = (s_rng += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+static double rng_unit(void)
+{
+    return (double)(rng_next() >> 11) / (double)(1ULL << 53);
+}
+
+static bool chance_per_1000(double rate)
+{
+    return rate > 0 && rng_unit() < rate / 1000.0;
+}
+
+static void fail(const char *what, uint32_t index)
+{
+    if (s_sim.errors++ < 10) {
+        fprintf(stderr, "log_replay: %s (line %u)\n", what, (unsigned)index);
+    }
+}
+
+// Upload collection
+
+static void on_upload_done(const char *request_id, size_t blocks, esp_err_t result)
+{
+    if (!s_up.active || strcmp(request_id, s_up.request_id) != 0) {
+        fail("done callback for an unknown request", 0);
+        return;
+    }
+    s_up.done = true;
+    s_up.result = result;
+    s_up.blocks_reported = blocks;
+}
+
+static void add_entry(const entry_t *entry)
+{
+    if (s_up.count == s_up.cap) {
+        size_t cap = s_up.cap ? s_up.cap * 2 : 1024;
+        entry_t *grown = realloc(s_up.entries, cap * sizeof(*grown));
+        if (!grown) {
+            fail("out of memory", 0);
+            return;
+        }
+        s_up.entries = grown;
+        s_up.cap = cap;
+    }
+    s_up.entries[s_up.count++] = *entry;
+}
+
+static uint32_t get_le32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void decode_records(const uint8_t *data, size_t len)
+{
+    size_t off = 0;
+    while (off + 8 <= len) {
+        entry_t e = {
+            .uptime_ms = get_le32(&data[off]),
+            .boot = (uint16_t)(data[off + 4] | (data[off + 5] << 8)),
+            .level = data[off + 6],
+        };
+        size_t text_len = data[off + 7];
+        const uint8_t *text = &data[off + 8];
+        off += 8 + text_len;
+        if (off > len) {
+            fail("record runs past its block", 0);
+            return;
+        }
+        if (e.level == 0) {
+            if (text_len == 9 && text[0] == 'c') {
+                e.kind = ENTRY_CLOCK;
+                memcpy(&e.value, &text[1], sizeof(uint64_t));
+            } else if (text_len == 5 && text[0] == 'd') {
+                uint32_t n;
+                memcpy(&n, &text[1], sizeof(n));
+                e.kind = ENTRY_DROPPED;
+                e.value = n;
+            } else {
+                fail("unknown ring event", 0);
+                continue;
+            }
+            add_entry(&e);
+            continue;
+        }
+        char line[UINT8_MAX + 1];
+        memcpy(line, text, text_len);
+        line[text_len] = '\0';
+        unsigned index = 0;
+        unsigned boot = 0;
+        e.kind = sscanf(line, REPLAY_TAG ": line %u boot %u ", &index, &boot) == 2 ? ENTRY_LINE : ENTRY_OTHER;
+        e.index = index;
+        e.harness_boot = boot;
+        add_entry(&e);
+    }
+    if (off != len) {
+        fail("trailing bytes in a block", 0);
+    }
+}
+
+// A log block publish since the last look, if any
+static void collect_publish(void)
+{
+    const plant_mqtt_host_publish_t *pub = plant_mqtt_host_last_publish();
+    if (pub->count == s_up.publishes_seen) {
+        return;
+    }
+    s_up.publishes_seen = pub->count;
+    if (!s_up.active || strcmp(pub->topic, "pots/" REPLAY_DEVICE_ID "/logs/bin") != 0) {
+        return;
+    }
+    const uint8_t *p = pub->payload;
+    if (pub->len > sizeof(pub->payload) || pub->len < MQTT_BIN_HEADER_LEN + 7 || p[1] != MQTT_BIN_KIND_LOG_BLOCK ||
+        pub->qos != 1) {
+        fail("malformed log block message", 0);
+        return;
+    }
+    bool last = (p[2] & MQTT_BIN_LOG_LAST) != 0;
+    uint32_t seq = get_le32(&p[MQTT_BIN_HEADER_LEN]);
+    size_t raw_len = p[MQTT_BIN_HEADER_LEN + 4] | (p[MQTT_BIN_HEADER_LEN + 5] << 8);
+    size_t id_len = p[MQTT_BIN_HEADER_LEN + 6];
+    size_t header_len = MQTT_BIN_HEADER_LEN + 7 + id_len;
+    if (header_len > pub->len || id_len != strlen(s_up.request_id) ||
+        memcmp(&p[MQTT_BIN_HEADER_LEN + 7], s_up.request_id, id_len) != 0) {
+        fail("log block request id", 0);
+        return;
+    }
+    if (s_up.blocks && (int32_t)(seq - s_up.last_seq) <= 0) {
+        fail("log blocks out of order", seq);
+    }
+    if (s_up.saw_last) {
+        fail("log block after the last one", seq);
+    }
+
+    uint8_t raw[REPLAY_BLOCK_MAX];
+    z_stream z;
+    memset(&z, 0, sizeof(z));
+    if (inflateInit2(&z, -15) != Z_OK) {
+        fail("inflateInit2", 0);
+        return;
+    }
+    z.next_in = (Bytef *)(p + header_len);
+    z.avail_in = (uInt)(pub->len - header_len);
+    z.next_out = raw;
+    z.avail_out = sizeof(raw);
+    int zr = inflate(&z, Z_FINISH);
+    size_t out_len = sizeof(raw) - z.avail_out;
+    inflateEnd(&z);
+    if (zr != Z_STREAM_END || out_len != raw_len) {
+        fail("log block does not inflate to its length", seq);
+        return;
+    }
+    s_up.blocks++;
+    s_up.last_seq = seq;
+    s_up.saw_last = last;
+    s_sim.blocks++;
+    s_sim.raw_bytes += raw_len;
+    s_sim.compressed_bytes += pub->len - header_len;
+    decode_records(raw, raw_len);
+}
+
+static void start_upload(void)
+{
+    free(s_up.entries);
+    memset(&s_up, 0, sizeof(s_up));
+    s_up.publishes_seen = plant_mqtt_host_last_publish()->count;
+    snprintf(s_up.request_id, sizeof(s_up.request_id), "log-%u", (unsigned)s_sim.uploads + 1);
+    if (log_ring_request_upload(plant_mqtt_host_client(), REPLAY_DEVICE_ID, s_up.request_id) != ESP_OK) {
+        fail("log_read rejected", s_sim.emitted);
+        return;
+    }
+    s_up.active = true;
+    s_sim.uploads++;
+    if (s_sim.uploads % 4 == 0) {
+        s_sim.busy_steps = REPLAY_BUSY_STEPS;
+    }
+}
+
+// Lines missing between two that arrived, or after the last one in a final
+// upload, have to be lost to a power cut or counted by a dropped record
+static void verify_upload(bool final)
+{
+    if (s_up.result != ESP_OK) {
+        fail("log_read did not complete", s_sim.emitted);
+        return;
+    }
+    if (s_up.blocks_reported != s_up.blocks || (s_up.blocks && !s_up.saw_last)) {
+        fail("log_read block count", s_sim.emitted);
+    }
+    int64_t prev = -1;
+    uint32_t prev_harness_boot = 0;
+    uint16_t prev_boot = 0;
+    uint64_t missing = 0;
+    uint64_t dropped = 0;
+    uint32_t lines = 0;
+    uint32_t clocks = 0;
+    for (size_t i = 0; i < s_up.count; ++i) {
+        const entry_t *e = &s_up.entries[i];
+        if (e->kind == ENTRY_CLOCK) {
+            clocks++;
+            if (e->value != REPLAY_EPOCH_MS) {
+                fail("clock record", prev < 0 ? 0 : (uint32_t)prev);
+            }
+            continue;
+        }
+        if (e->kind == ENTRY_DROPPED) {
+            dropped += e->value;
+            continue;
+        }
+        if (e->kind != ENTRY_LINE) {
+            continue;
+        }
+        if (e->index >= s_sim.emitted) {
+            fail("line never logged", e->index);
+            continue;
+        }
+        if (prev >= 0) {
+            if ((int64_t)e->index <= prev) {
+                fail("line out of order or repeated", e->index);
+                continue;
+            }
+            for (uint32_t m = (uint32_t)prev + 1; m < e->index; ++m) {
+                missing += !s_sim.lost[m];
+            }
+            // A boot that left nothing on flash leaves no number behind either
+            bool same_boot = e->harness_boot == prev_harness_boot;
+            if (same_boot ? e->boot != prev_boot : e->boot <= prev_boot) {
+                fail("boot number", e->index);
+            }
+        }
+        if (e->level != s_sim.levels[e->index] || e->uptime_ms != s_sim.uptimes[e->index]) {
+            fail("line level or uptime", e->index);
+        }
+        prev = e->index;
+        prev_harness_boot = e->harness_boot;
+        prev_boot = e->boot;
+        lines++;
+    }
+    if (final) {
+        for (uint32_t m = prev < 0 ? 0 : (uint32_t)prev + 1; m < s_sim.emitted; ++m) {
+            missing += !s_sim.lost[m];
+        }
+        s_sim.captured = lines;
+        s_sim.clock_records = clocks;
+        s_sim.dropped = dropped;
+        if (!clocks) {
+            fail("no clock record", s_sim.emitted);
+        }
+    }
+    if (missing > dropped) {
+        fprintf(stderr, "log_replay: %llu lines missing, %llu counted as dropped\n", (unsigned long long)missing,
+                (unsigned long long)dropped);
+        fail("lines missing", s_sim.emitted);
+    }
+}
+
+// The log task: the passes due by now, each sleeping what the last returned
+static void run_task(bool now)
+{
+    if (now) {
+        s_sim.next_step_us = esp_timer_get_time();
+    }
+    while (s_sim.next_step_us <= esp_timer_get_time()) {
+        plant_mqtt_host_set_outbox_size(s_sim.busy_steps ? INT32_MAX : 0);
+        if (s_sim.busy_steps) {
+            s_sim.busy_steps--;
+        }
+        uint32_t wait_ms = log_ring_host_step();
+        if (log_ring_host_written()) {
+            s_sim.durable_upto = s_sim.emitted;
+        }
+        collect_publish();
+        s_sim.next_step_us += (int64_t)wait_ms * 1000;
+        if (s_up.active && s_up.done) {
+            verify_upload(false);
+            s_up.active = false;
+        }
+    }
+}
+
+static void boot(void)
+{
+    s_sim.harness_boot++;
+    s_sim.next_step_us = 0;
+    if (log_ring_init() != ESP_OK || log_ring_start() != ESP_OK) {
+        fail("log ring start", s_sim.emitted);
+    }
+    log_ring_set_upload_callback(on_upload_done);
+}
+
+static void drop_upload(void)
+{
+    if (s_up.active) {
+        s_up.active = false;
+        s_sim.uploads_interrupted++;
+    }
+}
+
+static void restart(void)
+{
+    host_restart();
+    esp_vfs_littlefs_unregister(HOST_FLASH_STORAGE_LABEL);
+    // The shutdown handler wrote everything queued
+    s_sim.durable_upto = s_sim.emitted;
+    log_ring_host_forget();
+    drop_upload();
+    s_sim.restarts++;
+    boot();
+}
+
+static void on_power_loss(void)
+{
+    host_flash_recover();
+    for (uint32_t i = s_sim.durable_upto; i < s_sim.emitted; ++i) {
+        s_sim.lost[i] = 1;
+        s_sim.lost_count++;
+    }
+    s_sim.durable_upto = s_sim.emitted;
+    log_ring_host_forget();
+    host_power_cycle();
+    drop_upload();
+    boot();
+}
+
+static void emit_line(void)
+{
+    uint32_t i = s_sim.emitted;
+    double r = rng_unit();
+    esp_log_level_t level = r < 0.03 ? ESP_LOG_ERROR : r < 0.18 ? ESP_LOG_WARN : ESP_LOG_INFO;
+    const char *phrase = PHRASES[rng_next() % (sizeof(PHRASES) / sizeof(PHRASES[0]))];
+    char text[96];
+    snprintf(text, sizeof(text), phrase, (unsigned)(rng_next() % 5000));
+    s_sim.levels[i] = (uint8_t)level;
+    s_sim.uptimes[i] = (uint32_t)(esp_timer_get_time() / 1000);
+    s_sim.emitted++;
+    switch (level) {
+    case ESP_LOG_ERROR:
+        ESP_LOGE(REPLAY_TAG, "line %u boot %u %s", (unsigned)i, (unsigned)s_sim.harness_boot, text);
+        break;
+    case ESP_LOG_WARN:
+        ESP_LOGW(REPLAY_TAG, "line %u boot %u %s", (unsigned)i, (unsigned)s_sim.harness_boot, text);
+        break;
+    default:
+        ESP_LOGI(REPLAY_TAG, "line %u boot %u %s", (unsigned)i, (unsigned)s_sim.harness_boot, text);
+        break;
+    }
+}
+
+static void step(void)
+{
+    // Where the clock settles, as time_sync.c would
+    plant_mqtt_host_set_time_valid(s_sim.emitted >= s_opt.lines / 10);
+    plant_mqtt_host_set_time_synced(s_sim.emitted >= s_opt.lines / 5);
+
+    if (chance_per_1000(s_opt.bursts)) {
+        s_sim.bursts++;
+        for (uint32_t n = 0; n < REPLAY_BURST_LINES && s_sim.emitted < s_opt.lines; ++n) {
+            emit_line();
+        }
+    } else {
+        host_clock_advance_us((int64_t)(-2e6 * log(1.0 - rng_unit())));
+        emit_line();
+    }
+    // An error line wakes the task
+    run_task(s_sim.levels[s_sim.emitted - 1] == ESP_LOG_ERROR);
+
+    if (chance_per_1000(s_opt.flushes)) {
+        // Deep sleep: flushed, then a boot with the uptime clock restarted
+        if (log_ring_flush() != ESP_OK) {
+            fail("flush", s_sim.emitted);
+        }
+        s_sim.durable_upto = s_sim.emitted;
+        s_sim.flushes++;
+        host_power_cycle();
+        log_ring_host_forget();
+        esp_vfs_littlefs_unregister(HOST_FLASH_STORAGE_LABEL);
+        drop_upload();
+        boot();
+    }
+    if (chance_per_1000(s_opt.restarts)) {
+        restart();
+    }
+    if (chance_per_1000(s_opt.power_losses)) {
+        host_flash_arm_power_loss(1 + (uint32_t)(rng_next() % 16), &s_power_loss);
+    }
+    if (s_opt.uploads && !s_up.active && s_sim.emitted % (s_opt.lines / (s_opt.uploads + 1) + 1) == 0) {
+        start_upload();
+    }
+}
+
+static void run(void)
+{
+    if (setjmp(s_power_loss) != 0) {
+        on_power_loss();
+    }
+    while (s_sim.emitted < s_opt.lines) {
+        step();
+    }
+    host_flash_arm_power_loss(0, NULL);
+
+    // Everything written, then one log_read for the whole ring
+    if (log_ring_flush() != ESP_OK) {
+        fail("flush", s_sim.emitted);
+    }
+    s_sim.durable_upto = s_sim.emitted;
+    drop_upload();
+    s_sim.busy_steps = 0;
+    start_upload();
+    for (int n = 0; n < 10000 && s_up.active && !s_up.done; ++n) {
+        host_clock_advance_us(20000);
+        run_task(true);
+        if (s_up.done) {
+            break;
+        }
+    }
+    if (!s_up.done) {
+        fail("final log_read never finished", s_sim.emitted);
+        return;
+    }
+}
+
+static double wall_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr,
+            "usage: %s [options]\n"
+            "  --lines N                lines to log (50000)\n"
+            "  --restarts X             clean restarts per 1000 lines (1)\n"
+            "  --power-losses X         power cuts per 1000 lines, 1-16 flash operations later (1)\n"
+            "  --flushes X              deep sleeps (flush, then boot) per 1000 lines (4)\n"
+            "  --bursts X               bursts of %d lines the queue cannot hold, per 1000 lines (0.5)\n"
+            "  --uploads N              log_reads during the run, one in four against a full outbox (8)\n"
+            "  --seed N                 seed (1)\n"
+            "  --check                  exit 1 on any line out of order, altered, or missing without\n"
+            "                           a power cut or a dropped record to explain it\n"
+            "  -v                       ring and flash logs\n",
+            argv0, REPLAY_BURST_LINES);
+}
+
+static bool parse_options(int argc, char **argv)
+{
+    static const struct option longopts[] = {
+        {"lines", required_argument, NULL, 'l'},
+        {"restarts", required_argument, NULL, 'r'},
+        {"power-losses", required_argument, NULL, 'p'},
+        {"flushes", required_argument, NULL, 'f'},
+        {"bursts", required_argument, NULL, 'b'},
+        {"uploads", required_argument, NULL, 'u'},
+        {"seed", required_argument, NULL, 's'},
+        {"check", no_argument, NULL, 'c'},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0},
+    };
+    // The replay's own lines would flood stderr
+    host_log_level = ESP_LOG_NONE;
+    int c;
+    while ((c = getopt_long(argc, argv, "vh", longopts, NULL)) != -1) {
+        switch (c) {
+        case 'l': s_opt.lines = (uint32_t)strtoul(optarg, NULL, 0); break;
+        case 'r': s_opt.restarts = strtod(optarg, NULL); break;
+        case 'p': s_opt.power_losses = strtod(optarg, NULL); break;
+        case 'f': s_opt.flushes = strtod(optarg, NULL); break;
+        case 'b': s_opt.bursts = strtod(optarg, NULL); break;
+        case 'u': s_opt.uploads = (uint32_t)strtoul(optarg, NULL, 0); break;
+        case 's': s_opt.seed = strtoull(optarg, NULL, 0); break;
+        case 'c': s_opt.check = true; break;
+        case 'v': host_log_level = ESP_LOG_INFO; break;
+        default:
+            usage(argv[0]);
+            return false;
+        }
+    }
+    if (optind != argc || s_opt.lines == 0) {
+        usage(argv[0]);
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    if (!parse_options(argc, argv)) {
+        return 2;
+    }
+    s_rng = s_opt.seed;
+    s_sim.levels = calloc(s_opt.lines, 1);
+    s_sim.uptimes = calloc(s_opt.lines, sizeof(uint32_t));
+    s_sim.lost = calloc(s_opt.lines, 1);
+    if (!s_sim.levels || !s_sim.uptimes || !s_sim.lost) {
+        fprintf(stderr, "out of memory\n");
+        return 2;
+    }
+    host_flash_config_t flash = HOST_FLASH_CONFIG_DEFAULT();
+    if (host_flash_init(&flash) != 0) {
+        fprintf(stderr, "flash emulation init failed\n");
+        return 2;
+    }
+
+    double started = wall_seconds();
+    boot();
+    run();
+    if (s_up.done) {
+        verify_upload(true);
+    }
+    double wall_s = wall_seconds() - started;
+
+    host_flash_stats_t st;
+    host_flash_get_stats(HOST_FLASH_STORAGE_LABEL, &st);
+    uint32_t power_losses = host_flash_power_losses();
+    double ratio = s_sim.compressed_bytes ? (double)s_sim.raw_bytes / (double)s_sim.compressed_bytes : 0.0;
+    double lines = s_sim.emitted ? (double)s_sim.emitted : 1.0;
+
+    printf("Logged %u lines (%u bursts): %u in the final log_read of %u blocks, %llu counted as dropped\n",
+           (unsigned)s_sim.emitted, (unsigned)s_sim.bursts, (unsigned)s_sim.captured, (unsigned)s_up.blocks,
+           (unsigned long long)s_sim.dropped);
+    printf("Boots: %u restarts, %u deep sleeps, %u power losses with %u lines not yet written\n",
+           (unsigned)s_sim.restarts, (unsigned)s_sim.flushes, (unsigned)power_losses, (unsigned)s_sim.lost_count);
+    printf("Uploads: %u log_reads (%u interrupted by a boot), %u blocks, %llu raw bytes sent as %llu (%.2fx)\n",
+           (unsigned)s_sim.uploads, (unsigned)s_sim.uploads_interrupted, (unsigned)s_sim.blocks,
+           (unsigned long long)s_sim.raw_bytes, (unsigned long long)s_sim.compressed_bytes, ratio);
+    printf("Flash: %u erases, wear max %u / mean %.1f, %llu bytes programmed (%.1f per line)\n",
+           (unsigned)st.erases, (unsigned)st.max_wear, st.mean_wear, (unsigned long long)st.bytes_programmed,
+           (double)st.bytes_programmed / lines);
+    printf("Host time %.2f s, %u errors\n", wall_s, (unsigned)s_sim.errors);
+    printf("LOG_REPLAY {\"lines\":%u,\"captured\":%u,\"dropped\":%llu,\"lost\":%u,\"restarts\":%u,\"flushes\":%u,"
+           "\"power_losses\":%u,\"uploads\":%u,\"blocks\":%u,\"raw_bytes\":%llu,\"compressed_bytes\":%llu,"
+           "\"ratio\":%.2f,\"clock_records\":%u,\"erases\":%u,\"max_wear\":%u,\"bytes_programmed\":%llu,"
+           "\"prog_bytes_per_line\":%.1f,\"errors\":%u,\"wall_s\":%.3f}\n",
+           (unsigned)s_sim.emitted, (unsigned)s_sim.captured, (unsigned long long)s_sim.dropped,
+           (unsigned)s_sim.lost_count, (unsigned)s_sim.restarts, (unsigned)s_sim.flushes, (unsigned)power_losses,
+           (unsigned)s_sim.uploads, (unsigned)s_sim.blocks, (unsigned long long)s_sim.raw_bytes,
+           (unsigned long long)s_sim.compressed_bytes, ratio, (unsigned)s_sim.clock_records, (unsigned)st.erases,
+           (unsigned)st.max_wear, (unsigned long long)st.bytes_programmed, (double)st.bytes_programmed / lines,
+           (unsigned)s_sim.errors, wall_s);
+
+    host_flash_deinit();
+    free(s_up.entries);
+    free(s_sim.levels);
+    free(s_sim.uptimes);
+    free(s_sim.lost);
+    return s_opt.check && s_sim.errors ? 1 : 0;
+}
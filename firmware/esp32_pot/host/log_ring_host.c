@@ -0,0 +1,35 @@
+// log_ring.c built for the host, plus the task pass and a reset between
+// simulated boots. Including it keeps main/log_ring.c unchanged.
+#include "../main/log_ring.c"
+
+#include "log_ring_host.h"
+
+uint32_t log_ring_host_step(void)
+{
+    return log_ring_step();
+}
+
+bool log_ring_host_written(void)
+{
+    return s_queue_used == 0 && s_dropped == 0 && !s_dirty;
+}
+
+void log_ring_host_forget(void)
+{
+    s_queue_start = 0;
+    s_queue_used = 0;
+    s_dropped = 0;
+    memset(&s_request, 0, sizeof(s_request));
+    s_task = NULL;
+    s_ready = false;
+    s_boot = 0;
+    s_first_seq = 0;
+    memset(&s_block, 0, sizeof(s_block));
+    s_dirty = false;
+    s_urgent = false;
+    s_dirty_since_us = 0;
+    s_written_us = 0;
+    s_clock_state = 0;
+    free(s_upload.buf);
+    memset(&s_upload, 0, sizeof(s_upload));
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "log_ring.h"
+
+// main/log_ring.c built for the host. The stub scheduler never runs the log
+// task, so the harness runs its passes itself.
+
+// One pass of the log task: take the queued lines, write the open block when
+// due and move an upload on by one block. Returns the wait the task would
+// sleep for (ms).
+uint32_t log_ring_host_step(void);
+// Every line logged so far is on flash: none queued, none only in RAM
+bool log_ring_host_written(void);
+// Drop the ring's RAM state, as a reboot would, so the next log_ring_start()
+// recovers from flash. The hook stays installed (log_ring_init() keeps it).
+void log_ring_host_forget(void);
@@ -0,0 +1,410 @@
+// Microbenchmark for main/plant_mqtt.c on the host: time and heap
+// allocations per call of mqtt_parse_command() for each command type
+// (schedule updates go through parse_schedule_config()), of
+// node_schedule_parse_hhmm(), and of each payload builder behind
+// mqtt_publish_*() and the binary encoders.
+//
+// Allocations are counted by wrapping malloc/calloc/realloc at link time
+// (-Wl,--wrap), so only calls made from the firmware sources and this file
+// count. Firmware code meant for the MQTT and sensor tasks should stay at 0.
+
+#include <getopt.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "host_platform.h"
+#include "node_schedule.h"
+#include "plant_mqtt.h"
+#include "plant_mqtt_host.h"
+
+#define BENCH_DEVICE_ID "pot-bench01"
+#define BENCH_VERSION "bench"
+#define BENCH_MIN_TIME_S 0.2      // per op unless --iterations is given
+#define BENCH_CHECK_ITERATIONS 64
+
+typedef struct {
+    const char *name;
+    mqtt_command_type_t expect;
+    const char *json;
+} bench_command_t;
+
+static const bench_command_t COMMANDS[] = {
+    {"pump_override", MQTT_CMD_PUMP_OVERRIDE, "{\"pump\":\"on\",\"duration_ms\":5000,\"requestId\":\"bench-1\"}"},
+    {"pump_watering", MQTT_CMD_PUMP_OVERRIDE,
+     "{\"pump\":\"on\",\"targetMoisture\":45,\"maxVolumeMl\":200,\"duration_ms\":60000,\"requestId\":\"bench-2\"}"},
+    {"ic_zone1_override", MQTT_CMD_IC_ZONE1_OVERRIDE, "{\"icZone1\":\"on\",\"duration_ms\":800}"},
+    {"fan_override", MQTT_CMD_FAN_OVERRIDE, "{\"fan\":true,\"duration_ms\":600000,\"requestId\":\"bench-3\"}"},
+    {"mister_override", MQTT_CMD_MISTER_OVERRIDE, "{\"mister\":\"off\"}"},
+    {"light_override", MQTT_CMD_LIGHT_OVERRIDE, "{\"light\":\"on\",\"requestId\":\"bench-4\"}"},
+    {"scene", MQTT_CMD_SCENE,
+     "{\"scene\":{\"fan\":\"on\",\"mister\":{\"state\":\"on\",\"duration_ms\":30000},\"light\":\"off\"},"
+     "\"duration_ms\":600000,\"requestId\":\"bench-5\"}"},
+    {"sensor_read", MQTT_CMD_SENSOR_READ, "{\"action\":\"sensor_read\",\"requestId\":\"req-123\"}"},
+    {"history_query", MQTT_CMD_HISTORY_QUERY,
+     "{\"action\":\"history_query\",\"fromMs\":1728900000000,\"toMs\":1728986400000,\"requestId\":\"gap-1\"}"},
+    {"diag_read", MQTT_CMD_DIAG_READ, "{\"action\":\"diag\",\"requestId\":\"diag-1\"}"},
+    {"log_read", MQTT_CMD_LOG_READ, "{\"action\":\"log_read\",\"requestId\":\"log-1\"}"},
+    {"config_identity", MQTT_CMD_CONFIG_UPDATE,
+     "{\"deviceName\":\"Kitchen Basil\",\"sensorMode\":\"full\",\"payloadEncoding\":\"binary\",\"requestId\":\"cfg-1\"}"},
+    {"config_schedule", MQTT_CMD_CONFIG_UPDATE,
+     "{\"schedule\":{"
+     "\"light\":{\"enabled\":true,\"startTime\":\"06:00\",\"endTime\":\"18:30\"},"
+     "\"pump\":{\"enabled\":false,\"startTime\":\"00:00\",\"endTime\":\"00:00\"},"
+     "\"mister\":{\"enabled\":false,\"startTime\":\"00:00\",\"endTime\":\"00:00\"},"
+     "\"fan\":{\"enabled\":true,\"startTime\":\"08:15\",\"endTime\":\"09:00\"},"
+     "\"tzOffsetMinutes\":-300},"
+     "\"updatedAtMs\":1728912345678}"},
+    {"config_report_policy", MQTT_CMD_CONFIG_UPDATE,
+     "{\"reportPolicy\":{\"moistureDeadband\":1.5,\"temperatureDeadband\":0.3,\"humidityDeadband\":2,\"maxSilenceS\":900}}"},
+    {"config_soil_calibration", MQTT_CMD_CONFIG_UPDATE, "{\"soilCalibration\":{\"rawDry\":17040,\"rawWet\":7507}}"},
+    {"config_interval", MQTT_CMD_CONFIG_UPDATE, "{\"measurementInterval\":{\"activeS\":5,\"minS\":60,\"maxS\":600}}"},
+    {"invalid_json", MQTT_CMD_UNKNOWN, "{\"pump\":\"on\",\"duration_ms\":"},
+};
+
+typedef struct {
+    const char *name;
+    void (*run)(void);
+    bool publishes;     // check: the op must leave a publish behind
+} bench_builder_t;
+
+static struct {
+    uint64_t iterations;
+    const char *filter;
+    bool check;
+} s_opt;
+
+static uint64_t s_allocs;
+static sensor_reading_t s_reading;
+static sensor_reading_t s_window_reading;
+static sensor_reading_t s_batch[MQTT_READING_BATCH_MAX];
+static runtime_diag_t s_diag;
+static watering_result_t s_watering;
+static actuator_scene_t s_scene;
+static const bench_command_t *s_command;
+static mqtt_command_scratch_t s_scratch;
+static volatile uint32_t s_sink;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+void *__wrap_malloc(size_t size)
+{
+    s_allocs++;
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size)
+{
+    s_allocs++;
+    return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+    s_allocs++;
+    return __real_realloc(ptr, size);
+}
+
+static double wall_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void fill_reading(sensor_reading_t *r, unsigned i)
+{
+    memset(r, 0, sizeof(*r));
+    r->timestamp_ms = 1767225600000ULL + (uint64_t)i * 60000ULL;
+    r->soil_raw = (uint16_t)(12000 + i * 7);
+    r->soil_percent = 47.25f + (float)i * 0.1f;
+    r->temperature_c = 22.8f;
+    r->humidity_pct = 55.5f;
+    r->battery_v = 3.91f;
+    r->pump_is_on = (i % 5) == 0;
+    r->light_is_on = true;
+}
+
+static void setup_fixtures(void)
+{
+    fill_reading(&s_reading, 0);
+    s_window_reading = s_reading;
+    s_window_reading.window_samples = 12;
+    s_window_reading.soil_spread = (sensor_spread_t){46.8f, 47.5f, 0.21f};
+    s_window_reading.temperature_spread = (sensor_spread_t){22.7f, 22.9f, 0.06f};
+    s_window_reading.humidity_spread = (sensor_spread_t){54.9f, 56.0f, 0.33f};
+    for (unsigned i = 0; i < MQTT_READING_BATCH_MAX; ++i) {
+        fill_reading(&s_batch[i], i);
+    }
+
+    static const char *const tasks[] = {"sensor_task", "network_task", "command_task", "schedule_task", "watering_task"};
+    memset(&s_diag, 0, sizeof(s_diag));
+    s_diag.uptime_s = 86400;
+    s_diag.cpu_valid = true;
+    s_diag.cpu_idle_pct = 93;
+    s_diag.task_count = sizeof(tasks) / sizeof(tasks[0]);
+    for (size_t i = 0; i < s_diag.task_count; ++i) {
+        s_diag.tasks[i] = (runtime_diag_task_t){.name = tasks[i], .found = true, .cpu_pct = 1, .stack_free_bytes = 1200};
+    }
+    s_diag.heap_free = 142000;
+    s_diag.heap_min_free = 118000;
+    s_diag.heap_largest_free = 65536;
+    s_diag.mqtt_outbox_bytes = 0;
+
+    s_scene = (actuator_scene_t){
+        .mask = (1u << NODE_SCHEDULE_TARGET_FAN) | (1u << NODE_SCHEDULE_TARGET_MISTER) | (1u << NODE_SCHEDULE_TARGET_LIGHT),
+        .on = (1u << NODE_SCHEDULE_TARGET_FAN) | (1u << NODE_SCHEDULE_TARGET_MISTER),
+        .duration_ms = {[NODE_SCHEDULE_TARGET_FAN] = 600000, [NODE_SCHEDULE_TARGET_MISTER] = 30000},
+    };
+    s_watering = (watering_result_t){
+        .reason = WATERING_STOP_TARGET,
+        .delivered_ms = 18250,
+        .start_pct = 31.5f,
+        .end_pct = 45.2f,
+        .target_pct = 45.0f,
+        .request_id = "bench-2",
+    };
+}
+
+static void run_parse(void)
+{
+    mqtt_command_t cmd = mqtt_parse_command(s_command->json, (int)strlen(s_command->json), &s_scratch);
+    s_sink += (uint32_t)cmd.type;
+}
+
+static void run_parse_hhmm(void)
+{
+    static const char *const times[] = {"06:00", "18:30", "23:59", "7:05"};
+    uint16_t minutes = 0;
+    for (size_t i = 0; i < sizeof(times) / sizeof(times[0]); ++i) {
+        node_schedule_parse_hhmm(times[i], &minutes);
+        s_sink += minutes;
+    }
+}
+
+static void run_publish_reading(void)
+{
+    mqtt_publish_reading(plant_mqtt_host_client(), BENCH_DEVICE_ID, &s_reading, NULL);
+}
+
+static void run_publish_reading_window(void)
+{
+    mqtt_publish_reading(plant_mqtt_host_client(), BENCH_DEVICE_ID, &s_window_reading, NULL);
+}
+
+static void run_publish_reading_binary(void)
+{
+    plant_mqtt_host_set_identity("Bench Pot", true, PAYLOAD_ENCODING_BINARY);
+    mqtt_publish_reading(plant_mqtt_host_client(), BENCH_DEVICE_ID, &s_reading, NULL);
+    plant_mqtt_host_set_identity("Bench Pot", true, PAYLOAD_ENCODING_JSON);
+}
+
+static void run_publish_batch(void)
+{
+    mqtt_publish_reading_batch(plant_mqtt_host_client(), BENCH_DEVICE_ID, s_batch, MQTT_READING_BATCH_MAX, NULL);
+}
+
+static void run_publish_status(void)
+{
+    mqtt_publish_status(plant_mqtt_host_client(), BENCH_DEVICE_ID, BENCH_VERSION, "pump_on", "bench-1");
+}
+
+static void run_publish_watering(void)
+{
+    mqtt_publish_watering_result(plant_mqtt_host_client(), BENCH_DEVICE_ID, BENCH_VERSION, &s_watering);
+}
+
+static void run_publish_scene(void)
+{
+    mqtt_publish_scene_status(plant_mqtt_host_client(), BENCH_DEVICE_ID, BENCH_VERSION, "scene_applied", &s_scene,
+                              "bench-5");
+}
+
+static void run_publish_schedule(void)
+{
+    mqtt_publish_schedule_state(plant_mqtt_host_client(), BENCH_DEVICE_ID, BENCH_VERSION);
+}
+
+static void run_publish_ping(void)
+{
+    mqtt_publish_ping(plant_mqtt_host_client(), BENCH_DEVICE_ID);
+}
+
+static void run_publish_diag(void)
+{
+    mqtt_publish_diag(plant_mqtt_host_client(), BENCH_DEVICE_ID, &s_diag, "diag-1");
+}
+
+static void run_encode_binary(void)
+{
+    uint8_t out[MQTT_BIN_READING_WINDOW_LEN];
+    s_sink += (uint32_t)mqtt_encode_reading_binary(&s_window_reading, true, s_window_reading.timestamp_ms, out, sizeof(out));
+}
+
+static const bench_builder_t BUILDERS[] = {
+    {"parse_hhmm_x4", run_parse_hhmm, false},
+    {"publish_reading", run_publish_reading, true},
+    {"publish_reading_window", run_publish_reading_window, true},
+    {"publish_reading_binary", run_publish_reading_binary, true},
+    {"publish_reading_batch16", run_publish_batch, true},
+    {"publish_status", run_publish_status, true},
+    {"publish_watering_result", run_publish_watering, true},
+    {"publish_scene_status", run_publish_scene, true},
+    {"publish_schedule_state", run_publish_schedule, true},
+    {"publish_ping", run_publish_ping, true},
+    {"publish_diag", run_publish_diag, true},
+    {"encode_reading_binary", run_encode_binary, false},
+};
+
+typedef struct {
+    uint64_t iterations;
+    double ns_per_op;
+    double allocs_per_op;
+} bench_result_t;
+
+static bench_result_t measure(void (*run)(void))
+{
+    bench_result_t res = {0};
+    run();  // warm caches and one-time lazy state
+    uint64_t n = s_opt.iterations ? s_opt.iterations : 64;
+    for (;;) {
+        uint64_t allocs_before = s_allocs;
+        double started = wall_seconds();
+        for (uint64_t i = 0; i < n; ++i) {
+            run();
+        }
+        double elapsed = wall_seconds() - started;
+        if (s_opt.iterations || elapsed >= BENCH_MIN_TIME_S || n >= (1ULL << 32)) {
+            res.iterations = n;
+            res.ns_per_op = elapsed * 1e9 / (double)n;
+            res.allocs_per_op = (double)(s_allocs - allocs_before) / (double)n;
+            return res;
+        }
+        n *= elapsed > 0 ? (uint64_t)fmin(ceil(BENCH_MIN_TIME_S / elapsed * 1.2), 100.0) : 100;
+    }
+}
+
+static bool selected(const char *name)
+{
+    return !s_opt.filter || strstr(name, s_opt.filter);
+}
+
+static void report(const char *group, const char *name, const bench_result_t *res, size_t payload_len)
+{
+    printf("%-8s %-26s %10.1f ns/op %6.2f allocs/op %6zu bytes\n",
+           group, name, res->ns_per_op, res->allocs_per_op, payload_len);
+}
+
+static void report_json(const char *group, const char *name, const bench_result_t *res, size_t payload_len)
+{
+    printf("MQTT_BENCH {\"group\":\"%s\",\"op\":\"%s\",\"iterations\":%llu,\"ns_per_op\":%.1f,"
+           "\"allocs_per_op\":%.2f,\"bytes\":%zu}\n",
+           group, name, (unsigned long long)res->iterations, res->ns_per_op, res->allocs_per_op, payload_len);
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr,
+            "usage: %s [options]\n"
+            "  --iterations N   fixed iteration count per op (default: as many as fit in %.1f s)\n"
+            "  --filter S       only ops whose name contains S\n"
+            "  --json           one MQTT_BENCH line per op as well\n"
+            "  --check          %d iterations; exit 1 if a command parses to the wrong type,\n"
+            "                   a builder publishes nothing, or anything allocates\n"
+            "  -v               plant_mqtt logs (repeat for more)\n",
+            argv0, BENCH_MIN_TIME_S, BENCH_CHECK_ITERATIONS);
+}
+
+int main(int argc, char **argv)
+{
+    static const struct option longopts[] = {
+        {"iterations", required_argument, NULL, 'n'},
+        {"filter", required_argument, NULL, 'f'},
+        {"json", no_argument, NULL, 'j'},
+        {"check", no_argument, NULL, 'c'},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0},
+    };
+    bool json = false;
+    int c;
+    host_log_level = ESP_LOG_NONE;  // the invalid case would log every call
+    while ((c = getopt_long(argc, argv, "vh", longopts, NULL)) != -1) {
+        switch (c) {
+        case 'n': s_opt.iterations = strtoull(optarg, NULL, 0); break;
+        case 'f': s_opt.filter = optarg; break;
+        case 'j': json = true; break;
+        case 'c': s_opt.check = true; break;
+        case 'v': host_log_level = host_log_level < ESP_LOG_WARN ? ESP_LOG_WARN : ESP_LOG_DEBUG; break;
+        default:
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (optind != argc) {
+        usage(argv[0]);
+        return 2;
+    }
+    if (s_opt.check && !s_opt.iterations) {
+        s_opt.iterations = BENCH_CHECK_ITERATIONS;
+    }
+
+    setup_fixtures();
+    node_schedule_init();
+    unsigned failures = 0;
+
+    for (size_t i = 0; i < sizeof(COMMANDS) / sizeof(COMMANDS[0]); ++i) {
+        s_command = &COMMANDS[i];
+        if (!selected(s_command->name)) {
+            continue;
+        }
+        mqtt_command_t cmd = mqtt_parse_command(s_command->json, (int)strlen(s_command->json), &s_scratch);
+        if (cmd.type != s_command->expect) {
+            fprintf(stderr, "%s: parsed as type %d, expected %d\n", s_command->name, (int)cmd.type, (int)s_command->expect);
+            failures++;
+        }
+        bench_result_t res = measure(run_parse);
+        if (res.allocs_per_op > 0 && s_opt.check) {
+            fprintf(stderr, "%s: %.2f allocations per parse\n", s_command->name, res.allocs_per_op);
+            failures++;
+        }
+        report("parse", s_command->name, &res, strlen(s_command->json));
+        if (json) {
+            report_json("parse", s_command->name, &res, strlen(s_command->json));
+        }
+    }
+
+    for (size_t i = 0; i < sizeof(BUILDERS) / sizeof(BUILDERS[0]); ++i) {
+        const bench_builder_t *b = &BUILDERS[i];
+        if (!selected(b->name)) {
+            continue;
+        }
+        plant_mqtt_host_reset();
+        bench_result_t res = measure(b->run);
+        const plant_mqtt_host_publish_t *last = plant_mqtt_host_last_publish();
+        if (b->publishes && last->count == 0) {
+            fprintf(stderr, "%s: nothing published\n", b->name);
+            failures++;
+        }
+        if (res.allocs_per_op > 0 && s_opt.check) {
+            fprintf(stderr, "%s: %.2f allocations per call\n", b->name, res.allocs_per_op);
+            failures++;
+        }
+        size_t len = b->publishes ? last->len : 0;
+        report("build", b->name, &res, len);
+        if (json) {
+            report_json("build", b->name, &res, len);
+        }
+    }
+
+    if (failures) {
+        fprintf(stderr, "%u check failures\n", failures);
+        return s_opt.check ? 1 : 0;
+    }
+    return 0;
+}
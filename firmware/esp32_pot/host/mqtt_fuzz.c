@@ -0,0 +1,249 @@
+// Fuzz target for the command path of main/plant_mqtt.c. Each input is an
+// MQTT command payload: it goes through mqtt_parse_command() exactly as the
+// MQTT event task hands it over (not NUL-terminated), the result is checked
+// for invariants the command task relies on, and a schedule it carries is
+// echoed back through the schedule payload builder.
+//
+// Built with clang -fsanitize=fuzzer this is a libFuzzer target (make fuzz).
+// Any other build gets a small driver instead (make fuzz-smoke): it runs the
+// files and directories given on the command line, then a fixed number of
+// byte-level mutations of them, so the sanitizers see the target without
+// libFuzzer installed.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "host_platform.h"
+#include "node_schedule.h"
+#include "plant_mqtt.h"
+#include "plant_mqtt_host.h"
+
+#define FUZZ_INPUT_MAX 4096   // larger than the MQTT client's receive buffer
+
+static bool bounded_string(const char *s, size_t cap)
+{
+    return memchr(s, '\0', cap) != NULL;
+}
+
+static bool timer_valid(const node_schedule_timer_t *timer)
+{
+    if (timer->window_count == 0 || timer->window_count > NODE_SCHEDULE_MAX_WINDOWS) {
+        return false;
+    }
+    for (uint8_t i = 0; i < timer->window_count; ++i) {
+        if (timer->windows[i].start_minute >= 24 * 60 || timer->windows[i].end_minute >= 24 * 60) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void check_command(const mqtt_command_t *cmd)
+{
+    bool ok = (unsigned)cmd->type <= MQTT_CMD_LOG_READ &&
+              bounded_string(cmd->request_id, sizeof(cmd->request_id)) &&
+              bounded_string(cmd->device_name, sizeof(cmd->device_name)) &&
+              (cmd->water_target_pct == 0 ||
+               (cmd->type == MQTT_CMD_PUMP_OVERRIDE && cmd->pump_on &&
+                cmd->water_target_pct > 0 && cmd->water_target_pct <= 100)) &&
+              (cmd->water_max_ml == 0 || cmd->water_target_pct > 0);
+    if (cmd->has_schedule) {
+        ok = ok && cmd->type == MQTT_CMD_CONFIG_UPDATE;
+        for (int t = 0; t < NODE_SCHEDULE_TARGET_COUNT; ++t) {
+            ok = ok && timer_valid(&cmd->schedule.timers[t]);
+        }
+    }
+    // A scene names at least one output and only real ones, and runs only
+    // outputs it switches on
+    const actuator_scene_t *scene = &cmd->scene;
+    ok = ok && (cmd->type == MQTT_CMD_SCENE ? scene->mask != 0 : scene->mask == 0) &&
+         (scene->mask >> NODE_SCHEDULE_TARGET_COUNT) == 0 && (scene->on & ~scene->mask) == 0;
+    for (int t = 0; t < NODE_SCHEDULE_TARGET_COUNT; ++t) {
+        ok = ok && (scene->duration_ms[t] == 0 || (scene->on & (1u << t)));
+    }
+    if (!ok) {
+        fprintf(stderr, "mqtt_fuzz: invariant broken for command type %d\n", (int)cmd->type);
+        abort();
+    }
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    static bool initialized = false;
+    if (!initialized) {
+        host_log_level = ESP_LOG_NONE;
+        node_schedule_init();
+        initialized = true;
+    }
+    if (size > FUZZ_INPUT_MAX) {
+        return 0;
+    }
+
+    // An exact-size copy, so reading past the payload trips ASan
+    char *payload = malloc(size ? size : 1);
+    if (!payload) {
+        return 0;
+    }
+    memcpy(payload, data, size);
+    static mqtt_command_scratch_t scratch;
+    mqtt_command_t cmd = mqtt_parse_command(payload, (int)size, &scratch);
+    free(payload);
+
+    check_command(&cmd);
+    if (cmd.has_schedule && node_schedule_set(&cmd.schedule) == ESP_OK) {
+        plant_mqtt_host_reset();
+        mqtt_publish_schedule_state(plant_mqtt_host_client(), "pot-fuzz", "fuzz");
+        const plant_mqtt_host_publish_t *last = plant_mqtt_host_last_publish();
+        if (last->count != 1 || last->len == 0 || last->len > PLANT_MQTT_HOST_PAYLOAD_MAX) {
+            fprintf(stderr, "mqtt_fuzz: schedule state not published (%zu bytes)\n", last->len);
+            abort();
+        }
+    }
+    return 0;
+}
+
+#ifndef MQTT_FUZZ_LIBFUZZER
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+#define FUZZ_SEEDS_MAX 256
+#define FUZZ_SMOKE_MUTATIONS 20000
+
+typedef struct {
+    uint8_t *data;
+    size_t len;
+} fuzz_seed_t;
+
+static fuzz_seed_t s_seeds[FUZZ_SEEDS_MAX];
+static size_t s_seed_count;
+static uint64_t s_rng = 0x9E3779B97F4A7C15ULL;
+
+static uint64_t next_random(void)
+{
+    // xorshift64*, fixed seed: every smoke run replays the same inputs
+    s_rng ^= s_rng >> 12;
+    s_rng ^= s_rng << 25;
+    s_rng ^= s_rng >> 27;
+    return s_rng * 2685821657736338717ULL;
+}
+
+static void add_seed_file(const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f || s_seed_count == FUZZ_SEEDS_MAX) {
+        if (f) {
+            fclose(f);
+        }
+        return;
+    }
+    uint8_t *buf = malloc(FUZZ_INPUT_MAX);
+    size_t len = buf ? fread(buf, 1, FUZZ_INPUT_MAX, f) : 0;
+    fclose(f);
+    if (!buf) {
+        return;
+    }
+    s_seeds[s_seed_count++] = (fuzz_seed_t){.data = buf, .len = len};
+    LLVMFuzzerTestOneInput(buf, len);
+}
+
+static void add_seed_path(const char *path)
+{
+    struct stat st;
+    if (stat(path, &st) != 0) {
+        fprintf(stderr, "mqtt_fuzz: cannot read %s\n", path);
+        return;
+    }
+    if (!S_ISDIR(st.st_mode)) {
+        add_seed_file(path);
+        return;
+    }
+    DIR *dir = opendir(path);
+    if (!dir) {
+        return;
+    }
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (entry->d_name[0] == '.') {
+            continue;
+        }
+        char child[1024];
+        snprintf(child, sizeof(child), "%s/%s", path, entry->d_name);
+        add_seed_file(child);
+    }
+    closedir(dir);
+}
+
+static size_t mutate(uint8_t *buf, size_t len, size_t cap)
+{
+    static const char tokens[] = "{}[]\":,0123456789-.eE\\ntfu";
+    unsigned edits = 1 + (unsigned)(next_random() % 4);
+    for (unsigned e = 0; e < edits; ++e) {
+        size_t pos = len ? (size_t)(next_random() % len) : 0;
+        switch (next_random() % 5) {
+        case 0:  // flip a bit
+            if (len) {
+                buf[pos] ^= (uint8_t)(1u << (next_random() % 8));
+            }
+            break;
+        case 1:  // JSON punctuation
+            if (len) {
+                buf[pos] = (uint8_t)tokens[next_random() % (sizeof(tokens) - 1)];
+            }
+            break;
+        case 2:  // insert a byte
+            if (len < cap) {
+                memmove(&buf[pos + 1], &buf[pos], len - pos);
+                buf[pos] = (uint8_t)next_random();
+                len++;
+            }
+            break;
+        case 3:  // drop a byte
+            if (len) {
+                memmove(&buf[pos], &buf[pos + 1], len - pos - 1);
+                len--;
+            }
+            break;
+        default:  // truncate
+            len = pos;
+            break;
+        }
+    }
+    return len;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned long mutations = FUZZ_SMOKE_MUTATIONS;
+    for (int i = 1; i < argc; ++i) {
+        if (strncmp(argv[i], "-runs=", 6) == 0) {
+            mutations = strtoul(argv[i] + 6, NULL, 0);
+        } else {
+            add_seed_path(argv[i]);
+        }
+    }
+    if (s_seed_count == 0) {
+        fprintf(stderr, "usage: %s [-runs=N] CORPUS_DIR_OR_FILE...\n", argv[0]);
+        return 2;
+    }
+
+    uint8_t *buf = malloc(FUZZ_INPUT_MAX);
+    if (!buf) {
+        return 2;
+    }
+    for (unsigned long i = 0; i < mutations; ++i) {
+        const fuzz_seed_t *seed = &s_seeds[next_random() % s_seed_count];
+        memcpy(buf, seed->data, seed->len);
+        size_t len = mutate(buf, seed->len, FUZZ_INPUT_MAX);
+        LLVMFuzzerTestOneInput(buf, len);
+    }
+    free(buf);
+    printf("MQTT_FUZZ {\"seeds\":%zu,\"mutations\":%lu}\n", s_seed_count, mutations);
+    return 0;
+}
+
+#endif
@@ -0,0 +1,888 @@
+// Runs the whole pot firmware (main/app_main.c and every task it starts) on a
+// virtual clock against a plant model and a simulated broker, and reports
+// what the task architecture costs: host CPU time per task, queue and
+// command-lane high-water marks, dropped and coalesced commands, reply
+// latency, reading gaps and schedule edge timing.
+//
+// The kernel (sim_rtos.c) only advances the clock when every task is blocked,
+// so a week of firmware runs in seconds. The plant is a reservoir with a
+// refill and a cutoff float, a pot whose moisture follows the pump, and a
+// daily climate cycle; the tank is topped up every morning at 07:00. Broker
+// outages are Poisson, as in ring_replay.c, and the hub sends a random mix of
+// commands (never the light, so its schedule edges can be checked).
+
+#include <getopt.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "command_lanes.h"
+#include "hardware_config.h"
+#include "host_flash.h"
+#include "host_platform.h"
+#include "offline_buffer.h"
+#include "sim_broker.h"
+#include "sim_hal.h"
+#include "sim_platform.h"
+#include "sim_rtos.h"
+
+#define SIM_COMMAND_TOPIC "pots/" SIM_DEVICE_ID "/command"
+#define SIM_SENSORS_TOPIC "pots/" SIM_DEVICE_ID "/sensors"
+#define SIM_BATCH_TOPIC "pots/" SIM_DEVICE_ID "/sensors/batch"
+
+#define SIM_DAY_US (86400LL * 1000000LL)
+#define SIM_HOUR_US (3600LL * 1000000LL)
+#define SIM_SETTLE_US (10LL * 1000000LL)   // after the last day, for PUBACKs in flight
+#define SIM_OUTAGE_MIN_S 60.0
+#define SIM_OUTAGE_MAX_S (4.0 * 3600.0)
+
+#define PLANT_TANK_ML 1500.0
+#define PLANT_REFILL_ML 600.0              // refill float drops below this
+#define PLANT_CUTOFF_ML 150.0              // cutoff float drops below this
+#define PLANT_PUMP_ML_PER_S 10.0
+#define PLANT_REFILL_HOUR 7
+#define PLANT_MOISTURE_START 40.0
+#define PLANT_WET_PER_S 0.1                // percentage points while the pump runs
+#define PLANT_DRY_PER_S (0.35 / 3600.0)
+#define PLANT_BATTERY_V 4.05
+
+#define LIGHT_ON_MS (6 * 3600000LL)        // the schedule sent at power-on
+#define LIGHT_OFF_MS (20 * 3600000LL)
+#define LIGHT_LATE_MAX_MS 2000
+#define READING_GAP_MAX_MS 120000          // two measurement intervals
+
+typedef struct {
+    uint32_t days;
+    uint64_t seed;
+    double outages_per_day;
+    double outage_mean_min;
+    double commands_per_hour;
+    uint32_t burst;
+    bool check;
+} options_t;
+
+typedef enum {
+    CMD_FAN,
+    CMD_MISTER,
+    CMD_PUMP,
+    CMD_WATERING,
+    CMD_SENSOR_READ,
+    CMD_DIAG,
+    CMD_IC_ZONE1,
+    CMD_SCHEDULE,
+    CMD_HISTORY,
+    CMD_SCENE,
+    CMD_KIND_COUNT,
+} command_kind_t;
+
+static const char *const COMMAND_NAMES[CMD_KIND_COUNT] = {
+    "fan", "mister", "pump", "watering", "sensor_read", "diag", "ic_zone1", "schedule", "history", "scene",
+};
+static const uint8_t COMMAND_WEIGHTS[CMD_KIND_COUNT] = {3, 2, 2, 1, 3, 1, 1, 1, 1, 2};
+
+typedef struct {
+    int64_t sent_us;
+    int64_t answered_us;     // -1 until the first reply
+    bool sent_online;
+    bool history_started;    // history_started / history_complete seen
+    bool history_complete;
+    command_kind_t kind;
+} command_t;
+
+typedef struct {
+    int64_t start_us;
+    int64_t end_us;
+} outage_t;
+
+typedef struct {
+    int64_t at_us;           // integrated up to here
+    double tank_ml;
+    double moisture_pct;
+    bool pump;
+    bool fan;
+    bool mister;
+    bool light;
+    bool rail;
+    double pump_dry_s;       // pumping with the tank below the cutoff float
+    double pumped_ml;
+    uint32_t refills;
+    uint32_t cutoff_trips;   // cutoff float dropped while the rail was up
+} plant_t;
+
+typedef struct {
+    command_t *commands;
+    size_t command_count;
+    size_t command_cap;
+    outage_t *outages;
+    size_t outage_count;
+    size_t next_outage;
+    bool link_down;
+    uint64_t *readings;      // epoch ms of every periodic reading the broker got
+    size_t reading_count;
+    size_t reading_cap;
+    uint32_t light_edges;
+    uint32_t light_early;
+    int64_t light_late_max_ms;
+    int64_t next_command_us;
+    int64_t next_burst_us;
+    int64_t next_refill_us;
+    uint32_t lane_high_water[COMMAND_LANE_COUNT];
+    bool replan;             // the pump or the rail changed: float crossings moved
+} sim_t;
+
+static options_t s_opt = {
+    .days = 7,
+    .seed = 1,
+    .outages_per_day = 2.0,
+    .outage_mean_min = 20.0,
+    .commands_per_hour = 2.0,
+};
+static sim_t s_sim;
+static plant_t s_plant;
+
+// splitmix64, as in ring_replay.c
+static uint64_t s_rng;
+
+static uint64_t rng_next(void)
+{
+    uint64_t z = (s_rng += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+static double rng_unit(void)
+{
+    return (double)(rng_next() >> 11) / (double)(1ULL << 53);
+}
+
+static double rng_exp(double mean)
+{
+    return -mean * log(1.0 - rng_unit());
+}
+
+static double rng_noise(double amplitude)
+{
+    return (rng_unit() * 2.0 - 1.0) * amplitude;
+}
+
+static double wall_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void *grow(void *items, size_t *cap, size_t item_size)
+{
+    size_t new_cap = *cap ? *cap * 2 : 256;
+    void *grown = realloc(items, new_cap * item_size);
+    if (!grown) {
+        fprintf(stderr, "out of memory\n");
+        exit(2);
+    }
+    *cap = new_cap;
+    return grown;
+}
+
+// Plant model
+
+static uint64_t ms_of_day(void)
+{
+    return sim_platform_epoch_ms() % 86400000ULL;
+}
+
+// Integrate the tank and the soil up to now with the outputs as they are
+static void plant_advance(int64_t now_us)
+{
+    double dt_s = (double)(now_us - s_plant.at_us) / 1e6;
+    s_plant.at_us = now_us;
+    if (dt_s <= 0) {
+        return;
+    }
+    if (s_plant.pump) {
+        double to_cutoff_s = (s_plant.tank_ml - PLANT_CUTOFF_ML) / PLANT_PUMP_ML_PER_S;
+        if (to_cutoff_s < dt_s) {
+            s_plant.pump_dry_s += to_cutoff_s > 0 ? dt_s - to_cutoff_s : dt_s;
+        }
+        double pumped = fmin(s_plant.tank_ml, dt_s * PLANT_PUMP_ML_PER_S);
+        s_plant.tank_ml -= pumped;
+        s_plant.pumped_ml += pumped;
+        s_plant.moisture_pct += dt_s * PLANT_WET_PER_S;
+    }
+    s_plant.moisture_pct -= dt_s * PLANT_DRY_PER_S;
+    s_plant.moisture_pct = fmax(5.0, fmin(95.0, s_plant.moisture_pct));
+}
+
+// The floats are active low and only read while the sensor rail powers them
+static void plant_drive_floats(void)
+{
+    int refill = s_plant.rail && s_plant.tank_ml > PLANT_REFILL_ML;
+    int cutoff = s_plant.rail && s_plant.tank_ml > PLANT_CUTOFF_ML;
+    sim_hal_drive_input(WATER_REFILL_GPIO, refill);
+    if (s_plant.rail && !cutoff && sim_hal_level(WATER_CUTOFF_GPIO)) {
+        s_plant.cutoff_trips++;
+    }
+    sim_hal_drive_input(WATER_CUTOFF_GPIO, cutoff);
+}
+
+// When the running pump takes the tank past the next float
+static int64_t plant_next_crossing_us(void)
+{
+    if (!s_plant.pump || !s_plant.rail) {
+        return INT64_MAX;
+    }
+    double level = s_plant.tank_ml > PLANT_REFILL_ML ? PLANT_REFILL_ML
+        : s_plant.tank_ml > PLANT_CUTOFF_ML ? PLANT_CUTOFF_ML
+        : -1.0;
+    if (level < 0) {
+        return INT64_MAX;
+    }
+    // One microsecond past, so the level is strictly below the float
+    return s_plant.at_us + (int64_t)ceil((s_plant.tank_ml - level) / PLANT_PUMP_ML_PER_S * 1e6) + 1;
+}
+
+static void on_output_changed(gpio_num_t gpio, int level)
+{
+    plant_advance(host_clock_now_us());
+    bool on = level != 0;
+    switch (gpio) {
+    case PUMP_GPIO:
+        s_plant.pump = on;
+        s_sim.replan = true;
+        break;
+    case SENSOR_EN_GPIO:
+        s_plant.rail = on;
+        s_sim.replan = true;
+        plant_drive_floats();
+        break;
+    case FAN_GPIO:
+        s_plant.fan = on;
+        break;
+    case MISTER_GPIO:
+        s_plant.mister = on;
+        break;
+    case LIGHT_GPIO: {
+        s_plant.light = on;
+        s_sim.light_edges++;
+        int64_t late_ms = (int64_t)ms_of_day() - (on ? LIGHT_ON_MS : LIGHT_OFF_MS);
+        if (late_ms < 0) {
+            s_sim.light_early++;
+        } else if (late_ms > s_sim.light_late_max_ms) {
+            s_sim.light_late_max_ms = late_ms;
+        }
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+static int16_t clamp_counts(double counts)
+{
+    return (int16_t)fmax(-32768.0, fmin(32767.0, round(counts)));
+}
+
+static int16_t on_adc_counts(uint8_t channel)
+{
+    plant_advance(host_clock_now_us());
+    if (channel == BATTERY_ADC_CHANNEL) {
+        double volts = PLANT_BATTERY_V + rng_noise(0.005);
+        return clamp_counts(volts / BATTERY_DIVIDER_RATIO / 2.048 * 32768.0);
+    }
+    double counts = SOIL_SENSOR_RAW_DRY -
+                    s_plant.moisture_pct / 100.0 * (SOIL_SENSOR_RAW_DRY - SOIL_SENSOR_RAW_WET) + rng_noise(6.0);
+    if (rng_next() % 2000 == 0) {
+        counts += rng_noise(2000.0);   // a disturbed probe, for the outlier filter
+    }
+    return clamp_counts(counts);
+}
+
+static void on_climate(float *temperature_c, float *humidity_pct)
+{
+    double hour = (double)ms_of_day() / 3600000.0;
+    double swing = sin(2.0 * M_PI * (hour - 9.0) / 24.0);
+    double t = 21.0 + 3.0 * swing + (s_plant.light ? 1.5 : 0.0) + rng_noise(0.05);
+    double h = 55.0 - 10.0 * swing + (s_plant.mister ? 8.0 : 0.0) - (s_plant.fan ? 3.0 : 0.0) + rng_noise(0.3);
+    *temperature_c = (float)t;
+    *humidity_pct = (float)fmax(0.0, fmin(100.0, h));
+}
+
+static const sim_hal_world_t s_world = {
+    .output_changed = on_output_changed,
+    .adc_counts = on_adc_counts,
+    .climate = on_climate,
+};
+
+// Hub side
+
+static void note_reading(uint64_t epoch_ms)
+{
+    if (s_sim.reading_count == s_sim.reading_cap) {
+        s_sim.readings = grow(s_sim.readings, &s_sim.reading_cap, sizeof(uint64_t));
+    }
+    s_sim.readings[s_sim.reading_count++] = epoch_ms;
+}
+
+// Batches carry "t0" and rows of [dt_s, ...]
+static void note_batch(const char *data)
+{
+    const char *t0 = strstr(data, "\"t0\":");
+    const char *rows = strstr(data, "\"s\":[");
+    if (!t0 || !rows) {
+        return;
+    }
+    uint64_t base = strtoull(t0 + 5, NULL, 10);
+    for (const char *p = strchr(rows + 5, '['); p; p = strchr(p, '[')) {
+        char *end;
+        double dt_s = strtod(p + 1, &end);
+        if (end == p + 1) {
+            break;
+        }
+        note_reading(base + (uint64_t)llround(dt_s * 1000.0));
+        p = end;
+    }
+}
+
+static void on_deliver(const char *topic, const char *data, int len, bool dup)
+{
+    const char *request = strstr(data, "\"requestId\":\"sim-");
+    if (request) {
+        size_t index = strtoul(request + 17, NULL, 10);
+        if (index < s_sim.command_count) {
+            command_t *cmd = &s_sim.commands[index];
+            if (cmd->answered_us < 0) {
+                cmd->answered_us = host_clock_now_us();   // the first reply; some send a second when done
+            }
+            cmd->history_started |= strstr(data, "\"status\":\"history_started\"") != NULL;
+            cmd->history_complete |= strstr(data, "\"status\":\"history_complete\"") != NULL;
+        }
+        return;   // replies and history pages are not the periodic readings
+    }
+    if (strcmp(topic, SIM_SENSORS_TOPIC) == 0) {
+        const char *ts = strstr(data, "\"timestampMs\":");
+        if (ts) {
+            note_reading(strtoull(ts + 14, NULL, 10));
+        }
+    } else if (strcmp(topic, SIM_BATCH_TOPIC) == 0) {
+        note_batch(data);
+    }
+}
+
+static void send_command(command_kind_t kind)
+{
+    if (s_sim.command_count == s_sim.command_cap) {
+        s_sim.commands = grow(s_sim.commands, &s_sim.command_cap, sizeof(command_t));
+    }
+    size_t index = s_sim.command_count++;
+    s_sim.commands[index] = (command_t){
+        .sent_us = host_clock_now_us(),
+        .answered_us = -1,
+        .sent_online = sim_broker_connected(),
+        .kind = kind,
+    };
+    uint64_t now_ms = sim_platform_epoch_ms();
+    char payload[768];
+    switch (kind) {
+    case CMD_FAN:
+        snprintf(payload, sizeof(payload), "{\"fan\":true,\"duration_ms\":%u,\"requestId\":\"sim-%zu\"}",
+                 (unsigned)(60000 + rng_next() % 540000), index);
+        break;
+    case CMD_MISTER:
+        snprintf(payload, sizeof(payload), "{\"mister\":%s,\"duration_ms\":%u,\"requestId\":\"sim-%zu\"}",
+                 rng_next() % 4 ? "true" : "false", (unsigned)(30000 + rng_next() % 150000), index);
+        break;
+    case CMD_PUMP:
+        snprintf(payload, sizeof(payload), "{\"pump\":\"on\",\"duration_ms\":%u,\"requestId\":\"sim-%zu\"}",
+                 (unsigned)(2000 + rng_next() % 8000), index);
+        break;
+    case CMD_WATERING:
+        snprintf(payload, sizeof(payload),
+                 "{\"pump\":\"on\",\"targetMoisture\":%d,\"duration_ms\":60000,\"requestId\":\"sim-%zu\"}",
+                 (int)fmin(90.0, s_plant.moisture_pct + 5.0), index);
+        break;
+    case CMD_SENSOR_READ:
+        snprintf(payload, sizeof(payload), "{\"command\":\"sensorRead\",\"requestId\":\"sim-%zu\"}", index);
+        break;
+    case CMD_DIAG:
+        snprintf(payload, sizeof(payload), "{\"action\":\"diag\",\"requestId\":\"sim-%zu\"}", index);
+        break;
+    case CMD_IC_ZONE1:
+        snprintf(payload, sizeof(payload), "{\"ic_zone1\":\"on\",\"duration_ms\":800,\"requestId\":\"sim-%zu\"}",
+                 index);
+        break;
+    case CMD_SCENE:
+        // Ventilate and mist
+        snprintf(payload, sizeof(payload),
+                 "{\"scene\":{\"fan\":\"on\",\"mister\":{\"state\":\"on\",\"duration_ms\":%u}},"
+                 "\"duration_ms\":%u,\"requestId\":\"sim-%zu\"}",
+                 (unsigned)(30000 + rng_next() % 90000), (unsigned)(300000 + rng_next() % 300000), index);
+        break;
+    case CMD_SCHEDULE:
+        snprintf(payload, sizeof(payload),
+                 "{\"schedule\":{"
+                 "\"light\":{\"enabled\":true,\"startTime\":\"06:00\",\"endTime\":\"20:00\"},"
+                 "\"pump\":{\"enabled\":false,\"startTime\":\"00:00\",\"endTime\":\"00:00\"},"
+                 "\"icZone1\":{\"enabled\":false,\"startTime\":\"00:00\",\"endTime\":\"00:00\"},"
+                 "\"mister\":{\"enabled\":false,\"startTime\":\"00:00\",\"endTime\":\"00:00\"},"
+                 "\"fan\":{\"enabled\":true,\"startTime\":\"12:00\",\"endTime\":\"12:30\"},"
+                 "\"tzOffsetMinutes\":0,\"scheduleUpdatedAtMs\":%llu},\"requestId\":\"sim-%zu\"}",
+                 (unsigned long long)now_ms, index);
+        break;
+    case CMD_HISTORY:
+        snprintf(payload, sizeof(payload),
+                 "{\"action\":\"history_query\",\"fromMs\":%llu,\"toMs\":%llu,\"requestId\":\"sim-%zu\"}",
+                 (unsigned long long)(now_ms > 3600000 ? now_ms - 3600000 : 0), (unsigned long long)now_ms, index);
+        break;
+    default:
+        return;
+    }
+    sim_broker_send(SIM_COMMAND_TOPIC, payload);
+}
+
+static command_kind_t pick_command(void)
+{
+    unsigned total = 0;
+    for (int i = 0; i < CMD_KIND_COUNT; ++i) {
+        total += COMMAND_WEIGHTS[i];
+    }
+    unsigned pick = (unsigned)(rng_next() % total);
+    for (int i = 0; i < CMD_KIND_COUNT; ++i) {
+        if (pick < COMMAND_WEIGHTS[i]) {
+            return (command_kind_t)i;
+        }
+        pick -= COMMAND_WEIGHTS[i];
+    }
+    return CMD_SENSOR_READ;
+}
+
+// Poisson outages, none overlapping and none in the last hour, so the node
+// has time to drain before the totals are taken
+static void synthesize_outages(int64_t end_us)
+{
+    if (s_opt.outages_per_day <= 0) {
+        return;
+    }
+    size_t cap = 0;
+    double mean_gap_s = 86400.0 / s_opt.outages_per_day;
+    double last_s = (double)(end_us - SIM_HOUR_US) / 1e6;
+    double t = rng_exp(mean_gap_s);
+    while (t < last_s) {
+        double len = fmax(SIM_OUTAGE_MIN_S, fmin(SIM_OUTAGE_MAX_S, rng_exp(s_opt.outage_mean_min * 60.0)));
+        len = fmin(len, last_s - t);
+        if (s_sim.outage_count == cap) {
+            s_sim.outages = grow(s_sim.outages, &cap, sizeof(outage_t));
+        }
+        s_sim.outages[s_sim.outage_count++] = (outage_t){
+            .start_us = (int64_t)(t * 1e6),
+            .end_us = (int64_t)((t + len) * 1e6),
+        };
+        t += len + rng_exp(mean_gap_s);
+    }
+}
+
+// After every task run: keep the lane high-water marks and stop early when
+// the float crossings have to be planned again
+static bool stop_fn(void)
+{
+    command_lane_stats_t lanes[COMMAND_LANE_COUNT];
+    command_lanes_get_stats(lanes);
+    for (size_t i = 0; i < COMMAND_LANE_COUNT; ++i) {
+        if (lanes[i].depth > s_sim.lane_high_water[i]) {
+            s_sim.lane_high_water[i] = lanes[i].depth;
+        }
+    }
+    return s_sim.replan;
+}
+
+static void main_task(void *arg)
+{
+    extern void app_main(void);
+    app_main();
+    vTaskDelete(NULL);
+}
+
+static int64_t next_refill_after(int64_t now_us)
+{
+    int64_t day_start_us = now_us - (int64_t)ms_of_day() * 1000;
+    int64_t at_us = day_start_us + PLANT_REFILL_HOUR * SIM_HOUR_US;
+    return at_us > now_us ? at_us : at_us + SIM_DAY_US;
+}
+
+static void run(int64_t end_us)
+{
+    while (host_clock_now_us() < end_us) {
+        int64_t now_us = host_clock_now_us();
+        int64_t next_us = end_us;
+        if (s_sim.next_outage < s_sim.outage_count) {
+            const outage_t *o = &s_sim.outages[s_sim.next_outage];
+            int64_t toggle_us = s_sim.link_down ? o->end_us : o->start_us;
+            next_us = toggle_us < next_us ? toggle_us : next_us;
+        }
+        next_us = s_sim.next_command_us < next_us ? s_sim.next_command_us : next_us;
+        next_us = s_sim.next_burst_us < next_us ? s_sim.next_burst_us : next_us;
+        next_us = s_sim.next_refill_us < next_us ? s_sim.next_refill_us : next_us;
+        int64_t crossing_us = plant_next_crossing_us();
+        next_us = crossing_us < next_us ? crossing_us : next_us;
+        next_us = next_us > now_us ? next_us : now_us;
+
+        s_sim.replan = false;
+        sim_rtos_run_until(next_us, stop_fn);
+        now_us = host_clock_now_us();
+        plant_advance(now_us);
+        plant_drive_floats();
+
+        while (s_sim.next_outage < s_sim.outage_count) {
+            const outage_t *o = &s_sim.outages[s_sim.next_outage];
+            if (!s_sim.link_down && o->start_us <= now_us) {
+                s_sim.link_down = true;
+                sim_broker_set_link(false);
+            } else if (s_sim.link_down && o->end_us <= now_us) {
+                s_sim.link_down = false;
+                sim_broker_set_link(true);
+                s_sim.next_outage++;
+            } else {
+                break;
+            }
+        }
+        if (s_sim.next_refill_us <= now_us) {
+            s_plant.tank_ml = PLANT_TANK_ML;
+            s_plant.refills++;
+            s_sim.replan = true;
+            plant_drive_floats();
+            s_sim.next_refill_us = next_refill_after(now_us);
+        }
+        if (s_sim.next_command_us <= now_us) {
+            send_command(pick_command());
+            s_sim.next_command_us = now_us + (int64_t)(rng_exp(3600.0 / s_opt.commands_per_hour) * 1e6) + 1;
+        }
+        if (s_sim.next_burst_us <= now_us) {
+            for (uint32_t i = 0; i < s_opt.burst; ++i) {
+                send_command(pick_command());
+            }
+            s_sim.next_burst_us = now_us + SIM_HOUR_US;
+        }
+    }
+}
+
+static int compare_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static int compare_i64(const void *a, const void *b)
+{
+    int64_t x = *(const int64_t *)a;
+    int64_t y = *(const int64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr,
+            "usage: %s [options]\n"
+            "  --days N                 simulated days (7)\n"
+            "  --seed N                 plant noise, outage and command seed (1)\n"
+            "  --outages-per-day X      broker outages, Poisson (2)\n"
+            "  --outage-minutes M       mean outage length, kept within 1 min-4 h (20)\n"
+            "  --commands-per-hour X    hub commands, Poisson (2)\n"
+            "  --burst N                also N commands at once every hour (0)\n"
+            "  --check                  exit 1 on dropped commands (unless bursting), unanswered ones\n"
+            "                           the lanes do not explain, history queries left unfinished, late\n"
+            "                           or missing light edges, reading gaps, pumping dry, or anything\n"
+            "                           still buffered at the end\n"
+            "  -v                       firmware logs (repeat for more)\n",
+            argv0);
+}
+
+static bool parse_options(int argc, char **argv)
+{
+    static const struct option longopts[] = {
+        {"days", required_argument, NULL, 'd'},
+        {"seed", required_argument, NULL, 's'},
+        {"outages-per-day", required_argument, NULL, 'o'},
+        {"outage-minutes", required_argument, NULL, 'm'},
+        {"commands-per-hour", required_argument, NULL, 'C'},
+        {"burst", required_argument, NULL, 'b'},
+        {"check", no_argument, NULL, 'c'},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0},
+    };
+    int c;
+    host_log_level = ESP_LOG_ERROR;
+    while ((c = getopt_long(argc, argv, "vh", longopts, NULL)) != -1) {
+        switch (c) {
+        case 'd': s_opt.days = (uint32_t)strtoul(optarg, NULL, 10); break;
+        case 's': s_opt.seed = strtoull(optarg, NULL, 10); break;
+        case 'o': s_opt.outages_per_day = strtod(optarg, NULL); break;
+        case 'm': s_opt.outage_mean_min = strtod(optarg, NULL); break;
+        case 'C': s_opt.commands_per_hour = strtod(optarg, NULL); break;
+        case 'b': s_opt.burst = (uint32_t)strtoul(optarg, NULL, 10); break;
+        case 'c': s_opt.check = true; break;
+        case 'v': host_log_level = host_log_level < ESP_LOG_INFO ? ESP_LOG_INFO : ESP_LOG_DEBUG; break;
+        case 'h': usage(argv[0]); exit(0);
+        default: usage(argv[0]); return false;
+        }
+    }
+    if (s_opt.days == 0 || s_opt.commands_per_hour <= 0 || s_opt.outage_mean_min <= 0) {
+        fprintf(stderr, "--days, --commands-per-hour and --outage-minutes must be positive\n");
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    if (!parse_options(argc, argv)) {
+        return 2;
+    }
+    s_rng = s_opt.seed;
+    int64_t end_us = (int64_t)s_opt.days * SIM_DAY_US;
+    synthesize_outages(end_us);
+
+    host_flash_config_t flash = HOST_FLASH_CONFIG_DEFAULT();
+    if (host_flash_init(&flash) != 0) {
+        fprintf(stderr, "flash emulation init failed\n");
+        return 2;
+    }
+    s_plant = (plant_t){
+        .tank_ml = PLANT_TANK_ML,
+        .moisture_pct = PLANT_MOISTURE_START,
+    };
+    sim_rtos_init();
+    sim_hal_init(&s_world);
+    sim_broker_config_t broker = SIM_BROKER_CONFIG_DEFAULT();
+    sim_broker_init(&broker, on_deliver);
+    xTaskCreatePinnedToCore(main_task, "main", 8192, NULL, 1, NULL, 0);
+
+    // The hub's schedule waits in the session for the first connection
+    send_command(CMD_SCHEDULE);
+    s_sim.next_command_us = (int64_t)(rng_exp(3600.0 / s_opt.commands_per_hour) * 1e6);
+    s_sim.next_burst_us = s_opt.burst ? SIM_HOUR_US : INT64_MAX;
+    s_sim.next_refill_us = next_refill_after(0);
+
+    double started = wall_seconds();
+    run(end_us);
+    s_sim.next_command_us = INT64_MAX;
+    s_sim.next_burst_us = INT64_MAX;
+    run(end_us + SIM_SETTLE_US);
+    double wall_s = wall_seconds() - started;
+
+    // Readings: sorted and deduplicated (resends), then the longest silence
+    qsort(s_sim.readings, s_sim.reading_count, sizeof(uint64_t), compare_u64);
+    size_t unique = 0;
+    for (size_t i = 0; i < s_sim.reading_count; ++i) {
+        if (unique == 0 || s_sim.readings[i] != s_sim.readings[unique - 1]) {
+            s_sim.readings[unique++] = s_sim.readings[i];
+        }
+    }
+    uint64_t end_epoch_ms = SIM_EPOCH_MS + (uint64_t)(end_us / 1000);
+    uint64_t gap_max_ms = 0;
+    uint64_t last_ms = SIM_EPOCH_MS;
+    for (size_t i = 0; i < unique && s_sim.readings[i] <= end_epoch_ms; ++i) {
+        uint64_t gap = s_sim.readings[i] - last_ms;
+        gap_max_ms = gap > gap_max_ms ? gap : gap_max_ms;
+        last_ms = s_sim.readings[i];
+    }
+    gap_max_ms = end_epoch_ms - last_ms > gap_max_ms ? end_epoch_ms - last_ms : gap_max_ms;
+
+    // Commands and reply latency (those sent while the node was reachable)
+    uint32_t answered = 0;
+    uint32_t per_kind[CMD_KIND_COUNT] = {0};
+    int64_t *latency = calloc(s_sim.command_count + 1, sizeof(int64_t));
+    size_t latency_count = 0;
+    uint32_t history_open = 0;   // started, never completed
+    for (size_t i = 0; i < s_sim.command_count; ++i) {
+        const command_t *cmd = &s_sim.commands[i];
+        per_kind[cmd->kind]++;
+        history_open += cmd->history_started && !cmd->history_complete;
+        if (cmd->answered_us >= 0) {
+            answered++;
+            if (cmd->sent_online && latency) {
+                latency[latency_count++] = cmd->answered_us - cmd->sent_us;
+            }
+        }
+    }
+    int64_t lat_p50 = 0;
+    int64_t lat_p99 = 0;
+    int64_t lat_max = 0;
+    if (latency_count > 0) {
+        qsort(latency, latency_count, sizeof(int64_t), compare_i64);
+        lat_p50 = latency[latency_count / 2];
+        lat_p99 = latency[(latency_count * 99) / 100];
+        lat_max = latency[latency_count - 1];
+    }
+    free(latency);
+    uint32_t unanswered = (uint32_t)s_sim.command_count - answered;
+
+    command_lane_stats_t lanes[COMMAND_LANE_COUNT];
+    command_lanes_get_stats(lanes);
+    uint32_t lane_drops = 0;
+    uint32_t lane_coalesced = 0;
+    for (size_t i = 0; i < COMMAND_LANE_COUNT; ++i) {
+        lane_drops += lanes[i].drops;
+        lane_coalesced += lanes[i].coalesced;
+    }
+    sim_broker_stats_t br;
+    sim_broker_get_stats(&br);
+    sim_hal_stats_t hal;
+    sim_hal_get_stats(&hal);
+    size_t pending = offline_buffer_pending();
+    uint64_t pump_dry_ms = (uint64_t)floor(s_plant.pump_dry_s * 1000.0);
+
+    sim_task_stats_t tasks[32];
+    size_t task_count = sim_rtos_task_stats(tasks, sizeof(tasks) / sizeof(tasks[0]));
+    task_count = task_count < sizeof(tasks) / sizeof(tasks[0]) ? task_count : sizeof(tasks) / sizeof(tasks[0]);
+    sim_queue_stats_t queues[64];
+    size_t queue_count = sim_rtos_queue_stats(queues, sizeof(queues) / sizeof(queues[0]));
+    queue_count = queue_count < sizeof(queues) / sizeof(queues[0]) ? queue_count : sizeof(queues) / sizeof(queues[0]);
+    uint64_t task_ns = 0;
+    for (size_t i = 0; i < task_count; ++i) {
+        task_ns += tasks[i].cpu_ns;
+    }
+    double sim_s = (double)host_clock_now_us() / 1e6;
+
+    printf("Simulated %u days in %.2f s of host time (%.0fx), %zu outages\n", (unsigned)s_opt.days, wall_s,
+           wall_s > 0 ? sim_s / wall_s : 0.0, s_sim.outage_count);
+    printf("Tasks (host CPU, per simulated day):\n");
+    for (size_t i = 0; i < task_count; ++i) {
+        printf("  %-16s prio %2u core %2d  %10.1f us/day  %9llu runs%s\n", tasks[i].name,
+               (unsigned)tasks[i].priority, (int)tasks[i].core, (double)tasks[i].cpu_ns / 1000.0 / s_opt.days,
+               (unsigned long long)tasks[i].runs, tasks[i].deleted ? "  (exited)" : "");
+    }
+    printf("  %-16s                   %10.1f us/day\n", "(scheduler)",
+           (double)sim_rtos_scheduler_ns() / 1000.0 / s_opt.days);
+    printf("Queues and semaphores (high water / length, full, overwritten):\n");
+    for (size_t i = 0; i < queue_count; ++i) {
+        if (queues[i].kind == SIM_QUEUE_MUTEX || queues[i].kind == SIM_QUEUE_RECURSIVE_MUTEX) {
+            continue;
+        }
+        printf("  %-32s %3u / %-3u %6llu full %6llu overwritten\n", queues[i].name,
+               (unsigned)queues[i].high_water, (unsigned)queues[i].length, (unsigned long long)queues[i].full,
+               (unsigned long long)queues[i].overwrites);
+    }
+    printf("Command lanes: priority high water %u / %u, normal %u / %u; %u dropped, %u coalesced\n",
+           (unsigned)s_sim.lane_high_water[COMMAND_LANE_PRIORITY], (unsigned)lanes[COMMAND_LANE_PRIORITY].len,
+           (unsigned)s_sim.lane_high_water[COMMAND_LANE_NORMAL], (unsigned)lanes[COMMAND_LANE_NORMAL].len,
+           (unsigned)lane_drops, (unsigned)lane_coalesced);
+    printf("Commands: %zu sent, %u answered, %u unanswered;", s_sim.command_count, (unsigned)answered,
+           (unsigned)unanswered);
+    for (int i = 0; i < CMD_KIND_COUNT; ++i) {
+        printf(" %s %u", COMMAND_NAMES[i], (unsigned)per_kind[i]);
+    }
+    printf("; %u history queries started and never completed", (unsigned)history_open);
+    printf("\nReply latency while connected: p50 %.1f ms, p99 %.1f ms, max %.1f ms\n", lat_p50 / 1000.0,
+           lat_p99 / 1000.0, lat_max / 1000.0);
+    printf("Readings: %zu at the broker, longest gap %.1f s, %zu still buffered\n", unique,
+           (double)gap_max_ms / 1000.0, pending);
+    printf("Light: %u edges (%u expected), %u early, latest %lld ms after its time\n", (unsigned)s_sim.light_edges,
+           (unsigned)(2 * s_opt.days), (unsigned)s_sim.light_early, (long long)s_sim.light_late_max_ms);
+    printf("Plant: %.0f ml pumped, %u refills, %u cutoff trips, %llu ms pumped dry, moisture %.1f%%\n",
+           s_plant.pumped_ml, (unsigned)s_plant.refills, (unsigned)s_plant.cutoff_trips,
+           (unsigned long long)pump_dry_ms, s_plant.moisture_pct);
+    printf("Broker: %llu connects, %llu publishes, %llu resent, %llu refused offline, %llu refused full, "
+           "%llu expired, outbox peak %u bytes, %zu bytes left\n",
+           (unsigned long long)br.connects, (unsigned long long)br.publishes, (unsigned long long)br.resent,
+           (unsigned long long)br.refused_offline, (unsigned long long)br.refused_full,
+           (unsigned long long)br.expired, (unsigned)br.outbox_high_water, br.outbox_bytes);
+    printf("HAL: %llu ADC conversions, %llu T/RH conversions, %llu cutoff interrupts\n",
+           (unsigned long long)hal.adc_conversions, (unsigned long long)hal.th_conversions,
+           (unsigned long long)hal.isr_calls);
+
+    printf("NODE_SIM {\"days\":%u,\"seed\":%llu,\"outages\":%zu,\"wall_s\":%.3f,\"speedup\":%.0f,"
+           "\"task_cpu_us_per_day\":{", (unsigned)s_opt.days, (unsigned long long)s_opt.seed, s_sim.outage_count,
+           wall_s, wall_s > 0 ? sim_s / wall_s : 0.0);
+    for (size_t i = 0; i < task_count; ++i) {
+        printf("%s\"%s\":%.1f", i ? "," : "", tasks[i].name, (double)tasks[i].cpu_ns / 1000.0 / s_opt.days);
+    }
+    printf("},\"scheduler_cpu_us_per_day\":%.1f,\"firmware_cpu_us_per_day\":%.1f,\"queue_high_water\":{",
+           (double)sim_rtos_scheduler_ns() / 1000.0 / s_opt.days, (double)task_ns / 1000.0 / s_opt.days);
+    bool first = true;
+    uint64_t queue_full = 0;
+    for (size_t i = 0; i < queue_count; ++i) {
+        if (queues[i].kind == SIM_QUEUE_MUTEX || queues[i].kind == SIM_QUEUE_RECURSIVE_MUTEX) {
+            continue;
+        }
+        queue_full += queues[i].full;
+        printf("%s\"%s\":%u", first ? "" : ",", queues[i].name, (unsigned)queues[i].high_water);
+        first = false;
+    }
+    printf("},\"queue_full\":%llu,\"lane_high_water\":[%u,%u],\"lane_drops\":%u,\"lane_coalesced\":%u,"
+           "\"commands\":%zu,\"answered\":%u,\"latency_p50_ms\":%.1f,\"latency_p99_ms\":%.1f,\"latency_max_ms\":%.1f,"
+           "\"readings\":%zu,\"reading_gap_max_s\":%.1f,\"buffered_left\":%zu,\"light_edges\":%u,\"light_early\":%u,"
+           "\"light_late_max_ms\":%lld,\"pump_dry_ms\":%llu,\"cutoff_trips\":%u,\"connects\":%llu,\"resent\":%llu,"
+           "\"expired\":%llu,\"outbox_peak_bytes\":%u,\"outbox_left_bytes\":%zu}\n",
+           (unsigned long long)queue_full, (unsigned)s_sim.lane_high_water[COMMAND_LANE_PRIORITY],
+           (unsigned)s_sim.lane_high_water[COMMAND_LANE_NORMAL], (unsigned)lane_drops, (unsigned)lane_coalesced,
+           s_sim.command_count, (unsigned)answered, lat_p50 / 1000.0, lat_p99 / 1000.0, lat_max / 1000.0, unique,
+           (double)gap_max_ms / 1000.0, pending, (unsigned)s_sim.light_edges, (unsigned)s_sim.light_early,
+           (long long)s_sim.light_late_max_ms, (unsigned long long)pump_dry_ms, (unsigned)s_plant.cutoff_trips,
+           (unsigned long long)br.connects, (unsigned long long)br.resent, (unsigned long long)br.expired,
+           (unsigned)br.outbox_high_water, br.outbox_bytes);
+
+    host_flash_deinit();
+    free(s_sim.commands);
+    free(s_sim.outages);
+    free(s_sim.readings);
+
+    if (s_opt.check) {
+        // Superseded commands are answered with command_coalesced; those
+        // refused by a full lane get no reply, nor do those whose status
+        // expired in the outbox
+        uint32_t explained = lane_drops + (uint32_t)br.expired;
+        uint32_t unexplained = unanswered > explained ? unanswered - explained : 0;
+        bool failed = false;
+        if (lane_drops > 0 && s_opt.burst == 0) {
+            fprintf(stderr, "check failed: %u commands dropped by full lanes\n", (unsigned)lane_drops);
+            failed = true;
+        }
+        // Only the request streaming at the end and those queued behind it
+        // may still be open
+        if (history_open > OFFLINE_HISTORY_QUEUE_DEPTH + 1) {
+            fprintf(stderr, "check failed: %u history queries started but never completed\n",
+                    (unsigned)history_open);
+            failed = true;
+        }
+        if (unexplained > 0) {
+            fprintf(stderr, "check failed: %u commands unanswered, %u more than %u dropped "
+                    "and %llu expired explain\n", (unsigned)unanswered, (unsigned)unexplained,
+                    (unsigned)lane_drops, (unsigned long long)br.expired);
+            failed = true;
+        }
+        if (s_sim.light_edges != 2 * s_opt.days || s_sim.light_early > 0 ||
+            s_sim.light_late_max_ms > LIGHT_LATE_MAX_MS) {
+            fprintf(stderr, "check failed: %u light edges (%u expected), %u early, %lld ms late\n",
+                    (unsigned)s_sim.light_edges, (unsigned)(2 * s_opt.days), (unsigned)s_sim.light_early,
+                    (long long)s_sim.light_late_max_ms);
+            failed = true;
+        }
+        if (gap_max_ms > READING_GAP_MAX_MS) {
+            fprintf(stderr, "check failed: %.1f s without a reading\n", (double)gap_max_ms / 1000.0);
+            failed = true;
+        }
+        if (pump_dry_ms > 0) {
+            fprintf(stderr, "check failed: pump ran %llu ms below the cutoff float\n",
+                    (unsigned long long)pump_dry_ms);
+            failed = true;
+        }
+        if (pending > 0 || br.outbox_bytes > 0) {
+            fprintf(stderr, "check failed: %zu readings still buffered, %zu bytes in the outbox\n", pending,
+                    br.outbox_bytes);
+            failed = true;
+        }
+        if (failed) {
+            return 1;
+        }
+    }
+    return 0;
+}
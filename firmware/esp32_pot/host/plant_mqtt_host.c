@@ -0,0 +1,220 @@
+#include "plant_mqtt_host.h"
+
+#include <string.h>
+
+#include "mqtt_client.h"
+
+#include "device_identity.h"
+#include "power_manager.h"
+#include "sensors.h"
+#include "time_sync.h"
+#include "watering.h"
+
+struct host_mqtt_client {
+    int unused;
+};
+
+static struct host_mqtt_client s_client;
+static plant_mqtt_host_publish_t s_last;
+
+static char s_name[DEVICE_NAME_MAX_LEN] = "Bench Pot";
+static bool s_sensors_enabled = true;
+static payload_encoding_t s_encoding = PAYLOAD_ENCODING_JSON;
+static bool s_time_valid = true;
+static bool s_time_synced = false;
+static int s_outbox_size = 0;
+
+static bool s_pump, s_ic_zone1, s_fan, s_mister, s_light;
+
+esp_mqtt_client_handle_t plant_mqtt_host_client(void)
+{
+    return &s_client;
+}
+
+const plant_mqtt_host_publish_t *plant_mqtt_host_last_publish(void)
+{
+    return &s_last;
+}
+
+void plant_mqtt_host_reset(void)
+{
+    memset(&s_last, 0, sizeof(s_last));
+}
+
+void plant_mqtt_host_set_identity(const char *name, bool sensors_enabled, payload_encoding_t encoding)
+{
+    s_name[0] = '\0';
+    if (name) {
+        strncpy(s_name, name, sizeof(s_name) - 1);
+        s_name[sizeof(s_name) - 1] = '\0';
+    }
+    s_sensors_enabled = sensors_enabled;
+    s_encoding = encoding;
+}
+
+void plant_mqtt_host_set_time_valid(bool valid)
+{
+    s_time_valid = valid;
+}
+
+void plant_mqtt_host_set_time_synced(bool synced)
+{
+    s_time_synced = synced;
+}
+
+void plant_mqtt_host_set_outbox_size(int bytes)
+{
+    s_outbox_size = bytes;
+}
+
+// MQTT client
+
+esp_mqtt_client_handle_t esp_mqtt_client_init(const esp_mqtt_client_config_t *config)
+{
+    return config ? &s_client : NULL;
+}
+
+esp_err_t esp_mqtt_client_start(esp_mqtt_client_handle_t client)
+{
+    return client ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t esp_mqtt_client_register_event(esp_mqtt_client_handle_t client,
+                                         esp_mqtt_event_id_t event,
+                                         esp_event_handler_t event_handler,
+                                         void *event_handler_arg)
+{
+    return client ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+int esp_mqtt_client_subscribe(esp_mqtt_client_handle_t client, const char *topic, int qos)
+{
+    return client ? 0 : -1;
+}
+
+int esp_mqtt_client_publish(esp_mqtt_client_handle_t client, const char *topic, const char *data, int len, int qos, int retain)
+{
+    if (!client || !topic) {
+        return -1;
+    }
+    size_t n = len > 0 ? (size_t)len : (data ? strlen(data) : 0);
+    s_last.count++;
+    s_last.qos = qos;
+    s_last.retain = retain != 0;
+    strncpy(s_last.topic, topic, sizeof(s_last.topic) - 1);
+    s_last.topic[sizeof(s_last.topic) - 1] = '\0';
+    s_last.len = n;
+    memcpy(s_last.payload, data, n < sizeof(s_last.payload) ? n : sizeof(s_last.payload));
+    return qos > 0 ? (int)s_last.count : 0;
+}
+
+int esp_mqtt_client_get_outbox_size(esp_mqtt_client_handle_t client)
+{
+    return client ? s_outbox_size : 0;
+}
+
+// device_identity.c
+
+const char *device_identity_name(void)
+{
+    return s_name;
+}
+
+bool device_identity_is_named(void)
+{
+    return s_name[0] != '\0';
+}
+
+const char *device_identity_sensor_mode_label(void)
+{
+    return s_sensors_enabled ? "full" : "control_only";
+}
+
+bool device_identity_sensors_enabled(void)
+{
+    return s_sensors_enabled;
+}
+
+payload_encoding_t device_identity_payload_encoding(void)
+{
+    return s_encoding;
+}
+
+const char *device_identity_payload_encoding_label(void)
+{
+    return s_encoding == PAYLOAD_ENCODING_BINARY ? "binary" : "json";
+}
+
+// power_manager.c: an always-on pot
+
+const char *power_manager_mode_label(void)
+{
+    return "always_on";
+}
+
+void power_manager_get_stats(power_stats_t *out_stats)
+{
+    if (out_stats) {
+        memset(out_stats, 0, sizeof(*out_stats));
+        out_stats->mode = POWER_MODE_ALWAYS_ON;
+    }
+}
+
+// sensors.c outputs, as node_schedule.c drives them
+
+void sensors_set_pump_state(bool on) { s_pump = on; }
+bool sensors_get_pump_state(void) { return s_pump; }
+void sensors_set_ic_zone1_state(bool on) { s_ic_zone1 = on; }
+bool sensors_get_ic_zone1_state(void) { return s_ic_zone1; }
+void sensors_pulse_ic_zone1(bool forward, uint32_t pulse_ms) {}
+void sensors_set_fan_state(bool on) { s_fan = on; }
+bool sensors_get_fan_state(void) { return s_fan; }
+void sensors_set_mister_state(bool on) { s_mister = on; }
+bool sensors_get_mister_state(void) { return s_mister; }
+void sensors_set_light_state(bool on) { s_light = on; }
+bool sensors_get_light_state(void) { return s_light; }
+
+// time_sync.c
+
+bool time_sync_is_time_valid(void)
+{
+    return s_time_valid;
+}
+
+bool time_sync_is_synced(void)
+{
+    return s_time_valid && s_time_synced;
+}
+
+uint64_t time_sync_boot_to_epoch_ms(uint64_t uptime_ms)
+{
+    return s_time_valid ? 1767225600000ULL + uptime_ms : 0;
+}
+
+uint64_t time_sync_refine_epoch_ms(uint64_t epoch_ms, bool *estimated)
+{
+    if (estimated) {
+        *estimated = false;
+    }
+    return epoch_ms;
+}
+
+// watering.c; the names match its watering_stop_reason_name()
+
+const char *watering_stop_reason_name(watering_stop_t reason)
+{
+    switch (reason) {
+    case WATERING_STOP_TARGET:
+        return "target";
+    case WATERING_STOP_LIMIT:
+        return "limit";
+    case WATERING_STOP_CUTOFF:
+        return "cutoff";
+    case WATERING_STOP_INTERRUPTED:
+        return "interrupted";
+    case WATERING_STOP_SENSOR_FAULT:
+        return "sensor_fault";
+    default:
+        return "unknown";
+    }
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "plant_mqtt.h"
+
+// main/plant_mqtt.c built for the host. The MQTT client keeps the last
+// publish instead of sending it, and the modules plant_mqtt.c reads
+// (identity, power, outputs, time sync) are stood in for here with fixed
+// answers the harness can change; preferences come from host_prefs.c.
+
+#define PLANT_MQTT_HOST_PAYLOAD_MAX 4608   // a log block, MQTT_BIN_LOG_HEADROOM and all
+
+typedef struct {
+    uint32_t count;             // publishes since the last reset
+    int qos;
+    bool retain;
+    char topic[128];
+    uint8_t payload[PLANT_MQTT_HOST_PAYLOAD_MAX];
+    size_t len;                 // may exceed the copy if the payload did
+} plant_mqtt_host_publish_t;
+
+// A handle for mqtt_publish_*(); no broker or event task behind it
+esp_mqtt_client_handle_t plant_mqtt_host_client(void);
+const plant_mqtt_host_publish_t *plant_mqtt_host_last_publish(void);
+void plant_mqtt_host_reset(void);
+
+// What device_identity.c would report
+void plant_mqtt_host_set_identity(const char *name, bool sensors_enabled, payload_encoding_t encoding);
+// time_sync_is_time_valid(); when false, readings fall back to uptime stamps
+void plant_mqtt_host_set_time_valid(bool valid);
+// time_sync_is_synced(): SNTP has set the clock (false by default)
+void plant_mqtt_host_set_time_synced(bool synced);
+// What esp_mqtt_client_get_outbox_size() reports (0 by default)
+void plant_mqtt_host_set_outbox_size(int bytes);
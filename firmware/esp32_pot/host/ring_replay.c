@@ -0,0 +1,729 @@
+// Replays an outage trace against the telemetry ring (main/storage.c, or
+// main/storage_raw.c when built with BACKEND=partition) on an emulated flash and reports wear, flash traffic and delivery integrity.
+//
+// The workload follows offline_buffer.c: one reading per measurement
+// interval, stored only while the broker is unreachable; while connected the
+// drain step sends OFFLINE_DRAIN_BATCH readings, waits a drain interval for
+// the PUBACK and commits the cursor. Restarts run the shutdown handlers,
+// power losses cut the flash after a given number of program/erase
+// operations. Every reading carries values derived from its index, so each
+// one read back is checked field by field.
+
+#include <errno.h>
+#include <getopt.h>
+#include <math.h>
+#include <setjmp.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "esp_littlefs.h"
+#include "esp_timer.h"
+#include "sdkconfig.h"
+
+#include "host_flash.h"
+#include "host_platform.h"
+#include "storage_host.h"
+
+#if CONFIG_PROJECTPLANT_RING_BACKEND_PARTITION
+#define REPLAY_BACKEND "partition"
+#define REPLAY_RING_LABEL HOST_FLASH_RAW_LABEL
+#define REPLAY_APPEND_BATCH 1          // each append is one program
+#define REPLAY_HEADER_SYNC_ENTRIES 0
+#define REPLAY_FLUSH_SEC 0
+#define REPLAY_LOST_PER_POWER_LOSS 1   // the append being programmed
+#else
+#define REPLAY_BACKEND "littlefs"
+#define REPLAY_RING_LABEL HOST_FLASH_STORAGE_LABEL
+#define REPLAY_APPEND_BATCH CONFIG_PROJECTPLANT_RING_APPEND_BATCH
+#define REPLAY_HEADER_SYNC_ENTRIES CONFIG_PROJECTPLANT_RING_HEADER_SYNC_ENTRIES
+#define REPLAY_FLUSH_SEC CONFIG_PROJECTPLANT_RING_FLUSH_SEC
+// The staged batch, plus the keyframe opening it
+#define REPLAY_LOST_PER_POWER_LOSS (CONFIG_PROJECTPLANT_RING_APPEND_BATCH + 1)
+#endif
+
+#define REPLAY_EPOCH_MS 1767225600000ULL  // 2026-01-01, readings are stamped from here
+#define REPLAY_DRAIN_BATCH 16             // OFFLINE_DRAIN_BATCH
+#define REPLAY_DRAIN_INTERVAL_US 250000LL // OFFLINE_DRAIN_INTERVAL_MS
+#define REPLAY_DRAIN_IDLE_US 5000000LL    // OFFLINE_DRAIN_IDLE_MS
+#define REPLAY_POWER_LOSS_OPS_MAX 64      // synthesized losses land this deep into a write
+#define REPLAY_FINAL_DRAIN_S (7 * 86400)
+#define REPLAY_HISTORY_WINDOWS 16
+
+typedef enum {
+    EVENT_OFFLINE,
+    EVENT_ONLINE,
+    EVENT_RESTART,
+    EVENT_POWER_LOSS,
+} event_kind_t;
+
+static const char *const EVENT_NAMES[] = {"offline", "online", "restart", "powerloss"};
+
+typedef struct {
+    int64_t t_s;
+    event_kind_t kind;
+    uint32_t ops;          // power loss: program/erase operations still allowed
+} event_t;
+
+typedef struct {
+    uint32_t days;
+    uint32_t interval_s;
+    double outages_per_day;
+    double outage_mean_min;
+    double restarts_per_day;
+    double power_losses_per_day;
+    uint64_t seed;
+    uint32_t endurance;
+    const char *trace_path;
+    const char *write_trace_path;
+    bool power_loss_ooo;
+    bool check;
+} options_t;
+
+typedef struct {
+    event_t *events;
+    size_t event_count;
+    size_t next_event;
+    size_t sample_count;   // measurement slots in the trace
+    uint8_t *appended;     // per reading index
+    uint8_t *delivered;
+    bool online;
+    bool draining;         // a batch is waiting for its PUBACK
+    storage_cursor_t batch_next;
+    int64_t next_measure_us;
+    int64_t next_drain_us;
+    int64_t end_us;
+    uint32_t appended_count;
+    uint32_t append_errors;
+    uint32_t live_count;
+    uint32_t delivered_count;
+    uint32_t duplicates;
+    uint32_t corrupt;
+    uint32_t restarts;
+    uint32_t init_failures;
+    uint32_t max_backlog;
+    uint32_t history_retained;   // readings a full-range history query returns
+    uint32_t history_errors;
+} sim_t;
+
+static options_t s_opt = {
+    .days = 30,
+    .interval_s = 60,
+    .outages_per_day = 3.0,
+    .outage_mean_min = 120.0,
+    .restarts_per_day = 0.2,
+    .power_losses_per_day = 0.0,
+    .seed = 1,
+    .endurance = 100000,
+};
+static sim_t s_sim;
+static jmp_buf s_power_loss;
+
+// splitmix64: tiny and the same on every host, so traces are reproducible
+static uint64_t s_rng;
+
+static uint64_t rng_next(void)
+{
+    uint64_t z = (s_rng += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+static double rng_unit(void)
+{
+    return (double)(rng_next() >> 11) / (double)(1ULL << 53);
+}
+
+static double rng_exp(double mean)
+{
+    return -mean * log(1.0 - rng_unit());
+}
+
+static bool push_event(event_t **events, size_t *count, size_t *cap, event_t ev)
+{
+    if (*count == *cap) {
+        size_t new_cap = *cap ? *cap * 2 : 64;
+        event_t *grown = realloc(*events, new_cap * sizeof(event_t));
+        if (!grown) {
+            return false;
+        }
+        *events = grown;
+        *cap = new_cap;
+    }
+    (*events)[(*count)++] = ev;
+    return true;
+}
+
+static int compare_events(const void *a, const void *b)
+{
+    const event_t *x = a;
+    const event_t *y = b;
+    if (x->t_s != y->t_s) {
+        return x->t_s < y->t_s ? -1 : 1;
+    }
+    return (int)x->kind - (int)y->kind;
+}
+
+// Poisson outages, restarts and power losses over the run
+static bool synthesize_trace(void)
+{
+    event_t *events = NULL;
+    size_t count = 0;
+    size_t cap = 0;
+    double span_s = (double)s_opt.days * 86400.0;
+    bool ok = true;
+
+    if (s_opt.outages_per_day > 0) {
+        double t = rng_exp(86400.0 / s_opt.outages_per_day);
+        while (ok && t < span_s) {
+            double len = rng_exp(s_opt.outage_mean_min * 60.0);
+            ok = push_event(&events, &count, &cap, (event_t){(int64_t)t, EVENT_OFFLINE, 0}) &&
+                 push_event(&events, &count, &cap, (event_t){(int64_t)(t + len) + 1, EVENT_ONLINE, 0});
+            t += len + rng_exp(86400.0 / s_opt.outages_per_day);
+        }
+    }
+    if (s_opt.restarts_per_day > 0) {
+        for (double t = rng_exp(86400.0 / s_opt.restarts_per_day); ok && t < span_s;
+             t += rng_exp(86400.0 / s_opt.restarts_per_day)) {
+            ok = push_event(&events, &count, &cap, (event_t){(int64_t)t, EVENT_RESTART, 0});
+        }
+    }
+    if (s_opt.power_losses_per_day > 0) {
+        for (double t = rng_exp(86400.0 / s_opt.power_losses_per_day); ok && t < span_s;
+             t += rng_exp(86400.0 / s_opt.power_losses_per_day)) {
+            uint32_t ops = 1 + (uint32_t)(rng_next() % REPLAY_POWER_LOSS_OPS_MAX);
+            ok = push_event(&events, &count, &cap, (event_t){(int64_t)t, EVENT_POWER_LOSS, ops});
+        }
+    }
+    if (!ok) {
+        free(events);
+        return false;
+    }
+    qsort(events, count, sizeof(event_t), compare_events);
+    s_sim.events = events;
+    s_sim.event_count = count;
+    return true;
+}
+
+// One event per line: "<seconds> offline|online|restart|powerloss [ops]"
+static bool load_trace(const char *path)
+{
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        return false;
+    }
+    event_t *events = NULL;
+    size_t count = 0;
+    size_t cap = 0;
+    char line[128];
+    unsigned lineno = 0;
+    bool ok = true;
+    int64_t last_s = 0;
+    while (ok && fgets(line, sizeof(line), f)) {
+        lineno++;
+        char *p = line + strspn(line, " \t");
+        if (*p == '#' || *p == '\n' || *p == '\0') {
+            continue;
+        }
+        long long t_s = 0;
+        char name[16];
+        unsigned long ops = 1;
+        int fields = sscanf(p, "%lld %15s %lu", &t_s, name, &ops);
+        event_t ev = {.t_s = t_s, .ops = (uint32_t)ops};
+        size_t kind = 0;
+        while (kind < sizeof(EVENT_NAMES) / sizeof(EVENT_NAMES[0]) && (fields < 2 || strcmp(name, EVENT_NAMES[kind]) != 0)) {
+            kind++;
+        }
+        if (fields < 2 || kind == sizeof(EVENT_NAMES) / sizeof(EVENT_NAMES[0]) || t_s < last_s || ops == 0) {
+            fprintf(stderr, "%s:%u: expected \"<seconds> offline|online|restart|powerloss [ops]\" in time order\n",
+                    path, lineno);
+            ok = false;
+            break;
+        }
+        ev.kind = (event_kind_t)kind;
+        last_s = t_s;
+        ok = push_event(&events, &count, &cap, ev);
+    }
+    fclose(f);
+    if (!ok) {
+        free(events);
+        return false;
+    }
+    s_sim.events = events;
+    s_sim.event_count = count;
+    if (count > 0 && (uint64_t)events[count - 1].t_s > (uint64_t)s_opt.days * 86400) {
+        s_opt.days = (uint32_t)((events[count - 1].t_s + 86399) / 86400);
+    }
+    return true;
+}
+
+static bool write_trace(const char *path)
+{
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        return false;
+    }
+    fprintf(f, "# ring_replay trace: %u days, seed %llu\n", (unsigned)s_opt.days, (unsigned long long)s_opt.seed);
+    for (size_t i = 0; i < s_sim.event_count; ++i) {
+        const event_t *ev = &s_sim.events[i];
+        if (ev->kind == EVENT_POWER_LOSS) {
+            fprintf(f, "%lld %s %u\n", (long long)ev->t_s, EVENT_NAMES[ev->kind], (unsigned)ev->ops);
+        } else {
+            fprintf(f, "%lld %s\n", (long long)ev->t_s, EVENT_NAMES[ev->kind]);
+        }
+    }
+    return fclose(f) == 0;
+}
+
+// Reading values are a function of the index, in steps the ring stores exactly
+static void expected_reading(uint32_t k, sensor_reading_t *out)
+{
+    memset(out, 0, sizeof(*out));
+    out->timestamp_ms = REPLAY_EPOCH_MS + (uint64_t)k * s_opt.interval_s * 1000ULL;
+    out->soil_raw = (uint16_t)(k * 37u);
+    out->soil_percent = (float)(k % 10000) / 100.0f;
+    out->temperature_c = (float)((int32_t)((k * 7u) % 4000) - 1000) / 100.0f;
+    out->humidity_pct = k % 11 == 0 ? NAN : (float)(k % 9000) / 100.0f;
+    out->battery_v = k % 13 == 0 ? NAN : (float)(3000 + k % 1000) / 1000.0f;
+    out->water_low = k % 3 == 0;
+    out->water_cutoff = k % 17 == 0;
+    out->pump_is_on = k % 5 == 0;
+    out->ic_zone1_is_on = k % 7 == 0;
+    out->fan_is_on = k % 2 == 0;
+    out->mister_is_on = k % 19 == 0;
+    out->light_is_on = k % 23 == 0;
+}
+
+static bool same_float(float a, float b)
+{
+    return (isnan(a) && isnan(b)) || fabsf(a - b) < 0.0005f;
+}
+
+// Index of the appended reading a sample decodes to, or false if it matches none
+static bool sample_index(const telemetry_sample_t *sample, uint32_t *out_k)
+{
+    const sensor_reading_t *got = &sample->reading;
+    uint64_t step_ms = (uint64_t)s_opt.interval_s * 1000ULL;
+    uint64_t rel_ms = got->timestamp_ms - REPLAY_EPOCH_MS;
+    uint64_t k = rel_ms / step_ms;
+    if (got->timestamp_ms < REPLAY_EPOCH_MS || rel_ms % step_ms != 0 || k >= s_sim.sample_count ||
+        !s_sim.appended[k]) {
+        return false;
+    }
+    sensor_reading_t want;
+    expected_reading((uint32_t)k, &want);
+    if (got->soil_raw != want.soil_raw || !same_float(got->soil_percent, want.soil_percent) ||
+        !same_float(got->temperature_c, want.temperature_c) || !same_float(got->humidity_pct, want.humidity_pct) ||
+        !same_float(got->battery_v, want.battery_v) || got->water_low != want.water_low ||
+        got->water_cutoff != want.water_cutoff || got->pump_is_on != want.pump_is_on ||
+        got->ic_zone1_is_on != want.ic_zone1_is_on || got->fan_is_on != want.fan_is_on ||
+        got->mister_is_on != want.mister_is_on || got->light_is_on != want.light_is_on ||
+        sample->rssi != -(int16_t)(k % 90)) {
+        return false;
+    }
+    *out_k = (uint32_t)k;
+    return true;
+}
+
+static void verify_sample(const telemetry_sample_t *sample)
+{
+    uint32_t k;
+    if (!sample_index(sample, &k)) {
+        s_sim.corrupt++;
+        return;
+    }
+    if (s_sim.delivered[k]) {
+        s_sim.duplicates++;
+        return;
+    }
+    s_sim.delivered[k] = 1;
+    s_sim.delivered_count++;
+}
+
+static void boot(void)
+{
+    s_sim.draining = false;
+    if (storage_init() != ESP_OK) {
+        s_sim.init_failures++;
+    }
+}
+
+static void restart(void)
+{
+    host_restart();
+    esp_vfs_littlefs_unregister("storage");
+    storage_host_forget();
+    s_sim.restarts++;
+    boot();
+}
+
+static void on_power_loss(void)
+{
+    host_flash_recover();
+    storage_host_forget();
+    host_power_cycle();
+    boot();
+}
+
+static void measure(void)
+{
+    uint64_t k = (uint64_t)(s_sim.next_measure_us / 1000000LL) / s_opt.interval_s;
+    s_sim.next_measure_us += (int64_t)s_opt.interval_s * 1000000LL;
+    if (k >= s_sim.sample_count) {
+        return;
+    }
+    if (s_sim.online) {
+        s_sim.live_count++;
+        return;
+    }
+    telemetry_sample_t sample = {
+        .uptime_ms = esp_timer_get_time() / 1000,
+        .rssi = -(int16_t)(k % 90),
+    };
+    expected_reading((uint32_t)k, &sample.reading);
+    s_sim.appended[k] = 1;
+    s_sim.appended_count++;
+    if (storage_append_sample(&sample) != ESP_OK) {
+        s_sim.append_errors++;
+    }
+    size_t backlog = storage_count();
+    if (backlog > s_sim.max_backlog) {
+        s_sim.max_backlog = (uint32_t)backlog;
+    }
+}
+
+// offline_buffer_drain_step(), with the PUBACK arriving one interval later
+static void drain_step(void)
+{
+    storage_flush_if_due();
+    if (s_sim.draining && s_sim.online) {
+        storage_commit_cursor(&s_sim.batch_next);
+        s_sim.draining = false;
+    }
+    if (!s_sim.online || s_sim.draining) {
+        s_sim.next_drain_us += REPLAY_DRAIN_IDLE_US;
+        return;
+    }
+    telemetry_sample_t batch[REPLAY_DRAIN_BATCH];
+    storage_cursor_begin(&s_sim.batch_next);
+    size_t n = storage_read_batch(&s_sim.batch_next, batch, REPLAY_DRAIN_BATCH);
+    if (n == 0) {
+        storage_commit_cursor(&s_sim.batch_next);
+        s_sim.next_drain_us += REPLAY_DRAIN_IDLE_US;
+        return;
+    }
+    for (size_t i = 0; i < n; ++i) {
+        verify_sample(&batch[i]);
+    }
+    s_sim.draining = true;
+    s_sim.next_drain_us += REPLAY_DRAIN_INTERVAL_US;
+}
+
+static void apply_event(const event_t *ev)
+{
+    switch (ev->kind) {
+    case EVENT_OFFLINE:
+        s_sim.online = false;
+        break;
+    case EVENT_ONLINE:
+        s_sim.online = true;
+        break;
+    case EVENT_RESTART:
+        restart();
+        break;
+    case EVENT_POWER_LOSS:
+        host_flash_arm_power_loss(ev->ops, &s_power_loss);
+        break;
+    }
+}
+
+// Advance to whichever comes first: a trace event, a measurement or a drain step
+static bool step(void)
+{
+    int64_t event_us = s_sim.next_event < s_sim.event_count ? s_sim.events[s_sim.next_event].t_s * 1000000LL : INT64_MAX;
+    int64_t next_us = s_sim.next_measure_us;
+    next_us = s_sim.next_drain_us < next_us ? s_sim.next_drain_us : next_us;
+    next_us = event_us < next_us ? event_us : next_us;
+    if (next_us >= s_sim.end_us) {
+        return false;
+    }
+    host_clock_advance_us(next_us - host_clock_now_us());
+    if (next_us == event_us) {
+        apply_event(&s_sim.events[s_sim.next_event++]);
+    } else if (next_us == s_sim.next_measure_us) {
+        measure();
+    } else {
+        drain_step();
+    }
+    return true;
+}
+
+static void run(void)
+{
+    if (setjmp(s_power_loss) != 0) {
+        on_power_loss();
+    }
+    while (step()) {
+    }
+
+    // Reconnect for good and drain what is left, so every reading is accounted for
+    host_flash_arm_power_loss(0, NULL);
+    s_sim.online = true;
+    s_sim.next_event = s_sim.event_count;
+    s_sim.end_us = host_clock_now_us() + REPLAY_FINAL_DRAIN_S * 1000000LL;
+    s_sim.next_measure_us = INT64_MAX;
+    while (step() && (s_sim.draining || storage_count() > 0)) {
+    }
+    storage_flush();
+}
+
+// Run one history query; every reading it returns is marked in seen
+static uint32_t history_scan(uint64_t from_ms, uint64_t to_ms, uint8_t *seen)
+{
+    storage_history_t query;
+    storage_history_begin(&query, from_ms, to_ms);
+    telemetry_sample_t out[REPLAY_DRAIN_BATCH];
+    uint32_t count = 0;
+    size_t n;
+    while ((n = storage_history_read(&query, out, REPLAY_DRAIN_BATCH)) > 0) {
+        for (size_t i = 0; i < n; ++i) {
+            uint32_t k;
+            uint64_t ts = out[i].reading.timestamp_ms;
+            if (!sample_index(&out[i], &k) || seen[k] || ts < from_ms || ts > to_ms) {
+                s_sim.history_errors++;
+                continue;
+            }
+            seen[k] = 1;
+            count++;
+        }
+    }
+    return count;
+}
+
+// History queries must agree with a full scan: the full range returns each
+// reading still on flash once, and any window returns exactly the full
+// scan's readings inside it. Checked with the index built by appends, then
+// again with the one rebuilt at boot.
+static void verify_history(void)
+{
+    uint8_t *full = calloc(s_sim.sample_count, 1);
+    uint8_t *window = calloc(s_sim.sample_count, 1);
+    if (!full || !window) {
+        s_sim.history_errors++;
+        free(full);
+        free(window);
+        return;
+    }
+    uint64_t step_ms = (uint64_t)s_opt.interval_s * 1000ULL;
+    uint64_t first_k = 0;
+    uint64_t last_k = 0;
+    for (int pass = 0; pass < 2; ++pass) {
+        if (pass == 1) {
+            restart();
+            memset(window, 0, s_sim.sample_count);
+            if (history_scan(0, UINT64_MAX, window) != s_sim.history_retained ||
+                memcmp(window, full, s_sim.sample_count) != 0) {
+                s_sim.history_errors++;
+            }
+        } else {
+            s_sim.history_retained = history_scan(0, UINT64_MAX, full);
+            for (size_t k = 0; k < s_sim.sample_count; ++k) {
+                if (full[k]) {
+                    first_k = first_k ? first_k : k;
+                    last_k = k;
+                }
+            }
+        }
+        // Windows around what is retained, overhanging either end
+        for (int w = 0; w < REPLAY_HISTORY_WINDOWS; ++w) {
+            uint64_t lo = first_k > 512 ? first_k - 512 : 0;
+            uint64_t from_k = lo + rng_next() % (last_k - lo + 1);
+            uint64_t span_k = rng_next() % 1024;
+            uint64_t from_ms = REPLAY_EPOCH_MS + from_k * step_ms - step_ms / 2;
+            uint64_t to_ms = from_ms + span_k * step_ms;
+            memset(window, 0, s_sim.sample_count);
+            history_scan(from_ms, to_ms, window);
+            for (size_t k = 0; k < s_sim.sample_count; ++k) {
+                uint64_t ts = REPLAY_EPOCH_MS + k * step_ms;
+                bool want = full[k] && ts >= from_ms && ts <= to_ms;
+                if (want != (window[k] != 0)) {
+                    s_sim.history_errors++;
+                    break;
+                }
+            }
+        }
+    }
+    free(full);
+    free(window);
+}
+
+static double wall_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr,
+            "usage: %s [options]\n"
+            "  --days N                 length of the synthesized trace (30)\n"
+            "  --interval S             measurement interval in seconds (60)\n"
+            "  --outages-per-day X      broker outages, Poisson (3)\n"
+            "  --outage-minutes M       mean outage length (120)\n"
+            "  --restarts-per-day X     clean restarts (0.2)\n"
+            "  --power-losses-per-day X power cuts, each 1-%d flash operations after its time (0)\n"
+            "  --power-loss-ooo         a power cut also reverts the last block written since sync\n"
+            "  --seed N                 trace seed (1)\n"
+            "  --trace FILE             replay FILE instead of synthesizing a trace\n"
+            "  --write-trace FILE       save the trace that is replayed\n"
+            "  --endurance N            erase cycles per block used for the lifetime estimate (100000)\n"
+            "  --check                  exit 1 on corrupt readings, failed inits, or more readings\n"
+            "                           missing than power cuts explain (keep outages within the ring)\n"
+            "  -v                       storage and flash logs (repeat for more)\n",
+            argv0, REPLAY_POWER_LOSS_OPS_MAX);
+}
+
+static bool parse_options(int argc, char **argv)
+{
+    static const struct option longopts[] = {
+        {"days", required_argument, NULL, 'd'},
+        {"interval", required_argument, NULL, 'i'},
+        {"outages-per-day", required_argument, NULL, 'o'},
+        {"outage-minutes", required_argument, NULL, 'm'},
+        {"restarts-per-day", required_argument, NULL, 'r'},
+        {"power-losses-per-day", required_argument, NULL, 'p'},
+        {"power-loss-ooo", no_argument, NULL, 'O'},
+        {"seed", required_argument, NULL, 's'},
+        {"trace", required_argument, NULL, 't'},
+        {"write-trace", required_argument, NULL, 'w'},
+        {"endurance", required_argument, NULL, 'e'},
+        {"check", no_argument, NULL, 'c'},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0},
+    };
+    int c;
+    while ((c = getopt_long(argc, argv, "vh", longopts, NULL)) != -1) {
+        switch (c) {
+        case 'd': s_opt.days = (uint32_t)strtoul(optarg, NULL, 0); break;
+        case 'i': s_opt.interval_s = (uint32_t)strtoul(optarg, NULL, 0); break;
+        case 'o': s_opt.outages_per_day = strtod(optarg, NULL); break;
+        case 'm': s_opt.outage_mean_min = strtod(optarg, NULL); break;
+        case 'r': s_opt.restarts_per_day = strtod(optarg, NULL); break;
+        case 'p': s_opt.power_losses_per_day = strtod(optarg, NULL); break;
+        case 'O': s_opt.power_loss_ooo = true; break;
+        case 's': s_opt.seed = strtoull(optarg, NULL, 0); break;
+        case 't': s_opt.trace_path = optarg; break;
+        case 'w': s_opt.write_trace_path = optarg; break;
+        case 'e': s_opt.endurance = (uint32_t)strtoul(optarg, NULL, 0); break;
+        case 'c': s_opt.check = true; break;
+        case 'v': host_log_level = host_log_level < ESP_LOG_INFO ? ESP_LOG_INFO : ESP_LOG_DEBUG; break;
+        default:
+            usage(argv[0]);
+            return false;
+        }
+    }
+    if (optind != argc || s_opt.days == 0 || s_opt.interval_s == 0 || s_opt.endurance == 0) {
+        usage(argv[0]);
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    if (!parse_options(argc, argv)) {
+        return 2;
+    }
+    s_rng = s_opt.seed;
+    if (s_opt.trace_path ? !load_trace(s_opt.trace_path) : !synthesize_trace()) {
+        return 2;
+    }
+    if (s_opt.write_trace_path && !write_trace(s_opt.write_trace_path)) {
+        return 2;
+    }
+
+    s_sim.sample_count = (size_t)s_opt.days * 86400 / s_opt.interval_s;
+    s_sim.appended = calloc(s_sim.sample_count, 1);
+    s_sim.delivered = calloc(s_sim.sample_count, 1);
+    if (!s_sim.appended || !s_sim.delivered) {
+        fprintf(stderr, "out of memory\n");
+        return 2;
+    }
+    s_sim.online = true;
+    s_sim.next_measure_us = (int64_t)s_opt.interval_s * 1000000LL;
+    s_sim.next_drain_us = REPLAY_DRAIN_IDLE_US;
+    s_sim.end_us = (int64_t)s_opt.days * 86400 * 1000000LL;
+
+    host_flash_config_t flash = HOST_FLASH_CONFIG_DEFAULT();
+    flash.power_loss_ooo = s_opt.power_loss_ooo;
+    if (host_flash_init(&flash) != 0) {
+        fprintf(stderr, "flash emulation init failed\n");
+        return 2;
+    }
+
+    double started = wall_seconds();
+    boot();
+    run();
+    double wall_s = wall_seconds() - started;
+
+    host_flash_stats_t st;
+    host_flash_get_stats(REPLAY_RING_LABEL, &st);
+    uint32_t power_losses = host_flash_power_losses();
+    uint32_t restarts = s_sim.restarts;
+    verify_history();  // after the totals: it reads flash and reboots once
+    uint32_t missing = s_sim.appended_count - s_sim.delivered_count;
+    double readings = s_sim.appended_count ? (double)s_sim.appended_count : 1.0;
+    double wear_per_day = (double)st.max_wear / s_opt.days;
+    double life_years = wear_per_day > 0 ? (double)s_opt.endurance / wear_per_day / 365.0 : INFINITY;
+
+    printf("Replayed %u days: %u readings buffered, %u sent live, backlog peak %u of %u\n",
+           (unsigned)s_opt.days, (unsigned)s_sim.appended_count, (unsigned)s_sim.live_count,
+           (unsigned)s_sim.max_backlog, (unsigned)storage_capacity());
+    printf("Delivered %u, missing %u, duplicates %u, corrupt %u (%u restarts, %u power losses, %u failed inits)\n",
+           (unsigned)s_sim.delivered_count, (unsigned)missing, (unsigned)s_sim.duplicates, (unsigned)s_sim.corrupt,
+           (unsigned)restarts, (unsigned)power_losses, (unsigned)s_sim.init_failures);
+    printf("History: %u readings still on flash, %u query mismatches\n", (unsigned)s_sim.history_retained,
+           (unsigned)s_sim.history_errors);
+    printf("Flash: %u erases, wear max %u / mean %.1f / min %u, %llu bytes programmed in %u progs, %llu bytes read\n",
+           (unsigned)st.erases, (unsigned)st.max_wear, st.mean_wear, (unsigned)st.min_wear,
+           (unsigned long long)st.bytes_programmed, (unsigned)st.progs, (unsigned long long)st.bytes_read);
+    printf("Per buffered reading: %.1f bytes programmed, %.3f erases; worst block lasts %.0f years at %u cycles\n",
+           (double)st.bytes_programmed / readings, (double)st.erases / readings, life_years, (unsigned)s_opt.endurance);
+    printf("Host time %.2f s (%.0f readings/s)\n", wall_s, wall_s > 0 ? readings / wall_s : 0.0);
+    printf("RING_REPLAY {\"backend\":\"" REPLAY_BACKEND "\",\"days\":%u,\"interval_s\":%u,\"append_batch\":%u,\"header_sync_entries\":%u,"
+           "\"flush_sec\":%u,\"capacity\":%u,\"buffered\":%u,\"delivered\":%u,\"missing\":%u,"
+           "\"duplicates\":%u,\"corrupt\":%u,\"restarts\":%u,\"power_losses\":%u,\"history_retained\":%u,\"history_errors\":%u,\"erases\":%u,"
+           "\"max_wear\":%u,\"mean_wear\":%.2f,\"bytes_programmed\":%llu,\"progs\":%u,\"bytes_read\":%llu,"
+           "\"prog_bytes_per_reading\":%.1f,\"life_years\":%.1f,\"wall_s\":%.3f}\n",
+           (unsigned)s_opt.days, (unsigned)s_opt.interval_s, (unsigned)REPLAY_APPEND_BATCH,
+           (unsigned)REPLAY_HEADER_SYNC_ENTRIES, (unsigned)REPLAY_FLUSH_SEC,
+           (unsigned)storage_capacity(), (unsigned)s_sim.appended_count, (unsigned)s_sim.delivered_count,
+           (unsigned)missing, (unsigned)s_sim.duplicates, (unsigned)s_sim.corrupt, (unsigned)restarts,
+           (unsigned)power_losses, (unsigned)s_sim.history_retained, (unsigned)s_sim.history_errors, (unsigned)st.erases, (unsigned)st.max_wear, st.mean_wear,
+           (unsigned long long)st.bytes_programmed, (unsigned)st.progs, (unsigned long long)st.bytes_read,
+           (double)st.bytes_programmed / readings, isinf(life_years) ? -1.0 : life_years, wall_s);
+
+    host_flash_deinit();
+    free(s_sim.appended);
+    free(s_sim.delivered);
+    free(s_sim.events);
+
+    if (s_opt.check) {
+        uint32_t allowed = power_losses * REPLAY_LOST_PER_POWER_LOSS;
+        if (s_sim.corrupt > 0 || s_sim.init_failures > 0 || missing > allowed || s_sim.history_errors > 0) {
+            fprintf(stderr, "check failed: %u corrupt, %u failed inits, %u missing (at most %u expected), "
+                    "%u history mismatches\n", (unsigned)s_sim.corrupt, (unsigned)s_sim.init_failures,
+                    (unsigned)missing, (unsigned)allowed, (unsigned)s_sim.history_errors);
+            return 1;
+        }
+    }
+    return 0;
+}
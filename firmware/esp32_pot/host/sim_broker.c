@@ -0,0 +1,452 @@
+#include "sim_broker.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "mqtt_client.h"
+
+#include "host_platform.h"
+
+#define SIM_MQTT_TASK_PRIORITY 5     // esp-mqtt's MQTT_TASK_PRIORITY
+#define SIM_MQTT_TASK_STACK 6144
+#define SIM_TOPIC_MAX 96
+#define SIM_NEVER INT64_MAX
+
+typedef enum {
+    EV_ATTEMPT,      // connect attempt: TCP, TLS and CONNECT go out
+    EV_CONNACK,
+    EV_LINK_LOST,
+    EV_PUBACK,
+    EV_DATA,
+} pending_kind_t;
+
+// Something the client task will act on at due_us
+typedef struct pending {
+    struct pending *next;
+    int64_t due_us;
+    pending_kind_t kind;
+    int msg_id;
+    uint32_t connection;     // PUBACKs only count on the connection that sent them
+    uint64_t seq;            // hub messages keep their order through the session
+    char topic[SIM_TOPIC_MAX];
+    char *data;
+    int len;
+} pending_t;
+
+typedef struct outbox_item {
+    struct outbox_item *next;
+    int msg_id;
+    int64_t created_us;
+    bool sent;               // on the current connection
+    bool ever_sent;
+    char topic[SIM_TOPIC_MAX];
+    char *data;
+    int len;
+} outbox_item_t;
+
+struct host_mqtt_client {
+    esp_event_handler_t handler;
+    void *handler_arg;
+    int outbox_limit;
+    bool started;
+};
+
+static struct host_mqtt_client s_client;
+static sim_broker_config_t s_config;
+static sim_broker_deliver_fn_t s_on_deliver;
+static TaskHandle_t s_task;
+static pending_t *s_pending;         // sorted by due_us, FIFO among equals
+static outbox_item_t *s_outbox;      // publish order
+static pending_t *s_session;         // hub messages waiting for the node
+static bool s_link_up = true;
+static bool s_connected;
+static bool s_had_session;
+static uint32_t s_connection;
+static int s_next_msg_id = 1;
+static uint64_t s_hub_seq;
+static sim_broker_stats_t s_stats;
+
+void sim_broker_init(const sim_broker_config_t *config, sim_broker_deliver_fn_t on_deliver)
+{
+    s_config = *config;
+    s_on_deliver = on_deliver;
+}
+
+static size_t outbox_bytes(void)
+{
+    size_t bytes = 0;
+    for (outbox_item_t *item = s_outbox; item; item = item->next) {
+        bytes += (size_t)item->len + strlen(item->topic);
+    }
+    return bytes;
+}
+
+void sim_broker_get_stats(sim_broker_stats_t *out)
+{
+    *out = s_stats;
+    out->outbox_bytes = outbox_bytes();
+}
+
+bool sim_broker_connected(void)
+{
+    return s_connected && s_link_up;
+}
+
+static void wake_client(void)
+{
+    if (s_task) {
+        xTaskNotifyGive(s_task);
+    }
+}
+
+static void schedule(pending_t *ev)
+{
+    pending_t **at = &s_pending;
+    while (*at && (*at)->due_us <= ev->due_us) {
+        at = &(*at)->next;
+    }
+    ev->next = *at;
+    *at = ev;
+}
+
+static pending_t *new_pending(pending_kind_t kind, int64_t due_us)
+{
+    pending_t *ev = calloc(1, sizeof(*ev));
+    if (!ev) {
+        abort();
+    }
+    ev->kind = kind;
+    ev->due_us = due_us;
+    return ev;
+}
+
+static void free_pending(pending_t *ev)
+{
+    free(ev->data);
+    free(ev);
+}
+
+static void dispatch(esp_mqtt_event_id_t id, int msg_id, pending_t *data)
+{
+    if (!s_client.handler) {
+        return;
+    }
+    esp_mqtt_event_t event = {
+        .event_id = id,
+        .client = &s_client,
+        .msg_id = msg_id,
+        .session_present = id == MQTT_EVENT_CONNECTED && s_had_session,
+    };
+    if (data) {
+        event.topic = data->topic;
+        event.topic_len = (int)strlen(data->topic);
+        event.data = data->data;
+        event.data_len = data->len;
+        event.total_data_len = data->len;
+        event.qos = 1;
+    }
+    s_client.handler(s_client.handler_arg, "MQTT_EVENTS", id, &event);
+}
+
+// The broker got it; the PUBACK comes back one round trip later
+static void transmit(outbox_item_t *item)
+{
+    bool dup = item->ever_sent;
+    item->sent = true;
+    item->ever_sent = true;
+    s_stats.delivered++;
+    if (dup) {
+        s_stats.resent++;
+    }
+    if (s_on_deliver) {
+        s_on_deliver(item->topic, item->data, item->len, dup);
+    }
+    pending_t *ack = new_pending(EV_PUBACK, host_clock_now_us() + (int64_t)s_config.rtt_ms * 1000);
+    ack->msg_id = item->msg_id;
+    ack->connection = s_connection;
+    schedule(ack);
+}
+
+// esp-mqtt deletes expired messages while connected, before resending
+static void expire_outbox(int64_t now_us)
+{
+    outbox_item_t **at = &s_outbox;
+    while (*at) {
+        outbox_item_t *item = *at;
+        if (now_us - item->created_us >= (int64_t)s_config.outbox_expire_ms * 1000) {
+            *at = item->next;
+            s_stats.expired++;
+            int msg_id = item->msg_id;
+            free(item->data);
+            free(item);
+            dispatch(MQTT_EVENT_DELETED, msg_id, NULL);
+        } else {
+            at = &item->next;
+        }
+    }
+}
+
+static void keep_in_session(pending_t *msg)
+{
+    pending_t **at = &s_session;
+    while (*at && (*at)->seq < msg->seq) {
+        at = &(*at)->next;
+    }
+    msg->next = *at;
+    *at = msg;
+    s_stats.hub_queued++;
+}
+
+static void on_connack(void)
+{
+    s_connected = true;
+    s_connection++;
+    s_stats.connects++;
+    for (outbox_item_t *item = s_outbox; item; item = item->next) {
+        item->sent = false;
+    }
+    dispatch(MQTT_EVENT_CONNECTED, 0, NULL);
+    s_had_session = true;
+    expire_outbox(host_clock_now_us());
+    for (outbox_item_t *item = s_outbox; item && sim_broker_connected(); item = item->next) {
+        if (!item->sent) {
+            transmit(item);
+        }
+    }
+    while (s_session) {
+        pending_t *msg = s_session;
+        s_session = msg->next;
+        msg->due_us = host_clock_now_us();
+        schedule(msg);
+    }
+}
+
+static void handle(pending_t *ev)
+{
+    int64_t now_us = host_clock_now_us();
+    switch (ev->kind) {
+    case EV_ATTEMPT:
+        if (s_connected) {
+            break;
+        }
+        if (s_link_up) {
+            schedule(new_pending(EV_CONNACK, now_us + (int64_t)s_config.connect_ms * 1000));
+        } else {
+            schedule(new_pending(EV_ATTEMPT, now_us + (int64_t)s_config.reconnect_ms * 1000));
+        }
+        break;
+    case EV_CONNACK:
+        if (s_link_up) {
+            on_connack();
+        } else {
+            schedule(new_pending(EV_ATTEMPT, now_us + (int64_t)s_config.reconnect_ms * 1000));
+        }
+        break;
+    case EV_LINK_LOST:
+        if (s_connected) {
+            s_connected = false;
+            dispatch(MQTT_EVENT_DISCONNECTED, 0, NULL);
+            schedule(new_pending(EV_ATTEMPT, now_us + (int64_t)s_config.reconnect_ms * 1000));
+        }
+        break;
+    case EV_PUBACK:
+        if (!s_connected || ev->connection != s_connection) {
+            break;   // lost with the connection; resent on the next one
+        }
+        for (outbox_item_t **at = &s_outbox; *at; at = &(*at)->next) {
+            outbox_item_t *item = *at;
+            if (item->msg_id == ev->msg_id) {
+                *at = item->next;
+                free(item->data);
+                free(item);
+                dispatch(MQTT_EVENT_PUBLISHED, ev->msg_id, NULL);
+                break;
+            }
+        }
+        break;
+    case EV_DATA:
+        if (!sim_broker_connected()) {
+            // Dropped on the way; the session keeps it for the next connection
+            keep_in_session(ev);
+            return;
+        }
+        dispatch(MQTT_EVENT_DATA, 0, ev);
+        break;
+    }
+    free_pending(ev);
+}
+
+static void client_task(void *arg)
+{
+    schedule(new_pending(EV_ATTEMPT, host_clock_now_us()));
+    while (true) {
+        int64_t now_us = host_clock_now_us();
+        if (s_connected) {
+            expire_outbox(now_us);
+        }
+        if (s_pending && s_pending->due_us <= now_us) {
+            pending_t *ev = s_pending;
+            s_pending = ev->next;
+            handle(ev);
+            continue;
+        }
+        int64_t next_us = s_pending ? s_pending->due_us : SIM_NEVER;
+        if (s_connected && s_outbox) {
+            int64_t expiry_us = s_outbox->created_us + (int64_t)s_config.outbox_expire_ms * 1000;
+            for (outbox_item_t *item = s_outbox; item; item = item->next) {
+                int64_t at = item->created_us + (int64_t)s_config.outbox_expire_ms * 1000;
+                expiry_us = at < expiry_us ? at : expiry_us;
+            }
+            next_us = expiry_us < next_us ? expiry_us : next_us;
+        }
+        TickType_t wait = next_us == SIM_NEVER
+            ? portMAX_DELAY
+            : pdMS_TO_TICKS((uint32_t)((next_us - now_us + 999) / 1000));
+        ulTaskNotifyTake(pdTRUE, wait);
+    }
+}
+
+void sim_broker_set_link(bool up)
+{
+    if (s_link_up == up) {
+        return;
+    }
+    s_link_up = up;
+    if (!up) {
+        schedule(new_pending(EV_LINK_LOST, host_clock_now_us()));
+        wake_client();
+    }
+}
+
+void sim_broker_send(const char *topic, const char *payload)
+{
+    pending_t *msg = new_pending(EV_DATA, host_clock_now_us() + (int64_t)s_config.rtt_ms * 500);
+    snprintf(msg->topic, sizeof(msg->topic), "%s", topic);
+    msg->len = (int)strlen(payload);
+    msg->data = malloc((size_t)msg->len + 1);
+    if (!msg->data) {
+        abort();
+    }
+    memcpy(msg->data, payload, (size_t)msg->len + 1);
+    msg->seq = s_hub_seq++;
+    s_stats.hub_messages++;
+    if (sim_broker_connected()) {
+        schedule(msg);
+        wake_client();
+    } else {
+        keep_in_session(msg);
+    }
+}
+
+// esp-mqtt client API
+
+esp_mqtt_client_handle_t esp_mqtt_client_init(const esp_mqtt_client_config_t *config)
+{
+    if (!config) {
+        return NULL;
+    }
+    s_client.outbox_limit = config->outbox.limit;
+    return &s_client;
+}
+
+esp_err_t esp_mqtt_client_register_event(esp_mqtt_client_handle_t client,
+                                         esp_mqtt_event_id_t event,
+                                         esp_event_handler_t event_handler,
+                                         void *event_handler_arg)
+{
+    if (!client) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    client->handler = event_handler;
+    client->handler_arg = event_handler_arg;
+    return ESP_OK;
+}
+
+esp_err_t esp_mqtt_client_start(esp_mqtt_client_handle_t client)
+{
+    if (!client) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (client->started) {
+        return ESP_FAIL;
+    }
+    client->started = true;
+    if (xTaskCreatePinnedToCore(client_task, "mqtt_client", SIM_MQTT_TASK_STACK, NULL, SIM_MQTT_TASK_PRIORITY,
+                                &s_task, 0) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+int esp_mqtt_client_subscribe(esp_mqtt_client_handle_t client, const char *topic, int qos)
+{
+    if (!client || !sim_broker_connected()) {
+        return -1;
+    }
+    return s_next_msg_id++;
+}
+
+int esp_mqtt_client_publish(esp_mqtt_client_handle_t client, const char *topic, const char *data, int len,
+                            int qos, int retain)
+{
+    if (!client || !topic) {
+        return -1;
+    }
+    if (len <= 0) {
+        len = data ? (int)strlen(data) : 0;
+    }
+    bool online = sim_broker_connected();
+    if (qos == 0) {
+        if (!online) {
+            s_stats.refused_offline++;
+            return -1;
+        }
+        s_stats.publishes++;
+        s_stats.delivered++;
+        if (s_on_deliver) {
+            s_on_deliver(topic, data, len, false);
+        }
+        return 0;
+    }
+    size_t bytes = outbox_bytes() + (size_t)len + strlen(topic);
+    if (client->outbox_limit > 0 && bytes > (size_t)client->outbox_limit) {
+        s_stats.refused_full++;
+        return -2;
+    }
+    outbox_item_t *item = calloc(1, sizeof(*item));
+    if (!item || !(item->data = malloc((size_t)len + 1))) {
+        abort();
+    }
+    item->msg_id = s_next_msg_id++;
+    if (s_next_msg_id > 65535) {
+        s_next_msg_id = 1;
+    }
+    item->created_us = host_clock_now_us();
+    snprintf(item->topic, sizeof(item->topic), "%s", topic);
+    memcpy(item->data, data, (size_t)len);
+    item->data[len] = '\0';
+    item->len = len;
+    outbox_item_t **at = &s_outbox;
+    while (*at) {
+        at = &(*at)->next;
+    }
+    *at = item;
+    s_stats.publishes++;
+    if (bytes > s_stats.outbox_high_water) {
+        s_stats.outbox_high_water = (uint32_t)bytes;
+    }
+    int msg_id = item->msg_id;
+    if (online) {
+        transmit(item);
+        wake_client();   // last: it may switch to the client task
+    }
+    return msg_id;
+}
+
+int esp_mqtt_client_get_outbox_size(esp_mqtt_client_handle_t client)
+{
+    return client ? (int)outbox_bytes() : 0;
+}
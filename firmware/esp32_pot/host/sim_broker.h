@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// The MQTT client and broker for the node simulator, in place of esp-mqtt.
+// The client runs its own task, as esp-mqtt does: it connects, retries every
+// reconnect interval while the link is down, and hands CONNECTED,
+// DISCONNECTED, DATA, PUBLISHED and DELETED events to the registered
+// handler. QoS 1 publishes wait in an outbox (capped by outbox.limit) until
+// the broker's PUBACK, are sent again after a reconnect and expire like
+// esp-mqtt's. The broker keeps the persistent session: hub messages for a
+// disconnected node are delivered when it comes back.
+
+typedef struct {
+    uint32_t connect_ms;        // link up to CONNACK
+    uint32_t reconnect_ms;      // esp-mqtt's reconnect_timeout_ms
+    uint32_t rtt_ms;            // publish to PUBACK, hub message to DATA
+    uint32_t outbox_expire_ms;  // CONFIG_MQTT_OUTBOX_EXPIRED_TIMEOUT_MS
+} sim_broker_config_t;
+
+#define SIM_BROKER_CONFIG_DEFAULT() { \
+    .connect_ms = 400, \
+    .reconnect_ms = 10000, \
+    .rtt_ms = 40, \
+    .outbox_expire_ms = 30000, \
+}
+
+// Every message the node got through to the broker, resends included
+typedef void (*sim_broker_deliver_fn_t)(const char *topic, const char *data, int len, bool dup);
+
+void sim_broker_init(const sim_broker_config_t *config, sim_broker_deliver_fn_t on_deliver);
+
+// The network path to the broker. Taking it down drops the connection at
+// once; bringing it back lets the next connect attempt through.
+void sim_broker_set_link(bool up);
+bool sim_broker_connected(void);
+
+// Publish from the hub to the node (QoS 1): delivered now when connected,
+// otherwise kept in the session until the node connects
+void sim_broker_send(const char *topic, const char *payload);
+
+typedef struct {
+    uint64_t connects;
+    uint64_t publishes;          // accepted by esp_mqtt_client_publish()
+    uint64_t delivered;          // reached the broker, resends included
+    uint64_t resent;
+    uint64_t refused_offline;    // QoS 0 while disconnected
+    uint64_t refused_full;       // QoS 1 past the outbox cap
+    uint64_t expired;            // MQTT_EVENT_DELETED
+    uint64_t hub_messages;
+    uint64_t hub_queued;         // waited in the session for a reconnect
+    uint32_t outbox_high_water;  // bytes
+    size_t outbox_bytes;
+} sim_broker_stats_t;
+
+void sim_broker_get_stats(sim_broker_stats_t *out);
@@ -0,0 +1,341 @@
+#include "sim_hal.h"
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "ads1115.h"
+#include "aht10.h"
+#include "hardware_config.h"
+#include "i2c_bus.h"
+#include "sht4x.h"
+
+#define SHT4X_ADDRESS 0x44
+
+typedef struct {
+    int level;
+    gpio_mode_t mode;
+    gpio_int_type_t intr_type;
+    bool intr_enabled;
+    gpio_isr_t handler;
+    void *arg;
+} gpio_cell_t;
+
+static const sim_hal_world_t *s_world;
+static gpio_cell_t s_gpio[GPIO_NUM_MAX];
+static bool s_isr_service;
+static sim_hal_stats_t s_stats;
+
+static bool s_adc_running;
+static uint8_t s_adc_channel;
+static ads1115_data_rate_t s_adc_rate;
+static int64_t s_th_trigger_us = -1;
+
+void sim_hal_init(const sim_hal_world_t *world)
+{
+    s_world = world;
+    memset(s_gpio, 0, sizeof(s_gpio));
+    memset(&s_stats, 0, sizeof(s_stats));
+    s_isr_service = false;
+    s_adc_running = false;
+    s_th_trigger_us = -1;
+}
+
+void sim_hal_get_stats(sim_hal_stats_t *out)
+{
+    *out = s_stats;
+}
+
+static bool valid_gpio(gpio_num_t gpio)
+{
+    return gpio >= 0 && gpio < GPIO_NUM_MAX;
+}
+
+// The ADS1115 and the T/RH sensor sit on the switched sensor rail
+static bool rail_up(void)
+{
+    return s_gpio[SENSOR_EN_GPIO].level != 0;
+}
+
+// Conversion and transfer time, as the drivers' waits would take it
+static void spend_us(uint64_t us)
+{
+    vTaskDelay(pdMS_TO_TICKS((uint32_t)((us + 999) / 1000)));
+}
+
+// GPIO
+
+void sim_hal_drive_input(gpio_num_t gpio, int level)
+{
+    if (!valid_gpio(gpio)) {
+        return;
+    }
+    gpio_cell_t *cell = &s_gpio[gpio];
+    int old = cell->level;
+    cell->level = level ? 1 : 0;
+    if (old == cell->level || !cell->intr_enabled || !cell->handler || !s_isr_service) {
+        return;
+    }
+    bool fire = cell->intr_type == GPIO_INTR_ANYEDGE ||
+                (cell->intr_type == GPIO_INTR_NEGEDGE && cell->level == 0) ||
+                (cell->intr_type == GPIO_INTR_POSEDGE && cell->level == 1);
+    if (fire) {
+        s_stats.isr_calls++;
+        cell->handler(cell->arg);
+    }
+}
+
+int sim_hal_level(gpio_num_t gpio)
+{
+    return valid_gpio(gpio) ? s_gpio[gpio].level : 0;
+}
+
+esp_err_t gpio_config(const gpio_config_t *config)
+{
+    if (!config || config->pin_bit_mask == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (int gpio = 0; gpio < GPIO_NUM_MAX; ++gpio) {
+        if (config->pin_bit_mask & BIT64(gpio)) {
+            s_gpio[gpio].mode = config->mode;
+            s_gpio[gpio].intr_type = config->intr_type;
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_level(gpio_num_t gpio, uint32_t level)
+{
+    if (!valid_gpio(gpio)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    gpio_cell_t *cell = &s_gpio[gpio];
+    int next = level ? 1 : 0;
+    if (cell->mode != GPIO_MODE_OUTPUT && cell->mode != GPIO_MODE_INPUT_OUTPUT) {
+        return ESP_OK;   // the IDF latches it for later; nothing drives the pin
+    }
+    if (cell->level != next) {
+        cell->level = next;
+        if (s_world && s_world->output_changed) {
+            s_world->output_changed(gpio, next);
+        }
+    }
+    return ESP_OK;
+}
+
+int gpio_get_level(gpio_num_t gpio)
+{
+    return sim_hal_level(gpio);
+}
+
+esp_err_t gpio_set_intr_type(gpio_num_t gpio, gpio_int_type_t type)
+{
+    if (!valid_gpio(gpio)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_gpio[gpio].intr_type = type;
+    return ESP_OK;
+}
+
+esp_err_t gpio_intr_enable(gpio_num_t gpio)
+{
+    if (!valid_gpio(gpio)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_gpio[gpio].intr_enabled = true;
+    return ESP_OK;
+}
+
+esp_err_t gpio_intr_disable(gpio_num_t gpio)
+{
+    if (!valid_gpio(gpio)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_gpio[gpio].intr_enabled = false;
+    return ESP_OK;
+}
+
+esp_err_t gpio_install_isr_service(int flags)
+{
+    if (s_isr_service) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    s_isr_service = true;
+    return ESP_OK;
+}
+
+esp_err_t gpio_isr_handler_add(gpio_num_t gpio, gpio_isr_t handler, void *arg)
+{
+    if (!valid_gpio(gpio)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!s_isr_service) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    s_gpio[gpio].handler = handler;
+    s_gpio[gpio].arg = arg;
+    return ESP_OK;
+}
+
+// I2C bus: only probes are used once the drivers below stand in
+
+esp_err_t i2c_bus_init(void)
+{
+    return ESP_OK;
+}
+
+esp_err_t i2c_bus_probe(uint16_t address, int timeout_ms)
+{
+    if (!rail_up()) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    return address == SHT4X_ADDRESS || address == ADS1115_I2C_ADDRESS ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
+
+// ADS1115
+
+uint32_t ads1115_conversion_time_us(ads1115_data_rate_t rate)
+{
+    static const uint16_t sps[] = {8, 16, 32, 64, 128, 250, 475, 860};
+    return rate <= ADS1115_DR_860SPS ? (1000000u + sps[rate] - 1) / sps[rate] : 1000000u / 128;
+}
+
+esp_err_t ads1115_init(void)
+{
+    return rail_up() ? ESP_OK : ESP_ERR_TIMEOUT;
+}
+
+esp_err_t ads1115_set_ready_gpio(gpio_num_t rdy_gpio)
+{
+    return rdy_gpio == GPIO_NUM_NC ? ESP_OK : ESP_ERR_NOT_SUPPORTED;
+}
+
+static int16_t convert(uint8_t channel)
+{
+    s_stats.adc_conversions++;
+    return s_world && s_world->adc_counts ? s_world->adc_counts(channel) : 0;
+}
+
+esp_err_t ads1115_scan(const ads1115_scan_channel_t *channels, size_t channel_count,
+                       ads1115_data_rate_t rate, int16_t *out_samples, size_t *out_valid)
+{
+    if (!channels || !out_samples || !out_valid) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    size_t total = 0;
+    for (size_t i = 0; i < channel_count; ++i) {
+        total += channels[i].samples;
+    }
+    spend_us((uint64_t)total * ads1115_conversion_time_us(rate));
+    if (!rail_up()) {
+        memset(out_valid, 0, channel_count * sizeof(*out_valid));
+        return ESP_ERR_TIMEOUT;
+    }
+    size_t at = 0;
+    for (size_t i = 0; i < channel_count; ++i) {
+        for (size_t k = 0; k < channels[i].samples; ++k) {
+            out_samples[at++] = convert(channels[i].channel);
+        }
+        out_valid[i] = channels[i].samples;
+    }
+    return ESP_OK;
+}
+
+esp_err_t ads1115_continuous_start(uint8_t channel, ads1115_pga_t pga, ads1115_data_rate_t rate)
+{
+    if (!rail_up()) {
+        return ESP_ERR_TIMEOUT;
+    }
+    s_adc_running = true;
+    s_adc_channel = channel;
+    s_adc_rate = rate;
+    return ESP_OK;
+}
+
+esp_err_t ads1115_continuous_read(int16_t *out_counts)
+{
+    if (!s_adc_running || !out_counts) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    spend_us(ads1115_conversion_time_us(s_adc_rate));
+    if (!rail_up()) {
+        return ESP_ERR_TIMEOUT;
+    }
+    *out_counts = convert(s_adc_channel);
+    return ESP_OK;
+}
+
+esp_err_t ads1115_continuous_stop(void)
+{
+    s_adc_running = false;
+    return ESP_OK;
+}
+
+// SHT4x
+
+static esp_err_t sim_sht4x_init(void)
+{
+    return rail_up() ? ESP_OK : ESP_ERR_TIMEOUT;
+}
+
+static esp_err_t sim_sht4x_trigger(void)
+{
+    if (!rail_up()) {
+        return ESP_ERR_TIMEOUT;
+    }
+    s_th_trigger_us = esp_timer_get_time();
+    return ESP_OK;
+}
+
+static esp_err_t sim_sht4x_fetch(float *temperature_c, float *humidity_pct)
+{
+    if (s_th_trigger_us < 0) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    int64_t left_us = s_th_trigger_us + (int64_t)SHT4X_MEASURE_MS * 1000 - esp_timer_get_time();
+    s_th_trigger_us = -1;
+    if (left_us > 0) {
+        spend_us((uint64_t)left_us);
+    }
+    if (!rail_up()) {
+        return ESP_ERR_TIMEOUT;
+    }
+    s_stats.th_conversions++;
+    if (s_world && s_world->climate) {
+        s_world->climate(temperature_c, humidity_pct);
+    }
+    return ESP_OK;
+}
+
+const th_sensor_driver_t sht4x_driver = {
+    .name = "SHT4x",
+    .address = SHT4X_ADDRESS,
+    .conversion_ms = SHT4X_MEASURE_MS,
+    .init = sim_sht4x_init,
+    .trigger = sim_sht4x_trigger,
+    .fetch = sim_sht4x_fetch,
+};
+
+// The AHT10 is not fitted: i2c_bus_probe() never finds it
+
+static esp_err_t sim_aht10_absent(void)
+{
+    return ESP_ERR_NOT_FOUND;
+}
+
+static esp_err_t sim_aht10_fetch(float *temperature_c, float *humidity_pct)
+{
+    return ESP_ERR_NOT_FOUND;
+}
+
+const th_sensor_driver_t aht10_driver = {
+    .name = "AHT10",
+    .address = 0x38,
+    .conversion_ms = AHT10_MEASURE_MS,
+    .init = sim_aht10_absent,
+    .trigger = sim_aht10_absent,
+    .fetch = sim_aht10_fetch,
+};
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "driver/gpio.h"
+
+// Board I/O for the node simulator: GPIO cells, the I2C bus, the ADS1115 and
+// an SHT4x, in place of ads1115.c, i2c_bus.c, sht4x.c and aht10.c. The
+// plant model (node_sim.c) supplies the analog values, drives the float
+// inputs and hears about every output change. Conversions and transfers
+// take their datasheet time as task delays, so sampling shows up in the
+// schedule as it would on the device.
+
+typedef struct {
+    // After an output pin changed level; may call sim_hal_drive_input()
+    void (*output_changed)(gpio_num_t gpio, int level);
+    // Raw counts on an ADS1115 input, noise included
+    int16_t (*adc_counts)(uint8_t channel);
+    void (*climate)(float *temperature_c, float *humidity_pct);
+} sim_hal_world_t;
+
+void sim_hal_init(const sim_hal_world_t *world);
+
+// Set an input pin's level; an edge the pin's enabled interrupt matches runs
+// its ISR right there, in the caller's context
+void sim_hal_drive_input(gpio_num_t gpio, int level);
+int sim_hal_level(gpio_num_t gpio);
+
+typedef struct {
+    uint64_t adc_conversions;
+    uint64_t th_conversions;
+    uint64_t isr_calls;
+} sim_hal_stats_t;
+
+void sim_hal_get_stats(sim_hal_stats_t *out);
@@ -0,0 +1,303 @@
+#include "sim_platform.h"
+
+#include <string.h>
+#include <sys/time.h>
+
+#include "esp_timer.h"
+#include "esp_wifi.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "nvs_flash.h"
+
+#include "device_identity.h"
+#include "host_platform.h"
+#include "power_manager.h"
+#include "runtime_diag.h"
+#include "sim_rtos.h"
+#include "startup_onboarding.h"
+#include "time_sync.h"
+
+#define SIM_SNTP_PRIORITY 18          // lwIP's tcpip thread, which runs the SNTP client
+#define SIM_WIFI_RSSI (-58)
+
+static bool s_synced;
+static bool s_sntp_started;
+static time_sync_callback_t s_on_sync;
+static bool s_wifi_up;
+
+static char s_name[DEVICE_NAME_MAX_LEN] = "Sim Pot";
+static bool s_named = true;
+static sensor_mode_t s_sensor_mode = SENSOR_MODE_FULL;
+static payload_encoding_t s_encoding = PAYLOAD_ENCODING_JSON;
+
+static uint32_t s_wake_latency_ms;
+
+uint64_t sim_platform_epoch_ms(void)
+{
+    return SIM_EPOCH_MS + (uint64_t)(host_clock_now_us() / 1000);
+}
+
+bool sim_platform_time_synced(void)
+{
+    return s_synced;
+}
+
+// The libc clock: 1970 plus uptime until SNTP sets it, as on a node with no
+// saved time base (-Wl,--wrap=gettimeofday)
+int __wrap_gettimeofday(struct timeval *tv, void *tz)
+{
+    int64_t us = s_synced ? (int64_t)SIM_EPOCH_MS * 1000 + host_clock_now_us() : esp_timer_get_time();
+    tv->tv_sec = (time_t)(us / 1000000);
+    tv->tv_usec = (suseconds_t)(us % 1000000);
+    return 0;
+}
+
+// nvs_flash.h
+
+esp_err_t nvs_flash_init(void)
+{
+    return ESP_OK;
+}
+
+esp_err_t nvs_flash_erase(void)
+{
+    return ESP_OK;
+}
+
+// esp_wifi.h
+
+esp_err_t esp_wifi_sta_get_ap_info(wifi_ap_record_t *ap_info)
+{
+    if (!s_wifi_up) {
+        return ESP_ERR_INVALID_STATE;   // ESP_ERR_WIFI_NOT_CONNECT
+    }
+    ap_info->rssi = SIM_WIFI_RSSI;
+    return ESP_OK;
+}
+
+// startup_onboarding.c: stored credentials, the AP answers
+
+esp_err_t startup_onboarding_run(const char *device_id, const char *default_mqtt_uri, const char *fallback_ssid,
+                                 const char *fallback_password, startup_onboarding_state_t *out_state)
+{
+    vTaskDelay(pdMS_TO_TICKS(SIM_WIFI_ASSOC_MS));
+    s_wifi_up = true;
+    if (out_state) {
+        memset(out_state, 0, sizeof(*out_state));
+        out_state->wifi_connected = true;
+    }
+    return ESP_OK;
+}
+
+esp_err_t startup_onboarding_release(size_t *out_reclaimed_bytes)
+{
+    if (out_reclaimed_bytes) {
+        *out_reclaimed_bytes = 0;
+    }
+    return ESP_OK;
+}
+
+// time_sync.c: nothing saved, so the clock is invalid until SNTP answers
+
+static void sntp_task(void *arg)
+{
+    vTaskDelay(pdMS_TO_TICKS(SIM_SNTP_ANSWER_MS));
+    s_synced = true;
+    if (s_on_sync) {
+        s_on_sync();
+    }
+    vTaskDelete(NULL);
+}
+
+void time_sync_restore(void)
+{
+}
+
+esp_err_t time_sync_init(time_sync_callback_t on_sync)
+{
+    if (s_sntp_started) {
+        return ESP_OK;
+    }
+    s_sntp_started = true;
+    s_on_sync = on_sync;
+    return xTaskCreatePinnedToCore(sntp_task, "sntp", 2048, NULL, SIM_SNTP_PRIORITY, NULL, 0) == pdPASS
+        ? ESP_OK
+        : ESP_ERR_NO_MEM;
+}
+
+bool time_sync_is_time_valid(void)
+{
+    return s_synced;
+}
+
+bool time_sync_is_synced(void)
+{
+    return s_synced;
+}
+
+void time_sync_set_epoch_ms(uint64_t epoch_ms)
+{
+    s_synced = true;
+}
+
+uint64_t time_sync_boot_to_epoch_ms(uint64_t uptime_ms)
+{
+    return s_synced ? SIM_EPOCH_MS + uptime_ms : 0;
+}
+
+uint64_t time_sync_refine_epoch_ms(uint64_t epoch_ms, bool *estimated)
+{
+    if (estimated) {
+        *estimated = !s_synced;
+    }
+    return epoch_ms;
+}
+
+// device_identity.c
+
+void device_identity_init(void)
+{
+}
+
+const char *device_identity_id(void)
+{
+    return SIM_DEVICE_ID;
+}
+
+const char *device_identity_name(void)
+{
+    return s_name;
+}
+
+bool device_identity_is_named(void)
+{
+    return s_named;
+}
+
+esp_err_t device_identity_set_name(const char *name)
+{
+    if (!name || strlen(name) >= sizeof(s_name)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    strcpy(s_name, name);
+    s_named = name[0] != '\0';
+    return ESP_OK;
+}
+
+sensor_mode_t device_identity_sensor_mode(void)
+{
+    return s_sensor_mode;
+}
+
+const char *device_identity_sensor_mode_label(void)
+{
+    return s_sensor_mode == SENSOR_MODE_CONTROL_ONLY ? "control_only" : "full";
+}
+
+bool device_identity_sensors_enabled(void)
+{
+    return s_sensor_mode == SENSOR_MODE_FULL;
+}
+
+esp_err_t device_identity_set_sensor_mode(sensor_mode_t mode)
+{
+    if (mode != SENSOR_MODE_FULL && mode != SENSOR_MODE_CONTROL_ONLY) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_sensor_mode = mode;
+    return ESP_OK;
+}
+
+payload_encoding_t device_identity_payload_encoding(void)
+{
+    return s_encoding;
+}
+
+const char *device_identity_payload_encoding_label(void)
+{
+    return s_encoding == PAYLOAD_ENCODING_BINARY ? "binary" : "json";
+}
+
+esp_err_t device_identity_set_payload_encoding(payload_encoding_t encoding)
+{
+    if (encoding != PAYLOAD_ENCODING_JSON && encoding != PAYLOAD_ENCODING_BINARY) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_encoding = encoding;
+    return ESP_OK;
+}
+
+// power_manager.c: an always-on pot on mains power
+
+esp_err_t power_manager_init(void)
+{
+    return ESP_OK;
+}
+
+power_mode_t power_manager_mode(void)
+{
+    return POWER_MODE_ALWAYS_ON;
+}
+
+const char *power_manager_mode_label(void)
+{
+    return "always_on";
+}
+
+bool power_manager_woke_from_deep_sleep(void)
+{
+    return false;
+}
+
+void power_manager_network_ready(void)
+{
+}
+
+bool power_manager_retained_schedule(node_schedule_t *out_schedule)
+{
+    return false;
+}
+
+void power_manager_restore_outputs(void)
+{
+}
+
+void power_manager_note_wake_latency(uint32_t latency_ms)
+{
+    s_wake_latency_ms = latency_ms;
+}
+
+void power_manager_get_stats(power_stats_t *out_stats)
+{
+    if (out_stats) {
+        memset(out_stats, 0, sizeof(*out_stats));
+        out_stats->mode = POWER_MODE_ALWAYS_ON;
+        out_stats->wake_latency_ms = s_wake_latency_ms;
+    }
+}
+
+// runtime_diag.c: tasks are looked up in the simulator's kernel, which keeps
+// no run-time counters, stack watermarks (host stacks are oversized) or heap
+// figures; CPU use is in the NODE_SIM report instead
+
+void runtime_diag_collect(const char *const *task_names, size_t task_count, runtime_diag_t *out)
+{
+    memset(out, 0, sizeof(*out));
+    out->uptime_s = (uint32_t)(esp_timer_get_time() / 1000000);
+    out->mqtt_outbox_bytes = -1;
+    sim_task_stats_t tasks[32];
+    size_t n = sim_rtos_task_stats(tasks, sizeof(tasks) / sizeof(tasks[0]));
+    if (n > sizeof(tasks) / sizeof(tasks[0])) {
+        n = sizeof(tasks) / sizeof(tasks[0]);
+    }
+    out->task_count = task_count < RUNTIME_DIAG_TASK_MAX ? task_count : RUNTIME_DIAG_TASK_MAX;
+    for (size_t i = 0; i < out->task_count; ++i) {
+        out->tasks[i].name = task_names[i];
+        for (size_t k = 0; k < n; ++k) {
+            if (!tasks[k].deleted && strcmp(tasks[k].name, task_names[i]) == 0) {
+                out->tasks[i].found = true;
+                break;
+            }
+        }
+    }
+}
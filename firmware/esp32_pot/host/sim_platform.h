@@ -0,0 +1,19 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// The node simulator's stand-ins for the modules that talk to the radio, NVS
+// and the chip: onboarding, SNTP, identity, power management and the
+// runtime diag. Wi-Fi always associates, SNTP always answers, and the node
+// is a powered always-on pot with an empty NVS.
+
+#define SIM_EPOCH_MS 1767225600000ULL  // 2026-01-01 00:00 UTC at power-on
+#define SIM_WIFI_ASSOC_MS 1200         // startup_onboarding_run() on known credentials
+#define SIM_SNTP_ANSWER_MS 800         // time_sync_init() to the first answer
+#define SIM_DEVICE_ID "pot-sim"
+
+// Wall clock in epoch milliseconds, whatever the node believes
+uint64_t sim_platform_epoch_ms(void);
+// True once the simulated SNTP answered
+bool sim_platform_time_synced(void);
@@ -0,0 +1,890 @@
+#include "sim_rtos.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <ucontext.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/event_groups.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+#include "host_platform.h"
+
+#define SIM_TASKS_MAX 24
+#define SIM_QUEUES_MAX 48
+#define SIM_EVENT_GROUPS_MAX 8
+#define SIM_TIMERS_MAX 16
+#define SIM_TASK_NAME_LEN 16              // configMAX_TASK_NAME_LEN
+#define SIM_QUEUE_NAME_LEN 48
+#define SIM_HOST_STACK_BYTES (256 * 1024) // the device sizes are far too small for host frames
+#define SIM_SPIN_LIMIT 1000000            // task switches without the clock moving
+#define SIM_ESP_TIMER_PRIORITY 22         // ESP-IDF's esp_timer task
+#define SIM_NEVER INT64_MAX
+
+static const char *TAG = "sim_rtos";
+
+typedef enum {
+    TASK_FREE = 0,
+    TASK_READY,
+    TASK_RUNNING,
+    TASK_BLOCKED,
+    TASK_DELETED,
+} task_state_t;
+
+struct sim_task {
+    ucontext_t ctx;
+    void *stack;
+    char name[SIM_TASK_NAME_LEN];
+    UBaseType_t priority;
+    BaseType_t core;
+    uint32_t stack_bytes;
+    TaskFunction_t fn;
+    void *arg;
+    task_state_t state;
+    uint64_t ready_seq;        // FIFO among equal priorities
+    const void *waiting_on;    // object whose change wakes it; NULL for a plain delay
+    int64_t wake_us;           // host clock; SIM_NEVER waits for the object alone
+    bool timed_out;
+    uint32_t notify_value;
+    bool notify_pending;
+    uint64_t cpu_ns;
+    uint64_t runs;
+};
+
+struct sim_queue {
+    sim_queue_kind_t kind;
+    char name[SIM_QUEUE_NAME_LEN];
+    uint32_t length;
+    uint32_t item_size;
+    uint32_t count;            // items, or free tokens for semaphores
+    uint32_t head;
+    uint8_t *storage;
+    struct sim_queue *set;     // queue set this one belongs to
+    struct sim_task *owner;    // mutexes
+    uint32_t recursion;
+    uint32_t high_water;
+    uint64_t sends;
+    uint64_t full;
+    uint64_t overwrites;
+    uint64_t waits;
+};
+
+struct sim_event_group {
+    EventBits_t bits;
+};
+
+struct esp_timer {
+    esp_timer_cb_t callback;
+    void *arg;
+    const char *name;
+    int64_t deadline_us;       // host clock
+    uint64_t period_us;        // 0 for one-shot
+    bool armed;
+};
+
+static struct sim_task s_tasks[SIM_TASKS_MAX];
+static struct sim_queue s_queues[SIM_QUEUES_MAX];
+static size_t s_queue_count;
+static struct sim_event_group s_event_groups[SIM_EVENT_GROUPS_MAX];
+static size_t s_event_group_count;
+static struct esp_timer s_timers[SIM_TIMERS_MAX];
+static size_t s_timer_count;
+static const char s_timers_changed = 0;   // what the esp_timer task waits on
+
+static ucontext_t s_scheduler_ctx;
+static struct sim_task *s_current;
+static uint64_t s_ready_seq;
+static uint64_t s_spin;
+static uint64_t s_scheduler_ns;
+
+static uint64_t cpu_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static int64_t deadline_for(TickType_t ticks)
+{
+    return ticks == portMAX_DELAY ? SIM_NEVER : host_clock_now_us() + (int64_t)ticks * 1000;
+}
+
+static void make_ready(struct sim_task *task)
+{
+    task->state = TASK_READY;
+    task->waiting_on = NULL;
+    task->wake_us = SIM_NEVER;
+    task->timed_out = false;
+    task->ready_seq = ++s_ready_seq;
+}
+
+static void switch_to_scheduler(void)
+{
+    swapcontext(&s_current->ctx, &s_scheduler_ctx);
+}
+
+static void yield_current(void)
+{
+    make_ready(s_current);
+    switch_to_scheduler();
+}
+
+// Sleep until obj changes or the deadline passes; false on the deadline
+static bool block_until(const void *obj, int64_t deadline_us)
+{
+    if (deadline_us <= host_clock_now_us()) {
+        return false;
+    }
+    if (!s_current) {
+        ESP_LOGE(TAG, "blocking call outside a task");
+        abort();
+    }
+    struct sim_task *self = s_current;
+    self->state = TASK_BLOCKED;
+    self->waiting_on = obj;
+    self->wake_us = deadline_us;
+    self->timed_out = false;
+    switch_to_scheduler();
+    return !self->timed_out;
+}
+
+// Wake everything blocked on obj; true when one of them outranks the caller
+static bool wake_waiters(const void *obj)
+{
+    bool outranked = false;
+    for (size_t i = 0; i < SIM_TASKS_MAX; ++i) {
+        struct sim_task *task = &s_tasks[i];
+        if (task->state == TASK_BLOCKED && task->waiting_on == obj) {
+            make_ready(task);
+            if (!s_current || task->priority > s_current->priority) {
+                outranked = true;
+            }
+        }
+    }
+    return outranked;
+}
+
+// Preempt the caller, as a give or send from a task does; interrupts raised
+// by the simulator return to the scheduler by themselves
+static void preempt_if(bool outranked)
+{
+    if (outranked && s_current) {
+        yield_current();
+    }
+}
+
+// Tasks
+
+static void task_entry(void)
+{
+    struct sim_task *self = s_current;
+    self->fn(self->arg);
+    // ESP-IDF aborts when a task function returns
+    ESP_LOGE(TAG, "%s returned from its task function", self->name);
+    abort();
+}
+
+static struct sim_task *task_create(TaskFunction_t fn, const char *name, uint32_t stack_depth, void *arg,
+                                    UBaseType_t priority, BaseType_t core)
+{
+    struct sim_task *task = NULL;
+    for (size_t i = 0; i < SIM_TASKS_MAX; ++i) {
+        if (s_tasks[i].state == TASK_FREE) {
+            task = &s_tasks[i];
+            break;
+        }
+    }
+    if (!task) {
+        ESP_LOGE(TAG, "no room for task %s", name);
+        return NULL;
+    }
+    memset(task, 0, sizeof(*task));
+    task->stack = malloc(SIM_HOST_STACK_BYTES);
+    if (!task->stack) {
+        return NULL;
+    }
+    getcontext(&task->ctx);
+    task->ctx.uc_stack.ss_sp = task->stack;
+    task->ctx.uc_stack.ss_size = SIM_HOST_STACK_BYTES;
+    task->ctx.uc_link = NULL;
+    makecontext(&task->ctx, task_entry, 0);
+    snprintf(task->name, sizeof(task->name), "%s", name ? name : "");
+    task->priority = priority;
+    task->core = core;
+    task->stack_bytes = stack_depth;
+    task->fn = fn;
+    task->arg = arg;
+    make_ready(task);
+    preempt_if(s_current && priority > s_current->priority);
+    return task;
+}
+
+TaskHandle_t xTaskCreateStaticPinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack_depth, void *arg,
+                                           UBaseType_t priority, StackType_t *stack, StaticTask_t *tcb,
+                                           BaseType_t core)
+{
+    return task_create(fn, name, stack_depth, arg, priority, core);
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack_depth, void *arg,
+                                   UBaseType_t priority, TaskHandle_t *out_task, BaseType_t core)
+{
+    struct sim_task *task = task_create(fn, name, stack_depth, arg, priority, core);
+    if (out_task) {
+        *out_task = task;
+    }
+    return task ? pdPASS : pdFAIL;
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+    if (!task || task == s_current) {
+        s_current->state = TASK_DELETED;
+        switch_to_scheduler();   // never comes back; the scheduler frees the stack
+        return;
+    }
+    task->state = TASK_DELETED;
+    free(task->stack);
+    task->stack = NULL;
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    if (ticks == 0) {
+        taskYIELD();
+        return;
+    }
+    block_until(NULL, deadline_for(ticks));
+}
+
+void taskYIELD(void)
+{
+    if (s_current) {
+        yield_current();
+    }
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    return (TickType_t)(esp_timer_get_time() / 1000);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    return s_current;
+}
+
+const char *pcTaskGetName(TaskHandle_t task)
+{
+    task = task ? task : s_current;
+    return task ? task->name : "";
+}
+
+// Notifications
+
+static bool notify(TaskHandle_t task, uint32_t value, eNotifyAction action)
+{
+    switch (action) {
+    case eSetBits:
+        task->notify_value |= value;
+        break;
+    case eIncrement:
+        task->notify_value++;
+        break;
+    case eSetValueWithOverwrite:
+        task->notify_value = value;
+        break;
+    case eSetValueWithoutOverwrite:
+        if (task->notify_pending) {
+            return false;
+        }
+        task->notify_value = value;
+        break;
+    case eNoAction:
+    default:
+        break;
+    }
+    task->notify_pending = true;
+    return true;
+}
+
+BaseType_t xTaskNotify(TaskHandle_t task, uint32_t value, eNotifyAction action)
+{
+    if (!notify(task, value, action)) {
+        return pdFAIL;
+    }
+    preempt_if(wake_waiters(&task->notify_value));
+    return pdPASS;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+    return xTaskNotify(task, 0, eIncrement);
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *woken)
+{
+    notify(task, 0, eIncrement);
+    if (wake_waiters(&task->notify_value) && woken) {
+        *woken = pdTRUE;
+    }
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks)
+{
+    struct sim_task *self = s_current;
+    int64_t deadline_us = deadline_for(ticks);
+    while (self->notify_value == 0 && block_until(&self->notify_value, deadline_us)) {
+    }
+    uint32_t value = self->notify_value;
+    if (value > 0) {
+        self->notify_value = clear_on_exit ? 0 : value - 1;
+    }
+    self->notify_pending = false;
+    return value;
+}
+
+BaseType_t xTaskNotifyWait(uint32_t clear_on_entry, uint32_t clear_on_exit, uint32_t *out_value, TickType_t ticks)
+{
+    struct sim_task *self = s_current;
+    if (!self->notify_pending) {
+        self->notify_value &= ~clear_on_entry;
+    }
+    int64_t deadline_us = deadline_for(ticks);
+    while (!self->notify_pending && block_until(&self->notify_value, deadline_us)) {
+    }
+    if (out_value) {
+        *out_value = self->notify_value;
+    }
+    if (!self->notify_pending) {
+        return pdFALSE;
+    }
+    self->notify_value &= ~clear_on_exit;
+    self->notify_pending = false;
+    return pdTRUE;
+}
+
+// Queues, sets and semaphores
+
+QueueHandle_t sim_queue_create(sim_queue_kind_t kind, uint32_t length, uint32_t item_size, const char *name)
+{
+    if (s_queue_count == SIM_QUEUES_MAX || length == 0) {
+        return NULL;
+    }
+    struct sim_queue *queue = &s_queues[s_queue_count++];
+    memset(queue, 0, sizeof(*queue));
+    queue->kind = kind;
+    queue->length = length;
+    queue->item_size = item_size;
+    if (item_size > 0) {
+        queue->storage = calloc(length, item_size);
+    }
+    // "&lanes_ready_buf" -> "lanes_ready"; "../main/app_main.c:42" -> "app_main.c:42"
+    const char *base = strrchr(name, '/');
+    base = base ? base + 1 : name;
+    if (*base == '&') {
+        base++;
+    }
+    snprintf(queue->name, sizeof(queue->name), "%s", base);
+    size_t len = strlen(queue->name);
+    static const char *const suffixes[] = {"_storage", "_buf"};
+    for (size_t i = 0; i < sizeof(suffixes) / sizeof(suffixes[0]); ++i) {
+        size_t slen = strlen(suffixes[i]);
+        if (len > slen && strcmp(queue->name + len - slen, suffixes[i]) == 0) {
+            queue->name[len - slen] = '\0';
+            break;
+        }
+    }
+    if (kind == SIM_QUEUE_MUTEX || kind == SIM_QUEUE_RECURSIVE_MUTEX) {
+        queue->count = 1;
+    }
+    return queue;
+}
+
+QueueHandle_t sim_counting_create(uint32_t max, uint32_t initial, const char *name)
+{
+    struct sim_queue *queue = sim_queue_create(SIM_QUEUE_COUNTING, max, 0, name);
+    if (queue) {
+        queue->count = initial < max ? initial : max;
+    }
+    return queue;
+}
+
+void vQueueDelete(QueueHandle_t queue)
+{
+    // Slots are never reused; the report still lists it
+    (void)queue;
+}
+
+static void queue_push(struct sim_queue *queue, const void *item)
+{
+    if (queue->item_size > 0) {
+        uint32_t slot = (queue->head + queue->count) % queue->length;
+        memcpy(queue->storage + (size_t)slot * queue->item_size, item, queue->item_size);
+    }
+    queue->count++;
+    queue->sends++;
+    if (queue->count > queue->high_water) {
+        queue->high_water = queue->count;
+    }
+}
+
+static void queue_pop(struct sim_queue *queue, void *out_item)
+{
+    if (queue->item_size > 0 && out_item) {
+        memcpy(out_item, queue->storage + (size_t)queue->head * queue->item_size, queue->item_size);
+    }
+    queue->head = (queue->head + 1) % queue->length;
+    queue->count--;
+}
+
+// One set entry per item, as FreeRTOS posts them; true if a waiter outranks us
+static bool post_to_set(struct sim_queue *queue)
+{
+    struct sim_queue *set = queue->set;
+    if (!set) {
+        return false;
+    }
+    if (set->count == set->length) {
+        set->full++;
+        return false;
+    }
+    queue_push(set, &queue);
+    return wake_waiters(set);
+}
+
+static bool queue_wait(struct sim_queue *queue, int64_t deadline_us)
+{
+    queue->waits++;
+    return block_until(queue, deadline_us);
+}
+
+BaseType_t xQueueGenericSend(QueueHandle_t queue, const void *item, TickType_t ticks, BaseType_t overwrite)
+{
+    if (overwrite && queue->count == queue->length) {
+        // Length-one queues only: replace in place, nothing new to announce
+        memcpy(queue->storage + (size_t)queue->head * queue->item_size, item, queue->item_size);
+        queue->overwrites++;
+        return pdTRUE;
+    }
+    int64_t deadline_us = deadline_for(ticks);
+    while (queue->count == queue->length) {
+        if (!queue_wait(queue, deadline_us)) {
+            queue->full++;
+            return pdFALSE;
+        }
+    }
+    queue_push(queue, item);
+    bool outranked = post_to_set(queue);
+    outranked |= wake_waiters(queue);
+    preempt_if(outranked);
+    return pdTRUE;
+}
+
+BaseType_t xQueueSendFromISR(QueueHandle_t queue, const void *item, BaseType_t *woken)
+{
+    if (queue->count == queue->length) {
+        queue->full++;
+        return pdFALSE;
+    }
+    queue_push(queue, item);
+    bool outranked = post_to_set(queue);
+    outranked |= wake_waiters(queue);
+    if (outranked && woken) {
+        *woken = pdTRUE;
+    }
+    return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *out_item, TickType_t ticks)
+{
+    int64_t deadline_us = deadline_for(ticks);
+    while (queue->count == 0) {
+        if (!queue_wait(queue, deadline_us)) {
+            return pdFALSE;
+        }
+    }
+    queue_pop(queue, out_item);
+    preempt_if(wake_waiters(queue));
+    return pdTRUE;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue)
+{
+    return queue->count;
+}
+
+BaseType_t xQueueAddToSet(QueueSetMemberHandle_t member, QueueSetHandle_t set)
+{
+    if (!member || !set || member->set || member->count > 0) {
+        return pdFAIL;
+    }
+    member->set = set;
+    return pdPASS;
+}
+
+QueueSetMemberHandle_t xQueueSelectFromSet(QueueSetHandle_t set, TickType_t ticks)
+{
+    struct sim_queue *member = NULL;
+    return xQueueReceive(set, &member, ticks) == pdTRUE ? member : NULL;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks)
+{
+    int64_t deadline_us = deadline_for(ticks);
+    while (sem->count == 0) {
+        if (!queue_wait(sem, deadline_us)) {
+            return pdFALSE;
+        }
+    }
+    sem->count--;
+    if (sem->kind == SIM_QUEUE_MUTEX || sem->kind == SIM_QUEUE_RECURSIVE_MUTEX) {
+        sem->owner = s_current;
+        sem->recursion = 1;
+        sem->sends++;
+    }
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem)
+{
+    if (sem->kind == SIM_QUEUE_MUTEX || sem->kind == SIM_QUEUE_RECURSIVE_MUTEX) {
+        if (sem->owner != s_current || sem->count > 0) {
+            return pdFALSE;
+        }
+        sem->owner = NULL;
+        sem->recursion = 0;
+        sem->count = 1;
+        preempt_if(wake_waiters(sem));
+        return pdTRUE;
+    }
+    if (sem->count == sem->length) {
+        sem->full++;
+        return pdFALSE;
+    }
+    queue_push(sem, NULL);
+    bool outranked = post_to_set(sem);
+    outranked |= wake_waiters(sem);
+    preempt_if(outranked);
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t sem, BaseType_t *woken)
+{
+    if (sem->count == sem->length) {
+        sem->full++;
+        return pdFALSE;
+    }
+    queue_push(sem, NULL);
+    bool outranked = post_to_set(sem);
+    outranked |= wake_waiters(sem);
+    if (outranked && woken) {
+        *woken = pdTRUE;
+    }
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t sem, TickType_t ticks)
+{
+    if (sem->owner && sem->owner == s_current) {
+        sem->recursion++;
+        return pdTRUE;
+    }
+    return xSemaphoreTake(sem, ticks);
+}
+
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t sem)
+{
+    if (sem->owner != s_current) {
+        return pdFALSE;
+    }
+    if (--sem->recursion > 0) {
+        return pdTRUE;
+    }
+    return xSemaphoreGive(sem);
+}
+
+// Event groups
+
+EventGroupHandle_t xEventGroupCreate(void)
+{
+    if (s_event_group_count == SIM_EVENT_GROUPS_MAX) {
+        return NULL;
+    }
+    struct sim_event_group *group = &s_event_groups[s_event_group_count++];
+    group->bits = 0;
+    return group;
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits)
+{
+    group->bits |= bits;
+    EventBits_t now = group->bits;
+    preempt_if(wake_waiters(group));
+    return now;
+}
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t group, EventBits_t bits)
+{
+    EventBits_t before = group->bits;
+    group->bits &= ~bits;
+    return before;
+}
+
+EventBits_t xEventGroupGetBits(EventGroupHandle_t group)
+{
+    return group->bits;
+}
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits, BaseType_t clear_on_exit,
+                                BaseType_t wait_for_all, TickType_t ticks)
+{
+    int64_t deadline_us = deadline_for(ticks);
+    while (true) {
+        EventBits_t now = group->bits;
+        bool met = wait_for_all ? (now & bits) == bits : (now & bits) != 0;
+        if (met) {
+            if (clear_on_exit) {
+                group->bits &= ~bits;
+            }
+            return now;
+        }
+        if (!block_until(group, deadline_us)) {
+            return group->bits;
+        }
+    }
+}
+
+// esp_timer
+
+static void esp_timer_task(void *arg)
+{
+    while (true) {
+        struct esp_timer *due = NULL;
+        int64_t next_us = SIM_NEVER;
+        for (size_t i = 0; i < s_timer_count; ++i) {
+            if (s_timers[i].armed && s_timers[i].deadline_us < next_us) {
+                next_us = s_timers[i].deadline_us;
+                due = &s_timers[i];
+            }
+        }
+        if (due && next_us <= host_clock_now_us()) {
+            if (due->period_us > 0) {
+                due->deadline_us += (int64_t)due->period_us;
+            } else {
+                due->armed = false;
+            }
+            due->callback(due->arg);
+            continue;
+        }
+        block_until(&s_timers_changed, next_us);
+    }
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *out_handle)
+{
+    if (!args || !args->callback || !out_handle) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_timer_count == SIM_TIMERS_MAX) {
+        return ESP_ERR_NO_MEM;
+    }
+    struct esp_timer *timer = &s_timers[s_timer_count++];
+    timer->callback = args->callback;
+    timer->arg = args->arg;
+    timer->name = args->name;
+    timer->armed = false;
+    *out_handle = timer;
+    return ESP_OK;
+}
+
+static esp_err_t timer_start(esp_timer_handle_t timer, uint64_t timeout_us, uint64_t period_us)
+{
+    if (!timer) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (timer->armed) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    timer->deadline_us = host_clock_now_us() + (int64_t)timeout_us;
+    timer->period_us = period_us;
+    timer->armed = true;
+    preempt_if(wake_waiters(&s_timers_changed));
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us)
+{
+    return timer_start(timer, timeout_us, 0);
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period_us)
+{
+    return timer_start(timer, period_us, period_us);
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer)
+{
+    if (!timer) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!timer->armed) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    timer->armed = false;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer)
+{
+    if (!timer) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (timer->armed) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    timer->callback = NULL;
+    return ESP_OK;
+}
+
+bool esp_timer_is_active(esp_timer_handle_t timer)
+{
+    return timer && timer->armed;
+}
+
+// Scheduler
+
+void sim_rtos_init(void)
+{
+    xTaskCreatePinnedToCore(esp_timer_task, "esp_timer", 3584, NULL, SIM_ESP_TIMER_PRIORITY, NULL, 0);
+}
+
+static struct sim_task *next_ready(void)
+{
+    struct sim_task *best = NULL;
+    for (size_t i = 0; i < SIM_TASKS_MAX; ++i) {
+        struct sim_task *task = &s_tasks[i];
+        if (task->state != TASK_READY) {
+            continue;
+        }
+        if (!best || task->priority > best->priority ||
+            (task->priority == best->priority && task->ready_seq < best->ready_seq)) {
+            best = task;
+        }
+    }
+    return best;
+}
+
+static void run_task(struct sim_task *task)
+{
+    if (++s_spin > SIM_SPIN_LIMIT) {
+        ESP_LOGE(TAG, "%s keeps running without the clock moving (a busy wait?)", task->name);
+        abort();
+    }
+    s_current = task;
+    task->state = TASK_RUNNING;
+    task->runs++;
+    uint64_t start_ns = cpu_now_ns();
+    swapcontext(&s_scheduler_ctx, &task->ctx);
+    task->cpu_ns += cpu_now_ns() - start_ns;
+    s_current = NULL;
+    if (task->state == TASK_DELETED && task->stack) {
+        free(task->stack);
+        task->stack = NULL;
+    }
+}
+
+void sim_rtos_run_until(int64_t until_us, sim_rtos_stop_fn_t stop_fn)
+{
+    uint64_t start_ns = cpu_now_ns();
+    uint64_t task_ns = 0;
+    while (true) {
+        struct sim_task *task = next_ready();
+        if (task) {
+            uint64_t before = task->cpu_ns;
+            run_task(task);
+            task_ns += task->cpu_ns - before;
+            if (stop_fn && stop_fn()) {
+                break;
+            }
+            continue;
+        }
+        int64_t wake_us = SIM_NEVER;
+        for (size_t i = 0; i < SIM_TASKS_MAX; ++i) {
+            if (s_tasks[i].state == TASK_BLOCKED && s_tasks[i].wake_us < wake_us) {
+                wake_us = s_tasks[i].wake_us;
+            }
+        }
+        int64_t now_us = host_clock_now_us();
+        if (wake_us > until_us) {
+            host_clock_advance_us(until_us - now_us);
+            break;
+        }
+        host_clock_advance_us(wake_us - now_us);
+        s_spin = 0;
+        for (size_t i = 0; i < SIM_TASKS_MAX; ++i) {
+            struct sim_task *blocked = &s_tasks[i];
+            if (blocked->state == TASK_BLOCKED && blocked->wake_us <= wake_us) {
+                make_ready(blocked);
+                blocked->timed_out = true;
+            }
+        }
+    }
+    s_scheduler_ns += cpu_now_ns() - start_ns - task_ns;
+}
+
+bool sim_rtos_in_task(void)
+{
+    return s_current != NULL;
+}
+
+uint64_t sim_rtos_scheduler_ns(void)
+{
+    return s_scheduler_ns;
+}
+
+size_t sim_rtos_task_stats(sim_task_stats_t *out, size_t cap)
+{
+    size_t n = 0;
+    for (size_t i = 0; i < SIM_TASKS_MAX; ++i) {
+        const struct sim_task *task = &s_tasks[i];
+        if (task->state == TASK_FREE) {
+            continue;
+        }
+        if (n < cap) {
+            out[n] = (sim_task_stats_t){
+                .name = task->name,
+                .priority = task->priority,
+                .core = task->core,
+                .stack_bytes = task->stack_bytes,
+                .cpu_ns = task->cpu_ns,
+                .runs = task->runs,
+                .deleted = task->state == TASK_DELETED,
+            };
+        }
+        n++;
+    }
+    return n;
+}
+
+size_t sim_rtos_queue_stats(sim_queue_stats_t *out, size_t cap)
+{
+    for (size_t i = 0; i < s_queue_count && i < cap; ++i) {
+        const struct sim_queue *queue = &s_queues[i];
+        out[i] = (sim_queue_stats_t){
+            .name = queue->name,
+            .kind = queue->kind,
+            .length = queue->length,
+            .high_water = queue->high_water,
+            .sends = queue->sends,
+            .full = queue->full,
+            .overwrites = queue->overwrites,
+            .waits = queue->waits,
+        };
+    }
+    return s_queue_count;
+}
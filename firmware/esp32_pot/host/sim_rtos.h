@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+
+// The FreeRTOS kernel and esp_timer for the node simulator, in virtual time.
+// Every task is a ucontext coroutine on the one host thread. The highest
+// priority ready task runs until it blocks; a give, send or notify that
+// readies a higher-priority task switches to it on the spot, as the
+// single-core scheduler would. Task bodies take no simulated time: the clock
+// (host_platform.h) only moves once every task is blocked, and then jumps
+// straight to the next wake-up, so a day of mostly idle firmware runs in
+// well under a second.
+//
+// Both cores are folded onto one. Tasks keep their pinning for the report
+// but never run side by side, and mutexes have no priority inheritance.
+
+// Creates the esp_timer task; call once before any other API
+void sim_rtos_init(void);
+
+// Run tasks and timers until host_clock_now_us() reaches until_us. Returns
+// early, leaving the clock where it is, once stop_fn() says so after a task
+// ran; NULL never stops early.
+typedef bool (*sim_rtos_stop_fn_t)(void);
+void sim_rtos_run_until(int64_t until_us, sim_rtos_stop_fn_t stop_fn);
+
+typedef struct {
+    const char *name;
+    UBaseType_t priority;
+    BaseType_t core;           // tskNO_AFFINITY when unpinned
+    uint32_t stack_bytes;      // as requested on the device
+    uint64_t cpu_ns;           // host CPU time inside the task body
+    uint64_t runs;             // times it was switched in
+    bool deleted;
+} sim_task_stats_t;
+
+typedef struct {
+    const char *name;          // storage buffer or creating call site
+    sim_queue_kind_t kind;
+    uint32_t length;
+    uint32_t high_water;       // most items ever waiting
+    uint64_t sends;            // items or gives accepted; mutex takes
+    uint64_t full;             // sends and gives refused for want of room
+    uint64_t overwrites;       // xQueueOverwrite() that replaced an item
+    uint64_t waits;            // times a task blocked on it
+} sim_queue_stats_t;
+
+// Both return how many entries exist, filling at most cap of them
+size_t sim_rtos_task_stats(sim_task_stats_t *out, size_t cap);
+size_t sim_rtos_queue_stats(sim_queue_stats_t *out, size_t cap);
+
+// Host CPU time spent outside task bodies: picking tasks, advancing the
+// clock and context switches
+uint64_t sim_rtos_scheduler_ns(void);
+
+// True while a task body runs, false in the simulator's own context (where
+// the plant model raises interrupts); blocking calls are only legal in a task
+bool sim_rtos_in_task(void);
@@ -0,0 +1,6 @@
+#pragma once
+
+// Host stand-in for ESP-IDF's driver/i2c_master.h: only the handle type
+// i2c_bus.h exposes. The simulator mocks the bus one level up (sim_hal.c).
+
+typedef struct i2c_master_dev_t *i2c_master_dev_handle_t;
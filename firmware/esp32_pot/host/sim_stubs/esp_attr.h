@@ -0,0 +1,9 @@
+#pragma once
+
+// Host stand-in for ESP-IDF's esp_attr.h: placement attributes do nothing,
+// and "RTC memory" is ordinary memory that a simulated reboot keeps
+
+#define IRAM_ATTR
+#define DRAM_ATTR
+#define RTC_DATA_ATTR
+#define RTC_NOINIT_ATTR
@@ -0,0 +1,53 @@
+#pragma once
+
+// FreeRTOS types for the node simulator (node_sim.c). Unlike stubs/freertos
+// there is a scheduler behind these: sim_rtos.c runs every task as a
+// coroutine on one host thread, in virtual time.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_attr.h"
+#include "esp_bit_defs.h"
+#include "sdkconfig.h"   // as the IDF headers pull it in
+
+typedef int32_t BaseType_t;
+typedef uint32_t UBaseType_t;
+typedef uint32_t TickType_t;
+typedef uint8_t StackType_t;   // ESP-IDF counts stacks in bytes
+
+#define pdFALSE ((BaseType_t)0)
+#define pdTRUE ((BaseType_t)1)
+#define pdPASS pdTRUE
+#define pdFAIL pdFALSE
+
+#define portMAX_DELAY ((TickType_t)0xffffffffUL)
+#define configTICK_RATE_HZ 1000
+#define configMAX_PRIORITIES 25
+#define portTICK_PERIOD_MS ((TickType_t)1000 / configTICK_RATE_HZ)
+#define pdMS_TO_TICKS(ms) ((TickType_t)(((TickType_t)(ms) * (TickType_t)configTICK_RATE_HZ) / (TickType_t)1000U))
+
+// The memory the static creators are handed; sim_rtos.c keeps its own
+// objects and only remembers which one a buffer stands for
+typedef struct {
+    void *sim_object;
+} StaticTask_t, StaticQueue_t, StaticSemaphore_t, StaticEventGroup_t;
+
+// One host thread and no preemption inside a task body: critical sections
+// have nothing to exclude
+typedef struct {
+    int unused;
+} portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED {0}
+#define taskENTER_CRITICAL(mux) ((void)(mux))
+#define taskEXIT_CRITICAL(mux) ((void)(mux))
+#define taskENTER_CRITICAL_ISR(mux) ((void)(mux))
+#define taskEXIT_CRITICAL_ISR(mux) ((void)(mux))
+#define portENTER_CRITICAL(mux) ((void)(mux))
+#define portEXIT_CRITICAL(mux) ((void)(mux))
+#define portENTER_CRITICAL_ISR(mux) ((void)(mux))
+#define portEXIT_CRITICAL_ISR(mux) ((void)(mux))
+
+// Interrupts are raised by the simulator between task runs; the scheduler
+// picks the highest-priority ready task as soon as the ISR returns
+#define portYIELD_FROM_ISR(...) ((void)0)
@@ -0,0 +1,42 @@
+#pragma once
+
+// FreeRTOS queues and queue sets on sim_rtos.c. The creators are macros so
+// the report can name each queue after its storage buffer or call site.
+
+#include "freertos/FreeRTOS.h"
+
+typedef struct sim_queue *QueueHandle_t;
+typedef struct sim_queue *QueueSetHandle_t;
+typedef struct sim_queue *QueueSetMemberHandle_t;
+
+#define SIM_STRINGIFY_(x) #x
+#define SIM_STRINGIFY(x) SIM_STRINGIFY_(x)
+#define SIM_CALL_SITE __FILE__ ":" SIM_STRINGIFY(__LINE__)
+
+typedef enum {
+    SIM_QUEUE_PLAIN = 0,
+    SIM_QUEUE_SET,
+    SIM_QUEUE_MUTEX,
+    SIM_QUEUE_RECURSIVE_MUTEX,
+    SIM_QUEUE_BINARY,
+    SIM_QUEUE_COUNTING,
+} sim_queue_kind_t;
+
+QueueHandle_t sim_queue_create(sim_queue_kind_t kind, uint32_t length, uint32_t item_size, const char *name);
+
+#define xQueueCreate(length, item_size) sim_queue_create(SIM_QUEUE_PLAIN, (length), (item_size), SIM_CALL_SITE)
+#define xQueueCreateStatic(length, item_size, storage, queue) \
+    ((void)(queue), (void)(storage), sim_queue_create(SIM_QUEUE_PLAIN, (length), (item_size), #storage))
+#define xQueueCreateSet(length) sim_queue_create(SIM_QUEUE_SET, (length), sizeof(void *), SIM_CALL_SITE)
+void vQueueDelete(QueueHandle_t queue);
+
+BaseType_t xQueueGenericSend(QueueHandle_t queue, const void *item, TickType_t ticks, BaseType_t overwrite);
+#define xQueueSend(queue, item, ticks) xQueueGenericSend((queue), (item), (ticks), pdFALSE)
+#define xQueueSendToBack(queue, item, ticks) xQueueGenericSend((queue), (item), (ticks), pdFALSE)
+#define xQueueOverwrite(queue, item) xQueueGenericSend((queue), (item), 0, pdTRUE)
+BaseType_t xQueueSendFromISR(QueueHandle_t queue, const void *item, BaseType_t *woken);
+BaseType_t xQueueReceive(QueueHandle_t queue, void *out_item, TickType_t ticks);
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue);
+
+BaseType_t xQueueAddToSet(QueueSetMemberHandle_t member, QueueSetHandle_t set);
+QueueSetMemberHandle_t xQueueSelectFromSet(QueueSetHandle_t set, TickType_t ticks);
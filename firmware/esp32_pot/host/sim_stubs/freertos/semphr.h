@@ -0,0 +1,24 @@
+#pragma once
+
+// FreeRTOS semaphores and mutexes on sim_rtos.c: queues of zero-size items,
+// as in FreeRTOS itself. Mutexes have no priority inheritance here.
+
+#include "freertos/queue.h"
+
+typedef QueueHandle_t SemaphoreHandle_t;
+
+#define xSemaphoreCreateMutex() sim_queue_create(SIM_QUEUE_MUTEX, 1, 0, SIM_CALL_SITE)
+#define xSemaphoreCreateMutexStatic(buf) ((void)(buf), sim_queue_create(SIM_QUEUE_MUTEX, 1, 0, #buf))
+#define xSemaphoreCreateRecursiveMutex() sim_queue_create(SIM_QUEUE_RECURSIVE_MUTEX, 1, 0, SIM_CALL_SITE)
+#define xSemaphoreCreateRecursiveMutexStatic(buf) ((void)(buf), sim_queue_create(SIM_QUEUE_RECURSIVE_MUTEX, 1, 0, #buf))
+#define xSemaphoreCreateBinary() sim_queue_create(SIM_QUEUE_BINARY, 1, 0, SIM_CALL_SITE)
+#define xSemaphoreCreateBinaryStatic(buf) ((void)(buf), sim_queue_create(SIM_QUEUE_BINARY, 1, 0, #buf))
+#define xSemaphoreCreateCounting(max, initial) sim_counting_create((max), (initial), SIM_CALL_SITE)
+QueueHandle_t sim_counting_create(uint32_t max, uint32_t initial, const char *name);
+#define vSemaphoreDelete(sem) vQueueDelete(sem)
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem);
+BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t sem, BaseType_t *woken);
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t sem, TickType_t ticks);
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t sem);
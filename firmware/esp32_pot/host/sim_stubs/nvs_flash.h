@@ -0,0 +1,11 @@
+#pragma once
+
+// Host stand-in for ESP-IDF's nvs_flash.h; preferences live in RAM (sim_platform.c)
+
+#include "nvs.h"
+
+#define ESP_ERR_NVS_NO_FREE_PAGES (ESP_ERR_NVS_BASE + 0x0d)
+#define ESP_ERR_NVS_NEW_VERSION_FOUND (ESP_ERR_NVS_BASE + 0x10)
+
+esp_err_t nvs_flash_init(void);
+esp_err_t nvs_flash_erase(void);
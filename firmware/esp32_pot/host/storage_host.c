@@ -0,0 +1,19 @@
+// storage.c built for the host, plus a way to reset its file-scope state
+// between simulated boots. Including it keeps main/storage.c unchanged.
+#include "../main/storage.c"
+
+#include "storage_host.h"
+
+void storage_host_forget(void)
+{
+    s_file = NULL;
+    memset(&s_header, 0, sizeof(s_header));
+    s_ready = false;
+    s_batch_count = 0;
+    s_blank_to_seq = 0;
+    s_batch_since_us = 0;
+    s_unsynced_entries = 0;
+    s_header_synced_us = 0;
+    s_head_key_valid = false;
+    s_read_key_valid = false;
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+#include "storage.h"
+
+// Drop everything the ring backend (storage.c, or storage_raw.c with
+// BACKEND=partition) holds in RAM, as a reboot would, so the next
+// storage_init() starts from what is on flash. The stream is not closed:
+// after a power loss host_flash_recover() does that, after a clean restart
+// esp_vfs_littlefs_unregister() does.
+void storage_host_forget(void);
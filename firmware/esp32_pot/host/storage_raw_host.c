@@ -0,0 +1,17 @@
+// storage_raw.c built for the host, plus a way to reset its file-scope state
+// between simulated boots. Including it keeps main/storage_raw.c unchanged.
+#include "../main/storage_raw.c"
+
+#include "storage_host.h"
+
+void storage_host_forget(void)
+{
+    s_part = NULL;
+    s_ready = false;
+    s_sector_count = 0;
+    s_head_seq = 0;
+    s_head_sector_seq = 0;
+    s_tail_seq = 0;
+    s_tail_durable = true;
+    s_retained_seq = 0;
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+// Host stand-in for ESP-IDF's esp_crc.h. The ROM routines invert the running
+// value on entry and exit, so chained calls match one call over the whole
+// buffer; host_platform.c does the same bitwise.
+
+#include <stdint.h>
+
+uint32_t esp_crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len);
+uint16_t esp_crc16_le(uint16_t crc, const uint8_t *buf, uint32_t len);
@@ -0,0 +1,55 @@
+#pragma once
+
+// Host stand-in for esp_littlefs.h, backed by littlefs on an lfs_emubd
+// emulated flash (host_flash.c). Only the calls the pot firmware makes are
+// provided.
+//
+// Files under the mount point are reached through stdio, as on the device:
+// after this header fopen(), fileno(), fsync() and ftruncate() resolve to
+// host_flash versions that serve littlefs files through fopencookie() and
+// fall through to the host C library for every other path. Include it after
+// stdio.h and unistd.h, as the firmware does.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "esp_err.h"
+
+typedef struct {
+    const char *base_path;
+    const char *partition_label;
+    const void *partition;            // unused on the host
+    uint8_t format_if_mount_failed:1;
+    uint8_t read_only : 1;
+    uint8_t dont_mount:1;
+    uint8_t grow_on_mount:1;
+} esp_vfs_littlefs_conf_t;
+
+typedef struct {
+    uint64_t flash_bytes_programmed;
+    uint32_t flash_progs;
+    uint32_t flash_erases;
+    uint32_t erases_skipped;          // always 0: there is no pre-erase on the host
+} esp_littlefs_write_stats_t;
+
+esp_err_t esp_vfs_littlefs_register(const esp_vfs_littlefs_conf_t *conf);
+esp_err_t esp_vfs_littlefs_unregister(const char *partition_label);
+bool esp_littlefs_mounted(const char *partition_label);
+esp_err_t esp_littlefs_format(const char *partition_label);
+esp_err_t esp_littlefs_info(const char *partition_label, size_t *total_bytes, size_t *used_bytes);
+esp_err_t esp_littlefs_write_stats(const char *partition_label, esp_littlefs_write_stats_t *stats);
+esp_err_t esp_littlefs_write_stats_reset(const char *partition_label);
+
+FILE *host_flash_fopen(const char *path, const char *mode);
+int host_flash_fileno(FILE *stream);
+int host_flash_fsync(int fd);
+int host_flash_ftruncate(int fd, off_t length);
+
+#define fopen host_flash_fopen
+#define fileno host_flash_fileno
+#define fsync host_flash_fsync
+#define ftruncate host_flash_ftruncate
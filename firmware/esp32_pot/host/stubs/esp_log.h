@@ -0,0 +1,48 @@
+#pragma once
+
+// Host stand-in for ESP-IDF's esp_log.h. Lines go to stderr when their level
+// is at or below host_log_level (ESP_LOG_WARN unless the harness changes it).
+//
+// Once something installs a hook with esp_log_set_vprintf(), lines up to
+// ESP_LOG_INFO (the device's default level) reach it in the device's format,
+// "W (<uptime ms>) tag: text\n"; the function esp_log_set_vprintf() returns
+// is the stderr path above.
+
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+
+typedef enum {
+    ESP_LOG_NONE,
+    ESP_LOG_ERROR,
+    ESP_LOG_WARN,
+    ESP_LOG_INFO,
+    ESP_LOG_DEBUG,
+    ESP_LOG_VERBOSE,
+} esp_log_level_t;
+
+typedef int (*vprintf_like_t)(const char *format, va_list args);
+
+extern esp_log_level_t host_log_level;
+extern vprintf_like_t host_log_hook;
+
+vprintf_like_t esp_log_set_vprintf(vprintf_like_t func);
+uint32_t esp_log_timestamp(void);
+void host_log_write(esp_log_level_t level, const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+#define HOST_LOG(level, letter, tag, format, ...)                                                     \
+    do {                                                                                               \
+        if (host_log_hook && (level) <= ESP_LOG_INFO) {                                                \
+            host_log_write(level, letter " (%" PRIu32 ") %s: " format "\n", esp_log_timestamp(), tag, \
+                           ##__VA_ARGS__);                                                             \
+        } else if (host_log_level >= (level)) {                                                        \
+            fprintf(stderr, letter " (%s) " format "\n", tag, ##__VA_ARGS__);                          \
+        }                                                                                              \
+    } while (0)
+
+#define ESP_LOGE(tag, format, ...) HOST_LOG(ESP_LOG_ERROR, "E", tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) HOST_LOG(ESP_LOG_WARN, "W", tag, format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...) HOST_LOG(ESP_LOG_INFO, "I", tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...) HOST_LOG(ESP_LOG_DEBUG, "D", tag, format, ##__VA_ARGS__)
+#define ESP_LOGV(tag, format, ...) HOST_LOG(ESP_LOG_VERBOSE, "V", tag, format, ##__VA_ARGS__)
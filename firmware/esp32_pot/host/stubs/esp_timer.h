@@ -0,0 +1,8 @@
+#pragma once
+
+// Host stand-in for ESP-IDF's esp_timer.h: microseconds since the simulated
+// boot, driven by host_clock_advance_us() (host_platform.h)
+
+#include <stdint.h>
+
+int64_t esp_timer_get_time(void);
@@ -0,0 +1,30 @@
+#pragma once
+
+// Host stand-in for FreeRTOS semaphores. With a single thread a take always
+// succeeds; the handle only has to be non-NULL.
+
+#include "freertos/FreeRTOS.h"
+
+typedef struct host_semaphore *SemaphoreHandle_t;
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void);
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex(void);
+#define xSemaphoreCreateMutexStatic(buf) ((void)(buf), xSemaphoreCreateMutex())
+#define xSemaphoreCreateRecursiveMutexStatic(buf) ((void)(buf), xSemaphoreCreateRecursiveMutex())
+void vSemaphoreDelete(SemaphoreHandle_t sem);
+
+static inline BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks)
+{
+    (void)sem;
+    (void)ticks;
+    return pdTRUE;
+}
+
+static inline BaseType_t xSemaphoreGive(SemaphoreHandle_t sem)
+{
+    (void)sem;
+    return pdTRUE;
+}
+
+#define xSemaphoreTakeRecursive(sem, ticks) xSemaphoreTake(sem, ticks)
+#define xSemaphoreGiveRecursive(sem) xSemaphoreGive(sem)
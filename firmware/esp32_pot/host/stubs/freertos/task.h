@@ -0,0 +1,43 @@
+#pragma once
+
+// Host stand-in for the FreeRTOS task API the pot modules touch outside
+// their task bodies. Notifications go nowhere: nothing waits on them. A
+// created task never runs; the harness calls its work itself.
+
+#include "freertos/FreeRTOS.h"
+
+typedef struct host_task *TaskHandle_t;
+typedef void (*TaskFunction_t)(void *arg);
+
+// The handle only has to be non-NULL and stable: the TCB buffer stands in
+static inline TaskHandle_t xTaskCreateStaticPinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack_depth,
+                                                         void *arg, UBaseType_t priority, StackType_t *stack,
+                                                         StaticTask_t *tcb, BaseType_t core)
+{
+    (void)fn;
+    (void)name;
+    (void)stack_depth;
+    (void)arg;
+    (void)priority;
+    (void)stack;
+    (void)core;
+    return (TaskHandle_t)(void *)tcb;
+}
+
+static inline TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    return NULL;
+}
+
+static inline BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+    (void)task;
+    return pdPASS;
+}
+
+static inline uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks)
+{
+    (void)clear_on_exit;
+    (void)ticks;
+    return 0;
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+// Host stand-in for the generated sdkconfig.h. Defaults follow
+// firmware/esp32_pot/sdkconfig; every value can be overridden with -D (the
+// host Makefile exposes the ring policy knobs as make variables).
+
+#if !CONFIG_PROJECTPLANT_RING_BACKEND_PARTITION && !defined(CONFIG_PROJECTPLANT_RING_BACKEND_LITTLEFS)
+#define CONFIG_PROJECTPLANT_RING_BACKEND_LITTLEFS 1
+#endif
+#ifndef CONFIG_PROJECTPLANT_RING_PARTITION_LABEL
+#define CONFIG_PROJECTPLANT_RING_PARTITION_LABEL "telemetry"
+#endif
+#ifndef CONFIG_PROJECTPLANT_RING_BUFFER_CAPACITY
+#define CONFIG_PROJECTPLANT_RING_BUFFER_CAPACITY 1536
+#endif
+#ifndef CONFIG_PROJECTPLANT_RING_KEYFRAME_INTERVAL
+#define CONFIG_PROJECTPLANT_RING_KEYFRAME_INTERVAL 32
+#endif
+#ifndef CONFIG_PROJECTPLANT_RING_APPEND_BATCH
+#define CONFIG_PROJECTPLANT_RING_APPEND_BATCH 8
+#endif
+#ifndef CONFIG_PROJECTPLANT_RING_HEADER_SYNC_ENTRIES
+#define CONFIG_PROJECTPLANT_RING_HEADER_SYNC_ENTRIES 64
+#endif
+#ifndef CONFIG_PROJECTPLANT_RING_FLUSH_SEC
+#define CONFIG_PROJECTPLANT_RING_FLUSH_SEC 300
+#endif
+
+#ifndef CONFIG_PROJECTPLANT_MQTT_PERSISTENT_SESSION
+#define CONFIG_PROJECTPLANT_MQTT_PERSISTENT_SESSION 1
+#endif
+#ifndef CONFIG_PROJECTPLANT_MQTT_OUTBOX_LIMIT_BYTES
+#define CONFIG_PROJECTPLANT_MQTT_OUTBOX_LIMIT_BYTES 8192
+#endif
+
+// The log ring is only built into log_replay (CONFIG_PROJECTPLANT_LOG_RING=1)
+#ifndef CONFIG_PROJECTPLANT_LOG_RING_LEVEL
+#define CONFIG_PROJECTPLANT_LOG_RING_LEVEL 3
+#endif
+#ifndef CONFIG_PROJECTPLANT_LOG_RING_BLOCKS
+#define CONFIG_PROJECTPLANT_LOG_RING_BLOCKS 16
+#endif
+#ifndef CONFIG_PROJECTPLANT_LOG_RING_FLUSH_SEC
+#define CONFIG_PROJECTPLANT_LOG_RING_FLUSH_SEC 60
+#endif
+#ifndef CONFIG_PROJECTPLANT_LOG_RING_QUEUE_BYTES
+#define CONFIG_PROJECTPLANT_LOG_RING_QUEUE_BYTES 2048
+#endif
+
+#ifndef CONFIG_LITTLEFS_READ_SIZE
+#define CONFIG_LITTLEFS_READ_SIZE 128
+#endif
+#ifndef CONFIG_LITTLEFS_WRITE_SIZE
+#define CONFIG_LITTLEFS_WRITE_SIZE 128
+#endif
+#ifndef CONFIG_LITTLEFS_LOOKAHEAD_SIZE
+#define CONFIG_LITTLEFS_LOOKAHEAD_SIZE 128
+#endif
+#ifndef CONFIG_LITTLEFS_CACHE_SIZE
+#define CONFIG_LITTLEFS_CACHE_SIZE 512
+#endif
+#ifndef CONFIG_LITTLEFS_BLOCK_CYCLES
+#define CONFIG_LITTLEFS_BLOCK_CYCLES 512
+#endif
+#ifndef CONFIG_LITTLEFS_BLOCK_SIZE
+#define CONFIG_LITTLEFS_BLOCK_SIZE 4096
+#endif
+
+// Only the node simulator builds the modules below these
+#ifndef CONFIG_PROJECTPLANT_MQTT_DURABLE_LIVE
+#define CONFIG_PROJECTPLANT_MQTT_DURABLE_LIVE 1
+#endif
+#ifndef CONFIG_MQTT_REPORT_DELETED_MESSAGES
+#define CONFIG_MQTT_REPORT_DELETED_MESSAGES 1
+#endif
+#if !defined(CONFIG_PROJECTPLANT_TH_SENSOR_AHT10) && !defined(CONFIG_PROJECTPLANT_TH_SENSOR_SHT4X) && \
+    !defined(CONFIG_PROJECTPLANT_TH_SENSOR_AUTO)
+#define CONFIG_PROJECTPLANT_TH_SENSOR_AUTO 1
+#endif
+#if !defined(CONFIG_PROJECTPLANT_POWER_LIGHT_SLEEP) && !defined(CONFIG_PROJECTPLANT_POWER_DEEP_SLEEP) && \
+    !defined(CONFIG_PROJECTPLANT_POWER_ALWAYS_ON)
+#define CONFIG_PROJECTPLANT_POWER_ALWAYS_ON 1
+#endif
+#ifndef CONFIG_PROJECTPLANT_NETWORK_CORE
+#define CONFIG_PROJECTPLANT_NETWORK_CORE 0
+#endif
+#ifndef CONFIG_PROJECTPLANT_CONTROL_CORE
+#define CONFIG_PROJECTPLANT_CONTROL_CORE 1
+#endif
+#ifndef CONFIG_PROJECTPLANT_ACTUATOR_TIMEOUT_QUEUE_DEPTH
+#define CONFIG_PROJECTPLANT_ACTUATOR_TIMEOUT_QUEUE_DEPTH 5
+#endif
+#ifndef CONFIG_PROJECTPLANT_WATERING_RESULT_QUEUE_DEPTH
+#define CONFIG_PROJECTPLANT_WATERING_RESULT_QUEUE_DEPTH 2
+#endif
@@ -0,0 +1,71 @@
+#include "actuator_state.h"
+
+#include <stdatomic.h>
+
+#include "esp_attr.h"
+
+_Static_assert(NODE_SCHEDULE_TARGET_COUNT <= ACTUATOR_STATE_SEQ_SHIFT, "one state bit per output");
+
+static _Atomic actuator_state_t state_word;
+
+// Appended under subscribe_lock, then published by the count; the cutoff ISR
+// reads the table without taking the lock
+static TaskHandle_t subscribers[ACTUATOR_STATE_SUBSCRIBERS];
+static _Atomic uint32_t subscriber_count;
+static portMUX_TYPE subscribe_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// IRAM: the cutoff ISR reads the pump state here too
+actuator_state_t IRAM_ATTR actuator_state_snapshot(void)
+{
+    return atomic_load(&state_word);
+}
+
+// IRAM: called from the cutoff ISR, which also runs during flash writes
+bool IRAM_ATTR actuator_state_store(node_schedule_target_t target, bool on)
+{
+    actuator_state_t bit = 1u << target;
+    actuator_state_t old = atomic_load(&state_word);
+    actuator_state_t next;
+    do {
+        if (((old & bit) != 0) == on) {
+            return false;
+        }
+        next = (((old >> ACTUATOR_STATE_SEQ_SHIFT) + 1u) << ACTUATOR_STATE_SEQ_SHIFT) |
+               ((old ^ bit) & ACTUATOR_STATE_OUTPUT_MASK);
+    } while (!atomic_compare_exchange_weak(&state_word, &old, next));
+    return true;
+}
+
+void actuator_state_notify(void)
+{
+    uint32_t count = atomic_load(&subscriber_count);
+    for (uint32_t i = 0; i < count; ++i) {
+        xTaskNotifyGive(subscribers[i]);
+    }
+}
+
+void IRAM_ATTR actuator_state_notify_from_isr(BaseType_t *woken)
+{
+    uint32_t count = atomic_load(&subscriber_count);
+    for (uint32_t i = 0; i < count; ++i) {
+        vTaskNotifyGiveFromISR(subscribers[i], woken);
+    }
+}
+
+esp_err_t actuator_state_subscribe(TaskHandle_t task)
+{
+    if (!task) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_err_t err = ESP_OK;
+    taskENTER_CRITICAL(&subscribe_lock);
+    uint32_t count = atomic_load(&subscriber_count);
+    if (count < ACTUATOR_STATE_SUBSCRIBERS) {
+        subscribers[count] = task;
+        atomic_store(&subscriber_count, count + 1);
+    } else {
+        err = ESP_ERR_NO_MEM;
+    }
+    taskEXIT_CRITICAL(&subscribe_lock);
+    return err;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "node_schedule.h"
+
+// Output states in one word: a bit per node_schedule_target_t in the low
+// byte and a change sequence above it, so a single load is a consistent
+// snapshot of every output. Written by sensors.c (tasks and the cutoff ISR);
+// read from anywhere without a lock.
+
+#define ACTUATOR_STATE_OUTPUT_MASK  0xFFu
+#define ACTUATOR_STATE_SEQ_SHIFT    8
+#define ACTUATOR_STATE_SUBSCRIBERS  4
+
+typedef uint32_t actuator_state_t;
+
+static inline bool actuator_state_is_on(actuator_state_t state, node_schedule_target_t target)
+{
+    return (state >> target) & 1u;
+}
+
+// Bumped on every change; wraps after 2^24 changes
+static inline uint32_t actuator_state_seq(actuator_state_t state)
+{
+    return state >> ACTUATOR_STATE_SEQ_SHIFT;
+}
+
+actuator_state_t actuator_state_snapshot(void);
+
+// Record an output's state; returns true when it changed. Takes no lock and
+// notifies no one, so it is safe inside a critical section or an ISR; follow
+// a change with actuator_state_notify() or actuator_state_notify_from_isr().
+bool actuator_state_store(node_schedule_target_t target, bool on);
+
+void actuator_state_notify(void);
+void actuator_state_notify_from_isr(BaseType_t *woken);
+
+// Give task a notification (xTaskNotifyGive) on every change. Subscribers
+// are never removed.
+esp_err_t actuator_state_subscribe(TaskHandle_t task);
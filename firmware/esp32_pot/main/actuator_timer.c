@@ -0,0 +1,237 @@
+#include "actuator_timer.h"
+
+#include <string.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+#include "sensors.h"
+
+#define ACTUATOR_TARGET_COUNT NODE_SCHEDULE_TARGET_COUNT
+
+typedef struct {
+    esp_timer_handle_t timer;
+    int64_t deadline_us;     // lets a stale expiry (raced by a re-arm) recognise itself
+    bool armed;
+    char request_id[ACTUATOR_TIMER_REQUEST_ID_LEN];
+} actuator_slot_t;
+
+static const char *TAG = "actuator_timer";
+static actuator_slot_t slots[ACTUATOR_TARGET_COUNT];
+static StaticSemaphore_t slots_mutex_buf;
+static SemaphoreHandle_t slots_mutex = NULL;
+static actuator_timer_expired_cb_t expired_cb = NULL;
+
+static const char *target_name(node_schedule_target_t target)
+{
+    switch (target) {
+    case NODE_SCHEDULE_TARGET_LIGHT:
+        return "light";
+    case NODE_SCHEDULE_TARGET_PUMP:
+        return "pump";
+    case NODE_SCHEDULE_TARGET_IC_ZONE1:
+        return "ic_zone1";
+    case NODE_SCHEDULE_TARGET_MISTER:
+        return "mister";
+    case NODE_SCHEDULE_TARGET_FAN:
+        return "fan";
+    default:
+        return "unknown";
+    }
+}
+
+static bool apply_output(node_schedule_target_t target, bool on)
+{
+    switch (target) {
+    case NODE_SCHEDULE_TARGET_LIGHT:
+        sensors_set_light_state(on);
+        return true;
+    case NODE_SCHEDULE_TARGET_PUMP:
+        sensors_set_pump_state(on);
+        return true;
+    case NODE_SCHEDULE_TARGET_MISTER:
+        sensors_set_mister_state(on);
+        return true;
+    case NODE_SCHEDULE_TARGET_FAN:
+        sensors_set_fan_state(on);
+        return true;
+    default:
+        return false;
+    }
+}
+
+static void actuator_timer_expired(void *arg)
+{
+    node_schedule_target_t target = (node_schedule_target_t)(uintptr_t)arg;
+    actuator_slot_t *slot = &slots[target];
+    actuator_timer_event_t event = {
+        .target = target,
+        .request_id = "",
+    };
+
+    xSemaphoreTake(slots_mutex, portMAX_DELAY);
+    // If the slot was re-armed while this callback waited on the mutex, the new
+    // deadline is still ahead and the new run's own expiry will switch it off.
+    bool fire = slot->armed && esp_timer_get_time() >= slot->deadline_us;
+    if (fire) {
+        slot->armed = false;
+        apply_output(target, false);
+        memcpy(event.request_id, slot->request_id, sizeof(event.request_id));
+    }
+    xSemaphoreGive(slots_mutex);
+
+    if (!fire) {
+        return;
+    }
+    ESP_LOGI(TAG, "%s run elapsed; output off", target_name(target));
+    if (expired_cb) {
+        expired_cb(&event);
+    }
+}
+
+esp_err_t actuator_timer_init(actuator_timer_expired_cb_t on_expired)
+{
+    if (slots_mutex) {
+        expired_cb = on_expired;
+        return ESP_OK;
+    }
+
+    slots_mutex = xSemaphoreCreateMutexStatic(&slots_mutex_buf);
+    expired_cb = on_expired;
+
+    for (int i = 0; i < ACTUATOR_TARGET_COUNT; ++i) {
+        if (i == NODE_SCHEDULE_TARGET_IC_ZONE1) {
+            continue;
+        }
+        const esp_timer_create_args_t args = {
+            .callback = actuator_timer_expired,
+            .arg = (void *)(uintptr_t)i,
+            .dispatch_method = ESP_TIMER_TASK,
+            .name = target_name((node_schedule_target_t)i),
+        };
+        esp_err_t err = esp_timer_create(&args, &slots[i].timer);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to create %s timer: %s", args.name, esp_err_to_name(err));
+            return err;
+        }
+    }
+    return ESP_OK;
+}
+
+// A pump start waits SENSOR_POWER_ON_DELAY_MS for the sensor rail. Settle it
+// before slots_mutex, which the expiry callback on the shared esp_timer task
+// takes, so the wait never stalls timer dispatch.
+static bool hold_rail_for(node_schedule_target_t target, bool on)
+{
+    return target == NODE_SCHEDULE_TARGET_PUMP && on && sensors_pump_rail_hold();
+}
+
+// Caller holds slots_mutex
+static esp_err_t set_locked(node_schedule_target_t target, bool on, uint32_t duration_ms, const char *request_id)
+{
+    actuator_slot_t *slot = &slots[target];
+    esp_err_t err = ESP_OK;
+    if (slot->armed) {
+        esp_timer_stop(slot->timer);  // ESP_ERR_INVALID_STATE if it is already dispatching; armed=false covers that
+        slot->armed = false;
+    }
+    apply_output(target, on);
+
+    if (on && duration_ms > 0) {
+        slot->request_id[0] = '\0';
+        if (request_id) {
+            strncpy(slot->request_id, request_id, sizeof(slot->request_id) - 1);
+            slot->request_id[sizeof(slot->request_id) - 1] = '\0';
+        }
+        slot->deadline_us = esp_timer_get_time() + (int64_t)duration_ms * 1000LL;
+        err = esp_timer_start_once(slot->timer, (uint64_t)duration_ms * 1000ULL);
+        if (err == ESP_OK) {
+            slot->armed = true;
+        } else {
+            // Never leave an output running without its off-timer
+            apply_output(target, false);
+        }
+    }
+    return err;
+}
+
+esp_err_t actuator_timer_set(node_schedule_target_t target, bool on, uint32_t duration_ms, const char *request_id)
+{
+    if ((int)target < 0 || target >= ACTUATOR_TARGET_COUNT || target == NODE_SCHEDULE_TARGET_IC_ZONE1) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    if (!slots_mutex) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    bool rail_held = hold_rail_for(target, on);
+    xSemaphoreTake(slots_mutex, portMAX_DELAY);
+    esp_err_t err = set_locked(target, on, duration_ms, request_id);
+    xSemaphoreGive(slots_mutex);
+    if (rail_held) {
+        sensors_pump_rail_release();
+    }
+
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to arm %s timer: %s", target_name(target), esp_err_to_name(err));
+    }
+    return err;
+}
+
+esp_err_t actuator_timer_set_scene(const actuator_scene_t *scene, const char *request_id, uint8_t *out_failed)
+{
+    if (out_failed) {
+        *out_failed = 0;
+    }
+    if (!scene) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!slots_mutex) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    esp_err_t first_err = ESP_OK;
+    uint8_t failed = 0;
+    uint8_t pump_bit = (uint8_t)(1u << NODE_SCHEDULE_TARGET_PUMP);
+    bool rail_held = hold_rail_for(NODE_SCHEDULE_TARGET_PUMP, (scene->mask & scene->on & pump_bit) != 0);
+    xSemaphoreTake(slots_mutex, portMAX_DELAY);
+    for (int pass = 0; pass < 2; ++pass) {
+        bool on = pass == 1;
+        for (int i = 0; i < ACTUATOR_TARGET_COUNT; ++i) {
+            uint8_t bit = (uint8_t)(1u << i);
+            if (!(scene->mask & bit) || ((scene->on & bit) != 0) != on || i == NODE_SCHEDULE_TARGET_IC_ZONE1) {
+                continue;
+            }
+            esp_err_t err = set_locked((node_schedule_target_t)i, on, scene->duration_ms[i], request_id);
+            if (err != ESP_OK) {
+                failed |= bit;
+                first_err = first_err == ESP_OK ? err : first_err;
+            }
+        }
+    }
+    xSemaphoreGive(slots_mutex);
+    if (rail_held) {
+        sensors_pump_rail_release();
+    }
+
+    if (failed) {
+        ESP_LOGE(TAG, "Scene: failed to arm timers 0x%02x: %s", (unsigned)failed, esp_err_to_name(first_err));
+    }
+    if (out_failed) {
+        *out_failed = failed;
+    }
+    return first_err;
+}
+
+bool actuator_timer_is_armed(node_schedule_target_t target)
+{
+    if ((int)target < 0 || target >= ACTUATOR_TARGET_COUNT || !slots_mutex) {
+        return false;
+    }
+    xSemaphoreTake(slots_mutex, portMAX_DELAY);
+    bool armed = slots[target].armed;
+    xSemaphoreGive(slots_mutex);
+    return armed;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#include "node_schedule.h"
+
+// Timed actuator runs on esp_timer one-shots. Outputs are switched off from
+// the timer callback itself, so a long run never blocks the caller; the
+// expiry callback is then told so it can publish the acknowledgement.
+
+#define ACTUATOR_TIMER_REQUEST_ID_LEN 64
+
+typedef struct {
+    node_schedule_target_t target;
+    char request_id[ACTUATOR_TIMER_REQUEST_ID_LEN];  // empty when the command had none
+} actuator_timer_event_t;
+
+// Runs on the esp_timer task after the output has been switched off; keep it
+// short (e.g. post to a queue).
+typedef void (*actuator_timer_expired_cb_t)(const actuator_timer_event_t *event);
+
+esp_err_t actuator_timer_init(actuator_timer_expired_cb_t on_expired);
+
+// Switch an output and, when on with duration_ms > 0, arm its off-timer.
+// Any previously armed run for the same target is cancelled first.
+// IC Zone 1 is a latching valve driven by pulses and is not handled here.
+esp_err_t actuator_timer_set(node_schedule_target_t target, bool on, uint32_t duration_ms, const char *request_id);
+
+// Several outputs switched together (a scene command): a bit per
+// node_schedule_target_t in mask, its state in on, and the off-timer of each
+// output switched on (0 = none)
+typedef struct {
+    uint8_t mask;
+    uint8_t on;
+    uint32_t duration_ms[NODE_SCHEDULE_TARGET_COUNT];
+} actuator_scene_t;
+
+// actuator_timer_set() for every output in the scene in one pass under one
+// lock, outputs going off before those going on, so no expiry lands halfway.
+// Each armed run carries request_id. IC Zone 1 is left to the caller, as
+// above. Targets that failed are set in out_failed (may be NULL); returns the
+// first error.
+esp_err_t actuator_timer_set_scene(const actuator_scene_t *scene, const char *request_id, uint8_t *out_failed);
+
+bool actuator_timer_is_armed(node_schedule_target_t target);
@@ -1,15 +1,51 @@
 #include "ads1115.h"
 
+#include <stdbool.h>
+
+#include "esp_attr.h"
 #include "esp_log.h"
+#include "esp_rom_sys.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
 #include "freertos/task.h"
 
+#include "i2c_bus.h"
+
 #define ADS1115_ADDR            0x48
 #define ADS1115_REG_CONVERSION  0x00
 #define ADS1115_REG_CONFIG      0x01
+#define ADS1115_REG_LO_THRESH   0x02
+#define ADS1115_REG_HI_THRESH   0x03
+
+#define ADS1115_CFG_OS          (1u << 15)
+#define ADS1115_CFG_MODE_SINGLE (1u << 8)
+#define ADS1115_CFG_COMP_OFF    0x0003u    // COMP_QUE=11 -> comparator disabled, ALERT/RDY high-Z
+#define ADS1115_CFG_COMP_RDY    0x0000u    // COMP_QUE=00 -> ALERT/RDY pulses after every conversion
+
+#define ADS1115_MAX_RETRIES     3
+#define ADS1115_XFER_TIMEOUT_MS 50
 
 static const char *TAG = "ads1115";
-static i2c_port_t active_port = I2C_NUM_0;
+static i2c_master_dev_handle_t dev = NULL;
+
+static const uint32_t conversion_us[] = {
+    125000, 62500, 31250, 15625, 7813, 4000, 2106, 1163,
+};
+
+typedef struct {
+    bool active;
+    bool use_rdy;
+    uint8_t channel;
+    uint16_t config;
+    ads1115_data_rate_t rate;
+} ads1115_stream_t;
+
+static gpio_num_t rdy_gpio = GPIO_NUM_NC;
+static StaticSemaphore_t rdy_sem_buf;
+static SemaphoreHandle_t rdy_sem = NULL;
+static ads1115_stream_t stream = {0};
+static bool rdy_thresholds_set = false;
 
 static esp_err_t ads1115_write_reg(uint8_t reg, uint16_t value)
 {
@@ -17,57 +53,192 @@ static esp_err_t ads1115_write_reg(uint8_t reg, uint16_t value)
     payload[0] = reg;
     payload[1] = (uint8_t)(value >> 8);
     payload[2] = (uint8_t)(value & 0xFF);
-    return i2c_master_write_to_device(active_port, ADS1115_ADDR, payload, sizeof(payload), pdMS_TO_TICKS(50));
+    if (!dev) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    return i2c_bus_transmit(dev, payload, sizeof(payload), ADS1115_XFER_TIMEOUT_MS);
 }
 
 static esp_err_t ads1115_read_reg(uint8_t reg, uint8_t *buf, size_t len)
 {
-    esp_err_t err = i2c_master_write_to_device(active_port, ADS1115_ADDR, &reg, 1, pdMS_TO_TICKS(50));
-    if (err != ESP_OK) return err;
-    return i2c_master_read_from_device(active_port, ADS1115_ADDR, buf, len, pdMS_TO_TICKS(50));
+    if (!dev) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    // Pointer write and read in one transaction (repeated start)
+    return i2c_bus_transmit_receive(dev, &reg, 1, buf, len, ADS1115_XFER_TIMEOUT_MS);
 }
 
-esp_err_t ads1115_init(i2c_port_t port, gpio_num_t sda_gpio, gpio_num_t scl_gpio)
+// Retry logic with exponential backoff for transient I2C errors
+static esp_err_t ads1115_write_reg_retry(uint8_t reg, uint16_t value)
 {
-    (void)sda_gpio;
-    (void)scl_gpio;
-    active_port = port;
-    return ESP_OK;
+    esp_err_t err = ESP_OK;
+    for (int attempt = 0; attempt < ADS1115_MAX_RETRIES; attempt++) {
+        err = ads1115_write_reg(reg, value);
+        if (err == ESP_OK) break;
+        ESP_LOGW(TAG, "Reg 0x%02x write failed (attempt %d/%d): %s", reg, attempt + 1, ADS1115_MAX_RETRIES, esp_err_to_name(err));
+        vTaskDelay(pdMS_TO_TICKS(10 * (1 << attempt))); // exponential backoff: 10, 20, 40ms
+    }
+    return err;
 }
 
-esp_err_t ads1115_read_single_ended(uint8_t channel, ads1115_pga_t pga, int16_t *out_counts)
+static esp_err_t ads1115_read_counts_retry(int16_t *out_counts)
 {
-    if (channel > 3 || out_counts == NULL) {
-        return ESP_ERR_INVALID_ARG;
+    uint8_t raw[2];
+    esp_err_t err = ESP_OK;
+    for (int attempt = 0; attempt < ADS1115_MAX_RETRIES; attempt++) {
+        err = ads1115_read_reg(ADS1115_REG_CONVERSION, raw, sizeof raw);
+        if (err == ESP_OK) break;
+        ESP_LOGW(TAG, "Conversion read failed (attempt %d/%d): %s", attempt + 1, ADS1115_MAX_RETRIES, esp_err_to_name(err));
+        vTaskDelay(pdMS_TO_TICKS(10 * (1 << attempt))); // exponential backoff
     }
+    if (err == ESP_OK) {
+        *out_counts = (int16_t)((raw[0] << 8) | raw[1]);
+    }
+    return err;
+}
+
+static uint16_t ads1115_build_config(uint8_t channel, ads1115_pga_t pga, ads1115_data_rate_t rate, bool single_shot, uint16_t comp)
+{
     // Config register layout:
-    // [15] OS=1 (start single conversion)
+    // [15] OS (write 1 = start single conversion, read 1 = idle)
     // [14:12] MUX = 100 + channel (AINx vs GND)
     // [11:9] PGA
-    // [8] MODE=1 (single-shot)
-    // [7:5] DR (128 SPS = 100)
-    // [4:0] comparator disabled (default 00011)
-
+    // [8] MODE (1 = single-shot/power-down, 0 = continuous)
+    // [7:5] DR
+    // [4:0] comparator (COMP_QUE=11 disables, 00 drives ALERT/RDY)
     uint16_t mux = 0x04 + channel; // 100b + ch
     uint16_t cfg = 0;
-    cfg |= (1u << 15);                 // OS = 1 (start)
-    cfg |= (mux & 0x07) << 12;         // MUX
-    cfg |= ((uint16_t)pga & 0x07) << 9;// PGA
-    cfg |= (1u << 8);                  // MODE = single-shot
-    cfg |= (0x04u << 5);               // DR = 128 SPS
-    cfg |= 0x0003;                     // disable comparator
-
-    // Retry logic with exponential backoff for transient I2C errors
-    const int max_retries = 3;
-    esp_err_t err = ESP_OK;
-    
-    for (int attempt = 0; attempt < max_retries; attempt++) {
-        err = ads1115_write_reg(ADS1115_REG_CONFIG, cfg);
-        if (err == ESP_OK) break;
-        ESP_LOGW(TAG, "Config write failed (attempt %d/%d): %s", attempt + 1, max_retries, esp_err_to_name(err));
-        vTaskDelay(pdMS_TO_TICKS(10 * (1 << attempt))); // exponential backoff: 10, 20, 40ms
+    cfg |= (mux & 0x07) << 12;             // MUX
+    cfg |= ((uint16_t)pga & 0x07) << 9;    // PGA
+    if (single_shot) {
+        cfg |= ADS1115_CFG_MODE_SINGLE;
+    }
+    cfg |= ((uint16_t)rate & 0x07) << 5;   // DR
+    cfg |= comp;
+    return cfg;
+}
+
+static void ads1115_wait_us(uint32_t us)
+{
+    // Busy-wait below two ticks; yield for anything longer
+    const uint32_t tick_us = portTICK_PERIOD_MS * 1000U;
+    if (us >= 2U * tick_us) {
+        vTaskDelay(pdMS_TO_TICKS(us / 1000U));
+    } else if (us > 0) {
+        esp_rom_delay_us(us);
+    }
+}
+
+static esp_err_t ads1115_poll_ready(uint32_t period_us)
+{
+    // Internal oscillator is spec'd at +/-10%; allow two periods before giving up
+    const int64_t deadline = esp_timer_get_time() + (int64_t)(2U * period_us) + 2000;
+    const uint32_t poll_us = period_us / 8U + 50U;
+    uint8_t raw[2];
+    while (true) {
+        esp_err_t err = ads1115_read_reg(ADS1115_REG_CONFIG, raw, sizeof raw);
+        if (err == ESP_OK && (raw[0] & 0x80) != 0) {
+            return ESP_OK;
+        }
+        if (esp_timer_get_time() >= deadline) {
+            return err != ESP_OK ? err : ESP_ERR_TIMEOUT;
+        }
+        ads1115_wait_us(poll_us);
+    }
+}
+
+static void IRAM_ATTR ads1115_rdy_isr(void *arg)
+{
+    (void)arg;
+    BaseType_t woken = pdFALSE;
+    xSemaphoreGiveFromISR(rdy_sem, &woken);
+    if (woken == pdTRUE) {
+        portYIELD_FROM_ISR();
+    }
+}
+
+esp_err_t ads1115_init(void)
+{
+    if (dev) {
+        return ESP_OK;
+    }
+    esp_err_t err = i2c_bus_add_device(ADS1115_ADDR, &dev);
+    if (err != ESP_OK) {
+        dev = NULL;
+    }
+    return err;
+}
+
+esp_err_t ads1115_set_ready_gpio(gpio_num_t gpio)
+{
+    if (gpio == rdy_gpio) {
+        return ESP_OK;
+    }
+    if (stream.active) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    if (rdy_gpio != GPIO_NUM_NC) {
+        gpio_isr_handler_remove(rdy_gpio);
+        rdy_gpio = GPIO_NUM_NC;
+    }
+    if (gpio == GPIO_NUM_NC) {
+        return ESP_OK;
+    }
+
+    if (!rdy_sem) {
+        rdy_sem = xSemaphoreCreateBinaryStatic(&rdy_sem_buf);
+    }
+
+    gpio_config_t rdy_cfg = {
+        .pin_bit_mask = BIT64(gpio),
+        .mode = GPIO_MODE_INPUT,
+        .pull_up_en = GPIO_PULLUP_ENABLE,
+        .pull_down_en = GPIO_PULLDOWN_DISABLE,
+        .intr_type = GPIO_INTR_NEGEDGE,  // ALERT/RDY is active-low, ~8 us pulse per conversion
+    };
+    esp_err_t err = gpio_config(&rdy_cfg);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    // IRAM dispatch, as the water cutoff monitor installs it; whichever
+    // driver comes first installs the shared service
+    err = gpio_install_isr_service(ESP_INTR_FLAG_IRAM);
+    if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) {
+        ESP_LOGE(TAG, "GPIO ISR service install failed: %s", esp_err_to_name(err));
+        return err;
     }
-    
+    err = gpio_isr_handler_add(gpio, ads1115_rdy_isr, NULL);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "ALERT/RDY handler add failed: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    rdy_gpio = gpio;
+    ESP_LOGI(TAG, "ALERT/RDY conversion-ready interrupt on GPIO %d", (int)gpio);
+    return ESP_OK;
+}
+
+uint32_t ads1115_conversion_time_us(ads1115_data_rate_t rate)
+{
+    if ((unsigned)rate >= sizeof(conversion_us) / sizeof(conversion_us[0])) {
+        return conversion_us[ADS1115_DR_128SPS];
+    }
+    return conversion_us[rate];
+}
+
+esp_err_t ads1115_read_single_ended(uint8_t channel, ads1115_pga_t pga, int16_t *out_counts)
+{
+    if (channel > 3 || out_counts == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (stream.active) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    uint16_t cfg = ADS1115_CFG_OS | ads1115_build_config(channel, pga, ADS1115_DR_128SPS, true, ADS1115_CFG_COMP_OFF);
+    esp_err_t err = ads1115_write_reg_retry(ADS1115_REG_CONFIG, cfg);
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "ADS1115 channel %d config write exhausted retries", channel);
         return err;
@@ -76,21 +247,149 @@ esp_err_t ads1115_read_single_ended(uint8_t channel, ads1115_pga_t pga, int16_t
     // Wait for conversion (128 SPS ~7.8ms); add margin for clock variance
     vTaskDelay(pdMS_TO_TICKS(15));
 
-    uint8_t raw[2];
-    for (int attempt = 0; attempt < max_retries; attempt++) {
-        err = ads1115_read_reg(ADS1115_REG_CONVERSION, raw, sizeof raw);
-        if (err == ESP_OK) break;
-        ESP_LOGW(TAG, "Conversion read failed (attempt %d/%d): %s", attempt + 1, max_retries, esp_err_to_name(err));
-        vTaskDelay(pdMS_TO_TICKS(10 * (1 << attempt))); // exponential backoff
-    }
-    
+    err = ads1115_read_counts_retry(out_counts);
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "ADS1115 channel %d conversion read exhausted retries", channel);
         return err;
     }
 
-    *out_counts = (int16_t)((raw[0] << 8) | raw[1]);
     ESP_LOGD(TAG, "Channel %d: raw=%d (0x%04x)", channel, *out_counts, (uint16_t)*out_counts);
     return ESP_OK;
 }
 
+esp_err_t ads1115_continuous_start(uint8_t channel, ads1115_pga_t pga, ads1115_data_rate_t rate)
+{
+    if (channel > 3 || (unsigned)rate > ADS1115_DR_860SPS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    bool use_rdy = rdy_gpio != GPIO_NUM_NC && rdy_sem != NULL;
+    esp_err_t err = ESP_OK;
+    if (use_rdy) {
+        if (!rdy_thresholds_set) {
+            // Hi_thresh MSB=1 / Lo_thresh MSB=0 turns ALERT into a conversion-ready output
+            err = ads1115_write_reg_retry(ADS1115_REG_LO_THRESH, 0x0000);
+            if (err == ESP_OK) {
+                err = ads1115_write_reg_retry(ADS1115_REG_HI_THRESH, 0x8000);
+            }
+            if (err != ESP_OK) {
+                ESP_LOGE(TAG, "ALERT/RDY threshold setup failed: %s", esp_err_to_name(err));
+                return err;
+            }
+            rdy_thresholds_set = true;
+        }
+        stream.config = ads1115_build_config(channel, pga, rate, false, ADS1115_CFG_COMP_RDY);
+        xSemaphoreTake(rdy_sem, 0);  // discard a stale pulse from a previous run
+        err = ads1115_write_reg_retry(ADS1115_REG_CONFIG, stream.config);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "ADS1115 channel %d continuous start failed: %s", channel, esp_err_to_name(err));
+            return err;
+        }
+    } else {
+        stream.config = ads1115_build_config(channel, pga, rate, true, ADS1115_CFG_COMP_OFF);
+    }
+
+    stream.active = true;
+    stream.use_rdy = use_rdy;
+    stream.channel = channel;
+    stream.rate = rate;
+    ESP_LOGD(TAG, "Channel %d streaming at DR=%d (%s)", channel, (int)rate, use_rdy ? "ALERT/RDY" : "OS poll");
+    return ESP_OK;
+}
+
+esp_err_t ads1115_continuous_read(int16_t *out_counts)
+{
+    if (!out_counts) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!stream.active) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    uint32_t period_us = ads1115_conversion_time_us(stream.rate);
+    esp_err_t err;
+    if (stream.use_rdy) {
+        TickType_t timeout = pdMS_TO_TICKS((2U * period_us) / 1000U) + 2;
+        if (xSemaphoreTake(rdy_sem, timeout) != pdTRUE) {
+            ESP_LOGW(TAG, "ALERT/RDY timeout on channel %d", stream.channel);
+            return ESP_ERR_TIMEOUT;
+        }
+    } else {
+        err = ads1115_write_reg_retry(ADS1115_REG_CONFIG, ADS1115_CFG_OS | stream.config);
+        if (err != ESP_OK) {
+            return err;
+        }
+        ads1115_wait_us(period_us);
+        err = ads1115_poll_ready(period_us);
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "Conversion not ready on channel %d: %s", stream.channel, esp_err_to_name(err));
+            return err;
+        }
+    }
+
+    return ads1115_read_counts_retry(out_counts);
+}
+
+esp_err_t ads1115_continuous_stop(void)
+{
+    if (!stream.active) {
+        return ESP_OK;
+    }
+    stream.active = false;
+    if (!stream.use_rdy) {
+        return ESP_OK;
+    }
+    // Back to single-shot with the comparator off: the chip powers down after the
+    // conversion in flight and ALERT/RDY returns to high-Z.
+    uint16_t cfg = (stream.config & ~0x0103u) | ADS1115_CFG_MODE_SINGLE | ADS1115_CFG_COMP_OFF;
+    return ads1115_write_reg_retry(ADS1115_REG_CONFIG, cfg);
+}
+
+esp_err_t ads1115_scan(const ads1115_scan_channel_t *channels, size_t channel_count,
+                       ads1115_data_rate_t rate, int16_t *out_samples, size_t *out_valid)
+{
+    if (!channels || channel_count == 0 || !out_samples || !out_valid) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (stream.active) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    esp_err_t last_err = ESP_FAIL;
+    bool any_valid = false;
+    int16_t *dst = out_samples;
+    for (size_t c = 0; c < channel_count; ++c) {
+        out_valid[c] = 0;
+        if (channels[c].samples == 0) {
+            continue;
+        }
+
+        // While free-running, the config write that changes MUX also restarts the
+        // conversion, so the first RDY pulse afterwards already belongs to the new channel.
+        esp_err_t err = ads1115_continuous_start(channels[c].channel, channels[c].pga, rate);
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "Scan: channel %d start failed: %s", channels[c].channel, esp_err_to_name(err));
+            last_err = err;
+            continue;
+        }
+        for (size_t i = 0; i < channels[c].samples; ++i) {
+            int16_t sample = 0;
+            err = ads1115_continuous_read(&sample);
+            if (err != ESP_OK) {
+                last_err = err;
+                continue;
+            }
+            dst[out_valid[c]++] = sample;
+        }
+        dst += channels[c].samples;
+        if (out_valid[c] > 0) {
+            any_valid = true;
+        } else {
+            ESP_LOGW(TAG, "Scan: channel %d produced no samples", channels[c].channel);
+        }
+    }
+
+    // Converter stays running across channel switches; power it down once at the end
+    ads1115_continuous_stop();
+    return any_valid ? ESP_OK : last_err;
+}
@@ -1,7 +1,8 @@
 #pragma once
 
-#include "driver/i2c.h"
+#include "driver/gpio.h"
 #include "esp_err.h"
+#include <stddef.h>
 #include <stdint.h>
 
 // Minimal ADS1115 driver for single-ended reads on AIN0..AIN3
@@ -15,9 +16,49 @@ typedef enum {
     ADS1115_PGA_0256 = 5,  // ±0.256 V
 } ads1115_pga_t;
 
-esp_err_t ads1115_init(i2c_port_t port, gpio_num_t sda_gpio, gpio_num_t scl_gpio);
+typedef enum {
+    ADS1115_DR_8SPS = 0,
+    ADS1115_DR_16SPS = 1,
+    ADS1115_DR_32SPS = 2,
+    ADS1115_DR_64SPS = 3,
+    ADS1115_DR_128SPS = 4,  // default
+    ADS1115_DR_250SPS = 5,
+    ADS1115_DR_475SPS = 6,
+    ADS1115_DR_860SPS = 7,
+} ads1115_data_rate_t;
+
+// Call after i2c_bus_init()
+esp_err_t ads1115_init(void);
 esp_err_t ads1115_read_single_ended(uint8_t channel, ads1115_pga_t pga, int16_t *out_counts);
 
+// Optional ALERT/RDY wiring (open-drain, needs a pull-up). When set, continuous
+// reads block on the conversion-ready pulse; pass GPIO_NUM_NC to poll instead.
+esp_err_t ads1115_set_ready_gpio(gpio_num_t rdy_gpio);
+
+// Continuous sampling on one channel; calling start again while running switches
+// channel without a stop. With ALERT/RDY wired the chip free-runs in
+// continuous mode; without it each read starts a single-shot conversion at the
+// requested rate and polls the config OS bit, so no fixed delays are involved.
+esp_err_t ads1115_continuous_start(uint8_t channel, ads1115_pga_t pga, ads1115_data_rate_t rate);
+esp_err_t ads1115_continuous_read(int16_t *out_counts);
+esp_err_t ads1115_continuous_stop(void);
+
+typedef struct {
+    uint8_t channel;     // AIN0..AIN3 (single-ended)
+    ads1115_pga_t pga;
+    uint8_t samples;     // conversions to take on this channel
+} ads1115_scan_channel_t;
+
+// Sample several channels back-to-back in one call (and one sensor power window).
+// out_samples holds each channel's block in list order (block i starts after the
+// samples of channels 0..i-1), with out_valid[i] good samples packed at its front.
+// Returns ESP_OK if at least one channel produced a sample, otherwise the last error.
+esp_err_t ads1115_scan(const ads1115_scan_channel_t *channels, size_t channel_count,
+                       ads1115_data_rate_t rate, int16_t *out_samples, size_t *out_valid);
+
+// Nominal conversion period for a data rate (datasheet clock, no margin)
+uint32_t ads1115_conversion_time_us(ads1115_data_rate_t rate);
+
 // Utility to convert raw counts to volts for the provided PGA
 static inline float ads1115_counts_to_volts(int16_t counts, ads1115_pga_t pga)
 {
@@ -33,4 +74,3 @@ static inline float ads1115_counts_to_volts(int16_t counts, ads1115_pga_t pga)
     }
     return ((float)counts / 32768.0f) * fs;
 }
-
@@ -1,34 +1,48 @@
 #include "aht10.h"
 
-#include "esp_log.h"
+#include <stdbool.h>
+
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 
-#include "preferences.h"  // Chris
+#include "i2c_bus.h"
 
 #define AHT10_ADDR         0x38
 #define AHT10_CMD_RESET    0xBA
 #define AHT10_CMD_CALIB    0xE1
 #define AHT10_CMD_TRIGGER  0xAC
+#define AHT10_XFER_TIMEOUT_MS 50
 
-static const char *TAG = "aht10";
-static i2c_port_t active_port = I2C_NUM_0;
+static i2c_master_dev_handle_t dev = NULL;
+static int64_t triggered_us = 0;
+static bool triggered = false;
 
 static esp_err_t aht10_write_bytes(const uint8_t *data, size_t len)
 {
-    return i2c_master_write_to_device(active_port, AHT10_ADDR, data, len, pdMS_TO_TICKS(50));
+    if (!dev) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    return i2c_bus_transmit(dev, data, len, AHT10_XFER_TIMEOUT_MS);
 }
 
 static esp_err_t aht10_read_bytes(uint8_t *data, size_t len)
 {
-    return i2c_master_read_from_device(active_port, AHT10_ADDR, data, len, pdMS_TO_TICKS(50));
+    if (!dev) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    return i2c_bus_receive(dev, data, len, AHT10_XFER_TIMEOUT_MS);
 }
 
-esp_err_t aht10_init(i2c_port_t port, gpio_num_t sda_gpio, gpio_num_t scl_gpio)
+esp_err_t aht10_init(void)
 {
-    (void)sda_gpio;
-    (void)scl_gpio;
-    active_port = port;
+    if (!dev) {
+        esp_err_t err = i2c_bus_add_device(AHT10_ADDR, &dev);
+        if (err != ESP_OK) {
+            dev = NULL;
+            return err;
+        }
+    }
 
     // Soft reset then quick calibration
     uint8_t reset = AHT10_CMD_RESET;
@@ -41,18 +55,29 @@ esp_err_t aht10_init(i2c_port_t port, gpio_num_t sda_gpio, gpio_num_t scl_gpio)
     return ESP_OK;
 }
 
-esp_err_t aht10_read(float *temperature_c, float *humidity_pct)
+esp_err_t aht10_trigger(void)
 {
     // Trigger measurement: 0xAC 0x33 0x00
     uint8_t trig[3] = { AHT10_CMD_TRIGGER, 0x33, 0x00 };
     esp_err_t err = aht10_write_bytes(trig, sizeof(trig));
-    if (err != ESP_OK) {
-        return err;
+    triggered = err == ESP_OK;
+    triggered_us = esp_timer_get_time();
+    return err;
+}
+
+esp_err_t aht10_fetch(float *temperature_c, float *humidity_pct)
+{
+    if (!triggered) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    triggered = false;
+    int64_t left_us = (int64_t)AHT10_MEASURE_MS * 1000 - (esp_timer_get_time() - triggered_us);
+    if (left_us > 0) {
+        vTaskDelay(pdMS_TO_TICKS((left_us + 999) / 1000) + 1);
     }
-    vTaskDelay(pdMS_TO_TICKS(80));
 
     uint8_t buf[6] = {0};
-    err = aht10_read_bytes(buf, sizeof(buf));
+    esp_err_t err = aht10_read_bytes(buf, sizeof(buf));
     if (err != ESP_OK) {
         return err;
     }
@@ -78,13 +103,23 @@ esp_err_t aht10_read(float *temperature_c, float *humidity_pct)
     if (temperature_c) {
         *temperature_c = tc;
     }
-    if (tc > 30.0f) {
-        ESP_LOGI(TAG, "Temperature reading: %.2f C (raw %u)", tc, raw_t);
-        esp_err_t err = put_char("test_var", '1');  // DEBUG: Chris
-        if (err != ESP_OK) {
-            ESP_LOGW(TAG, "Failed to set test_var: %s", esp_err_to_name(err));
-        }
-    }
     return ESP_OK;
 }
 
+esp_err_t aht10_read(float *temperature_c, float *humidity_pct)
+{
+    esp_err_t err = aht10_trigger();
+    if (err != ESP_OK) {
+        return err;
+    }
+    return aht10_fetch(temperature_c, humidity_pct);
+}
+
+const th_sensor_driver_t aht10_driver = {
+    .name = "AHT10",
+    .address = AHT10_ADDR,
+    .conversion_ms = AHT10_MEASURE_MS,
+    .init = aht10_init,
+    .trigger = aht10_trigger,
+    .fetch = aht10_fetch,
+};
@@ -1,11 +1,23 @@
 #pragma once
 
-#include "driver/i2c.h"
 #include "esp_err.h"
 
+#include "th_sensor.h"
+
 // Minimal AHT10 driver (temperature + humidity)
 // Address: 0x38 (7-bit)
 
-esp_err_t aht10_init(i2c_port_t port, gpio_num_t sda_gpio, gpio_num_t scl_gpio);
+// Measurement time after a trigger (datasheet: >75 ms)
+#define AHT10_MEASURE_MS 80
+
+// Call after i2c_bus_init()
+esp_err_t aht10_init(void);
 esp_err_t aht10_read(float *temperature_c, float *humidity_pct);
 
+// Split read: trigger, do other work, then fetch. aht10_fetch() only waits
+// for whatever is left of AHT10_MEASURE_MS since the trigger.
+esp_err_t aht10_trigger(void);
+esp_err_t aht10_fetch(float *temperature_c, float *humidity_pct);
+
+// The functions above as a th_sensor driver
+extern const th_sensor_driver_t aht10_driver;
@@ -1,32 +1,112 @@
 #include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
 #include "freertos/queue.h"
+#include "freertos/semphr.h"
 #include "freertos/task.h"
 
 #include "esp_log.h"
+#include "esp_timer.h"
 
+#include "actuator_state.h"
+#include "actuator_timer.h"
+#include "command_lanes.h"
 #include "device_identity.h"
+#include "espnow_relay.h"
 #include "hardware_config.h"
+#include "latency_hist.h"
+#include "log_ring.h"
+#include "measurement_interval.h"
 #include "node_schedule.h"
+#include "offline_buffer.h"
 #include "plant_mqtt.h"
+#include "power_manager.h"
+#include "relay_frame.h"
+#include "report_policy.h"
+#include "runtime_diag.h"
+#include "sensor_window.h"
 #include "sensors.h"
+#include "soil_filter.h"
 #include "startup_onboarding.h"
 #include "time_sync.h"
+#include "watering.h"
 
 #include "nvs_flash.h"  // for init. flash memory
 #include "preferences.h"  // Chris
 
 #define FW_VERSION "0.1.0"
-#define COMMAND_TASK_STACK 3072
+#if CONFIG_PROJECTPLANT_LATENCY_HISTOGRAMS
+#define COMMAND_TASK_STACK 5120   // diag payloads, with histograms, are built on the stack
+#else
+#define COMMAND_TASK_STACK 4096   // diag payloads are built on the stack
+#endif
 #define PING_TASK_STACK 4096
 #define SCHEDULE_TASK_STACK 4096
+#define ACTUATOR_TIMEOUT_QUEUE_DEPTH CONFIG_PROJECTPLANT_ACTUATOR_TIMEOUT_QUEUE_DEPTH
+#define WATERING_RESULT_QUEUE_DEPTH CONFIG_PROJECTPLANT_WATERING_RESULT_QUEUE_DEPTH
 
 static const char *TAG = "app";
 
+// Boot stages run concurrently; these bits say which have finished
+#define BOOT_SENSORS_READY  BIT0   // sensor rail powered and I2C devices probed
+#define BOOT_STORAGE_READY  BIT1   // telemetry ring mounted
+#define BOOT_NETWORK_UP     BIT2   // Wi-Fi associated with an IP
+#define BOOT_TIME_VALID     BIT3   // clock estimated or synchronized
+
+static EventGroupHandle_t boot_events;
+
 static QueueHandle_t measurement_queue;
-static QueueHandle_t command_queue;
+static SemaphoreHandle_t command_ready;
+static QueueHandle_t actuator_timeout_queue;
+static SemaphoreHandle_t water_cutoff_event;
+static QueueHandle_t watering_done_queue;
+static QueueSetHandle_t command_events;
 static esp_mqtt_client_handle_t mqtt_client = NULL;
+
+// Task and queue memory is fixed at link time (StackType_t is a byte here).
+// Only the queue set comes from the heap: FreeRTOS has no static variant.
+static StaticEventGroup_t boot_events_buf;
+static StaticQueue_t measurement_queue_buf;
+static uint8_t measurement_queue_storage[sizeof(sensor_reading_t)];
+static StaticQueue_t actuator_timeout_queue_buf;
+static uint8_t actuator_timeout_queue_storage[ACTUATOR_TIMEOUT_QUEUE_DEPTH * sizeof(actuator_timer_event_t)];
+static StaticSemaphore_t water_cutoff_event_buf;
+static StaticQueue_t watering_done_queue_buf;
+static uint8_t watering_done_queue_storage[WATERING_RESULT_QUEUE_DEPTH * sizeof(watering_result_t)];
+
+static StaticTask_t network_task_tcb;
+static StackType_t network_task_stack[NETWORK_TASK_STACK];
+#if CONFIG_PROJECTPLANT_POWER_DEEP_SLEEP
+static StaticTask_t duty_task_tcb;
+static StackType_t duty_task_stack[MQTT_TASK_STACK];
+#else
+static StaticTask_t sensor_task_tcb;
+static StackType_t sensor_task_stack[SENSOR_TASK_STACK];
+static StaticTask_t mqtt_task_tcb;
+static StackType_t mqtt_task_stack[MQTT_TASK_STACK];
+static StaticTask_t ping_task_tcb;
+static StackType_t ping_task_stack[PING_TASK_STACK];
+#endif
+static StaticTask_t command_task_tcb;
+static StackType_t command_task_stack[COMMAND_TASK_STACK];
+static StaticTask_t schedule_task_tcb;
+static StackType_t schedule_task_stack[SCHEDULE_TASK_STACK];
 static const char *device_id = NULL;
 
+// Tasks reported on the diag topic
+static const char *const diag_tasks[] = {
+#if CONFIG_PROJECTPLANT_POWER_DEEP_SLEEP
+    "duty_task",
+#else
+    "sensor_task",
+    "mqtt_task",
+    "ping_task",
+#endif
+    "command_task",
+    "schedule_task",
+    "watering_task",
+};
+
+#if !CONFIG_PROJECTPLANT_POWER_DEEP_SLEEP
 #if defined(INCLUDE_uxTaskGetStackHighWaterMark) && (INCLUDE_uxTaskGetStackHighWaterMark == 1)
 static void log_ping_task_watermark(const char *label)
 {
@@ -42,210 +122,756 @@ static inline void log_ping_task_watermark(const char *label)
     (void)label;
 }
 #endif
+#endif
+
+static void boot_mark(EventBits_t stage, const char *label)
+{
+    xEventGroupSetBits(boot_events, stage);
+    ESP_LOGI(TAG, "Boot: %s at %lld ms", label, (long long)(esp_timer_get_time() / 1000));
+}
+
+// MQTT event task, from command_lanes_push(): a later command replaced or
+// cancelled this one before it ran
+static void on_command_superseded(const char *request_id)
+{
+    if (mqtt_client) {
+        mqtt_publish_status(mqtt_client, device_id, FW_VERSION, "command_coalesced", request_id);
+    }
+}
 
 static void mqtt_command_dispatch(const mqtt_command_t *cmd)
 {
-    if (!cmd || !command_queue) {
+    command_lanes_push(cmd);
+}
+
+// esp_timer task context: the output is already off, just hand the ack over
+static void actuator_timeout_dispatch(const actuator_timer_event_t *event)
+{
+    if (!event || !actuator_timeout_queue) {
         return;
     }
+    if (xQueueSend(actuator_timeout_queue, event, 0) != pdTRUE) {
+        ESP_LOGW(TAG, "Timeout queue full, dropping ack");
+    }
+}
 
-    if (xQueueSend(command_queue, cmd, 0) != pdTRUE) {
-        ESP_LOGW(TAG, "Command queue full, dropping command");
+static void handle_actuator_timeout(const actuator_timer_event_t *event)
+{
+    const char *status = NULL;
+    switch (event->target) {
+    case NODE_SCHEDULE_TARGET_PUMP:
+        status = "pump_off";
+        break;
+    case NODE_SCHEDULE_TARGET_FAN:
+        status = "fan_timeout_off";
+        break;
+    case NODE_SCHEDULE_TARGET_MISTER:
+        status = "mister_timeout_off";
+        break;
+    case NODE_SCHEDULE_TARGET_LIGHT:
+        status = "light_timeout_off";
+        break;
+    default:
+        return;
+    }
+    if (mqtt_client) {
+        const char *request_id = event->request_id[0] ? event->request_id : NULL;
+        mqtt_publish_status(mqtt_client, device_id, FW_VERSION, status, request_id);
     }
 }
 
-static void handle_command_task(void *arg)
+static void set_timed_output(node_schedule_target_t target, bool on, uint32_t duration_ms, const char *request_id)
 {
-    mqtt_command_t cmd;
-    while (true) {
-        if (xQueueReceive(command_queue, &cmd, portMAX_DELAY) == pdTRUE) {
-            switch (cmd.type) {
-            case MQTT_CMD_PUMP_OVERRIDE:
-            {
-                uint32_t pulse_ms = cmd.duration_ms > 0 ? cmd.duration_ms : PUMP_PULSE_MS;
-                ESP_LOGI(TAG, "Pump command: %s duration %u ms", cmd.pump_on ? "ON" : "OFF", (unsigned)pulse_ms);
-                sensors_set_pump_state(cmd.pump_on);
-                const char *request_id = cmd.request_id[0] ? cmd.request_id : NULL;
+    esp_err_t err = actuator_timer_set(target, on, duration_ms, request_id);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Timed output %d failed: %s", (int)target, esp_err_to_name(err));
+    }
+}
+
+// Watering task context: the pump is off, hand the report over
+static void watering_done_dispatch(const watering_result_t *result)
+{
+    if (watering_done_queue && xQueueSend(watering_done_queue, result, 0) != pdTRUE) {
+        ESP_LOGW(TAG, "Watering queue full, dropping report");
+    }
+}
+
+// Cutoff task context: the ISR has already stopped the pump
+static void on_water_cutoff(void)
+{
+    if (water_cutoff_event) {
+        xSemaphoreGive(water_cutoff_event);
+    }
+}
+
+static void handle_water_cutoff(void)
+{
+    if (actuator_timer_is_armed(NODE_SCHEDULE_TARGET_PUMP)) {
+        set_timed_output(NODE_SCHEDULE_TARGET_PUMP, false, 0, NULL);  // disarm the run
+    }
+    if (mqtt_client) {
+        mqtt_publish_status(mqtt_client, device_id, FW_VERSION, "water_cutoff", NULL);
+    }
+}
+
+// Command task only: the CPU shares are deltas between its snapshots
+static void publish_diag(const char *request_id)
+{
+    if (!mqtt_client) {
+        return;
+    }
+    runtime_diag_t diag;
+    runtime_diag_collect(diag_tasks, sizeof(diag_tasks) / sizeof(diag_tasks[0]), &diag);
+    command_lane_stats_t lanes[COMMAND_LANE_COUNT];
+    command_lanes_get_stats(lanes);
+    for (size_t i = 0; i < COMMAND_LANE_COUNT; ++i) {
+        diag.command_lanes[i].depth = lanes[i].depth;
+        diag.command_lanes[i].len = lanes[i].len;
+        diag.command_lanes[i].drops = lanes[i].drops;
+        diag.command_lanes[i].coalesced = lanes[i].coalesced;
+    }
+    diag.mqtt_outbox_bytes = esp_mqtt_client_get_outbox_size(mqtt_client);
+    mqtt_publish_diag(mqtt_client, device_id, &diag, request_id);
+}
+
+static void start_watering(const mqtt_command_t *cmd)
+{
+    uint32_t max_ms = cmd->duration_ms > 0 ? cmd->duration_ms : WATERING_MAX_RUN_MS;
+#if PUMP_FLOW_ML_PER_MIN > 0
+    // Without a measured flow there is no volume to cap, only the time
+    if (cmd->water_max_ml > 0) {
+        uint64_t volume_ms = (uint64_t)cmd->water_max_ml * 60000 / PUMP_FLOW_ML_PER_MIN;
+        if (volume_ms < max_ms) {
+            max_ms = volume_ms > 0 ? (uint32_t)volume_ms : 1;
+        }
+    }
+#endif
+    const char *request_id = cmd->request_id[0] ? cmd->request_id : NULL;
+    esp_err_t err = watering_start(cmd->water_target_pct, max_ms, request_id);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Watering rejected: %s", esp_err_to_name(err));
+    } else {
+        ESP_LOGI(TAG, "Watering to %.1f%% (max %u ms)", (double)cmd->water_target_pct, (unsigned)max_ms);
+    }
+    if (mqtt_client) {
+        mqtt_publish_status(mqtt_client, device_id, FW_VERSION,
+                            err == ESP_OK ? "watering_started" : "watering_failed",
+                            request_id);
+    }
+}
+
+// Every output the scene names in one pass, then one reply. Pump and IC
+// Zone 1 runs without a duration take their single overrides' pulse lengths.
+static void apply_scene(const mqtt_command_t *cmd)
+{
+    const uint8_t pump = 1u << NODE_SCHEDULE_TARGET_PUMP;
+    const uint8_t ic_zone1 = 1u << NODE_SCHEDULE_TARGET_IC_ZONE1;
+    actuator_scene_t scene = cmd->scene;
+    if ((scene.on & pump) && scene.duration_ms[NODE_SCHEDULE_TARGET_PUMP] == 0) {
+        scene.duration_ms[NODE_SCHEDULE_TARGET_PUMP] = PUMP_PULSE_MS;
+    }
+    const char *request_id = cmd->request_id[0] ? cmd->request_id : NULL;
+    ESP_LOGI(TAG, "Scene command: outputs 0x%02x, on 0x%02x", (unsigned)scene.mask, (unsigned)scene.on);
+
+    uint8_t failed = 0;
+    esp_err_t err = actuator_timer_set_scene(&scene, request_id, &failed);
+    if (err != ESP_OK && !failed) {
+        failed = scene.mask & ~ic_zone1;   // nothing was switched
+    }
+    if (scene.mask & ic_zone1) {
+        bool on = (scene.on & ic_zone1) != 0;
+        uint32_t pulse_ms = scene.duration_ms[NODE_SCHEDULE_TARGET_IC_ZONE1];
+        sensors_pulse_ic_zone1(on, pulse_ms > 0 ? pulse_ms : IC_ZONE1_PULSE_MS);
+        sensors_set_ic_zone1_state(on);
+    }
+
+    if (mqtt_client) {
+        actuator_scene_t applied = scene;
+        applied.mask &= ~failed;
+        mqtt_publish_scene_status(mqtt_client, device_id, FW_VERSION, failed ? "scene_partial" : "scene_applied",
+                                  &applied, request_id);
+    }
+}
+
+static void handle_command(const mqtt_command_t *cmd)
+{
+    switch (cmd->type) {
+    case MQTT_CMD_PUMP_OVERRIDE:
+    {
+        if (cmd->pump_on && cmd->water_target_pct > 0) {
+            start_watering(cmd);
+            break;
+        }
+        // A plain pump off also ends a closed-loop run; the watering task
+        // sees the pump stopped and reports the run interrupted
+        uint32_t pulse_ms = cmd->duration_ms > 0 ? cmd->duration_ms : PUMP_PULSE_MS;
+        ESP_LOGI(TAG, "Pump command: %s duration %u ms", cmd->pump_on ? "ON" : "OFF", (unsigned)pulse_ms);
+        const char *request_id = cmd->request_id[0] ? cmd->request_id : NULL;
+        set_timed_output(NODE_SCHEDULE_TARGET_PUMP, cmd->pump_on, pulse_ms, request_id);
+        if (mqtt_client) {
+            mqtt_publish_status(mqtt_client, device_id, FW_VERSION,
+                                cmd->pump_on ? "pump_on" : "pump_off",
+                                request_id);
+        }
+        break;
+    }
+    case MQTT_CMD_IC_ZONE1_OVERRIDE:
+    {
+        uint32_t pulse_ms = cmd->duration_ms > 0 ? cmd->duration_ms : IC_ZONE1_PULSE_MS;
+        ESP_LOGI(TAG, "IC Zone 1 command: %s duration %u ms", cmd->ic_zone1_on ? "ON" : "OFF", (unsigned)pulse_ms);
+        sensors_pulse_ic_zone1(cmd->ic_zone1_on, pulse_ms);
+        sensors_set_ic_zone1_state(cmd->ic_zone1_on);
+        const char *request_id = cmd->request_id[0] ? cmd->request_id : NULL;
+        if (mqtt_client) {
+            mqtt_publish_status(mqtt_client, device_id, FW_VERSION,
+                                cmd->ic_zone1_on ? "ic_zone1_on" : "ic_zone1_off",
+                                request_id);
+        }
+        break;
+    }
+    case MQTT_CMD_FAN_OVERRIDE: {
+        ESP_LOGI(TAG, "Fan command: %s duration %u ms", cmd->fan_on ? "ON" : "OFF", (unsigned)cmd->duration_ms);
+        const char *fan_request_id = cmd->request_id[0] ? cmd->request_id : NULL;
+        set_timed_output(NODE_SCHEDULE_TARGET_FAN, cmd->fan_on, cmd->duration_ms, fan_request_id);
+        if (mqtt_client) {
+            mqtt_publish_status(mqtt_client, device_id, FW_VERSION,
+                                cmd->fan_on ? "fan_on" : "fan_off",
+                                fan_request_id);
+        }
+        break;
+    }
+    case MQTT_CMD_MISTER_OVERRIDE: {
+        ESP_LOGI(TAG, "Mister command: %s duration %u ms", cmd->mister_on ? "ON" : "OFF", (unsigned)cmd->duration_ms);
+        const char *mister_request_id = cmd->request_id[0] ? cmd->request_id : NULL;
+        set_timed_output(NODE_SCHEDULE_TARGET_MISTER, cmd->mister_on, cmd->duration_ms, mister_request_id);
+        if (mqtt_client) {
+            mqtt_publish_status(mqtt_client, device_id, FW_VERSION,
+                                cmd->mister_on ? "mister_on" : "mister_off",
+                                mister_request_id);
+        }
+        break;
+    }
+    case MQTT_CMD_LIGHT_OVERRIDE: {
+        ESP_LOGI(TAG, "Light command: %s duration %u ms", cmd->light_on ? "ON" : "OFF", (unsigned)cmd->duration_ms);
+        const char *light_request_id = cmd->request_id[0] ? cmd->request_id : NULL;
+        set_timed_output(NODE_SCHEDULE_TARGET_LIGHT, cmd->light_on, cmd->duration_ms, light_request_id);
+        if (mqtt_client) {
+            mqtt_publish_status(mqtt_client, device_id, FW_VERSION,
+                                cmd->light_on ? "light_on" : "light_off",
+                                light_request_id);
+        }
+        break;
+    }
+    case MQTT_CMD_SCENE:
+        apply_scene(cmd);
+        break;
+    case MQTT_CMD_SENSOR_READ: {
+        sensor_reading_t reading;
+        xEventGroupWaitBits(boot_events, BOOT_SENSORS_READY, pdFALSE, pdTRUE, portMAX_DELAY);
+        sensors_collect(&reading);
+        if (cmd->request_id[0]) {
+            ESP_LOGI(TAG, "Sensor read command (requestId=%s)", cmd->request_id);
+        } else {
+            ESP_LOGI(TAG, "Sensor read command");
+        }
+        if (mqtt_client) {
+            const char *request_id = cmd->request_id[0] ? cmd->request_id : NULL;
+            mqtt_publish_reading(mqtt_client, device_id, &reading, request_id);
+        }
+        break;
+    }
+    case MQTT_CMD_DIAG_READ:
+        publish_diag(cmd->request_id[0] ? cmd->request_id : NULL);
+        break;
+    case MQTT_CMD_HISTORY_QUERY: {
+        const char *request_id = cmd->request_id[0] ? cmd->request_id : NULL;
+        esp_err_t err = offline_buffer_request_history(cmd->history_from_ms, cmd->history_to_ms, request_id);
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "History query rejected: %s", esp_err_to_name(err));
+        }
+        if (mqtt_client) {
+            mqtt_publish_status(mqtt_client, device_id, FW_VERSION,
+                                err == ESP_OK ? "history_started" : "history_query_failed",
+                                request_id);
+        }
+        break;
+    }
+    case MQTT_CMD_LOG_READ: {
+        const char *request_id = cmd->request_id[0] ? cmd->request_id : NULL;
+        esp_err_t err = mqtt_client ? log_ring_request_upload(mqtt_client, device_id, request_id)
+                                    : ESP_ERR_INVALID_STATE;
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "Log read rejected: %s", esp_err_to_name(err));
+        }
+        if (mqtt_client) {
+            mqtt_publish_status(mqtt_client, device_id, FW_VERSION,
+                                err == ESP_OK ? "log_read_started" : "log_read_failed", request_id);
+        }
+        break;
+    }
+    case MQTT_CMD_CONFIG_UPDATE: {
+        const char *request_id = cmd->request_id[0] ? cmd->request_id : NULL;
+        if (cmd->device_name[0]) {
+            esp_err_t err = device_identity_set_name(cmd->device_name);
+            if (err == ESP_OK) {
+                ESP_LOGI(TAG, "Device name updated to %s", cmd->device_name);
                 if (mqtt_client) {
-                    mqtt_publish_status(mqtt_client, device_id, FW_VERSION,
-                                        cmd.pump_on ? "pump_on" : "pump_off",
-                                        request_id);
-                }
-                if (cmd.pump_on && pulse_ms > 0) {
-                    vTaskDelay(pdMS_TO_TICKS(pulse_ms));
-                    sensors_set_pump_state(false);
-                    if (mqtt_client) {
-                        mqtt_publish_status(mqtt_client, device_id, FW_VERSION, "pump_off", request_id);
-                    }
+                    mqtt_publish_status(mqtt_client, device_id, FW_VERSION, "name_updated", request_id);
                 }
-                break;
-            }
-            case MQTT_CMD_IC_ZONE1_OVERRIDE:
-            {
-                uint32_t pulse_ms = cmd.duration_ms > 0 ? cmd.duration_ms : IC_ZONE1_PULSE_MS;
-                ESP_LOGI(TAG, "IC Zone 1 command: %s duration %u ms", cmd.ic_zone1_on ? "ON" : "OFF", (unsigned)pulse_ms);
-                sensors_pulse_ic_zone1(cmd.ic_zone1_on, pulse_ms);
-                sensors_set_ic_zone1_state(cmd.ic_zone1_on);
-                const char *request_id = cmd.request_id[0] ? cmd.request_id : NULL;
+            } else {
+                ESP_LOGW(TAG, "Failed to update device name: %s", esp_err_to_name(err));
                 if (mqtt_client) {
-                    mqtt_publish_status(mqtt_client, device_id, FW_VERSION,
-                                        cmd.ic_zone1_on ? "ic_zone1_on" : "ic_zone1_off",
-                                        request_id);
+                    mqtt_publish_status(mqtt_client, device_id, FW_VERSION, "name_update_failed", request_id);
                 }
-                break;
             }
-            case MQTT_CMD_FAN_OVERRIDE: {
-                ESP_LOGI(TAG, "Fan command: %s duration %u ms", cmd.fan_on ? "ON" : "OFF", (unsigned)cmd.duration_ms);
-                sensors_set_fan_state(cmd.fan_on);
-                const char *fan_request_id = cmd.request_id[0] ? cmd.request_id : NULL;
+        }
+        if (cmd->has_sensor_mode) {
+            esp_err_t err = device_identity_set_sensor_mode(cmd->sensor_mode);
+            if (err == ESP_OK) {
+                ESP_LOGI(TAG, "Sensor mode updated to %s", device_identity_sensor_mode_label());
                 if (mqtt_client) {
-                    mqtt_publish_status(mqtt_client, device_id, FW_VERSION,
-                                        cmd.fan_on ? "fan_on" : "fan_off",
-                                        fan_request_id);
+                    mqtt_publish_status(mqtt_client, device_id, FW_VERSION, "sensor_mode_updated", request_id);
                 }
-                if (cmd.fan_on && cmd.duration_ms > 0) {
-                    vTaskDelay(pdMS_TO_TICKS(cmd.duration_ms));
-                    sensors_set_fan_state(false);
-                    if (mqtt_client) {
-                        mqtt_publish_status(mqtt_client, device_id, FW_VERSION, "fan_timeout_off", fan_request_id);
-                    }
-                }
-                break;
-            }
-            case MQTT_CMD_MISTER_OVERRIDE: {
-                ESP_LOGI(TAG, "Mister command: %s duration %u ms", cmd.mister_on ? "ON" : "OFF", (unsigned)cmd.duration_ms);
-                sensors_set_mister_state(cmd.mister_on);
-                const char *mister_request_id = cmd.request_id[0] ? cmd.request_id : NULL;
+            } else {
+                ESP_LOGW(TAG, "Failed to update sensor mode: %s", esp_err_to_name(err));
                 if (mqtt_client) {
-                    mqtt_publish_status(mqtt_client, device_id, FW_VERSION,
-                                        cmd.mister_on ? "mister_on" : "mister_off",
-                                        mister_request_id);
+                    mqtt_publish_status(mqtt_client, device_id, FW_VERSION, "sensor_mode_update_failed", request_id);
                 }
-                if (cmd.mister_on && cmd.duration_ms > 0) {
-                    vTaskDelay(pdMS_TO_TICKS(cmd.duration_ms));
-                    sensors_set_mister_state(false);
-                    if (mqtt_client) {
-                        mqtt_publish_status(mqtt_client, device_id, FW_VERSION, "mister_timeout_off", mister_request_id);
-                    }
-                }
-                break;
             }
-            case MQTT_CMD_LIGHT_OVERRIDE: {
-                ESP_LOGI(TAG, "Light command: %s duration %u ms", cmd.light_on ? "ON" : "OFF", (unsigned)cmd.duration_ms);
-                sensors_set_light_state(cmd.light_on);
-                const char *light_request_id = cmd.request_id[0] ? cmd.request_id : NULL;
+        }
+        if (cmd->has_payload_encoding) {
+            esp_err_t err = device_identity_set_payload_encoding(cmd->payload_encoding);
+            if (err == ESP_OK) {
                 if (mqtt_client) {
-                    mqtt_publish_status(mqtt_client, device_id, FW_VERSION,
-                                        cmd.light_on ? "light_on" : "light_off",
-                                        light_request_id);
+                    mqtt_publish_status(mqtt_client, device_id, FW_VERSION, "payload_encoding_updated", request_id);
                 }
-                if (cmd.light_on && cmd.duration_ms > 0) {
-                    vTaskDelay(pdMS_TO_TICKS(cmd.duration_ms));
-                    sensors_set_light_state(false);
-                    if (mqtt_client) {
-                        mqtt_publish_status(mqtt_client, device_id, FW_VERSION, "light_timeout_off", light_request_id);
-                    }
+            } else {
+                ESP_LOGW(TAG, "Failed to update payload encoding: %s", esp_err_to_name(err));
+                if (mqtt_client) {
+                    mqtt_publish_status(mqtt_client, device_id, FW_VERSION, "payload_encoding_update_failed", request_id);
                 }
-                break;
             }
-            case MQTT_CMD_SENSOR_READ: {
-                sensor_reading_t reading;
-                sensors_collect(&reading);
-                if (cmd.request_id[0]) {
-                    ESP_LOGI(TAG, "Sensor read command (requestId=%s)", cmd.request_id);
-                } else {
-                    ESP_LOGI(TAG, "Sensor read command");
+        }
+        if (cmd->has_schedule) {
+            esp_err_t err = node_schedule_set(&cmd->schedule);
+            if (err == ESP_OK) {
+                ESP_LOGI(TAG, "Device schedule updated");
+                if (mqtt_client) {
+                    mqtt_publish_status(mqtt_client, device_id, FW_VERSION, "schedule_updated", request_id);
                 }
+            } else {
+                ESP_LOGW(TAG, "Failed to update device schedule: %s", esp_err_to_name(err));
                 if (mqtt_client) {
-                    const char *request_id = cmd.request_id[0] ? cmd.request_id : NULL;
-                    mqtt_publish_reading(mqtt_client, device_id, &reading, request_id);
+                    mqtt_publish_status(mqtt_client, device_id, FW_VERSION, "schedule_update_failed", request_id);
                 }
-                break;
             }
-            case MQTT_CMD_CONFIG_UPDATE: {
-                const char *request_id = cmd.request_id[0] ? cmd.request_id : NULL;
-                if (cmd.device_name[0]) {
-                    esp_err_t err = device_identity_set_name(cmd.device_name);
-                    if (err == ESP_OK) {
-                        ESP_LOGI(TAG, "Device name updated to %s", cmd.device_name);
-                        if (mqtt_client) {
-                            mqtt_publish_status(mqtt_client, device_id, FW_VERSION, "name_updated", request_id);
-                        }
-                    } else {
-                        ESP_LOGW(TAG, "Failed to update device name: %s", esp_err_to_name(err));
-                        if (mqtt_client) {
-                            mqtt_publish_status(mqtt_client, device_id, FW_VERSION, "name_update_failed", request_id);
-                        }
-                    }
-                }
-                if (cmd.has_sensor_mode) {
-                    esp_err_t err = device_identity_set_sensor_mode(cmd.sensor_mode);
-                    if (err == ESP_OK) {
-                        ESP_LOGI(TAG, "Sensor mode updated to %s", device_identity_sensor_mode_label());
-                        if (mqtt_client) {
-                            mqtt_publish_status(mqtt_client, device_id, FW_VERSION, "sensor_mode_updated", request_id);
-                        }
-                    } else {
-                        ESP_LOGW(TAG, "Failed to update sensor mode: %s", esp_err_to_name(err));
-                        if (mqtt_client) {
-                            mqtt_publish_status(mqtt_client, device_id, FW_VERSION, "sensor_mode_update_failed", request_id);
-                        }
-                    }
-                }
-                if (cmd.has_schedule) {
-                    esp_err_t err = node_schedule_set(&cmd.schedule);
-                    if (err == ESP_OK) {
-                        ESP_LOGI(TAG, "Device schedule updated");
-                        if (mqtt_client) {
-                            mqtt_publish_status(mqtt_client, device_id, FW_VERSION, "schedule_updated", request_id);
-                        }
-                    } else {
-                        ESP_LOGW(TAG, "Failed to update device schedule: %s", esp_err_to_name(err));
-                        if (mqtt_client) {
-                            mqtt_publish_status(mqtt_client, device_id, FW_VERSION, "schedule_update_failed", request_id);
-                        }
-                    }
+        }
+        if (cmd->has_soil_calibration) {
+            esp_err_t err = soil_calibration_set(&cmd->soil_calibration);
+            if (err == ESP_OK) {
+                ESP_LOGI(TAG, "Soil calibration updated (dry %u, wet %u)",
+                         (unsigned)cmd->soil_calibration.raw_dry, (unsigned)cmd->soil_calibration.raw_wet);
+            } else {
+                ESP_LOGW(TAG, "Failed to update soil calibration: %s", esp_err_to_name(err));
+            }
+            if (mqtt_client) {
+                mqtt_publish_status(mqtt_client, device_id, FW_VERSION,
+                                    err == ESP_OK ? "soil_calibration_updated" : "soil_calibration_update_failed",
+                                    request_id);
+            }
+        }
+        if (cmd->has_interval_bounds) {
+            esp_err_t err = measurement_interval_set_bounds(&cmd->interval_bounds);
+            if (err != ESP_OK) {
+                ESP_LOGW(TAG, "Failed to update measurement interval: %s", esp_err_to_name(err));
+            }
+            if (mqtt_client) {
+                mqtt_publish_status(mqtt_client, device_id, FW_VERSION,
+                                    err == ESP_OK ? "interval_updated" : "interval_update_failed",
+                                    request_id);
+            }
+        }
+        if (cmd->report_policy_mask) {
+            esp_err_t err = report_policy_update(&cmd->report_policy, cmd->report_policy_mask);
+            if (err != ESP_OK) {
+                ESP_LOGW(TAG, "Failed to update report policy: %s", esp_err_to_name(err));
+            }
+            if (mqtt_client) {
+                mqtt_publish_status(mqtt_client, device_id, FW_VERSION,
+                                    err == ESP_OK ? "report_policy_updated" : "report_policy_update_failed",
+                                    request_id);
+            }
+        }
+        break;
+    }
+    default:
+        ESP_LOGW(TAG, "Unhandled command type %d", cmd->type);
+        break;
+    }
+}
+
+static void handle_command_task(void *arg)
+{
+    mqtt_command_t cmd;
+    actuator_timer_event_t timeout;
+    watering_result_t watering;
+    int64_t next_diag_us = esp_timer_get_time() + (int64_t)DIAG_PUBLISH_INTERVAL_MS * 1000;
+    while (true) {
+        TickType_t wait = portMAX_DELAY;
+        if (DIAG_PUBLISH_INTERVAL_MS > 0) {
+            int64_t now_us = esp_timer_get_time();
+            if (now_us >= next_diag_us) {
+                publish_diag(NULL);
+                next_diag_us = now_us + (int64_t)DIAG_PUBLISH_INTERVAL_MS * 1000;
+            }
+            wait = pdMS_TO_TICKS((uint32_t)((next_diag_us - now_us) / 1000)) + 1;
+        }
+        QueueSetMemberHandle_t ready = xQueueSelectFromSet(command_events, wait);
+        if (ready == actuator_timeout_queue) {
+            if (xQueueReceive(actuator_timeout_queue, &timeout, 0) == pdTRUE) {
+                handle_actuator_timeout(&timeout);
+            }
+        } else if (ready == command_ready) {
+            if (xSemaphoreTake(command_ready, 0) == pdTRUE && command_lanes_pop(&cmd)) {
+                handle_command(&cmd);
+                if (cmd.received_us > 0) {
+                    latency_hist_record(LATENCY_STAGE_COMMAND, cmd.received_us);
                 }
-                break;
             }
-            default:
-                ESP_LOGW(TAG, "Unhandled command type %d", cmd.type);
-                break;
+        } else if (ready == water_cutoff_event) {
+            if (xSemaphoreTake(water_cutoff_event, 0) == pdTRUE) {
+                handle_water_cutoff();
+            }
+        } else if (ready == watering_done_queue) {
+            if (xQueueReceive(watering_done_queue, &watering, 0) == pdTRUE && mqtt_client) {
+                mqtt_publish_watering_result(mqtt_client, device_id, FW_VERSION, &watering);
             }
         }
     }
 }
 
+#if !CONFIG_PROJECTPLANT_POWER_DEEP_SLEEP
+_Static_assert(SENSOR_SAMPLE_INTERVAL_MS > 0, "the sample interval must be positive");
+
+// Fast sampling splits each measurement interval into SENSOR_SAMPLE_INTERVAL_MS steps
+static uint32_t sample_period_ms(uint32_t interval_ms)
+{
+    if (SENSOR_SAMPLE_INTERVAL_MS < MEASUREMENT_INTERVAL_MS && SENSOR_SAMPLE_INTERVAL_MS < interval_ms) {
+        return SENSOR_SAMPLE_INTERVAL_MS;
+    }
+    return interval_ms;
+}
+
 static void sensor_task(void *arg)
 {
+    static sensor_window_t window;
+    sensor_reading_t sample;
     sensor_reading_t reading;
+    sensors_init_bus();
+    boot_mark(BOOT_SENSORS_READY, "sensors ready");
+    // An output switching wakes us to sample, and so report it, right away
+    if (actuator_state_subscribe(xTaskGetCurrentTaskHandle()) != ESP_OK) {
+        ESP_LOGW(TAG, "Output changes wait for the next sample");
+    }
+    sensor_window_reset(&window);
+    uint32_t sample_ms = sample_period_ms(MEASUREMENT_INTERVAL_MS);
+    uint32_t window_samples = 1;
     while (true) {
-        sensors_collect(&reading);
-        if (measurement_queue) {
-            if (xQueueSend(measurement_queue, &reading, 0) != pdTRUE) {
-                xQueueOverwrite(measurement_queue, &reading);
+        sensors_collect(&sample);
+        // An output or float change closes the window so it is reported at once
+        bool changed = sensor_window_add(&window, &sample);
+        if (changed || window.samples >= window_samples) {
+            sensor_window_finish(&window, &reading);
+            sensor_window_reset(&window);
+            // Unchanged readings are neither published nor buffered
+            if (measurement_queue && report_policy_filter(&reading, esp_timer_get_time())) {
+                if (xQueueSend(measurement_queue, &reading, 0) != pdTRUE) {
+                    xQueueOverwrite(measurement_queue, &reading);
+                }
             }
+            uint32_t interval_ms = measurement_interval_next_ms(&reading);
+            sample_ms = sample_period_ms(interval_ms);
+            window_samples = interval_ms / sample_ms;
+        }
+        // How late the delay ends; with light sleep this includes the wakeup
+        int64_t due_us = esp_timer_get_time() + (int64_t)sample_ms * 1000;
+        if (ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(sample_ms)) == 0) {
+            int64_t late_us = esp_timer_get_time() - due_us;
+            power_manager_note_wake_latency(late_us > 0 ? (uint32_t)(late_us / 1000) : 0);
         }
-        vTaskDelay(pdMS_TO_TICKS(MEASUREMENT_INTERVAL_MS));
     }
 }
 
+#if TELEMETRY_LIVE_BATCH > 1
+// Live readings accumulated for one batch message (short measurement intervals)
+static sensor_reading_t live_batch[TELEMETRY_LIVE_BATCH];
+static size_t live_batch_len;
+
+static void publish_live_reading(const sensor_reading_t *reading)
+{
+    live_batch[live_batch_len++] = *reading;
+    if (live_batch_len == TELEMETRY_LIVE_BATCH) {
+        offline_buffer_publish_live(mqtt_client, device_id, live_batch, live_batch_len);
+        live_batch_len = 0;
+    }
+}
+
+// The link dropped with a partial batch: hand it to the offline buffer
+static void spill_live_batch(void)
+{
+    for (size_t i = 0; i < live_batch_len; ++i) {
+        offline_buffer_store(&live_batch[i]);
+    }
+    live_batch_len = 0;
+}
+#else
+static void publish_live_reading(const sensor_reading_t *reading)
+{
+    offline_buffer_publish_live(mqtt_client, device_id, reading, 1);
+}
+
+static void spill_live_batch(void)
+{
+}
+#endif
+
 static void mqtt_task(void *arg)
 {
     sensor_reading_t reading;
-    vTaskDelay(pdMS_TO_TICKS(2000));
-    if (mqtt_client) {
-        mqtt_publish_status(mqtt_client, device_id, FW_VERSION, "online", NULL);
+    bool announced = false;
+    xEventGroupWaitBits(boot_events, BOOT_STORAGE_READY, pdFALSE, pdTRUE, portMAX_DELAY);
+    TickType_t wait = portMAX_DELAY;
+    while (true) {
+        if (!announced && mqtt_client && offline_buffer_is_connected()) {
+            mqtt_publish_status(mqtt_client, device_id, FW_VERSION, "online", NULL);
+            announced = true;
+        }
+        // Live readings go out as soon as they arrive; the backlog is replayed
+        // in paced steps between them.
+        if (measurement_queue && xQueueReceive(measurement_queue, &reading, wait) == pdTRUE) {
+            bool live = mqtt_client && offline_buffer_is_connected();
+            if (!live) {
+                spill_live_batch();
+            }
+            if (!live && offline_buffer_store(&reading) != ESP_OK && mqtt_client) {
+                // No flash buffer: fall back to the client's in-RAM outbox
+                live = true;
+            }
+            if (live) {
+                publish_live_reading(&reading);
+            }
+        }
+        wait = pdMS_TO_TICKS(offline_buffer_drain_step(mqtt_client, device_id));
     }
+}
+#endif
+
+#if CONFIG_PROJECTPLANT_POWER_DEEP_SLEEP
+_Static_assert(POWER_RTC_PENDING_MAX <= MQTT_READING_BATCH_MAX,
+               "retained readings must fit in one batch message");
+
+static TaskHandle_t duty_task = NULL;
+
+#if !CONFIG_PROJECTPLANT_RELAY_LEAF
+static bool wait_for_broker(int64_t deadline_us)
+{
+    while (!mqtt_client || !offline_buffer_is_connected()) {
+        if (esp_timer_get_time() >= deadline_us) {
+            return false;
+        }
+        vTaskDelay(pdMS_TO_TICKS(100));
+    }
+    return true;
+}
+
+// PUBACKs are forwarded as the notification value; they arrive in publish
+// order, so waiting for the last message covers the ones before it.
+static bool wait_for_puback(int msg_id, int64_t deadline_us)
+{
     while (true) {
-        if (measurement_queue && xQueueReceive(measurement_queue, &reading, portMAX_DELAY) == pdTRUE) {
-            if (mqtt_client) {
-                mqtt_publish_reading(mqtt_client, device_id, &reading, NULL);
+        int64_t left_us = deadline_us - esp_timer_get_time();
+        if (left_us <= 0) {
+            return false;
+        }
+        uint32_t acked = 0;
+        if (xTaskNotifyWait(0, 0, &acked, pdMS_TO_TICKS(left_us / 1000) + 1) == pdTRUE &&
+            (int)acked == msg_id) {
+            return true;
+        }
+    }
+}
+
+#endif
+
+static void retain_reading(const sensor_reading_t *reading)
+{
+    if (power_manager_retain_reading(reading)) {
+        return;
+    }
+    // RTC slots exhausted by a long outage: move them to the flash ring
+    sensor_reading_t retained[POWER_RTC_PENDING_MAX];
+    size_t count = power_manager_retained_readings(retained, POWER_RTC_PENDING_MAX);
+    for (size_t i = 0; i < count; ++i) {
+        offline_buffer_store(&retained[i]);
+    }
+    power_manager_clear_retained_readings();
+    power_manager_retain_reading(reading);
+}
+
+#if !CONFIG_PROJECTPLANT_RELAY_LEAF
+static void publish_retained_readings(int64_t deadline_us)
+{
+    sensor_reading_t retained[POWER_RTC_PENDING_MAX];
+    size_t count = power_manager_retained_readings(retained, POWER_RTC_PENDING_MAX);
+    if (count == 0) {
+        return;
+    }
+    int msg_id = count == 1
+        ? mqtt_publish_reading(mqtt_client, device_id, &retained[0], NULL)
+        : mqtt_publish_reading_batch(mqtt_client, device_id, retained, count, NULL);
+    // Unacknowledged readings stay retained and go out again next wake
+    if (msg_id >= 0 && wait_for_puback(msg_id, deadline_us)) {
+        power_manager_clear_retained_readings();
+    }
+}
+
+static void drain_backlog(int64_t deadline_us)
+{
+    while (offline_buffer_pending() > 0 || offline_buffer_history_active()) {
+        int64_t left_ms = (deadline_us - esp_timer_get_time()) / 1000;
+        if (left_ms <= 0) {
+            return;
+        }
+        uint32_t wait_ms = offline_buffer_drain_step(mqtt_client, device_id);
+        vTaskDelay(pdMS_TO_TICKS(wait_ms < left_ms ? wait_ms : (uint32_t)left_ms));
+    }
+}
+#endif
+
+#if CONFIG_PROJECTPLANT_RELAY_LEAF
+_Static_assert(POWER_RTC_PENDING_MAX <= RELAY_READINGS_MAX,
+               "retained readings must fit in one relay frame");
+
+// A leaf hands its retained readings to the gateway in one frame; the ack
+// also carries the gateway's clock
+static void relay_retained_readings(int64_t deadline_us)
+{
+    int64_t left_us = deadline_us - esp_timer_get_time();
+    if (left_us <= 0 ||
+        !(xEventGroupWaitBits(boot_events, BOOT_NETWORK_UP, pdFALSE, pdTRUE,
+                              pdMS_TO_TICKS(left_us / 1000)) & BOOT_NETWORK_UP)) {
+        return;
+    }
+    sensor_reading_t retained[POWER_RTC_PENDING_MAX];
+    size_t count = power_manager_retained_readings(retained, POWER_RTC_PENDING_MAX);
+    bool had_time = time_sync_is_synced();
+    if (count > 0 && relay_leaf_send(retained, count, deadline_us) == ESP_OK) {
+        power_manager_clear_retained_readings();
+    }
+    if (!had_time && time_sync_is_synced()) {
+        boot_mark(BOOT_TIME_VALID, "time from gateway");
+        node_schedule_kick();
+    }
+}
+#endif
+
+// interval_ms already stops at the next schedule edge, which is applied at boot
+static uint32_t duty_sleep_ms(int64_t cycle_start_us, uint32_t interval_ms)
+{
+    uint32_t awake_ms = (uint32_t)((esp_timer_get_time() - cycle_start_us) / 1000);
+    uint32_t sleep_ms = awake_ms < interval_ms ? interval_ms - awake_ms : 0;
+    return sleep_ms < POWER_MIN_SLEEP_MS ? POWER_MIN_SLEEP_MS : sleep_ms;
+}
+
+// Deep sleep mode replaces the sensor, publishing and ping tasks: sample,
+// publish within POWER_AWAKE_WINDOW_MS, then sleep out the interval
+static void duty_cycle_task(void *arg)
+{
+    duty_task = xTaskGetCurrentTaskHandle();
+    int64_t cycle_start_us = 0;  // the first cycle began at the wake
+    bool first_cycle = true;
+    sensors_init_bus();
+    boot_mark(BOOT_SENSORS_READY, "sensors ready");
+    xEventGroupWaitBits(boot_events, BOOT_STORAGE_READY, pdFALSE, pdTRUE, portMAX_DELAY);
+    while (true) {
+        int64_t deadline_us = esp_timer_get_time() + (int64_t)POWER_AWAKE_WINDOW_MS * 1000;
+        sensor_reading_t reading;
+        sensors_collect(&reading);
+        retain_reading(&reading);
+        uint32_t interval_ms = measurement_interval_next_ms(&reading);
+
+#if CONFIG_PROJECTPLANT_RELAY_LEAF
+        relay_retained_readings(deadline_us);
+        if (first_cycle) {
+            power_manager_note_wake_latency((uint32_t)(esp_timer_get_time() / 1000));
+        }
+#else
+        if (wait_for_broker(deadline_us)) {
+            if (first_cycle) {
+                power_manager_note_wake_latency((uint32_t)(esp_timer_get_time() / 1000));
+                power_stats_t stats;
+                power_manager_get_stats(&stats);
+                if (stats.wake_count % POWER_STATUS_EVERY_WAKES == 0) {
+                    mqtt_publish_status(mqtt_client, device_id, FW_VERSION, "online", NULL);
+                }
             }
+            publish_retained_readings(deadline_us);
+            drain_backlog(deadline_us);
+        }
+#endif
+        first_cycle = false;
+
+        // Runs that need the CPU hold the node up until they finish
+        while (!power_manager_can_deep_sleep() &&
+               esp_timer_get_time() - cycle_start_us < (int64_t)interval_ms * 1000) {
+            vTaskDelay(pdMS_TO_TICKS(1000));
+        }
+        if (power_manager_can_deep_sleep()) {
+            offline_buffer_flush();
+            log_ring_flush();
+            power_manager_deep_sleep(duty_sleep_ms(cycle_start_us, interval_ms));
         }
+        cycle_start_us = esp_timer_get_time();
+    }
+}
+#endif
+
+static void on_mqtt_published(int msg_id)
+{
+    offline_buffer_on_published(msg_id);
+#if CONFIG_PROJECTPLANT_POWER_DEEP_SLEEP
+    if (duty_task) {
+        xTaskNotify(duty_task, (uint32_t)msg_id, eSetValueWithOverwrite);
+    }
+#endif
+}
+
+// Runs on the publishing task once a history query has been streamed
+static void on_history_done(const char *request_id, size_t sent)
+{
+    ESP_LOGI(TAG, "History query answered with %u readings", (unsigned)sent);
+    if (mqtt_client) {
+        mqtt_publish_status(mqtt_client, device_id, FW_VERSION, "history_complete",
+                            request_id[0] ? request_id : NULL);
+    }
+}
+
+// Runs on the log task once a log_read has been uploaded, or has given up
+static void on_log_upload_done(const char *request_id, size_t blocks, esp_err_t result)
+{
+    if (result == ESP_OK) {
+        ESP_LOGI(TAG, "Log read answered with %u blocks", (unsigned)blocks);
+    } else {
+        ESP_LOGW(TAG, "Log read stopped after %u blocks: %s", (unsigned)blocks, esp_err_to_name(result));
+    }
+    if (mqtt_client) {
+        mqtt_publish_status(mqtt_client, device_id, FW_VERSION,
+                            result == ESP_OK ? "log_read_complete" : "log_read_failed",
+                            request_id[0] ? request_id : NULL);
     }
 }
 
+#if !CONFIG_PROJECTPLANT_POWER_DEEP_SLEEP
 static void ping_task(void *arg)
 {
 #if defined(INCLUDE_uxTaskGetStackHighWaterMark) && (INCLUDE_uxTaskGetStackHighWaterMark == 1)
@@ -264,28 +890,31 @@ static void ping_task(void *arg)
         }
     }
 }
+#endif
 
-void app_main(void)
+// Wi-Fi association, then the MQTT client and SNTP. Sensor power-up and the
+// telemetry ring mount run meanwhile; readings taken before the broker is
+// reachable go to the offline buffer, and those taken before the clock is
+// valid carry uptime and are re-stamped when published.
+// SNTP task, on the first answer this boot
+static void on_time_synced(void)
 {
-    esp_err_t nvs_err = nvs_flash_init();
-    if (nvs_err == ESP_ERR_NVS_NO_FREE_PAGES || nvs_err == ESP_ERR_NVS_NEW_VERSION_FOUND) {
-        ESP_ERROR_CHECK(nvs_flash_erase());
-        nvs_err = nvs_flash_init();
-    }
-    ESP_ERROR_CHECK(nvs_err);
-
-    ESP_LOGI(TAG, "Starting ProjectPlant ESP32 node (%s)", FW_VERSION);
-    ESP_LOGI(TAG, "test_var: '%c'", get_char("test_var", '0'));  // DEBUG
-
-    device_identity_init();
-    device_id = device_identity_id();
+    boot_mark(BOOT_TIME_VALID, "time synchronized");
+    node_schedule_kick();
+}
 
-    sensors_init();
-    esp_err_t schedule_init_err = node_schedule_init();
-    if (schedule_init_err != ESP_OK) {
-        ESP_LOGW(TAG, "Failed to initialize node schedule: %s", esp_err_to_name(schedule_init_err));
+static void network_task(void *arg)
+{
+#if CONFIG_PROJECTPLANT_RELAY_LEAF
+    // A leaf never joins the AP; the gateway carries readings and commands
+    esp_err_t relay_err = relay_leaf_start(device_id, mqtt_command_dispatch);
+    if (relay_err != ESP_OK) {
+        ESP_LOGE(TAG, "ESP-NOW relay startup failed: %s", esp_err_to_name(relay_err));
+    } else {
+        boot_mark(BOOT_NETWORK_UP, "relay up");
     }
-
+    vTaskDelete(NULL);
+#endif
     startup_onboarding_state_t onboarding = {0};
     esp_err_t wifi_result = startup_onboarding_run(
         device_id,
@@ -295,7 +924,6 @@ void app_main(void)
         &onboarding);
     if (wifi_result != ESP_OK) {
         ESP_LOGE(TAG, "Network startup failed: %s", esp_err_to_name(wifi_result));
-        vTaskDelay(pdMS_TO_TICKS(5000));
     } else {
         if (onboarding.factory_default) {
             ESP_LOGI(
@@ -303,28 +931,123 @@ void app_main(void)
                 "Factory-default onboarding complete (%s transport)",
                 onboarding.ble_transport ? "BLE" : "SoftAP");
         }
-
-        if (time_sync_init() == ESP_OK) {
-            if (!time_sync_wait_for_valid(pdMS_TO_TICKS(15000))) {
-                ESP_LOGW(TAG, "Time sync timed out; timestamps may be inaccurate");
-            } else {
-                ESP_LOGI(TAG, "Time synchronized successfully");
-            }
-        } else {
-            ESP_LOGW(TAG, "Failed to initialize time sync; timestamps may be inaccurate");
-        }
+        // Nothing re-enters provisioning before a reboot; hand its memory
+        // to the MQTT client and offline buffer
+        startup_onboarding_release(NULL);
+        power_manager_network_ready();
+        boot_mark(BOOT_NETWORK_UP, "network up");
     }
 
-    measurement_queue = xQueueCreate(1, sizeof(sensor_reading_t));
-    command_queue = xQueueCreate(4, sizeof(mqtt_command_t));
-
+    // The broker does not need a synced clock; connect while SNTP runs
     const char *mqtt_uri = onboarding.mqtt_uri[0] ? onboarding.mqtt_uri : MQTT_BROKER_URI;
     ESP_LOGI(TAG, "Using MQTT broker URI: %s", mqtt_uri);
     mqtt_client = mqtt_client_start(mqtt_uri, device_id, MQTT_USERNAME, MQTT_PASSWORD, mqtt_command_dispatch);
+#if CONFIG_PROJECTPLANT_RELAY_GATEWAY
+    if (mqtt_client) {
+        esp_err_t relay_err = relay_gateway_start(mqtt_client, device_id);
+        if (relay_err != ESP_OK) {
+            ESP_LOGW(TAG, "ESP-NOW gateway unavailable: %s", esp_err_to_name(relay_err));
+        }
+    }
+#endif
+
+    // Nothing waits for SNTP: the clock already runs on its estimate
+    if (wifi_result == ESP_OK && time_sync_init(on_time_synced) != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to initialize time sync; timestamps stay estimated");
+    }
+    vTaskDelete(NULL);
+}
+
+void app_main(void)
+{
+    // First, so the ring sees the boot's own lines
+    log_ring_init();
+    esp_err_t nvs_err = nvs_flash_init();
+    if (nvs_err == ESP_ERR_NVS_NO_FREE_PAGES || nvs_err == ESP_ERR_NVS_NEW_VERSION_FOUND) {
+        ESP_ERROR_CHECK(nvs_flash_erase());
+        nvs_err = nvs_flash_init();
+    }
+    ESP_ERROR_CHECK(nvs_err);
+    prefs_init();
+    // Before anything takes a timestamp
+    time_sync_restore();
+    power_manager_init();
+
+    ESP_LOGI(TAG, "Starting ProjectPlant ESP32 node (%s)", FW_VERSION);
+
+    device_identity_init();
+    device_id = device_identity_id();
+    report_policy_init();
+    soil_filter_init();
+    measurement_interval_init();
+
+    sensors_init_outputs();
+    power_manager_restore_outputs();
+    esp_err_t cutoff_err = sensors_start_cutoff_monitor(on_water_cutoff);
+    if (cutoff_err != ESP_OK) {
+        ESP_LOGW(TAG, "Water cutoff interrupt unavailable, polling only: %s", esp_err_to_name(cutoff_err));
+    }
+    node_schedule_t retained_schedule;
+    esp_err_t schedule_init_err = power_manager_retained_schedule(&retained_schedule)
+        ? node_schedule_init_retained(&retained_schedule)
+        : node_schedule_init();
+    if (schedule_init_err != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to initialize node schedule: %s", esp_err_to_name(schedule_init_err));
+    }
+
+    boot_events = xEventGroupCreateStatic(&boot_events_buf);
+    if (time_sync_is_time_valid()) {
+        boot_mark(BOOT_TIME_VALID, "time estimated");
+    }
+    measurement_queue = xQueueCreateStatic(1, sizeof(sensor_reading_t), measurement_queue_storage,
+                                           &measurement_queue_buf);
+    command_lanes_init(&command_ready);
+    command_lanes_set_superseded_callback(on_command_superseded);
+    actuator_timeout_queue = xQueueCreateStatic(ACTUATOR_TIMEOUT_QUEUE_DEPTH, sizeof(actuator_timer_event_t),
+                                                actuator_timeout_queue_storage, &actuator_timeout_queue_buf);
+    water_cutoff_event = xSemaphoreCreateBinaryStatic(&water_cutoff_event_buf);
+    watering_done_queue = xQueueCreateStatic(WATERING_RESULT_QUEUE_DEPTH, sizeof(watering_result_t),
+                                             watering_done_queue_storage, &watering_done_queue_buf);
+    command_events = xQueueCreateSet(1 + ACTUATOR_TIMEOUT_QUEUE_DEPTH + 1 + WATERING_RESULT_QUEUE_DEPTH);
+    xQueueAddToSet(command_ready, command_events);
+    xQueueAddToSet(actuator_timeout_queue, command_events);
+    xQueueAddToSet(water_cutoff_event, command_events);
+    xQueueAddToSet(watering_done_queue, command_events);
+
+    esp_err_t timer_err = actuator_timer_init(actuator_timeout_dispatch);
+    if (timer_err != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to initialize actuator timers: %s", esp_err_to_name(timer_err));
+    }
+    esp_err_t watering_err = watering_init(watering_done_dispatch);
+    if (watering_err != ESP_OK) {
+        ESP_LOGW(TAG, "Closed-loop watering unavailable: %s", esp_err_to_name(watering_err));
+    }
+
+    mqtt_set_link_callbacks(offline_buffer_set_connected, on_mqtt_published, offline_buffer_on_deleted);
+    offline_buffer_set_history_callback(on_history_done);
+    log_ring_set_upload_callback(on_log_upload_done);
+    xTaskCreateStaticPinnedToCore(network_task, "network_task", NETWORK_TASK_STACK, NULL, NETWORK_TASK_PRIORITY,
+                                  network_task_stack, &network_task_tcb, NETWORK_CORE);
+
+#if CONFIG_PROJECTPLANT_POWER_DEEP_SLEEP
+    // Samples, then publishes: the wake's time-critical part is the sampling
+    xTaskCreateStaticPinnedToCore(duty_cycle_task, "duty_task", MQTT_TASK_STACK, NULL, CONTROL_TASK_PRIORITY,
+                                  duty_task_stack, &duty_task_tcb, CONTROL_CORE);
+#else
+    xTaskCreateStaticPinnedToCore(sensor_task, "sensor_task", SENSOR_TASK_STACK, NULL, CONTROL_TASK_PRIORITY,
+                                  sensor_task_stack, &sensor_task_tcb, CONTROL_CORE);
+    xTaskCreateStaticPinnedToCore(mqtt_task, "mqtt_task", MQTT_TASK_STACK, NULL, NETWORK_TASK_PRIORITY,
+                                  mqtt_task_stack, &mqtt_task_tcb, NETWORK_CORE);
+    xTaskCreateStaticPinnedToCore(ping_task, "ping_task", PING_TASK_STACK, NULL, NETWORK_TASK_PRIORITY,
+                                  ping_task_stack, &ping_task_tcb, NETWORK_CORE);
+#endif
+    xTaskCreateStaticPinnedToCore(handle_command_task, "command_task", COMMAND_TASK_STACK, NULL, CONTROL_TASK_PRIORITY,
+                                  command_task_stack, &command_task_tcb, CONTROL_CORE);
+    xTaskCreateStaticPinnedToCore(node_schedule_task, "schedule_task", SCHEDULE_TASK_STACK, NULL,
+                                  CONTROL_TASK_PRIORITY, schedule_task_stack, &schedule_task_tcb, CONTROL_CORE);
 
-    xTaskCreate(sensor_task, "sensor_task", SENSOR_TASK_STACK, NULL, SENSOR_TASK_PRIORITY, NULL);
-    xTaskCreate(mqtt_task, "mqtt_task", MQTT_TASK_STACK, NULL, MQTT_TASK_PRIORITY, NULL);
-    xTaskCreate(handle_command_task, "command_task", COMMAND_TASK_STACK, NULL, MQTT_TASK_PRIORITY, NULL);
-    xTaskCreate(ping_task, "ping_task", PING_TASK_STACK, NULL, MQTT_TASK_PRIORITY, NULL);
-    xTaskCreate(node_schedule_task, "schedule_task", SCHEDULE_TASK_STACK, NULL, MQTT_TASK_PRIORITY, NULL);
+    // Mount the telemetry ring while Wi-Fi associates and the sensors power up
+    offline_buffer_init();
+    log_ring_start();
+    boot_mark(BOOT_STORAGE_READY, "storage ready");
 }
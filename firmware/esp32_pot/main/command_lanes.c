@@ -0,0 +1,316 @@
+#include "command_lanes.h"
+
+#include <string.h>
+
+#include "esp_log.h"
+
+#include "hardware_config.h"
+
+static const char *TAG = "cmd_lanes";
+
+_Static_assert(COMMAND_LANE_COUNT == RUNTIME_DIAG_LANE_COUNT, "diag reports every command lane");
+
+typedef struct {
+    mqtt_command_t *slots;   // arrival order, oldest first
+    size_t len;
+    size_t count;
+    uint32_t drops;
+    uint32_t coalesced;
+} lane_t;
+
+static mqtt_command_t priority_slots[COMMAND_PRIORITY_QUEUE_DEPTH];
+static mqtt_command_t normal_slots[COMMAND_QUEUE_DEPTH];
+static lane_t lanes[COMMAND_LANE_COUNT] = {
+    [COMMAND_LANE_PRIORITY] = {.slots = priority_slots, .len = COMMAND_PRIORITY_QUEUE_DEPTH},
+    [COMMAND_LANE_NORMAL] = {.slots = normal_slots, .len = COMMAND_QUEUE_DEPTH},
+};
+static SemaphoreHandle_t lanes_mutex;
+static StaticSemaphore_t lanes_mutex_buf;
+static SemaphoreHandle_t lanes_ready;
+static StaticSemaphore_t lanes_ready_buf;
+static command_lanes_superseded_cb_t superseded_callback = NULL;
+
+// Request ids dropped by one push, reported once the mutex is released. A
+// priority off can empty the normal lane and replace one priority command.
+static char superseded_ids[COMMAND_QUEUE_DEPTH + 1][MQTT_REQUEST_ID_MAX_LEN];
+static size_t superseded_count;
+
+// Outputs a command switches off, a bit per node_schedule_target_t
+static uint8_t off_mask(const mqtt_command_t *cmd)
+{
+    switch (cmd->type) {
+    case MQTT_CMD_PUMP_OVERRIDE:
+        return cmd->pump_on ? 0 : 1u << NODE_SCHEDULE_TARGET_PUMP;
+    case MQTT_CMD_IC_ZONE1_OVERRIDE:
+        return cmd->ic_zone1_on ? 0 : 1u << NODE_SCHEDULE_TARGET_IC_ZONE1;
+    case MQTT_CMD_FAN_OVERRIDE:
+        return cmd->fan_on ? 0 : 1u << NODE_SCHEDULE_TARGET_FAN;
+    case MQTT_CMD_MISTER_OVERRIDE:
+        return cmd->mister_on ? 0 : 1u << NODE_SCHEDULE_TARGET_MISTER;
+    case MQTT_CMD_LIGHT_OVERRIDE:
+        return cmd->light_on ? 0 : 1u << NODE_SCHEDULE_TARGET_LIGHT;
+    case MQTT_CMD_SCENE:
+        return cmd->scene.mask & ~cmd->scene.on;
+    default:
+        return 0;
+    }
+}
+
+// The output a single override drives; 0 for other commands
+static uint8_t override_mask(mqtt_command_type_t type)
+{
+    switch (type) {
+    case MQTT_CMD_PUMP_OVERRIDE:
+        return 1u << NODE_SCHEDULE_TARGET_PUMP;
+    case MQTT_CMD_IC_ZONE1_OVERRIDE:
+        return 1u << NODE_SCHEDULE_TARGET_IC_ZONE1;
+    case MQTT_CMD_FAN_OVERRIDE:
+        return 1u << NODE_SCHEDULE_TARGET_FAN;
+    case MQTT_CMD_MISTER_OVERRIDE:
+        return 1u << NODE_SCHEDULE_TARGET_MISTER;
+    case MQTT_CMD_LIGHT_OVERRIDE:
+        return 1u << NODE_SCHEDULE_TARGET_LIGHT;
+    default:
+        return 0;
+    }
+}
+
+// Only switches outputs off: a single override off, or a scene of offs
+static bool is_off_command(const mqtt_command_t *cmd)
+{
+    uint8_t off = off_mask(cmd);
+    return off != 0 && (cmd->type != MQTT_CMD_SCENE || off == cmd->scene.mask);
+}
+
+// Each override type drives one output, so the type doubles as the key.
+// History queries for different windows each stream their own records.
+static bool supersedes(const mqtt_command_t *newer, const mqtt_command_t *older)
+{
+    if (newer->type != older->type) {
+        return false;
+    }
+    if (newer->type == MQTT_CMD_HISTORY_QUERY) {
+        return newer->history_from_ms == older->history_from_ms &&
+               newer->history_to_ms == older->history_to_ms;
+    }
+    return override_mask(newer->type) != 0 ||
+           newer->type == MQTT_CMD_SCENE ||
+           newer->type == MQTT_CMD_CONFIG_UPDATE ||
+           newer->type == MQTT_CMD_DIAG_READ ||
+           newer->type == MQTT_CMD_LOG_READ;
+}
+
+// older will not run; keep its request id for the superseded callback unless
+// the command replacing it answers to the same id
+static void note_superseded(const mqtt_command_t *older, const mqtt_command_t *newer)
+{
+    if (!older->request_id[0] || superseded_count == COMMAND_QUEUE_DEPTH + 1 ||
+        (newer && strcmp(older->request_id, newer->request_id) == 0)) {
+        return;
+    }
+    memcpy(superseded_ids[superseded_count++], older->request_id, MQTT_REQUEST_ID_MAX_LEN);
+}
+
+// Config updates carry only the fields they set; keep the older ones the
+// newer update leaves alone
+static void merge_config(mqtt_command_t *into, const mqtt_command_t *from)
+{
+    mqtt_command_t merged = *from;
+    if (!merged.device_name[0]) {
+        memcpy(merged.device_name, into->device_name, sizeof(merged.device_name));
+    }
+    if (!merged.has_sensor_mode && into->has_sensor_mode) {
+        merged.has_sensor_mode = true;
+        merged.sensor_mode = into->sensor_mode;
+    }
+    if (!merged.has_payload_encoding && into->has_payload_encoding) {
+        merged.has_payload_encoding = true;
+        merged.payload_encoding = into->payload_encoding;
+    }
+    if (!merged.has_schedule && into->has_schedule) {
+        merged.has_schedule = true;
+        merged.schedule = into->schedule;
+    }
+    if (!merged.has_soil_calibration && into->has_soil_calibration) {
+        merged.has_soil_calibration = true;
+        merged.soil_calibration = into->soil_calibration;
+    }
+    if (!merged.has_interval_bounds && into->has_interval_bounds) {
+        merged.has_interval_bounds = true;
+        merged.interval_bounds = into->interval_bounds;
+    }
+    uint8_t older_only = into->report_policy_mask & ~from->report_policy_mask;
+    if (older_only & REPORT_POLICY_FIELD_MOISTURE) {
+        merged.report_policy.moisture_pct = into->report_policy.moisture_pct;
+    }
+    if (older_only & REPORT_POLICY_FIELD_TEMPERATURE) {
+        merged.report_policy.temperature_c = into->report_policy.temperature_c;
+    }
+    if (older_only & REPORT_POLICY_FIELD_HUMIDITY) {
+        merged.report_policy.humidity_pct = into->report_policy.humidity_pct;
+    }
+    if (older_only & REPORT_POLICY_FIELD_MAX_SILENCE) {
+        merged.report_policy.max_silence_s = into->report_policy.max_silence_s;
+    }
+    merged.report_policy_mask |= older_only;
+    *into = merged;
+}
+
+// Outputs only the older scene sets keep their state and run
+static void merge_scene(mqtt_command_t *into, const mqtt_command_t *from)
+{
+    actuator_scene_t older = into->scene;
+    *into = *from;
+    uint8_t older_only = older.mask & ~from->scene.mask;
+    for (int t = 0; t < NODE_SCHEDULE_TARGET_COUNT; ++t) {
+        if (older_only & (1u << t)) {
+            into->scene.duration_ms[t] = older.duration_ms[t];
+        }
+    }
+    into->scene.mask |= older_only;
+    into->scene.on |= older.on & older_only;
+}
+
+static void lane_remove(lane_t *lane, size_t index)
+{
+    memmove(&lane->slots[index], &lane->slots[index + 1],
+            (lane->count - index - 1) * sizeof(mqtt_command_t));
+    lane->count--;
+}
+
+static esp_err_t lane_push(lane_t *lane, const mqtt_command_t *cmd)
+{
+    for (size_t i = 0; i < lane->count; ++i) {
+        if (!supersedes(cmd, &lane->slots[i])) {
+            continue;
+        }
+        note_superseded(&lane->slots[i], cmd);
+        if (cmd->type == MQTT_CMD_CONFIG_UPDATE) {
+            merge_config(&lane->slots[i], cmd);
+        } else if (cmd->type == MQTT_CMD_SCENE) {
+            merge_scene(&lane->slots[i], cmd);
+        } else {
+            lane->slots[i] = *cmd;
+        }
+        lane->coalesced++;
+        return ESP_OK;
+    }
+    if (lane->count == lane->len) {
+        lane->drops++;
+        return ESP_ERR_NO_MEM;
+    }
+    lane->slots[lane->count++] = *cmd;
+    return ESP_OK;
+}
+
+esp_err_t command_lanes_init(SemaphoreHandle_t *out_ready)
+{
+    if (!out_ready) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!lanes_mutex) {
+        lanes_mutex = xSemaphoreCreateMutexStatic(&lanes_mutex_buf);
+        lanes_ready = xSemaphoreCreateBinaryStatic(&lanes_ready_buf);
+    }
+    *out_ready = lanes_ready;
+    return ESP_OK;
+}
+
+void command_lanes_set_superseded_callback(command_lanes_superseded_cb_t cb)
+{
+    superseded_callback = cb;
+}
+
+esp_err_t command_lanes_push(const mqtt_command_t *cmd)
+{
+    if (!cmd) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!lanes_mutex) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    bool priority = is_off_command(cmd);
+    xSemaphoreTake(lanes_mutex, portMAX_DELAY);
+    superseded_count = 0;
+    if (priority) {
+        // A pending run of the same output would undo the off once it ran;
+        // pending scenes lose those outputs and go once they have none
+        uint8_t off = off_mask(cmd);
+        lane_t *normal = &lanes[COMMAND_LANE_NORMAL];
+        for (size_t i = normal->count; i-- > 0;) {
+            mqtt_command_t *pending = &normal->slots[i];
+            if (pending->type == MQTT_CMD_SCENE && (pending->scene.mask & off)) {
+                pending->scene.mask &= ~off;
+                pending->scene.on &= ~off;
+                if (pending->scene.mask == 0) {
+                    note_superseded(pending, NULL);
+                    lane_remove(normal, i);
+                }
+                normal->coalesced++;
+            } else if (override_mask(pending->type) & off) {
+                note_superseded(pending, NULL);
+                lane_remove(normal, i);
+                normal->coalesced++;
+            }
+        }
+    }
+    esp_err_t err = lane_push(&lanes[priority ? COMMAND_LANE_PRIORITY : COMMAND_LANE_NORMAL], cmd);
+    xSemaphoreGive(lanes_mutex);
+
+    for (size_t i = 0; i < superseded_count; ++i) {
+        ESP_LOGD(TAG, "Command %s superseded before it ran", superseded_ids[i]);
+        if (superseded_callback) {
+            superseded_callback(superseded_ids[i]);
+        }
+    }
+
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "%s command lane full, dropping command %d", priority ? "Priority" : "Normal", (int)cmd->type);
+        return err;
+    }
+    xSemaphoreGive(lanes_ready);
+    return ESP_OK;
+}
+
+bool command_lanes_pop(mqtt_command_t *out)
+{
+    if (!out || !lanes_mutex) {
+        return false;
+    }
+    bool found = false;
+    size_t left = 0;
+    xSemaphoreTake(lanes_mutex, portMAX_DELAY);
+    for (size_t l = 0; l < COMMAND_LANE_COUNT; ++l) {
+        lane_t *lane = &lanes[l];
+        if (!found && lane->count > 0) {
+            *out = lane->slots[0];
+            lane_remove(lane, 0);
+            found = true;
+        }
+        left += lane->count;
+    }
+    xSemaphoreGive(lanes_mutex);
+
+    if (left > 0) {
+        // One command per wakeup keeps the consumer's other queues served
+        xSemaphoreGive(lanes_ready);
+    }
+    return found;
+}
+
+void command_lanes_get_stats(command_lane_stats_t out[COMMAND_LANE_COUNT])
+{
+    memset(out, 0, COMMAND_LANE_COUNT * sizeof(command_lane_stats_t));
+    if (!lanes_mutex) {
+        return;
+    }
+    xSemaphoreTake(lanes_mutex, portMAX_DELAY);
+    for (size_t l = 0; l < COMMAND_LANE_COUNT; ++l) {
+        out[l].depth = lanes[l].count;
+        out[l].len = lanes[l].len;
+        out[l].drops = lanes[l].drops;
+        out[l].coalesced = lanes[l].coalesced;
+    }
+    xSemaphoreGive(lanes_mutex);
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+#include "plant_mqtt.h"
+
+// Two-lane command dispatch between the MQTT event task and the command task.
+// Commands that only switch outputs off (an override off, a scene of offs) go
+// to the priority lane and are always taken first; everything else waits in
+// the normal lane. Within a lane a later command replaces a pending one it
+// supersedes: the latest override per output, one merged scene, one merged
+// config update, one history query per window, one diag request. A priority
+// off also drops a pending normal-lane override of that output and takes the
+// output out of pending normal-lane scenes. Sensor reads are never merged,
+// each has its own reply. A command that is replaced or dropped this way
+// never runs; its request id goes to the superseded callback instead.
+
+// Same order as runtime_diag_t.command_lanes
+typedef enum {
+    COMMAND_LANE_PRIORITY = 0,
+    COMMAND_LANE_NORMAL,
+    COMMAND_LANE_COUNT,
+} command_lane_t;
+
+typedef struct {
+    uint32_t depth;       // commands waiting now
+    uint32_t len;         // slots in the lane
+    uint32_t drops;       // rejected because the lane was full
+    uint32_t coalesced;   // replaced or merged before they ran
+} command_lane_stats_t;
+
+// Creates the lanes. The returned semaphore is given whenever a command is
+// waiting; add it to the consumer's queue set (it counts as one member).
+esp_err_t command_lanes_init(SemaphoreHandle_t *out_ready);
+
+// Called from command_lanes_push(), after the lanes are unlocked, once per
+// request id that will get no reply of its own
+typedef void (*command_lanes_superseded_cb_t)(const char *request_id);
+
+void command_lanes_set_superseded_callback(command_lanes_superseded_cb_t cb);
+
+// MQTT event task only (one pusher). ESP_ERR_NO_MEM when the command's lane
+// is full.
+esp_err_t command_lanes_push(const mqtt_command_t *cmd);
+
+// Consumer, after taking the ready semaphore: the next command, priority lane
+// first. Gives the semaphore again while more are waiting.
+bool command_lanes_pop(mqtt_command_t *out);
+
+void command_lanes_get_stats(command_lane_stats_t out[COMMAND_LANE_COUNT]);
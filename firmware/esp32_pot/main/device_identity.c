@@ -17,6 +17,7 @@ static char device_id[DEVICE_ID_MAX_LEN];
 static char device_name[DEVICE_NAME_MAX_LEN];
 static bool device_named = false;
 static sensor_mode_t sensor_mode = SENSOR_MODE_FULL;
+static payload_encoding_t payload_encoding = PAYLOAD_ENCODING_JSON;
 static bool identity_ready = false;
 
 static void generate_default_name(const uint8_t *mac)
@@ -40,7 +41,15 @@ void device_identity_init(void)
     device_named = false;
     sensor_mode = SENSOR_MODE_FULL;
 
-    esp_err_t err = prefs_get_str("device", "display_name", device_name, sizeof(device_name), "");
+    // One handle for all boot-time identity reads; a fresh device has no namespace yet
+    prefs_txn_t txn;
+    esp_err_t err = prefs_begin(&txn, "device", false);
+    bool have_prefs = err == ESP_OK;
+    if (!have_prefs && err != ESP_ERR_NVS_NOT_FOUND) {
+        ESP_LOGW(TAG, "Identity load failed (%s); using defaults", esp_err_to_name(err));
+    }
+
+    err = have_prefs ? prefs_txn_get_str(&txn, "display_name", device_name, sizeof(device_name), "") : ESP_OK;
     if (err == ESP_OK) {
         if (device_name[0]) {
             device_named = true;
@@ -53,13 +62,24 @@ void device_identity_init(void)
     }
 
     uint8_t stored_mode = (uint8_t)SENSOR_MODE_FULL;
-    err = prefs_get_u8("device", "sensor_mode", &stored_mode, (uint8_t)SENSOR_MODE_FULL);
+    err = have_prefs ? prefs_txn_get_u8(&txn, "sensor_mode", &stored_mode, (uint8_t)SENSOR_MODE_FULL) : ESP_OK;
     if (err == ESP_OK) {
         sensor_mode = stored_mode == SENSOR_MODE_CONTROL_ONLY ? SENSOR_MODE_CONTROL_ONLY : SENSOR_MODE_FULL;
     } else {
         ESP_LOGW(TAG, "Sensor mode load failed (%s); using default mode", esp_err_to_name(err));
     }
 
+    uint8_t stored_encoding = (uint8_t)PAYLOAD_ENCODING_JSON;
+    err = have_prefs ? prefs_txn_get_u8(&txn, "payload_enc", &stored_encoding, (uint8_t)PAYLOAD_ENCODING_JSON) : ESP_OK;
+    if (err == ESP_OK) {
+        payload_encoding = stored_encoding == PAYLOAD_ENCODING_BINARY ? PAYLOAD_ENCODING_BINARY : PAYLOAD_ENCODING_JSON;
+    } else {
+        ESP_LOGW(TAG, "Payload encoding load failed (%s); using JSON", esp_err_to_name(err));
+    }
+    if (have_prefs) {
+        prefs_end(&txn);
+    }
+
     identity_ready = true;
     ESP_LOGI(TAG, "Device identity: id=%s name=%s named=%s",
              device_id,
@@ -100,7 +120,7 @@ esp_err_t device_identity_set_name(const char *name)
         return ESP_ERR_INVALID_ARG;
     }
 
-    esp_err_t err = prefs_put_str("device", "display_name", name);
+    esp_err_t err = prefs_defer_str("device", "display_name", name);
 
     if (err == ESP_OK) {
         memcpy(device_name, name, len);
@@ -133,7 +153,7 @@ esp_err_t device_identity_set_sensor_mode(sensor_mode_t mode)
         return ESP_ERR_INVALID_ARG;
     }
 
-    esp_err_t err = prefs_put_u8("device", "sensor_mode", (uint8_t)mode);
+    esp_err_t err = prefs_defer_u8("device", "sensor_mode", (uint8_t)mode);
 
     if (err == ESP_OK) {
         sensor_mode = mode;
@@ -142,3 +162,29 @@ esp_err_t device_identity_set_sensor_mode(sensor_mode_t mode)
 
     return err;
 }
+
+payload_encoding_t device_identity_payload_encoding(void)
+{
+    return payload_encoding;
+}
+
+const char *device_identity_payload_encoding_label(void)
+{
+    return payload_encoding == PAYLOAD_ENCODING_BINARY ? "binary" : "json";
+}
+
+esp_err_t device_identity_set_payload_encoding(payload_encoding_t encoding)
+{
+    if (encoding != PAYLOAD_ENCODING_JSON && encoding != PAYLOAD_ENCODING_BINARY) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    esp_err_t err = prefs_defer_u8("device", "payload_enc", (uint8_t)encoding);
+
+    if (err == ESP_OK) {
+        payload_encoding = encoding;
+        ESP_LOGI(TAG, "Payload encoding updated to %s", device_identity_payload_encoding_label());
+    }
+
+    return err;
+}
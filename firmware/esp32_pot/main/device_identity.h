@@ -12,6 +12,12 @@ typedef enum {
     SENSOR_MODE_CONTROL_ONLY = 1,
 } sensor_mode_t;
 
+// Wire format for readings and pings; binary goes to a parallel "/bin" topic
+typedef enum {
+    PAYLOAD_ENCODING_JSON = 0,
+    PAYLOAD_ENCODING_BINARY = 1,
+} payload_encoding_t;
+
 void device_identity_init(void);
 const char *device_identity_id(void);
 const char *device_identity_name(void);
@@ -21,3 +27,6 @@ sensor_mode_t device_identity_sensor_mode(void);
 const char *device_identity_sensor_mode_label(void);
 bool device_identity_sensors_enabled(void);
 esp_err_t device_identity_set_sensor_mode(sensor_mode_t mode);
+payload_encoding_t device_identity_payload_encoding(void);
+const char *device_identity_payload_encoding_label(void);
+esp_err_t device_identity_set_payload_encoding(payload_encoding_t encoding);
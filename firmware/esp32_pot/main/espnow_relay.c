@@ -0,0 +1,460 @@
+#include "espnow_relay.h"
+
+#include <string.h>
+#include <sys/time.h>
+
+#include "esp_attr.h"
+#include "esp_event.h"
+#include "esp_log.h"
+#include "esp_netif.h"
+#include "esp_now.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+#include "sdkconfig.h"
+
+#include "hardware_config.h"
+#include "offline_buffer.h"
+#include "relay_frame.h"
+#include "time_sync.h"
+
+static const char *TAG = "relay";
+
+_Static_assert(RELAY_FRAME_MAX <= ESP_NOW_MAX_DATA_LEN, "a relay frame must fit one ESP-NOW packet");
+
+// A received packet, copied off the Wi-Fi task
+typedef struct {
+    uint8_t mac[ESP_NOW_ETH_ALEN];
+    size_t len;
+    uint8_t data[RELAY_FRAME_MAX];
+} relay_packet_t;
+
+#if CONFIG_PROJECTPLANT_RELAY_GATEWAY
+#define RELAY_RX_DEPTH CONFIG_PROJECTPLANT_RELAY_RX_QUEUE_DEPTH
+#else
+#define RELAY_RX_DEPTH RELAY_LEAF_RX_QUEUE_DEPTH
+#endif
+
+static QueueHandle_t rx_queue;
+static StaticQueue_t rx_queue_buf;
+static uint8_t rx_queue_storage[RELAY_RX_DEPTH * sizeof(relay_packet_t)];
+static QueueHandle_t send_status_queue;
+static StaticQueue_t send_status_queue_buf;
+static uint8_t send_status_queue_storage[sizeof(esp_now_send_status_t)];
+static char local_id[DEVICE_ID_MAX_LEN];
+
+static void on_recv(const esp_now_recv_info_t *info, const uint8_t *data, int len)
+{
+    if (!info || !data || len <= 0 || len > RELAY_FRAME_MAX || !rx_queue) {
+        return;
+    }
+    relay_packet_t packet = {.len = (size_t)len};
+    memcpy(packet.mac, info->src_addr, ESP_NOW_ETH_ALEN);
+    memcpy(packet.data, data, (size_t)len);
+    // Dropped when full; a leaf sends again, a gateway acks again
+    xQueueSend(rx_queue, &packet, 0);
+}
+
+static void on_sent(const uint8_t *mac, esp_now_send_status_t status)
+{
+    (void)mac;
+    xQueueOverwrite(send_status_queue, &status);
+}
+
+static esp_err_t relay_espnow_init(void)
+{
+    rx_queue = xQueueCreateStatic(RELAY_RX_DEPTH, sizeof(relay_packet_t), rx_queue_storage, &rx_queue_buf);
+    send_status_queue = xQueueCreateStatic(1, sizeof(esp_now_send_status_t), send_status_queue_storage,
+                                           &send_status_queue_buf);
+    esp_err_t err = esp_now_init();
+    if (err == ESP_OK) {
+        err = esp_now_register_recv_cb(on_recv);
+    }
+    if (err == ESP_OK) {
+        err = esp_now_register_send_cb(on_sent);
+    }
+    return err;
+}
+
+// Peers use the current channel: the AP's on a gateway, the configured one on a leaf
+static esp_err_t relay_add_peer(const uint8_t *mac)
+{
+    if (esp_now_is_peer_exist(mac)) {
+        return ESP_OK;
+    }
+    esp_now_peer_info_t peer = {
+        .channel = 0,
+        .ifidx = WIFI_IF_STA,
+        .encrypt = false,
+    };
+    memcpy(peer.peer_addr, mac, ESP_NOW_ETH_ALEN);
+    return esp_now_add_peer(&peer);
+}
+
+// Send one frame and wait for the MAC-layer ack (always "delivered" for broadcast)
+static bool relay_send(const uint8_t *mac, const uint8_t *frame, size_t len)
+{
+    if (len == 0) {
+        return false;
+    }
+    xQueueReset(send_status_queue);
+    esp_err_t err = esp_now_send(mac, frame, len);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "ESP-NOW send failed: %s", esp_err_to_name(err));
+        return false;
+    }
+    esp_now_send_status_t status = ESP_NOW_SEND_FAIL;
+    if (xQueueReceive(send_status_queue, &status, pdMS_TO_TICKS(RELAY_SEND_TIMEOUT_MS)) != pdTRUE) {
+        return false;
+    }
+    return status == ESP_NOW_SEND_SUCCESS;
+}
+
+#if CONFIG_PROJECTPLANT_RELAY_GATEWAY
+// A leaf heard from since boot. Owned by the relay task.
+typedef struct {
+    uint8_t mac[ESP_NOW_ETH_ALEN];
+    char device_id[DEVICE_ID_MAX_LEN];
+    size_t command_len;                        // 0 = nothing pending
+    char command[RELAY_COMMAND_MAX];
+    char request_id[MQTT_REQUEST_ID_MAX_LEN];
+} relay_leaf_t;
+
+// A command for a leaf, handed over by the MQTT event task.
+// len > RELAY_COMMAND_MAX means it does not fit an ack and was not copied.
+typedef struct {
+    char device_id[DEVICE_ID_MAX_LEN];
+    char request_id[MQTT_REQUEST_ID_MAX_LEN];
+    size_t len;
+    char payload[RELAY_COMMAND_MAX];
+} relay_command_t;
+
+static relay_leaf_t leaves[MQTT_RELAY_MAX];
+static size_t leaf_count;
+static esp_mqtt_client_handle_t gateway_client;
+#define RELAY_COMMAND_QUEUE_DEPTH CONFIG_PROJECTPLANT_RELAY_COMMAND_QUEUE_DEPTH
+static QueueHandle_t command_queue;
+static StaticQueue_t command_queue_buf;
+static uint8_t command_queue_storage[RELAY_COMMAND_QUEUE_DEPTH * sizeof(relay_command_t)];
+static QueueSetHandle_t relay_events;
+static StaticTask_t relay_task_tcb;
+static StackType_t relay_task_stack[RELAY_TASK_STACK];
+
+static uint64_t epoch_now_ms(void)
+{
+    struct timeval tv;
+    // An estimated clock is not worth handing on
+    if (!time_sync_is_synced() || gettimeofday(&tv, NULL) != 0) {
+        return 0;
+    }
+    return ((uint64_t)tv.tv_sec * 1000ULL) + ((uint64_t)tv.tv_usec / 1000ULL);
+}
+
+static void on_relay_command(const char *device_id, const char *payload, int payload_len)
+{
+    static relay_command_t command;  // MQTT event task only
+    static mqtt_command_scratch_t scratch;
+    if (!payload || payload_len <= 0) {
+        return;
+    }
+    memset(&command, 0, sizeof(command));
+    strncpy(command.device_id, device_id, sizeof(command.device_id) - 1);
+    mqtt_command_t parsed = mqtt_parse_command(payload, payload_len, &scratch);
+    memcpy(command.request_id, parsed.request_id, sizeof(command.request_id));
+    command.len = (size_t)payload_len;
+    if (command.len <= RELAY_COMMAND_MAX) {
+        memcpy(command.payload, payload, command.len);
+    }
+    if (xQueueSend(command_queue, &command, 0) != pdTRUE) {
+        ESP_LOGW(TAG, "Relay busy; dropped command for %s", device_id);
+    }
+}
+
+static relay_leaf_t *find_leaf(const char *device_id)
+{
+    for (size_t i = 0; i < leaf_count; ++i) {
+        if (strcmp(leaves[i].device_id, device_id) == 0) {
+            return &leaves[i];
+        }
+    }
+    return NULL;
+}
+
+// The leaf's slot, added (peer, command subscription) on first contact
+static relay_leaf_t *gateway_leaf(const char *device_id, const uint8_t *mac)
+{
+    relay_leaf_t *leaf = find_leaf(device_id);
+    if (leaf && memcmp(leaf->mac, mac, ESP_NOW_ETH_ALEN) == 0) {
+        return leaf;
+    }
+    if (!leaf && leaf_count == MQTT_RELAY_MAX) {
+        ESP_LOGW(TAG, "Relay full (%d leaves); ignoring %s", MQTT_RELAY_MAX, device_id);
+        return NULL;
+    }
+    esp_err_t err = relay_add_peer(mac);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Cannot add ESP-NOW peer for %s: %s", device_id, esp_err_to_name(err));
+        return NULL;
+    }
+    if (leaf) {
+        // Same device id from a new MAC (board swapped): follow it
+        esp_now_del_peer(leaf->mac);
+        memcpy(leaf->mac, mac, ESP_NOW_ETH_ALEN);
+        return leaf;
+    }
+    err = mqtt_relay_add(gateway_client, device_id);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Commands for %s will not be relayed: %s", device_id, esp_err_to_name(err));
+    }
+    leaf = &leaves[leaf_count++];
+    memset(leaf, 0, sizeof(*leaf));
+    memcpy(leaf->mac, mac, ESP_NOW_ETH_ALEN);
+    strncpy(leaf->device_id, device_id, sizeof(leaf->device_id) - 1);
+    ESP_LOGI(TAG, "Relaying for %s (%u leaves)", device_id, (unsigned)leaf_count);
+    return leaf;
+}
+
+static void gateway_queue_command(const relay_command_t *command)
+{
+    relay_leaf_t *leaf = find_leaf(command->device_id);
+    if (!leaf) {
+        return;
+    }
+    const char *request_id = command->request_id[0] ? command->request_id : NULL;
+    if (command->len > RELAY_COMMAND_MAX) {
+        ESP_LOGW(TAG, "Command for %s is %u bytes; an ack holds %d", leaf->device_id,
+                 (unsigned)command->len, RELAY_COMMAND_MAX);
+        mqtt_publish_status(gateway_client, leaf->device_id, NULL, "command_rejected", request_id);
+        return;
+    }
+    if (leaf->command_len) {
+        ESP_LOGW(TAG, "Replacing undelivered command for %s", leaf->device_id);
+    }
+    memcpy(leaf->command, command->payload, command->len);
+    leaf->command_len = command->len;
+    memcpy(leaf->request_id, command->request_id, sizeof(leaf->request_id));
+}
+
+static void gateway_handle_packet(const relay_packet_t *packet, relay_frame_t *frame)
+{
+    if (!relay_decode(packet->data, packet->len, frame) || frame->type != RELAY_FRAME_READINGS) {
+        ESP_LOGD(TAG, "Ignored %u-byte ESP-NOW packet", (unsigned)packet->len);
+        return;
+    }
+    relay_leaf_t *leaf = gateway_leaf(frame->device_id, packet->mac);
+    if (!leaf) {
+        return;
+    }
+    // Unacked readings stay retained on the leaf for its next wake
+    if (!offline_buffer_is_connected()) {
+        return;
+    }
+    int msg_id = frame->reading_count == 1
+        ? mqtt_publish_reading(gateway_client, leaf->device_id, &frame->readings[0], NULL)
+        : mqtt_publish_reading_batch(gateway_client, leaf->device_id, frame->readings,
+                                     frame->reading_count, NULL);
+    if (msg_id < 0) {
+        return;
+    }
+
+    uint8_t ack[RELAY_FRAME_MAX];
+    size_t len = relay_encode_ack(frame->seq, local_id, epoch_now_ms(),
+                                  leaf->command, leaf->command_len, ack, sizeof(ack));
+    if (relay_send(leaf->mac, ack, len) && leaf->command_len) {
+        mqtt_publish_status(gateway_client, leaf->device_id, NULL, "command_relayed",
+                            leaf->request_id[0] ? leaf->request_id : NULL);
+        leaf->command_len = 0;
+    }
+}
+
+static void gateway_task(void *arg)
+{
+    static relay_packet_t packet;
+    static relay_frame_t frame;
+    static relay_command_t command;
+    while (true) {
+        QueueSetMemberHandle_t ready = xQueueSelectFromSet(relay_events, portMAX_DELAY);
+        if (ready == command_queue && xQueueReceive(command_queue, &command, 0) == pdTRUE) {
+            gateway_queue_command(&command);
+        } else if (ready == rx_queue && xQueueReceive(rx_queue, &packet, 0) == pdTRUE) {
+            gateway_handle_packet(&packet, &frame);
+        }
+    }
+}
+
+esp_err_t relay_gateway_start(esp_mqtt_client_handle_t client, const char *device_id)
+{
+    if (!client || !device_id) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    gateway_client = client;
+    strncpy(local_id, device_id, sizeof(local_id) - 1);
+
+    command_queue = xQueueCreateStatic(RELAY_COMMAND_QUEUE_DEPTH, sizeof(relay_command_t), command_queue_storage,
+                                       &command_queue_buf);
+    relay_events = xQueueCreateSet(RELAY_RX_DEPTH + RELAY_COMMAND_QUEUE_DEPTH);
+    if (!relay_events) {
+        return ESP_ERR_NO_MEM;
+    }
+    esp_err_t err = relay_espnow_init();
+    if (err != ESP_OK) {
+        return err;
+    }
+    xQueueAddToSet(rx_queue, relay_events);
+    xQueueAddToSet(command_queue, relay_events);
+    // Modem sleep would miss frames between beacons
+    esp_wifi_set_ps(WIFI_PS_NONE);
+
+    mqtt_set_relay_callback(on_relay_command);
+    xTaskCreateStaticPinnedToCore(gateway_task, "relay_task", RELAY_TASK_STACK, NULL, NETWORK_TASK_PRIORITY,
+                                  relay_task_stack, &relay_task_tcb, NETWORK_CORE);
+    ESP_LOGI(TAG, "ESP-NOW gateway listening on the AP channel");
+    return ESP_OK;
+}
+#endif
+
+#if CONFIG_PROJECTPLANT_RELAY_LEAF
+#define RELAY_MIN_VALID_TIMESTAMP_MS (1609459200ULL * 1000ULL)
+
+static const uint8_t broadcast_mac[ESP_NOW_ETH_ALEN] = {0xff, 0xff, 0xff, 0xff, 0xff, 0xff};
+
+// The gateway that last acked, kept across deep sleep; until one answers,
+// frames are broadcast. RELAY_LEAF_MAX_MISSES failed sends forget it.
+static RTC_DATA_ATTR uint8_t gateway_mac[ESP_NOW_ETH_ALEN];
+static RTC_DATA_ATTR bool gateway_known;
+static RTC_DATA_ATTR uint8_t gateway_misses;
+static RTC_DATA_ATTR uint8_t leaf_seq;
+static mqtt_command_callback_t leaf_command_cb;
+
+esp_err_t relay_leaf_start(const char *device_id, mqtt_command_callback_t on_command)
+{
+    if (!device_id) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    strncpy(local_id, device_id, sizeof(local_id) - 1);
+    leaf_command_cb = on_command;
+
+    esp_err_t err = esp_netif_init();
+    if (err == ESP_OK) {
+        err = esp_event_loop_create_default();
+        if (err == ESP_ERR_INVALID_STATE) {
+            err = ESP_OK;
+        }
+    }
+    wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
+    if (err == ESP_OK) {
+        err = esp_wifi_init(&cfg);
+    }
+    if (err == ESP_OK) {
+        err = esp_wifi_set_storage(WIFI_STORAGE_RAM);
+    }
+    if (err == ESP_OK) {
+        err = esp_wifi_set_mode(WIFI_MODE_STA);
+    }
+    if (err == ESP_OK) {
+        err = esp_wifi_start();
+    }
+    if (err == ESP_OK) {
+        err = esp_wifi_set_channel(CONFIG_PROJECTPLANT_RELAY_CHANNEL, WIFI_SECOND_CHAN_NONE);
+    }
+    if (err == ESP_OK) {
+        err = relay_espnow_init();
+    }
+    if (err == ESP_OK) {
+        err = relay_add_peer(broadcast_mac);
+    }
+    if (err == ESP_OK && gateway_known && relay_add_peer(gateway_mac) != ESP_OK) {
+        gateway_known = false;
+    }
+    return err;
+}
+
+static void leaf_handle_ack(const uint8_t *mac, const relay_frame_t *frame)
+{
+    gateway_misses = 0;
+    if (!gateway_known || memcmp(gateway_mac, mac, ESP_NOW_ETH_ALEN) != 0) {
+        if (relay_add_peer(mac) == ESP_OK) {
+            memcpy(gateway_mac, mac, ESP_NOW_ETH_ALEN);
+            gateway_known = true;
+            ESP_LOGI(TAG, "Relaying through gateway %s", frame->device_id);
+        }
+    }
+    if (frame->epoch_ms && !time_sync_is_synced()) {
+        time_sync_set_epoch_ms(frame->epoch_ms);
+        ESP_LOGI(TAG, "Clock set from the gateway");
+    }
+    if (frame->command_len && leaf_command_cb) {
+        static mqtt_command_scratch_t scratch;  // ESP-NOW leaf task only
+        mqtt_command_t cmd = mqtt_parse_command(frame->command, (int)frame->command_len, &scratch);
+        cmd.received_us = esp_timer_get_time();
+        if (cmd.type != MQTT_CMD_UNKNOWN) {
+            leaf_command_cb(&cmd);
+        }
+    }
+}
+
+// Wait up to CONFIG_PROJECTPLANT_RELAY_ACK_WAIT_MS for the ack to seq
+static bool leaf_wait_ack(uint8_t seq, int64_t deadline_us)
+{
+    static relay_packet_t packet;
+    static relay_frame_t frame;
+    int64_t until_us = esp_timer_get_time() + (int64_t)CONFIG_PROJECTPLANT_RELAY_ACK_WAIT_MS * 1000;
+    if (until_us > deadline_us) {
+        until_us = deadline_us;
+    }
+    while (true) {
+        int64_t left_us = until_us - esp_timer_get_time();
+        if (left_us <= 0 || xQueueReceive(rx_queue, &packet, pdMS_TO_TICKS(left_us / 1000) + 1) != pdTRUE) {
+            return false;
+        }
+        if (relay_decode(packet.data, packet.len, &frame) && frame.type == RELAY_FRAME_ACK && frame.seq == seq) {
+            leaf_handle_ack(packet.mac, &frame);
+            return true;
+        }
+    }
+}
+
+esp_err_t relay_leaf_send(const sensor_reading_t *readings, size_t count, int64_t deadline_us)
+{
+    if (!readings || count == 0 || count > RELAY_READINGS_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!rx_queue) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    // Uptime stamps mean nothing to the gateway: map them to epoch, or send 0
+    // ("unknown", stamped on arrival) when this clock is not set either
+    sensor_reading_t stamped[RELAY_READINGS_MAX];
+    for (size_t i = 0; i < count; ++i) {
+        stamped[i] = readings[i];
+        if (stamped[i].timestamp_ms < RELAY_MIN_VALID_TIMESTAMP_MS) {
+            stamped[i].timestamp_ms = time_sync_boot_to_epoch_ms(stamped[i].timestamp_ms);
+        }
+    }
+
+    uint8_t frame[RELAY_FRAME_MAX];
+    for (int attempt = 0; attempt < RELAY_LEAF_ATTEMPTS && esp_timer_get_time() < deadline_us; ++attempt) {
+        uint8_t seq = ++leaf_seq;
+        size_t len = relay_encode_readings(seq, local_id, stamped, count, frame, sizeof(frame));
+        if (len == 0) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        xQueueReset(rx_queue);
+        if (!relay_send(gateway_known ? gateway_mac : broadcast_mac, frame, len)) {
+            if (gateway_known && ++gateway_misses >= RELAY_LEAF_MAX_MISSES) {
+                ESP_LOGW(TAG, "Gateway not answering; broadcasting again");
+                esp_now_del_peer(gateway_mac);
+                gateway_known = false;
+            }
+            vTaskDelay(pdMS_TO_TICKS(RELAY_SEND_TIMEOUT_MS));
+            continue;
+        }
+        if (leaf_wait_ack(seq, deadline_us)) {
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_TIMEOUT;
+}
+#endif
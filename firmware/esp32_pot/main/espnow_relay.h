@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+#include <mqtt_client.h>
+
+#include "plant_mqtt.h"
+#include "sensors.h"
+
+// ESP-NOW relay between leaf pots and one Wi-Fi connected gateway
+// (CONFIG_PROJECTPLANT_RELAY_*). A leaf never joins the AP: each wake it
+// sends its retained readings as one frame (relay_frame.h) on the gateway's
+// channel and listens briefly for the ack, which may carry one command from
+// the hub and the gateway's clock. The gateway publishes the readings under
+// the leaf's device id on the usual pots/<id>/... topics, subscribes to the
+// leaf's command topic, and holds the latest command for the leaf until its
+// next frame; "command_relayed" or "command_rejected" (too large for a frame)
+// goes to the leaf's status topic with the request id.
+//
+// Readings are acked once the gateway has queued their publish, so a leaf
+// keeps them while the gateway's broker link is down. Frames are not
+// encrypted; any node on the channel can send readings for any device id.
+
+// Built for the gateway and leaf roles only.
+
+// Gateway: call once the MQTT client exists
+esp_err_t relay_gateway_start(esp_mqtt_client_handle_t client, const char *device_id);
+
+// Leaf: start Wi-Fi on CONFIG_PROJECTPLANT_RELAY_CHANNEL without associating.
+// Commands from acks are parsed and handed to on_command on the caller of
+// relay_leaf_send().
+esp_err_t relay_leaf_start(const char *device_id, mqtt_command_callback_t on_command);
+// Send up to RELAY_READINGS_MAX readings and wait for the gateway's ack,
+// RELAY_LEAF_ATTEMPTS times at most and not past deadline_us (esp_timer).
+// ESP_OK once acked; ESP_ERR_TIMEOUT if no gateway answered.
+esp_err_t relay_leaf_send(const sensor_reading_t *readings, size_t count, int64_t deadline_us);
@@ -9,27 +9,55 @@
 extern const char *WIFI_SSID;
 extern const char *WIFI_PASS;
 
+// Optional static IPv4 for the station interface; leave WIFI_STATIC_IP empty
+// for DHCP. Skips the DHCP exchange on every connect (DNS defaults to the
+// gateway when WIFI_STATIC_DNS is empty).
+#define WIFI_STATIC_IP          ""
+#define WIFI_STATIC_NETMASK     "255.255.255.0"
+#define WIFI_STATIC_GATEWAY     ""
+#define WIFI_STATIC_DNS         ""
+// Time allowed for the cached-AP fast path before falling back to a full scan
+#define WIFI_FAST_CONNECT_TIMEOUT_MS 1500
+
 // MQTT broker configuration
 extern const char *MQTT_BROKER_URI;
 extern const char *MQTT_USERNAME;
 extern const char *MQTT_PASSWORD;
 #define MQTT_PING_TOPIC         "lab/ping"
 #define MQTT_PING_INTERVAL_MS   30000      // send heartbeat ping every 30 s
+#define DIAG_PUBLISH_INTERVAL_MS 600000    // runtime diag message every 10 min; 0 = on request only
 
 // External ADC (ADS1115) + sensor power gating
 // Wiring: ADS1115 @ 0x48 on I2C; AIN0 = soil sensor; AIN1 = battery divider (1M : 330k)
 #define ADS1115_I2C_ADDRESS     0x48
 #define SOIL_ADC_CHANNEL        1           // ADS1115 AIN0
 #define BATTERY_ADC_CHANNEL     0           // ADS1115 AIN1
-#define SOIL_SAMPLES            16
-
-// Soil moisture calibration (ADS1115 counts)
+#define SOIL_SAMPLES            5           // median + MAD trim (soil_filter.h)
+#define SOIL_FILTER_MAD_K       3           // keep samples within K median abs deviations
+#define SOIL_FILTER_MIN_BAND    8           // counts; floor on the keep band (~1 mV at PGA 4.096 V)
+#define BATTERY_SAMPLES         4
+#define BATTERY_DIVIDER_RATIO   ((1000.0f + 330.0f) / 330.0f)   // Vbat = V(AIN1) * ratio
+#define SOIL_ADC_DATA_RATE      ADS1115_DR_860SPS   // ~1.2 ms per conversion
+// ADS1115 ALERT/RDY (open-drain, active low). GPIO_NUM_NC = not wired; the driver
+// then polls the config OS bit instead of waiting for the conversion-ready pulse.
+#define ADS1115_ALERT_RDY_GPIO  GPIO_NUM_NC
+
+// Soil moisture calibration defaults (ADS1115 counts); a soilCalibration
+// config update stores per-device values in NVS
 #define SOIL_SENSOR_RAW_DRY     17040       // Completely dry soil
 #define SOIL_SENSOR_RAW_WET     7507        // Waterlogged soil
 
 // Pump control GPIO (NOT IRRIGATION CONTROLLER H-BRIDGE)
 // Forward run: IN1=HIGH, IN2=LOW; Off: IN1=LOW, IN2=LOW
 #define PUMP_GPIO           GPIO_NUM_23
+#define PUMP_PULSE_MS       10000       // default pump run when a command omits duration_ms
+#define PUMP_FLOW_ML_PER_MIN 0          // measured pump flow; 0 = unknown (maxVolumeMl is ignored)
+
+// Closed-loop watering (watering.h)
+#define WATERING_SAMPLE_INTERVAL_MS 250     // soil burst period during a run
+#define WATERING_TARGET_CONFIRM     2       // samples in a row at target (or failing) before stopping
+#define WATERING_MAX_RUN_MS         120000  // cap on any closed-loop run
+#define WATERING_BACKSTOP_MARGIN_MS 2000    // pump timer armed this far past the run cap
 
 
 // Irrigation Controller Zone 1 (IC Zone 1)
@@ -51,26 +79,106 @@ extern const char *MQTT_PASSWORD;
 // Logic: drive HIGH to enable sensors (pull P-MOSFET gate low via NPN)
 #define SENSOR_EN_GPIO          GPIO_NUM_26
 #define SENSOR_POWER_ON_DELAY_MS 150        // allow sensors/I2C to power-stabilize and I2C settle
+#define SENSOR_ADC_SETTLE_MS    50          // extra margin before ADS1115 sampling
 
 // Water level float switches (active-low), external 100k pull-ups to 3V3_SW
 // On ESP32: GPIO34/35 are input-only and have no internal pull-ups; rely on external pull-ups.
 #define WATER_REFILL_GPIO       GPIO_NUM_34   // Reservoir refill indicator (low = needs refill)
 #define WATER_CUTOFF_GPIO       GPIO_NUM_35   // Immediate pump cutoff level (low = stop pump)
 
-// I2C pins (shared by AHT10 + ADS1115)
+// I2C pins (shared by the T/RH sensor, AHT10 or SHT4x, and the ADS1115)
 #define I2C_SDA_GPIO            GPIO_NUM_21
 #define I2C_SCL_GPIO            GPIO_NUM_22
 #define I2C_PORT_NUM            I2C_NUM_0
+#define I2C_BUS_SPEED_HZ        400000        // AHT10, SHT4x and ADS1115 all support fast mode
+
+// Offline telemetry buffer (store-and-forward to the LittleFS ring)
+#define OFFLINE_DRAIN_BATCH         16      // backlog readings per batch message (<= MQTT_READING_BATCH_MAX)
+#define OFFLINE_DRAIN_INTERVAL_MS   250     // PUBACK poll period while a batch is in flight
+#define OFFLINE_DRAIN_IDLE_MS       5000    // re-check period when idle/offline
+#define OFFLINE_ACK_TIMEOUT_MS      30000   // resend an unacknowledged batch message after this
+#define OFFLINE_LIVE_INFLIGHT_MAX   16      // unacked live readings journaled in RTC memory
+#define OFFLINE_HISTORY_QUEUE_DEPTH 4       // history requests waiting behind the one streaming
+
+// ESP-NOW relay (espnow_relay.h)
+#define RELAY_TASK_STACK            4096
+#define RELAY_LEAF_RX_QUEUE_DEPTH   2
+#define RELAY_SEND_TIMEOUT_MS       100     // wait for the MAC-layer ack of one frame
+#define RELAY_LEAF_ATTEMPTS         3       // frames per wake before the leaf gives up
+#define RELAY_LEAF_MAX_MISSES       3       // failed unicasts before the leaf broadcasts again
+
+// Live readings per batch message; 1 publishes each reading on its own topic.
+// Raise (<= MQTT_READING_BATCH_MAX) when MEASUREMENT_INTERVAL_MS is shortened.
+#define TELEMETRY_LIVE_BATCH        1
+
+// Report-by-exception defaults (report_policy.h); the hub can change them
+// with a reportPolicy config update. REPORT_MAX_SILENCE_S 0 publishes every
+// reading and leaves the deadbands unused.
+#define REPORT_MOISTURE_DEADBAND_PCT    1.0f
+#define REPORT_TEMPERATURE_DEADBAND_C   0.3f
+#define REPORT_HUMIDITY_DEADBAND_PCT    2.0f
+#define REPORT_MAX_SILENCE_S            0
+
+// Power modes (CONFIG_PROJECTPLANT_POWER_*, see power_manager.h). The current
+// figures only feed the avgCurrentUa estimate in status messages; measure the
+// board and adjust.
+#define POWER_PM_MAX_FREQ_MHZ           160
+#define POWER_PM_MIN_FREQ_MHZ           40
+#define POWER_ACTIVE_CURRENT_UA         80000   // Wi-Fi associated, CPU running
+#define POWER_LIGHT_SLEEP_CURRENT_UA    1500    // light sleep incl. sensor rail leakage
+#define POWER_DEEP_SLEEP_CURRENT_UA     150     // deep sleep incl. regulator quiescent
+#define POWER_RTC_PENDING_MAX           8       // unsent readings kept in RTC memory
+#define POWER_AWAKE_WINDOW_MS           15000   // deep sleep: max time awake per wake
+#define POWER_MIN_SLEEP_MS              1000    // deep sleep: shortest sleep worth taking
+#define POWER_STATUS_EVERY_WAKES        10      // deep sleep: status message cadence
+
+// Command lanes (command_lanes.h). Off commands coalesce per output, so five
+// priority slots never drop.
+#define COMMAND_PRIORITY_QUEUE_DEPTH 5
+#define COMMAND_QUEUE_DEPTH          8
 
 // Task configuration
 #define MEASUREMENT_INTERVAL_MS 60000
+// Default bounds of the adaptive interval (measurement_interval.h); a
+// measurementInterval config update changes them per pot. A reading is
+// steady when every field moves slower than these rates.
+#define MEASUREMENT_STEADY_SOIL_PCT_PER_MIN 0.2f
+#define MEASUREMENT_STEADY_TEMP_C_PER_MIN   0.05f
+#define MEASUREMENT_STEADY_RH_PCT_PER_MIN   0.5f
+// Fast sampling: below MEASUREMENT_INTERVAL_MS, samples are taken this often
+// (at most once per measurement interval) and each interval is published as
+// one reading with the means and min/max/stddev (sensor_window.h). Equal to
+// MEASUREMENT_INTERVAL_MS = one sample per reading. Ignored with deep sleep.
+#define SENSOR_SAMPLE_INTERVAL_MS MEASUREMENT_INTERVAL_MS
 #define SENSOR_TASK_STACK       4096
-#define MQTT_TASK_STACK         4096
-#define WIFI_TASK_PRIORITY      5
-#define SENSOR_TASK_PRIORITY    5
-#define MQTT_TASK_PRIORITY      5
-
-// MQTT topics (canonical schema)
-#define SENSORS_TOPIC_FMT       "pots/%s/sensors"
-#define STATUS_TOPIC_FMT        "pots/%s/status"
-#define COMMAND_TOPIC_FMT       "pots/%s/command"
+#define NETWORK_TASK_STACK      4096   // onboarding, SNTP and MQTT start at boot
+// Time base (time_sync.c): the last sync goes to NVS at most this often, or
+// sooner when the drift estimate moves by TIME_DRIFT_SAVE_PPM. Drift is only
+// measured between syncs at least TIME_DRIFT_MIN_SPAN_MS apart.
+#define TIME_SAVE_INTERVAL_MS   (6ULL * 60ULL * 60ULL * 1000ULL)
+#define TIME_DRIFT_MIN_SPAN_MS  (15ULL * 60ULL * 1000ULL)
+#define TIME_DRIFT_SAVE_PPM     200
+#define TIME_DRIFT_MAX_PPM      100000  // 10%: the RC slow clock, uncalibrated
+#define MQTT_TASK_STACK         6144   // batch payloads are built on the stack
+#define WATERING_TASK_STACK     3072
+#define LOG_RING_TASK_STACK     4096   // log_read status replies are built on the stack
+// Task layout: networking shares NETWORK_CORE with the Wi-Fi driver, and
+// sensing, the schedule, command handling and the pump safety path run on
+// CONTROL_CORE above it. Tasks, stacks and queues are allocated statically.
+#if CONFIG_FREERTOS_UNICORE
+#define NETWORK_CORE            0
+#define CONTROL_CORE            0
+#else
+#define NETWORK_CORE            CONFIG_PROJECTPLANT_NETWORK_CORE
+#define CONTROL_CORE            CONFIG_PROJECTPLANT_CONTROL_CORE
+#endif
+#define NETWORK_TASK_PRIORITY   5      // network, MQTT and ping tasks, the relay task
+#define CONTROL_TASK_PRIORITY   7      // sensor, schedule and command tasks
+#define WATERING_TASK_PRIORITY  8      // above the control tasks, below cutoff bookkeeping
+#define LOG_RING_TASK_PRIORITY  2      // below everything it logs for (log_ring.h)
+#define CUTOFF_TASK_STACK       3072
+#define CUTOFF_TASK_PRIORITY    (configMAX_PRIORITIES - 2)  // pump cutoff bookkeeping
+#define GPIO_ISR_FLAGS          ESP_INTR_FLAG_IRAM          // shared GPIO ISR service
+
+// MQTT topics (canonical schema, shared with esp32/fw)
+#include "node_topics.h"
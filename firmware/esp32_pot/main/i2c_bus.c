@@ -0,0 +1,88 @@
+#include "i2c_bus.h"
+
+#include "esp_log.h"
+
+#include "hardware_config.h"
+#include "latency_hist.h"
+
+static const char *TAG = "i2c_bus";
+static i2c_master_bus_handle_t bus = NULL;
+
+esp_err_t i2c_bus_init(void)
+{
+    if (bus) {
+        return ESP_OK;
+    }
+
+    i2c_master_bus_config_t bus_cfg = {
+        .i2c_port = I2C_PORT_NUM,
+        .sda_io_num = I2C_SDA_GPIO,
+        .scl_io_num = I2C_SCL_GPIO,
+        .clk_source = I2C_CLK_SRC_DEFAULT,
+        .glitch_ignore_cnt = 7,
+        .flags.enable_internal_pullup = true,
+    };
+    esp_err_t err = i2c_new_master_bus(&bus_cfg, &bus);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "I2C master bus init failed: %s", esp_err_to_name(err));
+        bus = NULL;
+        return err;
+    }
+    ESP_LOGI(TAG, "I2C master bus on port %d at %u Hz", (int)I2C_PORT_NUM, (unsigned)I2C_BUS_SPEED_HZ);
+    return ESP_OK;
+}
+
+esp_err_t i2c_bus_add_device(uint16_t address, i2c_master_dev_handle_t *out_dev)
+{
+    if (!out_dev) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!bus) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    i2c_device_config_t dev_cfg = {
+        .dev_addr_length = I2C_ADDR_BIT_LEN_7,
+        .device_address = address,
+        .scl_speed_hz = I2C_BUS_SPEED_HZ,
+    };
+    esp_err_t err = i2c_master_bus_add_device(bus, &dev_cfg, out_dev);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Add device 0x%02x failed: %s", (unsigned)address, esp_err_to_name(err));
+    }
+    return err;
+}
+
+esp_err_t i2c_bus_probe(uint16_t address, int timeout_ms)
+{
+    if (!bus) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    return i2c_master_probe(bus, address, timeout_ms);
+}
+
+esp_err_t i2c_bus_transmit(i2c_master_dev_handle_t dev, const uint8_t *data, size_t len, int timeout_ms)
+{
+    int64_t t0 = latency_hist_start();
+    esp_err_t err = i2c_master_transmit(dev, data, len, timeout_ms);
+    latency_hist_record(LATENCY_STAGE_I2C, t0);
+    return err;
+}
+
+esp_err_t i2c_bus_receive(i2c_master_dev_handle_t dev, uint8_t *data, size_t len, int timeout_ms)
+{
+    int64_t t0 = latency_hist_start();
+    esp_err_t err = i2c_master_receive(dev, data, len, timeout_ms);
+    latency_hist_record(LATENCY_STAGE_I2C, t0);
+    return err;
+}
+
+esp_err_t i2c_bus_transmit_receive(i2c_master_dev_handle_t dev,
+                                   const uint8_t *tx, size_t tx_len,
+                                   uint8_t *rx, size_t rx_len,
+                                   int timeout_ms)
+{
+    int64_t t0 = latency_hist_start();
+    esp_err_t err = i2c_master_transmit_receive(dev, tx, tx_len, rx, rx_len, timeout_ms);
+    latency_hist_record(LATENCY_STAGE_I2C, t0);
+    return err;
+}
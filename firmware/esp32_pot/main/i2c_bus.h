@@ -0,0 +1,25 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "driver/i2c_master.h"
+#include "esp_err.h"
+
+// Shared I2C master bus (driver/i2c_master.h) on I2C_PORT_NUM. Each driver
+// adds its device once and keeps the handle; the driver serializes transfers
+// between devices. Devices run at I2C_BUS_SPEED_HZ.
+
+// Create the bus; safe to call again once it exists
+esp_err_t i2c_bus_init(void);
+esp_err_t i2c_bus_add_device(uint16_t address, i2c_master_dev_handle_t *out_dev);
+// ESP_OK when a device ACKs address; ESP_ERR_NOT_FOUND when nothing does
+esp_err_t i2c_bus_probe(uint16_t address, int timeout_ms);
+
+// i2c_master_* transfers, timed for the latency histograms
+esp_err_t i2c_bus_transmit(i2c_master_dev_handle_t dev, const uint8_t *data, size_t len, int timeout_ms);
+esp_err_t i2c_bus_receive(i2c_master_dev_handle_t dev, uint8_t *data, size_t len, int timeout_ms);
+esp_err_t i2c_bus_transmit_receive(i2c_master_dev_handle_t dev,
+                                   const uint8_t *tx, size_t tx_len,
+                                   uint8_t *rx, size_t rx_len,
+                                   int timeout_ms);
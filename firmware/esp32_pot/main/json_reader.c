@@ -0,0 +1,404 @@
+#include "json_reader.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define JSON_READER_MAX_DEPTH 16
+
+typedef struct {
+    const char *js;
+    size_t len;
+    size_t pos;
+    json_tok_t *toks;
+    size_t max_toks;
+    size_t count;
+} json_parser_t;
+
+static int parse_value(json_parser_t *p, int depth);
+
+static void skip_ws(json_parser_t *p)
+{
+    while (p->pos < p->len) {
+        char c = p->js[p->pos];
+        if (c != ' ' && c != '\t' && c != '\n' && c != '\r') {
+            break;
+        }
+        p->pos++;
+    }
+}
+
+static int alloc_token(json_parser_t *p, json_tok_type_t type, size_t start)
+{
+    if (p->count >= p->max_toks) {
+        return JSON_READER_ERR_NOMEM;
+    }
+    json_tok_t *tok = &p->toks[p->count];
+    tok->type = (uint8_t)type;
+    tok->start = (int32_t)start;
+    tok->end = (int32_t)start;
+    tok->size = 0;
+    return (int)p->count++;
+}
+
+static int hex_value(char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+static int parse_string(json_parser_t *p)
+{
+    p->pos++;  // opening quote
+    int idx = alloc_token(p, JSON_TOK_STRING, p->pos);
+    if (idx < 0) {
+        return idx;
+    }
+    while (p->pos < p->len) {
+        char c = p->js[p->pos];
+        if (c == '"') {
+            p->toks[idx].end = (int32_t)p->pos;
+            p->pos++;
+            return idx;
+        }
+        if (c == '\\') {
+            if (++p->pos >= p->len) {
+                break;
+            }
+            switch (p->js[p->pos]) {
+            case '"': case '\\': case '/': case 'b': case 'f': case 'n': case 'r': case 't':
+                break;
+            case 'u':
+                if (p->pos + 4 >= p->len) {
+                    return JSON_READER_ERR_PARTIAL;
+                }
+                for (int i = 1; i <= 4; ++i) {
+                    if (hex_value(p->js[p->pos + i]) < 0) {
+                        return JSON_READER_ERR_INVALID;
+                    }
+                }
+                p->pos += 4;
+                break;
+            default:
+                return JSON_READER_ERR_INVALID;
+            }
+        }
+        p->pos++;
+    }
+    return JSON_READER_ERR_PARTIAL;
+}
+
+static size_t scan_digits(json_parser_t *p)
+{
+    size_t n = 0;
+    while (p->pos < p->len && p->js[p->pos] >= '0' && p->js[p->pos] <= '9') {
+        p->pos++;
+        n++;
+    }
+    return n;
+}
+
+static int parse_number(json_parser_t *p)
+{
+    int idx = alloc_token(p, JSON_TOK_NUMBER, p->pos);
+    if (idx < 0) {
+        return idx;
+    }
+    if (p->js[p->pos] == '-') {
+        p->pos++;
+    }
+    if (scan_digits(p) == 0) {
+        return JSON_READER_ERR_INVALID;
+    }
+    if (p->pos < p->len && p->js[p->pos] == '.') {
+        p->pos++;
+        if (scan_digits(p) == 0) {
+            return JSON_READER_ERR_INVALID;
+        }
+    }
+    if (p->pos < p->len && (p->js[p->pos] == 'e' || p->js[p->pos] == 'E')) {
+        p->pos++;
+        if (p->pos < p->len && (p->js[p->pos] == '+' || p->js[p->pos] == '-')) {
+            p->pos++;
+        }
+        if (scan_digits(p) == 0) {
+            return JSON_READER_ERR_INVALID;
+        }
+    }
+    p->toks[idx].end = (int32_t)p->pos;
+    return idx;
+}
+
+static int parse_literal(json_parser_t *p, const char *word, json_tok_type_t type)
+{
+    size_t n = strlen(word);
+    if (p->len - p->pos < n) {
+        return JSON_READER_ERR_PARTIAL;
+    }
+    if (memcmp(&p->js[p->pos], word, n) != 0) {
+        return JSON_READER_ERR_INVALID;
+    }
+    int idx = alloc_token(p, type, p->pos);
+    if (idx < 0) {
+        return idx;
+    }
+    p->pos += n;
+    p->toks[idx].end = (int32_t)p->pos;
+    return idx;
+}
+
+static int parse_container(json_parser_t *p, int depth, bool is_object)
+{
+    if (depth >= JSON_READER_MAX_DEPTH) {
+        return JSON_READER_ERR_INVALID;
+    }
+    int idx = alloc_token(p, is_object ? JSON_TOK_OBJECT : JSON_TOK_ARRAY, p->pos);
+    if (idx < 0) {
+        return idx;
+    }
+    const char close = is_object ? '}' : ']';
+    p->pos++;
+
+    skip_ws(p);
+    if (p->pos < p->len && p->js[p->pos] == close) {
+        p->pos++;
+        p->toks[idx].end = (int32_t)p->pos;
+        return idx;
+    }
+
+    while (true) {
+        skip_ws(p);
+        if (p->pos >= p->len) {
+            return JSON_READER_ERR_PARTIAL;
+        }
+        if (is_object) {
+            if (p->js[p->pos] != '"') {
+                return JSON_READER_ERR_INVALID;
+            }
+            int key = parse_string(p);
+            if (key < 0) {
+                return key;
+            }
+            skip_ws(p);
+            if (p->pos >= p->len) {
+                return JSON_READER_ERR_PARTIAL;
+            }
+            if (p->js[p->pos] != ':') {
+                return JSON_READER_ERR_INVALID;
+            }
+            p->pos++;
+        }
+        int child = parse_value(p, depth + 1);
+        if (child < 0) {
+            return child;
+        }
+        if (p->toks[idx].size == UINT16_MAX) {
+            return JSON_READER_ERR_NOMEM;
+        }
+        p->toks[idx].size++;
+
+        skip_ws(p);
+        if (p->pos >= p->len) {
+            return JSON_READER_ERR_PARTIAL;
+        }
+        char c = p->js[p->pos++];
+        if (c == close) {
+            p->toks[idx].end = (int32_t)p->pos;
+            return idx;
+        }
+        if (c != ',') {
+            return JSON_READER_ERR_INVALID;
+        }
+    }
+}
+
+static int parse_value(json_parser_t *p, int depth)
+{
+    skip_ws(p);
+    if (p->pos >= p->len) {
+        return JSON_READER_ERR_PARTIAL;
+    }
+    char c = p->js[p->pos];
+    switch (c) {
+    case '{': return parse_container(p, depth, true);
+    case '[': return parse_container(p, depth, false);
+    case '"': return parse_string(p);
+    case 't': return parse_literal(p, "true", JSON_TOK_TRUE);
+    case 'f': return parse_literal(p, "false", JSON_TOK_FALSE);
+    case 'n': return parse_literal(p, "null", JSON_TOK_NULL);
+    default:
+        if (c == '-' || (c >= '0' && c <= '9')) {
+            return parse_number(p);
+        }
+        return JSON_READER_ERR_INVALID;
+    }
+}
+
+int json_reader_parse(const char *js, size_t len, json_tok_t *toks, size_t max_toks)
+{
+    if (!js || !toks || max_toks == 0 || len > INT32_MAX) {
+        return JSON_READER_ERR_INVALID;
+    }
+    json_parser_t p = {
+        .js = js,
+        .len = len,
+        .pos = 0,
+        .toks = toks,
+        .max_toks = max_toks,
+        .count = 0,
+    };
+    int root = parse_value(&p, 0);
+    if (root < 0) {
+        return root;
+    }
+    skip_ws(&p);
+    if (p.pos < p.len) {
+        return JSON_READER_ERR_INVALID;
+    }
+    return (int)p.count;
+}
+
+int json_reader_next(const json_tok_t *toks, int count, int idx)
+{
+    int pending = 1;
+    while (pending > 0 && idx < count) {
+        const json_tok_t *tok = &toks[idx++];
+        pending--;
+        if (tok->type == JSON_TOK_OBJECT) {
+            pending += 2 * tok->size;
+        } else if (tok->type == JSON_TOK_ARRAY) {
+            pending += tok->size;
+        }
+    }
+    return idx;
+}
+
+int json_reader_object_get(const char *js, const json_tok_t *toks, int count, int obj, const char *key)
+{
+    if (obj < 0 || obj >= count || toks[obj].type != JSON_TOK_OBJECT || !key) {
+        return -1;
+    }
+    int idx = obj + 1;
+    for (uint16_t i = 0; i < toks[obj].size && idx + 1 < count; ++i) {
+        if (json_reader_string_equals(js, &toks[idx], key)) {
+            return idx + 1;
+        }
+        idx = json_reader_next(toks, count, idx + 1);
+    }
+    return -1;
+}
+
+bool json_reader_string_equals(const char *js, const json_tok_t *tok, const char *s)
+{
+    if (!tok || tok->type != JSON_TOK_STRING || !s) {
+        return false;
+    }
+    size_t n = (size_t)(tok->end - tok->start);
+    return strlen(s) == n && memcmp(&js[tok->start], s, n) == 0;
+}
+
+static size_t utf8_encode(uint32_t cp, char *out)
+{
+    if (cp < 0x80) {
+        out[0] = (char)cp;
+        return 1;
+    }
+    if (cp < 0x800) {
+        out[0] = (char)(0xC0 | (cp >> 6));
+        out[1] = (char)(0x80 | (cp & 0x3F));
+        return 2;
+    }
+    if (cp < 0x10000) {
+        out[0] = (char)(0xE0 | (cp >> 12));
+        out[1] = (char)(0x80 | ((cp >> 6) & 0x3F));
+        out[2] = (char)(0x80 | (cp & 0x3F));
+        return 3;
+    }
+    out[0] = (char)(0xF0 | (cp >> 18));
+    out[1] = (char)(0x80 | ((cp >> 12) & 0x3F));
+    out[2] = (char)(0x80 | ((cp >> 6) & 0x3F));
+    out[3] = (char)(0x80 | (cp & 0x3F));
+    return 4;
+}
+
+static uint32_t read_hex4(const char *s)
+{
+    uint32_t v = 0;
+    for (int i = 0; i < 4; ++i) {
+        v = (v << 4) | (uint32_t)hex_value(s[i]);
+    }
+    return v;
+}
+
+int json_reader_string_copy(const char *js, const json_tok_t *tok, char *out, size_t out_len)
+{
+    if (!tok || tok->type != JSON_TOK_STRING || !out || out_len == 0) {
+        return -1;
+    }
+    size_t n = 0;
+    int32_t i = tok->start;
+    while (i < tok->end) {
+        char enc[4];
+        size_t enc_len = 1;
+        char c = js[i++];
+        if (c == '\\') {
+            char e = js[i++];  // escapes were validated by the tokenizer
+            switch (e) {
+            case 'b': enc[0] = '\b'; break;
+            case 'f': enc[0] = '\f'; break;
+            case 'n': enc[0] = '\n'; break;
+            case 'r': enc[0] = '\r'; break;
+            case 't': enc[0] = '\t'; break;
+            case 'u': {
+                uint32_t cp = read_hex4(&js[i]);
+                i += 4;
+                if (cp >= 0xD800 && cp <= 0xDBFF) {
+                    // High surrogate must be followed by \uDC00..\uDFFF
+                    if (i + 6 > tok->end || js[i] != '\\' || js[i + 1] != 'u') {
+                        return -1;
+                    }
+                    uint32_t lo = read_hex4(&js[i + 2]);
+                    if (lo < 0xDC00 || lo > 0xDFFF) {
+                        return -1;
+                    }
+                    i += 6;
+                    cp = 0x10000 + (((cp & 0x3FF) << 10) | (lo & 0x3FF));
+                } else if (cp >= 0xDC00 && cp <= 0xDFFF) {
+                    return -1;
+                }
+                enc_len = utf8_encode(cp, enc);
+                break;
+            }
+            default: enc[0] = e; break;  // \" \\ \/
+            }
+        } else {
+            enc[0] = c;
+        }
+        if (n + enc_len >= out_len) {
+            return -1;
+        }
+        memcpy(&out[n], enc, enc_len);
+        n += enc_len;
+    }
+    out[n] = '\0';
+    return (int)n;
+}
+
+bool json_reader_number(const char *js, const json_tok_t *tok, double *out)
+{
+    if (!tok || tok->type != JSON_TOK_NUMBER || !out) {
+        return false;
+    }
+    // strtod needs a terminated copy; the source buffer is not NUL-terminated
+    char buf[40];
+    size_t n = (size_t)(tok->end - tok->start);
+    if (n == 0 || n >= sizeof(buf)) {
+        return false;
+    }
+    memcpy(buf, &js[tok->start], n);
+    buf[n] = '\0';
+    char *end = NULL;
+    *out = strtod(buf, &end);
+    return end == &buf[n];
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// jsmn-style JSON tokenizer: validates a payload in place and records token
+// offsets into a caller-provided array. Nothing is copied or allocated; values
+// are decoded on demand from the original buffer.
+
+typedef enum {
+    JSON_TOK_OBJECT = 1,
+    JSON_TOK_ARRAY,
+    JSON_TOK_STRING,
+    JSON_TOK_NUMBER,
+    JSON_TOK_TRUE,
+    JSON_TOK_FALSE,
+    JSON_TOK_NULL,
+} json_tok_type_t;
+
+typedef struct {
+    int32_t start;   // first byte (strings: just after the opening quote)
+    int32_t end;     // one past the last byte (strings: the closing quote)
+    uint16_t size;   // objects: member count, arrays: element count
+    uint8_t type;    // json_tok_type_t
+} json_tok_t;
+
+#define JSON_READER_ERR_NOMEM    (-1)   // more tokens than the array holds
+#define JSON_READER_ERR_INVALID  (-2)   // malformed JSON
+#define JSON_READER_ERR_PARTIAL  (-3)   // input ended mid-value
+
+// Tokenizes the JSON value in js[0..len); only whitespace may follow it. Tokens
+// are stored in document order (object members as key, value pairs). Returns the
+// token count or a negative JSON_READER_ERR_* code.
+int json_reader_parse(const char *js, size_t len, json_tok_t *toks, size_t max_toks);
+
+// Index of the token following idx and all of its children
+int json_reader_next(const json_tok_t *toks, int count, int idx);
+
+// Value token for key in the object at obj (first match, keys compared
+// byte-wise without escape decoding), or -1 if absent
+int json_reader_object_get(const char *js, const json_tok_t *toks, int count, int obj, const char *key);
+
+// True if the string token equals s byte-for-byte
+bool json_reader_string_equals(const char *js, const json_tok_t *tok, const char *s);
+
+// Decodes a string token (escapes and \uXXXX to UTF-8) into out. Returns the
+// decoded length, or -1 if it does not fit in out_len - 1 bytes.
+int json_reader_string_copy(const char *js, const json_tok_t *tok, char *out, size_t out_len);
+
+bool json_reader_number(const char *js, const json_tok_t *tok, double *out);
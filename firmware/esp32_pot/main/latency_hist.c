@@ -0,0 +1,57 @@
+#include "latency_hist.h"
+
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+
+const uint32_t latency_bucket_upper_us[LATENCY_BUCKET_COUNT - 1] = {
+    100, 300, 1000, 3000, 10000, 30000, 100000, 300000, 1000000,
+};
+
+static const char *const stage_names[LATENCY_STAGE_COUNT] = {
+    [LATENCY_STAGE_SENSOR_COLLECT] = "sensorCollect",
+    [LATENCY_STAGE_PUBLISH_READING] = "publishReading",
+    [LATENCY_STAGE_COMMAND] = "command",
+    [LATENCY_STAGE_I2C] = "i2c",
+    [LATENCY_STAGE_NVS_COMMIT] = "nvsCommit",
+};
+
+const char *latency_stage_name(latency_stage_t stage)
+{
+    return stage < LATENCY_STAGE_COUNT ? stage_names[stage] : "unknown";
+}
+
+#if CONFIG_PROJECTPLANT_LATENCY_HISTOGRAMS
+static latency_hist_t hists[LATENCY_STAGE_COUNT];
+static portMUX_TYPE hist_lock = portMUX_INITIALIZER_UNLOCKED;
+
+void latency_hist_record(latency_stage_t stage, int64_t start_us)
+{
+    if (stage >= LATENCY_STAGE_COUNT) {
+        return;
+    }
+    int64_t elapsed = esp_timer_get_time() - start_us;
+    uint32_t us = elapsed <= 0 ? 0 : elapsed >= UINT32_MAX ? UINT32_MAX : (uint32_t)elapsed;
+    size_t bucket = 0;
+    while (bucket < LATENCY_BUCKET_COUNT - 1 && us >= latency_bucket_upper_us[bucket]) {
+        ++bucket;
+    }
+
+    portENTER_CRITICAL(&hist_lock);
+    latency_hist_t *hist = &hists[stage];
+    hist->count++;
+    hist->total_us += us;
+    if (us > hist->max_us) {
+        hist->max_us = us;
+    }
+    hist->buckets[bucket]++;
+    portEXIT_CRITICAL(&hist_lock);
+}
+
+void latency_hist_snapshot(latency_hist_t out[LATENCY_STAGE_COUNT])
+{
+    portENTER_CRITICAL(&hist_lock);
+    memcpy(out, hists, sizeof(hists));
+    portEXIT_CRITICAL(&hist_lock);
+}
+#endif
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "esp_timer.h"
+#include "sdkconfig.h"
+
+// Fixed-bucket latency histograms for the hot paths, reported on the diag
+// topic. Compiled in with CONFIG_PROJECTPLANT_LATENCY_HISTOGRAMS; without it
+// the calls below are empty inlines and no timestamps are taken.
+//
+//   int64_t t0 = latency_hist_start();
+//   ...
+//   latency_hist_record(LATENCY_STAGE_I2C, t0);
+//
+// Buckets are 1-3-10 spaced; counts accumulate from boot.
+
+typedef enum {
+    LATENCY_STAGE_SENSOR_COLLECT = 0,   // sensors_collect()
+    LATENCY_STAGE_PUBLISH_READING,      // mqtt_publish_reading(), incl. the client enqueue
+    LATENCY_STAGE_COMMAND,              // command received to its status published
+    LATENCY_STAGE_I2C,                  // one I2C transfer
+    LATENCY_STAGE_NVS_COMMIT,           // one nvs_commit()
+    LATENCY_STAGE_COUNT,
+} latency_stage_t;
+
+#define LATENCY_BUCKET_COUNT 10
+
+typedef struct {
+    uint32_t count;
+    uint32_t max_us;
+    uint64_t total_us;
+    uint32_t buckets[LATENCY_BUCKET_COUNT];
+} latency_hist_t;
+
+// Upper bound (exclusive) of every bucket but the last, which is open-ended
+extern const uint32_t latency_bucket_upper_us[LATENCY_BUCKET_COUNT - 1];
+
+// Short camelCase name for payloads
+const char *latency_stage_name(latency_stage_t stage);
+
+#if CONFIG_PROJECTPLANT_LATENCY_HISTOGRAMS
+static inline int64_t latency_hist_start(void)
+{
+    return esp_timer_get_time();
+}
+
+// Any task; not from an ISR
+void latency_hist_record(latency_stage_t stage, int64_t start_us);
+void latency_hist_snapshot(latency_hist_t out[LATENCY_STAGE_COUNT]);
+#else
+static inline int64_t latency_hist_start(void)
+{
+    return 0;
+}
+
+static inline void latency_hist_record(latency_stage_t stage, int64_t start_us)
+{
+    (void)stage;
+    (void)start_us;
+}
+#endif
@@ -0,0 +1,164 @@
+#include "log_deflate.h"
+
+#include <stdbool.h>
+#include <string.h>
+
+#define MIN_MATCH 3
+#define MAX_MATCH 258
+#define END_OF_BLOCK 256
+
+// RFC 1951 3.2.5: length codes 257..285 and distance codes 0..29
+static const uint16_t length_base[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258,
+};
+static const uint8_t length_extra[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0,
+};
+static const uint16_t dist_base[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577,
+};
+static const uint8_t dist_extra[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13,
+};
+
+typedef struct {
+    uint8_t *out;
+    size_t cap;
+    size_t len;
+    uint32_t bits;
+    unsigned count;
+    bool overflow;
+} bit_writer_t;
+
+// Extra bits and header fields go out least significant bit first
+static void put_bits(bit_writer_t *w, uint32_t value, unsigned n)
+{
+    w->bits |= value << w->count;
+    w->count += n;
+    while (w->count >= 8) {
+        if (w->len < w->cap) {
+            w->out[w->len++] = (uint8_t)w->bits;
+        } else {
+            w->overflow = true;
+        }
+        w->bits >>= 8;
+        w->count -= 8;
+    }
+}
+
+// Huffman codes go out most significant bit first
+static void put_code(bit_writer_t *w, uint32_t code, unsigned n)
+{
+    uint32_t reversed = 0;
+    for (unsigned i = 0; i < n; ++i) {
+        reversed = (reversed << 1) | ((code >> i) & 1u);
+    }
+    put_bits(w, reversed, n);
+}
+
+// The fixed literal/length code (RFC 1951 3.2.6)
+static void put_symbol(bit_writer_t *w, unsigned symbol)
+{
+    if (symbol < 144) {
+        put_code(w, 0x30 + symbol, 8);
+    } else if (symbol < 256) {
+        put_code(w, 0x190 + (symbol - 144), 9);
+    } else if (symbol < 280) {
+        put_code(w, symbol - 256, 7);
+    } else {
+        put_code(w, 0xc0 + (symbol - 280), 8);
+    }
+}
+
+static void put_match(bit_writer_t *w, unsigned length, unsigned distance)
+{
+    unsigned code = 28;
+    while (length_base[code] > length) {
+        --code;
+    }
+    put_symbol(w, 257 + code);
+    put_bits(w, length - length_base[code], length_extra[code]);
+
+    code = 29;
+    while (dist_base[code] > distance) {
+        --code;
+    }
+    put_code(w, code, 5);
+    put_bits(w, distance - dist_base[code], dist_extra[code]);
+}
+
+static uint32_t hash3(const uint8_t *p)
+{
+    uint32_t v = (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16);
+    return (v * 2654435761u) >> (32 - LOG_DEFLATE_HASH_BITS);
+}
+
+static size_t stored_block(const uint8_t *in, size_t in_len, uint8_t *out, size_t cap)
+{
+    if (cap < LOG_DEFLATE_BOUND(in_len)) {
+        return 0;
+    }
+    out[0] = 0x01;  // BFINAL, BTYPE 00
+    out[1] = (uint8_t)in_len;
+    out[2] = (uint8_t)(in_len >> 8);
+    out[3] = (uint8_t)~in_len;
+    out[4] = (uint8_t)(~in_len >> 8);
+    if (in_len) {
+        memcpy(out + 5, in, in_len);
+    }
+    return LOG_DEFLATE_BOUND(in_len);
+}
+
+size_t log_deflate(log_deflate_state_t *state, const uint8_t *in, size_t in_len, uint8_t *out, size_t cap)
+{
+    if (!state || (!in && in_len) || !out || in_len > LOG_DEFLATE_MAX_INPUT) {
+        return 0;
+    }
+    memset(state->head, 0, sizeof(state->head));
+    bit_writer_t w = {.out = out, .cap = cap};
+    put_bits(&w, 1, 1);  // BFINAL
+    put_bits(&w, 1, 2);  // BTYPE 01, fixed codes
+
+    size_t i = 0;
+    while (i < in_len && !w.overflow) {
+        size_t length = 0;
+        size_t candidate = 0;
+        if (in_len - i >= MIN_MATCH) {
+            uint32_t h = hash3(&in[i]);
+            candidate = state->head[h];
+            state->head[h] = (uint16_t)(i + 1);
+            if (candidate && memcmp(&in[candidate - 1], &in[i], MIN_MATCH) == 0) {
+                size_t limit = in_len - i < MAX_MATCH ? in_len - i : MAX_MATCH;
+                length = MIN_MATCH;
+                while (length < limit && in[candidate - 1 + length] == in[i + length]) {
+                    ++length;
+                }
+            }
+        }
+        if (!length) {
+            put_symbol(&w, in[i]);
+            ++i;
+            continue;
+        }
+        put_match(&w, (unsigned)length, (unsigned)(i + 1 - candidate));
+        // Index the positions the match covers so later text can refer to them
+        size_t end = i + length;
+        for (++i; i < end && in_len - i >= MIN_MATCH; ++i) {
+            state->head[hash3(&in[i])] = (uint16_t)(i + 1);
+        }
+        i = end;
+    }
+    put_symbol(&w, END_OF_BLOCK);
+    if (w.count) {
+        put_bits(&w, 0, 8 - w.count);  // pad to a byte boundary
+    }
+
+    if (w.overflow || w.len >= LOG_DEFLATE_BOUND(in_len)) {
+        return stored_block(in, in_len, out, cap);
+    }
+    return w.len;
+}
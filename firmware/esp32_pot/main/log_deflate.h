@@ -0,0 +1,23 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Raw DEFLATE (RFC 1951) for buffers of a few KB, as zlib's inflate with
+// wbits -15 reads it. The whole input goes out as one final block coded
+// with the fixed Huffman tables, so there are no code tables to build or
+// send; matches come from a single-probe hash on the next three bytes.
+// Input that does not shrink is sent as a stored block instead.
+
+#define LOG_DEFLATE_HASH_BITS 10
+#define LOG_DEFLATE_MAX_INPUT 32768      // the DEFLATE window, so any match distance is valid
+// Output never exceeds this: a stored block is the input plus 5 bytes
+#define LOG_DEFLATE_BOUND(len) ((len) + 5)
+
+typedef struct {
+    uint16_t head[1u << LOG_DEFLATE_HASH_BITS];  // last position + 1 per hash, 0 = none
+} log_deflate_state_t;
+
+// Return the compressed length, or 0 if in_len exceeds LOG_DEFLATE_MAX_INPUT
+// or cap is below LOG_DEFLATE_BOUND(in_len) and the coded block did not fit
+size_t log_deflate(log_deflate_state_t *state, const uint8_t *in, size_t in_len, uint8_t *out, size_t cap);
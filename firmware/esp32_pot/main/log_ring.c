@@ -0,0 +1,629 @@
+#include "log_ring.h"
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "esp_littlefs.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+#include "hardware_config.h"
+#include "log_deflate.h"
+#include "plant_mqtt.h"
+#include "time_sync.h"
+
+static const char *TAG = "log_ring";
+
+#define LOG_RING_BASE_PATH "/storage"
+#define LOG_RING_PATH_FMT LOG_RING_BASE_PATH "/log%02u.bin"
+#define LOG_RING_MAGIC 0x474F4C50u  // 'PLOG'
+#define LOG_RING_BLOCKS CONFIG_PROJECTPLANT_LOG_RING_BLOCKS
+#define LOG_RING_BLOCK_SIZE CONFIG_LITTLEFS_BLOCK_SIZE     // a file never spans two littlefs blocks
+#define LOG_RING_LEVEL CONFIG_PROJECTPLANT_LOG_RING_LEVEL
+#define LOG_RING_QUEUE_BYTES CONFIG_PROJECTPLANT_LOG_RING_QUEUE_BYTES
+#define LOG_RING_FLUSH_US ((int64_t)CONFIG_PROJECTPLANT_LOG_RING_FLUSH_SEC * 1000000)
+#define LOG_RING_TEXT_MAX 160                   // longer lines are cut
+#define LOG_RING_LINE_MAX (LOG_RING_TEXT_MAX + 32)  // plus the console prefix and color codes
+#define LOG_RING_EVENT 0                        // record level of ring events
+#define LOG_RING_URGENT_GAP_US 1000000          // error lines are written at most this often
+#define LOG_RING_IDLE_MS 1000                   // queue drain period when nothing wakes the task
+#define LOG_RING_UPLOAD_GAP_MS 20               // between blocks while the outbox has room
+#define LOG_RING_UPLOAD_RETRY_MS 1000           // outbox busy or the publish refused
+#define LOG_RING_UPLOAD_RETRIES 30
+#define LOG_RING_UPLOAD_OUTBOX_MAX (CONFIG_PROJECTPLANT_MQTT_OUTBOX_LIMIT_BYTES / 2)  // the rest stays for readings
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint32_t seq;          // file = seq % LOG_RING_BLOCKS
+    uint16_t boot;         // of the newest record
+    uint16_t used;         // record bytes after the header
+} log_block_header_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t uptime_ms;
+    uint16_t boot;
+    uint8_t level;         // esp_log_level_t, or LOG_RING_EVENT
+    uint8_t len;           // text bytes that follow
+} log_record_t;
+
+#define LOG_RING_DATA_MAX (LOG_RING_BLOCK_SIZE - sizeof(log_block_header_t))
+
+_Static_assert(sizeof(log_block_header_t) == 12 && sizeof(log_record_t) == 8, "log_ring.h documents these layouts");
+_Static_assert(LOG_RING_DATA_MAX <= UINT16_MAX && LOG_RING_BLOCK_SIZE <= LOG_DEFLATE_MAX_INPUT, "block too large");
+_Static_assert(LOG_RING_TEXT_MAX <= UINT8_MAX, "record text length is a u8");
+
+typedef struct {
+    log_block_header_t header;
+    uint8_t data[LOG_RING_DATA_MAX];
+} log_block_t;
+
+// Work buffers for an upload, allocated while one runs
+typedef struct {
+    log_deflate_state_t deflate;
+    uint8_t records[LOG_RING_DATA_MAX];
+    uint8_t payload[MQTT_BIN_LOG_HEADROOM + LOG_DEFLATE_BOUND(LOG_RING_DATA_MAX)];
+} log_upload_buffers_t;
+
+// Queue from the hook to the task: records and their text back to back in
+// a byte ring. The request slot shares its lock.
+static portMUX_TYPE s_queue_lock = portMUX_INITIALIZER_UNLOCKED;
+static uint8_t s_queue[LOG_RING_QUEUE_BYTES];
+static size_t s_queue_start;
+static size_t s_queue_used;
+static uint32_t s_dropped;                  // lines lost to a full queue, not yet recorded
+static struct {
+    bool pending;
+    esp_mqtt_client_handle_t client;
+    const char *device_id;
+    char request_id[MQTT_REQUEST_ID_MAX_LEN];
+} s_request;
+
+static vprintf_like_t s_console = NULL;
+static TaskHandle_t s_task = NULL;
+static StaticTask_t s_task_tcb;
+static StackType_t s_task_stack[LOG_RING_TASK_STACK];
+static log_ring_upload_done_callback_t s_upload_done = NULL;
+
+// The open block and the files, under s_lock
+static StaticSemaphore_t s_lock_buf;
+static SemaphoreHandle_t s_lock = NULL;
+static bool s_ready = false;
+static uint16_t s_boot = 0;
+static uint32_t s_first_seq = 0;            // oldest block that can still be on flash
+static log_block_t s_block;
+static bool s_dirty = false;                // records not yet written
+static bool s_urgent = false;               // an error line among them
+static int64_t s_dirty_since_us = 0;
+static int64_t s_written_us = 0;
+static int s_clock_state = 0;               // 'c' record written for: 1 estimated, 2 synced
+
+// Upload state, log task only
+static struct {
+    bool active;
+    esp_mqtt_client_handle_t client;
+    const char *device_id;
+    char request_id[MQTT_REQUEST_ID_MAX_LEN];
+    uint32_t next_seq;
+    uint32_t last_seq;
+    size_t sent;
+    uint32_t retries;
+    log_upload_buffers_t *buf;
+} s_upload;
+
+// Queue: callers hold s_queue_lock
+
+static void queue_put(const void *data, size_t len)
+{
+    size_t at = (s_queue_start + s_queue_used) % LOG_RING_QUEUE_BYTES;
+    size_t first = len < LOG_RING_QUEUE_BYTES - at ? len : LOG_RING_QUEUE_BYTES - at;
+    memcpy(&s_queue[at], data, first);
+    memcpy(s_queue, (const uint8_t *)data + first, len - first);
+    s_queue_used += len;
+}
+
+static void queue_take(void *out, size_t len)
+{
+    size_t first = len < LOG_RING_QUEUE_BYTES - s_queue_start ? len : LOG_RING_QUEUE_BYTES - s_queue_start;
+    memcpy(out, &s_queue[s_queue_start], first);
+    memcpy((uint8_t *)out + first, s_queue, len - first);
+    s_queue_start = (s_queue_start + len) % LOG_RING_QUEUE_BYTES;
+    s_queue_used -= len;
+}
+
+// Hook
+
+// esp_log formats start with the level letter, after the color code when
+// CONFIG_LOG_COLORS is set: "\033[0;33mW (%lu) %s: ..."
+static esp_log_level_t line_level(const char *format)
+{
+    if (format[0] == '\033') {
+        const char *end = strchr(format, 'm');
+        if (!end) {
+            return ESP_LOG_NONE;
+        }
+        format = end + 1;
+    }
+    if (format[0] == '\0' || format[1] != ' ' || format[2] != '(') {
+        return ESP_LOG_NONE;
+    }
+    switch (format[0]) {
+    case 'E': return ESP_LOG_ERROR;
+    case 'W': return ESP_LOG_WARN;
+    case 'I': return ESP_LOG_INFO;
+    case 'D': return ESP_LOG_DEBUG;
+    case 'V': return ESP_LOG_VERBOSE;
+    default: return ESP_LOG_NONE;
+    }
+}
+
+// "W (1234) tag: text\n", color codes included, to "tag: text"
+static const char *line_text(const char *line, size_t *len)
+{
+    const char *start = strstr(line, ") ");
+    start = start ? start + 2 : line;
+    const char *end = line + *len;
+    while (end > start && (end[-1] == '\n' || end[-1] == '\r')) {
+        --end;
+    }
+    if (end - start >= 4 && memcmp(end - 4, "\033[0m", 4) == 0) {
+        end -= 4;
+    }
+    *len = end > start ? (size_t)(end - start) : 0;
+    return start;
+}
+
+static void log_ring_capture(const char *format, va_list args)
+{
+    esp_log_level_t level = line_level(format);
+    if (level == ESP_LOG_NONE || level > LOG_RING_LEVEL) {
+        return;
+    }
+    // littlefs and the MQTT client log on the log task too; those lines
+    // would only feed the queue that task is draining
+    if (s_task && xTaskGetCurrentTaskHandle() == s_task) {
+        return;
+    }
+    // The arguments may point into the caller's stack, so the line is
+    // rendered here; everything after the copy runs on the log task
+    char line[LOG_RING_LINE_MAX];
+    int n = vsnprintf(line, sizeof(line), format, args);
+    if (n < 0) {
+        return;
+    }
+    size_t len = (size_t)n < sizeof(line) ? (size_t)n : sizeof(line) - 1;
+    const char *text = line_text(line, &len);
+    if (len > LOG_RING_TEXT_MAX) {
+        len = LOG_RING_TEXT_MAX;
+    }
+    log_record_t record = {
+        .uptime_ms = (uint32_t)(esp_timer_get_time() / 1000),
+        .level = (uint8_t)level,
+        .len = (uint8_t)len,
+    };
+
+    portENTER_CRITICAL(&s_queue_lock);
+    if (LOG_RING_QUEUE_BYTES - s_queue_used >= sizeof(record) + len) {
+        queue_put(&record, sizeof(record));
+        queue_put(text, len);
+    } else {
+        s_dropped++;
+    }
+    bool wake = level == ESP_LOG_ERROR || s_queue_used > LOG_RING_QUEUE_BYTES / 2;
+    portEXIT_CRITICAL(&s_queue_lock);
+    if (wake && s_task) {
+        xTaskNotifyGive(s_task);
+    }
+}
+
+static int log_ring_vprintf(const char *format, va_list args)
+{
+    va_list copy;
+    va_copy(copy, args);
+    int written = s_console ? s_console(format, args) : 0;
+    log_ring_capture(format, copy);
+    va_end(copy);
+    return written;
+}
+
+// Blocks: callers hold s_lock
+
+static void block_path(uint32_t seq, char *path, size_t len)
+{
+    snprintf(path, len, LOG_RING_PATH_FMT, (unsigned)(seq % LOG_RING_BLOCKS));
+}
+
+static esp_err_t write_block_locked(void)
+{
+    char path[32];
+    block_path(s_block.header.seq, path, sizeof(path));
+    FILE *f = fopen(path, "wb");
+    if (!f) {
+        return ESP_FAIL;
+    }
+    // One write and the close: littlefs commits the new file whole, or not at all
+    size_t len = sizeof(s_block.header) + s_block.header.used;
+    bool ok = fwrite(&s_block, 1, len, f) == len;
+    ok = fclose(f) == 0 && ok;
+    if (!ok) {
+        return ESP_FAIL;
+    }
+    s_dirty = false;
+    s_urgent = false;
+    s_written_us = esp_timer_get_time();
+    return ESP_OK;
+}
+
+static void append_locked(const log_record_t *record, const void *text)
+{
+    size_t need = sizeof(*record) + record->len;
+    if (s_block.header.used + need > LOG_RING_DATA_MAX) {
+        // A block that failed to write is lost; the ring moves on regardless
+        write_block_locked();
+        s_block.header.seq++;
+        s_block.header.used = 0;
+    }
+    memcpy(&s_block.data[s_block.header.used], record, sizeof(*record));
+    memcpy(&s_block.data[s_block.header.used + sizeof(*record)], text, record->len);
+    s_block.header.used += (uint16_t)need;
+    s_block.header.boot = s_boot;
+    if (!s_dirty) {
+        s_dirty = true;
+        s_dirty_since_us = esp_timer_get_time();
+    }
+    if (record->level == ESP_LOG_ERROR) {
+        s_urgent = true;
+    }
+}
+
+static void append_event_locked(char kind, const void *value, size_t len)
+{
+    uint8_t text[1 + sizeof(uint64_t)];
+    text[0] = (uint8_t)kind;
+    memcpy(&text[1], value, len);
+    log_record_t record = {
+        .uptime_ms = (uint32_t)(esp_timer_get_time() / 1000),
+        .boot = s_boot,
+        .level = LOG_RING_EVENT,
+        .len = (uint8_t)(1 + len),
+    };
+    append_locked(&record, text);
+}
+
+// A 'c' record once the clock is estimated, and again once SNTP sets it
+static void note_clock_locked(void)
+{
+    int state = time_sync_is_synced() ? 2 : time_sync_is_time_valid() ? 1 : 0;
+    if (state <= s_clock_state) {
+        return;
+    }
+    uint64_t uptime_ms = (uint64_t)(esp_timer_get_time() / 1000);
+    uint64_t epoch_ms = time_sync_boot_to_epoch_ms(uptime_ms);
+    if (!epoch_ms || epoch_ms < uptime_ms) {
+        return;
+    }
+    s_clock_state = state;
+    uint64_t base_ms = epoch_ms - uptime_ms;
+    append_event_locked('c', &base_ms, sizeof(base_ms));
+}
+
+static void drain_locked(void)
+{
+    uint8_t text[LOG_RING_TEXT_MAX];
+    while (true) {
+        log_record_t record;
+        uint32_t dropped = 0;
+        bool have = false;
+        portENTER_CRITICAL(&s_queue_lock);
+        if (s_queue_used >= sizeof(record)) {
+            queue_take(&record, sizeof(record));
+            queue_take(text, record.len);
+            have = true;
+        } else {
+            dropped = s_dropped;
+            s_dropped = 0;
+        }
+        portEXIT_CRITICAL(&s_queue_lock);
+        if (!have) {
+            if (dropped) {
+                append_event_locked('d', &dropped, sizeof(dropped));
+            }
+            return;
+        }
+        record.boot = s_boot;
+        append_locked(&record, text);
+    }
+}
+
+// Record bytes of block seq copied to out, 0 if it is not on flash (or empty)
+static size_t load_block_locked(uint32_t seq, uint8_t *out)
+{
+    if (seq == s_block.header.seq) {
+        memcpy(out, s_block.data, s_block.header.used);
+        return s_block.header.used;
+    }
+    char path[32];
+    block_path(seq, path, sizeof(path));
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        return 0;
+    }
+    log_block_header_t header;
+    size_t used = 0;
+    if (fread(&header, sizeof(header), 1, f) == 1 && header.magic == LOG_RING_MAGIC && header.seq == seq &&
+        header.used <= LOG_RING_DATA_MAX && fread(out, 1, header.used, f) == header.used) {
+        used = header.used;
+    }
+    fclose(f);
+    return used;
+}
+
+// Upload: log task
+
+static void finish_upload(esp_err_t result)
+{
+    free(s_upload.buf);
+    s_upload.buf = NULL;
+    s_upload.active = false;
+    if (s_upload_done) {
+        s_upload_done(s_upload.request_id, s_upload.sent, result);
+    }
+}
+
+static void start_upload(void)
+{
+    portENTER_CRITICAL(&s_queue_lock);
+    bool pending = s_request.pending;
+    if (pending) {
+        s_upload.client = s_request.client;
+        s_upload.device_id = s_request.device_id;
+        memcpy(s_upload.request_id, s_request.request_id, sizeof(s_upload.request_id));
+        s_request.pending = false;
+    }
+    portEXIT_CRITICAL(&s_queue_lock);
+    if (!pending) {
+        return;
+    }
+
+    s_upload.active = true;
+    s_upload.sent = 0;
+    s_upload.retries = 0;
+    if (!s_upload.buf) {
+        s_upload.buf = malloc(sizeof(*s_upload.buf));
+        if (!s_upload.buf) {
+            finish_upload(ESP_ERR_NO_MEM);
+            return;
+        }
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    uint32_t head = s_block.header.seq;
+    uint32_t oldest = head >= LOG_RING_BLOCKS - 1 ? head - (LOG_RING_BLOCKS - 1) : 0;
+    s_upload.next_seq = oldest > s_first_seq ? oldest : s_first_seq;
+    // Lines logged from here on wait for the next request
+    s_upload.last_seq = s_block.header.used ? head : head - 1;
+    xSemaphoreGive(s_lock);
+}
+
+static uint32_t upload_step(void)
+{
+    if (esp_mqtt_client_get_outbox_size(s_upload.client) > LOG_RING_UPLOAD_OUTBOX_MAX) {
+        if (++s_upload.retries > LOG_RING_UPLOAD_RETRIES) {
+            finish_upload(ESP_ERR_TIMEOUT);
+        }
+        return LOG_RING_UPLOAD_RETRY_MS;
+    }
+
+    log_upload_buffers_t *buf = s_upload.buf;
+    size_t used = 0;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    while ((int32_t)(s_upload.last_seq - s_upload.next_seq) >= 0 &&
+           (used = load_block_locked(s_upload.next_seq, buf->records)) == 0) {
+        s_upload.next_seq++;
+    }
+    xSemaphoreGive(s_lock);
+    if (!used) {
+        finish_upload(ESP_OK);
+        return LOG_RING_IDLE_MS;
+    }
+
+    size_t len = log_deflate(&buf->deflate, buf->records, used, buf->payload + MQTT_BIN_LOG_HEADROOM,
+                             sizeof(buf->payload) - MQTT_BIN_LOG_HEADROOM);
+    bool last = s_upload.next_seq == s_upload.last_seq;
+    int msg_id = mqtt_publish_log_block(s_upload.client, s_upload.device_id, s_upload.next_seq, (uint16_t)used, last,
+                                        buf->payload, len, s_upload.request_id[0] ? s_upload.request_id : NULL);
+    if (msg_id < 0) {
+        if (++s_upload.retries > LOG_RING_UPLOAD_RETRIES) {
+            finish_upload(ESP_ERR_TIMEOUT);
+        }
+        return LOG_RING_UPLOAD_RETRY_MS;
+    }
+    s_upload.retries = 0;
+    s_upload.sent++;
+    s_upload.next_seq++;
+    if (last) {
+        finish_upload(ESP_OK);
+        return LOG_RING_IDLE_MS;
+    }
+    return LOG_RING_UPLOAD_GAP_MS;
+}
+
+// One pass of the log task; returns how long (ms) it may block before the next
+static uint32_t log_ring_step(void)
+{
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    note_clock_locked();
+    drain_locked();
+    int64_t now_us = esp_timer_get_time();
+    if (s_dirty && ((s_urgent && now_us - s_written_us >= LOG_RING_URGENT_GAP_US) ||
+                    now_us - s_dirty_since_us >= LOG_RING_FLUSH_US)) {
+        write_block_locked();
+    }
+    xSemaphoreGive(s_lock);
+
+    start_upload();
+    return s_upload.active ? upload_step() : LOG_RING_IDLE_MS;
+}
+
+static void log_ring_task(void *arg)
+{
+    while (true) {
+        uint32_t wait_ms = log_ring_step();
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(wait_ms));
+    }
+}
+
+static void log_ring_shutdown_handler(void)
+{
+    // esp_restart() path; don't hang the reboot on a held lock
+    if (!s_ready || xSemaphoreTake(s_lock, pdMS_TO_TICKS(500)) != pdTRUE) {
+        return;
+    }
+    drain_locked();
+    if (s_dirty) {
+        write_block_locked();
+    }
+    xSemaphoreGive(s_lock);
+}
+
+static esp_err_t log_ring_mount(void)
+{
+    esp_vfs_littlefs_conf_t conf = {
+        .base_path = LOG_RING_BASE_PATH,
+        .partition_label = "storage",
+        .format_if_mount_failed = true,
+    };
+    esp_err_t err = esp_vfs_littlefs_register(&conf);
+    // Already mounted by the telemetry ring
+    return err == ESP_ERR_INVALID_STATE ? ESP_OK : err;
+}
+
+static bool read_header(unsigned slot, log_block_header_t *out)
+{
+    char path[32];
+    snprintf(path, sizeof(path), LOG_RING_PATH_FMT, slot);
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        return false;
+    }
+    bool ok = fread(out, sizeof(*out), 1, f) == 1 && out->magic == LOG_RING_MAGIC &&
+              out->seq % LOG_RING_BLOCKS == slot && out->used <= LOG_RING_DATA_MAX;
+    fclose(f);
+    return ok;
+}
+
+// Carry on in the newest block, so short boots (deep sleep wakes) share
+// blocks, under a boot number one past its own
+static void log_ring_recover_locked(void)
+{
+    bool found = false;
+    uint32_t newest = 0;
+    uint32_t oldest = 0;
+    uint16_t newest_boot = 0;
+    for (unsigned slot = 0; slot < LOG_RING_BLOCKS; ++slot) {
+        log_block_header_t header;
+        if (!read_header(slot, &header)) {
+            continue;
+        }
+        if (!found || (int32_t)(header.seq - newest) > 0) {
+            newest = header.seq;
+            newest_boot = header.boot;
+        }
+        if (!found || (int32_t)(header.seq - oldest) < 0) {
+            oldest = header.seq;
+        }
+        found = true;
+    }
+
+    memset(&s_block.header, 0, sizeof(s_block.header));
+    s_block.header.magic = LOG_RING_MAGIC;
+    s_boot = (uint16_t)(newest_boot + 1);
+    if (!found) {
+        s_first_seq = 0;
+        return;
+    }
+    s_first_seq = oldest;
+    size_t used = load_block_locked(newest, s_block.data);
+    s_block.header.seq = used ? newest : newest + 1;
+    s_block.header.used = (uint16_t)used;
+    s_block.header.boot = newest_boot;
+}
+
+esp_err_t log_ring_init(void)
+{
+    if (!s_console) {
+        s_console = esp_log_set_vprintf(log_ring_vprintf);
+    }
+    return ESP_OK;
+}
+
+esp_err_t log_ring_start(void)
+{
+    if (s_ready) {
+        return ESP_OK;
+    }
+    if (!s_lock) {
+        s_lock = xSemaphoreCreateMutexStatic(&s_lock_buf);
+    }
+    esp_err_t err = log_ring_mount();
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "LittleFS mount failed: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    log_ring_recover_locked();
+    s_ready = true;
+    xSemaphoreGive(s_lock);
+    esp_register_shutdown_handler(log_ring_shutdown_handler);
+    s_task = xTaskCreateStaticPinnedToCore(log_ring_task, "log_task", LOG_RING_TASK_STACK, NULL,
+                                           LOG_RING_TASK_PRIORITY, s_task_stack, &s_task_tcb, NETWORK_CORE);
+    ESP_LOGI(TAG, "Boot %u logging to block %u (%u blocks of %u bytes)", (unsigned)s_boot,
+             (unsigned)s_block.header.seq, (unsigned)LOG_RING_BLOCKS, (unsigned)LOG_RING_BLOCK_SIZE);
+    return ESP_OK;
+}
+
+esp_err_t log_ring_flush(void)
+{
+    if (!s_ready) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    drain_locked();
+    esp_err_t err = s_dirty ? write_block_locked() : ESP_OK;
+    xSemaphoreGive(s_lock);
+    return err;
+}
+
+void log_ring_set_upload_callback(log_ring_upload_done_callback_t cb)
+{
+    s_upload_done = cb;
+}
+
+esp_err_t log_ring_request_upload(esp_mqtt_client_handle_t client, const char *device_id, const char *request_id)
+{
+    if (!client || !device_id || !device_id[0]) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!s_ready || !s_task) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    portENTER_CRITICAL(&s_queue_lock);
+    s_request.pending = true;
+    s_request.client = client;
+    s_request.device_id = device_id;
+    s_request.request_id[0] = '\0';
+    if (request_id) {
+        strncpy(s_request.request_id, request_id, sizeof(s_request.request_id) - 1);
+        s_request.request_id[sizeof(s_request.request_id) - 1] = '\0';
+    }
+    portEXIT_CRITICAL(&s_queue_lock);
+    xTaskNotifyGive(s_task);
+    return ESP_OK;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+#include <mqtt_client.h>
+
+#include "sdkconfig.h"
+
+// Persistent log ring (CONFIG_PROJECTPLANT_LOG_RING). An esp_log vprintf
+// hook copies every line at or above CONFIG_PROJECTPLANT_LOG_RING_LEVEL into
+// a RAM queue and hands it to a low-priority task, which packs the lines
+// into 4 KB blocks and keeps CONFIG_PROJECTPLANT_LOG_RING_BLOCKS of them as
+// log00.bin, log01.bin, ... next to telemetry.bin. Each file fits one
+// littlefs block and is rewritten whole, which littlefs commits atomically,
+// so a reset or power cut loses at most the lines not yet written. The
+// calling task renders the line and copies it into the queue; it never
+// waits on flash or on the log task. Lines are dropped, and counted, while
+// the queue is full. The console still gets every line, as before.
+//
+// A block file is a 12-byte header (magic 'PLOG', block sequence number
+// u32, boot u16 of its latest record, record bytes u16) and the records.
+// Each record has uptime ms u32 (wraps every 49.7 days; records are in
+// order), boot u16, level u8 (esp_log_level_t) and text length u8, then the
+// text without the level letter, the console timestamp or the newline,
+// e.g. "storage: LittleFS mounted on /storage". All fields are
+// little-endian. Boots are counted by the ring, so deep sleep wakes count
+// too. Level 0 records carry ring events instead of text:
+//   'c' + epoch ms u64: uptime 0 of this boot on the wall clock, once the
+//       clock is valid (again after SNTP replaces an estimate)
+//   'd' + count u32: lines the queue dropped before this record
+//
+// log_read uploads the ring, oldest block first, as one QoS 1 message per
+// block on pots/<id>/logs/bin (mqtt_publish_log_block()), paced by the MQTT
+// outbox, and then runs the done callback.
+
+typedef void (*log_ring_upload_done_callback_t)(const char *request_id, size_t blocks, esp_err_t result);
+
+#if CONFIG_PROJECTPLANT_LOG_RING
+// Install the hook first thing at boot; lines captured before
+// log_ring_start() wait in the queue
+esp_err_t log_ring_init(void);
+// Mount the storage partition (if the telemetry ring has not), find the
+// newest block and start the log task
+esp_err_t log_ring_start(void);
+// Write queued lines and the open block now (before a deep sleep). Any task.
+esp_err_t log_ring_flush(void);
+
+void log_ring_set_upload_callback(log_ring_upload_done_callback_t cb);
+// A new request replaces one still running. The callback runs on the log
+// task and is not called for a request this returns an error for.
+esp_err_t log_ring_request_upload(esp_mqtt_client_handle_t client, const char *device_id, const char *request_id);
+#else
+static inline esp_err_t log_ring_init(void)
+{
+    return ESP_OK;
+}
+
+static inline esp_err_t log_ring_start(void)
+{
+    return ESP_OK;
+}
+
+static inline esp_err_t log_ring_flush(void)
+{
+    return ESP_OK;
+}
+
+static inline void log_ring_set_upload_callback(log_ring_upload_done_callback_t cb)
+{
+    (void)cb;
+}
+
+static inline esp_err_t log_ring_request_upload(esp_mqtt_client_handle_t client, const char *device_id,
+                                                const char *request_id)
+{
+    (void)client;
+    (void)device_id;
+    (void)request_id;
+    return ESP_ERR_NOT_SUPPORTED;
+}
+#endif
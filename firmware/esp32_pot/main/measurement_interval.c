@@ -0,0 +1,187 @@
+#include "measurement_interval.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "esp_attr.h"
+#include "esp_crc.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+
+#include "actuator_timer.h"
+#include "hardware_config.h"
+#include "node_schedule.h"
+#include "preferences.h"
+#include "time_sync.h"
+
+#define INTERVAL_NAMESPACE "device"
+#define INTERVAL_KEY "interval"
+#define INTERVAL_VERSION 1
+
+// Read slightly after a schedule edge so the switched output is in it
+#define SCHEDULE_EDGE_MARGIN_MS 1000
+
+static const char *TAG = "interval";
+
+typedef struct {
+    uint8_t version;
+    uint8_t reserved[3];
+    measurement_interval_bounds_t bounds;
+    uint32_t crc32;  // esp_crc32_le over every byte before this field
+} interval_blob_t;
+
+static measurement_interval_bounds_t bounds = {
+    .active_s = MEASUREMENT_INTERVAL_MS / 1000,
+    .min_s = MEASUREMENT_INTERVAL_MS / 1000,
+    .max_s = MEASUREMENT_INTERVAL_MS / 1000,
+};
+static portMUX_TYPE bounds_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Zeroed at power-on; kept across deep sleep
+typedef struct {
+    bool valid;
+    uint32_t interval_ms;       // idle interval last chosen
+    sensor_reading_t last;
+} interval_history_t;
+static RTC_DATA_ATTR interval_history_t history;
+
+static uint32_t blob_crc(const interval_blob_t *blob)
+{
+    return esp_crc32_le(0, (const uint8_t *)blob, offsetof(interval_blob_t, crc32));
+}
+
+static bool bounds_valid(const measurement_interval_bounds_t *b)
+{
+    return b->active_s >= 1 && b->min_s >= 1 &&
+           b->active_s <= b->max_s && b->min_s <= b->max_s &&
+           b->max_s <= MEASUREMENT_INTERVAL_MAX_S;
+}
+
+void measurement_interval_init(void)
+{
+    interval_blob_t blob;
+    size_t len = sizeof(blob);
+    esp_err_t err = prefs_get_blob(INTERVAL_NAMESPACE, INTERVAL_KEY, &blob, &len);
+    if (err == ESP_ERR_NVS_NOT_FOUND) {
+        return;
+    }
+    if (err != ESP_OK ||
+        len != sizeof(blob) ||
+        blob.version != INTERVAL_VERSION ||
+        blob.crc32 != blob_crc(&blob) ||
+        !bounds_valid(&blob.bounds)) {
+        ESP_LOGW(TAG, "Stored interval bounds unusable (%s); using defaults", esp_err_to_name(err));
+        return;
+    }
+    taskENTER_CRITICAL(&bounds_lock);
+    bounds = blob.bounds;
+    taskEXIT_CRITICAL(&bounds_lock);
+    ESP_LOGI(TAG, "Measurement interval: active %u s, %u..%u s",
+             (unsigned)blob.bounds.active_s, (unsigned)blob.bounds.min_s, (unsigned)blob.bounds.max_s);
+}
+
+void measurement_interval_get_bounds(measurement_interval_bounds_t *out)
+{
+    if (!out) {
+        return;
+    }
+    taskENTER_CRITICAL(&bounds_lock);
+    *out = bounds;
+    taskEXIT_CRITICAL(&bounds_lock);
+}
+
+esp_err_t measurement_interval_set_bounds(const measurement_interval_bounds_t *next)
+{
+    if (!next || !bounds_valid(next)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    interval_blob_t blob;
+    memset(&blob, 0, sizeof(blob));
+    blob.version = INTERVAL_VERSION;
+    blob.bounds = *next;
+    blob.crc32 = blob_crc(&blob);
+    esp_err_t err = prefs_defer_blob(INTERVAL_NAMESPACE, INTERVAL_KEY, &blob, sizeof(blob));
+    if (err != ESP_OK) {
+        return err;
+    }
+    taskENTER_CRITICAL(&bounds_lock);
+    bounds = *next;
+    taskEXIT_CRITICAL(&bounds_lock);
+    return ESP_OK;
+}
+
+static bool outputs_active(const sensor_reading_t *reading)
+{
+    return reading->pump_is_on || reading->mister_is_on ||
+           actuator_timer_is_armed(NODE_SCHEDULE_TARGET_PUMP) ||
+           actuator_timer_is_armed(NODE_SCHEDULE_TARGET_MISTER) ||
+           actuator_timer_is_armed(NODE_SCHEDULE_TARGET_FAN) ||
+           actuator_timer_is_armed(NODE_SCHEDULE_TARGET_LIGHT) ||
+           actuator_timer_is_armed(NODE_SCHEDULE_TARGET_IC_ZONE1);
+}
+
+static bool states_differ(const sensor_reading_t *a, const sensor_reading_t *b)
+{
+    return a->water_low != b->water_low ||
+           a->water_cutoff != b->water_cutoff ||
+           a->pump_is_on != b->pump_is_on ||
+           a->ic_zone1_is_on != b->ic_zone1_is_on ||
+           a->fan_is_on != b->fan_is_on ||
+           a->mister_is_on != b->mister_is_on ||
+           a->light_is_on != b->light_is_on;
+}
+
+// Change per minute above limit; a value that appears or drops out counts
+static bool changing(float now, float then, float limit_per_min, uint32_t elapsed_ms)
+{
+    if (isnan(now) != isnan(then)) {
+        return true;
+    }
+    if (isnan(now) || elapsed_ms == 0) {
+        return false;
+    }
+    return fabsf(now - then) * 60000.0f / (float)elapsed_ms > limit_per_min;
+}
+
+static bool readings_steady(const sensor_reading_t *now, const sensor_reading_t *then, uint32_t elapsed_ms)
+{
+    return !states_differ(now, then) &&
+           !changing(now->soil_percent, then->soil_percent, MEASUREMENT_STEADY_SOIL_PCT_PER_MIN, elapsed_ms) &&
+           !changing(now->temperature_c, then->temperature_c, MEASUREMENT_STEADY_TEMP_C_PER_MIN, elapsed_ms) &&
+           !changing(now->humidity_pct, then->humidity_pct, MEASUREMENT_STEADY_RH_PCT_PER_MIN, elapsed_ms);
+}
+
+uint32_t measurement_interval_next_ms(const sensor_reading_t *reading)
+{
+    measurement_interval_bounds_t b;
+    measurement_interval_get_bounds(&b);
+    uint32_t min_ms = b.min_s * 1000;
+    uint32_t max_ms = b.max_s * 1000;
+
+    uint32_t next_ms = min_ms;
+    if (reading && history.valid && history.interval_ms >= min_ms && history.interval_ms <= max_ms &&
+        reading->timestamp_ms > history.last.timestamp_ms) {
+        uint32_t elapsed_ms = (uint32_t)(reading->timestamp_ms - history.last.timestamp_ms);
+        if (readings_steady(reading, &history.last, elapsed_ms)) {
+            next_ms = history.interval_ms > max_ms / 2 ? max_ms : history.interval_ms * 2;
+        }
+    }
+    if (reading) {
+        history.last = *reading;
+        history.valid = true;
+    }
+    history.interval_ms = next_ms;
+
+    if (reading && outputs_active(reading)) {
+        next_ms = b.active_s * 1000;
+    }
+    if (time_sync_is_time_valid()) {
+        uint32_t transition_ms = node_schedule_next_transition_ms();
+        if (transition_ms < next_ms - SCHEDULE_EDGE_MARGIN_MS) {
+            next_ms = transition_ms + SCHEDULE_EDGE_MARGIN_MS;
+        }
+    }
+    return next_ms;
+}
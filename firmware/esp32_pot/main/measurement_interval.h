@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#include "sensors.h"
+
+// Adaptive measurement interval. While the pump or mister runs, or a timed
+// output is armed, readings come every active_s. Otherwise the interval
+// starts at min_s and doubles after each reading whose soil %, temperature
+// and humidity moved slower than the MEASUREMENT_STEADY_* rates in
+// hardware_config.h, up to max_s; any faster change, or an output or float
+// switch change, drops it back to min_s. It never runs past the next
+// node_schedule edge, so the reading after a timer switch comes right away.
+// With all three bounds equal the interval is fixed (the default:
+// MEASUREMENT_INTERVAL_MS).
+typedef struct {
+    uint32_t active_s;
+    uint32_t min_s;
+    uint32_t max_s;
+} measurement_interval_bounds_t;
+
+#define MEASUREMENT_INTERVAL_MAX_S 86400
+
+// Loads the stored bounds; call after prefs_init()
+void measurement_interval_init(void);
+void measurement_interval_get_bounds(measurement_interval_bounds_t *out);
+// Needs 1 <= active_s <= max_s, 1 <= min_s <= max_s <= MEASUREMENT_INTERVAL_MAX_S.
+// The write is deferred like other prefs.
+esp_err_t measurement_interval_set_bounds(const measurement_interval_bounds_t *bounds);
+
+// Milliseconds until the next reading, given the one just taken. Single
+// caller (the sensor or duty-cycle task); the history it keeps survives
+// deep sleep.
+uint32_t measurement_interval_next_ms(const sensor_reading_t *reading);
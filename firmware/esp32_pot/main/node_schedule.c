@@ -1,10 +1,14 @@
 #include "node_schedule.h"
 
+#include <stdatomic.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <string.h>
 #include <sys/time.h>
 
+#include "esp_crc.h"
 #include "esp_err.h"
 #include "esp_log.h"
 #include "freertos/FreeRTOS.h"
@@ -19,34 +23,146 @@
 #include "time_sync.h"
 
 #define SCHEDULE_NAMESPACE "schedule"
-#define SCHEDULE_TASK_PERIOD_MS 10000
-#define DEFAULT_SCHEDULE_OVERRIDE_DURATION_MS (10U * SCHEDULE_TASK_PERIOD_MS)
+#define SCHEDULE_BLOB_KEY "sched"
+#define SCHEDULE_BLOB_VERSION 2
+#define SCHEDULE_BLOB_VERSION_V1 1
+#define SCHEDULE_V1_TIMER_COUNT 5
+#define SCHEDULE_MINUTES_PER_DAY 1440
+#define SCHEDULE_MASK_WORDS ((SCHEDULE_MINUTES_PER_DAY + 31) / 32)
+#define SCHEDULE_EDGE_MAX (NODE_SCHEDULE_TARGET_COUNT * NODE_SCHEDULE_MAX_WINDOWS * 2)
+// The task sleeps until the next timer edge or override expiry. Until the
+// clock is synced it polls; once synced the sleep is capped so SNTP steps
+// and external actuator changes are re-checked now and then.
+#define SCHEDULE_TIME_WAIT_MS 10000
+#define SCHEDULE_MAX_SLEEP_MS (15U * 60U * 1000U)
+#define SCHEDULE_EDGE_SLACK_MS 20
+#define DEFAULT_SCHEDULE_OVERRIDE_DURATION_MS 100000U
 
 static const char *TAG = "node_schedule";
 
 static const int16_t TZ_OFFSET_MIN = -720;
 static const int16_t TZ_OFFSET_MAX = 840;
 
+// Serializes writers only; readers go through schedule_copies
+static StaticSemaphore_t schedule_lock_buf;
 static SemaphoreHandle_t schedule_lock = NULL;
-static node_schedule_t schedule_state;
 static bool schedule_initialized = false;
+static TaskHandle_t schedule_task_handle = NULL;
 
 typedef struct {
     bool active;
     uint64_t expires_at_ms;
 } schedule_override_t;
 
-static schedule_override_t override_light = {0};
-static schedule_override_t override_pump = {0};
-static schedule_override_t override_ic_zone1 = {0};
-static schedule_override_t override_mister = {0};
-static schedule_override_t override_fan = {0};
+static schedule_override_t overrides[NODE_SCHEDULE_TARGET_COUNT];
 
-static const node_schedule_timer_t DEFAULT_LIGHT = { .enabled = false, .start_minute = 6 * 60, .end_minute = 20 * 60 };
-static const node_schedule_timer_t DEFAULT_PUMP = { .enabled = false, .start_minute = 7 * 60, .end_minute = (7 * 60) + 15 };
-static const node_schedule_timer_t DEFAULT_IC_ZONE1 = { .enabled = false, .start_minute = 7 * 60, .end_minute = (7 * 60) + 15 };
-static const node_schedule_timer_t DEFAULT_MISTER = { .enabled = false, .start_minute = 8 * 60, .end_minute = (8 * 60) + 15 };
-static const node_schedule_timer_t DEFAULT_FAN = { .enabled = false, .start_minute = 9 * 60, .end_minute = 18 * 60 };
+// A schedule compiled for evaluation: one bit per minute of the day per
+// target, and the sorted minutes at which any target's bit changes
+typedef struct {
+    uint32_t masks[NODE_SCHEDULE_TARGET_COUNT][SCHEDULE_MASK_WORDS];
+    uint16_t edges[SCHEDULE_EDGE_MAX];
+    uint8_t edge_count;
+} schedule_plan_t;
+
+typedef struct {
+    node_schedule_t schedule;
+    schedule_plan_t plan;
+} schedule_copy_t;
+
+// Double buffer: schedule_copies[schedule_seq & 1] is current. A writer fills
+// the other copy and then bumps schedule_seq; readers take no lock and retry
+// when the sequence moved while they read, since the copy they were reading
+// may then be the one being refilled.
+static schedule_copy_t schedule_copies[2];
+static _Atomic uint32_t schedule_seq;
+
+static const schedule_copy_t *schedule_read_begin(uint32_t *seq)
+{
+    *seq = atomic_load(&schedule_seq);
+    return &schedule_copies[*seq & 1U];
+}
+
+static bool schedule_read_retry(uint32_t seq)
+{
+    atomic_thread_fence(memory_order_seq_cst);
+    return atomic_load(&schedule_seq) != seq;
+}
+
+static void set_ic_zone1_output(bool on)
+{
+    // Latching valve: pulse the coil, then record the state it now holds
+    sensors_pulse_ic_zone1(on, IC_ZONE1_PULSE_MS);
+    sensors_set_ic_zone1_state(on);
+}
+
+// One row per node_schedule_target_t. A new zone is a target plus a row
+// here; parsing, persistence and evaluation pick it up from the table.
+typedef struct {
+    const char *name;
+    const char *legacy_prefix;     // per-key NVS layout before the blob, if any
+    bool (*get_output)(void);
+    void (*set_output)(bool on);
+    node_schedule_window_t default_window;
+} schedule_actuator_t;
+
+static const schedule_actuator_t ACTUATORS[NODE_SCHEDULE_TARGET_COUNT] = {
+    [NODE_SCHEDULE_TARGET_LIGHT] = { "light", "l", sensors_get_light_state, sensors_set_light_state, { 6 * 60, 20 * 60 } },
+    [NODE_SCHEDULE_TARGET_PUMP] = { "pump", "p", sensors_get_pump_state, sensors_set_pump_state, { 7 * 60, (7 * 60) + 15 } },
+    [NODE_SCHEDULE_TARGET_IC_ZONE1] = { "ic_zone1", "i", sensors_get_ic_zone1_state, set_ic_zone1_output, { 7 * 60, (7 * 60) + 15 } },
+    [NODE_SCHEDULE_TARGET_MISTER] = { "mister", "m", sensors_get_mister_state, sensors_set_mister_state, { 8 * 60, (8 * 60) + 15 } },
+    [NODE_SCHEDULE_TARGET_FAN] = { "fan", "f", sensors_get_fan_state, sensors_set_fan_state, { 9 * 60, 18 * 60 } },
+};
+
+// Persisted form of node_schedule_t: one NVS blob, one commit per update.
+// Fixed-width fields in a fixed order; timers are stored in target order
+// and only timer_count of them are written, so appending a target keeps
+// older blobs readable. Bump SCHEDULE_BLOB_VERSION on any other change.
+typedef struct {
+    uint16_t start_minute;
+    uint16_t end_minute;
+} schedule_blob_window_t;
+
+typedef struct {
+    uint8_t enabled;
+    uint8_t window_count;
+    schedule_blob_window_t windows[NODE_SCHEDULE_MAX_WINDOWS];
+} schedule_blob_timer_t;
+
+typedef struct {
+    uint8_t version;
+    uint8_t timer_count;
+    uint8_t window_capacity;   // NODE_SCHEDULE_MAX_WINDOWS of the writer
+    uint8_t reserved;
+    uint32_t crc32;            // esp_crc32_le over the stored bytes, this field as zero
+    uint64_t updated_at_ms;
+    int16_t timezone_offset_minutes;
+    uint8_t reserved2[6];
+    schedule_blob_timer_t timers[NODE_SCHEDULE_TARGET_COUNT];
+} schedule_blob_t;
+
+// Version 1: one window per timer, five timers
+typedef struct {
+    uint16_t start_minute;
+    uint16_t end_minute;
+    uint8_t enabled;
+    uint8_t reserved;
+} schedule_blob_v1_timer_t;
+
+typedef struct {
+    uint8_t version;
+    uint8_t timer_count;
+    int16_t timezone_offset_minutes;
+    schedule_blob_v1_timer_t timers[SCHEDULE_V1_TIMER_COUNT];  // light, pump, ic_zone1, mister, fan
+    uint8_t reserved[6];
+    uint64_t updated_at_ms;
+    uint32_t crc32;  // esp_crc32_le over every byte before this field
+} schedule_blob_v1_t;
+
+typedef union {
+    uint8_t version;
+    schedule_blob_t v2;
+    schedule_blob_v1_t v1;
+} schedule_blob_buffer_t;
 
 static bool is_pref_missing(esp_err_t err)
 {
@@ -55,10 +171,16 @@ static bool is_pref_missing(esp_err_t err)
 
 static bool is_valid_timer(const node_schedule_timer_t *timer)
 {
-    if (!timer) {
+    if (!timer || timer->window_count == 0 || timer->window_count > NODE_SCHEDULE_MAX_WINDOWS) {
         return false;
     }
-    return timer->start_minute < 1440U && timer->end_minute < 1440U;
+    for (uint8_t w = 0; w < timer->window_count; ++w) {
+        if (timer->windows[w].start_minute >= SCHEDULE_MINUTES_PER_DAY ||
+            timer->windows[w].end_minute >= SCHEDULE_MINUTES_PER_DAY) {
+            return false;
+        }
+    }
+    return true;
 }
 
 static bool is_valid_schedule(const node_schedule_t *schedule)
@@ -66,12 +188,10 @@ static bool is_valid_schedule(const node_schedule_t *schedule)
     if (!schedule) {
         return false;
     }
-    if (!is_valid_timer(&schedule->light) ||
-        !is_valid_timer(&schedule->pump) ||
-        !is_valid_timer(&schedule->ic_zone1) ||
-        !is_valid_timer(&schedule->mister) ||
-        !is_valid_timer(&schedule->fan)) {
-        return false;
+    for (int t = 0; t < NODE_SCHEDULE_TARGET_COUNT; ++t) {
+        if (!is_valid_timer(&schedule->timers[t])) {
+            return false;
+        }
     }
     return schedule->timezone_offset_minutes >= TZ_OFFSET_MIN &&
            schedule->timezone_offset_minutes <= TZ_OFFSET_MAX;
@@ -97,38 +217,18 @@ static bool override_should_skip(schedule_override_t *ovr)
 
 static schedule_override_t *override_for_target(node_schedule_target_t target)
 {
-    switch (target) {
-    case NODE_SCHEDULE_TARGET_LIGHT:
-        return &override_light;
-    case NODE_SCHEDULE_TARGET_PUMP:
-        return &override_pump;
-    case NODE_SCHEDULE_TARGET_IC_ZONE1:
-        return &override_ic_zone1;
-    case NODE_SCHEDULE_TARGET_MISTER:
-        return &override_mister;
-    case NODE_SCHEDULE_TARGET_FAN:
-        return &override_fan;
-    default:
+    if ((int)target < 0 || target >= NODE_SCHEDULE_TARGET_COUNT) {
         return NULL;
     }
+    return &overrides[target];
 }
 
 static const char *target_name(node_schedule_target_t target)
 {
-    switch (target) {
-    case NODE_SCHEDULE_TARGET_LIGHT:
-        return "light";
-    case NODE_SCHEDULE_TARGET_PUMP:
-        return "pump";
-    case NODE_SCHEDULE_TARGET_IC_ZONE1:
-        return "ic_zone1";
-    case NODE_SCHEDULE_TARGET_MISTER:
-        return "mister";
-    case NODE_SCHEDULE_TARGET_FAN:
-        return "fan";
-    default:
+    if ((int)target < 0 || target >= NODE_SCHEDULE_TARGET_COUNT) {
         return "unknown";
     }
+    return ACTUATORS[target].name;
 }
 
 static uint32_t override_duration_ms(uint32_t duration_ms)
@@ -136,18 +236,27 @@ static uint32_t override_duration_ms(uint32_t duration_ms)
     return duration_ms > 0 ? duration_ms : DEFAULT_SCHEDULE_OVERRIDE_DURATION_MS;
 }
 
+// Make the schedule task recompute its next wakeup
+static void wake_schedule_task(void)
+{
+    TaskHandle_t task = schedule_task_handle;
+    if (task) {
+        xTaskNotifyGive(task);
+    }
+}
+
 void node_schedule_defaults(node_schedule_t *out_schedule)
 {
     if (!out_schedule) {
         return;
     }
-    out_schedule->light = DEFAULT_LIGHT;
-    out_schedule->pump = DEFAULT_PUMP;
-    out_schedule->ic_zone1 = DEFAULT_IC_ZONE1;
-    out_schedule->mister = DEFAULT_MISTER;
-    out_schedule->fan = DEFAULT_FAN;
-    out_schedule->timezone_offset_minutes = 0;
-    out_schedule->updated_at_ms = 0;
+    memset(out_schedule, 0, sizeof(*out_schedule));
+    for (int t = 0; t < NODE_SCHEDULE_TARGET_COUNT; ++t) {
+        node_schedule_timer_t *timer = &out_schedule->timers[t];
+        timer->enabled = false;
+        timer->window_count = 1;
+        timer->windows[0] = ACTUATORS[t].default_window;
+    }
 }
 
 bool node_schedule_parse_hhmm(const char *value, uint16_t *out_minutes)
@@ -177,247 +286,268 @@ bool node_schedule_parse_hhmm(const char *value, uint16_t *out_minutes)
     return true;
 }
 
-static bool timer_is_active(const node_schedule_timer_t *timer, int minute_of_day)
+static void mask_set_range(uint32_t *mask, int start, int end)
 {
-    if (!timer || !timer->enabled) {
-        return false;
+    for (int m = start; m < end; ++m) {
+        mask[m / 32] |= 1UL << (m % 32);
     }
-
-    int start = (int)timer->start_minute;
-    int end = (int)timer->end_minute;
-
-    if (start == end) {
-        return true;
-    }
-
-    if (start < end) {
-        return minute_of_day >= start && minute_of_day < end;
-    }
-
-    return minute_of_day >= start || minute_of_day < end;
 }
 
-static esp_err_t save_schedule_locked(const node_schedule_t *schedule)
+static bool mask_test(const uint32_t *mask, int minute)
 {
-    esp_err_t err = prefs_put_bool(SCHEDULE_NAMESPACE, "l_en", schedule->light.enabled);
-    if (err != ESP_OK) {
-        return err;
-    }
-    err = prefs_put_u32(SCHEDULE_NAMESPACE, "l_st", schedule->light.start_minute);
-    if (err != ESP_OK) {
-        return err;
-    }
-    err = prefs_put_u32(SCHEDULE_NAMESPACE, "l_et", schedule->light.end_minute);
-    if (err != ESP_OK) {
-        return err;
-    }
-
-    err = prefs_put_bool(SCHEDULE_NAMESPACE, "p_en", schedule->pump.enabled);
-    if (err != ESP_OK) {
-        return err;
-    }
-    err = prefs_put_u32(SCHEDULE_NAMESPACE, "p_st", schedule->pump.start_minute);
-    if (err != ESP_OK) {
-        return err;
-    }
-    err = prefs_put_u32(SCHEDULE_NAMESPACE, "p_et", schedule->pump.end_minute);
-    if (err != ESP_OK) {
-        return err;
-    }
+    return (mask[minute / 32] >> (minute % 32)) & 1UL;
+}
 
-    err = prefs_put_bool(SCHEDULE_NAMESPACE, "i_en", schedule->ic_zone1.enabled);
-    if (err != ESP_OK) {
-        return err;
-    }
-    err = prefs_put_u32(SCHEDULE_NAMESPACE, "i_st", schedule->ic_zone1.start_minute);
-    if (err != ESP_OK) {
-        return err;
+static void compile_timer(const node_schedule_timer_t *timer, uint32_t *mask)
+{
+    memset(mask, 0, SCHEDULE_MASK_WORDS * sizeof(mask[0]));
+    if (!timer->enabled) {
+        return;
     }
-    err = prefs_put_u32(SCHEDULE_NAMESPACE, "i_et", schedule->ic_zone1.end_minute);
-    if (err != ESP_OK) {
-        return err;
+    for (uint8_t w = 0; w < timer->window_count; ++w) {
+        int start = (int)timer->windows[w].start_minute;
+        int end = (int)timer->windows[w].end_minute;
+        if (start == end) {
+            mask_set_range(mask, 0, SCHEDULE_MINUTES_PER_DAY);
+        } else if (start < end) {
+            mask_set_range(mask, start, end);
+        } else {
+            mask_set_range(mask, start, SCHEDULE_MINUTES_PER_DAY);
+            mask_set_range(mask, 0, end);
+        }
     }
+}
 
-    err = prefs_put_bool(SCHEDULE_NAMESPACE, "m_en", schedule->mister.enabled);
-    if (err != ESP_OK) {
-        return err;
-    }
-    err = prefs_put_u32(SCHEDULE_NAMESPACE, "m_st", schedule->mister.start_minute);
-    if (err != ESP_OK) {
-        return err;
-    }
-    err = prefs_put_u32(SCHEDULE_NAMESPACE, "m_et", schedule->mister.end_minute);
-    if (err != ESP_OK) {
-        return err;
+static void compile_plan(const node_schedule_t *schedule, schedule_plan_t *plan)
+{
+    for (int t = 0; t < NODE_SCHEDULE_TARGET_COUNT; ++t) {
+        compile_timer(&schedule->timers[t], plan->masks[t]);
+    }
+    // An edge is a minute whose bit differs from the minute before, for any
+    // target; overlapping or touching windows leave no edge between them
+    plan->edge_count = 0;
+    for (int m = 0; m < SCHEDULE_MINUTES_PER_DAY; ++m) {
+        int prev = (m + SCHEDULE_MINUTES_PER_DAY - 1) % SCHEDULE_MINUTES_PER_DAY;
+        for (int t = 0; t < NODE_SCHEDULE_TARGET_COUNT; ++t) {
+            if (mask_test(plan->masks[t], m) != mask_test(plan->masks[t], prev)) {
+                if (plan->edge_count < SCHEDULE_EDGE_MAX) {
+                    plan->edges[plan->edge_count++] = (uint16_t)m;
+                }
+                break;
+            }
+        }
     }
+}
 
-    err = prefs_put_bool(SCHEDULE_NAMESPACE, "f_en", schedule->fan.enabled);
-    if (err != ESP_OK) {
-        return err;
-    }
-    err = prefs_put_u32(SCHEDULE_NAMESPACE, "f_st", schedule->fan.start_minute);
-    if (err != ESP_OK) {
-        return err;
-    }
-    err = prefs_put_u32(SCHEDULE_NAMESPACE, "f_et", schedule->fan.end_minute);
-    if (err != ESP_OK) {
-        return err;
-    }
+// Compile schedule into the spare copy and make it current; caller holds
+// schedule_lock (or is init, before any reader runs)
+static void publish_schedule_locked(const node_schedule_t *schedule)
+{
+    uint32_t seq = atomic_load(&schedule_seq);
+    schedule_copy_t *next = &schedule_copies[(seq + 1U) & 1U];
+    // Readers of the previous publish must see it before this refill starts
+    atomic_thread_fence(memory_order_seq_cst);
+    next->schedule = *schedule;
+    compile_plan(&next->schedule, &next->plan);
+    atomic_store(&schedule_seq, seq + 1U);
+}
 
-    err = prefs_put_i32(SCHEDULE_NAMESPACE, "tz_ofs", (int32_t)schedule->timezone_offset_minutes);
-    if (err != ESP_OK) {
-        return err;
-    }
+static uint32_t schedule_blob_crc(schedule_blob_t *blob, size_t len)
+{
+    uint32_t stored = blob->crc32;
+    blob->crc32 = 0;
+    uint32_t crc = esp_crc32_le(0, (const uint8_t *)blob, len);
+    blob->crc32 = stored;
+    return crc;
+}
 
-    return prefs_put_u64(SCHEDULE_NAMESPACE, "upd_ms", schedule->updated_at_ms);
+static size_t schedule_blob_len(uint8_t timer_count)
+{
+    return offsetof(schedule_blob_t, timers) + (size_t)timer_count * sizeof(schedule_blob_timer_t);
 }
 
-static esp_err_t load_schedule_locked(node_schedule_t *schedule)
+static size_t schedule_to_blob(const node_schedule_t *schedule, schedule_blob_t *out)
 {
-    if (!schedule) {
-        return ESP_ERR_INVALID_ARG;
+    memset(out, 0, sizeof(*out));
+    out->version = SCHEDULE_BLOB_VERSION;
+    out->timer_count = NODE_SCHEDULE_TARGET_COUNT;
+    out->window_capacity = NODE_SCHEDULE_MAX_WINDOWS;
+    out->timezone_offset_minutes = schedule->timezone_offset_minutes;
+    out->updated_at_ms = schedule->updated_at_ms;
+    for (int t = 0; t < NODE_SCHEDULE_TARGET_COUNT; ++t) {
+        const node_schedule_timer_t *timer = &schedule->timers[t];
+        schedule_blob_timer_t *stored = &out->timers[t];
+        stored->enabled = timer->enabled ? 1U : 0U;
+        stored->window_count = timer->window_count;
+        for (uint8_t w = 0; w < timer->window_count; ++w) {
+            stored->windows[w].start_minute = timer->windows[w].start_minute;
+            stored->windows[w].end_minute = timer->windows[w].end_minute;
+        }
     }
+    size_t len = schedule_blob_len(out->timer_count);
+    out->crc32 = schedule_blob_crc(out, len);
+    return len;
+}
 
-    node_schedule_defaults(schedule);
-    esp_err_t err = ESP_OK;
-
-    bool b = false;
-    uint32_t u = 0;
-    int32_t tz = 0;
-    uint64_t updated_ms = 0;
+static esp_err_t save_schedule_locked(const node_schedule_t *schedule)
+{
+    schedule_blob_t blob;
+    size_t len = schedule_to_blob(schedule, &blob);
+    // Deferred: a burst of schedule edits from the hub costs one commit
+    return prefs_defer_blob(SCHEDULE_NAMESPACE, SCHEDULE_BLOB_KEY, &blob, len);
+}
 
-    b = schedule->light.enabled;
-    err = prefs_get_bool(SCHEDULE_NAMESPACE, "l_en", &b, schedule->light.enabled);
-    if (err == ESP_OK || is_pref_missing(err)) {
-        schedule->light.enabled = b;
-    } else {
+// Write the blob and drop the per-key layout in one commit
+static esp_err_t migrate_schedule_locked(const node_schedule_t *schedule)
+{
+    schedule_blob_t blob;
+    size_t len = schedule_to_blob(schedule, &blob);
+    prefs_txn_t txn;
+    esp_err_t err = prefs_begin(&txn, SCHEDULE_NAMESPACE, true);
+    if (err != ESP_OK) {
         return err;
     }
-    u = schedule->light.start_minute;
-    err = prefs_get_u32(SCHEDULE_NAMESPACE, "l_st", &u, schedule->light.start_minute);
-    if (err == ESP_OK || is_pref_missing(err)) {
-        if (u < 1440U) {
-            schedule->light.start_minute = (uint16_t)u;
+    prefs_txn_put_blob(&txn, SCHEDULE_BLOB_KEY, &blob, len);
+    char key[8];
+    for (int t = 0; t < NODE_SCHEDULE_TARGET_COUNT; ++t) {
+        const char *prefix = ACTUATORS[t].legacy_prefix;
+        if (!prefix) {
+            continue;
         }
-    } else {
-        return err;
-    }
-    u = schedule->light.end_minute;
-    err = prefs_get_u32(SCHEDULE_NAMESPACE, "l_et", &u, schedule->light.end_minute);
-    if (err == ESP_OK || is_pref_missing(err)) {
-        if (u < 1440U) {
-            schedule->light.end_minute = (uint16_t)u;
+        static const char *const suffixes[] = { "en", "st", "et" };
+        for (size_t i = 0; i < sizeof(suffixes) / sizeof(suffixes[0]); ++i) {
+            snprintf(key, sizeof(key), "%s_%s", prefix, suffixes[i]);
+            prefs_txn_erase(&txn, key);
         }
-    } else {
-        return err;
     }
+    prefs_txn_erase(&txn, "tz_ofs");
+    prefs_txn_erase(&txn, "upd_ms");
+    return prefs_commit(&txn);
+}
 
-    b = schedule->pump.enabled;
-    err = prefs_get_bool(SCHEDULE_NAMESPACE, "p_en", &b, schedule->pump.enabled);
-    if (err == ESP_OK || is_pref_missing(err)) {
-        schedule->pump.enabled = b;
-    } else {
-        return err;
+static bool schedule_from_blob(schedule_blob_t *blob, size_t len, node_schedule_t *out)
+{
+    if (len < offsetof(schedule_blob_t, timers) ||
+        blob->timer_count == 0 || blob->timer_count > NODE_SCHEDULE_TARGET_COUNT ||
+        blob->window_capacity != NODE_SCHEDULE_MAX_WINDOWS ||
+        len != schedule_blob_len(blob->timer_count) ||
+        blob->crc32 != schedule_blob_crc(blob, len)) {
+        return false;
     }
-    u = schedule->pump.start_minute;
-    err = prefs_get_u32(SCHEDULE_NAMESPACE, "p_st", &u, schedule->pump.start_minute);
-    if (err == ESP_OK || is_pref_missing(err)) {
-        if (u < 1440U) {
-            schedule->pump.start_minute = (uint16_t)u;
+    // Targets added since the blob was written keep their defaults
+    for (uint8_t t = 0; t < blob->timer_count; ++t) {
+        const schedule_blob_timer_t *stored = &blob->timers[t];
+        node_schedule_timer_t *timer = &out->timers[t];
+        if (stored->window_count == 0 || stored->window_count > NODE_SCHEDULE_MAX_WINDOWS) {
+            return false;
         }
-    } else {
-        return err;
-    }
-    u = schedule->pump.end_minute;
-    err = prefs_get_u32(SCHEDULE_NAMESPACE, "p_et", &u, schedule->pump.end_minute);
-    if (err == ESP_OK || is_pref_missing(err)) {
-        if (u < 1440U) {
-            schedule->pump.end_minute = (uint16_t)u;
+        timer->enabled = stored->enabled != 0;
+        timer->window_count = stored->window_count;
+        for (uint8_t w = 0; w < stored->window_count; ++w) {
+            timer->windows[w].start_minute = stored->windows[w].start_minute;
+            timer->windows[w].end_minute = stored->windows[w].end_minute;
         }
-    } else {
-        return err;
     }
+    out->timezone_offset_minutes = blob->timezone_offset_minutes;
+    out->updated_at_ms = blob->updated_at_ms;
+    return true;
+}
 
-    b = schedule->ic_zone1.enabled;
-    err = prefs_get_bool(SCHEDULE_NAMESPACE, "i_en", &b, schedule->ic_zone1.enabled);
-    if (err == ESP_OK || is_pref_missing(err)) {
-        schedule->ic_zone1.enabled = b;
-    } else {
-        return err;
+static bool schedule_from_blob_v1(const schedule_blob_v1_t *blob, size_t len, node_schedule_t *out)
+{
+    if (len != sizeof(*blob) || blob->timer_count != SCHEDULE_V1_TIMER_COUNT ||
+        blob->crc32 != esp_crc32_le(0, (const uint8_t *)blob, offsetof(schedule_blob_v1_t, crc32))) {
+        return false;
     }
-    u = schedule->ic_zone1.start_minute;
-    err = prefs_get_u32(SCHEDULE_NAMESPACE, "i_st", &u, schedule->ic_zone1.start_minute);
-    if (err == ESP_OK || is_pref_missing(err)) {
-        if (u < 1440U) {
-            schedule->ic_zone1.start_minute = (uint16_t)u;
-        }
-    } else {
-        return err;
+    // The v1 timer order matches the first five targets
+    for (int t = 0; t < SCHEDULE_V1_TIMER_COUNT; ++t) {
+        node_schedule_timer_t *timer = &out->timers[t];
+        timer->enabled = blob->timers[t].enabled != 0;
+        timer->window_count = 1;
+        timer->windows[0].start_minute = blob->timers[t].start_minute;
+        timer->windows[0].end_minute = blob->timers[t].end_minute;
     }
-    u = schedule->ic_zone1.end_minute;
-    err = prefs_get_u32(SCHEDULE_NAMESPACE, "i_et", &u, schedule->ic_zone1.end_minute);
-    if (err == ESP_OK || is_pref_missing(err)) {
-        if (u < 1440U) {
-            schedule->ic_zone1.end_minute = (uint16_t)u;
-        }
-    } else {
+    out->timezone_offset_minutes = blob->timezone_offset_minutes;
+    out->updated_at_ms = blob->updated_at_ms;
+    return true;
+}
+
+// Loads the blob into schedule; *out_stale is set when it was stored in an
+// older layout and should be rewritten
+static esp_err_t load_schedule_blob_locked(node_schedule_t *schedule, bool *out_stale)
+{
+    static schedule_blob_buffer_t blob;  // only touched from init, under schedule_lock
+    size_t len = sizeof(blob);
+    esp_err_t err = prefs_get_blob(SCHEDULE_NAMESPACE, SCHEDULE_BLOB_KEY, &blob, &len);
+    if (err != ESP_OK) {
         return err;
     }
 
-    b = schedule->mister.enabled;
-    err = prefs_get_bool(SCHEDULE_NAMESPACE, "m_en", &b, schedule->mister.enabled);
-    if (err == ESP_OK || is_pref_missing(err)) {
-        schedule->mister.enabled = b;
-    } else {
-        return err;
+    node_schedule_t loaded;
+    node_schedule_defaults(&loaded);
+    bool ok = false;
+    *out_stale = false;
+    if (len >= 1 && blob.version == SCHEDULE_BLOB_VERSION) {
+        ok = schedule_from_blob(&blob.v2, len, &loaded);
+        *out_stale = ok && blob.v2.timer_count != NODE_SCHEDULE_TARGET_COUNT;
+    } else if (len >= 1 && blob.version == SCHEDULE_BLOB_VERSION_V1) {
+        ok = schedule_from_blob_v1(&blob.v1, len, &loaded);
+        *out_stale = ok;
     }
-    u = schedule->mister.start_minute;
-    err = prefs_get_u32(SCHEDULE_NAMESPACE, "m_st", &u, schedule->mister.start_minute);
-    if (err == ESP_OK || is_pref_missing(err)) {
-        if (u < 1440U) {
-            schedule->mister.start_minute = (uint16_t)u;
-        }
-    } else {
-        return err;
+    if (!ok) {
+        return ESP_ERR_INVALID_CRC;
     }
-    u = schedule->mister.end_minute;
-    err = prefs_get_u32(SCHEDULE_NAMESPACE, "m_et", &u, schedule->mister.end_minute);
-    if (err == ESP_OK || is_pref_missing(err)) {
-        if (u < 1440U) {
-            schedule->mister.end_minute = (uint16_t)u;
-        }
-    } else {
-        return err;
+    if (!is_valid_schedule(&loaded)) {
+        return ESP_ERR_INVALID_STATE;
     }
+    *schedule = loaded;
+    return ESP_OK;
+}
 
-    b = schedule->fan.enabled;
-    err = prefs_get_bool(SCHEDULE_NAMESPACE, "f_en", &b, schedule->fan.enabled);
+static esp_err_t read_legacy_timer(prefs_txn_t *txn, const char *prefix, node_schedule_timer_t *timer)
+{
+    char key[8];
+    bool b = timer->enabled;
+    snprintf(key, sizeof(key), "%s_en", prefix);
+    esp_err_t err = prefs_txn_get_bool(txn, key, &b, timer->enabled);
     if (err == ESP_OK || is_pref_missing(err)) {
-        schedule->fan.enabled = b;
+        timer->enabled = b;
     } else {
         return err;
     }
-    u = schedule->fan.start_minute;
-    err = prefs_get_u32(SCHEDULE_NAMESPACE, "f_st", &u, schedule->fan.start_minute);
-    if (err == ESP_OK || is_pref_missing(err)) {
-        if (u < 1440U) {
-            schedule->fan.start_minute = (uint16_t)u;
+
+    uint16_t *minutes[] = { &timer->windows[0].start_minute, &timer->windows[0].end_minute };
+    static const char *const suffixes[] = { "st", "et" };
+    for (size_t i = 0; i < sizeof(suffixes) / sizeof(suffixes[0]); ++i) {
+        uint32_t u = *minutes[i];
+        snprintf(key, sizeof(key), "%s_%s", prefix, suffixes[i]);
+        err = prefs_txn_get_u32(txn, key, &u, *minutes[i]);
+        if (err == ESP_OK || is_pref_missing(err)) {
+            if (u < SCHEDULE_MINUTES_PER_DAY) {
+                *minutes[i] = (uint16_t)u;
+            }
+        } else {
+            return err;
         }
-    } else {
-        return err;
     }
-    u = schedule->fan.end_minute;
-    err = prefs_get_u32(SCHEDULE_NAMESPACE, "f_et", &u, schedule->fan.end_minute);
-    if (err == ESP_OK || is_pref_missing(err)) {
-        if (u < 1440U) {
-            schedule->fan.end_minute = (uint16_t)u;
+    return ESP_OK;
+}
+
+static esp_err_t read_legacy_schedule(prefs_txn_t *txn, node_schedule_t *schedule)
+{
+    esp_err_t err = ESP_OK;
+
+    for (int t = 0; t < NODE_SCHEDULE_TARGET_COUNT; ++t) {
+        if (ACTUATORS[t].legacy_prefix) {
+            err = read_legacy_timer(txn, ACTUATORS[t].legacy_prefix, &schedule->timers[t]);
+            if (err != ESP_OK) {
+                return err;
+            }
         }
-    } else {
-        return err;
     }
 
-    tz = schedule->timezone_offset_minutes;
-    err = prefs_get_i32(SCHEDULE_NAMESPACE, "tz_ofs", &tz, schedule->timezone_offset_minutes);
+    int32_t tz = schedule->timezone_offset_minutes;
+    err = prefs_txn_get_i32(txn, "tz_ofs", &tz, schedule->timezone_offset_minutes);
     if (err == ESP_OK || is_pref_missing(err)) {
         if (tz >= TZ_OFFSET_MIN && tz <= TZ_OFFSET_MAX) {
             schedule->timezone_offset_minutes = (int16_t)tz;
@@ -426,8 +556,8 @@ static esp_err_t load_schedule_locked(node_schedule_t *schedule)
         return err;
     }
 
-    updated_ms = schedule->updated_at_ms;
-    err = prefs_get_u64(SCHEDULE_NAMESPACE, "upd_ms", &updated_ms, schedule->updated_at_ms);
+    uint64_t updated_ms = schedule->updated_at_ms;
+    err = prefs_txn_get_u64(txn, "upd_ms", &updated_ms, schedule->updated_at_ms);
     if (err == ESP_OK || is_pref_missing(err)) {
         schedule->updated_at_ms = updated_ms;
     } else {
@@ -437,120 +567,199 @@ static esp_err_t load_schedule_locked(node_schedule_t *schedule)
     return ESP_OK;
 }
 
-static bool current_minute_of_day(int16_t timezone_offset_minutes, int *out_minute)
+static esp_err_t load_legacy_schedule_locked(node_schedule_t *schedule)
 {
-    if (!out_minute) {
-        return false;
-    }
-    if (!time_sync_is_time_valid()) {
-        return false;
-    }
-
-    struct timeval now;
-    if (gettimeofday(&now, NULL) != 0) {
-        return false;
+    node_schedule_defaults(schedule);
+    prefs_txn_t txn;
+    esp_err_t err = prefs_begin(&txn, SCHEDULE_NAMESPACE, false);
+    if (is_pref_missing(err)) {
+        return ESP_OK;
     }
-
-    int64_t local_minutes = ((int64_t)now.tv_sec / 60LL) + (int64_t)timezone_offset_minutes;
-    int minute = (int)(local_minutes % 1440LL);
-    if (minute < 0) {
-        minute += 1440;
+    if (err != ESP_OK) {
+        return err;
     }
-    *out_minute = minute;
-    return true;
+    err = read_legacy_schedule(&txn, schedule);
+    prefs_end(&txn);
+    return err;
 }
 
-static void apply_schedule_state(const node_schedule_t *schedule, int minute_of_day)
+static esp_err_t load_schedule_locked(node_schedule_t *schedule)
 {
-    bool desired_light = timer_is_active(&schedule->light, minute_of_day);
-    if (!override_should_skip(&override_light) &&
-        sensors_get_light_state() != desired_light) {
-        sensors_set_light_state(desired_light);
+    if (!schedule) {
+        return ESP_ERR_INVALID_ARG;
     }
 
-    bool desired_pump = timer_is_active(&schedule->pump, minute_of_day);
-    if (!override_should_skip(&override_pump) &&
-        sensors_get_pump_state() != desired_pump) {
-        sensors_set_pump_state(desired_pump);
+    bool stale = false;
+    esp_err_t err = load_schedule_blob_locked(schedule, &stale);
+    if (err == ESP_OK) {
+        if (stale) {
+            ESP_LOGI(TAG, "Upgrading stored schedule blob to version %d", SCHEDULE_BLOB_VERSION);
+            err = save_schedule_locked(schedule);
+            if (err != ESP_OK) {
+                ESP_LOGW(TAG, "Schedule blob upgrade failed: %s", esp_err_to_name(err));
+            }
+        }
+        return ESP_OK;
     }
-
-    bool desired_ic_zone1 = timer_is_active(&schedule->ic_zone1, minute_of_day);
-    if (!override_should_skip(&override_ic_zone1) &&
-        sensors_get_ic_zone1_state() != desired_ic_zone1) {
-        sensors_pulse_ic_zone1(desired_ic_zone1, IC_ZONE1_PULSE_MS);
-        sensors_set_ic_zone1_state(desired_ic_zone1);
+    if (!is_pref_missing(err)) {
+        ESP_LOGW(TAG, "Stored schedule blob unusable (%s); trying legacy keys", esp_err_to_name(err));
     }
 
-    bool desired_mister = timer_is_active(&schedule->mister, minute_of_day);
-    if (!override_should_skip(&override_mister) &&
-        sensors_get_mister_state() != desired_mister) {
-        sensors_set_mister_state(desired_mister);
+    err = load_legacy_schedule_locked(schedule);
+    if (err != ESP_OK) {
+        return err;
     }
 
-    bool desired_fan = timer_is_active(&schedule->fan, minute_of_day);
-    if (!override_should_skip(&override_fan) &&
-        sensors_get_fan_state() != desired_fan) {
-        sensors_set_fan_state(desired_fan);
+    // Migrate (or seed) the blob
+    err = migrate_schedule_locked(schedule);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Schedule migration to blob failed: %s", esp_err_to_name(err));
     }
+    return ESP_OK;
 }
 
-static void apply_now_if_possible(void)
+// Milliseconds from now until minute `edge`; an edge at the current minute
+// already happened, so it is a day away
+static uint64_t ms_until_minute(int edge, int minute_of_day, uint32_t ms_into_minute)
 {
-    node_schedule_t snapshot;
-    int minute_of_day = 0;
+    int delta = (edge - minute_of_day + SCHEDULE_MINUTES_PER_DAY) % SCHEDULE_MINUTES_PER_DAY;
+    if (delta == 0) {
+        delta = SCHEDULE_MINUTES_PER_DAY;
+    }
+    return (uint64_t)delta * 60000ULL - ms_into_minute;
+}
+
+// What the schedule asks for right now
+typedef struct {
+    bool clock_valid;
+    uint32_t desired;          // bit per target
+    uint64_t next_edge_ms;     // UINT64_MAX when no output ever changes
+} schedule_now_t;
 
+static bool evaluate_now(schedule_now_t *out)
+{
+    out->clock_valid = false;
+    out->desired = 0;
+    out->next_edge_ms = UINT64_MAX;
     if (!schedule_initialized || !schedule_lock) {
-        return;
+        return false;
     }
 
-    if (xSemaphoreTake(schedule_lock, pdMS_TO_TICKS(100)) != pdTRUE) {
-        return;
+    struct timeval now;
+    if (!time_sync_is_time_valid() || gettimeofday(&now, NULL) != 0) {
+        return true;
     }
-    snapshot = schedule_state;
-    xSemaphoreGive(schedule_lock);
+    uint32_t seq;
+    do {
+        const schedule_copy_t *copy = schedule_read_begin(&seq);
+        const schedule_plan_t *plan = &copy->plan;
+        out->desired = 0;
+        out->next_edge_ms = UINT64_MAX;
+        int64_t local_minutes = ((int64_t)now.tv_sec / 60LL) + (int64_t)copy->schedule.timezone_offset_minutes;
+        int minute = (int)(local_minutes % SCHEDULE_MINUTES_PER_DAY);
+        if (minute < 0) {
+            minute += SCHEDULE_MINUTES_PER_DAY;
+        }
+        for (int t = 0; t < NODE_SCHEDULE_TARGET_COUNT; ++t) {
+            if (mask_test(plan->masks[t], minute)) {
+                out->desired |= 1UL << t;
+            }
+        }
+        // A copy being refilled can hold any count; the retry discards the result
+        uint8_t edge_count = plan->edge_count < SCHEDULE_EDGE_MAX ? plan->edge_count : SCHEDULE_EDGE_MAX;
+        if (edge_count > 0) {
+            // Edges are sorted: the first one past this minute, else tomorrow's first
+            int edge = plan->edges[0];
+            for (uint8_t e = 0; e < edge_count; ++e) {
+                if (plan->edges[e] > minute) {
+                    edge = plan->edges[e];
+                    break;
+                }
+            }
+            uint32_t ms_into_minute = (uint32_t)(now.tv_sec % 60) * 1000U + (uint32_t)(now.tv_usec / 1000);
+            out->next_edge_ms = ms_until_minute(edge, minute, ms_into_minute);
+        }
+    } while (schedule_read_retry(seq));
+    out->clock_valid = true;
+    return true;
+}
 
-    if (!current_minute_of_day(snapshot.timezone_offset_minutes, &minute_of_day)) {
-        return;
+static void apply_schedule_state(uint32_t desired)
+{
+    for (int t = 0; t < NODE_SCHEDULE_TARGET_COUNT; ++t) {
+        const schedule_actuator_t *actuator = &ACTUATORS[t];
+        bool on = (desired >> t) & 1UL;
+        if (!override_should_skip(&overrides[t]) && actuator->get_output() != on) {
+            actuator->set_output(on);
+        }
     }
+}
 
-    apply_schedule_state(&snapshot, minute_of_day);
+static void apply_now_if_possible(void)
+{
+    schedule_now_t now;
+    if (evaluate_now(&now) && now.clock_valid) {
+        apply_schedule_state(now.desired);
+    }
 }
 
-esp_err_t node_schedule_init(void)
+static void log_schedule(const node_schedule_t *schedule)
+{
+    char summary[192];
+    size_t used = 0;
+    summary[0] = '\0';
+    for (int t = 0; t < NODE_SCHEDULE_TARGET_COUNT && used < sizeof(summary); ++t) {
+        const node_schedule_timer_t *timer = &schedule->timers[t];
+        int n = snprintf(summary + used, sizeof(summary) - used, " %s=%d[%u-%u]%s",
+                         ACTUATORS[t].name, timer->enabled ? 1 : 0,
+                         (unsigned)timer->windows[0].start_minute, (unsigned)timer->windows[0].end_minute,
+                         timer->window_count > 1 ? "+" : "");
+        if (n < 0) {
+            break;
+        }
+        used += (size_t)n;
+    }
+    ESP_LOGI(TAG, "Schedule initialized (tzOffsetMin=%d updatedAtMs=%llu%s)",
+             (int)schedule->timezone_offset_minutes,
+             (unsigned long long)schedule->updated_at_ms,
+             summary);
+}
+
+esp_err_t node_schedule_init_retained(const node_schedule_t *retained)
 {
     if (schedule_initialized) {
         return ESP_OK;
     }
 
-    schedule_lock = xSemaphoreCreateMutex();
     if (!schedule_lock) {
-        return ESP_ERR_NO_MEM;
+        schedule_lock = xSemaphoreCreateMutexStatic(&schedule_lock_buf);
     }
 
-    node_schedule_defaults(&schedule_state);
-    esp_err_t err = load_schedule_locked(&schedule_state);
-    if (err != ESP_OK) {
-        ESP_LOGW(TAG, "Failed to load schedule from NVS: %s", esp_err_to_name(err));
-        node_schedule_defaults(&schedule_state);
+    static node_schedule_t schedule;  // only touched from init
+    if (retained && is_valid_schedule(retained)) {
+        schedule = *retained;
+    } else {
+        node_schedule_defaults(&schedule);
+        esp_err_t err = load_schedule_locked(&schedule);
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "Failed to load schedule from NVS: %s", esp_err_to_name(err));
+            node_schedule_defaults(&schedule);
+        }
     }
 
+    publish_schedule_locked(&schedule);
     schedule_initialized = true;
-    ESP_LOGI(
-        TAG,
-        "Schedule initialized (tzOffsetMin=%d updatedAtMs=%llu light=%d[%u-%u] pump=%d[%u-%u] ic1=%d[%u-%u] mister=%d[%u-%u] fan=%d[%u-%u])",
-        (int)schedule_state.timezone_offset_minutes,
-        (unsigned long long)schedule_state.updated_at_ms,
-        schedule_state.light.enabled ? 1 : 0, (unsigned)schedule_state.light.start_minute, (unsigned)schedule_state.light.end_minute,
-        schedule_state.pump.enabled ? 1 : 0, (unsigned)schedule_state.pump.start_minute, (unsigned)schedule_state.pump.end_minute,
-        schedule_state.ic_zone1.enabled ? 1 : 0, (unsigned)schedule_state.ic_zone1.start_minute, (unsigned)schedule_state.ic_zone1.end_minute,
-        schedule_state.mister.enabled ? 1 : 0, (unsigned)schedule_state.mister.start_minute, (unsigned)schedule_state.mister.end_minute,
-        schedule_state.fan.enabled ? 1 : 0, (unsigned)schedule_state.fan.start_minute, (unsigned)schedule_state.fan.end_minute
-    );
+    log_schedule(&schedule);
 
     apply_now_if_possible();
     return ESP_OK;
 }
 
+esp_err_t node_schedule_init(void)
+{
+    return node_schedule_init_retained(NULL);
+}
+
 void node_schedule_get(node_schedule_t *out_schedule)
 {
     if (!out_schedule) {
@@ -562,12 +771,10 @@ void node_schedule_get(node_schedule_t *out_schedule)
         return;
     }
 
-    if (xSemaphoreTake(schedule_lock, pdMS_TO_TICKS(100)) != pdTRUE) {
-        node_schedule_defaults(out_schedule);
-        return;
-    }
-    *out_schedule = schedule_state;
-    xSemaphoreGive(schedule_lock);
+    uint32_t seq;
+    do {
+        *out_schedule = schedule_read_begin(&seq)->schedule;
+    } while (schedule_read_retry(seq));
 }
 
 esp_err_t node_schedule_set(const node_schedule_t *schedule)
@@ -583,18 +790,21 @@ esp_err_t node_schedule_set(const node_schedule_t *schedule)
         return ESP_ERR_TIMEOUT;
     }
 
-    if (schedule_state.updated_at_ms > 0 &&
+    // Writers hold the lock, so the current copy cannot change under us
+    uint32_t seq;
+    uint64_t current_ms = schedule_read_begin(&seq)->schedule.updated_at_ms;
+    if (current_ms > 0 &&
         schedule->updated_at_ms > 0 &&
-        schedule->updated_at_ms < schedule_state.updated_at_ms) {
+        schedule->updated_at_ms < current_ms) {
         xSemaphoreGive(schedule_lock);
         ESP_LOGW(TAG, "Ignoring stale schedule update (incoming=%llu current=%llu)",
                  (unsigned long long)schedule->updated_at_ms,
-                 (unsigned long long)schedule_state.updated_at_ms);
+                 (unsigned long long)current_ms);
         return ESP_ERR_INVALID_STATE;
     }
 
-    schedule_state = *schedule;
-    esp_err_t err = save_schedule_locked(&schedule_state);
+    publish_schedule_locked(schedule);
+    esp_err_t err = save_schedule_locked(schedule);
     xSemaphoreGive(schedule_lock);
 
     if (err != ESP_OK) {
@@ -603,33 +813,55 @@ esp_err_t node_schedule_set(const node_schedule_t *schedule)
 
     ESP_LOGI(TAG, "Schedule updated and persisted");
     apply_now_if_possible();
+    wake_schedule_task();
     return ESP_OK;
 }
 
+// Delay until the next moment any output could change state
+static uint32_t next_transition_delay_ms(const schedule_now_t *now)
+{
+    uint64_t next_ms = SCHEDULE_MAX_SLEEP_MS;
+    uint64_t now_ms = monotonic_ms();
+
+    for (int t = 0; t < NODE_SCHEDULE_TARGET_COUNT; ++t) {
+        const schedule_override_t *ovr = &overrides[t];
+        if (ovr->active) {
+            uint64_t remaining = ovr->expires_at_ms > now_ms ? ovr->expires_at_ms - now_ms : 0;
+            if (remaining < next_ms) {
+                next_ms = remaining;
+            }
+        }
+    }
+
+    if (!now->clock_valid) {
+        return (uint32_t)(next_ms < SCHEDULE_TIME_WAIT_MS ? next_ms : SCHEDULE_TIME_WAIT_MS);
+    }
+    if (now->next_edge_ms < next_ms) {
+        next_ms = now->next_edge_ms;
+    }
+    // Land just past the edge so the minute has rolled over
+    return (uint32_t)next_ms + SCHEDULE_EDGE_SLACK_MS;
+}
+
 void node_schedule_task(void *arg)
 {
     (void)arg;
 
-    while (true) {
-        if (!schedule_initialized || !schedule_lock) {
-            vTaskDelay(pdMS_TO_TICKS(SCHEDULE_TASK_PERIOD_MS));
-            continue;
-        }
-
-        node_schedule_t snapshot;
-        if (xSemaphoreTake(schedule_lock, pdMS_TO_TICKS(100)) != pdTRUE) {
-            vTaskDelay(pdMS_TO_TICKS(SCHEDULE_TASK_PERIOD_MS));
-            continue;
-        }
-        snapshot = schedule_state;
-        xSemaphoreGive(schedule_lock);
+    schedule_task_handle = xTaskGetCurrentTaskHandle();
 
-        int minute_of_day = 0;
-        if (current_minute_of_day(snapshot.timezone_offset_minutes, &minute_of_day)) {
-            apply_schedule_state(&snapshot, minute_of_day);
+    while (true) {
+        uint32_t delay_ms = SCHEDULE_TIME_WAIT_MS;
+        schedule_now_t now;
+        if (evaluate_now(&now)) {
+            if (now.clock_valid) {
+                apply_schedule_state(now.desired);
+            }
+            delay_ms = next_transition_delay_ms(&now);
         }
 
-        vTaskDelay(pdMS_TO_TICKS(SCHEDULE_TASK_PERIOD_MS));
+        ESP_LOGD(TAG, "Next schedule check in %u ms", (unsigned)delay_ms);
+        // node_schedule_set() and overrides notify us to re-plan early
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(delay_ms));
     }
 }
 
@@ -648,6 +880,7 @@ void node_schedule_set_override(node_schedule_target_t target, bool on, uint32_t
                  target_name(target),
                  (unsigned)effective_duration_ms,
                  (unsigned)duration_ms);
+        wake_schedule_task();
         return;
     }
 
@@ -655,4 +888,27 @@ void node_schedule_set_override(node_schedule_target_t target, bool on, uint32_t
     ovr->expires_at_ms = 0;
     ESP_LOGI(TAG, "Manual override cleared for %s; reapplying schedule", target_name(target));
     apply_now_if_possible();
+    wake_schedule_task();
+}
+
+bool node_schedule_overrides_active(void)
+{
+    for (int t = 0; t < NODE_SCHEDULE_TARGET_COUNT; ++t) {
+        if (overrides[t].active) {
+            return true;
+        }
+    }
+    return false;
+}
+
+uint32_t node_schedule_next_transition_ms(void)
+{
+    schedule_now_t now;
+    evaluate_now(&now);
+    return next_transition_delay_ms(&now);
+}
+
+void node_schedule_kick(void)
+{
+    wake_schedule_task();
 }
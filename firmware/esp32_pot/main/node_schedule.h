@@ -9,37 +9,51 @@
 extern "C" {
 #endif
 
+// Daily windows per actuator. A window runs from start to end (exclusive),
+// wrapping past midnight when end < start; start == end means all day.
+#define NODE_SCHEDULE_MAX_WINDOWS 4
+
+typedef enum {
+    NODE_SCHEDULE_TARGET_LIGHT = 0,
+    NODE_SCHEDULE_TARGET_PUMP,
+    NODE_SCHEDULE_TARGET_IC_ZONE1,
+    NODE_SCHEDULE_TARGET_MISTER,
+    NODE_SCHEDULE_TARGET_FAN,
+    NODE_SCHEDULE_TARGET_COUNT,
+} node_schedule_target_t;
+
 typedef struct {
-    bool enabled;
     uint16_t start_minute;
     uint16_t end_minute;
+} node_schedule_window_t;
+
+typedef struct {
+    bool enabled;
+    uint8_t window_count;       // 1..NODE_SCHEDULE_MAX_WINDOWS; overlaps merge
+    node_schedule_window_t windows[NODE_SCHEDULE_MAX_WINDOWS];
 } node_schedule_timer_t;
 
 typedef struct {
-    node_schedule_timer_t light;
-    node_schedule_timer_t pump;
-    node_schedule_timer_t ic_zone1;
-    node_schedule_timer_t mister;
-    node_schedule_timer_t fan;
+    node_schedule_timer_t timers[NODE_SCHEDULE_TARGET_COUNT];  // by node_schedule_target_t
     int16_t timezone_offset_minutes;
     uint64_t updated_at_ms;
 } node_schedule_t;
 
-typedef enum {
-    NODE_SCHEDULE_TARGET_LIGHT = 0,
-    NODE_SCHEDULE_TARGET_PUMP,
-    NODE_SCHEDULE_TARGET_IC_ZONE1,
-    NODE_SCHEDULE_TARGET_MISTER,
-    NODE_SCHEDULE_TARGET_FAN,
-} node_schedule_target_t;
-
 void node_schedule_defaults(node_schedule_t *out_schedule);
 bool node_schedule_parse_hhmm(const char *value, uint16_t *out_minutes);
 esp_err_t node_schedule_init(void);
+// Start from a schedule retained across deep sleep instead of reading NVS
+esp_err_t node_schedule_init_retained(const node_schedule_t *retained);
 esp_err_t node_schedule_set(const node_schedule_t *schedule);
 void node_schedule_get(node_schedule_t *out_schedule);
 void node_schedule_task(void *arg);
 void node_schedule_set_override(node_schedule_target_t target, bool on, uint32_t duration_ms);
+bool node_schedule_overrides_active(void);
+// Re-evaluate now, e.g. once the clock has become valid
+void node_schedule_kick(void);
+// Milliseconds until the next timer edge or override expiry (capped), or a
+// short poll period while the clock is not yet valid
+uint32_t node_schedule_next_transition_ms(void);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,520 @@
+#include "offline_buffer.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#include "esp_attr.h"
+#include "esp_crc.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "sdkconfig.h"
+
+#include "hardware_config.h"
+#include "plant_mqtt.h"
+#include "storage.h"
+
+static const char *TAG = "offline_buf";
+
+#define OFFLINE_ACK_LOG_LEN 8
+
+_Static_assert(OFFLINE_DRAIN_BATCH <= MQTT_READING_BATCH_MAX,
+               "a backlog batch must fit in one batch message");
+
+// The batch currently being uploaded as a single batch message. Owned by the
+// drain task; only the PUBACK log below is shared with the MQTT event task.
+typedef struct {
+    storage_cursor_t next;    // cursor just past the batch, committed once it is acked
+    size_t count;
+    telemetry_sample_t samples[OFFLINE_DRAIN_BATCH];
+    sensor_reading_t readings[OFFLINE_DRAIN_BATCH];
+    int msg_id;               // -1 if the publish was not queued
+    int64_t sent_at_us;
+    bool history;             // answers the history request below, not the backlog
+} offline_batch_t;
+
+// The history request being served, also owned by the drain task
+typedef struct {
+    bool active;
+    storage_history_t query;
+    char request_id[MQTT_REQUEST_ID_MAX_LEN];
+    size_t sent;
+} offline_history_t;
+
+// A history request waiting for the drain task
+typedef struct {
+    uint64_t from_ms;
+    uint64_t to_ms;
+    char request_id[MQTT_REQUEST_ID_MAX_LEN];
+} offline_history_request_t;
+
+typedef struct {
+    bool ready;
+    bool connected;
+    // PUBACKs arrive on the MQTT event task, possibly before publish() has
+    // handed the msg_id back to us, so they are logged and matched later.
+    int ack_log[OFFLINE_ACK_LOG_LEN];
+    size_t ack_log_next;
+    // History requests handed over by the command handler, oldest first,
+    // taken by the drain once the current one is done
+    offline_history_request_t history_queue[OFFLINE_HISTORY_QUEUE_DEPTH];
+    size_t history_head;
+    size_t history_queued;
+} offline_state_t;
+
+static offline_state_t state = {
+    .ready = false,
+    .connected = false,
+};
+static portMUX_TYPE state_lock = portMUX_INITIALIZER_UNLOCKED;
+static offline_batch_t batch;
+static offline_history_t history;
+static offline_history_done_callback_t history_done_cb;
+
+static esp_err_t offline_append(const sensor_reading_t *reading);
+
+#if CONFIG_PROJECTPLANT_MQTT_DURABLE_LIVE
+_Static_assert(TELEMETRY_LIVE_BATCH <= OFFLINE_LIVE_INFLIGHT_MAX,
+               "a live batch must fit in the inflight journal");
+
+#define OFFLINE_LIVE_MAGIC 0x4C495645u  // "LIVE", seeds the slot CRC
+
+// Live readings from their QoS 1 publish until the PUBACK. esp-mqtt holds
+// the message itself in its RAM outbox and retransmits it across
+// reconnects; the journal only keeps the reading where a reset cannot clear
+// it. A slot the outbox dropped (expired) is moved to the ring by the drain
+// task, and every valid slot left by a watchdog, panic or software reset is
+// moved there at boot, so the backlog replays them.
+typedef enum {
+    LIVE_SLOT_FREE = 0,
+    LIVE_SLOT_SENDING,    // publish call still running, msg_id not known yet
+    LIVE_SLOT_INFLIGHT,   // queued as msg_id, waiting for its PUBACK
+    LIVE_SLOT_EXPIRED,    // dropped from the outbox unacknowledged
+} live_slot_state_t;
+
+typedef struct {
+    sensor_reading_t reading;
+    int32_t msg_id;
+    uint32_t slot_state;      // live_slot_state_t
+    uint32_t crc32;           // esp_crc32_le over the bytes before this field
+} live_slot_t;
+
+// Survives every reset but a power cycle; validated slot by slot at boot.
+// Slots are changed under state_lock, by the publishing and MQTT event tasks.
+static RTC_NOINIT_ATTR live_slot_t live_journal[OFFLINE_LIVE_INFLIGHT_MAX];
+
+static uint32_t live_slot_crc(const live_slot_t *slot)
+{
+    return esp_crc32_le(OFFLINE_LIVE_MAGIC, (const uint8_t *)slot, offsetof(live_slot_t, crc32));
+}
+
+static void live_slot_set(live_slot_t *slot, live_slot_state_t slot_state, int32_t msg_id)
+{
+    slot->slot_state = slot_state;
+    slot->msg_id = msg_id;
+    slot->crc32 = live_slot_crc(slot);
+}
+
+// Move readings a reset left unacknowledged to the ring, then start empty
+static void live_journal_recover(void)
+{
+    size_t recovered = 0;
+    for (size_t i = 0; i < OFFLINE_LIVE_INFLIGHT_MAX; ++i) {
+        const live_slot_t *slot = &live_journal[i];
+        if (slot->crc32 == live_slot_crc(slot) && slot->slot_state != LIVE_SLOT_FREE &&
+            slot->slot_state <= LIVE_SLOT_EXPIRED && offline_append(&slot->reading) == ESP_OK) {
+            recovered++;
+        }
+    }
+    memset(live_journal, 0, sizeof(live_journal));
+    if (recovered > 0) {
+        ESP_LOGW(TAG, "%u unacknowledged live readings recovered after reset", (unsigned)recovered);
+    }
+}
+
+// Claim a slot per reading before publishing; false if the journal is full
+static bool live_journal_reserve(const sensor_reading_t *readings, size_t count, size_t *slots)
+{
+    size_t found = 0;
+    portENTER_CRITICAL(&state_lock);
+    for (size_t i = 0; i < OFFLINE_LIVE_INFLIGHT_MAX && found < count; ++i) {
+        if (live_journal[i].slot_state == LIVE_SLOT_FREE) {
+            slots[found++] = i;
+        }
+    }
+    if (found == count) {
+        for (size_t j = 0; j < count; ++j) {
+            live_slot_t *slot = &live_journal[slots[j]];
+            memcpy(&slot->reading, &readings[j], sizeof(slot->reading));
+            live_slot_set(slot, LIVE_SLOT_SENDING, -1);
+        }
+    }
+    portEXIT_CRITICAL(&state_lock);
+    return found == count;
+}
+
+// The publish returned: wait for msg_id's PUBACK, or release the slots if
+// nothing was queued or the PUBACK already beat us here
+static void live_journal_queued(const size_t *slots, size_t count, int msg_id)
+{
+    portENTER_CRITICAL(&state_lock);
+    bool done = msg_id <= 0;
+    for (size_t j = 0; j < OFFLINE_ACK_LOG_LEN && !done; ++j) {
+        done = state.ack_log[j] == msg_id;
+    }
+    for (size_t j = 0; j < count; ++j) {
+        live_slot_set(&live_journal[slots[j]], done ? LIVE_SLOT_FREE : LIVE_SLOT_INFLIGHT, msg_id);
+    }
+    portEXIT_CRITICAL(&state_lock);
+}
+
+// Move slots of msg_id from one state to another; call under state_lock
+static void live_journal_update(int msg_id, live_slot_state_t from, live_slot_state_t to)
+{
+    for (size_t i = 0; i < OFFLINE_LIVE_INFLIGHT_MAX; ++i) {
+        live_slot_t *slot = &live_journal[i];
+        if (slot->slot_state == from && slot->msg_id == msg_id) {
+            live_slot_set(slot, to, msg_id);
+        }
+    }
+}
+
+// Drain task: hand readings the outbox gave up on to the ring
+static void live_journal_spill_expired(void)
+{
+    for (size_t i = 0; i < OFFLINE_LIVE_INFLIGHT_MAX; ++i) {
+        sensor_reading_t reading;
+        portENTER_CRITICAL(&state_lock);
+        bool expired = live_journal[i].slot_state == LIVE_SLOT_EXPIRED;
+        if (expired) {
+            reading = live_journal[i].reading;
+        }
+        portEXIT_CRITICAL(&state_lock);
+        if (!expired) {
+            continue;
+        }
+        // Append before freeing: a reset in between replays it twice, not never
+        offline_append(&reading);
+        portENTER_CRITICAL(&state_lock);
+        live_slot_set(&live_journal[i], LIVE_SLOT_FREE, -1);
+        portEXIT_CRITICAL(&state_lock);
+    }
+}
+#endif
+
+esp_err_t offline_buffer_init(void)
+{
+    esp_err_t err = storage_init();
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Telemetry store unavailable (%s); readings will not survive outages", esp_err_to_name(err));
+        return err;
+    }
+    for (size_t i = 0; i < OFFLINE_ACK_LOG_LEN; ++i) {
+        state.ack_log[i] = -1;
+    }
+#if CONFIG_PROJECTPLANT_MQTT_DURABLE_LIVE
+    // Before ready: until then the event task leaves the journal alone, so
+    // PUBACKs on the new connection cannot match a previous boot's msg_ids
+    live_journal_recover();
+#endif
+    state.ready = true;
+    size_t pending = storage_count();
+    if (pending > 0) {
+        ESP_LOGI(TAG, "%u buffered readings from a previous outage", (unsigned)pending);
+    }
+    return ESP_OK;
+}
+
+void offline_buffer_set_connected(bool connected)
+{
+    portENTER_CRITICAL(&state_lock);
+    // An inflight message survives a disconnect: esp-mqtt retransmits it from
+    // its outbox, and the ack timeout in the drain step covers expiry.
+    state.connected = connected;
+    portEXIT_CRITICAL(&state_lock);
+}
+
+void offline_buffer_on_published(int msg_id)
+{
+    portENTER_CRITICAL(&state_lock);
+    state.ack_log[state.ack_log_next] = msg_id;
+    state.ack_log_next = (state.ack_log_next + 1) % OFFLINE_ACK_LOG_LEN;
+#if CONFIG_PROJECTPLANT_MQTT_DURABLE_LIVE
+    if (state.ready) {
+        live_journal_update(msg_id, LIVE_SLOT_INFLIGHT, LIVE_SLOT_FREE);
+    }
+#endif
+    portEXIT_CRITICAL(&state_lock);
+}
+
+void offline_buffer_on_deleted(int msg_id)
+{
+#if CONFIG_PROJECTPLANT_MQTT_DURABLE_LIVE
+    portENTER_CRITICAL(&state_lock);
+    if (state.ready) {
+        live_journal_update(msg_id, LIVE_SLOT_INFLIGHT, LIVE_SLOT_EXPIRED);
+    }
+    portEXIT_CRITICAL(&state_lock);
+#else
+    (void)msg_id;
+#endif
+}
+
+bool offline_buffer_is_connected(void)
+{
+    portENTER_CRITICAL(&state_lock);
+    bool connected = state.connected;
+    portEXIT_CRITICAL(&state_lock);
+    return connected;
+}
+
+size_t offline_buffer_pending(void)
+{
+    return state.ready ? storage_count() : 0;
+}
+
+void offline_buffer_set_history_callback(offline_history_done_callback_t cb)
+{
+    history_done_cb = cb;
+}
+
+esp_err_t offline_buffer_request_history(uint64_t from_ms, uint64_t to_ms, const char *request_id)
+{
+    if (from_ms > to_ms) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!state.ready) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    esp_err_t err = ESP_ERR_NO_MEM;
+    portENTER_CRITICAL(&state_lock);
+    if (state.history_queued < OFFLINE_HISTORY_QUEUE_DEPTH) {
+        offline_history_request_t *req =
+            &state.history_queue[(state.history_head + state.history_queued) % OFFLINE_HISTORY_QUEUE_DEPTH];
+        req->from_ms = from_ms;
+        req->to_ms = to_ms;
+        strncpy(req->request_id, request_id ? request_id : "", sizeof(req->request_id) - 1);
+        req->request_id[sizeof(req->request_id) - 1] = '\0';
+        state.history_queued++;
+        err = ESP_OK;
+    }
+    portEXIT_CRITICAL(&state_lock);
+    return err;
+}
+
+bool offline_buffer_history_active(void)
+{
+    portENTER_CRITICAL(&state_lock);
+    bool pending = state.history_queued > 0;
+    portEXIT_CRITICAL(&state_lock);
+    return pending || history.active;
+}
+
+static esp_err_t offline_append(const sensor_reading_t *reading)
+{
+    telemetry_sample_t sample = {
+        .reading = *reading,
+        .uptime_ms = esp_timer_get_time() / 1000,
+        .rssi = 0,
+    };
+    wifi_ap_record_t ap;
+    if (esp_wifi_sta_get_ap_info(&ap) == ESP_OK) {
+        sample.rssi = ap.rssi;
+    }
+
+    esp_err_t err = storage_append_sample(&sample);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to buffer reading: %s", esp_err_to_name(err));
+    }
+    return err;
+}
+
+esp_err_t offline_buffer_store(const sensor_reading_t *reading)
+{
+    if (!reading) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!state.ready) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    esp_err_t err = offline_append(reading);
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "Broker offline; buffered reading (%u pending)", (unsigned)storage_count());
+    }
+    return err;
+}
+
+esp_err_t offline_buffer_publish_live(esp_mqtt_client_handle_t client, const char *device_id,
+                                      const sensor_reading_t *readings, size_t count)
+{
+    if (!readings || count == 0 || count > MQTT_READING_BATCH_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    bool publish = true;
+#if CONFIG_PROJECTPLANT_MQTT_DURABLE_LIVE
+    size_t slots[OFFLINE_LIVE_INFLIGHT_MAX];
+    bool journaled = state.ready && count <= OFFLINE_LIVE_INFLIGHT_MAX &&
+                     live_journal_reserve(readings, count, slots);
+    // A full journal means the broker is not keeping up; the backlog paces it
+    publish = journaled || !state.ready;
+#endif
+    int msg_id = -1;
+    if (publish) {
+        msg_id = count == 1 ? mqtt_publish_reading(client, device_id, &readings[0], NULL)
+                            : mqtt_publish_reading_batch(client, device_id, readings, count, NULL);
+    }
+#if CONFIG_PROJECTPLANT_MQTT_DURABLE_LIVE
+    if (journaled) {
+        live_journal_queued(slots, count, msg_id);
+    }
+#endif
+    if (msg_id >= 0) {
+        return ESP_OK;
+    }
+    if (!state.ready) {
+        return ESP_FAIL;
+    }
+    // Outbox full or publish refused: the ring keeps them instead of the heap
+    ESP_LOGW(TAG, "Live publish not queued; buffering %u readings", (unsigned)count);
+    esp_err_t err = ESP_OK;
+    for (size_t i = 0; i < count; ++i) {
+        esp_err_t append_err = offline_append(&readings[i]);
+        if (append_err != ESP_OK) {
+            err = append_err;
+        }
+    }
+    return err;
+}
+
+esp_err_t offline_buffer_flush(void)
+{
+    if (!state.ready) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    return storage_flush();
+}
+
+// Match logged PUBACKs against the batch message
+static bool offline_collect_ack(void)
+{
+    bool acked = false;
+    portENTER_CRITICAL(&state_lock);
+    for (size_t j = 0; j < OFFLINE_ACK_LOG_LEN && batch.msg_id >= 0; ++j) {
+        if (state.ack_log[j] == batch.msg_id) {
+            state.ack_log[j] = -1;
+            acked = true;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&state_lock);
+    return acked;
+}
+
+// (Re)publish the whole batch as one message
+static bool offline_publish_batch(esp_mqtt_client_handle_t client, const char *device_id)
+{
+    batch.msg_id = mqtt_publish_reading_batch(client, device_id, batch.readings, batch.count,
+                                              batch.history ? history.request_id : NULL);
+    batch.sent_at_us = esp_timer_get_time();
+    return batch.msg_id >= 0;
+}
+
+// Start the oldest queued history request; false if none is waiting
+static bool offline_history_start_next(void)
+{
+    offline_history_request_t req;
+    portENTER_CRITICAL(&state_lock);
+    bool found = state.history_queued > 0;
+    if (found) {
+        req = state.history_queue[state.history_head];
+        state.history_head = (state.history_head + 1) % OFFLINE_HISTORY_QUEUE_DEPTH;
+        state.history_queued--;
+    }
+    portEXIT_CRITICAL(&state_lock);
+
+    if (found) {
+        memcpy(history.request_id, req.request_id, sizeof(history.request_id));
+        storage_history_begin(&history.query, req.from_ms, req.to_ms);
+        history.active = true;
+        history.sent = 0;
+    }
+    return found;
+}
+
+// Fill the batch from the current history request once the backlog is
+// empty, moving on to the next queued one as each finishes. Returns the
+// number of readings staged.
+static size_t offline_history_next(void)
+{
+    while (history.active || offline_history_start_next()) {
+        size_t count = storage_history_read(&history.query, batch.samples, OFFLINE_DRAIN_BATCH);
+        if (count > 0) {
+            return count;
+        }
+        history.active = false;
+        ESP_LOGI(TAG, "History request %s done: %u readings", history.request_id, (unsigned)history.sent);
+        if (history_done_cb) {
+            history_done_cb(history.request_id, history.sent);
+        }
+    }
+    return 0;
+}
+
+uint32_t offline_buffer_drain_step(esp_mqtt_client_handle_t client, const char *device_id)
+{
+    if (!state.ready) {
+        return OFFLINE_DRAIN_IDLE_MS;
+    }
+    storage_flush_if_due();
+#if CONFIG_PROJECTPLANT_MQTT_DURABLE_LIVE
+    live_journal_spill_expired();
+#endif
+
+    if (batch.count > 0 && offline_collect_ack()) {
+        if (batch.history) {
+            history.sent += batch.count;
+        } else {
+            // Whole batch delivered: drop it from flash with one header update
+            storage_commit_cursor(&batch.next);
+            ESP_LOGD(TAG, "Replayed %u buffered readings", (unsigned)batch.count);
+        }
+        batch.count = 0;
+    }
+
+    if (!offline_buffer_is_connected() || !client) {
+        return OFFLINE_DRAIN_IDLE_MS;
+    }
+
+    if (batch.count > 0) {
+        if (esp_timer_get_time() - batch.sent_at_us < (int64_t)OFFLINE_ACK_TIMEOUT_MS * 1000) {
+            return OFFLINE_DRAIN_INTERVAL_MS;
+        }
+        ESP_LOGW(TAG, "%s batch not acknowledged; resending", batch.history ? "History" : "Backlog");
+    } else {
+        storage_cursor_begin(&batch.next);
+        batch.count = storage_read_batch(&batch.next, batch.samples, OFFLINE_DRAIN_BATCH);
+        batch.history = false;
+        if (batch.count == 0) {
+            // Only blank or keyframe slots were left; let the tail catch up
+            storage_commit_cursor(&batch.next);
+            // With the backlog delivered, serve any history request
+            batch.count = offline_history_next();
+            batch.history = batch.count > 0;
+        }
+        if (batch.count == 0) {
+            return offline_buffer_history_active() ? OFFLINE_DRAIN_INTERVAL_MS : OFFLINE_DRAIN_IDLE_MS;
+        }
+        for (size_t i = 0; i < batch.count; ++i) {
+            batch.readings[i] = batch.samples[i].reading;
+        }
+        batch.msg_id = -1;
+    }
+
+    if (!offline_publish_batch(client, device_id)) {
+        ESP_LOGW(TAG, "Backlog publish failed; %u readings pending", (unsigned)storage_count());
+        return OFFLINE_DRAIN_IDLE_MS;
+    }
+    return OFFLINE_DRAIN_INTERVAL_MS;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+#include <mqtt_client.h>
+
+#include "sensors.h"
+
+// Store-and-forward for sensor readings. While the broker is unreachable,
+// readings are persisted to the LittleFS telemetry ring (storage.c); once the
+// link is back, the publishing task drains the backlog oldest-first, up to
+// OFFLINE_DRAIN_BATCH readings per QoS 1 batch message (pots/<id>/sensors/batch);
+// a batch is dropped from flash only once its message has been acknowledged.
+// Live readings go out through offline_buffer_publish_live(); those the MQTT
+// client cannot hold (outbox full) or gives up on (expired) are persisted the
+// same way, and with CONFIG_PROJECTPLANT_MQTT_DURABLE_LIVE so are readings
+// still unacknowledged when the node resets.
+
+esp_err_t offline_buffer_init(void);
+
+// MQTT event task hooks (see mqtt_set_link_callbacks)
+void offline_buffer_set_connected(bool connected);
+void offline_buffer_on_published(int msg_id);
+void offline_buffer_on_deleted(int msg_id);
+
+bool offline_buffer_is_connected(void);
+size_t offline_buffer_pending(void);
+
+// Persist a reading that could not be published live
+esp_err_t offline_buffer_store(const sensor_reading_t *reading);
+// Publish live readings on the reading topic (count 1) or as one batch
+// message; readings that could not be queued go to the ring. Fails only if
+// they were neither queued nor stored.
+esp_err_t offline_buffer_publish_live(esp_mqtt_client_handle_t client, const char *device_id,
+                                      const sensor_reading_t *readings, size_t count);
+// Write readings still staged in RAM to flash (before a deep sleep)
+esp_err_t offline_buffer_flush(void);
+
+// Replay buffered readings already delivered, for gap repair on the hub.
+// Readings with timestamp_ms in [from_ms, to_ms] that are still on flash go
+// out as batch messages tagged with request_id, paced like the backlog and
+// after it. Requests run one at a time in arrival order, with up to
+// OFFLINE_HISTORY_QUEUE_DEPTH waiting; ESP_ERR_NO_MEM when that queue is
+// full. The callback runs on the drain task once per request, when it has
+// been fully sent.
+typedef void (*offline_history_done_callback_t)(const char *request_id, size_t sent);
+void offline_buffer_set_history_callback(offline_history_done_callback_t cb);
+esp_err_t offline_buffer_request_history(uint64_t from_ms, uint64_t to_ms, const char *request_id);
+bool offline_buffer_history_active(void);
+
+// One paced drain step, called from the publishing task between live
+// readings. Returns how long (ms) the caller may block before the next step.
+uint32_t offline_buffer_drain_step(esp_mqtt_client_handle_t client, const char *device_id);
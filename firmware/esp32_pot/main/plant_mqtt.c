@@ -2,33 +2,64 @@
 
 #include <limits.h>
 #include <math.h>
+#include <stddef.h>
 #include <stdio.h>
-#include <stdlib.h>
 #include <string.h>
 #include <strings.h>
 #include <sys/time.h>
 #include <time.h>
 
 #include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
 #include "freertos/task.h"
 
-#include "cJSON.h"
 #include "esp_err.h"
 #include "esp_log.h"
 #include "esp_timer.h"
+#include "sdkconfig.h"
+#if CONFIG_MBEDTLS_CERTIFICATE_BUNDLE
+#include "esp_crt_bundle.h"
+#endif
+#if CONFIG_PROJECTPLANT_MQTT_TLS_SESSION_TICKETS
+#include "esp_transport_ssl.h"
+#endif
 
 #include "hardware_config.h"
+#include "json_reader.h"
+#include "json_writer.h"
+#include "latency_hist.h"
+#include "node_diag.h"
+#include "power_manager.h"
+#include "preferences.h"
 #include "time_sync.h"
 
+// Fixed payload buffers (stack, per publishing task); sized for the longest
+// device id/name plus margin. Oversized payloads are dropped with a warning.
+#define PING_PAYLOAD_MAX        128
+#define STATUS_PAYLOAD_MAX      640     // plus a watering result or scene
+#if CONFIG_PROJECTPLANT_LATENCY_HISTOGRAMS
+#define DIAG_PAYLOAD_MAX        1408    // plus one histogram per latency stage
+#else
+#define DIAG_PAYLOAD_MAX        768
+#endif
+#define READING_PAYLOAD_MAX     768
+#define BATCH_PAYLOAD_MAX       1280    // header + MQTT_READING_BATCH_MAX compact samples
+#define SCHEDULE_PAYLOAD_MAX    1536    // every timer at NODE_SCHEDULE_MAX_WINDOWS
+
+#define MQTT_TLS_DEFAULT_PORT   8883
+
 static const char *TAG = "mqtt";
 static mqtt_command_callback_t command_callback = NULL;
+static mqtt_link_callback_t link_callback = NULL;
+static mqtt_published_callback_t published_callback = NULL;
+static mqtt_published_callback_t deleted_callback = NULL;
 static char command_topic[96];
 static char device_id_buffer[64];
 static const uint64_t MIN_VALID_TIMESTAMP_MS = 1609459200ULL * 1000ULL;
 
 static uint64_t current_epoch_ms(void);
 static void format_hhmm(uint16_t minutes, char *buffer, size_t buffer_len);
-static void add_schedule_timer(cJSON *schedule_obj, const char *name, const node_schedule_timer_t *timer);
+static void write_schedule_timer(json_writer_t *w, const char *name, const node_schedule_timer_t *timer);
 
 static void log_stack_metrics(const char *label)
 {
@@ -54,72 +85,620 @@ static bool topic_equals(const char *topic, int topic_len, const char *expected)
     return topic_len == (int)expected_len && strncmp(topic, expected, expected_len) == 0;
 }
 
-static bool parse_schedule_timer(const cJSON *schedule_obj, const char *name, node_schedule_timer_t *out_timer)
+#if CONFIG_PROJECTPLANT_RELAY_GATEWAY
+// Pots whose command topics this gateway relays over ESP-NOW (espnow_relay.c).
+// Added by the relay task, read by the MQTT event task, under relay_lock.
+typedef struct {
+    char device_id[DEVICE_ID_MAX_LEN];
+    bool subscribed;          // on the current session
+} relay_subscription_t;
+
+static relay_subscription_t relay_subscriptions[MQTT_RELAY_MAX];
+static size_t relay_subscription_count;
+static StaticSemaphore_t relay_lock_buf;
+static SemaphoreHandle_t relay_lock;
+static mqtt_relay_command_callback_t relay_callback = NULL;
+
+// Subscribe every relayed command topic the session does not hold yet.
+// Entries are only ever appended, so an index stays valid unlocked; the
+// client is never called with relay_lock held, since the event handler
+// takes relay_lock while the client holds its own lock.
+static void relay_subscribe_pending(esp_mqtt_client_handle_t client, bool session_present)
+{
+    for (size_t i = 0; i < MQTT_RELAY_MAX; ++i) {
+        char topic[96];
+        bool pending = false;
+        if (!relay_lock || xSemaphoreTake(relay_lock, portMAX_DELAY) != pdTRUE) {
+            return;
+        }
+        if (i < relay_subscription_count) {
+            relay_subscription_t *sub = &relay_subscriptions[i];
+            if (!session_present) {
+                sub->subscribed = false;
+            }
+            pending = !sub->subscribed;
+            snprintf(topic, sizeof(topic), COMMAND_TOPIC_FMT, sub->device_id);
+        }
+        xSemaphoreGive(relay_lock);
+        if (pending && esp_mqtt_client_subscribe(client, topic, 1) >= 0 &&
+            xSemaphoreTake(relay_lock, portMAX_DELAY) == pdTRUE) {
+            relay_subscriptions[i].subscribed = true;
+            xSemaphoreGive(relay_lock);
+        }
+    }
+}
+
+// The device id of a relayed pots/<id>/command topic, or false
+static bool relay_topic_device(const char *topic, int topic_len, char *device_id, size_t device_id_len)
+{
+    static const char prefix[] = "pots/";
+    static const char suffix[] = "/command";
+    const int prefix_len = (int)sizeof(prefix) - 1;
+    const int suffix_len = (int)sizeof(suffix) - 1;
+    if (!topic || topic_len <= prefix_len + suffix_len ||
+        strncmp(topic, prefix, prefix_len) != 0 ||
+        strncmp(topic + topic_len - suffix_len, suffix, suffix_len) != 0) {
+        return false;
+    }
+    int id_len = topic_len - prefix_len - suffix_len;
+    if (id_len >= (int)device_id_len) {
+        return false;
+    }
+    memcpy(device_id, topic + prefix_len, id_len);
+    device_id[id_len] = '\0';
+
+    bool relayed = false;
+    if (relay_lock && xSemaphoreTake(relay_lock, portMAX_DELAY) == pdTRUE) {
+        for (size_t i = 0; i < relay_subscription_count && !relayed; ++i) {
+            relayed = strcmp(relay_subscriptions[i].device_id, device_id) == 0;
+        }
+        xSemaphoreGive(relay_lock);
+    }
+    return relayed;
+}
+
+void mqtt_set_relay_callback(mqtt_relay_command_callback_t cb)
+{
+    relay_callback = cb;
+}
+
+esp_err_t mqtt_relay_add(esp_mqtt_client_handle_t client, const char *device_id)
+{
+    if (!device_id || !device_id[0] || strlen(device_id) >= DEVICE_ID_MAX_LEN) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!relay_lock || xSemaphoreTake(relay_lock, portMAX_DELAY) != pdTRUE) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    esp_err_t err = ESP_OK;
+    bool known = false;
+    for (size_t i = 0; i < relay_subscription_count && !known; ++i) {
+        known = strcmp(relay_subscriptions[i].device_id, device_id) == 0;
+    }
+    if (!known && relay_subscription_count == MQTT_RELAY_MAX) {
+        err = ESP_ERR_NO_MEM;
+    } else if (!known) {
+        relay_subscription_t *sub = &relay_subscriptions[relay_subscription_count++];
+        strncpy(sub->device_id, device_id, sizeof(sub->device_id) - 1);
+        sub->device_id[sizeof(sub->device_id) - 1] = '\0';
+        sub->subscribed = false;
+    }
+    xSemaphoreGive(relay_lock);
+    if (err == ESP_OK && client) {
+        // Fails while disconnected; the next CONNECTED event retries
+        relay_subscribe_pending(client, true);
+    }
+    return err;
+}
+#endif
+
+// Topics published with an MQTT 5 topic alias (numbers as sent). Only the
+// ping and diag topics qualify: they go out at QoS 0, so a message that leaves
+// the topic out for its alias is never resent on a later connection, where
+// the alias would mean nothing. QoS 1 messages sit in the outbox until acked.
+typedef enum {
+    TOPIC_ALIAS_NONE = 0,
+    TOPIC_ALIAS_PING,
+    TOPIC_ALIAS_PING_BIN,
+    TOPIC_ALIAS_DIAG,
+    TOPIC_ALIAS_COUNT,
+} topic_alias_t;
+
+#if CONFIG_PROJECTPLANT_MQTT_V5
+#define CORRELATED_IDS_MAX 4
+
+// esp_mqtt5_client_set_publish_property() applies to whichever publish comes
+// next, so the two calls run under publish_lock. The MQTT task holds the
+// client's own lock while it runs mqtt_event_handler, so it only ever tries
+// publish_lock; taking the locks in the other order would deadlock.
+static StaticSemaphore_t publish_lock_buf;
+static SemaphoreHandle_t publish_lock;
+static uint32_t connection_serial;                 // bumped on MQTT_EVENT_CONNECTED
+static uint32_t alias_serial[TOPIC_ALIAS_COUNT];   // connection each alias was last bound on
+
+// Request ids that arrived as correlation data rather than in the JSON.
+// Replies to them echo the id as correlation data and leave requestId out.
+static StaticSemaphore_t correlation_lock_buf;
+static SemaphoreHandle_t correlation_lock;
+static char correlated_ids[CORRELATED_IDS_MAX][MQTT_REQUEST_ID_MAX_LEN];
+static size_t correlated_next;
+
+static void remember_correlated_id(const char *request_id)
+{
+    if (!correlation_lock || xSemaphoreTake(correlation_lock, portMAX_DELAY) != pdTRUE) {
+        return;
+    }
+    strncpy(correlated_ids[correlated_next], request_id, sizeof(correlated_ids[0]) - 1);
+    correlated_ids[correlated_next][sizeof(correlated_ids[0]) - 1] = '\0';
+    correlated_next = (correlated_next + 1) % CORRELATED_IDS_MAX;
+    xSemaphoreGive(correlation_lock);
+}
+
+static bool is_correlated_id(const char *request_id)
+{
+    bool found = false;
+    if (!request_id || !request_id[0] || !correlation_lock ||
+        xSemaphoreTake(correlation_lock, portMAX_DELAY) != pdTRUE) {
+        return false;
+    }
+    for (size_t i = 0; i < CORRELATED_IDS_MAX && !found; ++i) {
+        found = strcmp(correlated_ids[i], request_id) == 0;
+    }
+    xSemaphoreGive(correlation_lock);
+    return found;
+}
+
+// Correlation data is opaque bytes; only a printable id that fits is used
+static bool copy_correlation_id(const esp_mqtt5_event_property_t *property, char *out, size_t out_len)
+{
+    if (!property || !property->correlation_data || property->correlation_data_len == 0 ||
+        property->correlation_data_len >= out_len) {
+        return false;
+    }
+    for (int i = 0; i < property->correlation_data_len; ++i) {
+        uint8_t c = property->correlation_data[i];
+        if (c < 0x20 || c > 0x7e || c == '"' || c == '\\') {
+            return false;
+        }
+    }
+    memcpy(out, property->correlation_data, property->correlation_data_len);
+    out[property->correlation_data_len] = '\0';
+    return true;
+}
+
+static int publish_with_properties(esp_mqtt_client_handle_t client,
+                                   const char *topic,
+                                   topic_alias_t alias,
+                                   const char *data,
+                                   int len,
+                                   int qos,
+                                   bool retain,
+                                   const char *request_id)
+{
+    esp_mqtt5_publish_property_config_t property = {0};
+    if (request_id && is_correlated_id(request_id)) {
+        property.correlation_data = request_id;
+        property.correlation_data_len = (uint16_t)strlen(request_id);
+    }
+    bool alias_bound = false;
+    if (alias != TOPIC_ALIAS_NONE && qos == 0) {
+        property.topic_alias = (uint16_t)alias;
+        // Fails when the broker's Topic Alias Maximum is lower; send the topic
+        if (esp_mqtt5_client_set_publish_property(client, &property) == ESP_OK) {
+            alias_bound = alias_serial[alias] == connection_serial;
+        } else {
+            property.topic_alias = 0;
+            alias = TOPIC_ALIAS_NONE;
+        }
+    }
+    if (property.topic_alias == 0 && property.correlation_data) {
+        esp_mqtt5_client_set_publish_property(client, &property);
+    }
+
+    // The first publish on a connection carries the topic and binds the alias
+    int msg_id = esp_mqtt_client_publish(client, alias_bound ? "" : topic, data, len, qos, retain);
+    if (msg_id >= 0 && alias != TOPIC_ALIAS_NONE) {
+        alias_serial[alias] = connection_serial;
+    }
+    return msg_id;
+}
+#endif
+
+static int publish_message(esp_mqtt_client_handle_t client,
+                           const char *topic,
+                           topic_alias_t alias,
+                           const char *data,
+                           int len,
+                           int qos,
+                           bool retain,
+                           const char *request_id)
+{
+#if CONFIG_PROJECTPLANT_MQTT_V5
+    if (!publish_lock || xSemaphoreTakeRecursive(publish_lock, portMAX_DELAY) != pdTRUE) {
+        return -1;
+    }
+    int msg_id = publish_with_properties(client, topic, alias, data, len, qos, retain, request_id);
+    xSemaphoreGiveRecursive(publish_lock);
+    return msg_id;
+#else
+    (void)alias;
+    (void)request_id;
+    return esp_mqtt_client_publish(client, topic, data, len, qos, retain);
+#endif
+}
+
+// requestId in a reply, unless it travels as MQTT 5 correlation data
+static void write_request_id(json_writer_t *w, const char *request_id)
+{
+    if (!request_id || !request_id[0]) {
+        return;
+    }
+#if CONFIG_PROJECTPLANT_MQTT_V5
+    if (is_correlated_id(request_id)) {
+        return;
+    }
+#endif
+    json_writer_string(w, "requestId", request_id);
+}
+
+typedef struct {
+    const char *js;
+    const json_tok_t *toks;
+    int count;
+} command_doc_t;
+
+enum {
+    ROOT_KEY_REQUEST_ID,
+    ROOT_KEY_DEVICE_NAME,
+    ROOT_KEY_DISPLAY_NAME,
+    ROOT_KEY_SENSOR_MODE,
+    ROOT_KEY_SENSORS_ENABLED,
+    ROOT_KEY_PAYLOAD_ENCODING,
+    ROOT_KEY_SCHEDULE,
+    ROOT_KEY_TZ_OFFSET,
+    ROOT_KEY_SCHEDULE_UPDATED_AT,
+    ROOT_KEY_UPDATED_AT,
+    ROOT_KEY_ACTION,
+    ROOT_KEY_COMMAND,
+    ROOT_KEY_PUMP,
+    ROOT_KEY_IC_ZONE1,
+    ROOT_KEY_IC_ZONE1_ALT,
+    ROOT_KEY_FAN,
+    ROOT_KEY_MISTER,
+    ROOT_KEY_LIGHT,
+    ROOT_KEY_DURATION,
+    ROOT_KEY_FROM_MS,
+    ROOT_KEY_TO_MS,
+    ROOT_KEY_REPORT_POLICY,
+    ROOT_KEY_SOIL_CALIBRATION,
+    ROOT_KEY_MEASUREMENT_INTERVAL,
+    ROOT_KEY_TARGET_MOISTURE,
+    ROOT_KEY_MAX_VOLUME,
+    ROOT_KEY_SCENE,
+    ROOT_KEY_COUNT,
+};
+
+static const char *const ROOT_KEYS[ROOT_KEY_COUNT] = {
+    [ROOT_KEY_REQUEST_ID] = "requestId",
+    [ROOT_KEY_DEVICE_NAME] = "deviceName",
+    [ROOT_KEY_DISPLAY_NAME] = "displayName",
+    [ROOT_KEY_SENSOR_MODE] = "sensorMode",
+    [ROOT_KEY_SENSORS_ENABLED] = "sensorsEnabled",
+    [ROOT_KEY_PAYLOAD_ENCODING] = "payloadEncoding",
+    [ROOT_KEY_SCHEDULE] = "schedule",
+    [ROOT_KEY_TZ_OFFSET] = "tzOffsetMinutes",
+    [ROOT_KEY_SCHEDULE_UPDATED_AT] = "scheduleUpdatedAtMs",
+    [ROOT_KEY_UPDATED_AT] = "updatedAtMs",
+    [ROOT_KEY_ACTION] = "action",
+    [ROOT_KEY_COMMAND] = "command",
+    [ROOT_KEY_PUMP] = "pump",
+    [ROOT_KEY_IC_ZONE1] = "icZone1",
+    [ROOT_KEY_IC_ZONE1_ALT] = "ic_zone1",
+    [ROOT_KEY_FAN] = "fan",
+    [ROOT_KEY_MISTER] = "mister",
+    [ROOT_KEY_LIGHT] = "light",
+    [ROOT_KEY_DURATION] = "duration_ms",
+    [ROOT_KEY_FROM_MS] = "fromMs",
+    [ROOT_KEY_TO_MS] = "toMs",
+    [ROOT_KEY_REPORT_POLICY] = "reportPolicy",
+    [ROOT_KEY_SOIL_CALIBRATION] = "soilCalibration",
+    [ROOT_KEY_MEASUREMENT_INTERVAL] = "measurementInterval",
+    [ROOT_KEY_TARGET_MOISTURE] = "targetMoisture",
+    [ROOT_KEY_MAX_VOLUME] = "maxVolumeMl",
+    [ROOT_KEY_SCENE] = "scene",
+};
+
+enum {
+    SCHED_KEY_LIGHT,
+    SCHED_KEY_PUMP,
+    SCHED_KEY_MISTER,
+    SCHED_KEY_FAN,
+    SCHED_KEY_IC_ZONE1,
+    SCHED_KEY_IC_ZONE1_ALT,
+    SCHED_KEY_TZ_OFFSET,
+    SCHED_KEY_SCHEDULE_UPDATED_AT,
+    SCHED_KEY_UPDATED_AT,
+    SCHED_KEY_COUNT,
+};
+
+static const char *const SCHEDULE_KEYS[SCHED_KEY_COUNT] = {
+    [SCHED_KEY_LIGHT] = "light",
+    [SCHED_KEY_PUMP] = "pump",
+    [SCHED_KEY_MISTER] = "mister",
+    [SCHED_KEY_FAN] = "fan",
+    [SCHED_KEY_IC_ZONE1] = "ic_zone1",
+    [SCHED_KEY_IC_ZONE1_ALT] = "icZone1",
+    [SCHED_KEY_TZ_OFFSET] = "tzOffsetMinutes",
+    [SCHED_KEY_SCHEDULE_UPDATED_AT] = "scheduleUpdatedAtMs",
+    [SCHED_KEY_UPDATED_AT] = "updatedAtMs",
+};
+
+// Schedule timers on the wire, by node_schedule_target_t. `name` is what
+// schedule_state publishes; input is looked up under `key`, then `alt`.
+static const struct {
+    const char *name;
+    int key;
+    int alt;
+    bool required;
+} SCHEDULE_TIMERS[NODE_SCHEDULE_TARGET_COUNT] = {
+    [NODE_SCHEDULE_TARGET_LIGHT] = { "light", SCHED_KEY_LIGHT, -1, true },
+    [NODE_SCHEDULE_TARGET_PUMP] = { "pump", SCHED_KEY_PUMP, -1, true },
+    [NODE_SCHEDULE_TARGET_IC_ZONE1] = { "icZone1", SCHED_KEY_IC_ZONE1, SCHED_KEY_IC_ZONE1_ALT, false },
+    [NODE_SCHEDULE_TARGET_MISTER] = { "mister", SCHED_KEY_MISTER, -1, true },
+    [NODE_SCHEDULE_TARGET_FAN] = { "fan", SCHED_KEY_FAN, -1, true },
+};
+
+// A scene output given as an object instead of a bare state
+enum {
+    SCENE_KEY_STATE,
+    SCENE_KEY_DURATION,
+    SCENE_KEY_COUNT,
+};
+
+static const char *const SCENE_KEYS[SCENE_KEY_COUNT] = {
+    [SCENE_KEY_STATE] = "state",
+    [SCENE_KEY_DURATION] = "duration_ms",
+};
+
+enum {
+    REPORT_KEY_MOISTURE,
+    REPORT_KEY_TEMPERATURE,
+    REPORT_KEY_HUMIDITY,
+    REPORT_KEY_MAX_SILENCE,
+    REPORT_KEY_COUNT,
+};
+
+static const char *const REPORT_KEYS[REPORT_KEY_COUNT] = {
+    [REPORT_KEY_MOISTURE] = "moistureDeadband",
+    [REPORT_KEY_TEMPERATURE] = "temperatureDeadband",
+    [REPORT_KEY_HUMIDITY] = "humidityDeadband",
+    [REPORT_KEY_MAX_SILENCE] = "maxSilenceS",
+};
+
+enum {
+    SOIL_CAL_KEY_DRY,
+    SOIL_CAL_KEY_WET,
+    SOIL_CAL_KEY_COUNT,
+};
+
+static const char *const SOIL_CAL_KEYS[SOIL_CAL_KEY_COUNT] = {
+    [SOIL_CAL_KEY_DRY] = "rawDry",
+    [SOIL_CAL_KEY_WET] = "rawWet",
+};
+
+enum {
+    INTERVAL_KEY_ACTIVE,
+    INTERVAL_KEY_MIN,
+    INTERVAL_KEY_MAX,
+    INTERVAL_KEY_COUNT,
+};
+
+static const char *const INTERVAL_KEYS[INTERVAL_KEY_COUNT] = {
+    [INTERVAL_KEY_ACTIVE] = "activeS",
+    [INTERVAL_KEY_MIN] = "minS",
+    [INTERVAL_KEY_MAX] = "maxS",
+};
+
+enum {
+    TIMER_KEY_ENABLED,
+    TIMER_KEY_START,
+    TIMER_KEY_END,
+    TIMER_KEY_WINDOWS,
+    TIMER_KEY_COUNT,
+};
+
+static const char *const TIMER_KEYS[TIMER_KEY_COUNT] = {
+    [TIMER_KEY_ENABLED] = "enabled",
+    [TIMER_KEY_START] = "startTime",
+    [TIMER_KEY_END] = "endTime",
+    [TIMER_KEY_WINDOWS] = "windows",
+};
+
+// Override keys in precedence order; the first one present wins
+static const struct {
+    int key;
+    int alt_key;    // consulted only when key is absent, -1 if none
+    mqtt_command_type_t type;
+    size_t state_offset;
+} OVERRIDE_KEYS[] = {
+    { ROOT_KEY_PUMP, -1, MQTT_CMD_PUMP_OVERRIDE, offsetof(mqtt_command_t, pump_on) },
+    { ROOT_KEY_IC_ZONE1, ROOT_KEY_IC_ZONE1_ALT, MQTT_CMD_IC_ZONE1_OVERRIDE, offsetof(mqtt_command_t, ic_zone1_on) },
+    { ROOT_KEY_FAN, -1, MQTT_CMD_FAN_OVERRIDE, offsetof(mqtt_command_t, fan_on) },
+    { ROOT_KEY_MISTER, -1, MQTT_CMD_MISTER_OVERRIDE, offsetof(mqtt_command_t, mister_on) },
+    { ROOT_KEY_LIGHT, -1, MQTT_CMD_LIGHT_OVERRIDE, offsetof(mqtt_command_t, light_on) },
+};
+
+static const json_tok_t *doc_tok(const command_doc_t *doc, int idx)
+{
+    return (idx >= 0 && idx < doc->count) ? &doc->toks[idx] : NULL;
+}
+
+static bool doc_is(const command_doc_t *doc, int idx, json_tok_type_t type)
+{
+    const json_tok_t *tok = doc_tok(doc, idx);
+    return tok && tok->type == type;
+}
+
+static bool doc_is_bool(const command_doc_t *doc, int idx)
 {
-    if (!schedule_obj || !name || !out_timer) {
+    return doc_is(doc, idx, JSON_TOK_TRUE) || doc_is(doc, idx, JSON_TOK_FALSE);
+}
+
+static bool doc_number(const command_doc_t *doc, int idx, double *out)
+{
+    return json_reader_number(doc->js, doc_tok(doc, idx), out);
+}
+
+// Integer view of a number with the same saturation cJSON applies to valueint
+static bool doc_int(const command_doc_t *doc, int idx, int *out)
+{
+    double value = 0;
+    if (!doc_number(doc, idx, &value)) {
         return false;
     }
+    if (value >= (double)INT_MAX) {
+        *out = INT_MAX;
+    } else if (value <= (double)INT_MIN) {
+        *out = INT_MIN;
+    } else {
+        *out = (int)value;
+    }
+    return true;
+}
 
-    cJSON *timer_obj = cJSON_GetObjectItemCaseSensitive((cJSON *)schedule_obj, name);
-    if (!cJSON_IsObject(timer_obj)) {
+// Non-negative millisecond timestamp; out is left alone if absent or negative
+static bool doc_epoch_ms(const command_doc_t *doc, int idx, uint64_t *out)
+{
+    double value = 0;
+    if (!doc_number(doc, idx, &value) || !(value >= 0)) {
         return false;
     }
+    *out = value >= (double)UINT64_MAX ? UINT64_MAX : (uint64_t)value;
+    return true;
+}
+
+// Single pass over an object's members, recording the value index of each
+// wanted key (first occurrence, like cJSON_GetObjectItemCaseSensitive)
+static void doc_index_members(const command_doc_t *doc, int obj, const char *const *keys, size_t key_count, int *out)
+{
+    for (size_t k = 0; k < key_count; ++k) {
+        out[k] = -1;
+    }
+    if (!doc_is(doc, obj, JSON_TOK_OBJECT)) {
+        return;
+    }
+
+    int idx = obj + 1;
+    for (uint16_t m = 0; m < doc->toks[obj].size && idx + 1 < doc->count; ++m) {
+        for (size_t k = 0; k < key_count; ++k) {
+            if (out[k] < 0 && json_reader_string_equals(doc->js, &doc->toks[idx], keys[k])) {
+                out[k] = idx + 1;
+                break;
+            }
+        }
+        idx = json_reader_next(doc->toks, doc->count, idx + 1);
+    }
+}
 
-    cJSON *enabled = cJSON_GetObjectItemCaseSensitive(timer_obj, "enabled");
-    cJSON *start_time = cJSON_GetObjectItemCaseSensitive(timer_obj, "startTime");
-    cJSON *end_time = cJSON_GetObjectItemCaseSensitive(timer_obj, "endTime");
-    if (!cJSON_IsBool(enabled) || !cJSON_IsString(start_time) || !start_time->valuestring ||
-        !cJSON_IsString(end_time) || !end_time->valuestring) {
+static bool parse_schedule_window(const command_doc_t *doc, const int *fields, node_schedule_window_t *out_window)
+{
+    char start_time[8];
+    char end_time[8];
+    if (json_reader_string_copy(doc->js, doc_tok(doc, fields[TIMER_KEY_START]), start_time, sizeof(start_time)) < 0 ||
+        json_reader_string_copy(doc->js, doc_tok(doc, fields[TIMER_KEY_END]), end_time, sizeof(end_time)) < 0) {
         return false;
     }
 
     uint16_t start_minute = 0;
     uint16_t end_minute = 0;
-    if (!node_schedule_parse_hhmm(start_time->valuestring, &start_minute) ||
-        !node_schedule_parse_hhmm(end_time->valuestring, &end_minute)) {
+    if (!node_schedule_parse_hhmm(start_time, &start_minute) ||
+        !node_schedule_parse_hhmm(end_time, &end_minute)) {
         return false;
     }
-
-    out_timer->enabled = cJSON_IsTrue(enabled);
-    out_timer->start_minute = start_minute;
-    out_timer->end_minute = end_minute;
+    out_window->start_minute = start_minute;
+    out_window->end_minute = end_minute;
     return true;
 }
 
-static bool parse_schedule_config(cJSON *root, node_schedule_t *out_schedule)
+// {"enabled", "startTime", "endTime"} for one window a day, or
+// {"enabled", "windows": [{"startTime", "endTime"}, ...]} for several
+static bool parse_schedule_timer(const command_doc_t *doc, int timer_idx, node_schedule_timer_t *out_timer)
 {
-    if (!root || !out_schedule) {
+    if (!doc || !out_timer || !doc_is(doc, timer_idx, JSON_TOK_OBJECT)) {
         return false;
     }
 
-    cJSON *schedule_obj = cJSON_GetObjectItemCaseSensitive(root, "schedule");
-    if (!cJSON_IsObject(schedule_obj)) {
+    int fields[TIMER_KEY_COUNT];
+    doc_index_members(doc, timer_idx, TIMER_KEYS, TIMER_KEY_COUNT, fields);
+    if (!doc_is_bool(doc, fields[TIMER_KEY_ENABLED])) {
         return false;
     }
 
-    node_schedule_t parsed;
-    node_schedule_defaults(&parsed);
+    node_schedule_timer_t timer = {
+        .enabled = doc_is(doc, fields[TIMER_KEY_ENABLED], JSON_TOK_TRUE),
+        .window_count = 1,
+    };
+    int windows_idx = fields[TIMER_KEY_WINDOWS];
+    if (doc_is(doc, windows_idx, JSON_TOK_ARRAY)) {
+        uint16_t count = doc->toks[windows_idx].size;
+        if (count == 0 || count > NODE_SCHEDULE_MAX_WINDOWS) {
+            return false;
+        }
+        int idx = windows_idx + 1;
+        for (uint16_t w = 0; w < count; ++w) {
+            int window_fields[TIMER_KEY_COUNT];
+            doc_index_members(doc, idx, TIMER_KEYS, TIMER_KEY_COUNT, window_fields);
+            if (!parse_schedule_window(doc, window_fields, &timer.windows[w])) {
+                return false;
+            }
+            idx = json_reader_next(doc->toks, doc->count, idx);
+        }
+        timer.window_count = (uint8_t)count;
+    } else if (!parse_schedule_window(doc, fields, &timer.windows[0])) {
+        return false;
+    }
+
+    *out_timer = timer;
+    return true;
+}
 
-    if (!parse_schedule_timer(schedule_obj, "light", &parsed.light) ||
-        !parse_schedule_timer(schedule_obj, "pump", &parsed.pump) ||
-        !parse_schedule_timer(schedule_obj, "mister", &parsed.mister) ||
-        !parse_schedule_timer(schedule_obj, "fan", &parsed.fan)) {
-        ESP_LOGW(TAG, "Invalid schedule payload; expected full timer config for light/pump/mister/fan");
+static bool parse_schedule_config(const command_doc_t *doc, const int *root_keys, node_schedule_t *out_schedule)
+{
+    if (!doc || !root_keys || !out_schedule) {
+        return false;
+    }
+
+    int schedule_idx = root_keys[ROOT_KEY_SCHEDULE];
+    if (!doc_is(doc, schedule_idx, JSON_TOK_OBJECT)) {
         return false;
     }
 
-    if (!parse_schedule_timer(schedule_obj, "ic_zone1", &parsed.ic_zone1)) {
-        if (!parse_schedule_timer(schedule_obj, "icZone1", &parsed.ic_zone1)) {
-            ESP_LOGD(TAG, "Schedule payload missing ic_zone1; keeping defaults");
+    int keys[SCHED_KEY_COUNT];
+    doc_index_members(doc, schedule_idx, SCHEDULE_KEYS, SCHED_KEY_COUNT, keys);
+
+    node_schedule_t parsed;
+    node_schedule_defaults(&parsed);
+
+    for (int t = 0; t < NODE_SCHEDULE_TARGET_COUNT; ++t) {
+        int key = keys[SCHEDULE_TIMERS[t].key];
+        int alt = SCHEDULE_TIMERS[t].alt >= 0 ? keys[SCHEDULE_TIMERS[t].alt] : -1;
+        if (parse_schedule_timer(doc, key, &parsed.timers[t]) ||
+            parse_schedule_timer(doc, alt, &parsed.timers[t])) {
+            continue;
+        }
+        if (SCHEDULE_TIMERS[t].required) {
+            ESP_LOGW(TAG, "Invalid schedule payload; expected full timer config for %s", SCHEDULE_TIMERS[t].name);
+            return false;
         }
+        ESP_LOGD(TAG, "Schedule payload missing %s; keeping defaults", SCHEDULE_TIMERS[t].name);
     }
 
-    cJSON *tz_offset = cJSON_GetObjectItemCaseSensitive(root, "tzOffsetMinutes");
-    if (!tz_offset) {
-        tz_offset = cJSON_GetObjectItemCaseSensitive(schedule_obj, "tzOffsetMinutes");
+    int tz_offset = root_keys[ROOT_KEY_TZ_OFFSET];
+    if (tz_offset < 0) {
+        tz_offset = keys[SCHED_KEY_TZ_OFFSET];
     }
-    if (cJSON_IsNumber(tz_offset)) {
-        int tz_value = tz_offset->valueint;
+    int tz_value = 0;
+    if (doc_int(doc, tz_offset, &tz_value)) {
         if (tz_value >= -720 && tz_value <= 840) {
             parsed.timezone_offset_minutes = (int16_t)tz_value;
         } else {
@@ -127,24 +706,22 @@ static bool parse_schedule_config(cJSON *root, node_schedule_t *out_schedule)
         }
     }
 
-    cJSON *updated_at = cJSON_GetObjectItemCaseSensitive(root, "scheduleUpdatedAtMs");
-    if (!updated_at) {
-        updated_at = cJSON_GetObjectItemCaseSensitive(schedule_obj, "scheduleUpdatedAtMs");
+    int updated_at = root_keys[ROOT_KEY_SCHEDULE_UPDATED_AT];
+    if (updated_at < 0) {
+        updated_at = keys[SCHED_KEY_SCHEDULE_UPDATED_AT];
     }
-    if (!updated_at) {
-        updated_at = cJSON_GetObjectItemCaseSensitive(root, "updatedAtMs");
+    if (updated_at < 0) {
+        updated_at = root_keys[ROOT_KEY_UPDATED_AT];
     }
-    if (!updated_at) {
-        updated_at = cJSON_GetObjectItemCaseSensitive(schedule_obj, "updatedAtMs");
+    if (updated_at < 0) {
+        updated_at = keys[SCHED_KEY_UPDATED_AT];
     }
-    if (cJSON_IsNumber(updated_at) && updated_at->valuedouble >= 0) {
-        double updated_value = updated_at->valuedouble;
-        if (updated_value > 0) {
-            if (updated_value > (double)UINT64_MAX) {
-                parsed.updated_at_ms = UINT64_MAX;
-            } else {
-                parsed.updated_at_ms = (uint64_t)updated_value;
-            }
+    double updated_value = 0;
+    if (doc_number(doc, updated_at, &updated_value) && updated_value > 0) {
+        if (updated_value > (double)UINT64_MAX) {
+            parsed.updated_at_ms = UINT64_MAX;
+        } else {
+            parsed.updated_at_ms = (uint64_t)updated_value;
         }
     }
 
@@ -152,6 +729,175 @@ static bool parse_schedule_config(cJSON *root, node_schedule_t *out_schedule)
     return true;
 }
 
+// Partial updates are fine; returns the REPORT_POLICY_FIELD_* bits present.
+// Range checks happen in report_policy_update().
+static uint8_t parse_report_policy(const command_doc_t *doc, const int *root_keys, report_policy_t *out)
+{
+    int keys[REPORT_KEY_COUNT];
+    doc_index_members(doc, root_keys[ROOT_KEY_REPORT_POLICY], REPORT_KEYS, REPORT_KEY_COUNT, keys);
+
+    uint8_t mask = 0;
+    double value = 0;
+    if (doc_number(doc, keys[REPORT_KEY_MOISTURE], &value)) {
+        out->moisture_pct = (float)value;
+        mask |= REPORT_POLICY_FIELD_MOISTURE;
+    }
+    if (doc_number(doc, keys[REPORT_KEY_TEMPERATURE], &value)) {
+        out->temperature_c = (float)value;
+        mask |= REPORT_POLICY_FIELD_TEMPERATURE;
+    }
+    if (doc_number(doc, keys[REPORT_KEY_HUMIDITY], &value)) {
+        out->humidity_pct = (float)value;
+        mask |= REPORT_POLICY_FIELD_HUMIDITY;
+    }
+    if (doc_number(doc, keys[REPORT_KEY_MAX_SILENCE], &value) && value >= 0) {
+        out->max_silence_s = value >= (double)UINT32_MAX ? UINT32_MAX : (uint32_t)value;
+        mask |= REPORT_POLICY_FIELD_MAX_SILENCE;
+    }
+    return mask;
+}
+
+// Both points are required; the span is checked by soil_calibration_set()
+static bool parse_soil_calibration(const command_doc_t *doc, const int *root_keys, soil_calibration_t *out)
+{
+    int keys[SOIL_CAL_KEY_COUNT];
+    doc_index_members(doc, root_keys[ROOT_KEY_SOIL_CALIBRATION], SOIL_CAL_KEYS, SOIL_CAL_KEY_COUNT, keys);
+
+    int dry = 0;
+    int wet = 0;
+    if (!doc_int(doc, keys[SOIL_CAL_KEY_DRY], &dry) || !doc_int(doc, keys[SOIL_CAL_KEY_WET], &wet)) {
+        return false;
+    }
+    if (dry < 0 || dry > UINT16_MAX || wet < 0 || wet > UINT16_MAX) {
+        ESP_LOGW(TAG, "soilCalibration out of range (dry %d, wet %d), ignoring", dry, wet);
+        return false;
+    }
+    out->raw_dry = (uint16_t)dry;
+    out->raw_wet = (uint16_t)wet;
+    return true;
+}
+
+// All three bounds are required; their order is checked by
+// measurement_interval_set_bounds()
+static bool parse_interval_bounds(const command_doc_t *doc, const int *root_keys, measurement_interval_bounds_t *out)
+{
+    int keys[INTERVAL_KEY_COUNT];
+    doc_index_members(doc, root_keys[ROOT_KEY_MEASUREMENT_INTERVAL], INTERVAL_KEYS, INTERVAL_KEY_COUNT, keys);
+
+    int values[INTERVAL_KEY_COUNT];
+    for (size_t i = 0; i < INTERVAL_KEY_COUNT; ++i) {
+        if (!doc_int(doc, keys[i], &values[i])) {
+            return false;
+        }
+        if (values[i] < 0) {
+            ESP_LOGW(TAG, "measurementInterval %s negative, ignoring", INTERVAL_KEYS[i]);
+            return false;
+        }
+    }
+    out->active_s = (uint32_t)values[INTERVAL_KEY_ACTIVE];
+    out->min_s = (uint32_t)values[INTERVAL_KEY_MIN];
+    out->max_s = (uint32_t)values[INTERVAL_KEY_MAX];
+    return true;
+}
+
+// Override state as the single-output commands take it: true or "on"
+// switch on, false or any other string off; false when it is neither
+static bool doc_switch(const command_doc_t *doc, int idx, bool *out_on)
+{
+    if (!doc_is_bool(doc, idx) && !doc_is(doc, idx, JSON_TOK_STRING)) {
+        return false;
+    }
+    *out_on = doc_is(doc, idx, JSON_TOK_TRUE) || json_reader_string_equals(doc->js, doc_tok(doc, idx), "on");
+    return true;
+}
+
+// Outputs use the schedule's names; each is a state or {"state", "duration_ms"},
+// the root duration_ms applying where an output has none
+static bool parse_scene(const command_doc_t *doc, const int *root_keys, actuator_scene_t *out)
+{
+    int keys[SCHED_KEY_COUNT];
+    doc_index_members(doc, root_keys[ROOT_KEY_SCENE], SCHEDULE_KEYS, SCHED_KEY_COUNT, keys);
+
+    int default_duration = 0;
+    doc_int(doc, root_keys[ROOT_KEY_DURATION], &default_duration);
+    memset(out, 0, sizeof(*out));
+    for (int t = 0; t < NODE_SCHEDULE_TARGET_COUNT; ++t) {
+        int value = keys[SCHEDULE_TIMERS[t].key];
+        if (value < 0 && SCHEDULE_TIMERS[t].alt >= 0) {
+            value = keys[SCHEDULE_TIMERS[t].alt];
+        }
+        int duration = default_duration;
+        bool on = false;
+        if (doc_is(doc, value, JSON_TOK_OBJECT)) {
+            int entry[SCENE_KEY_COUNT];
+            doc_index_members(doc, value, SCENE_KEYS, SCENE_KEY_COUNT, entry);
+            doc_int(doc, entry[SCENE_KEY_DURATION], &duration);
+            value = entry[SCENE_KEY_STATE];
+        }
+        if (!doc_switch(doc, value, &on)) {
+            continue;
+        }
+        out->mask |= (uint8_t)(1u << t);
+        if (on) {
+            out->on |= (uint8_t)(1u << t);
+            out->duration_ms[t] = duration > 0 ? (uint32_t)duration : 0;
+        }
+    }
+    return out->mask != 0;
+}
+
+// Binary payloads are explicit little-endian byte streams, independent of struct packing
+static uint8_t *put_le16(uint8_t *p, uint16_t value)
+{
+    p[0] = (uint8_t)value;
+    p[1] = (uint8_t)(value >> 8);
+    return p + 2;
+}
+
+static uint8_t *put_le32(uint8_t *p, uint32_t value)
+{
+    for (int i = 0; i < 4; ++i) {
+        p[i] = (uint8_t)(value >> (8 * i));
+    }
+    return p + 4;
+}
+
+static uint8_t *put_le64(uint8_t *p, uint64_t value)
+{
+    for (int i = 0; i < 8; ++i) {
+        p[i] = (uint8_t)(value >> (8 * i));
+    }
+    return p + 8;
+}
+
+static uint8_t *put_bin_header(uint8_t *p, uint8_t kind, uint8_t flags, uint64_t timestamp_ms)
+{
+    *p++ = MQTT_BIN_SCHEMA_VERSION;
+    *p++ = kind;
+    *p++ = flags;
+    *p++ = 0;
+    return put_le64(p, timestamp_ms);
+}
+
+// Header byte 3: set after encoding, the encoders take the final timestamp
+static void mark_binary_estimated(uint8_t *bin, size_t len, bool estimated)
+{
+    if (estimated && len >= MQTT_BIN_HEADER_LEN) {
+        bin[3] |= MQTT_BIN_HDR_TIME_ESTIMATED;
+    }
+}
+
+size_t mqtt_encode_ping_binary(const char *device_id, uint64_t timestamp_ms, uint8_t *out, size_t cap)
+{
+    size_t id_len = device_id ? strnlen(device_id, DEVICE_ID_MAX_LEN) : 0;
+    if (!out || cap < MQTT_BIN_HEADER_LEN + id_len) {
+        return 0;
+    }
+    uint8_t *p = put_bin_header(out, MQTT_BIN_KIND_PING, 0, timestamp_ms);
+    memcpy(p, device_id, id_len);
+    return MQTT_BIN_HEADER_LEN + id_len;
+}
+
 void mqtt_publish_ping(esp_mqtt_client_handle_t client, const char *device_id)
 {
     if (!client || !device_id || !device_id[0]) {
@@ -159,42 +905,98 @@ void mqtt_publish_ping(esp_mqtt_client_handle_t client, const char *device_id)
     }
 
     log_stack_metrics("mqtt_publish_ping:entry");
-    const size_t local_bytes = sizeof(cJSON *) + sizeof(char *) + sizeof(int);
-    ESP_LOGD(TAG, "mqtt_publish_ping locals estimate: %u bytes", (unsigned)local_bytes);
 
-    cJSON *root = cJSON_CreateObject();
-    if (!root) {
+    if (device_identity_payload_encoding() == PAYLOAD_ENCODING_BINARY) {
+        uint8_t bin[MQTT_BIN_HEADER_LEN + DEVICE_ID_MAX_LEN];
+        bool estimated = false;
+        uint64_t timestamp_ms = time_sync_refine_epoch_ms(current_epoch_ms(), &estimated);
+        size_t len = mqtt_encode_ping_binary(device_id, timestamp_ms, bin, sizeof(bin));
+        mark_binary_estimated(bin, len, estimated);
+        if (publish_message(client, MQTT_PING_TOPIC MQTT_BIN_TOPIC_SUFFIX, TOPIC_ALIAS_PING_BIN, (const char *)bin, (int)len, 0, false, NULL) < 0) {
+            ESP_LOGW(TAG, "Failed to publish binary ping");
+        }
         return;
     }
 
-    cJSON_AddStringToObject(root, "from", device_id);
-    log_stack_metrics("mqtt_publish_ping:before current_epoch_ms");
-    uint64_t timestamp_ms = current_epoch_ms();
-    log_stack_metrics("mqtt_publish_ping:after current_epoch_ms");
-    cJSON_AddNumberToObject(root, "timestampMs", (double)timestamp_ms);
-
-    log_stack_metrics("mqtt_publish_ping:before cJSON_PrintUnformatted");
-    char *payload = cJSON_PrintUnformatted(root);
-    log_stack_metrics("mqtt_publish_ping:after cJSON_PrintUnformatted");
-    cJSON_Delete(root);
-    if (!payload) {
+    char payload[PING_PAYLOAD_MAX];
+    json_writer_t w;
+    json_writer_init(&w, payload, sizeof(payload));
+    json_writer_begin_object(&w);
+    json_writer_string(&w, "from", device_id);
+    bool estimated = false;
+    uint64_t timestamp_ms = time_sync_refine_epoch_ms(current_epoch_ms(), &estimated);
+    json_writer_number(&w, "timestampMs", (double)timestamp_ms);
+    if (estimated) {
+        json_writer_bool(&w, "timeEstimated", true);
+    }
+    json_writer_end_object(&w);
+    if (!json_writer_finish(&w)) {
+        ESP_LOGW(TAG, "Ping payload exceeds %u bytes", (unsigned)sizeof(payload));
         return;
     }
 
-    ESP_LOGD(TAG, "mqtt_publish_ping payload length: %u", (unsigned)strlen(payload));
+    ESP_LOGD(TAG, "mqtt_publish_ping payload length: %u", (unsigned)w.len);
 
     log_stack_metrics("mqtt_publish_ping:before esp_mqtt_client_publish");
-    int msg_id = esp_mqtt_client_publish(client, MQTT_PING_TOPIC, payload, 0, 0, false);
+    int msg_id = publish_message(client, MQTT_PING_TOPIC, TOPIC_ALIAS_PING, payload, (int)w.len, 0, false, NULL);
     log_stack_metrics("mqtt_publish_ping:after esp_mqtt_client_publish");
     if (msg_id >= 0) {
         ESP_LOGI(TAG, "Published ping: %s", payload);
     } else {
         ESP_LOGW(TAG, "Failed to publish ping message");
     }
-    cJSON_free(payload);
     log_stack_metrics("mqtt_publish_ping:exit");
 }
 
+// The retained schedule_state last published on any connection since boot
+static node_schedule_t published_schedule;
+static bool schedule_published = false;
+
+static bool schedule_equal(const node_schedule_t *a, const node_schedule_t *b)
+{
+    if (a->timezone_offset_minutes != b->timezone_offset_minutes || a->updated_at_ms != b->updated_at_ms) {
+        return false;
+    }
+    for (int t = 0; t < NODE_SCHEDULE_TARGET_COUNT; ++t) {
+        const node_schedule_timer_t *x = &a->timers[t];
+        const node_schedule_timer_t *y = &b->timers[t];
+        if (x->enabled != y->enabled || x->window_count != y->window_count) {
+            return false;
+        }
+        for (uint8_t w = 0; w < x->window_count && w < NODE_SCHEDULE_MAX_WINDOWS; ++w) {
+            if (x->windows[w].start_minute != y->windows[w].start_minute ||
+                x->windows[w].end_minute != y->windows[w].end_minute) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static void announce_connection(esp_mqtt_client_handle_t client, bool session_present)
+{
+    if (!device_id_buffer[0]) {
+        return;
+    }
+#if CONFIG_PROJECTPLANT_MQTT_V5
+    // Another task may be between setting publish properties and its
+    // publish; the ping comes round again and schedule_state is retained
+    if (xSemaphoreTakeRecursive(publish_lock, 0) != pdTRUE) {
+        ESP_LOGD(TAG, "Publisher busy; skipped connect ping and schedule_state");
+        return;
+    }
+#endif
+    mqtt_publish_ping(client, device_id_buffer);
+    node_schedule_t schedule;
+    node_schedule_get(&schedule);
+    if (!session_present || !schedule_published || !schedule_equal(&schedule, &published_schedule)) {
+        mqtt_publish_schedule_state(client, device_id_buffer, NULL);
+    }
+#if CONFIG_PROJECTPLANT_MQTT_V5
+    xSemaphoreGiveRecursive(publish_lock);
+#endif
+}
+
 static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_t event_id, void *event_data)
 {
     esp_mqtt_event_handle_t event = event_data;
@@ -202,20 +1004,63 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
 
     switch (event_id) {
     case MQTT_EVENT_CONNECTED:
-        ESP_LOGI(TAG, "Connected to broker");
-        esp_mqtt_client_subscribe(client, command_topic, 1);
-        esp_mqtt_client_subscribe(client, MQTT_PING_TOPIC, 0);
-        if (device_id_buffer[0]) {
-            mqtt_publish_ping(client, device_id_buffer);
-            mqtt_publish_schedule_state(client, device_id_buffer, NULL);
+        ESP_LOGI(TAG, "Connected to broker (session %s)", event->session_present ? "resumed" : "new");
+#if CONFIG_PROJECTPLANT_MQTT_V5
+        connection_serial++;
+#endif
+        // A resumed session still holds the subscriptions
+        if (!event->session_present) {
+            esp_mqtt_client_subscribe(client, command_topic, 1);
+            esp_mqtt_client_subscribe(client, MQTT_PING_TOPIC, 0);
+        }
+#if CONFIG_PROJECTPLANT_RELAY_GATEWAY
+        relay_subscribe_pending(client, event->session_present);
+#endif
+        announce_connection(client, event->session_present);
+        if (link_callback) {
+            link_callback(true);
+        }
+        break;
+    case MQTT_EVENT_DISCONNECTED:
+        ESP_LOGW(TAG, "Disconnected from broker");
+        if (link_callback) {
+            link_callback(false);
+        }
+        break;
+    case MQTT_EVENT_PUBLISHED:
+        if (published_callback) {
+            published_callback(event->msg_id);
+        }
+        break;
+    case MQTT_EVENT_DELETED:
+        ESP_LOGW(TAG, "Message %d expired in the outbox", event->msg_id);
+        if (deleted_callback) {
+            deleted_callback(event->msg_id);
         }
         break;
     case MQTT_EVENT_DATA: {
+#if CONFIG_PROJECTPLANT_RELAY_GATEWAY
+        char relayed_id[DEVICE_ID_MAX_LEN];
+#endif
         if (topic_equals(event->topic, event->topic_len, command_topic)) {
-            mqtt_command_t cmd = mqtt_parse_command(event->data, event->data_len);
+            int64_t received_us = esp_timer_get_time();
+            static mqtt_command_scratch_t scratch;  // MQTT event task only; its stack stays default
+            mqtt_command_t cmd = mqtt_parse_command(event->data, event->data_len, &scratch);
+            cmd.received_us = received_us;
+#if CONFIG_PROJECTPLANT_MQTT_V5
+            if (!cmd.request_id[0] &&
+                copy_correlation_id(event->property, cmd.request_id, sizeof(cmd.request_id))) {
+                remember_correlated_id(cmd.request_id);
+            }
+#endif
             if (command_callback && cmd.type != MQTT_CMD_UNKNOWN) {
                 command_callback(&cmd);
             }
+#if CONFIG_PROJECTPLANT_RELAY_GATEWAY
+        } else if (relay_callback && relay_topic_device(event->topic, event->topic_len,
+                                                        relayed_id, sizeof(relayed_id))) {
+            relay_callback(relayed_id, event->data, event->data_len);
+#endif
         } else if (topic_equals(event->topic, event->topic_len, MQTT_PING_TOPIC)) {
             ESP_LOGI(TAG, "Ping topic %.*s payload %.*s",
                      event->topic_len, event->topic,
@@ -230,6 +1075,33 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
     }
 }
 
+void mqtt_set_link_callbacks(mqtt_link_callback_t on_link,
+                             mqtt_published_callback_t on_published,
+                             mqtt_published_callback_t on_deleted)
+{
+    link_callback = on_link;
+    published_callback = on_published;
+    deleted_callback = on_deleted;
+}
+
+#if CONFIG_PROJECTPLANT_MQTT_TLS_SESSION_TICKETS
+// The client keeps this transport across reconnects (and destroys it with
+// the client). With tickets enabled it saves the TLS session when a
+// connection closes and offers it on the next handshake, so a reconnect
+// after a Wi-Fi drop skips the certificate chain and the key exchange.
+static esp_transport_handle_t create_tls_transport(void)
+{
+    esp_transport_handle_t ssl = esp_transport_ssl_init();
+    if (!ssl) {
+        return NULL;
+    }
+    esp_transport_set_default_port(ssl, MQTT_TLS_DEFAULT_PORT);
+    esp_transport_ssl_crt_bundle_attach(ssl, esp_crt_bundle_attach);
+    esp_transport_ssl_session_tickets_enable(ssl);
+    return ssl;
+}
+#endif
+
 esp_mqtt_client_handle_t mqtt_client_start(const char *uri,
                                            const char *device_id,
                                            const char *username,
@@ -255,14 +1127,68 @@ esp_mqtt_client_handle_t mqtt_client_start(const char *uri,
                 .password = password,
             },
         },
+        .session = {
+#if CONFIG_PROJECTPLANT_MQTT_V5
+            .protocol_ver = MQTT_PROTOCOL_V_5,
+#endif
+#if CONFIG_PROJECTPLANT_MQTT_PERSISTENT_SESSION
+            // The client id is the device id, so every connect names the
+            // same session; the broker keeps its subscriptions and queued
+            // QoS 1 commands while the pot is away
+            .disable_clean_session = true,
+#endif
+        },
+        .outbox = {
+            // Unacked QoS 1 messages are held in internal RAM; past the cap
+            // a publish fails and live readings go to the flash ring instead
+            .limit = CONFIG_PROJECTPLANT_MQTT_OUTBOX_LIMIT_BYTES,
+        },
     };
 
+#if CONFIG_PROJECTPLANT_MQTT_V5
+    if (!publish_lock) {
+        publish_lock = xSemaphoreCreateRecursiveMutexStatic(&publish_lock_buf);
+        correlation_lock = xSemaphoreCreateMutexStatic(&correlation_lock_buf);
+    }
+#endif
+#if CONFIG_PROJECTPLANT_RELAY_GATEWAY
+    if (!relay_lock) {
+        relay_lock = xSemaphoreCreateMutexStatic(&relay_lock_buf);
+    }
+#endif
+
+    bool tls = uri && strncmp(uri, "mqtts://", 8) == 0;
+#if CONFIG_PROJECTPLANT_MQTT_TLS_SESSION_TICKETS
+    if (tls) {
+        cfg.network.transport = create_tls_transport();
+        if (!cfg.network.transport) {
+            ESP_LOGW(TAG, "Failed to create TLS transport; reconnects do full handshakes");
+        }
+    }
+#endif
+#if CONFIG_MBEDTLS_CERTIFICATE_BUNDLE
+    if (tls) {
+        cfg.broker.verification.crt_bundle_attach = esp_crt_bundle_attach;
+    }
+#else
+    (void)tls;
+#endif
+
     esp_mqtt_client_handle_t client = esp_mqtt_client_init(&cfg);
     if (!client) {
         ESP_LOGE(TAG, "Failed to init MQTT client");
         return NULL;
     }
 
+#if CONFIG_PROJECTPLANT_MQTT_V5 && CONFIG_PROJECTPLANT_MQTT_PERSISTENT_SESSION
+    esp_mqtt5_connection_property_config_t connect_property = {
+        .session_expiry_interval = CONFIG_PROJECTPLANT_MQTT_SESSION_EXPIRY_S,
+    };
+    if (esp_mqtt5_client_set_connect_property(client, &connect_property) != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to set MQTT 5 session expiry; sessions end with the link");
+    }
+#endif
+
     esp_mqtt_client_register_event(client, ESP_EVENT_ANY_ID, mqtt_event_handler, NULL);
     esp_err_t err = esp_mqtt_client_start(client);
     if (err != ESP_OK) {
@@ -299,30 +1225,42 @@ static void format_hhmm(uint16_t minutes, char *buffer, size_t buffer_len)
     if (!buffer || buffer_len == 0) {
         return;
     }
-    unsigned hour = (unsigned)(minutes / 60U);
+    unsigned hour = (unsigned)(minutes / 60U) % 24U;  // schedule minutes are within one day
     unsigned minute = (unsigned)(minutes % 60U);
     snprintf(buffer, buffer_len, "%02u:%02u", hour, minute);
 }
 
-static void add_schedule_timer(cJSON *schedule_obj, const char *name, const node_schedule_timer_t *timer)
+static void write_schedule_window(json_writer_t *w, const node_schedule_window_t *window)
 {
-    if (!schedule_obj || !name || !timer) {
-        return;
-    }
+    char start_buf[6] = {0};
+    char end_buf[6] = {0};
+    format_hhmm(window->start_minute, start_buf, sizeof(start_buf));
+    format_hhmm(window->end_minute, end_buf, sizeof(end_buf));
+    json_writer_string(w, "startTime", start_buf);
+    json_writer_string(w, "endTime", end_buf);
+}
 
-    cJSON *timer_obj = cJSON_AddObjectToObject(schedule_obj, name);
-    if (!timer_obj) {
+static void write_schedule_timer(json_writer_t *w, const char *name, const node_schedule_timer_t *timer)
+{
+    if (!w || !name || !timer) {
         return;
     }
 
-    cJSON_AddBoolToObject(timer_obj, "enabled", timer->enabled);
-
-    char start_buf[6] = {0};
-    char end_buf[6] = {0};
-    format_hhmm(timer->start_minute, start_buf, sizeof(start_buf));
-    format_hhmm(timer->end_minute, end_buf, sizeof(end_buf));
-    cJSON_AddStringToObject(timer_obj, "startTime", start_buf);
-    cJSON_AddStringToObject(timer_obj, "endTime", end_buf);
+    json_writer_begin_object_key(w, name);
+    json_writer_bool(w, "enabled", timer->enabled);
+
+    // The first window stays in startTime/endTime for single-window readers
+    write_schedule_window(w, &timer->windows[0]);
+    if (timer->window_count > 1) {
+        json_writer_begin_array(w, "windows");
+        for (uint8_t i = 0; i < timer->window_count && i < NODE_SCHEDULE_MAX_WINDOWS; ++i) {
+            json_writer_begin_object(w);
+            write_schedule_window(w, &timer->windows[i]);
+            json_writer_end_object(w);
+        }
+        json_writer_end_array(w);
+    }
+    json_writer_end_object(w);
 }
 
 static bool format_iso8601_timestamp(uint64_t timestamp_ms, char *buffer, size_t buffer_len)
@@ -353,81 +1291,394 @@ static bool format_iso8601_timestamp(uint64_t timestamp_ms, char *buffer, size_t
     return written > 0 && (size_t)written < buffer_len;
 }
 
-static void add_common_fields(cJSON *root, const char *device_id, uint64_t timestamp_ms)
+// Readings taken before time sync carry uptime; report them as "now" once the
+// clock is set. Stamps from the estimated clock get the first sync's step;
+// *estimated (may be NULL) says whether the result is still an estimate.
+static uint64_t effective_timestamp_ms(uint64_t timestamp_ms, bool *estimated)
 {
-    cJSON_AddStringToObject(root, "potId", device_id);
     uint64_t effective_ts = timestamp_ms;
     if (effective_ts == 0) {
         effective_ts = current_epoch_ms();
     } else if (effective_ts < MIN_VALID_TIMESTAMP_MS) {
-        uint64_t now_ms = current_epoch_ms();
-        if (now_ms >= MIN_VALID_TIMESTAMP_MS) {
-            effective_ts = now_ms;
+        // Taken before clock sync: re-stamp from uptime, or failing that
+        // (reading from an earlier boot) with the publish time
+        uint64_t restamped = time_sync_boot_to_epoch_ms(effective_ts);
+        uint64_t stamped = restamped ? restamped : current_epoch_ms();
+        if (stamped >= MIN_VALID_TIMESTAMP_MS) {
+            effective_ts = stamped;
         }
     }
+    if (effective_ts >= MIN_VALID_TIMESTAMP_MS) {
+        return time_sync_refine_epoch_ms(effective_ts, estimated);
+    }
+    if (estimated) {
+        *estimated = false;
+    }
+    return effective_ts;
+}
 
-    cJSON_AddNumberToObject(root, "timestampMs", (double)effective_ts);
+static void write_identity_fields(json_writer_t *w, const char *device_id)
+{
+#if CONFIG_PROJECTPLANT_RELAY_GATEWAY
+    // A relayed leaf's name and mode live on the leaf, not here
+    if (device_id && strcmp(device_id, device_id_buffer) != 0) {
+        json_writer_string(w, "relayedBy", device_id_buffer);
+        return;
+    }
+#else
+    (void)device_id;
+#endif
+    const char *device_name = device_identity_name();
+    if (device_name && device_name[0]) {
+        json_writer_string(w, "deviceName", device_name);
+        json_writer_bool(w, "isNamed", device_identity_is_named());
+    }
+    json_writer_string(w, "sensorMode", device_identity_sensor_mode_label());
+}
+
+static void write_common_fields(json_writer_t *w, const char *device_id, uint64_t timestamp_ms)
+{
+    json_writer_string(w, "potId", device_id);
+    bool estimated = false;
+    uint64_t effective_ts = effective_timestamp_ms(timestamp_ms, &estimated);
+
+    json_writer_number(w, "timestampMs", (double)effective_ts);
     char iso_timestamp[32];
     if (format_iso8601_timestamp(effective_ts, iso_timestamp, sizeof(iso_timestamp))) {
-        cJSON_AddStringToObject(root, "timestamp", iso_timestamp);
+        json_writer_string(w, "timestamp", iso_timestamp);
     }
+    if (estimated) {
+        json_writer_bool(w, "timeEstimated", true);
+    }
+    write_identity_fields(w, device_id);
+}
 
-    const char *device_name = device_identity_name();
-    if (device_name && device_name[0]) {
-        cJSON_AddStringToObject(root, "deviceName", device_name);
-        cJSON_AddBoolToObject(root, "isNamed", device_identity_is_named());
+static unsigned reading_flags(const sensor_reading_t *reading, bool sensors_enabled)
+{
+    unsigned flags = 0;
+    flags |= reading->pump_is_on ? MQTT_BATCH_FLAG_VALVE_OPEN : 0;
+    flags |= reading->ic_zone1_is_on ? MQTT_BATCH_FLAG_IC_ZONE1_ON : 0;
+    flags |= reading->fan_is_on ? MQTT_BATCH_FLAG_FAN_ON : 0;
+    flags |= reading->mister_is_on ? MQTT_BATCH_FLAG_MISTER_ON : 0;
+    flags |= reading->light_is_on ? MQTT_BATCH_FLAG_LIGHT_ON : 0;
+    if (sensors_enabled) {
+        flags |= reading->water_low ? MQTT_BATCH_FLAG_WATER_LOW : 0;
+        flags |= reading->water_cutoff ? MQTT_BATCH_FLAG_WATER_CUTOFF : 0;
     }
-    cJSON_AddStringToObject(root, "sensorMode", device_identity_sensor_mode_label());
+    return flags;
 }
 
-void mqtt_publish_reading(esp_mqtt_client_handle_t client,
-                          const char *device_id,
-                          const sensor_reading_t *reading,
-                          const char *request_id)
+static int16_t centi_or_missing(float value, float lo, float hi)
 {
-    if (!client || !device_id || !reading) {
-        return;
+    if (!is_valid_float(value) || value < lo || value > hi) {
+        return MQTT_BIN_MISSING;
+    }
+    return (int16_t)lroundf(value * 100.0f);
+}
+
+static uint8_t *put_spread_binary(uint8_t *p, const sensor_spread_t *spread)
+{
+    p = put_le16(p, (uint16_t)centi_or_missing(spread->min, -300.0f, 300.0f));
+    p = put_le16(p, (uint16_t)centi_or_missing(spread->max, -300.0f, 300.0f));
+    return put_le16(p, (uint16_t)centi_or_missing(spread->stddev, -300.0f, 300.0f));
+}
+
+size_t mqtt_encode_reading_binary(const sensor_reading_t *reading,
+                                  bool sensors_enabled,
+                                  uint64_t timestamp_ms,
+                                  uint8_t *out,
+                                  size_t cap)
+{
+    bool windowed = reading && reading->window_samples > 1;
+    size_t len = windowed ? MQTT_BIN_READING_WINDOW_LEN : MQTT_BIN_READING_LEN;
+    if (!reading || !out || cap < len) {
+        return 0;
+    }
+    uint8_t flags = (uint8_t)reading_flags(reading, sensors_enabled);
+    if (sensors_enabled) {
+        flags |= MQTT_BIN_FLAG_SENSORS;
+    }
+    uint8_t *p = put_bin_header(out, windowed ? MQTT_BIN_KIND_READING_WINDOW : MQTT_BIN_KIND_READING,
+                                flags, timestamp_ms);
+    p = put_le16(p, sensors_enabled ? reading->soil_raw : 0);
+    p = put_le16(p, (uint16_t)centi_or_missing(reading->soil_percent, -300.0f, 300.0f));
+    p = put_le16(p, (uint16_t)centi_or_missing(reading->temperature_c, -300.0f, 300.0f));
+    p = put_le16(p, (uint16_t)centi_or_missing(reading->humidity_pct, -300.0f, 300.0f));
+    uint16_t battery_mv = 0;
+    if (sensors_enabled && is_valid_float(reading->battery_v) && reading->battery_v > 0.0f && reading->battery_v < 65.0f) {
+        battery_mv = (uint16_t)lroundf(reading->battery_v * 1000.0f);
+    }
+    p = put_le16(p, battery_mv);
+    if (windowed) {
+        p = put_le16(p, reading->window_samples);
+        p = put_spread_binary(p, &reading->soil_spread);
+        p = put_spread_binary(p, &reading->temperature_spread);
+        put_spread_binary(p, &reading->humidity_spread);
     }
+    return len;
+}
 
-    cJSON *root = cJSON_CreateObject();
-    if (!root) {
+static void write_spread(json_writer_t *w, const char *name, const sensor_spread_t *spread)
+{
+    if (!is_valid_float(spread->min)) {
         return;
     }
+    json_writer_begin_object_key(w, name);
+    json_writer_number(w, "min", spread->min);
+    json_writer_number(w, "max", spread->max);
+    json_writer_number(w, "sd", spread->stddev);
+    json_writer_end_object(w);
+}
+
+// Windowed readings: the top-level values are the means
+static void write_window(json_writer_t *w, const sensor_reading_t *reading)
+{
+    json_writer_begin_object_key(w, "window");
+    json_writer_number(w, "n", reading->window_samples);
+    write_spread(w, "moisture", &reading->soil_spread);
+    write_spread(w, "temperature", &reading->temperature_spread);
+    write_spread(w, "humidity", &reading->humidity_spread);
+    json_writer_end_object(w);
+}
+
+static int publish_reading(esp_mqtt_client_handle_t client,
+                           const char *device_id,
+                           const sensor_reading_t *reading,
+                           const char *request_id)
+{
+
+    char topic[96];
+    // Replies to a sensor_read keep JSON so the requestId reaches the hub
+    if (device_identity_payload_encoding() == PAYLOAD_ENCODING_BINARY && !(request_id && request_id[0])) {
+        uint8_t bin[MQTT_BIN_READING_WINDOW_LEN];
+        bool estimated = false;
+        uint64_t timestamp_ms = effective_timestamp_ms(reading->timestamp_ms, &estimated);
+        size_t len = mqtt_encode_reading_binary(reading, device_identity_sensors_enabled(), timestamp_ms, bin, sizeof(bin));
+        mark_binary_estimated(bin, len, estimated);
+        snprintf(topic, sizeof(topic), SENSORS_TOPIC_FMT MQTT_BIN_TOPIC_SUFFIX, device_id);
+        return publish_message(client, topic, TOPIC_ALIAS_NONE, (const char *)bin, (int)len, 1, false, NULL);
+    }
 
-    add_common_fields(root, device_id, reading->timestamp_ms);
+    char payload[READING_PAYLOAD_MAX];
+    json_writer_t w;
+    json_writer_init(&w, payload, sizeof(payload));
+    json_writer_begin_object(&w);
+    write_common_fields(&w, device_id, reading->timestamp_ms);
 
     float moisture = is_valid_float(reading->soil_percent) ? reading->soil_percent : 0.0f;
     float temperature = is_valid_float(reading->temperature_c) ? reading->temperature_c : 0.0f;
-    if (request_id && request_id[0]) {
-        cJSON_AddStringToObject(root, "requestId", request_id);
-    }
+    write_request_id(&w, request_id);
 
-    cJSON_AddNumberToObject(root, "moisture", moisture);
-    cJSON_AddNumberToObject(root, "temperature", temperature);
+    json_writer_number(&w, "moisture", moisture);
+    json_writer_number(&w, "temperature", temperature);
     if (is_valid_float(reading->humidity_pct)) {
-        cJSON_AddNumberToObject(root, "humidity", reading->humidity_pct);
+        json_writer_number(&w, "humidity", reading->humidity_pct);
+    }
+    if (reading->window_samples > 1) {
+        write_window(&w, reading);
     }
-    cJSON_AddBoolToObject(root, "valveOpen", reading->pump_is_on);
-    cJSON_AddBoolToObject(root, "icZone1On", reading->ic_zone1_is_on);
-    cJSON_AddBoolToObject(root, "fanOn", reading->fan_is_on);
-    cJSON_AddBoolToObject(root, "misterOn", reading->mister_is_on);
-    cJSON_AddBoolToObject(root, "lightOn", reading->light_is_on);
+    json_writer_bool(&w, "valveOpen", reading->pump_is_on);
+    json_writer_bool(&w, "icZone1On", reading->ic_zone1_is_on);
+    json_writer_bool(&w, "fanOn", reading->fan_is_on);
+    json_writer_bool(&w, "misterOn", reading->mister_is_on);
+    json_writer_bool(&w, "lightOn", reading->light_is_on);
     if (device_identity_sensors_enabled()) {
-        cJSON_AddBoolToObject(root, "waterLow", reading->water_low);
-        cJSON_AddBoolToObject(root, "waterCutoff", reading->water_cutoff);
-        cJSON_AddNumberToObject(root, "soilRaw", reading->soil_raw);
+        json_writer_bool(&w, "waterLow", reading->water_low);
+        json_writer_bool(&w, "waterCutoff", reading->water_cutoff);
+        json_writer_number(&w, "soilRaw", reading->soil_raw);
+        if (is_valid_float(reading->battery_v)) {
+            json_writer_number(&w, "batteryV", reading->battery_v);
+        }
+    }
+    json_writer_end_object(&w);
+    if (!json_writer_finish(&w)) {
+        ESP_LOGW(TAG, "Reading payload exceeds %u bytes", (unsigned)sizeof(payload));
+        return -1;
+    }
+
+    snprintf(topic, sizeof(topic), SENSORS_TOPIC_FMT, device_id);
+    return publish_message(client, topic, TOPIC_ALIAS_NONE, payload, (int)w.len, 1, false, request_id);
+}
+
+int mqtt_publish_reading(esp_mqtt_client_handle_t client,
+                         const char *device_id,
+                         const sensor_reading_t *reading,
+                         const char *request_id)
+{
+    if (!client || !device_id || !reading) {
+        return -1;
+    }
+    int64_t t0 = latency_hist_start();
+    int msg_id = publish_reading(client, device_id, reading, request_id);
+    latency_hist_record(LATENCY_STAGE_PUBLISH_READING, t0);
+    return msg_id;
+}
+
+// Fixed-point so samples print as short integers rather than float noise
+static void write_centi(json_writer_t *w, float value)
+{
+    if (is_valid_float(value)) {
+        json_writer_number(w, NULL, (double)lroundf(value * 100.0f));
+    } else {
+        json_writer_null(w, NULL);
+    }
+}
+
+int mqtt_publish_reading_batch(esp_mqtt_client_handle_t client,
+                               const char *device_id,
+                               const sensor_reading_t *readings,
+                               size_t count,
+                               const char *request_id)
+{
+    if (!client || !device_id || !readings || count == 0 || count > MQTT_READING_BATCH_MAX) {
+        return -1;
+    }
+
+    char payload[BATCH_PAYLOAD_MAX];
+    json_writer_t w;
+    json_writer_init(&w, payload, sizeof(payload));
+    json_writer_begin_object(&w);
+    json_writer_string(&w, "potId", device_id);
+    write_identity_fields(&w, device_id);
+    write_request_id(&w, request_id);
+    json_writer_number(&w, "v", 1);
+    bool estimated = false;
+    uint64_t t0 = effective_timestamp_ms(readings[0].timestamp_ms, &estimated);
+    json_writer_number(&w, "t0", (double)t0);
+
+    bool sensors_enabled = device_identity_sensors_enabled();
+    json_writer_begin_array(&w, "f");
+    json_writer_string(&w, NULL, "dt");
+    json_writer_string(&w, NULL, "m");
+    json_writer_string(&w, NULL, "t");
+    json_writer_string(&w, NULL, "h");
+    json_writer_string(&w, NULL, "fl");
+    if (sensors_enabled) {
+        json_writer_string(&w, NULL, "r");
+        json_writer_string(&w, NULL, "b");
+    }
+    json_writer_end_array(&w);
+
+    json_writer_begin_array(&w, "s");
+    for (size_t i = 0; i < count; ++i) {
+        const sensor_reading_t *reading = &readings[i];
+        bool reading_estimated = false;
+        int64_t dt_s = ((int64_t)effective_timestamp_ms(reading->timestamp_ms, &reading_estimated) - (int64_t)t0) / 1000;
+        estimated = estimated || reading_estimated;
+        json_writer_begin_array(&w, NULL);
+        json_writer_number(&w, NULL, (double)dt_s);
+        write_centi(&w, reading->soil_percent);
+        write_centi(&w, reading->temperature_c);
+        write_centi(&w, reading->humidity_pct);
+        json_writer_number(&w, NULL, reading_flags(reading, sensors_enabled));
+        if (sensors_enabled) {
+            json_writer_number(&w, NULL, reading->soil_raw);
+            if (is_valid_float(reading->battery_v)) {
+                json_writer_number(&w, NULL, (double)lroundf(reading->battery_v * 1000.0f));
+            } else {
+                json_writer_null(&w, NULL);
+            }
+        }
+        json_writer_end_array(&w);
+    }
+    json_writer_end_array(&w);
+    if (estimated) {
+        json_writer_bool(&w, "timeEstimated", true);
+    }
+    json_writer_end_object(&w);
+    if (!json_writer_finish(&w)) {
+        ESP_LOGW(TAG, "Batch of %u readings exceeds %u bytes", (unsigned)count, (unsigned)sizeof(payload));
+        return -1;
     }
 
-    char *payload = cJSON_PrintUnformatted(root);
-    cJSON_Delete(root);
-    if (!payload) {
+    char topic[96];
+    snprintf(topic, sizeof(topic), SENSORS_BATCH_TOPIC_FMT, device_id);
+    return publish_message(client, topic, TOPIC_ALIAS_NONE, payload, (int)w.len, 1, false, request_id);
+}
+
+static void write_power_fields(json_writer_t *w)
+{
+    power_stats_t stats;
+    power_manager_get_stats(&stats);
+    json_writer_begin_object_key(w, "power");
+    json_writer_string(w, "mode", power_manager_mode_label());
+    json_writer_number(w, "wakeLatencyMs", stats.wake_latency_ms);
+    if (stats.mode == POWER_MODE_DEEP_SLEEP) {
+        json_writer_number(w, "wakes", stats.wake_count);
+    }
+    if (stats.mode != POWER_MODE_ALWAYS_ON && stats.avg_current_ua > 0) {
+        json_writer_number(w, "avgCurrentUa", stats.avg_current_ua);
+        json_writer_number(w, "sleepPct", stats.sleep_pct);
+    }
+    json_writer_end_object(w);
+}
+
+static void write_watering_fields(json_writer_t *w, const watering_result_t *result)
+{
+    json_writer_begin_object_key(w, "watering");
+    json_writer_string(w, "reason", watering_stop_reason_name(result->reason));
+    json_writer_number(w, "deliveredMs", result->delivered_ms);
+    if (PUMP_FLOW_ML_PER_MIN > 0) {
+        json_writer_number(w, "deliveredMl",
+                           (double)((uint64_t)result->delivered_ms * PUMP_FLOW_ML_PER_MIN / 60000));
+    }
+    json_writer_number(w, "targetMoisture", result->target_pct);
+    if (is_valid_float(result->start_pct)) {
+        json_writer_number(w, "startMoisture", result->start_pct);
+        json_writer_number(w, "endMoisture", result->end_pct);
+    }
+    json_writer_end_object(w);
+}
+
+static void write_scene_fields(json_writer_t *w, const actuator_scene_t *scene)
+{
+    json_writer_begin_object_key(w, "scene");
+    for (int t = 0; t < NODE_SCHEDULE_TARGET_COUNT; ++t) {
+        if (scene->mask & (1u << t)) {
+            json_writer_string(w, SCHEDULE_TIMERS[t].name, (scene->on & (1u << t)) ? "on" : "off");
+        }
+    }
+    json_writer_end_object(w);
+}
+
+static void publish_status(esp_mqtt_client_handle_t client,
+                           const char *device_id,
+                           const char *version,
+                           const char *status,
+                           const char *request_id,
+                           const watering_result_t *watering,
+                           const actuator_scene_t *scene)
+{
+
+    char payload[STATUS_PAYLOAD_MAX];
+    json_writer_t w;
+    json_writer_init(&w, payload, sizeof(payload));
+    json_writer_begin_object(&w);
+    write_common_fields(&w, device_id, current_epoch_ms());
+    json_writer_string(&w, "status", status);
+    write_request_id(&w, request_id);
+    if (version) {
+        json_writer_string(&w, "fwVersion", version);
+    }
+    // Lets hub consumers see which sensors topic to subscribe to
+    json_writer_string(&w, "payloadEncoding", device_identity_payload_encoding_label());
+    json_writer_number(&w, "nvsCommitsLastHour", prefs_commits_last_hour());
+    write_power_fields(&w);
+    if (watering) {
+        write_watering_fields(&w, watering);
+    }
+    if (scene) {
+        write_scene_fields(&w, scene);
+    }
+    json_writer_end_object(&w);
+    if (!json_writer_finish(&w)) {
+        ESP_LOGW(TAG, "Status payload exceeds %u bytes", (unsigned)sizeof(payload));
         return;
     }
 
     char topic[96];
-    snprintf(topic, sizeof(topic), SENSORS_TOPIC_FMT, device_id);
-    esp_mqtt_client_publish(client, topic, payload, 0, 1, false);
-    cJSON_free(payload);
+    snprintf(topic, sizeof(topic), STATUS_TOPIC_FMT, device_id);
+    publish_message(client, topic, TOPIC_ALIAS_NONE, payload, (int)w.len, 1, true, request_id);
 }
 
 void mqtt_publish_status(esp_mqtt_client_handle_t client,
@@ -439,31 +1690,147 @@ void mqtt_publish_status(esp_mqtt_client_handle_t client,
     if (!client || !device_id || !status) {
         return;
     }
+    publish_status(client, device_id, version, status, request_id, NULL, NULL);
+}
+
+void mqtt_publish_scene_status(esp_mqtt_client_handle_t client,
+                               const char *device_id,
+                               const char *version,
+                               const char *status,
+                               const actuator_scene_t *applied,
+                               const char *request_id)
+{
+    if (!client || !device_id || !status || !applied) {
+        return;
+    }
+    publish_status(client, device_id, version, status, request_id, NULL, applied);
+}
 
-    cJSON *root = cJSON_CreateObject();
-    if (!root) {
+void mqtt_publish_watering_result(esp_mqtt_client_handle_t client,
+                                  const char *device_id,
+                                  const char *version,
+                                  const watering_result_t *result)
+{
+    if (!client || !device_id || !result) {
         return;
     }
+    const char *request_id = result->request_id[0] ? result->request_id : NULL;
+    publish_status(client, device_id, version, "watering_complete", request_id, result, NULL);
+}
 
-    add_common_fields(root, device_id, current_epoch_ms());
-    cJSON_AddStringToObject(root, "status", status);
-    if (request_id && request_id[0]) {
-        cJSON_AddStringToObject(root, "requestId", request_id);
+#if CONFIG_PROJECTPLANT_LATENCY_HISTOGRAMS
+// "latency":{"bucketsUs":[upper bounds],"<stage>":{"n","meanUs","maxUs","b":[counts]}}
+static void write_latency_fields(json_writer_t *w)
+{
+    latency_hist_t hists[LATENCY_STAGE_COUNT];
+    latency_hist_snapshot(hists);
+
+    json_writer_begin_object_key(w, "latency");
+    json_writer_begin_array(w, "bucketsUs");
+    for (size_t i = 0; i < LATENCY_BUCKET_COUNT - 1; ++i) {
+        json_writer_number(w, NULL, latency_bucket_upper_us[i]);
     }
-    if (version) {
-        cJSON_AddStringToObject(root, "fwVersion", version);
+    json_writer_end_array(w);
+    for (size_t s = 0; s < LATENCY_STAGE_COUNT; ++s) {
+        const latency_hist_t *hist = &hists[s];
+        json_writer_begin_object_key(w, latency_stage_name((latency_stage_t)s));
+        json_writer_number(w, "n", hist->count);
+        if (hist->count > 0) {
+            json_writer_number(w, "meanUs", (double)(hist->total_us / hist->count));
+            json_writer_number(w, "maxUs", hist->max_us);
+        }
+        json_writer_begin_array(w, "b");
+        for (size_t i = 0; i < LATENCY_BUCKET_COUNT; ++i) {
+            json_writer_number(w, NULL, hist->buckets[i]);
+        }
+        json_writer_end_array(w);
+        json_writer_end_object(w);
+    }
+    json_writer_end_object(w);
+}
+#endif
+
+void mqtt_publish_diag(esp_mqtt_client_handle_t client,
+                       const char *device_id,
+                       const runtime_diag_t *diag,
+                       const char *request_id)
+{
+    if (!client || !device_id || !device_id[0] || !diag) {
+        return;
     }
 
-    char *payload = cJSON_PrintUnformatted(root);
-    cJSON_Delete(root);
-    if (!payload) {
+    char payload[DIAG_PAYLOAD_MAX];
+    json_writer_t w;
+    json_writer_init(&w, payload, sizeof(payload));
+    json_writer_begin_object(&w);
+    write_common_fields(&w, device_id, current_epoch_ms());
+    write_request_id(&w, request_id);
+    node_diag_write_system(&w, diag);
+
+    static const char *const lane_names[RUNTIME_DIAG_LANE_COUNT] = {"priority", "normal"};
+    json_writer_begin_object_key(&w, "commandQueue");
+    for (size_t i = 0; i < RUNTIME_DIAG_LANE_COUNT; ++i) {
+        json_writer_begin_object_key(&w, lane_names[i]);
+        json_writer_number(&w, "depth", diag->command_lanes[i].depth);
+        json_writer_number(&w, "len", diag->command_lanes[i].len);
+        json_writer_number(&w, "drops", diag->command_lanes[i].drops);
+        json_writer_number(&w, "coalesced", diag->command_lanes[i].coalesced);
+        json_writer_end_object(&w);
+    }
+    json_writer_end_object(&w);
+    if (diag->mqtt_outbox_bytes >= 0) {
+        json_writer_number(&w, "mqttOutboxBytes", diag->mqtt_outbox_bytes);
+    }
+    node_diag_write_tasks(&w, diag);
+#if CONFIG_PROJECTPLANT_LATENCY_HISTOGRAMS
+    write_latency_fields(&w);
+#endif
+    json_writer_end_object(&w);
+    if (!json_writer_finish(&w)) {
+        ESP_LOGW(TAG, "Diag payload exceeds %u bytes", (unsigned)sizeof(payload));
         return;
     }
 
     char topic[96];
-    snprintf(topic, sizeof(topic), STATUS_TOPIC_FMT, device_id);
-    esp_mqtt_client_publish(client, topic, payload, 0, 1, true);
-    cJSON_free(payload);
+    snprintf(topic, sizeof(topic), DIAG_TOPIC_FMT, device_id);
+    publish_message(client, topic, TOPIC_ALIAS_DIAG, payload, (int)w.len, 0, false, request_id);
+}
+
+int mqtt_publish_log_block(esp_mqtt_client_handle_t client,
+                           const char *device_id,
+                           uint32_t seq,
+                           uint16_t raw_len,
+                           bool last,
+                           uint8_t *buf,
+                           size_t data_len,
+                           const char *request_id)
+{
+    if (!client || !device_id || !device_id[0] || !buf) {
+        return -1;
+    }
+    size_t id_len = request_id ? strnlen(request_id, MQTT_REQUEST_ID_MAX_LEN - 1) : 0;
+#if CONFIG_PROJECTPLANT_MQTT_V5
+    if (is_correlated_id(request_id)) {
+        id_len = 0;
+    }
+#endif
+    size_t header_len = MQTT_BIN_HEADER_LEN + 7 + id_len;
+    uint8_t *start = buf + MQTT_BIN_LOG_HEADROOM - header_len;
+    bool estimated = false;
+    uint64_t timestamp_ms = time_sync_refine_epoch_ms(current_epoch_ms(), &estimated);
+    uint8_t *p = put_bin_header(start, MQTT_BIN_KIND_LOG_BLOCK, last ? MQTT_BIN_LOG_LAST : 0, timestamp_ms);
+    mark_binary_estimated(start, MQTT_BIN_HEADER_LEN, estimated);
+    p = put_le32(p, seq);
+    p = put_le16(p, raw_len);
+    *p++ = (uint8_t)id_len;
+    if (id_len) {
+        memcpy(p, request_id, id_len);
+    }
+
+    char topic[96];
+    snprintf(topic, sizeof(topic), LOGS_TOPIC_FMT MQTT_BIN_TOPIC_SUFFIX, device_id);
+    return publish_message(client, topic, TOPIC_ALIAS_NONE, (const char *)start, (int)(header_len + data_len), 1,
+                           false, request_id);
 }
 
 void mqtt_publish_schedule_state(esp_mqtt_client_handle_t client,
@@ -474,45 +1841,42 @@ void mqtt_publish_schedule_state(esp_mqtt_client_handle_t client,
         return;
     }
 
-    cJSON *root = cJSON_CreateObject();
-    if (!root) {
-        return;
-    }
-
-    add_common_fields(root, device_id, current_epoch_ms());
-    cJSON_AddStringToObject(root, "status", "schedule_state");
+    char payload[SCHEDULE_PAYLOAD_MAX];
+    json_writer_t w;
+    json_writer_init(&w, payload, sizeof(payload));
+    json_writer_begin_object(&w);
+    write_common_fields(&w, device_id, current_epoch_ms());
+    json_writer_string(&w, "status", "schedule_state");
     if (version) {
-        cJSON_AddStringToObject(root, "fwVersion", version);
+        json_writer_string(&w, "fwVersion", version);
     }
 
     node_schedule_t schedule;
     node_schedule_get(&schedule);
     if (schedule.updated_at_ms > 0) {
-        cJSON_AddNumberToObject(root, "scheduleUpdatedAtMs", (double)schedule.updated_at_ms);
+        json_writer_number(&w, "scheduleUpdatedAtMs", (double)schedule.updated_at_ms);
     }
 
-    cJSON *schedule_obj = cJSON_AddObjectToObject(root, "schedule");
-    if (schedule_obj) {
-        add_schedule_timer(schedule_obj, "light", &schedule.light);
-        add_schedule_timer(schedule_obj, "pump", &schedule.pump);
-        add_schedule_timer(schedule_obj, "icZone1", &schedule.ic_zone1);
-        add_schedule_timer(schedule_obj, "mister", &schedule.mister);
-        add_schedule_timer(schedule_obj, "fan", &schedule.fan);
+    json_writer_begin_object_key(&w, "schedule");
+    for (int t = 0; t < NODE_SCHEDULE_TARGET_COUNT; ++t) {
+        write_schedule_timer(&w, SCHEDULE_TIMERS[t].name, &schedule.timers[t]);
     }
-
-    char *payload = cJSON_PrintUnformatted(root);
-    cJSON_Delete(root);
-    if (!payload) {
+    json_writer_end_object(&w);
+    json_writer_end_object(&w);
+    if (!json_writer_finish(&w)) {
+        ESP_LOGW(TAG, "Schedule payload exceeds %u bytes", (unsigned)sizeof(payload));
         return;
     }
 
     char topic[96];
     snprintf(topic, sizeof(topic), STATUS_TOPIC_FMT, device_id);
-    esp_mqtt_client_publish(client, topic, payload, 0, 1, true);
-    cJSON_free(payload);
+    if (publish_message(client, topic, TOPIC_ALIAS_NONE, payload, (int)w.len, 1, true, NULL) >= 0) {
+        published_schedule = schedule;
+        schedule_published = true;
+    }
 }
 
-mqtt_command_t mqtt_parse_command(const char *payload, int payload_len)
+mqtt_command_t mqtt_parse_command(const char *payload, int payload_len, mqtt_command_scratch_t *scratch)
 {
     mqtt_command_t cmd = {
         .type = MQTT_CMD_UNKNOWN,
@@ -520,211 +1884,209 @@ mqtt_command_t mqtt_parse_command(const char *payload, int payload_len)
         .device_name = "",
         .has_sensor_mode = false,
         .has_schedule = false,
+        .has_payload_encoding = false,
         .sensor_mode = SENSOR_MODE_FULL,
+        .payload_encoding = PAYLOAD_ENCODING_JSON,
         .pump_on = false,
         .ic_zone1_on = false,
         .fan_on = false,
         .mister_on = false,
         .light_on = false,
         .duration_ms = 0,
+        .water_target_pct = 0,
+        .water_max_ml = 0,
+        .history_from_ms = 0,
+        .history_to_ms = UINT64_MAX,
+        .report_policy_mask = 0,
+        .has_soil_calibration = false,
+        .has_interval_bounds = false,
+        .received_us = 0,
     };
     node_schedule_defaults(&cmd.schedule);
 
-    if (!payload || payload_len <= 0) {
+    if (!payload || payload_len <= 0 || !scratch) {
         return cmd;
     }
 
-    char *buffer = calloc((size_t)payload_len + 1, sizeof(char));
-    if (!buffer) {
+    // Tokenize in place on the caller's buffer; a fixed token budget bounds the
+    // work and memory an oversized or hostile payload can cost.
+    json_tok_t *toks = scratch->toks;
+    int count = json_reader_parse(payload, (size_t)payload_len, toks, MQTT_COMMAND_MAX_TOKENS);
+    if (count == JSON_READER_ERR_NOMEM) {
+        ESP_LOGW(TAG, "Command JSON exceeds %d tokens, ignoring", MQTT_COMMAND_MAX_TOKENS);
         return cmd;
     }
-
-    memcpy(buffer, payload, (size_t)payload_len);
-    buffer[payload_len] = '\0';
-
-    cJSON *root = cJSON_Parse(buffer);
-    free(buffer);
-    if (!root) {
+    if (count <= 0) {
         ESP_LOGW(TAG, "Failed to parse command JSON");
         return cmd;
     }
 
-    cJSON *request_id = cJSON_GetObjectItemCaseSensitive(root, "requestId");
-    if (cJSON_IsString(request_id) && request_id->valuestring) {
-        size_t id_len = strlen(request_id->valuestring);
-        if (id_len < sizeof(cmd.request_id)) {
-            memcpy(cmd.request_id, request_id->valuestring, id_len + 1);
-        } else {
-            ESP_LOGW(TAG, "requestId too long (%u), ignoring", (unsigned)id_len);
+    const command_doc_t doc = {
+        .js = payload,
+        .toks = toks,
+        .count = count,
+    };
+    int keys[ROOT_KEY_COUNT];
+    doc_index_members(&doc, 0, ROOT_KEYS, ROOT_KEY_COUNT, keys);
+
+    if (doc_is(&doc, keys[ROOT_KEY_REQUEST_ID], JSON_TOK_STRING)) {
+        const json_tok_t *tok = doc_tok(&doc, keys[ROOT_KEY_REQUEST_ID]);
+        if (json_reader_string_copy(payload, tok, cmd.request_id, sizeof(cmd.request_id)) < 0) {
+            ESP_LOGW(TAG, "requestId too long (%u), ignoring", (unsigned)(tok->end - tok->start));
             cmd.request_id[0] = '\0';
         }
     }
 
-    cJSON *device_name = cJSON_GetObjectItemCaseSensitive(root, "deviceName");
-    if (!device_name) {
-        device_name = cJSON_GetObjectItemCaseSensitive(root, "displayName");
+    int device_name = keys[ROOT_KEY_DEVICE_NAME];
+    if (device_name < 0) {
+        device_name = keys[ROOT_KEY_DISPLAY_NAME];
     }
-    if (cJSON_IsString(device_name) && device_name->valuestring) {
-        size_t name_len = strlen(device_name->valuestring);
-        if (name_len > 0 && name_len < sizeof(cmd.device_name)) {
-            memcpy(cmd.device_name, device_name->valuestring, name_len + 1);
+    if (doc_is(&doc, device_name, JSON_TOK_STRING)) {
+        const json_tok_t *tok = doc_tok(&doc, device_name);
+        int name_len = json_reader_string_copy(payload, tok, cmd.device_name, sizeof(cmd.device_name));
+        if (name_len > 0) {
             cmd.type = MQTT_CMD_CONFIG_UPDATE;
         } else {
-            ESP_LOGW(TAG, "deviceName too long (%u), ignoring", (unsigned)name_len);
+            ESP_LOGW(TAG, "deviceName too long (%u), ignoring", (unsigned)(tok->end - tok->start));
             cmd.device_name[0] = '\0';
         }
     }
 
-    cJSON *sensor_mode = cJSON_GetObjectItemCaseSensitive(root, "sensorMode");
-    if (cJSON_IsString(sensor_mode) && sensor_mode->valuestring) {
-        if (strcasecmp(sensor_mode->valuestring, "control_only") == 0 ||
-            strcasecmp(sensor_mode->valuestring, "control-only") == 0 ||
-            strcasecmp(sensor_mode->valuestring, "control") == 0) {
+    if (doc_is(&doc, keys[ROOT_KEY_SENSOR_MODE], JSON_TOK_STRING)) {
+        const json_tok_t *tok = doc_tok(&doc, keys[ROOT_KEY_SENSOR_MODE]);
+        char mode[24];
+        if (json_reader_string_copy(payload, tok, mode, sizeof(mode)) < 0) {
+            mode[0] = '\0';
+        }
+        if (strcasecmp(mode, "control_only") == 0 ||
+            strcasecmp(mode, "control-only") == 0 ||
+            strcasecmp(mode, "control") == 0) {
             cmd.sensor_mode = SENSOR_MODE_CONTROL_ONLY;
             cmd.has_sensor_mode = true;
             cmd.type = MQTT_CMD_CONFIG_UPDATE;
-        } else if (strcasecmp(sensor_mode->valuestring, "full") == 0 ||
-                   strcasecmp(sensor_mode->valuestring, "sensors") == 0 ||
-                   strcasecmp(sensor_mode->valuestring, "enabled") == 0) {
+        } else if (strcasecmp(mode, "full") == 0 ||
+                   strcasecmp(mode, "sensors") == 0 ||
+                   strcasecmp(mode, "enabled") == 0) {
             cmd.sensor_mode = SENSOR_MODE_FULL;
             cmd.has_sensor_mode = true;
             cmd.type = MQTT_CMD_CONFIG_UPDATE;
         } else {
-            ESP_LOGW(TAG, "Unknown sensorMode %s, ignoring", sensor_mode->valuestring);
+            ESP_LOGW(TAG, "Unknown sensorMode %.*s, ignoring", (int)(tok->end - tok->start), &payload[tok->start]);
         }
     }
 
-    cJSON *sensors_enabled = cJSON_GetObjectItemCaseSensitive(root, "sensorsEnabled");
-    if (cJSON_IsBool(sensors_enabled)) {
-        cmd.sensor_mode = cJSON_IsTrue(sensors_enabled) ? SENSOR_MODE_FULL : SENSOR_MODE_CONTROL_ONLY;
+    if (doc_is_bool(&doc, keys[ROOT_KEY_SENSORS_ENABLED])) {
+        bool enabled = doc_is(&doc, keys[ROOT_KEY_SENSORS_ENABLED], JSON_TOK_TRUE);
+        cmd.sensor_mode = enabled ? SENSOR_MODE_FULL : SENSOR_MODE_CONTROL_ONLY;
         cmd.has_sensor_mode = true;
         cmd.type = MQTT_CMD_CONFIG_UPDATE;
     }
 
-    if (parse_schedule_config(root, &cmd.schedule)) {
+    if (doc_is(&doc, keys[ROOT_KEY_PAYLOAD_ENCODING], JSON_TOK_STRING)) {
+        const json_tok_t *tok = doc_tok(&doc, keys[ROOT_KEY_PAYLOAD_ENCODING]);
+        char encoding[16];
+        if (json_reader_string_copy(payload, tok, encoding, sizeof(encoding)) < 0) {
+            encoding[0] = '\0';
+        }
+        if (strcasecmp(encoding, "binary") == 0 || strcasecmp(encoding, "bin") == 0) {
+            cmd.payload_encoding = PAYLOAD_ENCODING_BINARY;
+            cmd.has_payload_encoding = true;
+            cmd.type = MQTT_CMD_CONFIG_UPDATE;
+        } else if (strcasecmp(encoding, "json") == 0) {
+            cmd.payload_encoding = PAYLOAD_ENCODING_JSON;
+            cmd.has_payload_encoding = true;
+            cmd.type = MQTT_CMD_CONFIG_UPDATE;
+        } else {
+            ESP_LOGW(TAG, "Unknown payloadEncoding %.*s, ignoring", (int)(tok->end - tok->start), &payload[tok->start]);
+        }
+    }
+
+    if (parse_schedule_config(&doc, keys, &cmd.schedule)) {
         cmd.has_schedule = true;
         cmd.type = MQTT_CMD_CONFIG_UPDATE;
     }
 
+    cmd.report_policy_mask = parse_report_policy(&doc, keys, &cmd.report_policy);
+    if (cmd.report_policy_mask) {
+        cmd.type = MQTT_CMD_CONFIG_UPDATE;
+    }
+
+    if (parse_soil_calibration(&doc, keys, &cmd.soil_calibration)) {
+        cmd.has_soil_calibration = true;
+        cmd.type = MQTT_CMD_CONFIG_UPDATE;
+    }
+
+    if (parse_interval_bounds(&doc, keys, &cmd.interval_bounds)) {
+        cmd.has_interval_bounds = true;
+        cmd.type = MQTT_CMD_CONFIG_UPDATE;
+    }
+
     if (cmd.type == MQTT_CMD_CONFIG_UPDATE) {
-        cJSON_Delete(root);
         return cmd;
     }
 
-    const char *action_value = NULL;
-    cJSON *action = cJSON_GetObjectItemCaseSensitive(root, "action");
-    if (cJSON_IsString(action) && action->valuestring) {
-        action_value = action->valuestring;
-    } else {
-        cJSON *command = cJSON_GetObjectItemCaseSensitive(root, "command");
-        if (cJSON_IsString(command) && command->valuestring) {
-            action_value = command->valuestring;
-        }
+    int action = keys[ROOT_KEY_ACTION];
+    if (!doc_is(&doc, action, JSON_TOK_STRING)) {
+        action = keys[ROOT_KEY_COMMAND];
     }
-
-    if (action_value &&
-        (strcmp(action_value, "sensor_read") == 0 || strcmp(action_value, "sensorRead") == 0)) {
+    if (json_reader_string_equals(payload, doc_tok(&doc, action), "sensor_read") ||
+        json_reader_string_equals(payload, doc_tok(&doc, action), "sensorRead")) {
         cmd.type = MQTT_CMD_SENSOR_READ;
     }
+    if (json_reader_string_equals(payload, doc_tok(&doc, action), "diag")) {
+        cmd.type = MQTT_CMD_DIAG_READ;
+        return cmd;
+    }
+    if (json_reader_string_equals(payload, doc_tok(&doc, action), "log_read") ||
+        json_reader_string_equals(payload, doc_tok(&doc, action), "logRead")) {
+        cmd.type = MQTT_CMD_LOG_READ;
+        return cmd;
+    }
+    if (json_reader_string_equals(payload, doc_tok(&doc, action), "history_query") ||
+        json_reader_string_equals(payload, doc_tok(&doc, action), "historyQuery")) {
+        // Missing ends leave the window open on that side
+        cmd.type = MQTT_CMD_HISTORY_QUERY;
+        doc_epoch_ms(&doc, keys[ROOT_KEY_FROM_MS], &cmd.history_from_ms);
+        doc_epoch_ms(&doc, keys[ROOT_KEY_TO_MS], &cmd.history_to_ms);
+        return cmd;
+    }
 
-    cJSON *pump = cJSON_GetObjectItemCaseSensitive(root, "pump");
-    if (pump && (cJSON_IsBool(pump) || (cJSON_IsString(pump) && pump->valuestring))) {
-        bool pump_on = false;
-        if (cJSON_IsBool(pump)) {
-            pump_on = cJSON_IsTrue(pump);
-        } else if (strcmp(pump->valuestring, "on") == 0) {
-            pump_on = true;
-        } else if (strcmp(pump->valuestring, "off") == 0) {
-            pump_on = false;
-        }
-        cmd.type = MQTT_CMD_PUMP_OVERRIDE;
-        cmd.pump_on = pump_on;
+    if (parse_scene(&doc, keys, &cmd.scene)) {
+        cmd.type = MQTT_CMD_SCENE;
+        return cmd;
+    }
 
-        cJSON *duration = cJSON_GetObjectItemCaseSensitive(root, "duration_ms");
-        if (cJSON_IsNumber(duration) && duration->valueint > 0) {
-            cmd.duration_ms = (uint32_t)duration->valueint;
+    for (size_t i = 0; i < sizeof(OVERRIDE_KEYS) / sizeof(OVERRIDE_KEYS[0]); ++i) {
+        int value = keys[OVERRIDE_KEYS[i].key];
+        if (value < 0 && OVERRIDE_KEYS[i].alt_key >= 0) {
+            value = keys[OVERRIDE_KEYS[i].alt_key];
         }
-    } else {
-        cJSON *ic_zone1 = cJSON_GetObjectItemCaseSensitive(root, "icZone1");
-        if (!ic_zone1) {
-            ic_zone1 = cJSON_GetObjectItemCaseSensitive(root, "ic_zone1");
-        }
-        if (ic_zone1 && (cJSON_IsBool(ic_zone1) || (cJSON_IsString(ic_zone1) && ic_zone1->valuestring))) {
-            bool zone_on = false;
-            if (cJSON_IsBool(ic_zone1)) {
-                zone_on = cJSON_IsTrue(ic_zone1);
-            } else if (strcmp(ic_zone1->valuestring, "on") == 0) {
-                zone_on = true;
-            } else if (strcmp(ic_zone1->valuestring, "off") == 0) {
-                zone_on = false;
-            }
-            cmd.type = MQTT_CMD_IC_ZONE1_OVERRIDE;
-            cmd.ic_zone1_on = zone_on;
-
-            cJSON *duration = cJSON_GetObjectItemCaseSensitive(root, "duration_ms");
-            if (cJSON_IsNumber(duration) && duration->valueint > 0) {
-                cmd.duration_ms = (uint32_t)duration->valueint;
-            }
-        } else {
-            cJSON *fan = cJSON_GetObjectItemCaseSensitive(root, "fan");
-            if (fan && (cJSON_IsBool(fan) || (cJSON_IsString(fan) && fan->valuestring))) {
-                bool fan_on = false;
-                if (cJSON_IsBool(fan)) {
-                    fan_on = cJSON_IsTrue(fan);
-                } else if (strcmp(fan->valuestring, "on") == 0) {
-                    fan_on = true;
-                } else if (strcmp(fan->valuestring, "off") == 0) {
-                    fan_on = false;
-                }
-                cmd.type = MQTT_CMD_FAN_OVERRIDE;
-                cmd.fan_on = fan_on;
+        bool on = false;
+        if (!doc_switch(&doc, value, &on)) {
+            continue;
+        }
+        cmd.type = OVERRIDE_KEYS[i].type;
+        *(bool *)((char *)&cmd + OVERRIDE_KEYS[i].state_offset) = on;
 
-                cJSON *duration = cJSON_GetObjectItemCaseSensitive(root, "duration_ms");
-                if (cJSON_IsNumber(duration) && duration->valueint > 0) {
-                    cmd.duration_ms = (uint32_t)duration->valueint;
+        int duration = 0;
+        if (doc_int(&doc, keys[ROOT_KEY_DURATION], &duration) && duration > 0) {
+            cmd.duration_ms = (uint32_t)duration;
+        }
+        double target = 0;
+        if (cmd.type == MQTT_CMD_PUMP_OVERRIDE && on &&
+            doc_number(&doc, keys[ROOT_KEY_TARGET_MOISTURE], &target)) {
+            if (target > 0 && target <= 100) {
+                cmd.water_target_pct = (float)target;
+                int volume = 0;
+                if (doc_int(&doc, keys[ROOT_KEY_MAX_VOLUME], &volume) && volume > 0) {
+                    cmd.water_max_ml = (uint32_t)volume;
                 }
             } else {
-                cJSON *mister = cJSON_GetObjectItemCaseSensitive(root, "mister");
-                if (mister && (cJSON_IsBool(mister) || (cJSON_IsString(mister) && mister->valuestring))) {
-                    bool mister_on = false;
-                    if (cJSON_IsBool(mister)) {
-                        mister_on = cJSON_IsTrue(mister);
-                    } else if (strcmp(mister->valuestring, "on") == 0) {
-                        mister_on = true;
-                    } else if (strcmp(mister->valuestring, "off") == 0) {
-                        mister_on = false;
-                    }
-                    cmd.type = MQTT_CMD_MISTER_OVERRIDE;
-                    cmd.mister_on = mister_on;
-
-                    cJSON *duration = cJSON_GetObjectItemCaseSensitive(root, "duration_ms");
-                    if (cJSON_IsNumber(duration) && duration->valueint > 0) {
-                        cmd.duration_ms = (uint32_t)duration->valueint;
-                    }
-                } else {
-                    cJSON *light = cJSON_GetObjectItemCaseSensitive(root, "light");
-                    if (light && (cJSON_IsBool(light) || (cJSON_IsString(light) && light->valuestring))) {
-                        bool light_on = false;
-                        if (cJSON_IsBool(light)) {
-                            light_on = cJSON_IsTrue(light);
-                        } else if (strcmp(light->valuestring, "on") == 0) {
-                            light_on = true;
-                        } else if (strcmp(light->valuestring, "off") == 0) {
-                            light_on = false;
-                        }
-                        cmd.type = MQTT_CMD_LIGHT_OVERRIDE;
-                        cmd.light_on = light_on;
-
-                        cJSON *duration = cJSON_GetObjectItemCaseSensitive(root, "duration_ms");
-                        if (cJSON_IsNumber(duration) && duration->valueint > 0) {
-                            cmd.duration_ms = (uint32_t)duration->valueint;
-                        }
-                    }
-                }
+                ESP_LOGW(TAG, "targetMoisture %.1f out of range, running open-loop", target);
             }
         }
+        break;
     }
 
-    cJSON_Delete(root);
     return cmd;
 }
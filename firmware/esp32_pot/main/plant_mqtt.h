@@ -1,13 +1,21 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 #include "esp_err.h"
 #include <mqtt_client.h>
 
+#include "actuator_timer.h"
 #include "device_identity.h"
+#include "measurement_interval.h"
 #include "node_schedule.h"
+#include "report_policy.h"
+#include "soil_filter.h"
+#include "watering.h"
+#include "json_reader.h"
+#include "runtime_diag.h"
 #include "sensors.h"
 
 typedef enum {
@@ -19,6 +27,10 @@ typedef enum {
     MQTT_CMD_MISTER_OVERRIDE,
     MQTT_CMD_LIGHT_OVERRIDE,
     MQTT_CMD_IC_ZONE1_OVERRIDE,
+    MQTT_CMD_HISTORY_QUERY,
+    MQTT_CMD_DIAG_READ,
+    MQTT_CMD_SCENE,
+    MQTT_CMD_LOG_READ,
 } mqtt_command_type_t;
 
 #define MQTT_REQUEST_ID_MAX_LEN 64
@@ -29,17 +41,55 @@ typedef struct {
     char device_name[DEVICE_NAME_MAX_LEN];
     bool has_sensor_mode;
     bool has_schedule;
+    bool has_payload_encoding;
     sensor_mode_t sensor_mode;
+    payload_encoding_t payload_encoding;
     node_schedule_t schedule;
+    uint8_t report_policy_mask;     // REPORT_POLICY_FIELD_* set by a reportPolicy update
+    report_policy_t report_policy;
+    bool has_soil_calibration;
+    soil_calibration_t soil_calibration;
+    bool has_interval_bounds;
+    measurement_interval_bounds_t interval_bounds;
     bool pump_on;
     bool ic_zone1_on;
     bool fan_on;
     bool mister_on;
     bool light_on;
     uint32_t duration_ms;
+    float water_target_pct;     // pump on only: > 0 runs closed-loop to this soil %
+    uint32_t water_max_ml;      // closed-loop volume cap, 0 = none
+    uint64_t history_from_ms;   // MQTT_CMD_HISTORY_QUERY window, inclusive
+    uint64_t history_to_ms;
+    // MQTT_CMD_SCENE: {"scene":{"fan":"on","mister":{"state":"on","duration_ms":30000}},"duration_ms":60000}
+    // sets every listed output at once; a bare state takes the root
+    // duration_ms. Open-loop only, so targetMoisture does not apply.
+    actuator_scene_t scene;
+    int64_t received_us;        // esp_timer time the message arrived
 } mqtt_command_t;
 
 typedef void (*mqtt_command_callback_t)(const mqtt_command_t *cmd);
+// Broker link up/down, QoS 1 publish completion, and a QoS 1 message the
+// client dropped from its outbox unacknowledged (expired, reported with
+// CONFIG_MQTT_REPORT_DELETED_MESSAGES); all run on the MQTT event task
+typedef void (*mqtt_link_callback_t)(bool connected);
+typedef void (*mqtt_published_callback_t)(int msg_id);
+
+// Register before mqtt_client_start(); any callback may be NULL
+void mqtt_set_link_callbacks(mqtt_link_callback_t on_link,
+                             mqtt_published_callback_t on_published,
+                             mqtt_published_callback_t on_deleted);
+
+// Gateway builds (CONFIG_PROJECTPLANT_RELAY_GATEWAY) relay commands for up
+// to MQTT_RELAY_MAX other pots: once a device id is added, the client holds
+// a subscription to its command topic on every session and hands messages
+// on it to the callback (on the MQTT event task) unparsed. Readings and
+// status published for such an id carry "relayedBy" instead of this node's
+// identity fields.
+#define MQTT_RELAY_MAX 16
+typedef void (*mqtt_relay_command_callback_t)(const char *device_id, const char *payload, int payload_len);
+void mqtt_set_relay_callback(mqtt_relay_command_callback_t cb);
+esp_err_t mqtt_relay_add(esp_mqtt_client_handle_t client, const char *device_id);
 
 esp_mqtt_client_handle_t mqtt_client_start(const char *uri,
                                            const char *device_id,
@@ -47,10 +97,73 @@ esp_mqtt_client_handle_t mqtt_client_start(const char *uri,
                                            const char *password,
                                            mqtt_command_callback_t cb);
 
-void mqtt_publish_reading(esp_mqtt_client_handle_t client,
-                          const char *device_id,
-                          const sensor_reading_t *reading,
-                          const char *request_id);
+// Returns the QoS 1 message id (>= 0) or -1 if nothing was queued
+int mqtt_publish_reading(esp_mqtt_client_handle_t client,
+                         const char *device_id,
+                         const sensor_reading_t *reading,
+                         const char *request_id);
+
+// Several readings in one message on pots/<id>/sensors/batch. The header
+// carries potId, identity and t0 (ms); "f" names the per-sample columns and
+// "s" holds one array per reading: dt (s from t0), moisture/temperature/
+// humidity in hundredths (null when missing), MQTT_BATCH_FLAG_* bits, and
+// with sensors enabled soilRaw and battery (mV). A request_id (history
+// replies) goes into the header as requestId. Returns the QoS 1 message id
+// or -1.
+#define MQTT_READING_BATCH_MAX 16
+
+#define MQTT_BATCH_FLAG_VALVE_OPEN   (1u << 0)
+#define MQTT_BATCH_FLAG_IC_ZONE1_ON  (1u << 1)
+#define MQTT_BATCH_FLAG_FAN_ON       (1u << 2)
+#define MQTT_BATCH_FLAG_MISTER_ON    (1u << 3)
+#define MQTT_BATCH_FLAG_LIGHT_ON     (1u << 4)
+#define MQTT_BATCH_FLAG_WATER_LOW    (1u << 5)
+#define MQTT_BATCH_FLAG_WATER_CUTOFF (1u << 6)
+
+int mqtt_publish_reading_batch(esp_mqtt_client_handle_t client,
+                               const char *device_id,
+                               const sensor_reading_t *readings,
+                               size_t count,
+                               const char *request_id);
+
+// Binary encoding (config "payloadEncoding": "binary"), published on the
+// JSON topic plus MQTT_BIN_TOPIC_SUFFIX. Every payload starts with a 12-byte
+// header: schema version, kind, flags, header flags (MQTT_BIN_HDR_*),
+// timestamp ms (u64); all multi-byte fields are little-endian.
+//   reading (22 bytes): flags = MQTT_BATCH_FLAG_* | MQTT_BIN_FLAG_SENSORS, then
+//     soilRaw u16, moisture/temperature/humidity i16 hundredths
+//     (MQTT_BIN_MISSING when unavailable), battery u16 mV (0 when unavailable)
+//   reading window (42 bytes): a windowed reading (sensor_window.h); the
+//     reading layout with the window means, then samples u16 and min, max,
+//     stddev i16 hundredths each for moisture, temperature and humidity
+//   ping: the device id bytes follow the header
+//   log block (pots/<id>/logs/bin only): flags MQTT_BIN_LOG_LAST on the last
+//     block of a log_read upload, then block seq u32, record bytes u16
+//     before compression, request id length u8 and bytes, and the block's
+//     records (log_ring.h) as raw DEFLATE (RFC 1951)
+// Readings that answer a request keep JSON so the requestId is preserved.
+#define MQTT_BIN_TOPIC_SUFFIX   "/bin"
+#define MQTT_BIN_SCHEMA_VERSION 1
+#define MQTT_BIN_KIND_READING   1
+#define MQTT_BIN_KIND_PING      2
+#define MQTT_BIN_KIND_READING_WINDOW 3
+#define MQTT_BIN_KIND_LOG_BLOCK 4
+#define MQTT_BIN_FLAG_SENSORS   (1u << 7)
+#define MQTT_BIN_LOG_LAST       (1u << 0)
+#define MQTT_BIN_HDR_TIME_ESTIMATED (1u << 0)  // as "timeEstimated" in JSON
+#define MQTT_BIN_MISSING        INT16_MIN
+#define MQTT_BIN_HEADER_LEN     12
+#define MQTT_BIN_READING_LEN    22
+#define MQTT_BIN_READING_WINDOW_LEN 42
+#define MQTT_BIN_LOG_HEADROOM   (MQTT_BIN_HEADER_LEN + 7 + MQTT_REQUEST_ID_MAX_LEN)
+
+// Return the encoded length, or 0 if cap is too small
+size_t mqtt_encode_reading_binary(const sensor_reading_t *reading,
+                                  bool sensors_enabled,
+                                  uint64_t timestamp_ms,
+                                  uint8_t *out,
+                                  size_t cap);
+size_t mqtt_encode_ping_binary(const char *device_id, uint64_t timestamp_ms, uint8_t *out, size_t cap);
 
 void mqtt_publish_status(esp_mqtt_client_handle_t client,
                          const char *device_id,
@@ -58,6 +171,42 @@ void mqtt_publish_status(esp_mqtt_client_handle_t client,
                          const char *status,
                          const char *request_id);
 
+// Closed-loop watering outcome on the status topic: status
+// "watering_complete" with a "watering" object (reason, deliveredMs,
+// deliveredMl when PUMP_FLOW_ML_PER_MIN is set, start/end/target moisture)
+void mqtt_publish_watering_result(esp_mqtt_client_handle_t client,
+                                  const char *device_id,
+                                  const char *version,
+                                  const watering_result_t *result);
+
+// The one reply to a scene command: status (e.g. "scene_applied") with a
+// "scene" object giving the state of each output in applied->mask
+void mqtt_publish_scene_status(esp_mqtt_client_handle_t client,
+                               const char *device_id,
+                               const char *version,
+                               const char *status,
+                               const actuator_scene_t *applied,
+                               const char *request_id);
+
+// Runtime diagnostics on pots/<id>/diag (QoS 0, not retained)
+void mqtt_publish_diag(esp_mqtt_client_handle_t client,
+                       const char *device_id,
+                       const runtime_diag_t *diag,
+                       const char *request_id);
+
+// One block of a log_read upload on pots/<id>/logs/bin (QoS 1, not
+// retained). The compressed records sit at buf + MQTT_BIN_LOG_HEADROOM; the
+// header goes into the headroom right in front of them, so nothing is
+// copied. Returns the message id or -1.
+int mqtt_publish_log_block(esp_mqtt_client_handle_t client,
+                           const char *device_id,
+                           uint32_t seq,
+                           uint16_t raw_len,
+                           bool last,
+                           uint8_t *buf,
+                           size_t data_len,
+                           const char *request_id);
+
 void mqtt_publish_schedule_state(esp_mqtt_client_handle_t client,
                                  const char *device_id,
                                  const char *version);
@@ -65,4 +214,14 @@ void mqtt_publish_schedule_state(esp_mqtt_client_handle_t client,
 void mqtt_publish_ping(esp_mqtt_client_handle_t client,
                        const char *device_id);
 
-mqtt_command_t mqtt_parse_command(const char *payload, int payload_len);
+// Token budget for inbound commands; a full schedule update needs ~60 with
+// one window per timer, ~170 with NODE_SCHEDULE_MAX_WINDOWS on every timer
+#define MQTT_COMMAND_MAX_TOKENS 192
+
+// Tokens for one mqtt_parse_command() call (about 2.3 KB, too much for most
+// task stacks). Each task that parses commands keeps its own, usually static.
+typedef struct {
+    json_tok_t toks[MQTT_COMMAND_MAX_TOKENS];
+} mqtt_command_scratch_t;
+
+mqtt_command_t mqtt_parse_command(const char *payload, int payload_len, mqtt_command_scratch_t *scratch);
@@ -0,0 +1,299 @@
+#include "power_manager.h"
+
+#include <string.h>
+
+#include "driver/gpio.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_pm.h"
+#include "esp_sleep.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+#include "sdkconfig.h"
+
+#include "actuator_state.h"
+#include "actuator_timer.h"
+#include "hardware_config.h"
+#include "preferences.h"
+#include "watering.h"
+
+static const char *TAG = "power";
+
+// Bump when power_rtc_state_t changes so a new image ignores old RTC contents
+#define POWER_RTC_LAYOUT 2
+
+#define POWER_HOLD_LIGHT    (1u << 0)
+#define POWER_HOLD_FAN      (1u << 1)
+#define POWER_HOLD_IC_ZONE1 (1u << 2)   // latching valve: state only, no pad hold
+
+// Survives deep sleep (not power loss or a crash reset; see power_manager_init)
+typedef struct {
+    uint32_t layout;
+    uint32_t wake_count;
+    uint32_t wake_latency_ms;
+    uint64_t awake_ms_total;
+    uint64_t sleep_ms_total;
+    uint8_t outputs;            // POWER_HOLD_* set when the node went to sleep
+    bool schedule_valid;
+    node_schedule_t schedule;
+    uint8_t pending_count;
+    sensor_reading_t pending[POWER_RTC_PENDING_MAX];
+} power_rtc_state_t;
+
+static RTC_DATA_ATTR power_rtc_state_t rtc_state;
+static bool woke_from_deep_sleep = false;
+
+#if CONFIG_PM_LIGHT_SLEEP_CALLBACKS
+// Accumulated in the light sleep exit hook (interrupts off, runs from IRAM)
+static volatile int64_t light_sleep_us_total = 0;
+
+static esp_err_t IRAM_ATTR on_light_sleep_exit(int64_t sleep_time_us, void *arg)
+{
+    (void)arg;
+    light_sleep_us_total += sleep_time_us;
+    return ESP_OK;
+}
+#endif
+
+power_mode_t power_manager_mode(void)
+{
+#if CONFIG_PROJECTPLANT_POWER_DEEP_SLEEP
+    return POWER_MODE_DEEP_SLEEP;
+#elif CONFIG_PROJECTPLANT_POWER_LIGHT_SLEEP
+    return POWER_MODE_LIGHT_SLEEP;
+#else
+    return POWER_MODE_ALWAYS_ON;
+#endif
+}
+
+const char *power_manager_mode_label(void)
+{
+    switch (power_manager_mode()) {
+    case POWER_MODE_LIGHT_SLEEP:
+        return "light_sleep";
+    case POWER_MODE_DEEP_SLEEP:
+        return "deep_sleep";
+    default:
+        return "always_on";
+    }
+}
+
+bool power_manager_woke_from_deep_sleep(void)
+{
+    return woke_from_deep_sleep;
+}
+
+static esp_err_t configure_light_sleep(void)
+{
+#if CONFIG_PM_ENABLE
+    esp_pm_config_t pm_config = {
+        .max_freq_mhz = POWER_PM_MAX_FREQ_MHZ,
+        .min_freq_mhz = POWER_PM_MIN_FREQ_MHZ,
+        .light_sleep_enable = true,
+    };
+    esp_err_t err = esp_pm_configure(&pm_config);
+    if (err != ESP_OK) {
+        return err;
+    }
+#if CONFIG_PM_LIGHT_SLEEP_CALLBACKS
+    esp_pm_sleep_cbs_register_config_t cbs = {
+        .exit_cb = on_light_sleep_exit,
+    };
+    err = esp_pm_light_sleep_register_cbs(&cbs);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Light sleep accounting unavailable: %s", esp_err_to_name(err));
+    }
+#endif
+    return ESP_OK;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+esp_err_t power_manager_init(void)
+{
+    esp_sleep_wakeup_cause_t cause = esp_sleep_get_wakeup_cause();
+    woke_from_deep_sleep = (cause == ESP_SLEEP_WAKEUP_TIMER && rtc_state.layout == POWER_RTC_LAYOUT);
+    if (!woke_from_deep_sleep) {
+        // Power-on, crash or a different image: RTC contents are not ours
+        memset(&rtc_state, 0, sizeof(rtc_state));
+        rtc_state.layout = POWER_RTC_LAYOUT;
+    } else {
+        rtc_state.wake_count++;
+    }
+
+    esp_err_t err = ESP_OK;
+    if (power_manager_mode() == POWER_MODE_LIGHT_SLEEP) {
+        err = configure_light_sleep();
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "Automatic light sleep not enabled: %s", esp_err_to_name(err));
+        }
+    }
+    ESP_LOGI(TAG, "Power mode %s (%s)", power_manager_mode_label(),
+             woke_from_deep_sleep ? "deep sleep wake" : "cold boot");
+    return err;
+}
+
+void power_manager_network_ready(void)
+{
+    if (power_manager_mode() != POWER_MODE_LIGHT_SLEEP) {
+        return;
+    }
+    // Modem sleep between DTIM beacons; required for automatic light sleep
+    esp_err_t err = esp_wifi_set_ps(WIFI_PS_MIN_MODEM);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Wi-Fi power save not enabled: %s", esp_err_to_name(err));
+    }
+}
+
+bool power_manager_retained_schedule(node_schedule_t *out_schedule)
+{
+    if (!out_schedule || !woke_from_deep_sleep || !rtc_state.schedule_valid) {
+        return false;
+    }
+    *out_schedule = rtc_state.schedule;
+    return true;
+}
+
+void power_manager_restore_outputs(void)
+{
+    if (!woke_from_deep_sleep) {
+        return;
+    }
+    // sensors_init_outputs() drove the pads low, but the holds kept them latched;
+    // set the level we want before letting go
+    if (rtc_state.outputs & POWER_HOLD_LIGHT) {
+        sensors_set_light_state(true);
+    }
+    if (rtc_state.outputs & POWER_HOLD_FAN) {
+        sensors_set_fan_state(true);
+    }
+    if (rtc_state.outputs & POWER_HOLD_IC_ZONE1) {
+        sensors_set_ic_zone1_state(true);
+    }
+    gpio_hold_dis(LIGHT_GPIO);
+    gpio_hold_dis(FAN_GPIO);
+    gpio_deep_sleep_hold_dis();
+    rtc_state.outputs = 0;
+}
+
+bool power_manager_retain_reading(const sensor_reading_t *reading)
+{
+    if (!reading || rtc_state.pending_count >= POWER_RTC_PENDING_MAX) {
+        return false;
+    }
+    rtc_state.pending[rtc_state.pending_count++] = *reading;
+    return true;
+}
+
+size_t power_manager_retained_readings(sensor_reading_t *out, size_t cap)
+{
+    size_t count = rtc_state.pending_count < cap ? rtc_state.pending_count : cap;
+    if (out && count > 0) {
+        memcpy(out, rtc_state.pending, count * sizeof(sensor_reading_t));
+    }
+    return out ? count : rtc_state.pending_count;
+}
+
+void power_manager_clear_retained_readings(void)
+{
+    rtc_state.pending_count = 0;
+}
+
+void power_manager_note_wake_latency(uint32_t latency_ms)
+{
+    rtc_state.wake_latency_ms = latency_ms;
+}
+
+void power_manager_get_stats(power_stats_t *out_stats)
+{
+    if (!out_stats) {
+        return;
+    }
+    memset(out_stats, 0, sizeof(*out_stats));
+    out_stats->mode = power_manager_mode();
+    out_stats->wake_count = rtc_state.wake_count;
+    out_stats->wake_latency_ms = rtc_state.wake_latency_ms;
+
+    uint64_t now_ms = (uint64_t)(esp_timer_get_time() / 1000);
+    uint64_t awake_ms = now_ms;
+    uint64_t asleep_ms = 0;
+    uint32_t sleep_current_ua = POWER_DEEP_SLEEP_CURRENT_UA;
+    switch (out_stats->mode) {
+    case POWER_MODE_DEEP_SLEEP:
+        awake_ms = rtc_state.awake_ms_total + now_ms;
+        asleep_ms = rtc_state.sleep_ms_total;
+        break;
+    case POWER_MODE_LIGHT_SLEEP:
+#if CONFIG_PM_LIGHT_SLEEP_CALLBACKS
+        asleep_ms = (uint64_t)(light_sleep_us_total / 1000);
+        awake_ms = now_ms > asleep_ms ? now_ms - asleep_ms : 0;
+        sleep_current_ua = POWER_LIGHT_SLEEP_CURRENT_UA;
+#else
+        // Sleep time is not observable without the esp_pm callbacks
+        return;
+#endif
+        break;
+    default:
+        break;
+    }
+
+    uint64_t total_ms = awake_ms + asleep_ms;
+    if (total_ms == 0) {
+        return;
+    }
+    out_stats->avg_current_ua = (uint32_t)((awake_ms * POWER_ACTIVE_CURRENT_UA +
+                                            asleep_ms * sleep_current_ua) / total_ms);
+    out_stats->sleep_pct = (uint8_t)((asleep_ms * 100U) / total_ms);
+}
+
+bool power_manager_can_deep_sleep(void)
+{
+    actuator_state_t outputs = actuator_state_snapshot();
+    if (actuator_state_is_on(outputs, NODE_SCHEDULE_TARGET_PUMP) ||
+        actuator_state_is_on(outputs, NODE_SCHEDULE_TARGET_MISTER) || watering_active()) {
+        return false;
+    }
+    if (actuator_timer_is_armed(NODE_SCHEDULE_TARGET_PUMP) ||
+        actuator_timer_is_armed(NODE_SCHEDULE_TARGET_FAN) ||
+        actuator_timer_is_armed(NODE_SCHEDULE_TARGET_MISTER) ||
+        actuator_timer_is_armed(NODE_SCHEDULE_TARGET_LIGHT)) {
+        return false;
+    }
+    // Override expiries are kept on the monotonic clock, which restarts at boot
+    return !node_schedule_overrides_active();
+}
+
+void power_manager_deep_sleep(uint32_t sleep_ms)
+{
+    // RAM is lost in deep sleep; commit what the preferences writer holds
+    prefs_flush();
+    node_schedule_get(&rtc_state.schedule);
+    rtc_state.schedule_valid = true;
+
+    // Steady loads stay on through the sleep by latching their pads
+    actuator_state_t outputs = actuator_state_snapshot();
+    rtc_state.outputs = 0;
+    if (actuator_state_is_on(outputs, NODE_SCHEDULE_TARGET_LIGHT)) {
+        rtc_state.outputs |= POWER_HOLD_LIGHT;
+        gpio_hold_en(LIGHT_GPIO);
+    }
+    if (actuator_state_is_on(outputs, NODE_SCHEDULE_TARGET_FAN)) {
+        rtc_state.outputs |= POWER_HOLD_FAN;
+        gpio_hold_en(FAN_GPIO);
+    }
+    if (actuator_state_is_on(outputs, NODE_SCHEDULE_TARGET_IC_ZONE1)) {
+        rtc_state.outputs |= POWER_HOLD_IC_ZONE1;
+    }
+    if (rtc_state.outputs & (POWER_HOLD_LIGHT | POWER_HOLD_FAN)) {
+        gpio_deep_sleep_hold_en();
+    }
+
+    rtc_state.awake_ms_total += (uint64_t)(esp_timer_get_time() / 1000);
+    rtc_state.sleep_ms_total += sleep_ms;
+
+    ESP_LOGI(TAG, "Deep sleep for %u ms (%u readings retained)",
+             (unsigned)sleep_ms, (unsigned)rtc_state.pending_count);
+    esp_sleep_enable_timer_wakeup((uint64_t)sleep_ms * 1000ULL);
+    esp_deep_sleep_start();
+}
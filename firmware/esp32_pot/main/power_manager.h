@@ -0,0 +1,63 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#include "node_schedule.h"
+#include "sensors.h"
+
+// Power modes, chosen with CONFIG_PROJECTPLANT_POWER_*:
+//   always-on    the default; nothing here changes behaviour
+//   light sleep  esp_pm frequency scaling with automatic light sleep in idle
+//                and DTIM-based Wi-Fi modem sleep; the task layout is unchanged
+//   deep sleep   app_main runs one duty cycle per wake (sample, publish, sleep).
+//                Held outputs, the schedule and unsent readings are kept in
+//                RTC memory across the sleep.
+
+typedef enum {
+    POWER_MODE_ALWAYS_ON = 0,
+    POWER_MODE_LIGHT_SLEEP,
+    POWER_MODE_DEEP_SLEEP,
+} power_mode_t;
+
+typedef struct {
+    power_mode_t mode;
+    uint32_t wake_count;        // deep sleep wakes since power-on
+    uint32_t wake_latency_ms;   // deep sleep: wake to broker link; otherwise
+                                // lateness of the last periodic sensor wake
+    uint32_t avg_current_ua;    // estimate from the sleep/awake split; 0 if unknown
+    uint8_t sleep_pct;          // share of time spent asleep
+} power_stats_t;
+
+// Call once, early in app_main. Reads the wake cause, discards RTC state that
+// did not come from our own deep sleep, and configures esp_pm for light sleep.
+esp_err_t power_manager_init(void);
+power_mode_t power_manager_mode(void);
+const char *power_manager_mode_label(void);
+bool power_manager_woke_from_deep_sleep(void);
+
+// Once Wi-Fi is up: enables modem sleep in light sleep mode
+void power_manager_network_ready(void);
+
+// Retained schedule, if this boot is a deep sleep wake
+bool power_manager_retained_schedule(node_schedule_t *out_schedule);
+// After sensors_init_outputs(): restore outputs held through deep sleep and release
+// the pad holds
+void power_manager_restore_outputs(void);
+
+// Readings waiting in RTC memory for a broker connection
+bool power_manager_retain_reading(const sensor_reading_t *reading);
+size_t power_manager_retained_readings(sensor_reading_t *out, size_t cap);
+void power_manager_clear_retained_readings(void);
+
+void power_manager_note_wake_latency(uint32_t latency_ms);
+void power_manager_get_stats(power_stats_t *out_stats);
+
+// False while something needs the CPU awake: a pump or mister run, an armed
+// actuator timer or a manual schedule override
+bool power_manager_can_deep_sleep(void);
+// Snapshot state into RTC memory and sleep; does not return
+void power_manager_deep_sleep(uint32_t sleep_ms);
@@ -2,8 +2,74 @@
 
 #include <string.h>
 
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
 #include "nvs.h"
 
+#include "hardware_config.h"
+#include "latency_hist.h"
+
+#define PREFS_HANDLE_CACHE_SIZE 4
+#define PREFS_KEY_MAX_LEN       16  // NVS limit, including the terminator
+#define PREFS_COMPARE_MAX       128 // longer strings/blobs are written without comparing
+
+#define PREFS_STAGED_SLOTS      8
+#define PREFS_STAGED_VALUE_MAX  64  // display names, the schedule blob, the AP hint
+#define PREFS_WRITE_DELAY_MS    5000
+#define PREFS_WRITER_STACK      3072
+#define PREFS_WRITER_PRIORITY   2
+
+#define PREFS_HOUR_BUCKETS      6
+#define PREFS_BUCKET_US         (10LL * 60 * 1000000)  // 10 minute buckets
+
+static const char *TAG = "prefs";
+
+// Open NVS handles, one per namespace, reused across calls instead of an
+// nvs_open/nvs_close pair per value. Least recently used is closed first.
+typedef struct {
+    char name[PREFS_NAMESPACE_MAX_LEN];
+    nvs_handle_t handle;
+    bool open;
+    bool writable;
+    uint32_t last_used;
+} prefs_handle_slot_t;
+
+static prefs_handle_slot_t handle_cache[PREFS_HANDLE_CACHE_SIZE];
+static uint32_t handle_clock = 0;
+// Recursive so the one-shot helpers below can run on top of a caller's transaction
+static StaticSemaphore_t prefs_lock_storage;
+static SemaphoreHandle_t prefs_lock = NULL;
+
+// Deferred writes waiting for the writer task; guarded by prefs_lock
+typedef enum {
+    STAGED_U8 = 0,
+    STAGED_STR,
+    STAGED_BLOB,
+} prefs_staged_type_t;
+
+typedef struct {
+    bool used;
+    prefs_staged_type_t type;
+    uint8_t len;  // bytes in value; strings include the terminator
+    char name[PREFS_NAMESPACE_MAX_LEN];
+    char key[PREFS_KEY_MAX_LEN];
+    uint8_t value[PREFS_STAGED_VALUE_MAX];
+} prefs_staged_t;
+
+static prefs_staged_t staged[PREFS_STAGED_SLOTS];
+static TaskHandle_t writer_task = NULL;
+static StaticTask_t writer_task_tcb;
+static StackType_t writer_task_stack[PREFS_WRITER_STACK];
+
+// Write accounting; guarded by prefs_lock
+static prefs_write_stats_t write_stats;
+static uint16_t hour_buckets[PREFS_HOUR_BUCKETS];
+static int64_t current_bucket = 0;
+
 static const char *resolve_namespace(const char *nvs_namespace)
 {
     if (nvs_namespace && nvs_namespace[0] != '\0') {
@@ -12,15 +78,6 @@ static const char *resolve_namespace(const char *nvs_namespace)
     return PREFS_DEFAULT_NAMESPACE;
 }
 
-static esp_err_t commit_and_close(nvs_handle_t handle, esp_err_t err)
-{
-    if (err == ESP_OK) {
-        err = nvs_commit(handle);
-    }
-    nvs_close(handle);
-    return err;
-}
-
 static void copy_default_str(char *out_value, size_t out_value_len, const char *default_value)
 {
     if (!out_value || out_value_len == 0) {
@@ -40,139 +97,629 @@ static void copy_default_str(char *out_value, size_t out_value_len, const char *
     out_value[copy_len] = '\0';
 }
 
-esp_err_t prefs_put_u8(const char *nvs_namespace, const char *key, uint8_t value)
+static void prefs_shutdown_handler(void)
 {
-    if (!key) {
+    // esp_restart() path; don't hang the reboot on a held lock
+    if (xSemaphoreTakeRecursive(prefs_lock, pdMS_TO_TICKS(500)) != pdTRUE) {
+        return;
+    }
+    prefs_flush();
+    xSemaphoreGiveRecursive(prefs_lock);
+}
+
+void prefs_init(void)
+{
+    if (!prefs_lock) {
+        prefs_lock = xSemaphoreCreateRecursiveMutexStatic(&prefs_lock_storage);
+        esp_register_shutdown_handler(prefs_shutdown_handler);
+    }
+}
+
+static void roll_hour_buckets(void)
+{
+    int64_t bucket = esp_timer_get_time() / PREFS_BUCKET_US;
+    if (bucket - current_bucket >= PREFS_HOUR_BUCKETS) {
+        memset(hour_buckets, 0, sizeof(hour_buckets));
+        current_bucket = bucket;
+        return;
+    }
+    while (current_bucket < bucket) {
+        ++current_bucket;
+        hour_buckets[current_bucket % PREFS_HOUR_BUCKETS] = 0;
+    }
+}
+
+static prefs_namespace_stats_t *namespace_stats(const char *name)
+{
+    for (size_t i = 0; i < write_stats.namespace_count; ++i) {
+        if (strcmp(write_stats.namespaces[i].name, name) == 0) {
+            return &write_stats.namespaces[i];
+        }
+    }
+    if (write_stats.namespace_count >= PREFS_STATS_NAMESPACES) {
+        return NULL;
+    }
+    prefs_namespace_stats_t *slot = &write_stats.namespaces[write_stats.namespace_count++];
+    memcpy(slot->name, name, strlen(name) + 1);
+    return slot;
+}
+
+static void note_commit(const char *name)
+{
+    roll_hour_buckets();
+    hour_buckets[current_bucket % PREFS_HOUR_BUCKETS]++;
+    write_stats.commits++;
+    prefs_namespace_stats_t *ns = namespace_stats(name);
+    if (ns) {
+        ns->commits++;
+    }
+}
+
+static void note_skipped(const char *name)
+{
+    write_stats.skipped++;
+    prefs_namespace_stats_t *ns = namespace_stats(name);
+    if (ns) {
+        ns->skipped++;
+    }
+}
+
+static prefs_staged_t *staged_find(const char *name, const char *key)
+{
+    for (size_t i = 0; i < PREFS_STAGED_SLOTS; ++i) {
+        prefs_staged_t *slot = &staged[i];
+        if (slot->used && strcmp(slot->name, name) == 0 && strcmp(slot->key, key) == 0) {
+            return slot;
+        }
+    }
+    return NULL;
+}
+
+// Copy a staged value of the given type; false if none is staged. For
+// strings and blobs *in_out_len is the buffer size on entry.
+static bool staged_read(const char *name, const char *key, prefs_staged_type_t type, void *out, size_t *in_out_len, esp_err_t *out_err)
+{
+    const prefs_staged_t *pending = staged_find(name, key);
+    if (!pending || pending->type != type) {
+        return false;
+    }
+    if (pending->len > *in_out_len) {
+        *out_err = ESP_ERR_NVS_INVALID_LENGTH;
+        return true;
+    }
+    memcpy(out, pending->value, pending->len);
+    *in_out_len = pending->len;
+    *out_err = ESP_OK;
+    return true;
+}
+
+// An immediate put or erase supersedes a staged value for the same key
+static void staged_drop(const char *name, const char *key)
+{
+    prefs_staged_t *slot = staged_find(name, key);
+    if (slot) {
+        slot->used = false;
+    }
+}
+
+static esp_err_t acquire_handle_locked(const char *nvs_namespace, bool writable, nvs_handle_t *out_handle)
+{
+    const char *name = resolve_namespace(nvs_namespace);
+    if (strnlen(name, PREFS_NAMESPACE_MAX_LEN) >= PREFS_NAMESPACE_MAX_LEN) {
+        return ESP_ERR_NVS_INVALID_NAME;
+    }
+
+    prefs_handle_slot_t *slot = NULL;
+    prefs_handle_slot_t *victim = &handle_cache[0];
+    for (size_t i = 0; i < PREFS_HANDLE_CACHE_SIZE; ++i) {
+        prefs_handle_slot_t *candidate = &handle_cache[i];
+        if (candidate->open && strcmp(candidate->name, name) == 0) {
+            slot = candidate;
+            break;
+        }
+        if (victim->open && (!candidate->open || candidate->last_used < victim->last_used)) {
+            victim = candidate;
+        }
+    }
+
+    // A read-only handle cannot be upgraded in place; reopen it read-write
+    if (slot && writable && !slot->writable) {
+        nvs_close(slot->handle);
+        slot->open = false;
+    }
+    if (!slot || !slot->open) {
+        if (!slot) {
+            slot = victim;
+        }
+        if (slot->open) {
+            nvs_close(slot->handle);
+            slot->open = false;
+        }
+        esp_err_t err = nvs_open(name, writable ? NVS_READWRITE : NVS_READONLY, &slot->handle);
+        if (err != ESP_OK) {
+            return err;
+        }
+        memcpy(slot->name, name, strlen(name) + 1);
+        slot->open = true;
+        slot->writable = writable;
+    }
+
+    slot->last_used = ++handle_clock;
+    *out_handle = slot->handle;
+    return ESP_OK;
+}
+
+esp_err_t prefs_begin(prefs_txn_t *txn, const char *nvs_namespace, bool writable)
+{
+    if (!txn) {
         return ESP_ERR_INVALID_ARG;
     }
 
-    nvs_handle_t handle;
-    esp_err_t err = nvs_open(resolve_namespace(nvs_namespace), NVS_READWRITE, &handle);
+    memset(txn, 0, sizeof(*txn));
+    prefs_init();
+    xSemaphoreTakeRecursive(prefs_lock, portMAX_DELAY);
+    esp_err_t err = acquire_handle_locked(nvs_namespace, writable, &txn->handle);
     if (err != ESP_OK) {
+        xSemaphoreGiveRecursive(prefs_lock);
         return err;
     }
+    const char *name = resolve_namespace(nvs_namespace);
+    memcpy(txn->name, name, strlen(name) + 1);
+    txn->writable = writable;
+    txn->active = true;
+    txn->err = ESP_OK;
+    return ESP_OK;
+}
 
-    err = nvs_set_u8(handle, key, value);
-    return commit_and_close(handle, err);
+esp_err_t prefs_commit(prefs_txn_t *txn)
+{
+    if (!txn || !txn->active) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    esp_err_t err = txn->err;
+    if (err == ESP_OK && txn->writable && txn->dirty) {
+        int64_t t0 = latency_hist_start();
+        err = nvs_commit(txn->handle);
+        latency_hist_record(LATENCY_STAGE_NVS_COMMIT, t0);
+        if (err == ESP_OK) {
+            note_commit(txn->name);
+        }
+    }
+    txn->active = false;
+    xSemaphoreGiveRecursive(prefs_lock);
+    return err;
 }
 
-esp_err_t prefs_get_u8(const char *nvs_namespace, const char *key, uint8_t *out_value, uint8_t default_value)
+void prefs_end(prefs_txn_t *txn)
 {
-    if (!key || !out_value) {
+    if (!txn || !txn->active) {
+        return;
+    }
+    txn->active = false;
+    xSemaphoreGiveRecursive(prefs_lock);
+}
+
+// Puts are sticky on failure: once one fails the rest are skipped and
+// prefs_commit() reports the first error
+static esp_err_t txn_put_check(prefs_txn_t *txn, const char *key)
+{
+    if (!txn || !txn->active || !txn->writable) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (!key) {
         return ESP_ERR_INVALID_ARG;
     }
+    if (txn->err == ESP_OK) {
+        staged_drop(txn->name, key);
+    }
+    return txn->err;
+}
 
-    nvs_handle_t handle;
-    esp_err_t err = nvs_open(resolve_namespace(nvs_namespace), NVS_READONLY, &handle);
+// Unchanged values are not rewritten (and do not make the commit count)
+static esp_err_t txn_put_skipped(prefs_txn_t *txn)
+{
+    note_skipped(txn->name);
+    return ESP_OK;
+}
+
+static bool stored_str_equals(nvs_handle_t handle, const char *key, const char *value)
+{
+    size_t want = strlen(value) + 1;
+    size_t len = 0;
+    if (want > PREFS_COMPARE_MAX || nvs_get_str(handle, key, NULL, &len) != ESP_OK || len != want) {
+        return false;
+    }
+    char current[PREFS_COMPARE_MAX];
+    return nvs_get_str(handle, key, current, &len) == ESP_OK && memcmp(current, value, want) == 0;
+}
+
+static bool stored_blob_equals(nvs_handle_t handle, const char *key, const void *value, size_t value_len)
+{
+    size_t len = 0;
+    if (value_len > PREFS_COMPARE_MAX || nvs_get_blob(handle, key, NULL, &len) != ESP_OK || len != value_len) {
+        return false;
+    }
+    uint8_t current[PREFS_COMPARE_MAX];
+    return nvs_get_blob(handle, key, current, &len) == ESP_OK && memcmp(current, value, value_len) == 0;
+}
+
+static esp_err_t txn_put_done(prefs_txn_t *txn, esp_err_t err)
+{
+    if (err == ESP_OK) {
+        txn->dirty = true;
+    } else {
+        txn->err = err;
+    }
+    return err;
+}
+
+static bool txn_can_read(const prefs_txn_t *txn)
+{
+    return txn && txn->active;
+}
+
+esp_err_t prefs_txn_put_u8(prefs_txn_t *txn, const char *key, uint8_t value)
+{
+    esp_err_t err = txn_put_check(txn, key);
+    if (err != ESP_OK) {
+        return err;
+    }
+    uint8_t current;
+    if (nvs_get_u8(txn->handle, key, &current) == ESP_OK && current == value) {
+        return txn_put_skipped(txn);
+    }
+    return txn_put_done(txn, nvs_set_u8(txn->handle, key, value));
+}
+
+esp_err_t prefs_txn_put_i32(prefs_txn_t *txn, const char *key, int32_t value)
+{
+    esp_err_t err = txn_put_check(txn, key);
+    if (err != ESP_OK) {
+        return err;
+    }
+    int32_t current;
+    if (nvs_get_i32(txn->handle, key, &current) == ESP_OK && current == value) {
+        return txn_put_skipped(txn);
+    }
+    return txn_put_done(txn, nvs_set_i32(txn->handle, key, value));
+}
+
+esp_err_t prefs_txn_put_u32(prefs_txn_t *txn, const char *key, uint32_t value)
+{
+    esp_err_t err = txn_put_check(txn, key);
+    if (err != ESP_OK) {
+        return err;
+    }
+    uint32_t current;
+    if (nvs_get_u32(txn->handle, key, &current) == ESP_OK && current == value) {
+        return txn_put_skipped(txn);
+    }
+    return txn_put_done(txn, nvs_set_u32(txn->handle, key, value));
+}
+
+esp_err_t prefs_txn_put_u64(prefs_txn_t *txn, const char *key, uint64_t value)
+{
+    esp_err_t err = txn_put_check(txn, key);
+    if (err != ESP_OK) {
+        return err;
+    }
+    uint64_t current;
+    if (nvs_get_u64(txn->handle, key, &current) == ESP_OK && current == value) {
+        return txn_put_skipped(txn);
+    }
+    return txn_put_done(txn, nvs_set_u64(txn->handle, key, value));
+}
+
+esp_err_t prefs_txn_put_bool(prefs_txn_t *txn, const char *key, bool value)
+{
+    return prefs_txn_put_u8(txn, key, value ? 1U : 0U);
+}
+
+esp_err_t prefs_txn_put_str(prefs_txn_t *txn, const char *key, const char *value)
+{
+    esp_err_t err = txn_put_check(txn, key);
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (!value) {
+        return txn_put_done(txn, ESP_ERR_INVALID_ARG);
+    }
+    if (stored_str_equals(txn->handle, key, value)) {
+        return txn_put_skipped(txn);
+    }
+    return txn_put_done(txn, nvs_set_str(txn->handle, key, value));
+}
+
+esp_err_t prefs_txn_put_blob(prefs_txn_t *txn, const char *key, const void *value, size_t value_len)
+{
+    esp_err_t err = txn_put_check(txn, key);
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (!value || value_len == 0) {
+        return txn_put_done(txn, ESP_ERR_INVALID_ARG);
+    }
+    if (stored_blob_equals(txn->handle, key, value, value_len)) {
+        return txn_put_skipped(txn);
+    }
+    return txn_put_done(txn, nvs_set_blob(txn->handle, key, value, value_len));
+}
+
+esp_err_t prefs_txn_erase(prefs_txn_t *txn, const char *key)
+{
+    esp_err_t err = txn_put_check(txn, key);
     if (err != ESP_OK) {
         return err;
     }
+    err = nvs_erase_key(txn->handle, key);
+    if (err == ESP_ERR_NVS_NOT_FOUND) {
+        return ESP_OK;
+    }
+    return txn_put_done(txn, err);
+}
+
+esp_err_t prefs_txn_get_u8(prefs_txn_t *txn, const char *key, uint8_t *out_value, uint8_t default_value)
+{
+    if (!txn_can_read(txn)) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (!key || !out_value) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    size_t staged_len = sizeof(*out_value);
+    esp_err_t staged_err;
+    if (staged_read(txn->name, key, STAGED_U8, out_value, &staged_len, &staged_err)) {
+        return staged_err;
+    }
 
     uint8_t value = default_value;
-    err = nvs_get_u8(handle, key, &value);
+    esp_err_t err = nvs_get_u8(txn->handle, key, &value);
     if (err == ESP_ERR_NVS_NOT_FOUND) {
         err = ESP_OK;
     }
-    nvs_close(handle);
-
     if (err == ESP_OK) {
         *out_value = value;
     }
     return err;
 }
 
-esp_err_t prefs_put_i32(const char *nvs_namespace, const char *key, int32_t value)
+esp_err_t prefs_txn_get_i32(prefs_txn_t *txn, const char *key, int32_t *out_value, int32_t default_value)
 {
-    if (!key) {
+    if (!txn_can_read(txn)) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (!key || !out_value) {
         return ESP_ERR_INVALID_ARG;
     }
 
-    nvs_handle_t handle;
-    esp_err_t err = nvs_open(resolve_namespace(nvs_namespace), NVS_READWRITE, &handle);
-    if (err != ESP_OK) {
-        return err;
+    int32_t value = default_value;
+    esp_err_t err = nvs_get_i32(txn->handle, key, &value);
+    if (err == ESP_ERR_NVS_NOT_FOUND) {
+        err = ESP_OK;
     }
-
-    err = nvs_set_i32(handle, key, value);
-    return commit_and_close(handle, err);
+    if (err == ESP_OK) {
+        *out_value = value;
+    }
+    return err;
 }
 
-esp_err_t prefs_get_i32(const char *nvs_namespace, const char *key, int32_t *out_value, int32_t default_value)
+esp_err_t prefs_txn_get_u32(prefs_txn_t *txn, const char *key, uint32_t *out_value, uint32_t default_value)
 {
+    if (!txn_can_read(txn)) {
+        return ESP_ERR_INVALID_STATE;
+    }
     if (!key || !out_value) {
         return ESP_ERR_INVALID_ARG;
     }
 
-    nvs_handle_t handle;
-    esp_err_t err = nvs_open(resolve_namespace(nvs_namespace), NVS_READONLY, &handle);
-    if (err != ESP_OK) {
-        return err;
+    uint32_t value = default_value;
+    esp_err_t err = nvs_get_u32(txn->handle, key, &value);
+    if (err == ESP_ERR_NVS_NOT_FOUND) {
+        err = ESP_OK;
     }
+    if (err == ESP_OK) {
+        *out_value = value;
+    }
+    return err;
+}
 
-    int32_t value = default_value;
-    err = nvs_get_i32(handle, key, &value);
+esp_err_t prefs_txn_get_u64(prefs_txn_t *txn, const char *key, uint64_t *out_value, uint64_t default_value)
+{
+    if (!txn_can_read(txn)) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (!key || !out_value) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    uint64_t value = default_value;
+    esp_err_t err = nvs_get_u64(txn->handle, key, &value);
     if (err == ESP_ERR_NVS_NOT_FOUND) {
         err = ESP_OK;
     }
-    nvs_close(handle);
+    *out_value = value;
+    return err;
+}
+
+esp_err_t prefs_txn_get_bool(prefs_txn_t *txn, const char *key, bool *out_value, bool default_value)
+{
+    if (!out_value) {
+        return ESP_ERR_INVALID_ARG;
+    }
 
+    uint8_t raw = default_value ? 1U : 0U;
+    esp_err_t err = prefs_txn_get_u8(txn, key, &raw, raw);
     if (err == ESP_OK) {
-        *out_value = value;
+        *out_value = raw != 0;
     }
     return err;
 }
 
-esp_err_t prefs_put_u32(const char *nvs_namespace, const char *key, uint32_t value)
+esp_err_t prefs_txn_get_str(
+    prefs_txn_t *txn,
+    const char *key,
+    char *out_value,
+    size_t out_value_len,
+    const char *default_value)
+{
+    if (!txn_can_read(txn)) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (!key || !out_value || out_value_len == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    size_t staged_len = out_value_len;
+    esp_err_t staged_err;
+    if (staged_read(txn->name, key, STAGED_STR, out_value, &staged_len, &staged_err)) {
+        return staged_err;
+    }
+
+    size_t value_len = out_value_len;
+    esp_err_t err = nvs_get_str(txn->handle, key, out_value, &value_len);
+    if (err == ESP_ERR_NVS_NOT_FOUND) {
+        copy_default_str(out_value, out_value_len, default_value);
+        err = ESP_OK;
+    }
+    return err;
+}
+
+esp_err_t prefs_txn_get_blob(prefs_txn_t *txn, const char *key, void *out_value, size_t *in_out_value_len)
+{
+    if (!txn_can_read(txn)) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (!key || !out_value || !in_out_value_len || *in_out_value_len == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_err_t staged_err;
+    if (staged_read(txn->name, key, STAGED_BLOB, out_value, in_out_value_len, &staged_err)) {
+        return staged_err;
+    }
+    return nvs_get_blob(txn->handle, key, out_value, in_out_value_len);
+}
+
+// One-shot reads look at staged values before opening the namespace, which
+// may not exist in flash yet
+static bool read_staged_value(const char *nvs_namespace, const char *key, prefs_staged_type_t type, void *out, size_t *in_out_len, esp_err_t *out_err)
+{
+    prefs_init();
+    xSemaphoreTakeRecursive(prefs_lock, portMAX_DELAY);
+    bool found = staged_read(resolve_namespace(nvs_namespace), key, type, out, in_out_len, out_err);
+    xSemaphoreGiveRecursive(prefs_lock);
+    return found;
+}
+
+esp_err_t prefs_put_u8(const char *nvs_namespace, const char *key, uint8_t value)
 {
     if (!key) {
         return ESP_ERR_INVALID_ARG;
     }
 
-    nvs_handle_t handle;
-    esp_err_t err = nvs_open(resolve_namespace(nvs_namespace), NVS_READWRITE, &handle);
+    prefs_txn_t txn;
+    esp_err_t err = prefs_begin(&txn, nvs_namespace, true);
     if (err != ESP_OK) {
         return err;
     }
+    prefs_txn_put_u8(&txn, key, value);
+    return prefs_commit(&txn);
+}
 
-    err = nvs_set_u32(handle, key, value);
-    return commit_and_close(handle, err);
+esp_err_t prefs_get_u8(const char *nvs_namespace, const char *key, uint8_t *out_value, uint8_t default_value)
+{
+    if (!key || !out_value) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    size_t staged_len = sizeof(*out_value);
+    esp_err_t err;
+    if (read_staged_value(nvs_namespace, key, STAGED_U8, out_value, &staged_len, &err)) {
+        return err;
+    }
+
+    prefs_txn_t txn;
+    err = prefs_begin(&txn, nvs_namespace, false);
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = prefs_txn_get_u8(&txn, key, out_value, default_value);
+    prefs_end(&txn);
+    return err;
 }
 
-esp_err_t prefs_get_u32(const char *nvs_namespace, const char *key, uint32_t *out_value, uint32_t default_value)
+esp_err_t prefs_put_i32(const char *nvs_namespace, const char *key, int32_t value)
+{
+    if (!key) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    prefs_txn_t txn;
+    esp_err_t err = prefs_begin(&txn, nvs_namespace, true);
+    if (err != ESP_OK) {
+        return err;
+    }
+    prefs_txn_put_i32(&txn, key, value);
+    return prefs_commit(&txn);
+}
+
+esp_err_t prefs_get_i32(const char *nvs_namespace, const char *key, int32_t *out_value, int32_t default_value)
 {
     if (!key || !out_value) {
         return ESP_ERR_INVALID_ARG;
     }
 
-    nvs_handle_t handle;
-    esp_err_t err = nvs_open(resolve_namespace(nvs_namespace), NVS_READONLY, &handle);
+    prefs_txn_t txn;
+    esp_err_t err = prefs_begin(&txn, nvs_namespace, false);
     if (err != ESP_OK) {
         return err;
     }
+    err = prefs_txn_get_i32(&txn, key, out_value, default_value);
+    prefs_end(&txn);
+    return err;
+}
 
-    uint32_t value = default_value;
-    err = nvs_get_u32(handle, key, &value);
-    if (err == ESP_ERR_NVS_NOT_FOUND) {
-        err = ESP_OK;
+esp_err_t prefs_put_u32(const char *nvs_namespace, const char *key, uint32_t value)
+{
+    if (!key) {
+        return ESP_ERR_INVALID_ARG;
     }
-    nvs_close(handle);
 
-    if (err == ESP_OK) {
-        *out_value = value;
+    prefs_txn_t txn;
+    esp_err_t err = prefs_begin(&txn, nvs_namespace, true);
+    if (err != ESP_OK) {
+        return err;
     }
+    prefs_txn_put_u32(&txn, key, value);
+    return prefs_commit(&txn);
+}
+
+esp_err_t prefs_get_u32(const char *nvs_namespace, const char *key, uint32_t *out_value, uint32_t default_value)
+{
+    if (!key || !out_value) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    prefs_txn_t txn;
+    esp_err_t err = prefs_begin(&txn, nvs_namespace, false);
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = prefs_txn_get_u32(&txn, key, out_value, default_value);
+    prefs_end(&txn);
     return err;
 }
 
 esp_err_t prefs_put_u64(const char *nvs_namespace, const char *key, uint64_t value)
 {
-    nvs_handle_t handle;
-    esp_err_t err = nvs_open(resolve_namespace(nvs_namespace), NVS_READWRITE, &handle);
+    prefs_txn_t txn;
+    esp_err_t err = prefs_begin(&txn, nvs_namespace, true);
     if (err != ESP_OK) {
         return err;
     }
-
-    err = nvs_set_u64(handle, key, value);
-    return commit_and_close(handle, err);
+    prefs_txn_put_u64(&txn, key, value);
+    return prefs_commit(&txn);
 }
 
 esp_err_t prefs_get_u64(const char *nvs_namespace, const char *key, uint64_t *out_value, uint64_t default_value)
@@ -181,21 +728,14 @@ esp_err_t prefs_get_u64(const char *nvs_namespace, const char *key, uint64_t *ou
         return ESP_ERR_INVALID_ARG;
     }
 
-    nvs_handle_t handle;
-    esp_err_t err = nvs_open(resolve_namespace(nvs_namespace), NVS_READONLY, &handle);
+    prefs_txn_t txn;
+    esp_err_t err = prefs_begin(&txn, nvs_namespace, false);
     if (err != ESP_OK) {
         *out_value = default_value;
         return err;
     }
-
-    uint64_t value = default_value;
-    err = nvs_get_u64(handle, key, &value);
-    if (err == ESP_ERR_NVS_NOT_FOUND) {
-        err = ESP_OK;
-    }
-
-    nvs_close(handle);
-    *out_value = value;
+    err = prefs_txn_get_u64(&txn, key, out_value, default_value);
+    prefs_end(&txn);
     return err;
 }
 
@@ -253,14 +793,13 @@ esp_err_t prefs_put_str(const char *nvs_namespace, const char *key, const char *
         return ESP_ERR_INVALID_ARG;
     }
 
-    nvs_handle_t handle;
-    esp_err_t err = nvs_open(resolve_namespace(nvs_namespace), NVS_READWRITE, &handle);
+    prefs_txn_t txn;
+    esp_err_t err = prefs_begin(&txn, nvs_namespace, true);
     if (err != ESP_OK) {
         return err;
     }
-
-    err = nvs_set_str(handle, key, value);
-    return commit_and_close(handle, err);
+    prefs_txn_put_str(&txn, key, value);
+    return prefs_commit(&txn);
 }
 
 esp_err_t prefs_get_str(
@@ -274,19 +813,19 @@ esp_err_t prefs_get_str(
         return ESP_ERR_INVALID_ARG;
     }
 
-    nvs_handle_t handle;
-    esp_err_t err = nvs_open(resolve_namespace(nvs_namespace), NVS_READONLY, &handle);
-    if (err != ESP_OK) {
+    size_t staged_len = out_value_len;
+    esp_err_t err;
+    if (read_staged_value(nvs_namespace, key, STAGED_STR, out_value, &staged_len, &err)) {
         return err;
     }
 
-    size_t value_len = out_value_len;
-    err = nvs_get_str(handle, key, out_value, &value_len);
-    if (err == ESP_ERR_NVS_NOT_FOUND) {
-        copy_default_str(out_value, out_value_len, default_value);
-        err = ESP_OK;
+    prefs_txn_t txn;
+    err = prefs_begin(&txn, nvs_namespace, false);
+    if (err != ESP_OK) {
+        return err;
     }
-    nvs_close(handle);
+    err = prefs_txn_get_str(&txn, key, out_value, out_value_len, default_value);
+    prefs_end(&txn);
     return err;
 }
 
@@ -296,14 +835,13 @@ esp_err_t prefs_put_blob(const char *nvs_namespace, const char *key, const void
         return ESP_ERR_INVALID_ARG;
     }
 
-    nvs_handle_t handle;
-    esp_err_t err = nvs_open(resolve_namespace(nvs_namespace), NVS_READWRITE, &handle);
+    prefs_txn_t txn;
+    esp_err_t err = prefs_begin(&txn, nvs_namespace, true);
     if (err != ESP_OK) {
         return err;
     }
-
-    err = nvs_set_blob(handle, key, value, value_len);
-    return commit_and_close(handle, err);
+    prefs_txn_put_blob(&txn, key, value, value_len);
+    return prefs_commit(&txn);
 }
 
 esp_err_t prefs_get_blob(const char *nvs_namespace, const char *key, void *out_value, size_t *in_out_value_len)
@@ -312,20 +850,204 @@ esp_err_t prefs_get_blob(const char *nvs_namespace, const char *key, void *out_v
         return ESP_ERR_INVALID_ARG;
     }
 
-    nvs_handle_t handle;
-    esp_err_t err = nvs_open(resolve_namespace(nvs_namespace), NVS_READONLY, &handle);
-    if (err != ESP_OK) {
+    esp_err_t err;
+    if (read_staged_value(nvs_namespace, key, STAGED_BLOB, out_value, in_out_value_len, &err)) {
         return err;
     }
 
-    err = nvs_get_blob(handle, key, out_value, in_out_value_len);
-    nvs_close(handle);
+    prefs_txn_t txn;
+    err = prefs_begin(&txn, nvs_namespace, false);
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = prefs_txn_get_blob(&txn, key, out_value, in_out_value_len);
+    prefs_end(&txn);
     return err;
 }
 
+static void prefs_writer(void *arg)
+{
+    (void)arg;
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        // Let the rest of the burst arrive, then commit it together
+        vTaskDelay(pdMS_TO_TICKS(PREFS_WRITE_DELAY_MS));
+        prefs_flush();
+    }
+}
+
+static esp_err_t write_through(const char *nvs_namespace, const char *key, prefs_staged_type_t type, const void *value, size_t value_len)
+{
+    switch (type) {
+    case STAGED_U8:
+        return prefs_put_u8(nvs_namespace, key, *(const uint8_t *)value);
+    case STAGED_STR:
+        return prefs_put_str(nvs_namespace, key, (const char *)value);
+    case STAGED_BLOB:
+        return prefs_put_blob(nvs_namespace, key, value, value_len);
+    default:
+        return ESP_ERR_INVALID_ARG;
+    }
+}
+
+static esp_err_t defer_value(const char *nvs_namespace, const char *key, prefs_staged_type_t type, const void *value, size_t value_len)
+{
+    const char *name = resolve_namespace(nvs_namespace);
+    if (strnlen(name, PREFS_NAMESPACE_MAX_LEN) >= PREFS_NAMESPACE_MAX_LEN) {
+        return ESP_ERR_NVS_INVALID_NAME;
+    }
+    if (strnlen(key, PREFS_KEY_MAX_LEN) >= PREFS_KEY_MAX_LEN) {
+        return ESP_ERR_NVS_KEY_TOO_LONG;
+    }
+    if (value_len > PREFS_STAGED_VALUE_MAX) {
+        return write_through(nvs_namespace, key, type, value, value_len);
+    }
+
+    prefs_init();
+    xSemaphoreTakeRecursive(prefs_lock, portMAX_DELAY);
+    if (!writer_task) {
+        writer_task = xTaskCreateStaticPinnedToCore(prefs_writer, "prefs_writer", PREFS_WRITER_STACK, NULL,
+                                                    PREFS_WRITER_PRIORITY, writer_task_stack, &writer_task_tcb,
+                                                    NETWORK_CORE);
+    }
+    prefs_staged_t *slot = writer_task ? staged_find(name, key) : NULL;
+    if (slot) {
+        write_stats.coalesced++;
+    } else if (writer_task) {
+        for (size_t i = 0; i < PREFS_STAGED_SLOTS && !slot; ++i) {
+            if (!staged[i].used) {
+                slot = &staged[i];
+            }
+        }
+    }
+    if (!slot) {
+        // No writer or no room: pay for the commit now
+        esp_err_t err = write_through(nvs_namespace, key, type, value, value_len);
+        xSemaphoreGiveRecursive(prefs_lock);
+        return err;
+    }
+
+    slot->used = true;
+    slot->type = type;
+    slot->len = (uint8_t)value_len;
+    memcpy(slot->name, name, strlen(name) + 1);
+    memcpy(slot->key, key, strlen(key) + 1);
+    memcpy(slot->value, value, value_len);
+    xSemaphoreGiveRecursive(prefs_lock);
+    xTaskNotifyGive(writer_task);
+    return ESP_OK;
+}
+
+esp_err_t prefs_defer_u8(const char *nvs_namespace, const char *key, uint8_t value)
+{
+    if (!key) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return defer_value(nvs_namespace, key, STAGED_U8, &value, sizeof(value));
+}
+
+esp_err_t prefs_defer_bool(const char *nvs_namespace, const char *key, bool value)
+{
+    return prefs_defer_u8(nvs_namespace, key, value ? 1U : 0U);
+}
+
+esp_err_t prefs_defer_str(const char *nvs_namespace, const char *key, const char *value)
+{
+    if (!key || !value) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return defer_value(nvs_namespace, key, STAGED_STR, value, strlen(value) + 1);
+}
+
+esp_err_t prefs_defer_blob(const char *nvs_namespace, const char *key, const void *value, size_t value_len)
+{
+    if (!key || !value || value_len == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return defer_value(nvs_namespace, key, STAGED_BLOB, value, value_len);
+}
+
+static void put_staged(prefs_txn_t *txn, const prefs_staged_t *entry)
+{
+    switch (entry->type) {
+    case STAGED_U8:
+        prefs_txn_put_u8(txn, entry->key, entry->value[0]);
+        break;
+    case STAGED_STR:
+        prefs_txn_put_str(txn, entry->key, (const char *)entry->value);
+        break;
+    case STAGED_BLOB:
+        prefs_txn_put_blob(txn, entry->key, entry->value, entry->len);
+        break;
+    default:
+        break;
+    }
+}
+
+esp_err_t prefs_flush(void)
+{
+    prefs_init();
+    xSemaphoreTakeRecursive(prefs_lock, portMAX_DELAY);
+    esp_err_t result = ESP_OK;
+    for (size_t i = 0; i < PREFS_STAGED_SLOTS; ++i) {
+        if (!staged[i].used) {
+            continue;
+        }
+        // Everything staged for this namespace goes into one commit
+        char name[PREFS_NAMESPACE_MAX_LEN];
+        memcpy(name, staged[i].name, sizeof(name));
+        prefs_txn_t txn;
+        esp_err_t err = prefs_begin(&txn, name, true);
+        for (size_t j = i; j < PREFS_STAGED_SLOTS; ++j) {
+            if (!staged[j].used || strcmp(staged[j].name, name) != 0) {
+                continue;
+            }
+            prefs_staged_t entry = staged[j];
+            staged[j].used = false;
+            if (err == ESP_OK) {
+                put_staged(&txn, &entry);
+            }
+        }
+        if (err == ESP_OK) {
+            err = prefs_commit(&txn);
+        }
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "Deferred write to %s failed: %s", name, esp_err_to_name(err));
+            if (result == ESP_OK) {
+                result = err;
+            }
+        }
+    }
+    xSemaphoreGiveRecursive(prefs_lock);
+    return result;
+}
+
+void prefs_get_write_stats(prefs_write_stats_t *out_stats)
+{
+    if (!out_stats) {
+        return;
+    }
+    prefs_init();
+    xSemaphoreTakeRecursive(prefs_lock, portMAX_DELAY);
+    roll_hour_buckets();
+    *out_stats = write_stats;
+    out_stats->commits_last_hour = 0;
+    for (size_t i = 0; i < PREFS_HOUR_BUCKETS; ++i) {
+        out_stats->commits_last_hour += hour_buckets[i];
+    }
+    xSemaphoreGiveRecursive(prefs_lock);
+}
+
+uint32_t prefs_commits_last_hour(void)
+{
+    prefs_write_stats_t stats;
+    prefs_get_write_stats(&stats);
+    return stats.commits_last_hour;
+}
+
 esp_err_t put_char(const char *key, unsigned char value)
 {
-    return prefs_put_u8(NULL, key, (uint8_t)value);
+    return prefs_defer_u8(NULL, key, (uint8_t)value);
 }
 
 char get_char(const char *key, unsigned char default_value)
@@ -5,9 +5,63 @@
 #include <stdint.h>
 
 #include "esp_err.h"
+#include "nvs.h"
 
 #define PREFS_DEFAULT_NAMESPACE "app"
+#define PREFS_NAMESPACE_MAX_LEN 16  // NVS limit, including the terminator
+#define PREFS_STATS_NAMESPACES  8
 
+// NVS handles are cached per namespace and shared by every call below. Call
+// once after nvs_flash_init(), before other tasks use preferences.
+void prefs_init(void);
+
+// Transactions group several reads or writes on one namespace under one
+// cached handle and a single nvs_commit(). The preferences lock is held from
+// prefs_begin() to prefs_commit()/prefs_end(), so keep them short and do not
+// nest a transaction on the same namespace. NVS applies each put as it is
+// made; a failed put skips the remaining ones and is reported by
+// prefs_commit(), but earlier puts are not rolled back.
+
+typedef struct {
+    nvs_handle_t handle;
+    char name[PREFS_NAMESPACE_MAX_LEN];
+    esp_err_t err;  // first failed put
+    bool writable;
+    bool active;
+    bool dirty;
+} prefs_txn_t;
+
+esp_err_t prefs_begin(prefs_txn_t *txn, const char *nvs_namespace, bool writable);
+// Commit pending puts (if any) and release the transaction
+esp_err_t prefs_commit(prefs_txn_t *txn);
+// Release without committing (read-only transactions)
+void prefs_end(prefs_txn_t *txn);
+
+esp_err_t prefs_txn_put_u8(prefs_txn_t *txn, const char *key, uint8_t value);
+esp_err_t prefs_txn_put_i32(prefs_txn_t *txn, const char *key, int32_t value);
+esp_err_t prefs_txn_put_u32(prefs_txn_t *txn, const char *key, uint32_t value);
+esp_err_t prefs_txn_put_u64(prefs_txn_t *txn, const char *key, uint64_t value);
+esp_err_t prefs_txn_put_bool(prefs_txn_t *txn, const char *key, bool value);
+esp_err_t prefs_txn_put_str(prefs_txn_t *txn, const char *key, const char *value);
+esp_err_t prefs_txn_put_blob(prefs_txn_t *txn, const char *key, const void *value, size_t value_len);
+// Missing keys are not an error
+esp_err_t prefs_txn_erase(prefs_txn_t *txn, const char *key);
+
+// Same default handling as the one-shot getters: a missing key yields the default
+esp_err_t prefs_txn_get_u8(prefs_txn_t *txn, const char *key, uint8_t *out_value, uint8_t default_value);
+esp_err_t prefs_txn_get_i32(prefs_txn_t *txn, const char *key, int32_t *out_value, int32_t default_value);
+esp_err_t prefs_txn_get_u32(prefs_txn_t *txn, const char *key, uint32_t *out_value, uint32_t default_value);
+esp_err_t prefs_txn_get_u64(prefs_txn_t *txn, const char *key, uint64_t *out_value, uint64_t default_value);
+esp_err_t prefs_txn_get_bool(prefs_txn_t *txn, const char *key, bool *out_value, bool default_value);
+esp_err_t prefs_txn_get_str(
+    prefs_txn_t *txn,
+    const char *key,
+    char *out_value,
+    size_t out_value_len,
+    const char *default_value);
+esp_err_t prefs_txn_get_blob(prefs_txn_t *txn, const char *key, void *out_value, size_t *in_out_value_len);
+
+// One-shot accessors: each is a single-value transaction (a put commits)
 esp_err_t prefs_put_u8(const char *nvs_namespace, const char *key, uint8_t value);
 esp_err_t prefs_get_u8(const char *nvs_namespace, const char *key, uint8_t *out_value, uint8_t default_value);
 
@@ -36,5 +90,40 @@ esp_err_t prefs_get_str(
 esp_err_t prefs_put_blob(const char *nvs_namespace, const char *key, const void *value, size_t value_len);
 esp_err_t prefs_get_blob(const char *nvs_namespace, const char *key, void *out_value, size_t *in_out_value_len);
 
+// Deferred writes, for callers that must not wait on flash. The value is
+// staged in RAM and a low-priority writer commits everything staged
+// PREFS_WRITE_DELAY_MS after the first deferred write, so a burst of updates
+// costs one commit per namespace and a key rewritten before then is written
+// once. Reads see staged values. Staged writes are lost on power loss; they
+// are flushed on esp_restart() and should be flushed before deep sleep.
+// Values of any length are written through immediately if they cannot be staged.
+esp_err_t prefs_defer_u8(const char *nvs_namespace, const char *key, uint8_t value);
+esp_err_t prefs_defer_bool(const char *nvs_namespace, const char *key, bool value);
+esp_err_t prefs_defer_str(const char *nvs_namespace, const char *key, const char *value);
+esp_err_t prefs_defer_blob(const char *nvs_namespace, const char *key, const void *value, size_t value_len);
+// Commit all staged writes now
+esp_err_t prefs_flush(void);
+
+// Write accounting. Every put first compares against the stored value and
+// is dropped if nothing changed; only commits that carried a change count.
+typedef struct {
+    char name[PREFS_NAMESPACE_MAX_LEN];
+    uint32_t commits;
+    uint32_t skipped;     // puts dropped because the value was unchanged
+} prefs_namespace_stats_t;
+
+typedef struct {
+    uint32_t commits;
+    uint32_t skipped;
+    uint32_t coalesced;          // deferred writes replaced before reaching flash
+    uint32_t commits_last_hour;
+    size_t namespace_count;
+    prefs_namespace_stats_t namespaces[PREFS_STATS_NAMESPACES];
+} prefs_write_stats_t;
+
+void prefs_get_write_stats(prefs_write_stats_t *out_stats);
+uint32_t prefs_commits_last_hour(void);
+
+// Debug flag helpers on the default namespace; writes are deferred
 esp_err_t put_char(const char *key, unsigned char value);
 char get_char(const char *key, unsigned char default_value);
@@ -0,0 +1,146 @@
+#include "relay_frame.h"
+
+#include <string.h>
+
+#include "storage_codec.h"
+
+_Static_assert(RELAY_READINGS_MAX >= 1 && RELAY_COMMAND_MAX > 0, "relay frame layout");
+
+static uint8_t *put_le16(uint8_t *p, uint16_t value)
+{
+    p[0] = (uint8_t)value;
+    p[1] = (uint8_t)(value >> 8);
+    return p + 2;
+}
+
+static uint8_t *put_le64(uint8_t *p, uint64_t value)
+{
+    for (int i = 0; i < 8; ++i) {
+        p[i] = (uint8_t)(value >> (8 * i));
+    }
+    return p + 8;
+}
+
+static uint16_t get_le16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint64_t get_le64(const uint8_t *p)
+{
+    uint64_t value = 0;
+    for (int i = 7; i >= 0; --i) {
+        value = (value << 8) | p[i];
+    }
+    return value;
+}
+
+static uint8_t *put_header(uint8_t *p, relay_frame_type_t type, uint8_t seq, const char *device_id)
+{
+    p[0] = RELAY_FRAME_MAGIC;
+    p[1] = RELAY_FRAME_VERSION;
+    p[2] = (uint8_t)type;
+    p[3] = seq;
+    memset(&p[4], 0, DEVICE_ID_MAX_LEN);
+    size_t id_len = strnlen(device_id, DEVICE_ID_MAX_LEN - 1);
+    memcpy(&p[4], device_id, id_len);
+    return p + RELAY_HEADER_LEN;
+}
+
+size_t relay_encode_readings(uint8_t seq,
+                             const char *device_id,
+                             const sensor_reading_t *readings,
+                             size_t count,
+                             uint8_t *out,
+                             size_t cap)
+{
+    size_t len = RELAY_HEADER_LEN + 1 + count * RELAY_READING_LEN;
+    if (!device_id || !readings || !out || count == 0 || count > RELAY_READINGS_MAX || cap < len) {
+        return 0;
+    }
+    uint8_t *p = put_header(out, RELAY_FRAME_READINGS, seq, device_id);
+    *p++ = (uint8_t)count;
+    for (size_t i = 0; i < count; ++i) {
+        const sensor_reading_t *r = &readings[i];
+        p = put_le64(p, r->timestamp_ms);
+        p = put_le16(p, r->soil_raw);
+        p = put_le16(p, to_centi_u16(r->soil_percent));
+        p = put_le16(p, (uint16_t)to_centi_i16(r->temperature_c));
+        p = put_le16(p, (uint16_t)to_centi_i16(r->humidity_pct));
+        p = put_le16(p, to_battery_mv(r->battery_v));
+        *p++ = storage_flags_from_reading(r);
+    }
+    return len;
+}
+
+size_t relay_encode_ack(uint8_t seq,
+                        const char *device_id,
+                        uint64_t epoch_ms,
+                        const char *command,
+                        size_t command_len,
+                        uint8_t *out,
+                        size_t cap)
+{
+    size_t len = RELAY_HEADER_LEN + 8 + command_len;
+    if (!device_id || !out || command_len > RELAY_COMMAND_MAX || (command_len && !command) || cap < len) {
+        return 0;
+    }
+    uint8_t *p = put_header(out, RELAY_FRAME_ACK, seq, device_id);
+    p = put_le64(p, epoch_ms);
+    if (command_len) {
+        memcpy(p, command, command_len);
+    }
+    return len;
+}
+
+bool relay_decode(const uint8_t *data, size_t len, relay_frame_t *out)
+{
+    if (!data || !out || len < RELAY_HEADER_LEN || len > RELAY_FRAME_MAX ||
+        data[0] != RELAY_FRAME_MAGIC || data[1] != RELAY_FRAME_VERSION) {
+        return false;
+    }
+    memset(out, 0, sizeof(*out));
+    out->type = (relay_frame_type_t)data[2];
+    out->seq = data[3];
+    memcpy(out->device_id, &data[4], DEVICE_ID_MAX_LEN - 1);
+    if (!out->device_id[0]) {
+        return false;
+    }
+    const uint8_t *p = data + RELAY_HEADER_LEN;
+    size_t left = len - RELAY_HEADER_LEN;
+
+    switch (out->type) {
+    case RELAY_FRAME_READINGS: {
+        if (left < 1) {
+            return false;
+        }
+        size_t count = *p++;
+        if (count == 0 || count > RELAY_READINGS_MAX || left - 1 != count * RELAY_READING_LEN) {
+            return false;
+        }
+        for (size_t i = 0; i < count; ++i, p += RELAY_READING_LEN) {
+            sensor_reading_t *r = &out->readings[i];
+            r->timestamp_ms = get_le64(p);
+            r->soil_raw = get_le16(p + 8);
+            r->soil_percent = from_centi_u16(get_le16(p + 10));
+            r->temperature_c = from_centi_i16((int16_t)get_le16(p + 12));
+            r->humidity_pct = from_centi_i16((int16_t)get_le16(p + 14));
+            r->battery_v = from_battery_mv(get_le16(p + 16));
+            storage_flags_to_reading(p[18], r);
+            r->window_samples = 1;
+        }
+        out->reading_count = count;
+        return true;
+    }
+    case RELAY_FRAME_ACK:
+        if (left < 8) {
+            return false;
+        }
+        out->epoch_ms = get_le64(p);
+        out->command_len = left - 8;
+        out->command = out->command_len ? (const char *)(p + 8) : NULL;
+        return true;
+    default:
+        return false;
+    }
+}
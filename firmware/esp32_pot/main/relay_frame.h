@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "device_identity.h"
+#include "sensors.h"
+
+// Frames between leaf pots and their gateway (espnow_relay.h), one per
+// ESP-NOW packet. Explicit little-endian byte streams:
+//   header (36 bytes): magic 'P', version, type, seq, then the sender's
+//     device id NUL-padded to DEVICE_ID_MAX_LEN
+//   readings (leaf -> gateway): count u8, then RELAY_READING_LEN bytes per
+//     reading: timestamp ms u64 (0 = clock not set), soilRaw u16, moisture
+//     u16 hundredths, temperature and humidity i16 hundredths, battery u16 mV,
+//     STORAGE_FLAG_* u8 (the ring's fixed-point encoding, storage_codec.h)
+//   ack (gateway -> leaf): same seq as the readings frame; epoch ms u64 (0
+//     unless the gateway clock is synced), then optionally one command: the
+//     payload exactly as the hub published it on pots/<leaf id>/command
+#define RELAY_FRAME_MAGIC    'P'
+#define RELAY_FRAME_VERSION  1
+#define RELAY_FRAME_MAX      250    // ESP_NOW_MAX_DATA_LEN
+#define RELAY_HEADER_LEN     (4 + DEVICE_ID_MAX_LEN)
+#define RELAY_READING_LEN    19
+#define RELAY_READINGS_MAX   ((RELAY_FRAME_MAX - RELAY_HEADER_LEN - 1) / RELAY_READING_LEN)
+#define RELAY_COMMAND_MAX    (RELAY_FRAME_MAX - RELAY_HEADER_LEN - 8)
+
+typedef enum {
+    RELAY_FRAME_READINGS = 1,
+    RELAY_FRAME_ACK = 2,
+} relay_frame_type_t;
+
+// A decoded frame. command points into the buffer it was decoded from.
+typedef struct {
+    relay_frame_type_t type;
+    uint8_t seq;
+    char device_id[DEVICE_ID_MAX_LEN];
+    size_t reading_count;
+    sensor_reading_t readings[RELAY_READINGS_MAX];
+    uint64_t epoch_ms;
+    const char *command;
+    size_t command_len;
+} relay_frame_t;
+
+// Return the frame length, or 0 if the arguments do not fit one frame
+size_t relay_encode_readings(uint8_t seq,
+                             const char *device_id,
+                             const sensor_reading_t *readings,
+                             size_t count,
+                             uint8_t *out,
+                             size_t cap);
+size_t relay_encode_ack(uint8_t seq,
+                        const char *device_id,
+                        uint64_t epoch_ms,
+                        const char *command,
+                        size_t command_len,
+                        uint8_t *out,
+                        size_t cap);
+
+// False for anything that is not a well-formed frame of this version
+bool relay_decode(const uint8_t *data, size_t len, relay_frame_t *out);
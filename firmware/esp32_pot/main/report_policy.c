@@ -0,0 +1,165 @@
+#include "report_policy.h"
+
+#include <math.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "esp_crc.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+
+#include "hardware_config.h"
+#include "preferences.h"
+
+#define REPORT_POLICY_NAMESPACE "device"
+#define REPORT_POLICY_KEY "report_policy"
+#define REPORT_POLICY_VERSION 1
+
+static const char *TAG = "report_policy";
+
+typedef struct {
+    uint8_t version;
+    uint8_t reserved[3];
+    report_policy_t policy;
+    uint32_t crc32;  // esp_crc32_le over every byte before this field
+} report_policy_blob_t;
+
+static report_policy_t policy = {
+    .moisture_pct = REPORT_MOISTURE_DEADBAND_PCT,
+    .temperature_c = REPORT_TEMPERATURE_DEADBAND_C,
+    .humidity_pct = REPORT_HUMIDITY_DEADBAND_PCT,
+    .max_silence_s = REPORT_MAX_SILENCE_S,
+};
+static portMUX_TYPE policy_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Last reading that went out; sensor task only
+static sensor_reading_t reference;
+static bool have_reference = false;
+static int64_t reference_us = 0;
+
+static uint32_t blob_crc(const report_policy_blob_t *blob)
+{
+    return esp_crc32_le(0, (const uint8_t *)blob, offsetof(report_policy_blob_t, crc32));
+}
+
+static bool policy_valid(const report_policy_t *p)
+{
+    // NAN compares false and is rejected too
+    return p->moisture_pct >= 0 && p->temperature_c >= 0 && p->humidity_pct >= 0;
+}
+
+void report_policy_init(void)
+{
+    report_policy_blob_t blob;
+    size_t len = sizeof(blob);
+    esp_err_t err = prefs_get_blob(REPORT_POLICY_NAMESPACE, REPORT_POLICY_KEY, &blob, &len);
+    if (err == ESP_ERR_NVS_NOT_FOUND) {
+        return;
+    }
+    if (err != ESP_OK ||
+        len != sizeof(blob) ||
+        blob.version != REPORT_POLICY_VERSION ||
+        blob.crc32 != blob_crc(&blob) ||
+        !policy_valid(&blob.policy)) {
+        ESP_LOGW(TAG, "Stored report policy unusable (%s); using defaults", esp_err_to_name(err));
+        return;
+    }
+    taskENTER_CRITICAL(&policy_lock);
+    policy = blob.policy;
+    taskEXIT_CRITICAL(&policy_lock);
+    ESP_LOGI(TAG, "Report policy: soil %.2f %%, %.2f C, %.2f %%RH, heartbeat %u s",
+             (double)blob.policy.moisture_pct, (double)blob.policy.temperature_c,
+             (double)blob.policy.humidity_pct, (unsigned)blob.policy.max_silence_s);
+}
+
+void report_policy_get(report_policy_t *out)
+{
+    if (!out) {
+        return;
+    }
+    taskENTER_CRITICAL(&policy_lock);
+    *out = policy;
+    taskEXIT_CRITICAL(&policy_lock);
+}
+
+esp_err_t report_policy_update(const report_policy_t *values, uint8_t mask)
+{
+    if (!values) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    report_policy_t next;
+    report_policy_get(&next);
+    if (mask & REPORT_POLICY_FIELD_MOISTURE) {
+        next.moisture_pct = values->moisture_pct;
+    }
+    if (mask & REPORT_POLICY_FIELD_TEMPERATURE) {
+        next.temperature_c = values->temperature_c;
+    }
+    if (mask & REPORT_POLICY_FIELD_HUMIDITY) {
+        next.humidity_pct = values->humidity_pct;
+    }
+    if (mask & REPORT_POLICY_FIELD_MAX_SILENCE) {
+        next.max_silence_s = values->max_silence_s;
+    }
+    if (!policy_valid(&next)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    report_policy_blob_t blob;
+    memset(&blob, 0, sizeof(blob));
+    blob.version = REPORT_POLICY_VERSION;
+    blob.policy = next;
+    blob.crc32 = blob_crc(&blob);
+    esp_err_t err = prefs_defer_blob(REPORT_POLICY_NAMESPACE, REPORT_POLICY_KEY, &blob, sizeof(blob));
+    if (err != ESP_OK) {
+        return err;
+    }
+    taskENTER_CRITICAL(&policy_lock);
+    policy = next;
+    taskEXIT_CRITICAL(&policy_lock);
+    return ESP_OK;
+}
+
+// A value that appears or drops out always counts as a change
+static bool moved(float now, float then, float deadband)
+{
+    bool now_valid = !isnan(now);
+    if (now_valid != !isnan(then)) {
+        return true;
+    }
+    return now_valid && fabsf(now - then) > deadband;
+}
+
+static bool states_differ(const sensor_reading_t *a, const sensor_reading_t *b)
+{
+    return a->water_low != b->water_low ||
+           a->water_cutoff != b->water_cutoff ||
+           a->pump_is_on != b->pump_is_on ||
+           a->ic_zone1_is_on != b->ic_zone1_is_on ||
+           a->fan_is_on != b->fan_is_on ||
+           a->mister_is_on != b->mister_is_on ||
+           a->light_is_on != b->light_is_on;
+}
+
+bool report_policy_filter(const sensor_reading_t *reading, int64_t now_us)
+{
+    if (!reading) {
+        return false;
+    }
+    report_policy_t p;
+    report_policy_get(&p);
+
+    bool report = p.max_silence_s == 0 ||
+                  !have_reference ||
+                  now_us - reference_us >= (int64_t)p.max_silence_s * 1000000 ||
+                  states_differ(reading, &reference) ||
+                  moved(reading->soil_percent, reference.soil_percent, p.moisture_pct) ||
+                  moved(reading->temperature_c, reference.temperature_c, p.temperature_c) ||
+                  moved(reading->humidity_pct, reference.humidity_pct, p.humidity_pct);
+    if (report) {
+        reference = *reading;
+        reference_us = now_us;
+        have_reference = true;
+    }
+    return report;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#include "sensors.h"
+
+// Report-by-exception for live telemetry. A reading goes out when an output
+// or float switch changed, when soil %, temperature or humidity moved past
+// its deadband since the last reading that went out, when a value appears or
+// drops out, or when max_silence_s passed without one. max_silence_s = 0
+// turns the policy off and every reading goes out.
+typedef struct {
+    float moisture_pct;     // soil %, absolute
+    float temperature_c;
+    float humidity_pct;     // %RH, absolute
+    uint32_t max_silence_s; // heartbeat; 0 = report every reading
+} report_policy_t;
+
+// Field bits for report_policy_update(); unset fields keep their value
+#define REPORT_POLICY_FIELD_MOISTURE    (1u << 0)
+#define REPORT_POLICY_FIELD_TEMPERATURE (1u << 1)
+#define REPORT_POLICY_FIELD_HUMIDITY    (1u << 2)
+#define REPORT_POLICY_FIELD_MAX_SILENCE (1u << 3)
+
+// Loads the stored policy, or the REPORT_* defaults from hardware_config.h
+void report_policy_init(void);
+void report_policy_get(report_policy_t *out);
+// Negative deadbands are rejected; the write is deferred like other prefs
+esp_err_t report_policy_update(const report_policy_t *values, uint8_t mask);
+
+// True when the reading should be published; it then becomes the reference
+// the next one is compared with. Single caller (the sensor task).
+bool report_policy_filter(const sensor_reading_t *reading, int64_t now_us);
@@ -0,0 +1,77 @@
+#include "sensor_window.h"
+
+#include <math.h>
+#include <string.h>
+
+static void stat_add(sensor_stat_t *stat, float value)
+{
+    if (isnan(value)) {
+        return;
+    }
+    if (stat->n == 0) {
+        stat->min = value;
+        stat->max = value;
+    } else {
+        stat->min = fminf(stat->min, value);
+        stat->max = fmaxf(stat->max, value);
+    }
+    stat->n++;
+    float delta = value - stat->mean;
+    stat->mean += delta / (float)stat->n;
+    stat->m2 += delta * (value - stat->mean);
+}
+
+static float stat_result(const sensor_stat_t *stat, sensor_spread_t *spread)
+{
+    if (stat->n == 0) {
+        spread->min = NAN;
+        spread->max = NAN;
+        spread->stddev = NAN;
+        return NAN;
+    }
+    spread->min = stat->min;
+    spread->max = stat->max;
+    spread->stddev = stat->n > 1 ? sqrtf(stat->m2 / (float)stat->n) : 0.0f;
+    return stat->mean;
+}
+
+static bool states_differ(const sensor_reading_t *a, const sensor_reading_t *b)
+{
+    return a->water_low != b->water_low ||
+           a->water_cutoff != b->water_cutoff ||
+           a->pump_is_on != b->pump_is_on ||
+           a->ic_zone1_is_on != b->ic_zone1_is_on ||
+           a->fan_is_on != b->fan_is_on ||
+           a->mister_is_on != b->mister_is_on ||
+           a->light_is_on != b->light_is_on;
+}
+
+void sensor_window_reset(sensor_window_t *window)
+{
+    memset(window, 0, sizeof(*window));
+}
+
+bool sensor_window_add(sensor_window_t *window, const sensor_reading_t *sample)
+{
+    bool changed = window->samples > 0 && states_differ(sample, &window->last);
+    stat_add(&window->soil, sample->soil_percent);
+    stat_add(&window->temperature, sample->temperature_c);
+    stat_add(&window->humidity, sample->humidity_pct);
+    window->last = *sample;
+    if (window->samples < UINT16_MAX) {
+        window->samples++;
+    }
+    return changed;
+}
+
+void sensor_window_finish(const sensor_window_t *window, sensor_reading_t *out)
+{
+    *out = window->last;
+    out->window_samples = window->samples;
+    if (window->samples <= 1) {
+        return;
+    }
+    out->soil_percent = stat_result(&window->soil, &out->soil_spread);
+    out->temperature_c = stat_result(&window->temperature, &out->temperature_spread);
+    out->humidity_pct = stat_result(&window->humidity, &out->humidity_spread);
+}
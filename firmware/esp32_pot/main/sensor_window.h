@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "sensors.h"
+
+// Constant-memory statistics over the fast samples of one publish window.
+// Each field keeps a running count, mean and sum of squared deviations
+// (Welford's update), so the window length costs no RAM and the variance
+// does not cancel out the way sum/sum-of-squares does in float. Samples with
+// a NAN field are skipped for that field only.
+typedef struct {
+    uint16_t n;
+    float mean;
+    float m2;
+    float min;
+    float max;
+} sensor_stat_t;
+
+typedef struct {
+    uint16_t samples;
+    sensor_stat_t soil;
+    sensor_stat_t temperature;
+    sensor_stat_t humidity;
+    sensor_reading_t last;   // latest sample: timestamp, raw, battery, states
+} sensor_window_t;
+
+void sensor_window_reset(sensor_window_t *window);
+// Returns true when an output or float switch differs from the previous
+// sample, so the caller can close the window early and report it at once
+bool sensor_window_add(sensor_window_t *window, const sensor_reading_t *sample);
+// The latest sample with the window means and spreads; leaves the window as is
+void sensor_window_finish(const sensor_window_t *window, sensor_reading_t *out);
@@ -5,122 +5,311 @@
 #include <sys/time.h>
 
 #include "driver/gpio.h"
-#include "driver/i2c.h"
 #include "esp_err.h"
 #include "esp_log.h"
 #include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
 #include "freertos/task.h"
+#if CONFIG_PM_ENABLE
+#include "esp_pm.h"
+#endif
 
 #include "hardware_config.h"
 #include "device_identity.h"
-#include "aht10.h"
+#include "actuator_state.h"
 #include "ads1115.h"
+#include "i2c_bus.h"
+#include "latency_hist.h"
+#include "soil_filter.h"
+#include "th_sensor.h"
 #include "time_sync.h"
 
-#include "preferences.h"  // DEBUG
-
 static const char *TAG = "sensors";
-static bool pump_state = false;
-static bool ic_zone1_state = false;
-static bool fan_state = false;
-static bool mister_state = false;
-static bool light_state = false;
 static bool i2c_ready = false;
 
+// Output states live in the actuator state word (actuator_state.h); this
+// lock keeps the GPIO and the word in step when two tasks switch one output
+static portMUX_TYPE output_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// The sensor rail is shared by measurements and pump runs (the floats only
+// read while it is powered); it is switched off when the last user releases it
+static portMUX_TYPE rail_lock = portMUX_INITIALIZER_UNLOCKED;
+static int rail_users = 0;
+static int64_t rail_on_us = 0;   // when the rail last came up
+
+// One acquisition at a time; the mutex is held from start to complete
+static StaticSemaphore_t collect_mutex_buf;
+static SemaphoreHandle_t collect_mutex;
+typedef enum {
+    ACQ_IDLE = 0,
+    ACQ_SENSORS_DISABLED,
+    ACQ_BUS_DOWN,
+    ACQ_POWERED,
+} acquisition_state_t;
+static acquisition_state_t acquisition = ACQ_IDLE;
+
+// Pump transitions from tasks are serialized by pump_mutex; pump_lock covers
+// the few instructions shared with the cutoff ISR
+static StaticSemaphore_t pump_mutex_buf;
+static SemaphoreHandle_t pump_mutex;
+static portMUX_TYPE pump_lock = portMUX_INITIALIZER_UNLOCKED;
+static bool pump_holds_rail = false;
+static bool cutoff_monitor_armed = false;
+static TaskHandle_t cutoff_task_handle;
+static StaticTask_t cutoff_task_tcb;
+static StackType_t cutoff_task_stack[CUTOFF_TASK_STACK];
+static sensors_cutoff_cb_t cutoff_handler;
+static volatile int64_t cutoff_trip_us;
+#if CONFIG_PM_ENABLE
+static esp_pm_lock_handle_t pump_pm_lock;  // GPIO edges do not wake light sleep
+#endif
+
+static void sensor_rail_acquire(void)
+{
+    taskENTER_CRITICAL(&rail_lock);
+    if (rail_users++ == 0) {
+        gpio_set_level(SENSOR_EN_GPIO, 1);
+        rail_on_us = esp_timer_get_time();
+    }
+    taskEXIT_CRITICAL(&rail_lock);
+}
+
+// Block until the rail has been up for settle_ms; free if it already has
+static void sensor_rail_wait(uint32_t settle_ms)
+{
+    taskENTER_CRITICAL(&rail_lock);
+    int64_t ready_us = rail_on_us + (int64_t)settle_ms * 1000;
+    taskEXIT_CRITICAL(&rail_lock);
+    int64_t left_us = ready_us - esp_timer_get_time();
+    if (left_us > 0) {
+        vTaskDelay(pdMS_TO_TICKS((left_us + 999) / 1000) + 1);
+    }
+}
+
+static void sensor_rail_release(void)
+{
+    taskENTER_CRITICAL(&rail_lock);
+    if (rail_users > 0 && --rail_users == 0) {
+        gpio_set_level(SENSOR_EN_GPIO, 0);
+    }
+    taskEXIT_CRITICAL(&rail_lock);
+}
+
 static esp_err_t ensure_i2c_bus(void)
 {
     if (i2c_ready) {
         return ESP_OK;
     }
-
-    i2c_config_t conf = {
-        .mode = I2C_MODE_MASTER,
-        .sda_io_num = I2C_SDA_GPIO,
-        .scl_io_num = I2C_SCL_GPIO,
-        .sda_pullup_en = GPIO_PULLUP_ENABLE,
-        .scl_pullup_en = GPIO_PULLUP_ENABLE,
-        .master.clk_speed = 100000,
-        .clk_flags = 0,
-    };
-
-    esp_err_t err = i2c_param_config(I2C_PORT_NUM, &conf);
-    if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) {
-        ESP_LOGE(TAG, "I2C param config failed: %s", esp_err_to_name(err));
+    esp_err_t err = i2c_bus_init();
+    if (err != ESP_OK) {
         return err;
     }
+    i2c_ready = true;
+    return ESP_OK;
+}
 
-    err = i2c_driver_install(I2C_PORT_NUM, conf.mode, 0, 0, 0);
-    if (err != ESP_OK) {
-        if (err == ESP_ERR_INVALID_STATE || err == ESP_FAIL) {
-            ESP_LOGW(TAG, "I2C driver already installed on port %d", I2C_PORT_NUM);
-        } else {
-            ESP_LOGE(TAG, "I2C driver install failed: %s", esp_err_to_name(err));
-            return err;
+// Drop what a pump run holds; called with pump_mutex taken and the pump off
+static void release_pump_run(void)
+{
+    if (cutoff_monitor_armed) {
+        gpio_intr_disable(WATER_CUTOFF_GPIO);
+    }
+    if (pump_holds_rail) {
+        pump_holds_rail = false;
+        sensor_rail_release();
+#if CONFIG_PM_ENABLE
+        if (pump_pm_lock) {
+            esp_pm_lock_release(pump_pm_lock);
         }
-    } else {
-        ESP_LOGI(TAG, "I2C driver installed on port %d", I2C_PORT_NUM);
+#endif
     }
+}
 
-    i2c_ready = true;
-    return ESP_OK;
+bool sensors_pump_rail_hold(void)
+{
+    if (!device_identity_sensors_enabled()) {
+        return false;
+    }
+    sensor_rail_acquire();
+    sensor_rail_wait(SENSOR_POWER_ON_DELAY_MS);
+    return true;
 }
 
-static float soil_to_percent(uint16_t raw)
+void sensors_pump_rail_release(void)
 {
-    // Calibrated linear mapping: higher counts = drier soil.
-    const float dry = (float)SOIL_SENSOR_RAW_DRY;
-    const float wet = (float)SOIL_SENSOR_RAW_WET;
-    const float span = dry - wet;
+    sensor_rail_release();
+}
+
+void sensors_set_pump_state(bool on)
+{
+    // The cutoff float needs sensor power; keep it on for the whole run so the
+    // cutoff interrupt can stop the pump. The power-up wait happens before
+    // pump_mutex, so switching the pump off never waits behind a start.
+    bool guarded = on && sensors_pump_rail_hold();
+    xSemaphoreTake(pump_mutex, portMAX_DELAY);
+    if (guarded && !pump_holds_rail) {
+        sensor_rail_acquire();
+        pump_holds_rail = true;
+#if CONFIG_PM_ENABLE
+        if (pump_pm_lock) {
+            esp_pm_lock_acquire(pump_pm_lock);
+        }
+#endif
+    }
+    if (guarded && cutoff_monitor_armed) {
+        // Armed before the level check, so a float dropping in between is
+        // either seen here or trips the ISR
+        gpio_intr_enable(WATER_CUTOFF_GPIO);
+    }
 
-    if (span <= 0.0f) {
-        return 0.0f;
+    bool blocked = false;
+    taskENTER_CRITICAL(&pump_lock);
+    if (guarded && gpio_get_level(WATER_CUTOFF_GPIO) == 0) {
+        blocked = true;
+        on = false;
+    }
+    gpio_set_level(PUMP_GPIO, on ? 1 : 0);
+    bool changed = actuator_state_store(NODE_SCHEDULE_TARGET_PUMP, on);
+    taskEXIT_CRITICAL(&pump_lock);
+    if (changed) {
+        actuator_state_notify();
     }
 
-    float pct = ((dry - (float)raw) / span) * 100.0f;
-    if (pct < 0.0f) {
-        pct = 0.0f;
-    } else if (pct > 100.0f) {
-        pct = 100.0f;
+    if (!on) {
+        release_pump_run();
+    }
+    xSemaphoreGive(pump_mutex);
+    if (guarded) {
+        sensor_rail_release();  // the run holds its own reference
+    }
+    if (blocked) {
+        ESP_LOGW(TAG, "Pump ON blocked: cutoff float is LOW");
     }
-    return pct;
 }
 
-void sensors_set_pump_state(bool on)
+bool sensors_get_pump_state(void)
+{
+    return actuator_state_is_on(actuator_state_snapshot(), NODE_SCHEDULE_TARGET_PUMP);
+}
+
+// Stops the pump in the ISR itself; GPIO control is kept in IRAM
+// (CONFIG_GPIO_CTRL_FUNC_IN_IRAM) so this also runs during flash writes
+static void IRAM_ATTR water_cutoff_isr(void *arg)
 {
-    // If turning ON, ensure cutoff float is not low; floats need sensor power
-    if (on && device_identity_sensors_enabled()) {
-        int prev = gpio_get_level(SENSOR_EN_GPIO);
-        if (prev == 0) {
-            gpio_set_level(SENSOR_EN_GPIO, 1);
-            vTaskDelay(pdMS_TO_TICKS(SENSOR_POWER_ON_DELAY_MS));
+    (void)arg;
+    bool tripped = false;
+    portENTER_CRITICAL_ISR(&pump_lock);
+    if (actuator_state_is_on(actuator_state_snapshot(), NODE_SCHEDULE_TARGET_PUMP)) {
+        gpio_set_level(PUMP_GPIO, 0);
+        tripped = actuator_state_store(NODE_SCHEDULE_TARGET_PUMP, false);
+    }
+    portEXIT_CRITICAL_ISR(&pump_lock);
+    if (!tripped) {
+        return;
+    }
+    cutoff_trip_us = esp_timer_get_time();
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(cutoff_task_handle, &woken);
+    actuator_state_notify_from_isr(&woken);
+    if (woken == pdTRUE) {
+        portYIELD_FROM_ISR();
+    }
+}
+
+// Bookkeeping after a trip: rail, interrupt and the status callback
+static void water_cutoff_task(void *arg)
+{
+    (void)arg;
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        int64_t handled_us = esp_timer_get_time() - cutoff_trip_us;
+        xSemaphoreTake(pump_mutex, portMAX_DELAY);
+        if (!sensors_get_pump_state()) {
+            release_pump_run();
         }
-        bool cutoff_low = (gpio_get_level(WATER_CUTOFF_GPIO) == 0);
-        if (prev == 0) {
-            gpio_set_level(SENSOR_EN_GPIO, 0);
+        xSemaphoreGive(pump_mutex);
+        ESP_LOGW(TAG, "Cutoff float low -> pump stopped by interrupt (handled %lld us later)", (long long)handled_us);
+        if (cutoff_handler) {
+            cutoff_handler();
         }
-        if (cutoff_low) {
-            ESP_LOGW(TAG, "Pump ON blocked: cutoff float is LOW");
-            on = false;
+    }
+}
+
+int64_t sensors_last_cutoff_us(void)
+{
+    return cutoff_trip_us;
+}
+
+esp_err_t sensors_start_cutoff_monitor(sensors_cutoff_cb_t on_cutoff)
+{
+    if (cutoff_monitor_armed) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    cutoff_handler = on_cutoff;
+#if CONFIG_PM_ENABLE
+    esp_err_t pm_err = esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "pump", &pump_pm_lock);
+    if (pm_err != ESP_OK && pm_err != ESP_ERR_NOT_SUPPORTED) {
+        ESP_LOGW(TAG, "Pump PM lock failed: %s", esp_err_to_name(pm_err));
+    }
+#endif
+
+    cutoff_task_handle = xTaskCreateStaticPinnedToCore(water_cutoff_task, "cutoff_task", CUTOFF_TASK_STACK, NULL,
+                                                       CUTOFF_TASK_PRIORITY, cutoff_task_stack, &cutoff_task_tcb,
+                                                       CONTROL_CORE);
+    esp_err_t err = gpio_set_intr_type(WATER_CUTOFF_GPIO, GPIO_INTR_NEGEDGE);
+    if (err == ESP_OK) {
+        err = gpio_intr_disable(WATER_CUTOFF_GPIO);  // enabled per pump run
+    }
+    if (err == ESP_OK) {
+        err = gpio_install_isr_service(GPIO_ISR_FLAGS);
+        if (err == ESP_ERR_INVALID_STATE) {
+            err = ESP_OK;
         }
     }
-    gpio_set_level(PUMP_GPIO, on ? 1 : 0);
-    pump_state = on;
+    if (err == ESP_OK) {
+        err = gpio_isr_handler_add(WATER_CUTOFF_GPIO, water_cutoff_isr, NULL);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Cutoff interrupt setup failed: %s", esp_err_to_name(err));
+        vTaskDelete(cutoff_task_handle);
+        cutoff_task_handle = NULL;
+        return err;
+    }
+
+    xSemaphoreTake(pump_mutex, portMAX_DELAY);
+    cutoff_monitor_armed = true;
+    if (sensors_get_pump_state() && pump_holds_rail) {
+        gpio_intr_enable(WATER_CUTOFF_GPIO);
+    }
+    xSemaphoreGive(pump_mutex);
+    ESP_LOGI(TAG, "Water cutoff interrupt on GPIO %d", (int)WATER_CUTOFF_GPIO);
+    return ESP_OK;
 }
 
-bool sensors_get_pump_state(void)
+// Switch an output and record it; GPIO_NUM_NC only records (the latching
+// valve holds its state without a drive level)
+static void set_output(gpio_num_t gpio, node_schedule_target_t target, bool on)
 {
-    return pump_state;
+    taskENTER_CRITICAL(&output_lock);
+    if (gpio >= 0) {
+        gpio_set_level(gpio, on ? 1 : 0);
+    }
+    bool changed = actuator_state_store(target, on);
+    taskEXIT_CRITICAL(&output_lock);
+    if (changed) {
+        actuator_state_notify();
+    }
 }
 
 void sensors_set_ic_zone1_state(bool on)
 {
-    ic_zone1_state = on;
+    set_output(GPIO_NUM_NC, NODE_SCHEDULE_TARGET_IC_ZONE1, on);
 }
 
 bool sensors_get_ic_zone1_state(void)
 {
-    return ic_zone1_state;
+    return actuator_state_is_on(actuator_state_snapshot(), NODE_SCHEDULE_TARGET_IC_ZONE1);
 }
 
 void sensors_pulse_ic_zone1(bool forward, uint32_t pulse_ms)
@@ -140,39 +329,40 @@ void sensors_pulse_ic_zone1(bool forward, uint32_t pulse_ms)
 }
 void sensors_set_fan_state(bool on)
 {
-    gpio_set_level(FAN_GPIO, on ? 1 : 0);
-    fan_state = on;
+    set_output(FAN_GPIO, NODE_SCHEDULE_TARGET_FAN, on);
 }
 
 bool sensors_get_fan_state(void)
 {
-    return fan_state;
+    return actuator_state_is_on(actuator_state_snapshot(), NODE_SCHEDULE_TARGET_FAN);
 }
 
 void sensors_set_mister_state(bool on)
 {
-    gpio_set_level(MISTER_GPIO, on ? 1 : 0);
-    mister_state = on;
+    set_output(MISTER_GPIO, NODE_SCHEDULE_TARGET_MISTER, on);
 }
 
 bool sensors_get_mister_state(void)
 {
-    return mister_state;
+    return actuator_state_is_on(actuator_state_snapshot(), NODE_SCHEDULE_TARGET_MISTER);
 }
 
 void sensors_set_light_state(bool on)
 {
-    gpio_set_level(LIGHT_GPIO, on ? 1 : 0);
-    light_state = on;
+    set_output(LIGHT_GPIO, NODE_SCHEDULE_TARGET_LIGHT, on);
 }
 
 bool sensors_get_light_state(void)
 {
-    return light_state;
+    return actuator_state_is_on(actuator_state_snapshot(), NODE_SCHEDULE_TARGET_LIGHT);
 }
 
-void sensors_init(void)
+void sensors_init_outputs(void)
 {
+    if (!pump_mutex) {
+        pump_mutex = xSemaphoreCreateMutexStatic(&pump_mutex_buf);
+        collect_mutex = xSemaphoreCreateMutexStatic(&collect_mutex_buf);
+    }
     uint64_t pump_mask = BIT64(PUMP_GPIO);
     gpio_config_t pump_cfg = {
         .pin_bit_mask = pump_mask,
@@ -246,121 +436,180 @@ void sensors_init(void)
         .intr_type = GPIO_INTR_DISABLE,
     };
     gpio_config(&float_cfg);
+}
 
+void sensors_init_bus(void)
+{
     if (ensure_i2c_bus() != ESP_OK) {
         ESP_LOGE(TAG, "I2C bus init failed; sensors unavailable");
         return;
     }
 
     // Power sensors to initialize I2C devices
-    gpio_set_level(SENSOR_EN_GPIO, 1);
-    vTaskDelay(pdMS_TO_TICKS(SENSOR_POWER_ON_DELAY_MS));
+    sensor_rail_acquire();
+    sensor_rail_wait(SENSOR_POWER_ON_DELAY_MS);
 
-    esp_err_t err = aht10_init(I2C_PORT_NUM, I2C_SDA_GPIO, I2C_SCL_GPIO);
+    esp_err_t err = th_sensor_detect();
     if (err != ESP_OK) {
-        ESP_LOGW(TAG, "AHT10 init failed: %s", esp_err_to_name(err));
+        ESP_LOGW(TAG, "No temperature/humidity sensor found: %s", esp_err_to_name(err));
     }
-    err = ads1115_init(I2C_PORT_NUM, I2C_SDA_GPIO, I2C_SCL_GPIO);
+    err = ads1115_init();
     if (err != ESP_OK) {
         ESP_LOGW(TAG, "ADS1115 init failed: %s", esp_err_to_name(err));
     }
+    err = ads1115_set_ready_gpio(ADS1115_ALERT_RDY_GPIO);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "ADS1115 ALERT/RDY setup failed, polling instead: %s", esp_err_to_name(err));
+    }
 
-    // Optionally power sensors back off after init
-    gpio_set_level(SENSOR_EN_GPIO, 0);
+    // Power sensors back off after init (unless a pump run holds the rail)
+    sensor_rail_release();
 }
 
-void sensors_collect(sensor_reading_t *out)
+void sensors_init(void)
 {
+    sensors_init_outputs();
+    sensors_init_bus();
+}
+
+static void fill_output_states(sensor_reading_t *out)
+{
+    // One load, so a reading never shows half of a change
+    actuator_state_t state = actuator_state_snapshot();
+    out->pump_is_on = actuator_state_is_on(state, NODE_SCHEDULE_TARGET_PUMP);
+    out->ic_zone1_is_on = actuator_state_is_on(state, NODE_SCHEDULE_TARGET_IC_ZONE1);
+    out->fan_is_on = actuator_state_is_on(state, NODE_SCHEDULE_TARGET_FAN);
+    out->mister_is_on = actuator_state_is_on(state, NODE_SCHEDULE_TARGET_MISTER);
+    out->light_is_on = actuator_state_is_on(state, NODE_SCHEDULE_TARGET_LIGHT);
+}
+
+static uint64_t reading_timestamp_ms(void)
+{
+    uint64_t timestamp_ms = esp_timer_get_time() / 1000ULL;
+    if (time_sync_is_time_valid()) {
+        struct timeval now;
+        if (gettimeofday(&now, NULL) == 0) {
+            timestamp_ms = ((uint64_t)now.tv_sec * 1000ULL) + ((uint64_t)now.tv_usec / 1000ULL);
+        }
+    }
+    return timestamp_ms;
+}
+
+void sensors_collect_start(void)
+{
+    xSemaphoreTake(collect_mutex, portMAX_DELAY);
+    if (!device_identity_sensors_enabled()) {
+        acquisition = ACQ_SENSORS_DISABLED;
+        return;
+    }
+    if (!i2c_ready && ensure_i2c_bus() != ESP_OK) {
+        ESP_LOGE(TAG, "I2C bus unavailable during collection");
+        acquisition = ACQ_BUS_DOWN;
+        return;
+    }
+    // A running pump may already have the rail up and settled
+    sensor_rail_acquire();
+    acquisition = ACQ_POWERED;
+}
+
+void sensors_collect_complete(sensor_reading_t *out)
+{
+    if (acquisition == ACQ_IDLE) {
+        ESP_LOGW(TAG, "sensors_collect_complete() without sensors_collect_start()");
+        return;
+    }
+    acquisition_state_t state = acquisition;
+    acquisition = ACQ_IDLE;
     if (!out) {
+        if (state == ACQ_POWERED) {
+            sensor_rail_release();
+        }
+        xSemaphoreGive(collect_mutex);
         return;
     }
+    // One acquisition is one sample; sensor_window_finish() fills the spreads
+    out->window_samples = 0;
 
-    if (!device_identity_sensors_enabled()) {
+    if (state == ACQ_SENSORS_DISABLED) {
         out->soil_raw = 0;
         out->soil_percent = 0.0f;
         out->temperature_c = NAN;
         out->humidity_pct = NAN;
+        out->battery_v = NAN;
         out->water_low = false;
         out->water_cutoff = false;
-        out->pump_is_on = sensors_get_pump_state();
-        out->ic_zone1_is_on = sensors_get_ic_zone1_state();
-        out->fan_is_on = sensors_get_fan_state();
-        out->mister_is_on = sensors_get_mister_state();
-        out->light_is_on = sensors_get_light_state();
-
-        uint64_t timestamp_ms = esp_timer_get_time() / 1000ULL;
-        if (time_sync_is_time_valid()) {
-            struct timeval now;
-            if (gettimeofday(&now, NULL) == 0) {
-                timestamp_ms = ((uint64_t)now.tv_sec * 1000ULL) + ((uint64_t)now.tv_usec / 1000ULL);
-            }
-        }
-        out->timestamp_ms = timestamp_ms;
-        gpio_set_level(SENSOR_EN_GPIO, 0);
+        fill_output_states(out);
+        out->timestamp_ms = reading_timestamp_ms();
+        xSemaphoreGive(collect_mutex);
         return;
     }
-
-    if (!i2c_ready && ensure_i2c_bus() != ESP_OK) {
-        ESP_LOGE(TAG, "I2C bus unavailable during collection");
+    if (state == ACQ_BUS_DOWN) {
         memset(out, 0, sizeof(*out));
         out->temperature_c = NAN;
         out->humidity_pct = NAN;
-        out->pump_is_on = sensors_get_pump_state();
-        out->ic_zone1_is_on = sensors_get_ic_zone1_state();
-        out->fan_is_on = sensors_get_fan_state();
-        out->mister_is_on = sensors_get_mister_state();
-        out->light_is_on = sensors_get_light_state();
+        out->battery_v = NAN;
+        fill_output_states(out);
+        xSemaphoreGive(collect_mutex);
         return;
     }
 
-    // Power sensors
-    gpio_set_level(SENSOR_EN_GPIO, 1);
-    vTaskDelay(pdMS_TO_TICKS(SENSOR_POWER_ON_DELAY_MS + 50)); // extra margin for ADC settling
-
-    // Soil moisture via ADS1115 (AIN0)
-    int32_t acc = 0;
-    int valid_samples = 0;
-    for (int i = 0; i < SOIL_SAMPLES; ++i) {
-        int16_t sample = 0;
-        esp_err_t err = ads1115_read_single_ended(SOIL_ADC_CHANNEL, ADS1115_PGA_4096, &sample);
-        if (err != ESP_OK) {
-            ESP_LOGW(TAG, "ADS1115 read failed (sample %d/%d): %s", i + 1, SOIL_SAMPLES, esp_err_to_name(err));
-            vTaskDelay(pdMS_TO_TICKS(20)); // back off before retry
-            continue;
+    // The T/RH sensor only needs the I2C rail up, and then converts on its own
+    // for conversion_ms; start it before the ADC settling margin so the
+    // conversion runs behind the settle wait and the ADS1115 scan
+    sensor_rail_wait(SENSOR_POWER_ON_DELAY_MS);
+    const th_sensor_driver_t *th = th_sensor_active();
+    esp_err_t th_err = th ? th->trigger() : ESP_ERR_NOT_FOUND;
+    if (th && th_err != ESP_OK) {
+        ESP_LOGW(TAG, "%s trigger failed: %s", th->name, esp_err_to_name(th_err));
+    }
+    sensor_rail_wait(SENSOR_POWER_ON_DELAY_MS + SENSOR_ADC_SETTLE_MS);
+
+    // Soil + battery via ADS1115 in one pass while sensors are powered
+    static const ads1115_scan_channel_t scan_channels[] = {
+        { .channel = SOIL_ADC_CHANNEL, .pga = ADS1115_PGA_4096, .samples = SOIL_SAMPLES },
+        { .channel = BATTERY_ADC_CHANNEL, .pga = ADS1115_PGA_2048, .samples = BATTERY_SAMPLES },
+    };
+    int16_t samples[SOIL_SAMPLES + BATTERY_SAMPLES];
+    size_t valid[2] = {0};
+    esp_err_t adc_err = ads1115_scan(scan_channels, 2, SOIL_ADC_DATA_RATE, samples, valid);
+    if (adc_err != ESP_OK) {
+        ESP_LOGW(TAG, "ADS1115 scan failed: %s", esp_err_to_name(adc_err));
+    }
+
+    uint16_t soil_raw = 0;
+    size_t soil_kept = soil_filter_counts(samples, valid[0], &soil_raw);
+
+    out->battery_v = NAN;
+    if (valid[1] > 0) {
+        size_t n = valid[1];
+        int32_t bat_acc = 0;
+        for (size_t i = 0; i < n; ++i) {
+            int16_t v = samples[SOIL_SAMPLES + i];
+            bat_acc += v < 0 ? 0 : v;
         }
-        if (sample < 0) sample = 0; // single-ended should be >= 0
-        acc += sample;
-        valid_samples++;
-        vTaskDelay(pdMS_TO_TICKS(5));
+        float v_adc = ads1115_counts_to_volts((int16_t)(bat_acc / (int32_t)n), ADS1115_PGA_2048);
+        out->battery_v = v_adc * BATTERY_DIVIDER_RATIO;
+        ESP_LOGD(TAG, "Battery: %u samples, %.3f V", (unsigned)n, out->battery_v);
     }
-    
-    if (valid_samples == 0) {
+
+    if (soil_kept == 0) {
         ESP_LOGE(TAG, "ADS1115: no valid samples collected");
         out->soil_raw = 0;
         out->soil_percent = 0.0f;
     } else {
-        out->soil_raw = (uint16_t)(acc / valid_samples);
-        out->soil_percent = soil_to_percent(out->soil_raw);
-        ESP_LOGD(TAG, "Soil: %d valid samples, raw=%u, percent=%.1f%%", valid_samples, out->soil_raw, out->soil_percent);
-        
-        // DEBUG
-        ESP_LOGI(TAG, "Soil moisture: %.1f%% (raw %u)", out->soil_percent, out->soil_raw);
-        if (out->soil_percent >= 50.0f) {
-            ESP_LOGI(TAG, "Soil moisture is above 50%% threshold");
-            esp_err_t err = put_char("test_var", '0');  // DEBUG: Chris
-            if (err != ESP_OK) {
-                ESP_LOGW(TAG, "Failed to set test_var: %s", esp_err_to_name(err));
-            }
-        }
+        out->soil_raw = soil_raw;
+        out->soil_percent = (float)soil_counts_to_centipercent(soil_raw) / 100.0f;
+        ESP_LOGD(TAG, "Soil: kept %u of %u samples, raw=%u, percent=%.1f%%",
+                 (unsigned)soil_kept, (unsigned)valid[0], out->soil_raw, out->soil_percent);
     }
 
     // Float switches (active-low); valid only when sensors are powered
     out->water_low = gpio_get_level(WATER_REFILL_GPIO) == 0;      // refill indicator
     out->water_cutoff = gpio_get_level(WATER_CUTOFF_GPIO) == 0;   // cutoff indicator
 
-    // Temperature/Humidity from AHT10
+    // Temperature/Humidity (waits only for what is left of the conversion)
     float t = NAN, rh = NAN;
-    if (aht10_read(&t, &rh) == ESP_OK) {
+    if (th_err == ESP_OK && th->fetch(&t, &rh) == ESP_OK) {
         out->temperature_c = t;
         out->humidity_pct = rh;
     } else {
@@ -368,26 +617,55 @@ void sensors_collect(sensor_reading_t *out)
         out->humidity_pct = NAN;
     }
 
-    // Safety: if pump is on and cutoff is low, turn pump off immediately
+    // Safety: if pump is on and cutoff is low, turn pump off immediately.
+    // The cutoff interrupt normally gets there first; this covers a missed edge.
     if (sensors_get_pump_state() && out->water_cutoff) {
         ESP_LOGW(TAG, "Cutoff float low -> turning pump OFF");
         sensors_set_pump_state(false);
     }
-    out->pump_is_on = sensors_get_pump_state();
-    out->ic_zone1_is_on = sensors_get_ic_zone1_state();
-    out->fan_is_on = sensors_get_fan_state();
-    out->mister_is_on = sensors_get_mister_state();
-    out->light_is_on = sensors_get_light_state();
+    fill_output_states(out);
+    out->timestamp_ms = reading_timestamp_ms();
 
-    uint64_t timestamp_ms = esp_timer_get_time() / 1000ULL;
-    if (time_sync_is_time_valid()) {
-        struct timeval now;
-        if (gettimeofday(&now, NULL) == 0) {
-            timestamp_ms = ((uint64_t)now.tv_sec * 1000ULL) + ((uint64_t)now.tv_usec / 1000ULL);
+    // Power sensors off
+    sensor_rail_release();
+    xSemaphoreGive(collect_mutex);
+}
+
+esp_err_t sensors_sample_soil(uint16_t *out_raw)
+{
+    if (!out_raw) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    xSemaphoreTake(collect_mutex, portMAX_DELAY);
+    if (!device_identity_sensors_enabled() || (!i2c_ready && ensure_i2c_bus() != ESP_OK)) {
+        xSemaphoreGive(collect_mutex);
+        return ESP_ERR_INVALID_STATE;
+    }
+    sensor_rail_acquire();
+    sensor_rail_wait(SENSOR_POWER_ON_DELAY_MS + SENSOR_ADC_SETTLE_MS);
+
+    int16_t samples[SOIL_SAMPLES];
+    size_t n = 0;
+    esp_err_t err = ads1115_continuous_start(SOIL_ADC_CHANNEL, ADS1115_PGA_4096, SOIL_ADC_DATA_RATE);
+    for (size_t i = 0; err == ESP_OK && i < SOIL_SAMPLES; ++i) {
+        if (ads1115_continuous_read(&samples[n]) == ESP_OK) {
+            n++;
         }
     }
-    out->timestamp_ms = timestamp_ms;
+    ads1115_continuous_stop();
+    sensor_rail_release();
+    xSemaphoreGive(collect_mutex);
 
-    // Power sensors off
-    gpio_set_level(SENSOR_EN_GPIO, 0);
+    if (err != ESP_OK) {
+        return err;
+    }
+    return soil_filter_counts(samples, n, out_raw) > 0 ? ESP_OK : ESP_ERR_INVALID_RESPONSE;
+}
+
+void sensors_collect(sensor_reading_t *out)
+{
+    int64_t t0 = latency_hist_start();
+    sensors_collect_start();
+    sensors_collect_complete(out);
+    latency_hist_record(LATENCY_STAGE_SENSOR_COLLECT, t0);
 }
@@ -3,12 +3,23 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+#include "esp_err.h"
+
+// Spread of one field over the fast samples behind a windowed reading; NAN
+// when the field had no valid sample (sensor_window.h)
+typedef struct {
+    float min;
+    float max;
+    float stddev;   // population
+} sensor_spread_t;
+
 typedef struct {
     uint64_t timestamp_ms;
     uint16_t soil_raw;
     float soil_percent;
     float temperature_c;
     float humidity_pct;
+    float battery_v;     // NAN when the divider could not be read
     bool water_low;      // Backwards-compatible: maps to refill float
     bool water_cutoff;   // New: cutoff float (active-low)
     bool pump_is_on;
@@ -16,12 +27,51 @@ typedef struct {
     bool fan_is_on;
     bool mister_is_on;
     bool light_is_on;
+    // Windowed readings carry the mean in soil_percent/temperature_c/
+    // humidity_pct and the spread here; window_samples <= 1 is a single sample
+    // and the spreads are unset. Not kept in the offline ring.
+    uint16_t window_samples;
+    sensor_spread_t soil_spread;
+    sensor_spread_t temperature_spread;
+    sensor_spread_t humidity_spread;
 } sensor_reading_t;
 
+// sensors_init() = sensors_init_outputs() + sensors_init_bus(). The output
+// half only configures GPIOs; the bus half powers the sensor rail, waits
+// SENSOR_POWER_ON_DELAY_MS and probes the I2C devices, so boot code can run
+// it off the critical path. Call sensors_collect() only after it.
 void sensors_init(void);
+void sensors_init_outputs(void);
+void sensors_init_bus(void);
 void sensors_collect(sensor_reading_t *out);
+// sensors_collect() in two phases. start powers the sensor rail and returns;
+// complete waits out whatever is left of the settle time, triggers the T/RH
+// conversion, samples the ADS1115 while it runs, reads it back and powers the
+// rail down. Work done between the two calls overlaps the power-up wait.
+// Acquisitions are serialized: start blocks while another one is in flight.
+void sensors_collect_start(void);
+void sensors_collect_complete(sensor_reading_t *out);
 void sensors_set_pump_state(bool on);
 bool sensors_get_pump_state(void);
+// Powers the sensor rail and waits out SENSOR_POWER_ON_DELAY_MS, so a pump
+// start made while the hold lasts does not wait for the rail. Lets a caller
+// settle it before taking its own locks. False (nothing held) when sensors are
+// disabled and a pump run needs no rail; otherwise pair with the release.
+bool sensors_pump_rail_hold(void);
+void sensors_pump_rail_release(void);
+
+// Runs on the cutoff task after the ISR has stopped the pump; keep it short
+typedef void (*sensors_cutoff_cb_t)(void);
+// While the pump runs, the sensor rail stays powered and a falling edge on
+// WATER_CUTOFF_GPIO switches the pump off from the ISR. Call after
+// sensors_init_outputs().
+esp_err_t sensors_start_cutoff_monitor(sensors_cutoff_cb_t on_cutoff);
+// esp_timer time of the last cutoff interrupt trip, 0 if none since boot
+int64_t sensors_last_cutoff_us(void);
+// Closed-loop watering: one short ADS1115 continuous-mode burst on the soil
+// channel, reduced by soil_filter_counts(). Waits for a running acquisition;
+// free of the power-up wait while a pump run holds the rail.
+esp_err_t sensors_sample_soil(uint16_t *out_raw);
 void sensors_set_ic_zone1_state(bool on);
 bool sensors_get_ic_zone1_state(void);
 void sensors_pulse_ic_zone1(bool forward, uint32_t pulse_ms);
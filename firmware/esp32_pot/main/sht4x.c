@@ -1,17 +1,30 @@
 #include "sht4x.h"
 
+#include <stdbool.h>
+
 #include "esp_log.h"
 #include "esp_err.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 
+#include "i2c_bus.h"
+
 #define SHT4X_I2C_ADDRESS 0x44
+#if CONFIG_PROJECTPLANT_SHT4X_REPEATABILITY_LOW
+#define SHT4X_MEASURE_CMD 0xE0
+#elif CONFIG_PROJECTPLANT_SHT4X_REPEATABILITY_MEDIUM
+#define SHT4X_MEASURE_CMD 0xF6
+#else
 #define SHT4X_MEASURE_CMD 0xFD
+#endif
 #define SHT4X_SOFT_RESET_CMD 0x94
+#define SHT4X_XFER_TIMEOUT_MS 50
 
 static const char *TAG = "sht4x";
-static bool driver_installed = false;
-static i2c_port_t active_port = I2C_NUM_0;
+static i2c_master_dev_handle_t dev = NULL;
+static int64_t triggered_us = 0;
+static bool triggered = false;
 
 static uint8_t crc8(const uint8_t *data)
 {
@@ -32,36 +45,18 @@ static uint8_t crc8(const uint8_t *data)
 static esp_err_t sht4x_soft_reset(void)
 {
     uint8_t cmd = SHT4X_SOFT_RESET_CMD;
-    return i2c_master_write_to_device(active_port, SHT4X_I2C_ADDRESS, &cmd, sizeof(cmd), pdMS_TO_TICKS(50));
+    return i2c_bus_transmit(dev, &cmd, sizeof(cmd), SHT4X_XFER_TIMEOUT_MS);
 }
 
-esp_err_t sht4x_init(i2c_port_t port, gpio_num_t sda_gpio, gpio_num_t scl_gpio)
+esp_err_t sht4x_init(void)
 {
-    active_port = port;
-
-    i2c_config_t conf = {
-        .mode = I2C_MODE_MASTER,
-        .sda_io_num = sda_gpio,
-        .scl_io_num = scl_gpio,
-        .sda_pullup_en = GPIO_PULLUP_ENABLE,
-        .scl_pullup_en = GPIO_PULLUP_ENABLE,
-        .master.clk_speed = 100000,
-        .clk_flags = 0,
-    };
-
-    esp_err_t err = i2c_param_config(port, &conf);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "i2c_param_config failed: %s", esp_err_to_name(err));
-        return err;
-    }
-
-    if (!driver_installed) {
-        err = i2c_driver_install(port, conf.mode, 0, 0, 0);
-        if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) {
-            ESP_LOGE(TAG, "i2c_driver_install failed: %s", esp_err_to_name(err));
+    esp_err_t err = ESP_OK;
+    if (!dev) {
+        err = i2c_bus_add_device(SHT4X_I2C_ADDRESS, &dev);
+        if (err != ESP_OK) {
+            dev = NULL;
             return err;
         }
-        driver_installed = true;
     }
 
     err = sht4x_soft_reset();
@@ -73,19 +68,34 @@ esp_err_t sht4x_init(i2c_port_t port, gpio_num_t sda_gpio, gpio_num_t scl_gpio)
     return ESP_OK;
 }
 
-esp_err_t sht4x_read(float *temperature_c, float *humidity_pct)
+esp_err_t sht4x_trigger(void)
 {
+    if (!dev) {
+        return ESP_ERR_INVALID_STATE;
+    }
     uint8_t cmd = SHT4X_MEASURE_CMD;
-    esp_err_t err = i2c_master_write_to_device(active_port, SHT4X_I2C_ADDRESS, &cmd, sizeof(cmd), pdMS_TO_TICKS(50));
+    esp_err_t err = i2c_bus_transmit(dev, &cmd, sizeof(cmd), SHT4X_XFER_TIMEOUT_MS);
+    triggered = err == ESP_OK;
+    triggered_us = esp_timer_get_time();
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "Failed to start measurement: %s", esp_err_to_name(err));
-        return err;
     }
+    return err;
+}
 
-    vTaskDelay(pdMS_TO_TICKS(12));
+esp_err_t sht4x_fetch(float *temperature_c, float *humidity_pct)
+{
+    if (!triggered) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    triggered = false;
+    int64_t left_us = (int64_t)SHT4X_MEASURE_MS * 1000 - (esp_timer_get_time() - triggered_us);
+    if (left_us > 0) {
+        vTaskDelay(pdMS_TO_TICKS((left_us + 999) / 1000) + 1);
+    }
 
     uint8_t raw[6] = {0};
-    err = i2c_master_read_from_device(active_port, SHT4X_I2C_ADDRESS, raw, sizeof(raw), pdMS_TO_TICKS(50));
+    esp_err_t err = i2c_bus_receive(dev, raw, sizeof(raw), SHT4X_XFER_TIMEOUT_MS);
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "Failed to read data: %s", esp_err_to_name(err));
         return err;
@@ -115,3 +125,21 @@ esp_err_t sht4x_read(float *temperature_c, float *humidity_pct)
     }
     return ESP_OK;
 }
+
+esp_err_t sht4x_read(float *temperature_c, float *humidity_pct)
+{
+    esp_err_t err = sht4x_trigger();
+    if (err != ESP_OK) {
+        return err;
+    }
+    return sht4x_fetch(temperature_c, humidity_pct);
+}
+
+const th_sensor_driver_t sht4x_driver = {
+    .name = "SHT4x",
+    .address = SHT4X_I2C_ADDRESS,
+    .conversion_ms = SHT4X_MEASURE_MS,
+    .init = sht4x_init,
+    .trigger = sht4x_trigger,
+    .fetch = sht4x_fetch,
+};
@@ -1,8 +1,26 @@
 #pragma once
 
-#include "driver/gpio.h"
-#include "driver/i2c.h"
 #include "esp_err.h"
+#include "sdkconfig.h"
 
-esp_err_t sht4x_init(i2c_port_t port, gpio_num_t sda_gpio, gpio_num_t scl_gpio);
+#include "th_sensor.h"
+
+// Call after i2c_bus_init()
+esp_err_t sht4x_init(void);
 esp_err_t sht4x_read(float *temperature_c, float *humidity_pct);
+
+// Split read, as for the AHT10: sht4x_fetch() waits only for what is left of
+// SHT4X_MEASURE_MS since the trigger. The repeatability is a Kconfig choice
+// (datasheet maximum durations: 8.3, 4.5 and 1.6 ms).
+#if CONFIG_PROJECTPLANT_SHT4X_REPEATABILITY_LOW
+#define SHT4X_MEASURE_MS 2
+#elif CONFIG_PROJECTPLANT_SHT4X_REPEATABILITY_MEDIUM
+#define SHT4X_MEASURE_MS 5
+#else
+#define SHT4X_MEASURE_MS 9
+#endif
+esp_err_t sht4x_trigger(void);
+esp_err_t sht4x_fetch(float *temperature_c, float *humidity_pct);
+
+// The functions above as a th_sensor driver
+extern const th_sensor_driver_t sht4x_driver;
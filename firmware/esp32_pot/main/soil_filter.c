@@ -0,0 +1,173 @@
+#include "soil_filter.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_crc.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+
+#include "hardware_config.h"
+#include "preferences.h"
+
+#define SOIL_CAL_NAMESPACE "device"
+#define SOIL_CAL_KEY "soil_cal"
+#define SOIL_CAL_VERSION 1
+
+static const char *TAG = "soil_filter";
+
+typedef struct {
+    uint8_t version;
+    uint8_t reserved[3];
+    soil_calibration_t cal;
+    uint32_t crc32;  // esp_crc32_le over every byte before this field
+} soil_cal_blob_t;
+
+static soil_calibration_t calibration = {
+    .raw_dry = SOIL_SENSOR_RAW_DRY,
+    .raw_wet = SOIL_SENSOR_RAW_WET,
+};
+static portMUX_TYPE cal_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static uint32_t blob_crc(const soil_cal_blob_t *blob)
+{
+    return esp_crc32_le(0, (const uint8_t *)blob, offsetof(soil_cal_blob_t, crc32));
+}
+
+static bool calibration_valid(const soil_calibration_t *cal)
+{
+    return abs((int32_t)cal->raw_dry - (int32_t)cal->raw_wet) >= SOIL_CALIBRATION_MIN_SPAN;
+}
+
+void soil_filter_init(void)
+{
+    soil_cal_blob_t blob;
+    size_t len = sizeof(blob);
+    esp_err_t err = prefs_get_blob(SOIL_CAL_NAMESPACE, SOIL_CAL_KEY, &blob, &len);
+    if (err == ESP_ERR_NVS_NOT_FOUND) {
+        return;
+    }
+    if (err != ESP_OK ||
+        len != sizeof(blob) ||
+        blob.version != SOIL_CAL_VERSION ||
+        blob.crc32 != blob_crc(&blob) ||
+        !calibration_valid(&blob.cal)) {
+        ESP_LOGW(TAG, "Stored soil calibration unusable (%s); using defaults", esp_err_to_name(err));
+        return;
+    }
+    taskENTER_CRITICAL(&cal_lock);
+    calibration = blob.cal;
+    taskEXIT_CRITICAL(&cal_lock);
+    ESP_LOGI(TAG, "Soil calibration: dry %u, wet %u counts",
+             (unsigned)blob.cal.raw_dry, (unsigned)blob.cal.raw_wet);
+}
+
+void soil_calibration_get(soil_calibration_t *out)
+{
+    if (!out) {
+        return;
+    }
+    taskENTER_CRITICAL(&cal_lock);
+    *out = calibration;
+    taskEXIT_CRITICAL(&cal_lock);
+}
+
+esp_err_t soil_calibration_set(const soil_calibration_t *cal)
+{
+    if (!cal || !calibration_valid(cal)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    soil_cal_blob_t blob;
+    memset(&blob, 0, sizeof(blob));
+    blob.version = SOIL_CAL_VERSION;
+    blob.cal = *cal;
+    blob.crc32 = blob_crc(&blob);
+    esp_err_t err = prefs_defer_blob(SOIL_CAL_NAMESPACE, SOIL_CAL_KEY, &blob, sizeof(blob));
+    if (err != ESP_OK) {
+        return err;
+    }
+    taskENTER_CRITICAL(&cal_lock);
+    calibration = *cal;
+    taskEXIT_CRITICAL(&cal_lock);
+    return ESP_OK;
+}
+
+// n is at most SOIL_SAMPLES; insertion sort beats anything cleverer here
+static void sort_counts(int32_t *v, size_t n)
+{
+    for (size_t i = 1; i < n; ++i) {
+        int32_t x = v[i];
+        size_t j = i;
+        while (j > 0 && v[j - 1] > x) {
+            v[j] = v[j - 1];
+            --j;
+        }
+        v[j] = x;
+    }
+}
+
+static int32_t sorted_median(const int32_t *v, size_t n)
+{
+    return n % 2 ? v[n / 2] : (v[n / 2 - 1] + v[n / 2] + 1) / 2;
+}
+
+size_t soil_filter_counts(const int16_t *samples, size_t n, uint16_t *out_raw)
+{
+    if (!samples || !out_raw || n == 0) {
+        return 0;
+    }
+    if (n > SOIL_SAMPLES) {
+        n = SOIL_SAMPLES;
+    }
+
+    int32_t v[SOIL_SAMPLES];
+    for (size_t i = 0; i < n; ++i) {
+        v[i] = samples[i] < 0 ? 0 : samples[i];   // single-ended should be >= 0
+    }
+    sort_counts(v, n);
+    int32_t median = sorted_median(v, n);
+
+    int32_t dev[SOIL_SAMPLES];
+    for (size_t i = 0; i < n; ++i) {
+        dev[i] = abs(v[i] - median);
+    }
+    sort_counts(dev, n);
+    // A floor on the band keeps a quiet probe from rejecting its own LSB noise
+    int32_t band = sorted_median(dev, n) * SOIL_FILTER_MAD_K;
+    if (band < SOIL_FILTER_MIN_BAND) {
+        band = SOIL_FILTER_MIN_BAND;
+    }
+
+    int32_t acc = 0;
+    size_t kept = 0;
+    for (size_t i = 0; i < n; ++i) {
+        if (abs(v[i] - median) <= band) {
+            acc += v[i];
+            kept++;
+        }
+    }
+    if (kept == 0) {
+        // Cannot happen for K >= 1 (a middle sample is within the band); be safe
+        *out_raw = (uint16_t)median;
+        return 1;
+    }
+    *out_raw = (uint16_t)((acc + (int32_t)kept / 2) / (int32_t)kept);
+    return kept;
+}
+
+uint16_t soil_counts_to_centipercent(uint16_t raw)
+{
+    soil_calibration_t cal;
+    soil_calibration_get(&cal);
+    int32_t span = (int32_t)cal.raw_dry - (int32_t)cal.raw_wet;
+    if (span == 0) {
+        return 0;
+    }
+    // Signed span handles both probe orientations; round half away from zero
+    int32_t num = ((int32_t)cal.raw_dry - (int32_t)raw) * 10000;
+    if ((num < 0) != (span < 0)) {
+        return 0;
+    }
+    int32_t centi = (abs(num) + abs(span) / 2) / abs(span);
+    return (uint16_t)(centi > 10000 ? 10000 : centi);
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+// Soil probe conditioning, all in integer ADS1115 counts. A burst of
+// conversions is reduced to its median, samples further than
+// SOIL_FILTER_MAD_K median absolute deviations from it (an I2C glitch, a
+// pump switching transient) are dropped, and the rest are averaged. That
+// holds up with a handful of conversions where a plain mean needs many.
+//
+// Counts map to percent through a per-device two-point calibration kept in
+// NVS; SOIL_SENSOR_RAW_DRY/WET from hardware_config.h are the defaults.
+// Either orientation works (wet above or below dry).
+
+typedef struct {
+    uint16_t raw_dry;   // counts in completely dry soil = 0 %
+    uint16_t raw_wet;   // counts in waterlogged soil = 100 %
+} soil_calibration_t;
+
+// Minimum |raw_dry - raw_wet| soil_calibration_set() accepts
+#define SOIL_CALIBRATION_MIN_SPAN 100
+
+// Loads the stored calibration; call after prefs_init()
+void soil_filter_init(void);
+void soil_calibration_get(soil_calibration_t *out);
+// ESP_ERR_INVALID_ARG when the span is below SOIL_CALIBRATION_MIN_SPAN.
+// The write is deferred like other prefs.
+esp_err_t soil_calibration_set(const soil_calibration_t *cal);
+
+// Filters up to SOIL_SAMPLES single-ended conversions (negative ones count
+// as 0) into *out_raw. Returns how many samples were kept; 0 when n is 0.
+size_t soil_filter_counts(const int16_t *samples, size_t n, uint16_t *out_raw);
+
+// Hundredths of a percent, clamped to 0..10000
+uint16_t soil_counts_to_centipercent(uint16_t raw);
@@ -8,9 +8,11 @@
 
 #include "cJSON.h"
 #include "esp_event.h"
+#include "esp_heap_caps.h"
 #include "esp_log.h"
 #include "esp_mac.h"
 #include "esp_netif.h"
+#include "esp_timer.h"
 #include "esp_wifi.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/event_groups.h"
@@ -19,13 +21,16 @@
 #include "wifi_provisioning/manager.h"
 
 #if CONFIG_BT_ENABLED
+#include "esp_bt.h"
 #include "protocomm_ble.h"
 #include "wifi_provisioning/scheme_ble.h"
 #else
 #include "wifi_provisioning/scheme_softap.h"
 #endif
 
+#include "hardware_config.h"
 #include "preferences.h"
+#include "wifi_fast_connect.h"
 
 #define ONBOARD_NAMESPACE "onboard"
 #define ONBOARD_KEY_COMPLETE "complete"
@@ -39,14 +44,16 @@
 
 static const char *TAG = "startup_onboarding";
 
+static StaticEventGroup_t wifi_event_group_buf;
 static EventGroupHandle_t wifi_event_group = NULL;
 static int retry_count = 0;
 static bool handlers_registered = false;
 static bool wifi_stack_initialized = false;
-static bool sta_netif_created = false;
+static esp_netif_t *sta_netif = NULL;
 #if !CONFIG_BT_ENABLED
-static bool ap_netif_created = false;
+static esp_netif_t *ap_netif = NULL;
 #endif
+static bool provisioning_released = false;
 
 static char mqtt_uri_state[STARTUP_MQTT_URI_MAX_LEN];
 static char hub_url_state[STARTUP_HUB_URL_MAX_LEN];
@@ -69,24 +76,38 @@ static void safe_copy(char *out, size_t out_len, const char *value)
     out[out_len - 1] = '\0';
 }
 
-static esp_err_t load_onboarding_complete(bool *out_complete, bool *out_missing)
+// Boot-time read of every onboarding preference through one cached handle.
+// *out_missing is set when the namespace has never been written.
+static esp_err_t load_onboarding_prefs(const char *default_mqtt_uri, bool *out_complete, bool *out_missing)
 {
     if (!out_complete || !out_missing) {
         return ESP_ERR_INVALID_ARG;
     }
 
-    bool complete = false;
-    esp_err_t err = prefs_get_bool(ONBOARD_NAMESPACE, ONBOARD_KEY_COMPLETE, &complete, false);
-    if (err == ESP_OK) {
-        *out_complete = complete;
-        *out_missing = false;
-        return ESP_OK;
-    }
+    *out_complete = false;
+    *out_missing = false;
+    prefs_txn_t txn;
+    esp_err_t err = prefs_begin(&txn, ONBOARD_NAMESPACE, false);
     if (is_pref_missing(err)) {
-        *out_complete = false;
         *out_missing = true;
         return ESP_OK;
     }
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    err = prefs_txn_get_str(&txn, ONBOARD_KEY_MQTT_URI, mqtt_uri_state, sizeof(mqtt_uri_state), default_mqtt_uri);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to load mqtt_uri preference (%s), using default", esp_err_to_name(err));
+        safe_copy(mqtt_uri_state, sizeof(mqtt_uri_state), default_mqtt_uri);
+    }
+    err = prefs_txn_get_str(&txn, ONBOARD_KEY_HUB_URL, hub_url_state, sizeof(hub_url_state), "");
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to load hub_url preference (%s), using empty", esp_err_to_name(err));
+        hub_url_state[0] = '\0';
+    }
+    err = prefs_txn_get_bool(&txn, ONBOARD_KEY_COMPLETE, out_complete, false);
+    prefs_end(&txn);
     return err;
 }
 
@@ -95,18 +116,10 @@ static esp_err_t persist_onboarding_complete(bool complete)
     return prefs_put_bool(ONBOARD_NAMESPACE, ONBOARD_KEY_COMPLETE, complete);
 }
 
-static esp_err_t load_persisted_str(const char *key, char *out_value, size_t out_value_len, const char *default_value)
+static esp_err_t put_hub_settings(prefs_txn_t *txn, const char *mqtt_uri, const char *hub_url)
 {
-    if (!key || !out_value || out_value_len == 0) {
-        return ESP_ERR_INVALID_ARG;
-    }
-
-    safe_copy(out_value, out_value_len, default_value);
-    esp_err_t err = prefs_get_str(ONBOARD_NAMESPACE, key, out_value, out_value_len, default_value ? default_value : "");
-    if (err == ESP_OK || is_pref_missing(err)) {
-        return ESP_OK;
-    }
-    return err;
+    prefs_txn_put_str(txn, ONBOARD_KEY_MQTT_URI, mqtt_uri);
+    return prefs_txn_put_str(txn, ONBOARD_KEY_HUB_URL, hub_url ? hub_url : "");
 }
 
 static esp_err_t persist_hub_settings(const char *mqtt_uri, const char *hub_url)
@@ -115,12 +128,28 @@ static esp_err_t persist_hub_settings(const char *mqtt_uri, const char *hub_url)
         return ESP_ERR_INVALID_ARG;
     }
 
-    esp_err_t err = prefs_put_str(ONBOARD_NAMESPACE, ONBOARD_KEY_MQTT_URI, mqtt_uri);
+    prefs_txn_t txn;
+    esp_err_t err = prefs_begin(&txn, ONBOARD_NAMESPACE, true);
     if (err != ESP_OK) {
         return err;
     }
+    put_hub_settings(&txn, mqtt_uri, hub_url);
+    return prefs_commit(&txn);
+}
 
-    return prefs_put_str(ONBOARD_NAMESPACE, ONBOARD_KEY_HUB_URL, hub_url ? hub_url : "");
+// Completion flag and hub settings in one commit once Wi-Fi is up
+static esp_err_t persist_onboarding_result(const char *mqtt_uri, const char *hub_url)
+{
+    prefs_txn_t txn;
+    esp_err_t err = prefs_begin(&txn, ONBOARD_NAMESPACE, true);
+    if (err != ESP_OK) {
+        return err;
+    }
+    prefs_txn_put_bool(&txn, ONBOARD_KEY_COMPLETE, true);
+    if (mqtt_uri && mqtt_uri[0] != '\0') {
+        put_hub_settings(&txn, mqtt_uri, hub_url);
+    }
+    return prefs_commit(&txn);
 }
 
 static void event_handler(void *arg, esp_event_base_t event_base, int32_t event_id, void *event_data)
@@ -216,10 +245,7 @@ static void event_handler(void *arg, esp_event_base_t event_base, int32_t event_
 static esp_err_t init_wifi_stack(void)
 {
     if (!wifi_event_group) {
-        wifi_event_group = xEventGroupCreate();
-        if (!wifi_event_group) {
-            return ESP_ERR_NO_MEM;
-        }
+        wifi_event_group = xEventGroupCreateStatic(&wifi_event_group_buf);
     }
 
     esp_err_t err = esp_netif_init();
@@ -258,19 +284,20 @@ static esp_err_t init_wifi_stack(void)
         handlers_registered = true;
     }
 
-    if (!sta_netif_created) {
-        if (!esp_netif_create_default_wifi_sta()) {
+    if (!sta_netif) {
+        sta_netif = esp_netif_create_default_wifi_sta();
+        if (!sta_netif) {
             return ESP_FAIL;
         }
-        sta_netif_created = true;
+        wifi_fast_connect_apply_static_ip(sta_netif);
     }
 
 #if !CONFIG_BT_ENABLED
-    if (!ap_netif_created) {
-        if (!esp_netif_create_default_wifi_ap()) {
+    if (!ap_netif && !provisioning_released) {
+        ap_netif = esp_netif_create_default_wifi_ap();
+        if (!ap_netif) {
             return ESP_FAIL;
         }
-        ap_netif_created = true;
     }
 #endif
 
@@ -311,6 +338,7 @@ static esp_err_t connect_with_saved_credentials(uint32_t timeout_ms)
         return ESP_ERR_INVALID_STATE;
     }
 
+    int64_t started_us = esp_timer_get_time();
     retry_count = 0;
     xEventGroupClearBits(wifi_event_group, WIFI_CONNECTED_BIT | WIFI_FAIL_BIT);
 
@@ -319,6 +347,16 @@ static esp_err_t connect_with_saved_credentials(uint32_t timeout_ms)
         return err;
     }
 
+    // Tries the cached AP first. The hints only live in RAM so the
+    // provisioned credentials in flash are left alone.
+    wifi_config_t wifi_config;
+    bool fast_path = false;
+    if (esp_wifi_get_config(WIFI_IF_STA, &wifi_config) == ESP_OK &&
+        esp_wifi_set_storage(WIFI_STORAGE_RAM) == ESP_OK &&
+        wifi_fast_connect_apply(&wifi_config)) {
+        fast_path = esp_wifi_set_config(WIFI_IF_STA, &wifi_config) == ESP_OK;
+    }
+
     err = esp_wifi_start();
     if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) {
         return err;
@@ -329,7 +367,26 @@ static esp_err_t connect_with_saved_credentials(uint32_t timeout_ms)
         return err;
     }
 
-    return wait_for_wifi(timeout_ms);
+    if (fast_path) {
+        err = wait_for_wifi(WIFI_FAST_CONNECT_TIMEOUT_MS);
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "Cached AP unreachable (%s); scanning", esp_err_to_name(err));
+            wifi_fast_connect_clear(&wifi_config);
+            esp_wifi_set_config(WIFI_IF_STA, &wifi_config);
+            retry_count = 0;
+            xEventGroupClearBits(wifi_event_group, WIFI_CONNECTED_BIT | WIFI_FAIL_BIT);
+            esp_wifi_disconnect();  // the disconnect handler reconnects with the new config
+            err = wait_for_wifi(timeout_ms);
+        }
+    } else {
+        err = wait_for_wifi(timeout_ms);
+    }
+
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "Wi-Fi connected in %lld ms", (long long)((esp_timer_get_time() - started_us) / 1000));
+        wifi_fast_connect_remember();
+    }
+    return err;
 }
 
 static esp_err_t connect_with_fallback_credentials(const char *ssid, const char *password, uint32_t timeout_ms)
@@ -528,18 +585,9 @@ esp_err_t startup_onboarding_run(
     safe_copy(mqtt_uri_state, sizeof(mqtt_uri_state), default_mqtt_uri);
     hub_url_state[0] = '\0';
 
-    esp_err_t err = load_persisted_str(ONBOARD_KEY_MQTT_URI, mqtt_uri_state, sizeof(mqtt_uri_state), default_mqtt_uri);
-    if (err != ESP_OK) {
-        ESP_LOGW(TAG, "Failed to load mqtt_uri preference (%s), using default", esp_err_to_name(err));
-    }
-    err = load_persisted_str(ONBOARD_KEY_HUB_URL, hub_url_state, sizeof(hub_url_state), "");
-    if (err != ESP_OK) {
-        ESP_LOGW(TAG, "Failed to load hub_url preference (%s), using empty", esp_err_to_name(err));
-    }
-
     bool setup_complete = false;
     bool setup_missing = false;
-    err = load_onboarding_complete(&setup_complete, &setup_missing);
+    esp_err_t err = load_onboarding_prefs(default_mqtt_uri, &setup_complete, &setup_missing);
     if (err != ESP_OK) {
         ESP_LOGW(TAG, "Failed to load onboarding completion flag (%s)", esp_err_to_name(err));
         setup_complete = false;
@@ -554,7 +602,9 @@ esp_err_t startup_onboarding_run(
     wifi_prov_mgr_config_t prov_mgr_config = {
 #if CONFIG_BT_ENABLED
         .scheme = wifi_prov_scheme_ble,
-        .scheme_event_handler = WIFI_PROV_SCHEME_BLE_EVENT_HANDLER_FREE_BTDM,
+        // BT memory is released in startup_onboarding_release(), once the
+        // network is up, so the reclaimed heap is measured in one place
+        .scheme_event_handler = WIFI_PROV_EVENT_HANDLER_NONE,
 #else
         .scheme = wifi_prov_scheme_softap,
         .scheme_event_handler = WIFI_PROV_EVENT_HANDLER_NONE,
@@ -603,14 +653,9 @@ esp_err_t startup_onboarding_run(
                 out_state->ble_transport = false;
                 out_state->wifi_connected = true;
 
-                esp_err_t persist_err = persist_onboarding_complete(true);
-                if (persist_err != ESP_OK) {
-                    ESP_LOGW(TAG, "Failed to persist onboarding complete flag: %s", esp_err_to_name(persist_err));
-                }
-
-                persist_err = persist_hub_settings(mqtt_uri_state, hub_url_state);
+                esp_err_t persist_err = persist_onboarding_result(mqtt_uri_state, hub_url_state);
                 if (persist_err != ESP_OK) {
-                    ESP_LOGW(TAG, "Failed to persist hub settings: %s", esp_err_to_name(persist_err));
+                    ESP_LOGW(TAG, "Failed to persist onboarding result: %s", esp_err_to_name(persist_err));
                 }
 
                 wifi_prov_mgr_deinit();
@@ -685,14 +730,9 @@ esp_err_t startup_onboarding_run(
             }
         }
 
-        err = persist_onboarding_complete(true);
+        err = persist_onboarding_result(mqtt_uri_state, hub_url_state);
         if (err != ESP_OK) {
-            ESP_LOGW(TAG, "Failed to persist onboarding complete flag: %s", esp_err_to_name(err));
-        }
-
-        err = persist_hub_settings(mqtt_uri_state, hub_url_state);
-        if (err != ESP_OK) {
-            ESP_LOGW(TAG, "Failed to persist hub settings: %s", esp_err_to_name(err));
+            ESP_LOGW(TAG, "Failed to persist onboarding result: %s", esp_err_to_name(err));
         }
 
         wifi_prov_mgr_deinit();
@@ -723,3 +763,50 @@ esp_err_t startup_onboarding_run(
     safe_copy(out_state->hub_url, sizeof(out_state->hub_url), hub_url_state);
     return ESP_OK;
 }
+
+esp_err_t startup_onboarding_release(size_t *out_reclaimed_bytes)
+{
+    if (out_reclaimed_bytes) {
+        *out_reclaimed_bytes = 0;
+    }
+    if (provisioning_released) {
+        return ESP_OK;
+    }
+
+    size_t free_before = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+    esp_err_t err = ESP_OK;
+#if CONFIG_BT_ENABLED
+    // wifi_prov_mgr_deinit() stops the BLE transport; a controller still
+    // running here was brought up by someone else and is left alone
+    esp_bt_controller_status_t status = esp_bt_controller_get_status();
+    if (status == ESP_BT_CONTROLLER_STATUS_INITED) {
+        err = esp_bt_controller_deinit();
+        status = esp_bt_controller_get_status();
+    }
+    if (status == ESP_BT_CONTROLLER_STATUS_IDLE) {
+        // Controller and NimBLE host memory; BT cannot come back until reboot
+        err = esp_bt_mem_release(ESP_BT_MODE_BTDM);
+    } else if (err == ESP_OK) {
+        err = ESP_ERR_INVALID_STATE;
+    }
+#else
+    if (ap_netif) {
+        esp_netif_destroy_default_wifi(ap_netif);
+        ap_netif = NULL;
+    }
+#endif
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Provisioning teardown incomplete: %s", esp_err_to_name(err));
+        return err;
+    }
+    provisioning_released = true;
+
+    size_t free_after = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+    size_t reclaimed = free_after > free_before ? free_after - free_before : 0;
+    ESP_LOGI(TAG, "Provisioning resources released: %u bytes reclaimed, %u bytes internal heap free",
+             (unsigned)reclaimed, (unsigned)free_after);
+    if (out_reclaimed_bytes) {
+        *out_reclaimed_bytes = reclaimed;
+    }
+    return ESP_OK;
+}
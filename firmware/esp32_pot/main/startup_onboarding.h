@@ -1,6 +1,7 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stddef.h>
 
 #include "esp_err.h"
 
@@ -27,6 +28,11 @@ esp_err_t startup_onboarding_run(
     const char *fallback_password,
     startup_onboarding_state_t *out_state);
 
+// Frees what provisioning kept reserved once the network is up: the BT
+// controller and host memory (BLE builds) or the SoftAP interface. It is one
+// way; provisioning cannot run again until reboot. Safe to call twice.
+esp_err_t startup_onboarding_release(size_t *out_reclaimed_bytes);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,892 @@
+#include "storage.h"
+
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "esp_littlefs.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+#include "sdkconfig.h"
+
+#include "storage_codec.h"
+
+static const char *TAG = "storage";
+
+#define STORAGE_BASE_PATH "/storage"
+#define STORAGE_FILE_PATH STORAGE_BASE_PATH "/telemetry.bin"
+#define STORAGE_MAGIC 0x54524C47u  // 'TRLG'
+#define STORAGE_VERSION 4u
+#define STORAGE_READ_CHUNK 8   // slots per fread in storage_read_batch
+#define STORAGE_ZERO_CHUNK 8   // slots per fwrite when blanking a new block
+
+#define STORAGE_KEYFRAME_INTERVAL CONFIG_PROJECTPLANT_RING_KEYFRAME_INTERVAL
+#define STORAGE_RING_READINGS (CONFIG_PROJECTPLANT_RING_BUFFER_CAPACITY ? CONFIG_PROJECTPLANT_RING_BUFFER_CAPACITY : 512)
+#define STORAGE_RING_BLOCKS_NEEDED \
+    ((STORAGE_RING_READINGS + STORAGE_KEYFRAME_INTERVAL - 2) / (STORAGE_KEYFRAME_INTERVAL - 1))
+// Eviction needs a block to spare
+#define STORAGE_RING_BLOCKS (STORAGE_RING_BLOCKS_NEEDED < 2 ? 2 : STORAGE_RING_BLOCKS_NEEDED)
+
+// The file is a header followed by fixed-size slots. Slots are grouped in
+// blocks of STORAGE_KEYFRAME_INTERVAL: the first slot of a block is a keyframe
+// with absolute time bases, the rest are readings stored as deltas from it in
+// fixed point. A slot's position follows from its sequence number
+// (seq % capacity), blocks never straddle the end of the file, and the ring
+// always evicts a whole block so every live reading keeps its keyframe.
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t capacity;           // slots, a multiple of keyframe_interval
+    uint16_t keyframe_interval;
+    uint16_t reserved;
+    uint32_t head_seq;           // sequence number the next slot will carry
+    uint32_t tail_seq;           // oldest live slot
+} storage_header_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t seq;                // must equal the block's sequence number to be valid
+    uint64_t base_ms;            // reading timestamp base (epoch, or uptime before time sync)
+    uint32_t uptime_s;
+} storage_keyframe_t;
+
+typedef struct __attribute__((packed)) {
+    uint8_t flags;               // STORAGE_FLAG_*
+    int8_t rssi;
+    uint16_t dt_s;               // timestamp - keyframe base
+    uint16_t uptime_dt_s;        // uptime - keyframe uptime
+    uint16_t soil_raw;
+    uint16_t soil_centi_pct;
+    int16_t temperature_centi_c;
+    uint16_t humidity_centi_pct;
+    uint16_t battery_mv;         // 0 = not measured
+} storage_record_t;
+
+typedef union {
+    storage_keyframe_t key;
+    storage_record_t rec;
+} storage_slot_t;
+
+_Static_assert(sizeof(storage_keyframe_t) == 16 && sizeof(storage_record_t) == 16,
+               "keyframes and records share one slot size");
+
+// Time index for history queries, one entry per block, kept in RAM and
+// rebuilt by storage_init(). A block's readings are stamped between its
+// keyframe base and base + span_s; entries cover every block still on flash,
+// delivered or not.
+typedef struct {
+    uint64_t base_ms;
+    uint32_t seq;                // block sequence number; 0 = not indexed
+    uint16_t span_s;             // largest dt_s among the block's readings
+} storage_index_entry_t;
+
+// s_header describes the logical ring, including slots still staged in s_batch.
+// Staged slots are the ones just before head_seq.
+static StaticSemaphore_t s_lock_buf;
+static SemaphoreHandle_t s_lock = NULL;
+static FILE *s_file = NULL;
+static storage_header_t s_header = {0};
+static bool s_ready = false;
+static storage_slot_t s_batch[CONFIG_PROJECTPLANT_RING_APPEND_BATCH + 1];  // + a keyframe
+static uint32_t s_batch_count = 0;
+static uint32_t s_blank_to_seq = 0;        // end of a newly started block still to be blanked
+static int64_t s_batch_since_us = 0;       // when the oldest staged reading was appended
+static uint32_t s_unsynced_entries = 0;    // written since the header last hit flash
+static int64_t s_header_synced_us = 0;
+static storage_keyframe_t s_head_key;      // keyframe of the block being appended to
+static bool s_head_key_valid = false;
+static storage_keyframe_t s_read_key;      // last keyframe loaded by a reader
+static bool s_read_key_valid = false;
+static const storage_slot_t s_zero_slots[STORAGE_ZERO_CHUNK];
+static storage_index_entry_t s_index[STORAGE_RING_BLOCKS];
+
+static uint16_t storage_get_capacity_config(void)
+{
+    return (uint16_t)(STORAGE_RING_BLOCKS * STORAGE_KEYFRAME_INTERVAL);
+}
+
+static size_t slot_offset(uint32_t seq)
+{
+    return sizeof(storage_header_t) + (seq % s_header.capacity) * sizeof(storage_slot_t);
+}
+
+static uint32_t block_start(uint32_t seq)
+{
+    return seq - seq % STORAGE_KEYFRAME_INTERVAL;
+}
+
+// Oldest slot still on flash, delivered or not: the next block opened
+// overwrites the one a capacity behind it. The first lap starts at capacity
+// (storage_reset_locked), so nothing below that was ever written.
+static uint32_t storage_retained_seq_locked(void)
+{
+    uint32_t next_block = block_start(s_header.head_seq + STORAGE_KEYFRAME_INTERVAL - 1);
+    uint32_t oldest = next_block - s_header.capacity;
+    return (int32_t)(oldest - s_header.capacity) < 0 ? s_header.capacity : oldest;
+}
+
+static storage_index_entry_t *storage_index_entry(uint32_t block_seq)
+{
+    return &s_index[(block_seq % s_header.capacity) / STORAGE_KEYFRAME_INTERVAL];
+}
+
+static void storage_index_open_block(const storage_keyframe_t *key)
+{
+    storage_index_entry_t *entry = storage_index_entry(key->seq);
+    entry->seq = key->seq;
+    entry->base_ms = key->base_ms;
+    entry->span_s = 0;
+}
+
+static void storage_index_add_record(uint32_t block_seq, const storage_record_t *rec)
+{
+    storage_index_entry_t *entry = storage_index_entry(block_seq);
+    if (entry->seq == block_seq && rec->dt_s > entry->span_s) {
+        entry->span_s = rec->dt_s;
+    }
+}
+
+static bool storage_index_overlaps(uint32_t block_seq, uint64_t from_ms, uint64_t to_ms)
+{
+    const storage_index_entry_t *entry = storage_index_entry(block_seq);
+    return entry->seq == block_seq && entry->base_ms <= to_ms &&
+           entry->base_ms + (uint64_t)entry->span_s * 1000ULL >= from_ms;
+}
+
+static void storage_keyframe_from_sample(storage_keyframe_t *out, uint32_t seq, const telemetry_sample_t *sample)
+{
+    out->seq = seq;
+    out->base_ms = sample->reading.timestamp_ms;
+    out->uptime_s = (uint32_t)(sample->uptime_ms / 1000);
+}
+
+// Fails when the sample cannot be expressed against this keyframe (clock
+// stepped back, reboot, or a gap longer than the delta fields hold); the
+// caller then starts a new block.
+static bool storage_record_from_sample(storage_record_t *out, const storage_keyframe_t *key,
+                                       const telemetry_sample_t *sample)
+{
+    if (sample->reading.timestamp_ms < key->base_ms) {
+        return false;
+    }
+    uint64_t dt_s = (sample->reading.timestamp_ms - key->base_ms + 500) / 1000;
+    int64_t uptime_dt_s = sample->uptime_ms / 1000 - (int64_t)key->uptime_s;
+    if (dt_s > UINT16_MAX || uptime_dt_s < 0 || uptime_dt_s > UINT16_MAX) {
+        return false;
+    }
+
+    memset(out, 0, sizeof(*out));
+    out->dt_s = (uint16_t)dt_s;
+    out->uptime_dt_s = (uint16_t)uptime_dt_s;
+    out->rssi = to_rssi_i8(sample->rssi);
+    out->soil_raw = sample->reading.soil_raw;
+    out->soil_centi_pct = to_centi_u16(sample->reading.soil_percent);
+    out->temperature_centi_c = to_centi_i16(sample->reading.temperature_c);
+    out->humidity_centi_pct = to_centi_u16(sample->reading.humidity_pct);
+    out->battery_mv = to_battery_mv(sample->reading.battery_v);
+    out->flags = storage_flags_from_reading(&sample->reading);
+    return true;
+}
+
+static void storage_record_to_sample(const storage_record_t *rec, const storage_keyframe_t *key,
+                                     telemetry_sample_t *out)
+{
+    memset(out, 0, sizeof(*out));
+    out->reading.timestamp_ms = key->base_ms + (uint64_t)rec->dt_s * 1000ULL;
+    out->uptime_ms = ((int64_t)key->uptime_s + rec->uptime_dt_s) * 1000LL;
+    out->rssi = rec->rssi;
+    out->reading.soil_raw = rec->soil_raw;
+    out->reading.soil_percent = from_centi_u16(rec->soil_centi_pct);
+    out->reading.temperature_c = from_centi_i16(rec->temperature_centi_c);
+    out->reading.humidity_pct = from_centi_u16(rec->humidity_centi_pct);
+    out->reading.battery_v = from_battery_mv(rec->battery_mv);
+    storage_flags_to_reading(rec->flags, &out->reading);
+}
+
+// fflush() only hands data to LittleFS; fsync() is what commits it to flash.
+static esp_err_t storage_commit_file_locked(void)
+{
+    fflush(s_file);
+    if (fsync(fileno(s_file)) != 0) {
+        ESP_LOGE(TAG, "fsync failed: %d", errno);
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t storage_write_header_locked(void)
+{
+    if (fseek(s_file, 0, SEEK_SET) != 0) {
+        ESP_LOGE(TAG, "fseek header failed: %d", errno);
+        return ESP_FAIL;
+    }
+    size_t written = fwrite(&s_header, sizeof(s_header), 1, s_file);
+    if (written != 1) {
+        ESP_LOGE(TAG, "header write failed: %d", errno);
+        return ESP_FAIL;
+    }
+    esp_err_t err = storage_commit_file_locked();
+    if (err == ESP_OK) {
+        s_unsynced_entries = 0;
+        s_header_synced_us = esp_timer_get_time();
+    }
+    return err;
+}
+
+// Write staged slots, plus the blank rest of a block started in this batch,
+// as one contiguous run (two when it wraps the file end) and commit them
+// together. The header is left alone.
+static esp_err_t storage_flush_batch_locked(void)
+{
+    if (s_batch_count == 0) {
+        return ESP_OK;
+    }
+    uint32_t first = s_header.head_seq - s_batch_count;
+    uint32_t end = s_header.head_seq;
+    if (s_blank_to_seq != 0 && (int32_t)(s_blank_to_seq - end) > 0) {
+        end = s_blank_to_seq;
+    }
+
+    uint32_t seq = first;
+    while (seq != end) {
+        uint32_t to_file_end = s_header.capacity - seq % s_header.capacity;
+        uint32_t run_end = end - seq > to_file_end ? seq + to_file_end : end;
+        if (fseek(s_file, (long)slot_offset(seq), SEEK_SET) != 0) {
+            ESP_LOGE(TAG, "fseek append failed: %d", errno);
+            return ESP_FAIL;
+        }
+        while (seq != run_end) {
+            const storage_slot_t *src;
+            uint32_t n;
+            if ((int32_t)(s_header.head_seq - seq) > 0) {
+                src = &s_batch[seq - first];
+                n = (int32_t)(s_header.head_seq - run_end) < 0 ? s_header.head_seq - seq : run_end - seq;
+            } else {
+                src = s_zero_slots;
+                n = run_end - seq > STORAGE_ZERO_CHUNK ? STORAGE_ZERO_CHUNK : run_end - seq;
+            }
+            if (fwrite(src, sizeof(storage_slot_t), n, s_file) != n) {
+                ESP_LOGE(TAG, "write append failed: %d", errno);
+                return ESP_FAIL;
+            }
+            seq += n;
+        }
+    }
+    esp_err_t err = storage_commit_file_locked();
+    if (err != ESP_OK) {
+        return err;
+    }
+    s_unsynced_entries += s_batch_count;
+    s_batch_count = 0;
+    s_blank_to_seq = 0;
+    return ESP_OK;
+}
+
+// The header may only describe slots that are on flash, so staged ones go first.
+static esp_err_t storage_sync_header_locked(void)
+{
+    if (!s_file) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    esp_err_t err = storage_flush_batch_locked();
+    if (err != ESP_OK) {
+        return err;
+    }
+    return storage_write_header_locked();
+}
+
+static esp_err_t storage_reset_locked(void)
+{
+    if (!s_file) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    ESP_LOGI(TAG, "Resetting ring buffer file");
+    memset(&s_header, 0, sizeof(s_header));
+    s_header.magic = STORAGE_MAGIC;
+    s_header.version = STORAGE_VERSION;
+    s_header.capacity = storage_get_capacity_config();
+    s_header.keyframe_interval = STORAGE_KEYFRAME_INTERVAL;
+    // Start one lap in: zeroed slots (seq 0) then never pass for keyframes
+    s_header.head_seq = s_header.capacity;
+    s_header.tail_seq = s_header.capacity;
+    s_batch_count = 0;
+    s_blank_to_seq = 0;
+    s_head_key_valid = false;
+    s_read_key_valid = false;
+    memset(s_index, 0, sizeof(s_index));
+
+    // Old slots could carry the very sequence numbers a fresh ring reuses
+    fflush(s_file);
+    if (ftruncate(fileno(s_file), 0) != 0) {
+        ESP_LOGW(TAG, "truncate reset failed: %d", errno);
+    }
+    return storage_write_header_locked();
+}
+
+static bool storage_read_slot_locked(uint32_t seq, storage_slot_t *out)
+{
+    if (fseek(s_file, (long)slot_offset(seq), SEEK_SET) != 0) {
+        ESP_LOGE(TAG, "fseek slot failed: %d", errno);
+        return false;
+    }
+    return fread(out, sizeof(*out), 1, s_file) == 1;
+}
+
+// Load (or reuse) the keyframe opening the block at block_seq
+static const storage_keyframe_t *storage_load_key_locked(uint32_t block_seq)
+{
+    if (s_head_key_valid && s_head_key.seq == block_seq) {
+        return &s_head_key;
+    }
+    if (s_read_key_valid && s_read_key.seq == block_seq) {
+        return &s_read_key;
+    }
+    storage_slot_t slot;
+    if (!storage_read_slot_locked(block_seq, &slot) || slot.key.seq != block_seq) {
+        return NULL;
+    }
+    s_read_key = slot.key;
+    s_read_key_valid = true;
+    return &s_read_key;
+}
+
+// Opening a block at head_seq reclaims it; if the oldest live slots are in
+// it, the tail moves past the whole block.
+static void storage_claim_block_locked(uint32_t block_seq)
+{
+    uint32_t block_end = block_seq + STORAGE_KEYFRAME_INTERVAL;
+    if (block_end - s_header.tail_seq > s_header.capacity) {
+        s_header.tail_seq = block_end - s_header.capacity;
+    }
+}
+
+// Slots written after the last header sync are found by walking forward from
+// head_seq: keyframes must carry their own sequence number, readings must be
+// marked present, and a blank slot is only skipped if the next block was
+// started (its block was closed early).
+static void storage_recover_head_locked(void)
+{
+    uint32_t seq = s_header.head_seq;
+    uint32_t recovered = 0;
+    while (recovered < s_header.capacity) {
+        uint32_t block = block_start(seq);
+        if (seq == block) {
+            if (!storage_load_key_locked(seq)) {
+                break;
+            }
+            storage_claim_block_locked(seq);
+            seq++;
+            recovered++;
+            continue;
+        }
+        storage_slot_t slot;
+        if (!storage_load_key_locked(block) || !storage_read_slot_locked(seq, &slot)) {
+            break;
+        }
+        if (slot.rec.flags & STORAGE_FLAG_PRESENT) {
+            seq++;
+            recovered++;
+        } else if (storage_load_key_locked(block + STORAGE_KEYFRAME_INTERVAL)) {
+            seq = block + STORAGE_KEYFRAME_INTERVAL;
+        } else {
+            break;
+        }
+    }
+
+    uint32_t head_block = block_start(seq);
+    const storage_keyframe_t *key = seq != head_block ? storage_load_key_locked(head_block) : NULL;
+    if (key) {
+        s_head_key = *key;
+        s_head_key_valid = true;
+    }
+    if (seq != s_header.head_seq) {
+        ESP_LOGI(TAG, "Recovered %u slots appended after the last header sync", (unsigned)recovered);
+        s_header.head_seq = seq;
+        storage_write_header_locked();
+    }
+}
+
+// One pass over the blocks still on flash; blocks without a valid keyframe
+// stay out of the index, so history queries skip them
+static void storage_index_rebuild_locked(void)
+{
+    memset(s_index, 0, sizeof(s_index));
+    uint32_t end = s_header.head_seq;
+    for (uint32_t block = storage_retained_seq_locked(); (int32_t)(end - block) > 0;
+         block += STORAGE_KEYFRAME_INTERVAL) {
+        const storage_keyframe_t *key = storage_load_key_locked(block);
+        if (!key) {
+            continue;
+        }
+        storage_index_open_block(key);
+        uint32_t block_end = block + STORAGE_KEYFRAME_INTERVAL;
+        uint32_t run_end = (int32_t)(end - block_end) < 0 ? end : block_end;
+        uint32_t seq = block + 1;
+        if (seq == run_end || fseek(s_file, (long)slot_offset(seq), SEEK_SET) != 0) {
+            continue;
+        }
+        while (seq != run_end) {
+            storage_slot_t chunk[STORAGE_READ_CHUNK];
+            uint32_t n = run_end - seq > STORAGE_READ_CHUNK ? STORAGE_READ_CHUNK : run_end - seq;
+            if (fread(chunk, sizeof(storage_slot_t), n, s_file) != n) {
+                break;
+            }
+            for (uint32_t i = 0; i < n; ++i) {
+                if (chunk[i].rec.flags & STORAGE_FLAG_PRESENT) {
+                    storage_index_add_record(block, &chunk[i].rec);
+                }
+            }
+            seq += n;
+        }
+    }
+}
+
+static void storage_shutdown_handler(void)
+{
+    // esp_restart() path; don't hang the reboot on a held lock
+    if (!s_ready || xSemaphoreTake(s_lock, pdMS_TO_TICKS(500)) != pdTRUE) {
+        return;
+    }
+    storage_sync_header_locked();
+    xSemaphoreGive(s_lock);
+}
+
+static esp_err_t storage_mount(void)
+{
+    esp_vfs_littlefs_conf_t conf = {
+        .base_path = STORAGE_BASE_PATH,
+        .partition_label = "storage",
+        .format_if_mount_failed = true,
+    };
+    esp_err_t err = esp_vfs_littlefs_register(&conf);
+    if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) {
+        ESP_LOGE(TAG, "LittleFS mount failed: %s", esp_err_to_name(err));
+        return err;
+    }
+    if (err == ESP_ERR_INVALID_STATE) {
+        // Already mounted; continue.
+        return ESP_OK;
+    }
+    ESP_LOGI(TAG, "LittleFS mounted on %s", STORAGE_BASE_PATH);
+    size_t total = 0;
+    size_t used = 0;
+    if (esp_littlefs_info(conf.partition_label, &total, &used) == ESP_OK) {
+        ESP_LOGI(TAG, "LittleFS partition size=%u bytes used=%u bytes", (unsigned)total, (unsigned)used);
+    }
+    return ESP_OK;
+}
+
+esp_err_t storage_init(void)
+{
+    if (!s_lock) {
+        s_lock = xSemaphoreCreateMutexStatic(&s_lock_buf);
+    }
+
+    esp_err_t err = storage_mount();
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    if (s_file) {
+        s_ready = true;
+        return ESP_OK;
+    }
+
+    s_file = fopen(STORAGE_FILE_PATH, "r+b");
+    if (!s_file) {
+        ESP_LOGW(TAG, "Creating new buffer file at %s", STORAGE_FILE_PATH);
+        s_file = fopen(STORAGE_FILE_PATH, "w+b");
+        if (!s_file) {
+            ESP_LOGE(TAG, "Failed to open storage file: %d", errno);
+            return ESP_FAIL;
+        }
+    }
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    size_t read = fread(&s_header, sizeof(s_header), 1, s_file);
+    if (read != 1 || s_header.magic != STORAGE_MAGIC || s_header.version != STORAGE_VERSION ||
+        s_header.capacity != storage_get_capacity_config() ||
+        s_header.keyframe_interval != STORAGE_KEYFRAME_INTERVAL ||
+        s_header.head_seq - s_header.tail_seq > s_header.capacity) {
+        ESP_LOGW(TAG, "Ring buffer header invalid; reinitializing");
+        err = storage_reset_locked();
+    } else {
+        s_header_synced_us = esp_timer_get_time();
+        storage_recover_head_locked();
+        storage_index_rebuild_locked();
+        err = ESP_OK;
+    }
+    xSemaphoreGive(s_lock);
+
+    if (err == ESP_OK) {
+        s_ready = true;
+        esp_register_shutdown_handler(storage_shutdown_handler);
+    }
+    return err;
+}
+
+size_t storage_capacity(void)
+{
+    return s_header.capacity / STORAGE_KEYFRAME_INTERVAL * (STORAGE_KEYFRAME_INTERVAL - 1);
+}
+
+size_t storage_count(void)
+{
+    if (!s_ready) {
+        return 0;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    uint32_t tail = s_header.tail_seq;
+    uint32_t head = s_header.head_seq;
+    // Live slots minus the keyframes among them (tail and head are never 0)
+    size_t count = head - tail;
+    if (count > 0) {
+        count -= (head - 1) / STORAGE_KEYFRAME_INTERVAL - (tail - 1) / STORAGE_KEYFRAME_INTERVAL;
+    }
+    xSemaphoreGive(s_lock);
+    return count;
+}
+
+static bool storage_deadline_passed(int64_t since_us, uint32_t period_s)
+{
+    return esp_timer_get_time() - since_us >= (int64_t)period_s * 1000000LL;
+}
+
+// Apply the write policy: flush the batch when it is full or has aged out,
+// and rewrite the header every N entries or T seconds.
+static esp_err_t storage_apply_policy_locked(void)
+{
+    esp_err_t err = ESP_OK;
+    if (s_batch_count >= CONFIG_PROJECTPLANT_RING_APPEND_BATCH ||
+        (s_batch_count > 0 && storage_deadline_passed(s_batch_since_us, CONFIG_PROJECTPLANT_RING_FLUSH_SEC))) {
+        err = storage_flush_batch_locked();
+    }
+    if (err == ESP_OK && s_unsynced_entries > 0 &&
+        (s_unsynced_entries >= CONFIG_PROJECTPLANT_RING_HEADER_SYNC_ENTRIES ||
+         storage_deadline_passed(s_header_synced_us, CONFIG_PROJECTPLANT_RING_FLUSH_SEC))) {
+        err = storage_sync_header_locked();
+    }
+    return err;
+}
+
+static void storage_stage_locked(const storage_slot_t *slot)
+{
+    s_batch[s_batch_count++] = *slot;
+    s_header.head_seq++;
+}
+
+esp_err_t storage_append_sample(const telemetry_sample_t *sample)
+{
+    if (!s_ready || !sample) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    if (s_header.capacity == 0) {
+        xSemaphoreGive(s_lock);
+        return ESP_FAIL;
+    }
+    // A previous flush may have failed; retry before staging past the buffer
+    esp_err_t err = ESP_OK;
+    if (s_batch_count + 2 > sizeof(s_batch) / sizeof(s_batch[0])) {
+        err = storage_flush_batch_locked();
+    }
+    storage_slot_t slot;
+    uint32_t seq = s_header.head_seq;
+    bool fits = seq != block_start(seq) && s_head_key_valid &&
+                storage_record_from_sample(&slot.rec, &s_head_key, sample);
+    if (err == ESP_OK && !fits && seq != block_start(seq)) {
+        // Close the block early; its remaining slots stay blank
+        err = storage_flush_batch_locked();
+        s_header.head_seq = block_start(seq) + STORAGE_KEYFRAME_INTERVAL;
+    }
+    if (err != ESP_OK) {
+        xSemaphoreGive(s_lock);
+        return err;
+    }
+
+    if (s_batch_count == 0) {
+        s_batch_since_us = esp_timer_get_time();
+    }
+    if (!fits) {
+        seq = s_header.head_seq;
+        storage_claim_block_locked(seq);
+        storage_slot_t key;
+        storage_keyframe_from_sample(&key.key, seq, sample);
+        s_head_key = key.key;
+        s_head_key_valid = true;
+        s_blank_to_seq = seq + STORAGE_KEYFRAME_INTERVAL;
+        storage_index_open_block(&s_head_key);
+        storage_stage_locked(&key);
+        storage_record_from_sample(&slot.rec, &s_head_key, sample);
+    }
+    storage_index_add_record(block_start(s_header.head_seq), &slot.rec);
+    storage_stage_locked(&slot);
+
+    err = storage_apply_policy_locked();
+    xSemaphoreGive(s_lock);
+    return err;
+}
+
+esp_err_t storage_flush_if_due(void)
+{
+    if (!s_ready) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    esp_err_t err = storage_apply_policy_locked();
+    xSemaphoreGive(s_lock);
+    return err;
+}
+
+esp_err_t storage_flush(void)
+{
+    if (!s_ready) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    esp_err_t err = ESP_OK;
+    if (s_batch_count > 0 || s_unsynced_entries > 0) {
+        err = storage_sync_header_locked();
+    }
+    xSemaphoreGive(s_lock);
+    return err;
+}
+
+// Decode up to max readings from the cursor onward, skipping keyframes and
+// blank slots, and advance the cursor past everything consumed.
+static size_t storage_read_batch_locked(storage_cursor_t *cursor, telemetry_sample_t *out, size_t max)
+{
+    uint32_t tail_seq = s_header.tail_seq;
+    uint32_t head_seq = s_header.head_seq;
+    if ((int32_t)(cursor->seq - tail_seq) < 0) {
+        ESP_LOGW(TAG, "%u slots overwritten before upload", (unsigned)(tail_seq - cursor->seq));
+        cursor->seq = tail_seq;
+    }
+    if (cursor->seq - tail_seq > head_seq - tail_seq) {
+        return 0;  // cursor from a previous ring (reset)
+    }
+    if (cursor->seq == head_seq || storage_flush_batch_locked() != ESP_OK) {
+        return 0;
+    }
+
+    uint32_t seq = cursor->seq;
+    size_t done = 0;
+    while (done < max && seq != head_seq) {
+        uint32_t block = block_start(seq);
+        uint32_t block_end = block + STORAGE_KEYFRAME_INTERVAL;
+        uint32_t run_end = (int32_t)(head_seq - block_end) < 0 ? head_seq : block_end;
+        const storage_keyframe_t *key = storage_load_key_locked(block);
+        if (!key) {
+            ESP_LOGW(TAG, "Block %u has no valid keyframe; skipping it", (unsigned)block);
+            seq = run_end;
+            continue;
+        }
+        storage_keyframe_t block_key = *key;
+        if (seq == block) {
+            seq++;
+            continue;
+        }
+
+        // Blocks never straddle the file end, so a block's readings are one run
+        if (fseek(s_file, (long)slot_offset(seq), SEEK_SET) != 0) {
+            ESP_LOGE(TAG, "fseek batch read failed: %d", errno);
+            break;
+        }
+        bool failed = false;
+        while (done < max && seq != run_end) {
+            storage_slot_t chunk[STORAGE_READ_CHUNK];
+            uint32_t n = run_end - seq > STORAGE_READ_CHUNK ? STORAGE_READ_CHUNK : run_end - seq;
+            if (fread(chunk, sizeof(storage_slot_t), n, s_file) != n) {
+                ESP_LOGE(TAG, "batch read failed: %d", errno);
+                failed = true;
+                break;
+            }
+            uint32_t i = 0;
+            for (; i < n && done < max; ++i) {
+                if (chunk[i].rec.flags & STORAGE_FLAG_PRESENT) {
+                    storage_record_to_sample(&chunk[i].rec, &block_key, &out[done++]);
+                }
+            }
+            seq += i;
+        }
+        if (failed) {
+            break;
+        }
+    }
+    cursor->seq = seq;
+    return done;
+}
+
+bool storage_peek_oldest(telemetry_sample_t *out)
+{
+    if (!s_ready || !out) {
+        return false;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    storage_cursor_t cursor = {.seq = s_header.tail_seq};
+    bool ok = storage_read_batch_locked(&cursor, out, 1) == 1;
+    xSemaphoreGive(s_lock);
+    return ok;
+}
+
+esp_err_t storage_drop_oldest(void)
+{
+    if (!s_ready) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    storage_cursor_t cursor = {.seq = s_header.tail_seq};
+    telemetry_sample_t sample;
+    if (storage_read_batch_locked(&cursor, &sample, 1) == 0) {
+        xSemaphoreGive(s_lock);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    s_header.tail_seq = cursor.seq;
+    esp_err_t err = storage_sync_header_locked();
+    xSemaphoreGive(s_lock);
+    return err;
+}
+
+void storage_cursor_begin(storage_cursor_t *cursor)
+{
+    if (!cursor) {
+        return;
+    }
+    cursor->seq = 0;
+    if (!s_ready) {
+        return;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    cursor->seq = s_header.tail_seq;
+    xSemaphoreGive(s_lock);
+}
+
+size_t storage_read_batch(storage_cursor_t *cursor, telemetry_sample_t *out, size_t max)
+{
+    if (!s_ready || !cursor || !out || max == 0) {
+        return 0;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    size_t done = storage_read_batch_locked(cursor, out, max);
+    xSemaphoreGive(s_lock);
+    return done;
+}
+
+esp_err_t storage_commit_cursor(const storage_cursor_t *cursor)
+{
+    if (!s_ready || !cursor) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    uint32_t dropped = cursor->seq - s_header.tail_seq;
+    if ((int32_t)dropped <= 0 || dropped > s_header.head_seq - s_header.tail_seq) {
+        // Already dropped (or overwritten) in the meantime
+        xSemaphoreGive(s_lock);
+        return ESP_OK;
+    }
+    s_header.tail_seq = cursor->seq;
+    esp_err_t err = storage_sync_header_locked();
+    xSemaphoreGive(s_lock);
+    return err;
+}
+
+void storage_history_begin(storage_history_t *query, uint64_t from_ms, uint64_t to_ms)
+{
+    if (!query) {
+        return;
+    }
+    query->seq = 0;
+    query->from_ms = from_ms;
+    query->to_ms = to_ms;
+    if (!s_ready) {
+        return;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    query->seq = storage_retained_seq_locked();
+    xSemaphoreGive(s_lock);
+}
+
+// Like storage_read_batch_locked(), but over everything still on flash and
+// without flushing: staged slots are undelivered, so the drain sends them.
+static size_t storage_history_read_locked(storage_history_t *query, telemetry_sample_t *out, size_t max)
+{
+    uint32_t retained = storage_retained_seq_locked();
+    uint32_t end = s_header.head_seq - s_batch_count;
+    if ((int32_t)(query->seq - retained) < 0) {
+        query->seq = retained;  // the ring overwrote part of the window meanwhile
+    }
+    if (query->seq - retained > end - retained) {
+        return 0;  // query from a previous ring (reset)
+    }
+
+    uint32_t seq = query->seq;
+    size_t done = 0;
+    while (done < max && seq != end) {
+        uint32_t block = block_start(seq);
+        uint32_t block_end = block + STORAGE_KEYFRAME_INTERVAL;
+        uint32_t run_end = (int32_t)(end - block_end) < 0 ? end : block_end;
+        const storage_keyframe_t *key = NULL;
+        if (storage_index_overlaps(block, query->from_ms, query->to_ms)) {
+            key = storage_load_key_locked(block);
+        }
+        if (!key) {
+            seq = run_end;
+            continue;
+        }
+        storage_keyframe_t block_key = *key;
+        if (seq == block) {
+            seq++;
+            continue;
+        }
+
+        if (fseek(s_file, (long)slot_offset(seq), SEEK_SET) != 0) {
+            ESP_LOGE(TAG, "fseek history read failed: %d", errno);
+            break;
+        }
+        bool failed = false;
+        while (done < max && seq != run_end) {
+            storage_slot_t chunk[STORAGE_READ_CHUNK];
+            uint32_t n = run_end - seq > STORAGE_READ_CHUNK ? STORAGE_READ_CHUNK : run_end - seq;
+            if (fread(chunk, sizeof(storage_slot_t), n, s_file) != n) {
+                ESP_LOGE(TAG, "history read failed: %d", errno);
+                failed = true;
+                break;
+            }
+            uint32_t i = 0;
+            for (; i < n && done < max; ++i) {
+                if (!(chunk[i].rec.flags & STORAGE_FLAG_PRESENT)) {
+                    continue;
+                }
+                storage_record_to_sample(&chunk[i].rec, &block_key, &out[done]);
+                uint64_t ts = out[done].reading.timestamp_ms;
+                if (ts >= query->from_ms && ts <= query->to_ms) {
+                    done++;
+                }
+            }
+            seq += i;
+        }
+        if (failed) {
+            break;
+        }
+    }
+    query->seq = seq;
+    return done;
+}
+
+size_t storage_history_read(storage_history_t *query, telemetry_sample_t *out, size_t max)
+{
+    if (!s_ready || !query || !out || max == 0) {
+        return 0;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    size_t done = storage_history_read_locked(query, out, max);
+    xSemaphoreGive(s_lock);
+    return done;
+}
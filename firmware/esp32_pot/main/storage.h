@@ -0,0 +1,69 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#include "sensors.h"
+
+// Two backends implement this API, chosen with CONFIG_PROJECTPLANT_RING_BACKEND_*:
+// storage.c keeps the ring in a LittleFS file, storage_raw.c on a raw
+// partition of its own. Notes below are for the LittleFS ring unless marked.
+
+typedef struct {
+    sensor_reading_t reading;
+    int64_t uptime_ms;
+    int16_t rssi;
+} telemetry_sample_t;
+
+esp_err_t storage_init(void);
+size_t storage_capacity(void);
+// Readings between tail and head; blocks closed early (reboot, clock step)
+// leave blank slots that are counted too, so treat this as an upper bound.
+size_t storage_count(void);
+// Appends are staged in RAM and written in batches; the header follows on
+// its own (less frequent) schedule and is rolled forward from the entries'
+// sequence numbers on the next init. Readings staged when power is lost are
+// gone, so the batch is also flushed after CONFIG_PROJECTPLANT_RING_FLUSH_SEC.
+// Raw partition: each append is written, and durable, before this returns.
+esp_err_t storage_append_sample(const telemetry_sample_t *sample);
+// Apply the time-based part of the write policy; call periodically
+esp_err_t storage_flush_if_due(void);
+// Write everything staged and the header (also runs from a shutdown handler)
+esp_err_t storage_flush(void);
+bool storage_peek_oldest(telemetry_sample_t *out);
+esp_err_t storage_drop_oldest(void);
+
+// Drain cursor. It names entries by sequence number, so appends that overwrite
+// the oldest entries while a batch is being uploaded cannot shift it.
+typedef struct {
+    uint32_t seq;  // next entry to read
+} storage_cursor_t;
+
+// Position a cursor at the oldest entry
+void storage_cursor_begin(storage_cursor_t *cursor);
+// Read up to max entries from the cursor onward (one contiguous read per
+// side of the ring end) and advance the cursor past them. Returns the number
+// read; entries overwritten since the cursor was taken are skipped.
+size_t storage_read_batch(storage_cursor_t *cursor, telemetry_sample_t *out, size_t max);
+// Drop every entry before the cursor with a single header update
+esp_err_t storage_commit_cursor(const storage_cursor_t *cursor);
+
+// History queries. Delivered readings stay on flash until the ring reuses
+// their slots; an in-RAM time index (one entry per keyframe block, or per
+// sector on the raw partition, rebuilt by storage_init()) lets a query read
+// only the blocks that can hold its window. The drain cursor is not affected.
+typedef struct {
+    uint32_t seq;      // next slot to examine
+    uint64_t from_ms;  // window on reading.timestamp_ms, both ends inclusive
+    uint64_t to_ms;
+} storage_history_t;
+
+void storage_history_begin(storage_history_t *query, uint64_t from_ms, uint64_t to_ms);
+// Read up to max readings from the window, in ring order, and advance the
+// query past them. Returns 0 once nothing further is on flash; readings
+// overwritten since the last call are skipped, and readings still staged in
+// RAM are left to the drain.
+size_t storage_history_read(storage_history_t *query, telemetry_sample_t *out, size_t max);
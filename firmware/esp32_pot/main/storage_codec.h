@@ -0,0 +1,100 @@
+#pragma once
+
+// Fixed-point encoding of readings shared by the ring backends (storage.c,
+// storage_raw.c). Values outside a field's range are clamped; NAN maps to the
+// field's "not measured" code.
+
+#include <math.h>
+#include <stdint.h>
+
+#include "sensors.h"
+
+#define STORAGE_FLAG_WATER_LOW      (1u << 0)
+#define STORAGE_FLAG_WATER_CUTOFF   (1u << 1)
+#define STORAGE_FLAG_PUMP_ON        (1u << 2)
+#define STORAGE_FLAG_IC_ZONE1_ON    (1u << 3)
+#define STORAGE_FLAG_FAN_ON         (1u << 4)
+#define STORAGE_FLAG_MISTER_ON      (1u << 5)
+#define STORAGE_FLAG_LIGHT_ON       (1u << 6)
+#define STORAGE_FLAG_PRESENT        (1u << 7)  // slot holds a reading (blank slots are zero)
+
+#define STORAGE_CENTI_NONE_U16 UINT16_MAX      // fixed-point "not measured"
+#define STORAGE_CENTI_NONE_I16 INT16_MIN
+
+static inline uint16_t to_centi_u16(float value)
+{
+    if (isnan(value)) {
+        return STORAGE_CENTI_NONE_U16;
+    }
+    long centi = lroundf(value * 100.0f);
+    if (centi < 0) {
+        return 0;
+    }
+    return centi >= STORAGE_CENTI_NONE_U16 ? STORAGE_CENTI_NONE_U16 - 1 : (uint16_t)centi;
+}
+
+static inline int16_t to_centi_i16(float value)
+{
+    if (isnan(value)) {
+        return STORAGE_CENTI_NONE_I16;
+    }
+    long centi = lroundf(value * 100.0f);
+    if (centi <= STORAGE_CENTI_NONE_I16) {
+        return STORAGE_CENTI_NONE_I16 + 1;
+    }
+    return centi > INT16_MAX ? INT16_MAX : (int16_t)centi;
+}
+
+static inline float from_centi_u16(uint16_t centi)
+{
+    return centi == STORAGE_CENTI_NONE_U16 ? NAN : (float)centi / 100.0f;
+}
+
+static inline float from_centi_i16(int16_t centi)
+{
+    return centi == STORAGE_CENTI_NONE_I16 ? NAN : (float)centi / 100.0f;
+}
+
+// 0 = not measured
+static inline uint16_t to_battery_mv(float battery_v)
+{
+    if (!isnan(battery_v) && battery_v > 0.0f && battery_v < 65.0f) {
+        return (uint16_t)lroundf(battery_v * 1000.0f);
+    }
+    return 0;
+}
+
+static inline float from_battery_mv(uint16_t mv)
+{
+    return mv ? (float)mv / 1000.0f : NAN;
+}
+
+// STORAGE_FLAG_PRESENT plus the reading's state bits
+static inline uint8_t storage_flags_from_reading(const sensor_reading_t *reading)
+{
+    uint8_t flags = STORAGE_FLAG_PRESENT;
+    flags |= reading->water_low ? STORAGE_FLAG_WATER_LOW : 0;
+    flags |= reading->water_cutoff ? STORAGE_FLAG_WATER_CUTOFF : 0;
+    flags |= reading->pump_is_on ? STORAGE_FLAG_PUMP_ON : 0;
+    flags |= reading->ic_zone1_is_on ? STORAGE_FLAG_IC_ZONE1_ON : 0;
+    flags |= reading->fan_is_on ? STORAGE_FLAG_FAN_ON : 0;
+    flags |= reading->mister_is_on ? STORAGE_FLAG_MISTER_ON : 0;
+    flags |= reading->light_is_on ? STORAGE_FLAG_LIGHT_ON : 0;
+    return flags;
+}
+
+static inline void storage_flags_to_reading(uint8_t flags, sensor_reading_t *reading)
+{
+    reading->water_low = (flags & STORAGE_FLAG_WATER_LOW) != 0;
+    reading->water_cutoff = (flags & STORAGE_FLAG_WATER_CUTOFF) != 0;
+    reading->pump_is_on = (flags & STORAGE_FLAG_PUMP_ON) != 0;
+    reading->ic_zone1_is_on = (flags & STORAGE_FLAG_IC_ZONE1_ON) != 0;
+    reading->fan_is_on = (flags & STORAGE_FLAG_FAN_ON) != 0;
+    reading->mister_is_on = (flags & STORAGE_FLAG_MISTER_ON) != 0;
+    reading->light_is_on = (flags & STORAGE_FLAG_LIGHT_ON) != 0;
+}
+
+static inline int8_t to_rssi_i8(int16_t rssi)
+{
+    return rssi < INT8_MIN ? INT8_MIN : (rssi > INT8_MAX ? INT8_MAX : (int8_t)rssi);
+}
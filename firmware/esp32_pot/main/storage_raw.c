@@ -0,0 +1,672 @@
+#include "storage.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_crc.h"
+#include "esp_log.h"
+#include "esp_partition.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+#include "sdkconfig.h"
+
+#include "storage_codec.h"
+
+// Telemetry ring on a dedicated raw partition (CONFIG_PROJECTPLANT_RING_BACKEND_PARTITION),
+// instead of a file on LittleFS. The partition is a circular log of erase
+// sectors, each a header followed by fixed-size slots, and every slot is
+// written exactly once between erases:
+//   - an append programs one slot (a single page program, as slots never
+//     straddle a page) and nothing else: no RAM staging, no file metadata
+//   - the drain cursor is made durable by appending a tail slot
+//   - when the head fills a sector, the next one (the oldest) is erased and
+//     given a header, evicting its readings; sectors are reused strictly in
+//     turn, so every sector sees the same number of erases
+// At boot the head is found from the sector headers and the first erased
+// slot of the newest sector, and the tail from the newest tail slot. A slot
+// is named by its sequence number: sector (seq / slots per sector) % sector
+// count, slot seq % slots per sector. History queries use a per-sector time
+// index held in RAM and rebuilt at boot.
+
+static const char *TAG = "storage";
+
+#define STORAGE_RAW_MAGIC 0x52524C47u    // 'RRLG'
+#define STORAGE_RAW_VERSION 1u
+#define STORAGE_RAW_SECTOR_SIZE 4096u    // SPI flash erase sector
+#define STORAGE_RAW_PAGE_SIZE 256u       // SPI flash program page
+#define STORAGE_RAW_SLOT_SIZE 32u
+#define STORAGE_RAW_SLOTS_PER_SECTOR ((STORAGE_RAW_SECTOR_SIZE - STORAGE_RAW_SLOT_SIZE) / STORAGE_RAW_SLOT_SIZE)
+#define STORAGE_RAW_READ_CHUNK (STORAGE_RAW_PAGE_SIZE / STORAGE_RAW_SLOT_SIZE)  // slots per read
+#define STORAGE_RAW_MIN_SECTORS 3        // head, one being evicted, and data in between
+
+#define STORAGE_RAW_SLOT_SAMPLE 0x5Au
+#define STORAGE_RAW_SLOT_TAIL 0x7Eu
+
+// First sector slot; the sector's readings follow it
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t slot_size;
+    uint16_t slots_per_sector;
+    uint16_t sector_count;
+    uint32_t sector_seq;         // sequence number of the sector's first slot
+    uint8_t reserved[12];
+    uint32_t crc32;              // esp_crc32_le over every byte before this field
+} storage_raw_header_t;
+
+typedef struct __attribute__((packed)) {
+    uint8_t type;                // STORAGE_RAW_SLOT_*; erased slots read 0xFF
+    uint8_t flags;               // STORAGE_FLAG_*
+    int8_t rssi;
+    uint8_t reserved;
+    uint32_t seq;                // must equal the slot's sequence number to be valid
+    union {
+        struct __attribute__((packed)) {
+            uint64_t timestamp_ms;
+            uint32_t uptime_s;
+            uint16_t soil_raw;
+            uint16_t soil_centi_pct;
+            int16_t temperature_centi_c;
+            uint16_t humidity_centi_pct;
+            uint16_t battery_mv;   // 0 = not measured
+        } sample;
+        struct __attribute__((packed)) {
+            uint32_t tail_seq;     // every slot before this one has been delivered
+        } tail;
+    };
+    uint16_t crc16;              // esp_crc16_le over every byte before this field
+} storage_raw_slot_t;
+
+_Static_assert(sizeof(storage_raw_header_t) == STORAGE_RAW_SLOT_SIZE &&
+               sizeof(storage_raw_slot_t) == STORAGE_RAW_SLOT_SIZE,
+               "headers and slots share one slot size");
+_Static_assert(STORAGE_RAW_PAGE_SIZE % STORAGE_RAW_SLOT_SIZE == 0, "a slot must not straddle a page");
+
+static StaticSemaphore_t s_lock_buf;
+static SemaphoreHandle_t s_lock = NULL;
+static const esp_partition_t *s_part = NULL;
+static bool s_ready = false;
+static uint32_t s_sector_count = 0;
+static uint32_t s_head_seq = 0;         // slot the next append takes
+static uint32_t s_head_sector_seq = 0;  // first slot of the sector head is in (opened)
+static uint32_t s_tail_seq = 0;         // oldest undelivered slot
+static bool s_tail_durable = true;      // s_tail_seq is what the newest tail slot says
+static uint32_t s_retained_seq = 0;     // oldest slot still on flash, delivered or not
+
+// Time range of each sector's readings, indexed by sector number
+typedef struct {
+    uint64_t first_ms;
+    uint64_t last_ms;
+    uint32_t sector_seq;         // sector the range belongs to; 0 = no readings
+} storage_raw_index_entry_t;
+
+static storage_raw_index_entry_t *s_index = NULL;
+
+static uint32_t sector_of(uint32_t seq)
+{
+    return (seq / STORAGE_RAW_SLOTS_PER_SECTOR) % s_sector_count;
+}
+
+static uint32_t sector_start(uint32_t seq)
+{
+    return seq - seq % STORAGE_RAW_SLOTS_PER_SECTOR;
+}
+
+static size_t slot_address(uint32_t seq)
+{
+    return (size_t)sector_of(seq) * STORAGE_RAW_SECTOR_SIZE +
+           (1 + seq % STORAGE_RAW_SLOTS_PER_SECTOR) * STORAGE_RAW_SLOT_SIZE;
+}
+
+// Oldest slot the ring still holds: everything in the other sectors
+static uint32_t storage_raw_oldest_locked(void)
+{
+    return s_head_sector_seq - (s_sector_count - 1) * STORAGE_RAW_SLOTS_PER_SECTOR;
+}
+
+static void storage_raw_index_add(uint32_t seq, uint64_t timestamp_ms)
+{
+    storage_raw_index_entry_t *entry = &s_index[sector_of(seq)];
+    uint32_t sector_seq = sector_start(seq);
+    if (entry->sector_seq != sector_seq) {
+        entry->sector_seq = sector_seq;
+        entry->first_ms = timestamp_ms;
+        entry->last_ms = timestamp_ms;
+        return;
+    }
+    entry->first_ms = timestamp_ms < entry->first_ms ? timestamp_ms : entry->first_ms;
+    entry->last_ms = timestamp_ms > entry->last_ms ? timestamp_ms : entry->last_ms;
+}
+
+static bool storage_raw_index_overlaps(uint32_t sector_seq, uint64_t from_ms, uint64_t to_ms)
+{
+    const storage_raw_index_entry_t *entry = &s_index[sector_of(sector_seq)];
+    return entry->sector_seq == sector_seq && entry->first_ms <= to_ms && entry->last_ms >= from_ms;
+}
+
+static uint32_t header_crc(const storage_raw_header_t *header)
+{
+    return esp_crc32_le(0, (const uint8_t *)header, offsetof(storage_raw_header_t, crc32));
+}
+
+static uint16_t slot_crc(const storage_raw_slot_t *slot)
+{
+    return esp_crc16_le(0, (const uint8_t *)slot, offsetof(storage_raw_slot_t, crc16));
+}
+
+static bool slot_erased(const storage_raw_slot_t *slot)
+{
+    const uint8_t *bytes = (const uint8_t *)slot;
+    for (size_t i = 0; i < sizeof(*slot); ++i) {
+        if (bytes[i] != 0xFF) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool slot_valid(const storage_raw_slot_t *slot, uint32_t seq)
+{
+    return (slot->type == STORAGE_RAW_SLOT_SAMPLE || slot->type == STORAGE_RAW_SLOT_TAIL) &&
+           slot->seq == seq && slot->crc16 == slot_crc(slot);
+}
+
+// Sequence number of the sector's first slot, or false if its header is not ours
+static bool storage_raw_read_header(uint32_t sector, uint32_t *out_sector_seq)
+{
+    storage_raw_header_t header;
+    if (esp_partition_read(s_part, (size_t)sector * STORAGE_RAW_SECTOR_SIZE, &header, sizeof(header)) != ESP_OK) {
+        return false;
+    }
+    if (header.magic != STORAGE_RAW_MAGIC || header.version != STORAGE_RAW_VERSION ||
+        header.slot_size != STORAGE_RAW_SLOT_SIZE || header.slots_per_sector != STORAGE_RAW_SLOTS_PER_SECTOR ||
+        header.sector_count != s_sector_count || header.crc32 != header_crc(&header) ||
+        header.sector_seq % STORAGE_RAW_SLOTS_PER_SECTOR != 0 ||
+        (header.sector_seq / STORAGE_RAW_SLOTS_PER_SECTOR) % s_sector_count != sector) {
+        return false;
+    }
+    *out_sector_seq = header.sector_seq;
+    return true;
+}
+
+// Erase the sector the head has reached and stamp it. Its old readings are
+// the oldest in the ring; a tail still inside them moves past them.
+static esp_err_t storage_raw_open_sector_locked(void)
+{
+    uint32_t sector = sector_of(s_head_seq);
+    esp_err_t err = esp_partition_erase_range(s_part, (size_t)sector * STORAGE_RAW_SECTOR_SIZE, STORAGE_RAW_SECTOR_SIZE);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "erase sector %u failed: %s", (unsigned)sector, esp_err_to_name(err));
+        return err;
+    }
+    storage_raw_header_t header = {
+        .magic = STORAGE_RAW_MAGIC,
+        .version = STORAGE_RAW_VERSION,
+        .slot_size = STORAGE_RAW_SLOT_SIZE,
+        .slots_per_sector = STORAGE_RAW_SLOTS_PER_SECTOR,
+        .sector_count = (uint16_t)s_sector_count,
+        .sector_seq = s_head_seq,
+    };
+    header.crc32 = header_crc(&header);
+    err = esp_partition_write(s_part, (size_t)sector * STORAGE_RAW_SECTOR_SIZE, &header, sizeof(header));
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "sector header write failed: %s", esp_err_to_name(err));
+        return err;
+    }
+    s_head_sector_seq = s_head_seq;
+    s_index[sector].sector_seq = 0;
+    uint32_t oldest = storage_raw_oldest_locked();
+    if ((int32_t)(s_tail_seq - oldest) < 0) {
+        s_tail_seq = oldest;
+    }
+    if ((int32_t)(s_retained_seq - oldest) < 0) {
+        s_retained_seq = oldest;
+    }
+    return ESP_OK;
+}
+
+// Program one slot at the head. A failed program still uses the slot up: it
+// may be partly written, and slots are only written once per erase.
+static esp_err_t storage_raw_write_slot_locked(storage_raw_slot_t *slot)
+{
+    if (s_head_seq == s_head_sector_seq + STORAGE_RAW_SLOTS_PER_SECTOR) {
+        esp_err_t err = storage_raw_open_sector_locked();
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+    slot->seq = s_head_seq;
+    slot->crc16 = slot_crc(slot);
+    esp_err_t err = esp_partition_write(s_part, slot_address(s_head_seq), slot, sizeof(*slot));
+    if (err == ESP_OK && slot->type == STORAGE_RAW_SLOT_SAMPLE) {
+        storage_raw_index_add(s_head_seq, slot->sample.timestamp_ms);
+    }
+    s_head_seq++;
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "slot write failed: %s", esp_err_to_name(err));
+    }
+    return err;
+}
+
+// A tail slot written at the tail itself (everything delivered) needs no
+// delivery either, so the tail moves past it.
+static esp_err_t storage_raw_write_tail_locked(void)
+{
+    storage_raw_slot_t slot;
+    memset(&slot, 0, sizeof(slot));
+    slot.type = STORAGE_RAW_SLOT_TAIL;
+    slot.tail.tail_seq = s_tail_seq;
+    uint32_t at = s_head_seq;
+    esp_err_t err = storage_raw_write_slot_locked(&slot);
+    s_tail_durable = err == ESP_OK;
+    if (s_tail_durable && s_tail_seq == at) {
+        s_tail_seq = at + 1;
+    }
+    return err;
+}
+
+// Read up to STORAGE_RAW_READ_CHUNK slots from seq on, staying inside its sector
+static uint32_t storage_raw_read_chunk_locked(uint32_t seq, uint32_t end, storage_raw_slot_t *out)
+{
+    uint32_t n = end - seq;
+    uint32_t to_sector_end = STORAGE_RAW_SLOTS_PER_SECTOR - seq % STORAGE_RAW_SLOTS_PER_SECTOR;
+    n = n > to_sector_end ? to_sector_end : n;
+    n = n > STORAGE_RAW_READ_CHUNK ? STORAGE_RAW_READ_CHUNK : n;
+    if (esp_partition_read(s_part, slot_address(seq), out, n * sizeof(*out)) != ESP_OK) {
+        ESP_LOGE(TAG, "slot read failed at %u", (unsigned)seq);
+        return 0;
+    }
+    return n;
+}
+
+// Newest sector, then its first erased slot; scanning back from there finds
+// the newest tail slot. Sectors that are not in sequence behind the newest
+// one are stale (or half-erased) and get erased when the head reaches them.
+static void storage_raw_recover_locked(void)
+{
+    memset(s_index, 0, s_sector_count * sizeof(*s_index));
+    bool found = false;
+    uint32_t newest = 0;
+    for (uint32_t sector = 0; sector < s_sector_count; ++sector) {
+        uint32_t sector_seq;
+        if (storage_raw_read_header(sector, &sector_seq) && (!found || (int32_t)(sector_seq - newest) > 0)) {
+            newest = sector_seq;
+            found = true;
+        }
+    }
+    if (!found) {
+        // Blank or foreign partition; the first append opens sector 0. Start
+        // one lap in so no live slot ever has sequence number 0.
+        ESP_LOGW(TAG, "No ring on partition '%s'; starting a new one", s_part->label);
+        s_head_seq = s_sector_count * STORAGE_RAW_SLOTS_PER_SECTOR;
+        s_head_sector_seq = s_head_seq - STORAGE_RAW_SLOTS_PER_SECTOR;
+        s_tail_seq = s_head_seq;
+        s_retained_seq = s_head_seq;
+        return;
+    }
+
+    s_head_sector_seq = newest;
+    uint32_t seq = newest;
+    uint32_t end = newest + STORAGE_RAW_SLOTS_PER_SECTOR;
+    uint32_t head = end;
+    while (seq != end && head == end) {
+        storage_raw_slot_t chunk[STORAGE_RAW_READ_CHUNK];
+        uint32_t n = storage_raw_read_chunk_locked(seq, end, chunk);
+        if (n == 0) {
+            break;
+        }
+        for (uint32_t i = 0; i < n; ++i) {
+            if (slot_erased(&chunk[i])) {
+                head = seq + i;
+                break;
+            }
+        }
+        seq += n;
+    }
+    s_head_seq = head;
+
+    // Live sectors run back from the newest one without a gap
+    uint32_t oldest = newest;
+    for (uint32_t k = 1; k < s_sector_count; ++k) {
+        uint32_t want = newest - k * STORAGE_RAW_SLOTS_PER_SECTOR;
+        uint32_t sector_seq;
+        if (!storage_raw_read_header(sector_of(want), &sector_seq) || sector_seq != want) {
+            break;
+        }
+        oldest = want;
+    }
+
+    // Newest tail slot, scanning back a sector at a time
+    bool tail_found = false;
+    uint32_t tail = oldest;
+    for (uint32_t block = newest; !tail_found && (int32_t)(block - oldest) >= 0;
+         block -= STORAGE_RAW_SLOTS_PER_SECTOR) {
+        uint32_t block_end = block == newest ? s_head_seq : block + STORAGE_RAW_SLOTS_PER_SECTOR;
+        for (seq = block; seq != block_end;) {
+            storage_raw_slot_t chunk[STORAGE_RAW_READ_CHUNK];
+            uint32_t n = storage_raw_read_chunk_locked(seq, block_end, chunk);
+            if (n == 0) {
+                break;
+            }
+            for (uint32_t i = 0; i < n; ++i) {
+                if (chunk[i].type == STORAGE_RAW_SLOT_TAIL && slot_valid(&chunk[i], seq + i)) {
+                    tail = chunk[i].tail.tail_seq == seq + i ? seq + i + 1 : chunk[i].tail.tail_seq;
+                    tail_found = true;
+                }
+            }
+            seq += n;
+        }
+    }
+    if ((int32_t)(tail - oldest) < 0 || (int32_t)(tail - s_head_seq) > 0) {
+        tail = oldest;
+    }
+    s_tail_seq = tail;
+    s_tail_durable = true;
+    s_retained_seq = oldest;
+
+    // Time index over every live sector
+    for (seq = oldest; seq != s_head_seq;) {
+        storage_raw_slot_t chunk[STORAGE_RAW_READ_CHUNK];
+        uint32_t n = storage_raw_read_chunk_locked(seq, s_head_seq, chunk);
+        if (n == 0) {
+            seq = sector_start(seq) + STORAGE_RAW_SLOTS_PER_SECTOR;
+            continue;
+        }
+        for (uint32_t i = 0; i < n; ++i) {
+            if (chunk[i].type == STORAGE_RAW_SLOT_SAMPLE && slot_valid(&chunk[i], seq + i)) {
+                storage_raw_index_add(seq + i, chunk[i].sample.timestamp_ms);
+            }
+        }
+        seq += n;
+    }
+    ESP_LOGI(TAG, "Ring on '%s': %u sectors, head %u, tail %u", s_part->label, (unsigned)s_sector_count,
+             (unsigned)s_head_seq, (unsigned)s_tail_seq);
+}
+
+esp_err_t storage_init(void)
+{
+    if (!s_lock) {
+        s_lock = xSemaphoreCreateMutexStatic(&s_lock_buf);
+    }
+    if (s_ready) {
+        return ESP_OK;
+    }
+
+    s_part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY,
+                                      CONFIG_PROJECTPLANT_RING_PARTITION_LABEL);
+    if (!s_part) {
+        ESP_LOGE(TAG, "No '%s' data partition for the telemetry ring", CONFIG_PROJECTPLANT_RING_PARTITION_LABEL);
+        return ESP_ERR_NOT_FOUND;
+    }
+    uint32_t sectors = s_part->size / STORAGE_RAW_SECTOR_SIZE;
+    if (sectors < STORAGE_RAW_MIN_SECTORS || sectors > UINT16_MAX || s_part->address % STORAGE_RAW_SECTOR_SIZE != 0) {
+        ESP_LOGE(TAG, "Partition '%s' must be at least %u sector-aligned sectors", s_part->label,
+                 (unsigned)STORAGE_RAW_MIN_SECTORS);
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    if (!s_index) {
+        s_index = calloc(sectors, sizeof(*s_index));
+        if (!s_index) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_sector_count = sectors;
+    storage_raw_recover_locked();
+    s_ready = true;
+    xSemaphoreGive(s_lock);
+    return ESP_OK;
+}
+
+size_t storage_capacity(void)
+{
+    // Slots outside the sector being evicted; tail slots take a few of them
+    return s_ready ? (size_t)(s_sector_count - 1) * STORAGE_RAW_SLOTS_PER_SECTOR : 0;
+}
+
+size_t storage_count(void)
+{
+    if (!s_ready) {
+        return 0;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    size_t count = s_head_seq - s_tail_seq;  // tail slots included
+    xSemaphoreGive(s_lock);
+    return count;
+}
+
+esp_err_t storage_append_sample(const telemetry_sample_t *sample)
+{
+    if (!s_ready || !sample) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    storage_raw_slot_t slot;
+    memset(&slot, 0, sizeof(slot));
+    slot.type = STORAGE_RAW_SLOT_SAMPLE;
+    slot.flags = storage_flags_from_reading(&sample->reading);
+    slot.rssi = to_rssi_i8(sample->rssi);
+    slot.sample.timestamp_ms = sample->reading.timestamp_ms;
+    slot.sample.uptime_s = (uint32_t)(sample->uptime_ms / 1000);
+    slot.sample.soil_raw = sample->reading.soil_raw;
+    slot.sample.soil_centi_pct = to_centi_u16(sample->reading.soil_percent);
+    slot.sample.temperature_centi_c = to_centi_i16(sample->reading.temperature_c);
+    slot.sample.humidity_centi_pct = to_centi_u16(sample->reading.humidity_pct);
+    slot.sample.battery_mv = to_battery_mv(sample->reading.battery_v);
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    esp_err_t err = storage_raw_write_slot_locked(&slot);
+    xSemaphoreGive(s_lock);
+    return err;
+}
+
+// Appends are durable once storage_append_sample() returns; a tail that could
+// not be written is retried here.
+esp_err_t storage_flush_if_due(void)
+{
+    if (!s_ready) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    esp_err_t err = s_tail_durable ? ESP_OK : storage_raw_write_tail_locked();
+    xSemaphoreGive(s_lock);
+    return err;
+}
+
+esp_err_t storage_flush(void)
+{
+    return storage_flush_if_due();
+}
+
+static void storage_raw_slot_to_sample(const storage_raw_slot_t *slot, telemetry_sample_t *out)
+{
+    memset(out, 0, sizeof(*out));
+    out->reading.timestamp_ms = slot->sample.timestamp_ms;
+    out->uptime_ms = (int64_t)slot->sample.uptime_s * 1000LL;
+    out->rssi = slot->rssi;
+    out->reading.soil_raw = slot->sample.soil_raw;
+    out->reading.soil_percent = from_centi_u16(slot->sample.soil_centi_pct);
+    out->reading.temperature_c = from_centi_i16(slot->sample.temperature_centi_c);
+    out->reading.humidity_pct = from_centi_u16(slot->sample.humidity_centi_pct);
+    out->reading.battery_v = from_battery_mv(slot->sample.battery_mv);
+    storage_flags_to_reading(slot->flags, &out->reading);
+}
+
+// Decode up to max readings from the cursor onward, skipping tail slots and
+// slots that fail their checks, and advance the cursor past everything consumed.
+static size_t storage_raw_read_batch_locked(storage_cursor_t *cursor, telemetry_sample_t *out, size_t max)
+{
+    if ((int32_t)(cursor->seq - s_tail_seq) < 0) {
+        ESP_LOGW(TAG, "%u slots overwritten before upload", (unsigned)(s_tail_seq - cursor->seq));
+        cursor->seq = s_tail_seq;
+    }
+    if (cursor->seq - s_tail_seq > s_head_seq - s_tail_seq) {
+        return 0;  // cursor from before a reset
+    }
+
+    uint32_t seq = cursor->seq;
+    size_t done = 0;
+    while (done < max && seq != s_head_seq) {
+        storage_raw_slot_t chunk[STORAGE_RAW_READ_CHUNK];
+        uint32_t n = storage_raw_read_chunk_locked(seq, s_head_seq, chunk);
+        if (n == 0) {
+            break;
+        }
+        uint32_t i = 0;
+        for (; i < n && done < max; ++i) {
+            if (!slot_valid(&chunk[i], seq + i)) {
+                ESP_LOGW(TAG, "Slot %u is damaged; skipping it", (unsigned)(seq + i));
+            } else if (chunk[i].type == STORAGE_RAW_SLOT_SAMPLE) {
+                storage_raw_slot_to_sample(&chunk[i], &out[done++]);
+            }
+        }
+        seq += i;
+    }
+    cursor->seq = seq;
+    return done;
+}
+
+static esp_err_t storage_raw_set_tail_locked(uint32_t tail_seq)
+{
+    uint32_t dropped = tail_seq - s_tail_seq;
+    if ((int32_t)dropped <= 0 || dropped > s_head_seq - s_tail_seq) {
+        return ESP_OK;  // already dropped (or overwritten) in the meantime
+    }
+    s_tail_seq = tail_seq;
+    return storage_raw_write_tail_locked();
+}
+
+bool storage_peek_oldest(telemetry_sample_t *out)
+{
+    if (!s_ready || !out) {
+        return false;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    storage_cursor_t cursor = {.seq = s_tail_seq};
+    bool ok = storage_raw_read_batch_locked(&cursor, out, 1) == 1;
+    xSemaphoreGive(s_lock);
+    return ok;
+}
+
+esp_err_t storage_drop_oldest(void)
+{
+    if (!s_ready) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    storage_cursor_t cursor = {.seq = s_tail_seq};
+    telemetry_sample_t sample;
+    esp_err_t err = ESP_ERR_INVALID_SIZE;
+    if (storage_raw_read_batch_locked(&cursor, &sample, 1) == 1) {
+        err = storage_raw_set_tail_locked(cursor.seq);
+    }
+    xSemaphoreGive(s_lock);
+    return err;
+}
+
+void storage_cursor_begin(storage_cursor_t *cursor)
+{
+    if (!cursor) {
+        return;
+    }
+    cursor->seq = 0;
+    if (!s_ready) {
+        return;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    cursor->seq = s_tail_seq;
+    xSemaphoreGive(s_lock);
+}
+
+size_t storage_read_batch(storage_cursor_t *cursor, telemetry_sample_t *out, size_t max)
+{
+    if (!s_ready || !cursor || !out || max == 0) {
+        return 0;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    size_t done = storage_raw_read_batch_locked(cursor, out, max);
+    xSemaphoreGive(s_lock);
+    return done;
+}
+
+esp_err_t storage_commit_cursor(const storage_cursor_t *cursor)
+{
+    if (!s_ready || !cursor) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    esp_err_t err = storage_raw_set_tail_locked(cursor->seq);
+    xSemaphoreGive(s_lock);
+    return err;
+}
+
+void storage_history_begin(storage_history_t *query, uint64_t from_ms, uint64_t to_ms)
+{
+    if (!query) {
+        return;
+    }
+    query->seq = 0;
+    query->from_ms = from_ms;
+    query->to_ms = to_ms;
+    if (!s_ready) {
+        return;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    query->seq = s_retained_seq;
+    xSemaphoreGive(s_lock);
+}
+
+// Sectors the index rules out are not read; damaged slots are skipped quietly,
+// the drain reports those in its own range.
+static size_t storage_raw_history_read_locked(storage_history_t *query, telemetry_sample_t *out, size_t max)
+{
+    if ((int32_t)(query->seq - s_retained_seq) < 0) {
+        query->seq = s_retained_seq;  // the ring overwrote part of the window meanwhile
+    }
+    if (query->seq - s_retained_seq > s_head_seq - s_retained_seq) {
+        return 0;  // query from before a reset
+    }
+
+    uint32_t seq = query->seq;
+    size_t done = 0;
+    while (done < max && seq != s_head_seq) {
+        uint32_t sector_seq = sector_start(seq);
+        uint32_t sector_end = sector_seq + STORAGE_RAW_SLOTS_PER_SECTOR;
+        uint32_t run_end = (int32_t)(s_head_seq - sector_end) < 0 ? s_head_seq : sector_end;
+        if (!storage_raw_index_overlaps(sector_seq, query->from_ms, query->to_ms)) {
+            seq = run_end;
+            continue;
+        }
+        storage_raw_slot_t chunk[STORAGE_RAW_READ_CHUNK];
+        uint32_t n = storage_raw_read_chunk_locked(seq, run_end, chunk);
+        if (n == 0) {
+            break;
+        }
+        uint32_t i = 0;
+        for (; i < n && done < max; ++i) {
+            if (chunk[i].type == STORAGE_RAW_SLOT_SAMPLE && slot_valid(&chunk[i], seq + i) &&
+                chunk[i].sample.timestamp_ms >= query->from_ms && chunk[i].sample.timestamp_ms <= query->to_ms) {
+                storage_raw_slot_to_sample(&chunk[i], &out[done++]);
+            }
+        }
+        seq += i;
+    }
+    query->seq = seq;
+    return done;
+}
+
+size_t storage_history_read(storage_history_t *query, telemetry_sample_t *out, size_t max)
+{
+    if (!s_ready || !query || !out || max == 0) {
+        return 0;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    size_t done = storage_raw_history_read_locked(query, out, max);
+    xSemaphoreGive(s_lock);
+    return done;
+}
@@ -0,0 +1,56 @@
+#include "th_sensor.h"
+
+#include <stddef.h>
+
+#include "esp_log.h"
+#include "sdkconfig.h"
+
+#include "aht10.h"
+#include "i2c_bus.h"
+#include "sht4x.h"
+
+#define TH_SENSOR_PROBE_TIMEOUT_MS 20
+
+static const char *TAG = "th_sensor";
+
+// Probe order; the addresses differ, so a probe cannot pick the wrong part
+static const th_sensor_driver_t *const candidates[] = {
+#if CONFIG_PROJECTPLANT_TH_SENSOR_AUTO || CONFIG_PROJECTPLANT_TH_SENSOR_SHT4X
+    &sht4x_driver,
+#endif
+#if CONFIG_PROJECTPLANT_TH_SENSOR_AUTO || CONFIG_PROJECTPLANT_TH_SENSOR_AHT10
+    &aht10_driver,
+#endif
+};
+
+static const th_sensor_driver_t *active = NULL;
+
+esp_err_t th_sensor_detect(void)
+{
+    if (active) {
+        return ESP_OK;
+    }
+    for (size_t i = 0; i < sizeof(candidates) / sizeof(candidates[0]); ++i) {
+        const th_sensor_driver_t *driver = candidates[i];
+        esp_err_t err = i2c_bus_probe(driver->address, TH_SENSOR_PROBE_TIMEOUT_MS);
+        if (err != ESP_OK) {
+            continue;
+        }
+        err = driver->init();
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "%s at 0x%02x did not initialize: %s", driver->name, (unsigned)driver->address,
+                     esp_err_to_name(err));
+            continue;
+        }
+        active = driver;
+        ESP_LOGI(TAG, "%s at 0x%02x, %u ms conversion", driver->name, (unsigned)driver->address,
+                 (unsigned)driver->conversion_ms);
+        return ESP_OK;
+    }
+    return ESP_ERR_NOT_FOUND;
+}
+
+const th_sensor_driver_t *th_sensor_active(void)
+{
+    return active;
+}
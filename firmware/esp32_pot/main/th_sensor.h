@@ -0,0 +1,28 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "esp_err.h"
+
+// Temperature/RH sensor drivers behind one interface, so one image runs on
+// boards fitted with either part. The driver is picked once at boot
+// (ProjectPlant Pot Node → Temperature/humidity sensor); sensors.c only
+// talks to th_sensor_active().
+
+typedef struct {
+    const char *name;
+    uint16_t address;                  // 7-bit, probed by th_sensor_detect()
+    uint32_t conversion_ms;            // trigger to result, worst case
+    // Once, after i2c_bus_init() with the sensor rail up
+    esp_err_t (*init)(void);
+    esp_err_t (*trigger)(void);
+    // Waits only for what is left of conversion_ms since the trigger
+    esp_err_t (*fetch)(float *temperature_c, float *humidity_pct);
+} th_sensor_driver_t;
+
+// Find and initialize the fitted sensor; call with the sensor rail powered.
+// Returns ESP_ERR_NOT_FOUND when no known sensor answers.
+esp_err_t th_sensor_detect(void);
+
+// The detected driver, or NULL before detection or when none was found
+const th_sensor_driver_t *th_sensor_active(void);
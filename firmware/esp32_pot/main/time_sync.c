@@ -1,32 +1,275 @@
 #include "time_sync.h"
 
+#include <stddef.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/time.h>
 #include <time.h>
 
+#include "esp_attr.h"
+#include "esp_crc.h"
 #include "esp_err.h"
 #include "esp_log.h"
 #include "esp_netif_sntp.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 
+#include "hardware_config.h"
+#include "preferences.h"
+
+#define TIME_BASE_MAGIC   0x54494D45u  // "TIME"
+#define TIME_NAMESPACE    "device"
+#define TIME_KEY          "time_base"
+#define TIME_BLOB_VERSION 1
+
 static const char *TAG = "time_sync";
 static const time_t MIN_VALID_EPOCH = 1609459200; // 2021-01-01T00:00:00Z
 
+typedef enum {
+    TIME_SOURCE_NONE = 0,
+    TIME_SOURCE_ESTIMATED,   // seeded by time_sync_restore()
+    TIME_SOURCE_SYNCED,      // SNTP or the relay gateway, this boot
+} time_source_t;
+
+// All times in epoch us. A positive drift means the clock gains on true time.
+typedef struct {
+    uint32_t magic;
+    int32_t drift_ppm;
+    uint32_t drift_known;
+    uint32_t reserved;
+    int64_t synced_us;        // true time at the last sync; 0 = none since power-on
+    int64_t corrected_us;     // drift correction stepped in since synced_us
+    int64_t span_start_us;    // true time the drift measurement runs from
+    int64_t span_stepped_us;  // every step made to the clock since span_start_us
+    uint32_t crc32;           // esp_crc32_le over the bytes before this field
+} time_base_t;
+
+// What survives a power cycle: a lower bound for the time, and the drift
+typedef struct {
+    uint8_t version;
+    uint8_t drift_known;
+    uint8_t reserved[2];
+    int32_t drift_ppm;
+    uint64_t epoch_ms;
+    uint32_t crc32;           // esp_crc32_le over every byte before this field
+} time_blob_t;
+
+// Survives deep sleep and every reset but a power cycle; checked at boot
+static RTC_NOINIT_ATTR time_base_t rtc_base;
+
+static portMUX_TYPE time_lock = portMUX_INITIALIZER_UNLOCKED;
+static time_source_t source = TIME_SOURCE_NONE;
+// The clock runs on esp_timer while awake: anchor + elapsed timer is what it
+// read just before SNTP stepped it
+static int64_t anchor_clock_us;
+static int64_t anchor_timer_us;
+// Timestamps from the estimated clock lie in [estimate_from_ms, step_at_ms]
+// and are off by step_ms
+static uint64_t estimate_from_ms;
+static uint64_t step_at_ms;
+static int64_t step_ms;
+static bool step_known = false;
+
+static time_blob_t saved;
+static bool saved_valid = false;
+
 static bool sntp_started = false;
+static time_sync_callback_t sync_callback = NULL;
 
 static bool is_epoch_valid(time_t now)
 {
     return now >= MIN_VALID_EPOCH;
 }
 
-esp_err_t time_sync_init(void)
+static int64_t clock_now_us(void)
+{
+    struct timeval tv = {0};
+    gettimeofday(&tv, NULL);
+    return (int64_t)tv.tv_sec * 1000000LL + tv.tv_usec;
+}
+
+static void clock_set_us(int64_t epoch_us)
+{
+    struct timeval tv = {
+        .tv_sec = (time_t)(epoch_us / 1000000LL),
+        .tv_usec = (suseconds_t)(epoch_us % 1000000LL),
+    };
+    settimeofday(&tv, NULL);
+}
+
+static uint32_t base_crc(const time_base_t *base)
+{
+    return esp_crc32_le(TIME_BASE_MAGIC, (const uint8_t *)base, offsetof(time_base_t, crc32));
+}
+
+static uint32_t blob_crc(const time_blob_t *blob)
+{
+    return esp_crc32_le(0, (const uint8_t *)blob, offsetof(time_blob_t, crc32));
+}
+
+static void load_saved(void)
+{
+    size_t len = sizeof(saved);
+    esp_err_t err = prefs_get_blob(TIME_NAMESPACE, TIME_KEY, &saved, &len);
+    saved_valid = err == ESP_OK &&
+                  len == sizeof(saved) &&
+                  saved.version == TIME_BLOB_VERSION &&
+                  saved.crc32 == blob_crc(&saved) &&
+                  is_epoch_valid((time_t)(saved.epoch_ms / 1000ULL));
+}
+
+// Deferred: the SNTP task must not wait on flash
+static void save_if_due(const time_blob_t *blob)
+{
+    if (saved_valid &&
+        blob->epoch_ms < saved.epoch_ms + TIME_SAVE_INTERVAL_MS &&
+        blob->drift_known == saved.drift_known &&
+        abs(blob->drift_ppm - saved.drift_ppm) < TIME_DRIFT_SAVE_PPM) {
+        return;
+    }
+    esp_err_t err = prefs_defer_blob(TIME_NAMESPACE, TIME_KEY, blob, sizeof(*blob));
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to save the time base: %s", esp_err_to_name(err));
+        return;
+    }
+    saved = *blob;
+    saved_valid = true;
+}
+
+void time_sync_restore(void)
+{
+    setenv("TZ", "UTC0", 1);
+    tzset();
+    load_saved();
+    if (rtc_base.magic != TIME_BASE_MAGIC || rtc_base.crc32 != base_crc(&rtc_base)) {
+        memset(&rtc_base, 0, sizeof(rtc_base));
+        rtc_base.magic = TIME_BASE_MAGIC;
+        if (saved_valid) {
+            rtc_base.drift_ppm = saved.drift_ppm;
+            rtc_base.drift_known = saved.drift_known;
+        }
+    }
+
+    int64_t now_us = clock_now_us();
+    const char *seed = NULL;
+    if (is_epoch_valid((time_t)(now_us / 1000000LL))) {
+        // The RTC kept the clock through deep sleep or a reset; take out the
+        // drift it gathered since the last sync
+        int64_t raw_us = now_us - rtc_base.synced_us - rtc_base.corrected_us;
+        if (rtc_base.synced_us && rtc_base.drift_known && raw_us > 0) {
+            int64_t target_us = -(raw_us * rtc_base.drift_ppm) / 1000000LL;
+            int64_t delta_us = target_us - rtc_base.corrected_us;
+            if (delta_us) {
+                now_us += delta_us;
+                clock_set_us(now_us);
+                rtc_base.corrected_us = target_us;
+                rtc_base.span_stepped_us += delta_us;
+            }
+        }
+        seed = "kept by the RTC";
+    } else if (saved_valid) {
+        // Power was off for an unknown time: this is a lower bound
+        now_us = (int64_t)saved.epoch_ms * 1000LL;
+        clock_set_us(now_us);
+        seed = "last sync saved in NVS";
+    }
+    rtc_base.crc32 = base_crc(&rtc_base);
+
+    portENTER_CRITICAL(&time_lock);
+    anchor_clock_us = now_us;
+    anchor_timer_us = esp_timer_get_time();
+    if (seed) {
+        source = TIME_SOURCE_ESTIMATED;
+        estimate_from_ms = (uint64_t)now_us / 1000ULL;
+    }
+    portEXIT_CRITICAL(&time_lock);
+    if (seed) {
+        ESP_LOGI(TAG, "Clock estimated (%s, drift %ld ppm%s)", seed, (long)rtc_base.drift_ppm,
+                 rtc_base.drift_known ? "" : ", not measured yet");
+    }
+}
+
+// before_us: what the clock read just before it was set to true_us
+static void discipline(int64_t before_us, int64_t true_us)
+{
+    time_blob_t blob = {
+        .version = TIME_BLOB_VERSION,
+        .epoch_ms = (uint64_t)true_us / 1000ULL,
+    };
+    int64_t measured_ppm = 0;
+    bool measured = false;
+
+    portENTER_CRITICAL(&time_lock);
+    bool first = source != TIME_SOURCE_SYNCED;
+    if (source == TIME_SOURCE_ESTIMATED) {
+        step_at_ms = (uint64_t)before_us / 1000ULL;
+        step_ms = (true_us - before_us) / 1000LL;
+        step_known = true;
+    }
+    source = TIME_SOURCE_SYNCED;
+    anchor_clock_us = true_us;
+    anchor_timer_us = esp_timer_get_time();
+
+    time_base_t *base = &rtc_base;
+    int64_t span_us = true_us - base->span_start_us;
+    if (!base->span_start_us || span_us <= 0) {
+        base->span_start_us = true_us;
+        base->span_stepped_us = 0;
+    } else if (span_us >= (int64_t)TIME_DRIFT_MIN_SPAN_MS * 1000LL) {
+        // How far the clock ran on its own, steps taken out, against truth
+        int64_t raw_us = before_us - base->span_start_us - base->span_stepped_us;
+        measured_ppm = ((raw_us - span_us) * 1000000LL) / span_us;
+        if (measured_ppm > TIME_DRIFT_MAX_PPM) {
+            measured_ppm = TIME_DRIFT_MAX_PPM;
+        } else if (measured_ppm < -TIME_DRIFT_MAX_PPM) {
+            measured_ppm = -TIME_DRIFT_MAX_PPM;
+        }
+        base->drift_ppm = base->drift_known ? (int32_t)((base->drift_ppm + measured_ppm) / 2) : (int32_t)measured_ppm;
+        base->drift_known = 1;
+        base->span_start_us = true_us;
+        base->span_stepped_us = 0;
+        measured = true;
+    } else {
+        base->span_stepped_us += true_us - before_us;
+    }
+    base->synced_us = true_us;
+    base->corrected_us = 0;
+    base->crc32 = base_crc(base);
+    blob.drift_ppm = base->drift_ppm;
+    blob.drift_known = (uint8_t)base->drift_known;
+    portEXIT_CRITICAL(&time_lock);
+
+    if (measured) {
+        ESP_LOGI(TAG, "Clock synchronized, off by %lld ms; drift %lld ppm, estimate now %ld ppm",
+                 (long long)((true_us - before_us) / 1000LL), (long long)measured_ppm, (long)blob.drift_ppm);
+    } else {
+        ESP_LOGI(TAG, "Clock synchronized, off by %lld ms", (long long)((true_us - before_us) / 1000LL));
+    }
+    save_if_due(&blob);
+    if (first && sync_callback) {
+        sync_callback();
+    }
+}
+
+// SNTP task, after it has set the clock
+static void on_sntp_sync(struct timeval *tv)
+{
+    portENTER_CRITICAL(&time_lock);
+    int64_t before_us = anchor_clock_us + (esp_timer_get_time() - anchor_timer_us);
+    portEXIT_CRITICAL(&time_lock);
+    discipline(before_us, (int64_t)tv->tv_sec * 1000000LL + tv->tv_usec);
+}
+
+esp_err_t time_sync_init(time_sync_callback_t on_sync)
 {
     if (sntp_started) {
         return ESP_OK;
     }
 
-    const esp_sntp_config_t config = ESP_NETIF_SNTP_DEFAULT_CONFIG("pool.ntp.org");
+    sync_callback = on_sync;
+    esp_sntp_config_t config = ESP_NETIF_SNTP_DEFAULT_CONFIG("pool.ntp.org");
+    config.sync_cb = on_sntp_sync;
     esp_err_t err = esp_netif_sntp_init(&config);
     if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) {
         ESP_LOGE(TAG, "Failed to init SNTP: %s", esp_err_to_name(err));
@@ -60,19 +303,51 @@ bool time_sync_is_time_valid(void)
     return false;
 }
 
-bool time_sync_wait_for_valid(TickType_t timeout_ticks)
+bool time_sync_is_synced(void)
 {
-    const TickType_t delay = pdMS_TO_TICKS(500);
-    TickType_t waited = 0;
+    portENTER_CRITICAL(&time_lock);
+    bool synced = source == TIME_SOURCE_SYNCED;
+    portEXIT_CRITICAL(&time_lock);
+    return synced;
+}
 
-    while (!time_sync_is_time_valid()) {
-        if (timeout_ticks != portMAX_DELAY && waited >= timeout_ticks) {
-            return time_sync_is_time_valid();
-        }
-        vTaskDelay(delay);
-        if (timeout_ticks != portMAX_DELAY) {
-            waited += delay;
-        }
+void time_sync_set_epoch_ms(uint64_t epoch_ms)
+{
+    int64_t true_us = (int64_t)epoch_ms * 1000LL;
+    int64_t before_us = clock_now_us();
+    clock_set_us(true_us);
+    discipline(before_us, true_us);
+}
+
+uint64_t time_sync_boot_to_epoch_ms(uint64_t uptime_ms)
+{
+    struct timeval tv = {0};
+    if (!time_sync_is_time_valid() || gettimeofday(&tv, NULL) != 0) {
+        return 0;
+    }
+    uint64_t now_uptime_ms = (uint64_t)(esp_timer_get_time() / 1000);
+    if (uptime_ms > now_uptime_ms) {
+        return 0;
+    }
+    uint64_t now_ms = ((uint64_t)tv.tv_sec * 1000ULL) + ((uint64_t)tv.tv_usec / 1000ULL);
+    return now_ms - (now_uptime_ms - uptime_ms);
+}
+
+uint64_t time_sync_refine_epoch_ms(uint64_t epoch_ms, bool *estimated)
+{
+    bool still_estimated = false;
+    portENTER_CRITICAL(&time_lock);
+    if (source == TIME_SOURCE_ESTIMATED) {
+        still_estimated = epoch_ms >= estimate_from_ms;
+    } else if (step_known && epoch_ms >= estimate_from_ms && epoch_ms <= step_at_ms &&
+               // After a backward step the synced clock revisits part of the
+               // range; leave that part alone, it is off by less than the step
+               (step_ms >= 0 || (int64_t)epoch_ms < (int64_t)step_at_ms + step_ms)) {
+        epoch_ms = (uint64_t)((int64_t)epoch_ms + step_ms);
+    }
+    portEXIT_CRITICAL(&time_lock);
+    if (estimated) {
+        *estimated = still_estimated;
     }
-    return true;
+    return epoch_ms;
 }
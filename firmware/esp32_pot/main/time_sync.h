@@ -1,6 +1,7 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <time.h>
 
 #include "esp_err.h"
@@ -10,26 +11,64 @@
 extern "C" {
 #endif
 
+// Called once per boot, when the clock is first synchronized (from the SNTP
+// task, or from whoever calls time_sync_set_epoch_ms())
+typedef void (*time_sync_callback_t)(void);
+
 /**
- * Initialize SNTP time synchronization service.
+ * Seed the system clock from the saved time base, before anything reads it.
  *
- * Safe to call multiple times; subsequent calls are no-ops.
+ * Across deep sleep and resets the RTC keeps the clock; the drift it gathered
+ * since the last sync is taken out using the measured drift rate. After a
+ * power cycle the clock starts at the last synced time saved in NVS. Either
+ * way the clock is only estimated until SNTP (or the relay gateway) answers.
+ * Call once from app_main after prefs_init().
  */
-esp_err_t time_sync_init(void);
+void time_sync_restore(void);
 
 /**
- * Wait until the system clock has been synchronized to a valid epoch.
+ * Initialize SNTP time synchronization service. Never waits for an answer;
+ * on_sync runs when the first one arrives.
  *
- * @param timeout_ticks Maximum time to wait (FreeRTOS ticks). Pass portMAX_DELAY to wait indefinitely.
- * @return true if time became valid before timeout, false otherwise.
+ * Safe to call multiple times; subsequent calls are no-ops.
  */
-bool time_sync_wait_for_valid(TickType_t timeout_ticks);
+esp_err_t time_sync_init(time_sync_callback_t on_sync);
 
 /**
- * Returns true when the current system time is considered valid.
+ * Returns true when the current system time is considered valid: synced,
+ * or estimated by time_sync_restore().
  */
 bool time_sync_is_time_valid(void);
 
+/**
+ * Returns true once SNTP or time_sync_set_epoch_ms() set the clock this boot.
+ */
+bool time_sync_is_synced(void);
+
+/**
+ * Set the clock from another trusted source (the relay gateway's ack). Counts
+ * as a sync: drift is measured against it and on_sync runs if this is the
+ * first one.
+ */
+void time_sync_set_epoch_ms(uint64_t epoch_ms);
+
+/**
+ * Map a boot-relative timestamp (ms of esp_timer uptime, as taken before the
+ * clock was synced) to epoch milliseconds.
+ *
+ * @return The epoch time of that moment, or 0 if the clock is not valid yet or
+ *         the timestamp cannot belong to this boot.
+ */
+uint64_t time_sync_boot_to_epoch_ms(uint64_t uptime_ms);
+
+/**
+ * Correct an epoch timestamp taken from this boot's estimated clock by the
+ * step the first sync made. *estimated is set when the timestamp still rests
+ * on the estimate (no sync yet); timestamps from the synced clock or an
+ * earlier boot come back unchanged.
+ */
+uint64_t time_sync_refine_epoch_ms(uint64_t epoch_ms, bool *estimated);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,220 @@
+#include "watering.h"
+
+#include <math.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "actuator_timer.h"
+#include "device_identity.h"
+#include "hardware_config.h"
+#include "sensors.h"
+#include "soil_filter.h"
+
+static const char *TAG = "watering";
+
+typedef struct {
+    float target_pct;
+    uint32_t max_ms;
+    char request_id[WATERING_REQUEST_ID_LEN];
+} watering_request_t;
+
+static TaskHandle_t watering_task_handle;
+static StaticTask_t watering_task_tcb;
+static StackType_t watering_task_stack[WATERING_TASK_STACK];
+static watering_done_cb_t done_cb;
+static portMUX_TYPE request_lock = portMUX_INITIALIZER_UNLOCKED;
+static watering_request_t pending;
+static bool pending_valid = false;
+static volatile bool running = false;
+
+const char *watering_stop_reason_name(watering_stop_t reason)
+{
+    switch (reason) {
+    case WATERING_STOP_TARGET:
+        return "target";
+    case WATERING_STOP_LIMIT:
+        return "limit";
+    case WATERING_STOP_CUTOFF:
+        return "cutoff";
+    case WATERING_STOP_INTERRUPTED:
+        return "interrupted";
+    case WATERING_STOP_SENSOR_FAULT:
+        return "sensor_fault";
+    default:
+        return "unknown";
+    }
+}
+
+static bool take_pending(watering_request_t *out)
+{
+    taskENTER_CRITICAL(&request_lock);
+    bool valid = pending_valid;
+    if (valid) {
+        *out = pending;
+        pending_valid = false;
+    }
+    taskEXIT_CRITICAL(&request_lock);
+    return valid;
+}
+
+static bool has_pending(void)
+{
+    taskENTER_CRITICAL(&request_lock);
+    bool valid = pending_valid;
+    taskEXIT_CRITICAL(&request_lock);
+    return valid;
+}
+
+static float sample_pct(void)
+{
+    uint16_t raw = 0;
+    if (sensors_sample_soil(&raw) != ESP_OK) {
+        return NAN;
+    }
+    return (float)soil_counts_to_centipercent(raw) / 100.0f;
+}
+
+static void run(const watering_request_t *req, watering_result_t *result)
+{
+    memset(result, 0, sizeof(*result));
+    result->target_pct = req->target_pct;
+    memcpy(result->request_id, req->request_id, sizeof(result->request_id));
+    result->start_pct = sample_pct();
+    result->end_pct = result->start_pct;
+    if (isnan(result->start_pct)) {
+        result->reason = WATERING_STOP_SENSOR_FAULT;
+        return;
+    }
+    if (result->start_pct >= req->target_pct) {
+        result->reason = WATERING_STOP_TARGET;
+        return;
+    }
+
+    int64_t start_us = esp_timer_get_time();
+    const char *request_id = req->request_id[0] ? req->request_id : NULL;
+    esp_err_t err = actuator_timer_set(NODE_SCHEDULE_TARGET_PUMP, true,
+                                       req->max_ms + WATERING_BACKSTOP_MARGIN_MS, request_id);
+    if (err != ESP_OK || !sensors_get_pump_state()) {
+        if (err == ESP_OK) {
+            // Blocked by a low cutoff float; drop the armed timer
+            actuator_timer_set(NODE_SCHEDULE_TARGET_PUMP, false, 0, NULL);
+        }
+        result->reason = err == ESP_OK ? WATERING_STOP_CUTOFF : WATERING_STOP_INTERRUPTED;
+        return;
+    }
+    ESP_LOGI(TAG, "Watering from %.1f%% to %.1f%% (max %u ms)",
+             (double)result->start_pct, (double)req->target_pct, (unsigned)req->max_ms);
+
+    unsigned at_target = 0;
+    unsigned faults = 0;
+    bool stop_pump = true;
+    while (true) {
+        vTaskDelay(pdMS_TO_TICKS(WATERING_SAMPLE_INTERVAL_MS));
+        if (has_pending()) {
+            // The next run takes over the pump
+            result->reason = WATERING_STOP_INTERRUPTED;
+            stop_pump = false;
+            break;
+        }
+        if (!sensors_get_pump_state()) {
+            result->reason = sensors_last_cutoff_us() >= start_us
+                ? WATERING_STOP_CUTOFF : WATERING_STOP_INTERRUPTED;
+            stop_pump = false;
+            break;
+        }
+        if (esp_timer_get_time() - start_us >= (int64_t)req->max_ms * 1000) {
+            result->reason = WATERING_STOP_LIMIT;
+            break;
+        }
+        float pct = sample_pct();
+        if (isnan(pct)) {
+            if (++faults >= WATERING_TARGET_CONFIRM) {
+                result->reason = WATERING_STOP_SENSOR_FAULT;
+                break;
+            }
+            continue;
+        }
+        faults = 0;
+        result->end_pct = pct;
+        at_target = pct >= req->target_pct ? at_target + 1 : 0;
+        if (at_target >= WATERING_TARGET_CONFIRM) {
+            result->reason = WATERING_STOP_TARGET;
+            break;
+        }
+    }
+    if (stop_pump) {
+        actuator_timer_set(NODE_SCHEDULE_TARGET_PUMP, false, 0, NULL);
+    }
+    result->delivered_ms = (uint32_t)((esp_timer_get_time() - start_us) / 1000);
+}
+
+static void watering_task(void *arg)
+{
+    (void)arg;
+    watering_request_t req;
+    watering_result_t result;
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        while (take_pending(&req)) {
+            running = true;
+            run(&req, &result);
+            running = has_pending();
+            ESP_LOGI(TAG, "Watering stopped (%s) after %u ms at %.1f%%",
+                     watering_stop_reason_name(result.reason), (unsigned)result.delivered_ms,
+                     (double)result.end_pct);
+            if (done_cb) {
+                done_cb(&result);
+            }
+        }
+    }
+}
+
+esp_err_t watering_init(watering_done_cb_t on_done)
+{
+    done_cb = on_done;
+    if (watering_task_handle) {
+        return ESP_OK;
+    }
+    watering_task_handle = xTaskCreateStaticPinnedToCore(watering_task, "watering_task", WATERING_TASK_STACK, NULL,
+                                                         WATERING_TASK_PRIORITY, watering_task_stack,
+                                                         &watering_task_tcb, CONTROL_CORE);
+    return ESP_OK;
+}
+
+esp_err_t watering_start(float target_pct, uint32_t max_ms, const char *request_id)
+{
+    if (!(target_pct > 0.0f && target_pct <= 100.0f) || max_ms == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!watering_task_handle) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (!device_identity_sensors_enabled()) {
+        // No soil feedback to close the loop on
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    watering_request_t req = {
+        .target_pct = target_pct,
+        .max_ms = max_ms > WATERING_MAX_RUN_MS ? WATERING_MAX_RUN_MS : max_ms,
+        .request_id = "",
+    };
+    if (request_id) {
+        strncpy(req.request_id, request_id, sizeof(req.request_id) - 1);
+    }
+    taskENTER_CRITICAL(&request_lock);
+    pending = req;
+    pending_valid = true;
+    running = true;
+    taskEXIT_CRITICAL(&request_lock);
+    xTaskNotifyGive(watering_task_handle);
+    return ESP_OK;
+}
+
+bool watering_active(void)
+{
+    return running;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+// Closed-loop watering. The pump runs while a dedicated task samples soil
+// moisture in short ADS1115 continuous-mode bursts every
+// WATERING_SAMPLE_INTERVAL_MS, and stops as soon as the target is reached
+// (WATERING_TARGET_CONFIRM samples in a row), the time or volume cap is
+// hit, or the cutoff float trips. The pump's actuator timer is armed a
+// little past the cap as a backstop, so a stalled loop cannot overwater.
+
+#define WATERING_REQUEST_ID_LEN 64
+
+typedef enum {
+    WATERING_STOP_TARGET = 0,   // target moisture reached (or already met)
+    WATERING_STOP_LIMIT,        // time/volume cap
+    WATERING_STOP_CUTOFF,       // cutoff float
+    WATERING_STOP_INTERRUPTED,  // pump switched off elsewhere (command, schedule)
+    WATERING_STOP_SENSOR_FAULT, // no usable soil sample; the pump was not started or was stopped
+} watering_stop_t;
+
+typedef struct {
+    watering_stop_t reason;
+    uint32_t delivered_ms;  // pump on time
+    float start_pct;        // NAN when the first sample failed
+    float end_pct;
+    float target_pct;
+    char request_id[WATERING_REQUEST_ID_LEN];  // empty when the command had none
+} watering_result_t;
+
+// Runs on the watering task once the pump is off; keep it short
+typedef void (*watering_done_cb_t)(const watering_result_t *result);
+
+esp_err_t watering_init(watering_done_cb_t on_done);
+
+// Starts a run, replacing one in progress (which then reports
+// WATERING_STOP_INTERRUPTED). target_pct in (0, 100]; max_ms is clamped to
+// WATERING_MAX_RUN_MS.
+esp_err_t watering_start(float target_pct, uint32_t max_ms, const char *request_id);
+bool watering_active(void);
+
+// Short label for payloads
+const char *watering_stop_reason_name(watering_stop_t reason);
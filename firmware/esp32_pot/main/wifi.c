@@ -15,6 +15,7 @@
 #define WIFI_MAX_RETRY     5
 
 static const char *TAG = "wifi";
+static StaticEventGroup_t wifi_event_group_buf;
 static EventGroupHandle_t wifi_event_group;
 static int retry_count = 0;
 
@@ -45,9 +46,8 @@ esp_err_t wifi_init_sta(const char *ssid, const char *password)
         return ESP_ERR_INVALID_ARG;
     }
 
-    wifi_event_group = xEventGroupCreate();
     if (!wifi_event_group) {
-        return ESP_ERR_NO_MEM;
+        wifi_event_group = xEventGroupCreateStatic(&wifi_event_group_buf);
     }
 
         esp_err_t nvs_err = nvs_flash_init();
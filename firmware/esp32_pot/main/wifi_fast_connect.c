@@ -0,0 +1,145 @@
+#include "wifi_fast_connect.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "esp_crc.h"
+#include "esp_log.h"
+
+#include "hardware_config.h"
+#include "preferences.h"
+
+#define FAST_CONNECT_NAMESPACE "wifi"
+#define FAST_CONNECT_KEY "fast"
+#define FAST_CONNECT_VERSION 1
+
+static const char *TAG = "wifi_fast";
+
+typedef struct {
+    uint8_t version;
+    uint8_t channel;
+    uint8_t bssid[6];
+    uint8_t ssid[32];
+    uint32_t crc32;  // esp_crc32_le over every byte before this field
+} fast_connect_blob_t;
+
+// What is in NVS, so an unchanged AP costs no flash write
+static fast_connect_blob_t cached;
+static bool cached_loaded = false;
+static bool cached_valid = false;
+
+static uint32_t blob_crc(const fast_connect_blob_t *blob)
+{
+    return esp_crc32_le(0, (const uint8_t *)blob, offsetof(fast_connect_blob_t, crc32));
+}
+
+static void load_cache(void)
+{
+    if (cached_loaded) {
+        return;
+    }
+    cached_loaded = true;
+    size_t len = sizeof(cached);
+    esp_err_t err = prefs_get_blob(FAST_CONNECT_NAMESPACE, FAST_CONNECT_KEY, &cached, &len);
+    cached_valid = err == ESP_OK &&
+                   len == sizeof(cached) &&
+                   cached.version == FAST_CONNECT_VERSION &&
+                   cached.crc32 == blob_crc(&cached) &&
+                   cached.channel >= 1 && cached.channel <= 14;
+}
+
+bool wifi_fast_connect_apply(wifi_config_t *cfg)
+{
+    if (!cfg) {
+        return false;
+    }
+    load_cache();
+    if (!cached_valid || memcmp(cached.ssid, cfg->sta.ssid, sizeof(cached.ssid)) != 0) {
+        return false;
+    }
+    memcpy(cfg->sta.bssid, cached.bssid, sizeof(cfg->sta.bssid));
+    cfg->sta.bssid_set = true;
+    cfg->sta.channel = cached.channel;
+    cfg->sta.scan_method = WIFI_FAST_SCAN;
+    ESP_LOGI(TAG, "Trying cached AP " MACSTR " on channel %u", MAC2STR(cached.bssid), (unsigned)cached.channel);
+    return true;
+}
+
+void wifi_fast_connect_clear(wifi_config_t *cfg)
+{
+    if (!cfg) {
+        return;
+    }
+    cfg->sta.bssid_set = false;
+    memset(cfg->sta.bssid, 0, sizeof(cfg->sta.bssid));
+    cfg->sta.channel = 0;
+    cfg->sta.scan_method = WIFI_ALL_CHANNEL_SCAN;
+}
+
+void wifi_fast_connect_remember(void)
+{
+    wifi_ap_record_t ap;
+    wifi_config_t cfg;
+    if (esp_wifi_sta_get_ap_info(&ap) != ESP_OK || esp_wifi_get_config(WIFI_IF_STA, &cfg) != ESP_OK) {
+        return;
+    }
+
+    fast_connect_blob_t blob;
+    memset(&blob, 0, sizeof(blob));
+    blob.version = FAST_CONNECT_VERSION;
+    blob.channel = ap.primary;
+    memcpy(blob.bssid, ap.bssid, sizeof(blob.bssid));
+    memcpy(blob.ssid, cfg.sta.ssid, sizeof(blob.ssid));
+    blob.crc32 = blob_crc(&blob);
+
+    load_cache();
+    if (cached_valid && memcmp(&cached, &blob, sizeof(blob)) == 0) {
+        return;
+    }
+    // Deferred so the connect path does not wait on flash
+    esp_err_t err = prefs_defer_blob(FAST_CONNECT_NAMESPACE, FAST_CONNECT_KEY, &blob, sizeof(blob));
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to cache AP: %s", esp_err_to_name(err));
+        return;
+    }
+    cached = blob;
+    cached_valid = true;
+}
+
+esp_err_t wifi_fast_connect_apply_static_ip(esp_netif_t *sta_netif)
+{
+    if (!sta_netif) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (WIFI_STATIC_IP[0] == '\0') {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    esp_netif_ip_info_t ip_info = {0};
+    if (esp_netif_str_to_ip4(WIFI_STATIC_IP, &ip_info.ip) != ESP_OK ||
+        esp_netif_str_to_ip4(WIFI_STATIC_NETMASK, &ip_info.netmask) != ESP_OK ||
+        esp_netif_str_to_ip4(WIFI_STATIC_GATEWAY, &ip_info.gw) != ESP_OK) {
+        ESP_LOGW(TAG, "Invalid static IP configuration; using DHCP");
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    esp_err_t err = esp_netif_dhcpc_stop(sta_netif);
+    if (err != ESP_OK && err != ESP_ERR_ESP_NETIF_DHCP_ALREADY_STOPPED) {
+        return err;
+    }
+    err = esp_netif_set_ip_info(sta_netif, &ip_info);
+    if (err != ESP_OK) {
+        esp_netif_dhcpc_start(sta_netif);
+        return err;
+    }
+
+    const char *dns = WIFI_STATIC_DNS[0] ? WIFI_STATIC_DNS : WIFI_STATIC_GATEWAY;
+    esp_netif_dns_info_t dns_info = {0};
+    dns_info.ip.type = ESP_IPADDR_TYPE_V4;
+    if (esp_netif_str_to_ip4(dns, &dns_info.ip.u_addr.ip4) == ESP_OK) {
+        esp_netif_set_dns_info(sta_netif, ESP_NETIF_DNS_MAIN, &dns_info);
+    }
+    ESP_LOGI(TAG, "Static IP %s (gw %s)", WIFI_STATIC_IP, WIFI_STATIC_GATEWAY);
+    return ESP_OK;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <stdbool.h>
+
+#include "esp_err.h"
+#include "esp_netif.h"
+#include "esp_wifi.h"
+
+// Reconnect hints for the saved-credentials path. After each successful
+// association the AP's BSSID and channel are cached in NVS (rewritten only
+// when they change); the next boot connects to that AP directly instead of
+// scanning every channel. The DHCP side is covered by lwIP restoring the last
+// lease (CONFIG_LWIP_DHCP_RESTORE_LAST_IP), or skipped entirely when
+// WIFI_STATIC_IP is set.
+
+// Add the cached BSSID/channel to cfg if they belong to cfg's SSID
+bool wifi_fast_connect_apply(wifi_config_t *cfg);
+// Undo wifi_fast_connect_apply() for a full scan
+void wifi_fast_connect_clear(wifi_config_t *cfg);
+// Cache the AP we are associated with now
+void wifi_fast_connect_remember(void);
+
+// Configure WIFI_STATIC_IP on the station netif; ESP_ERR_NOT_FOUND when the
+// firmware uses DHCP
+esp_err_t wifi_fast_connect_apply_static_ip(esp_netif_t *sta_netif);
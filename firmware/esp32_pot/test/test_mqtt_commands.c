@@ -1,15 +1,26 @@
 #include "unity.h"
 
+#include <math.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 
+#include "actuator_state.h"
+#include "cJSON.h"
+#include "command_lanes.h"
+#include "json_writer.h"
 #include "plant_mqtt.h"
+#include "sensor_window.h"
+#include "soil_filter.h"
+#include "watering.h"
+
+static mqtt_command_scratch_t scratch;
 
 static mqtt_command_t parse_command(const char *json)
 {
-    return mqtt_parse_command(json, (int)strlen(json));
+    return mqtt_parse_command(json, (int)strlen(json), &scratch);
 }
 
 void setUp(void) {}
@@ -50,7 +61,7 @@ void test_parse_pump_override_command(void)
 void test_parse_ignores_invalid_json(void)
 {
     const char *json = "{invalid json";
-    mqtt_command_t cmd = mqtt_parse_command(json, (int)strlen(json));
+    mqtt_command_t cmd = mqtt_parse_command(json, (int)strlen(json), &scratch);
 
     TEST_ASSERT_EQUAL(MQTT_CMD_UNKNOWN, cmd.type);
     TEST_ASSERT_EQUAL_CHAR('\0', cmd.request_id[0]);
@@ -73,6 +84,480 @@ void test_parse_truncates_long_request_id(void)
     TEST_ASSERT_EQUAL_CHAR('\0', cmd.request_id[0]);
 }
 
+void test_parse_schedule_update(void)
+{
+    const char *json =
+        "{\"schedule\":{"
+        "\"light\":{\"enabled\":true,\"startTime\":\"06:00\",\"endTime\":\"18:30\"},"
+        "\"pump\":{\"enabled\":false,\"startTime\":\"00:00\",\"endTime\":\"00:00\"},"
+        "\"mister\":{\"enabled\":false,\"startTime\":\"00:00\",\"endTime\":\"00:00\"},"
+        "\"fan\":{\"enabled\":true,\"startTime\":\"08:15\",\"endTime\":\"09:00\"},"
+        "\"tzOffsetMinutes\":-300},"
+        "\"updatedAtMs\":1728912345678}";
+    mqtt_command_t cmd = parse_command(json);
+
+    TEST_ASSERT_EQUAL(MQTT_CMD_CONFIG_UPDATE, cmd.type);
+    TEST_ASSERT_TRUE(cmd.has_schedule);
+    const node_schedule_timer_t *light = &cmd.schedule.timers[NODE_SCHEDULE_TARGET_LIGHT];
+    const node_schedule_timer_t *fan = &cmd.schedule.timers[NODE_SCHEDULE_TARGET_FAN];
+    TEST_ASSERT_TRUE(light->enabled);
+    TEST_ASSERT_EQUAL_UINT8(1, light->window_count);
+    TEST_ASSERT_EQUAL_UINT16(360, light->windows[0].start_minute);
+    TEST_ASSERT_EQUAL_UINT16(1110, light->windows[0].end_minute);
+    TEST_ASSERT_TRUE(fan->enabled);
+    TEST_ASSERT_EQUAL_UINT16(495, fan->windows[0].start_minute);
+    TEST_ASSERT_EQUAL_INT16(-300, cmd.schedule.timezone_offset_minutes);
+    TEST_ASSERT_TRUE(cmd.schedule.updated_at_ms == 1728912345678ULL);
+}
+
+void test_parse_schedule_windows(void)
+{
+    const char *json =
+        "{\"schedule\":{"
+        "\"light\":{\"enabled\":true,\"startTime\":\"06:00\",\"endTime\":\"18:30\"},"
+        "\"pump\":{\"enabled\":true,\"windows\":["
+        "{\"startTime\":\"07:00\",\"endTime\":\"07:05\"},"
+        "{\"startTime\":\"19:00\",\"endTime\":\"19:05\"}]},"
+        "\"mister\":{\"enabled\":false,\"startTime\":\"00:00\",\"endTime\":\"00:00\"},"
+        "\"fan\":{\"enabled\":false,\"startTime\":\"00:00\",\"endTime\":\"00:00\"}}}";
+    mqtt_command_t cmd = parse_command(json);
+
+    TEST_ASSERT_TRUE(cmd.has_schedule);
+    const node_schedule_timer_t *pump = &cmd.schedule.timers[NODE_SCHEDULE_TARGET_PUMP];
+    TEST_ASSERT_TRUE(pump->enabled);
+    TEST_ASSERT_EQUAL_UINT8(2, pump->window_count);
+    TEST_ASSERT_EQUAL_UINT16(420, pump->windows[0].start_minute);
+    TEST_ASSERT_EQUAL_UINT16(1145, pump->windows[1].end_minute);
+
+    // More windows than NODE_SCHEDULE_MAX_WINDOWS rejects the whole schedule
+    cmd = parse_command(
+        "{\"schedule\":{"
+        "\"light\":{\"enabled\":true,\"windows\":["
+        "{\"startTime\":\"01:00\",\"endTime\":\"02:00\"},{\"startTime\":\"03:00\",\"endTime\":\"04:00\"},"
+        "{\"startTime\":\"05:00\",\"endTime\":\"06:00\"},{\"startTime\":\"07:00\",\"endTime\":\"08:00\"},"
+        "{\"startTime\":\"09:00\",\"endTime\":\"10:00\"}]},"
+        "\"pump\":{\"enabled\":false,\"startTime\":\"00:00\",\"endTime\":\"00:00\"},"
+        "\"mister\":{\"enabled\":false,\"startTime\":\"00:00\",\"endTime\":\"00:00\"},"
+        "\"fan\":{\"enabled\":false,\"startTime\":\"00:00\",\"endTime\":\"00:00\"}}}");
+    TEST_ASSERT_FALSE(cmd.has_schedule);
+}
+
+void test_parse_report_policy_update(void)
+{
+    mqtt_command_t cmd = parse_command(
+        "{\"reportPolicy\":{\"moistureDeadband\":1.5,\"maxSilenceS\":900}}");
+
+    TEST_ASSERT_EQUAL(MQTT_CMD_CONFIG_UPDATE, cmd.type);
+    TEST_ASSERT_EQUAL_UINT8(REPORT_POLICY_FIELD_MOISTURE | REPORT_POLICY_FIELD_MAX_SILENCE,
+                            cmd.report_policy_mask);
+    TEST_ASSERT_EQUAL_FLOAT(1.5f, cmd.report_policy.moisture_pct);
+    TEST_ASSERT_EQUAL_UINT32(900, cmd.report_policy.max_silence_s);
+
+    cmd = parse_command("{\"reportPolicy\":{\"maxSilenceS\":-5}}");
+    TEST_ASSERT_EQUAL(MQTT_CMD_UNKNOWN, cmd.type);
+    TEST_ASSERT_EQUAL_UINT8(0, cmd.report_policy_mask);
+}
+
+void test_parse_decodes_escaped_device_name(void)
+{
+    const char *json = "{\"deviceName\":\"Basil \\\"Two\\\" \\u00e9\"}";
+    mqtt_command_t cmd = parse_command(json);
+
+    TEST_ASSERT_EQUAL(MQTT_CMD_CONFIG_UPDATE, cmd.type);
+    TEST_ASSERT_EQUAL_STRING("Basil \"Two\" \xc3\xa9", cmd.device_name);
+}
+
+void test_parse_rejects_token_flood(void)
+{
+    char json[512];
+    size_t len = (size_t)snprintf(json, sizeof(json), "{\"pump\":\"on\",\"x\":[");
+    for (int i = 0; i < 120; ++i) {
+        json[len++] = '0';
+        json[len++] = ',';
+    }
+    len += (size_t)snprintf(&json[len], sizeof(json) - len, "0]}");
+    mqtt_command_t cmd = mqtt_parse_command(json, (int)len, &scratch);
+
+    TEST_ASSERT_EQUAL(MQTT_CMD_UNKNOWN, cmd.type);
+    TEST_ASSERT_FALSE(cmd.pump_on);
+}
+
+void test_parse_uses_payload_length_not_terminator(void)
+{
+    const char *json = "{\"pump\":\"on\"}garbage";
+    mqtt_command_t cmd = mqtt_parse_command(json, 13, &scratch);
+
+    TEST_ASSERT_EQUAL(MQTT_CMD_PUMP_OVERRIDE, cmd.type);
+    TEST_ASSERT_TRUE(cmd.pump_on);
+}
+
+void test_parse_rejects_trailing_bytes(void)
+{
+    const char *json = "{\"pump\":\"on\"}garbage";
+    mqtt_command_t cmd = mqtt_parse_command(json, (int)strlen(json), &scratch);
+    TEST_ASSERT_EQUAL(MQTT_CMD_UNKNOWN, cmd.type);
+    TEST_ASSERT_FALSE(cmd.pump_on);
+
+    json = "{\"pump\":\"on\"} {\"fan\":\"on\"}";
+    cmd = mqtt_parse_command(json, (int)strlen(json), &scratch);
+    TEST_ASSERT_EQUAL(MQTT_CMD_UNKNOWN, cmd.type);
+
+    json = "{\"pump\":\"on\"}\r\n ";
+    cmd = mqtt_parse_command(json, (int)strlen(json), &scratch);
+    TEST_ASSERT_EQUAL(MQTT_CMD_PUMP_OVERRIDE, cmd.type);
+    TEST_ASSERT_TRUE(cmd.pump_on);
+}
+
+void test_parse_payload_encoding(void)
+{
+    const char *payload = "{\"payloadEncoding\":\"binary\",\"requestId\":\"enc-1\"}";
+    mqtt_command_t cmd = mqtt_parse_command(payload, (int)strlen(payload), &scratch);
+    TEST_ASSERT_EQUAL(MQTT_CMD_CONFIG_UPDATE, cmd.type);
+    TEST_ASSERT_TRUE(cmd.has_payload_encoding);
+    TEST_ASSERT_EQUAL(PAYLOAD_ENCODING_BINARY, cmd.payload_encoding);
+
+    payload = "{\"payloadEncoding\":\"msgpack\"}";
+    cmd = mqtt_parse_command(payload, (int)strlen(payload), &scratch);
+    TEST_ASSERT_FALSE(cmd.has_payload_encoding);
+}
+
+void test_encode_reading_binary_layout(void)
+{
+    sensor_reading_t reading = {
+        .soil_raw = 18342,
+        .soil_percent = 47.2f,
+        .temperature_c = -3.5f,
+        .humidity_pct = NAN,
+        .battery_v = 3.92f,
+        .water_cutoff = true,
+        .pump_is_on = true,
+    };
+    uint8_t buf[MQTT_BIN_READING_LEN];
+    TEST_ASSERT_EQUAL(MQTT_BIN_READING_LEN,
+                      mqtt_encode_reading_binary(&reading, true, 1728912345678ULL, buf, sizeof(buf)));
+
+    const uint8_t expected[MQTT_BIN_READING_LEN] = {
+        MQTT_BIN_SCHEMA_VERSION, MQTT_BIN_KIND_READING,
+        MQTT_BIN_FLAG_SENSORS | MQTT_BATCH_FLAG_WATER_CUTOFF | MQTT_BATCH_FLAG_VALVE_OPEN, 0,
+        0x4e, 0xca, 0x34, 0x8b, 0x92, 0x01, 0x00, 0x00,  // 1728912345678
+        0xa6, 0x47,                                      // soilRaw 18342
+        0x70, 0x12,                                      // 4720
+        0xa2, 0xfe,                                      // -350
+        0x00, 0x80,                                      // humidity missing
+        0x50, 0x0f,                                      // 3920 mV
+    };
+    TEST_ASSERT_EQUAL_MEMORY(expected, buf, sizeof(expected));
+    TEST_ASSERT_EQUAL(0, mqtt_encode_reading_binary(&reading, true, 0, buf, sizeof(buf) - 1));
+}
+
+void test_sensor_window_aggregates(void)
+{
+    static const float soil[] = {40.0f, 42.0f, 44.0f, 46.0f};
+    sensor_window_t window;
+    sensor_window_reset(&window);
+    sensor_reading_t sample = {.temperature_c = 20.0f, .humidity_pct = NAN};
+    for (size_t i = 0; i < sizeof(soil) / sizeof(soil[0]); ++i) {
+        sample.soil_percent = soil[i];
+        sample.timestamp_ms = 1000 * (i + 1);
+        TEST_ASSERT_FALSE(sensor_window_add(&window, &sample));
+    }
+
+    sensor_reading_t reading;
+    sensor_window_finish(&window, &reading);
+    TEST_ASSERT_EQUAL_UINT16(4, reading.window_samples);
+    TEST_ASSERT_TRUE(reading.timestamp_ms == 4000);
+    TEST_ASSERT_FLOAT_WITHIN(1e-4f, 43.0f, reading.soil_percent);
+    TEST_ASSERT_EQUAL_FLOAT(40.0f, reading.soil_spread.min);
+    TEST_ASSERT_EQUAL_FLOAT(46.0f, reading.soil_spread.max);
+    TEST_ASSERT_FLOAT_WITHIN(1e-4f, sqrtf(5.0f), reading.soil_spread.stddev);
+    TEST_ASSERT_FLOAT_WITHIN(1e-4f, 0.0f, reading.temperature_spread.stddev);
+    TEST_ASSERT_TRUE(isnan(reading.humidity_pct));
+
+    sample.pump_is_on = true;
+    TEST_ASSERT_TRUE(sensor_window_add(&window, &sample));
+
+    uint8_t buf[MQTT_BIN_READING_WINDOW_LEN];
+    TEST_ASSERT_EQUAL(MQTT_BIN_READING_WINDOW_LEN,
+                      mqtt_encode_reading_binary(&reading, true, 0, buf, sizeof(buf)));
+    TEST_ASSERT_EQUAL_UINT8(MQTT_BIN_KIND_READING_WINDOW, buf[1]);
+    TEST_ASSERT_EQUAL_UINT8(4, buf[22]);
+    TEST_ASSERT_EQUAL_UINT8(0xa0, buf[24]);  // soil min 4000 = 0x0fa0
+}
+
+void test_soil_filter_rejects_glitch(void)
+{
+    const int16_t samples[] = {12000, 12010, 11995, 32767, 12005};
+    uint16_t raw = 0;
+    TEST_ASSERT_EQUAL(4, soil_filter_counts(samples, 5, &raw));
+    TEST_ASSERT_EQUAL_UINT16(12003, raw);
+
+    const int16_t flat[] = {-3, 0, 0};
+    TEST_ASSERT_EQUAL(3, soil_filter_counts(flat, 3, &raw));
+    TEST_ASSERT_EQUAL_UINT16(0, raw);
+    TEST_ASSERT_EQUAL(0, soil_filter_counts(samples, 0, &raw));
+
+    mqtt_command_t cmd = parse_command("{\"soilCalibration\":{\"rawDry\":16000,\"rawWet\":8000}}");
+    TEST_ASSERT_EQUAL(MQTT_CMD_CONFIG_UPDATE, cmd.type);
+    TEST_ASSERT_TRUE(cmd.has_soil_calibration);
+    TEST_ASSERT_EQUAL_UINT16(16000, cmd.soil_calibration.raw_dry);
+    TEST_ASSERT_EQUAL_UINT16(8000, cmd.soil_calibration.raw_wet);
+    cmd = parse_command("{\"soilCalibration\":{\"rawDry\":16000}}");
+    TEST_ASSERT_FALSE(cmd.has_soil_calibration);
+}
+
+void test_parse_measurement_interval(void)
+{
+    mqtt_command_t cmd = parse_command(
+        "{\"measurementInterval\":{\"activeS\":5,\"minS\":60,\"maxS\":600},\"requestId\":\"iv-1\"}");
+    TEST_ASSERT_EQUAL(MQTT_CMD_CONFIG_UPDATE, cmd.type);
+    TEST_ASSERT_TRUE(cmd.has_interval_bounds);
+    TEST_ASSERT_EQUAL_UINT32(5, cmd.interval_bounds.active_s);
+    TEST_ASSERT_EQUAL_UINT32(60, cmd.interval_bounds.min_s);
+    TEST_ASSERT_EQUAL_UINT32(600, cmd.interval_bounds.max_s);
+
+    cmd = parse_command("{\"measurementInterval\":{\"minS\":60,\"maxS\":600}}");
+    TEST_ASSERT_FALSE(cmd.has_interval_bounds);
+    TEST_ASSERT_EQUAL(MQTT_CMD_UNKNOWN, cmd.type);
+
+    const measurement_interval_bounds_t inverted = {.active_s = 5, .min_s = 600, .max_s = 60};
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, measurement_interval_set_bounds(&inverted));
+}
+
+void test_parse_closed_loop_watering(void)
+{
+    mqtt_command_t cmd = parse_command(
+        "{\"pump\":\"on\",\"targetMoisture\":45,\"maxVolumeMl\":200,\"requestId\":\"w-1\"}");
+    TEST_ASSERT_EQUAL(MQTT_CMD_PUMP_OVERRIDE, cmd.type);
+    TEST_ASSERT_TRUE(cmd.pump_on);
+    TEST_ASSERT_EQUAL_FLOAT(45.0f, cmd.water_target_pct);
+    TEST_ASSERT_EQUAL_UINT32(200, cmd.water_max_ml);
+
+    // A target only means something while the pump runs
+    cmd = parse_command("{\"pump\":\"off\",\"targetMoisture\":45}");
+    TEST_ASSERT_EQUAL(MQTT_CMD_PUMP_OVERRIDE, cmd.type);
+    TEST_ASSERT_FALSE(cmd.pump_on);
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, cmd.water_target_pct);
+
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, watering_start(120.0f, 1000, NULL));
+}
+
+void test_parse_history_query(void)
+{
+    mqtt_command_t cmd = parse_command(
+        "{\"action\":\"history_query\",\"fromMs\":1728900000000,\"requestId\":\"gap-1\"}");
+
+    TEST_ASSERT_EQUAL(MQTT_CMD_HISTORY_QUERY, cmd.type);
+    TEST_ASSERT_TRUE(cmd.history_from_ms == 1728900000000ULL);
+    TEST_ASSERT_TRUE(cmd.history_to_ms == UINT64_MAX);
+    TEST_ASSERT_EQUAL_STRING("gap-1", cmd.request_id);
+}
+
+void test_actuator_state_snapshot_and_notify(void)
+{
+    TEST_ASSERT_EQUAL(ESP_OK, actuator_state_subscribe(xTaskGetCurrentTaskHandle()));
+    ulTaskNotifyTake(pdTRUE, 0);
+
+    actuator_state_t before = actuator_state_snapshot();
+    bool fan_on = actuator_state_is_on(before, NODE_SCHEDULE_TARGET_FAN);
+    TEST_ASSERT_TRUE(actuator_state_store(NODE_SCHEDULE_TARGET_FAN, !fan_on));
+    actuator_state_notify();
+    // Storing the same state again is not a change
+    TEST_ASSERT_FALSE(actuator_state_store(NODE_SCHEDULE_TARGET_FAN, !fan_on));
+
+    actuator_state_t after = actuator_state_snapshot();
+    TEST_ASSERT_EQUAL(!fan_on, actuator_state_is_on(after, NODE_SCHEDULE_TARGET_FAN));
+    TEST_ASSERT_EQUAL(actuator_state_is_on(before, NODE_SCHEDULE_TARGET_PUMP),
+                      actuator_state_is_on(after, NODE_SCHEDULE_TARGET_PUMP));
+    TEST_ASSERT_EQUAL_UINT32(actuator_state_seq(before) + 1, actuator_state_seq(after));
+    TEST_ASSERT_EQUAL_UINT32(1, ulTaskNotifyTake(pdTRUE, 0));
+
+    actuator_state_store(NODE_SCHEDULE_TARGET_FAN, fan_on);
+}
+
+static void drain_lanes(void)
+{
+    mqtt_command_t cmd;
+    while (command_lanes_pop(&cmd)) {
+    }
+}
+
+static void push_command(const char *json)
+{
+    mqtt_command_t cmd = parse_command(json);
+    TEST_ASSERT_EQUAL(ESP_OK, command_lanes_push(&cmd));
+}
+
+void test_lanes_off_overtakes_and_cancels_pending_on(void)
+{
+    SemaphoreHandle_t ready;
+    TEST_ASSERT_EQUAL(ESP_OK, command_lanes_init(&ready));
+    drain_lanes();
+
+    push_command("{\"fan\":\"on\"}");
+    push_command("{\"pump\":\"on\",\"duration_ms\":5000}");
+    push_command("{\"action\":\"sensor_read\",\"requestId\":\"r-1\"}");
+    push_command("{\"pump\":\"off\"}");
+
+    mqtt_command_t cmd;
+    TEST_ASSERT_TRUE(command_lanes_pop(&cmd));
+    TEST_ASSERT_EQUAL(MQTT_CMD_PUMP_OVERRIDE, cmd.type);
+    TEST_ASSERT_FALSE(cmd.pump_on);
+    TEST_ASSERT_TRUE(command_lanes_pop(&cmd));
+    TEST_ASSERT_EQUAL(MQTT_CMD_FAN_OVERRIDE, cmd.type);
+    TEST_ASSERT_TRUE(command_lanes_pop(&cmd));
+    TEST_ASSERT_EQUAL(MQTT_CMD_SENSOR_READ, cmd.type);
+    TEST_ASSERT_FALSE(command_lanes_pop(&cmd));
+}
+
+void test_lanes_merge_config_updates(void)
+{
+    SemaphoreHandle_t ready;
+    TEST_ASSERT_EQUAL(ESP_OK, command_lanes_init(&ready));
+    drain_lanes();
+    command_lane_stats_t before[COMMAND_LANE_COUNT];
+    command_lanes_get_stats(before);
+
+    push_command("{\"deviceName\":\"Basil\",\"requestId\":\"cfg-1\"}");
+    push_command("{\"payloadEncoding\":\"binary\",\"requestId\":\"cfg-2\"}");
+    push_command("{\"deviceName\":\"Thyme\",\"requestId\":\"cfg-3\"}");
+
+    command_lane_stats_t after[COMMAND_LANE_COUNT];
+    command_lanes_get_stats(after);
+    TEST_ASSERT_EQUAL_UINT32(1, after[COMMAND_LANE_NORMAL].depth);
+    TEST_ASSERT_EQUAL_UINT32(2, after[COMMAND_LANE_NORMAL].coalesced - before[COMMAND_LANE_NORMAL].coalesced);
+
+    mqtt_command_t cmd;
+    TEST_ASSERT_TRUE(command_lanes_pop(&cmd));
+    TEST_ASSERT_EQUAL(MQTT_CMD_CONFIG_UPDATE, cmd.type);
+    TEST_ASSERT_EQUAL_STRING("Thyme", cmd.device_name);
+    TEST_ASSERT_TRUE(cmd.has_payload_encoding);
+    TEST_ASSERT_EQUAL(PAYLOAD_ENCODING_BINARY, cmd.payload_encoding);
+    TEST_ASSERT_EQUAL_STRING("cfg-3", cmd.request_id);
+    TEST_ASSERT_FALSE(command_lanes_pop(&cmd));
+}
+
+static char superseded[4][MQTT_REQUEST_ID_MAX_LEN];
+static size_t superseded_count;
+
+static void record_superseded(const char *request_id)
+{
+    if (superseded_count < 4) {
+        strcpy(superseded[superseded_count++], request_id);
+    }
+}
+
+void test_lanes_report_superseded_ids(void)
+{
+    SemaphoreHandle_t ready;
+    TEST_ASSERT_EQUAL(ESP_OK, command_lanes_init(&ready));
+    drain_lanes();
+    superseded_count = 0;
+    command_lanes_set_superseded_callback(record_superseded);
+
+    // Different windows both stream; the same window again replaces the first
+    push_command("{\"action\":\"history_query\",\"fromMs\":1000,\"toMs\":2000,\"requestId\":\"gap-1\"}");
+    push_command("{\"action\":\"history_query\",\"fromMs\":5000,\"toMs\":6000,\"requestId\":\"gap-2\"}");
+    TEST_ASSERT_EQUAL_UINT32(0, superseded_count);
+    push_command("{\"action\":\"history_query\",\"fromMs\":1000,\"toMs\":2000,\"requestId\":\"gap-3\"}");
+    TEST_ASSERT_EQUAL_UINT32(1, superseded_count);
+    TEST_ASSERT_EQUAL_STRING("gap-1", superseded[0]);
+
+    // An off cancels the pending on, whose id gets no reply of its own
+    push_command("{\"fan\":\"on\",\"requestId\":\"fan-1\"}");
+    push_command("{\"fan\":\"off\",\"requestId\":\"fan-2\"}");
+    TEST_ASSERT_EQUAL_UINT32(2, superseded_count);
+    TEST_ASSERT_EQUAL_STRING("fan-1", superseded[1]);
+
+    mqtt_command_t cmd;
+    TEST_ASSERT_TRUE(command_lanes_pop(&cmd));
+    TEST_ASSERT_EQUAL_STRING("fan-2", cmd.request_id);
+    TEST_ASSERT_TRUE(command_lanes_pop(&cmd));
+    TEST_ASSERT_EQUAL_STRING("gap-3", cmd.request_id);
+    TEST_ASSERT_TRUE(command_lanes_pop(&cmd));
+    TEST_ASSERT_EQUAL_STRING("gap-2", cmd.request_id);
+    TEST_ASSERT_FALSE(command_lanes_pop(&cmd));
+    command_lanes_set_superseded_callback(NULL);
+}
+
+void test_json_writer_matches_cjson(void)
+{
+    cJSON *root = cJSON_CreateObject();
+    cJSON_AddStringToObject(root, "potId", "pot-\"01\"\n\x01");
+    cJSON_AddNumberToObject(root, "timestampMs", 1728912345678.0);
+    cJSON_AddNumberToObject(root, "moisture", 47.2f);
+    cJSON_AddNumberToObject(root, "soilRaw", 18342);
+    cJSON_AddNumberToObject(root, "temperature", -3.5);
+    cJSON_AddBoolToObject(root, "valveOpen", false);
+    cJSON *timer = cJSON_AddObjectToObject(root, "light");
+    cJSON_AddBoolToObject(timer, "enabled", true);
+    cJSON_AddStringToObject(timer, "startTime", "06:00");
+    cJSON_AddBoolToObject(root, "lightOn", true);
+    char *expected = cJSON_PrintUnformatted(root);
+    cJSON_Delete(root);
+
+    char buf[256];
+    json_writer_t w;
+    json_writer_init(&w, buf, sizeof(buf));
+    json_writer_begin_object(&w);
+    json_writer_string(&w, "potId", "pot-\"01\"\n\x01");
+    json_writer_number(&w, "timestampMs", 1728912345678.0);
+    json_writer_number(&w, "moisture", 47.2f);
+    json_writer_number(&w, "soilRaw", 18342);
+    json_writer_number(&w, "temperature", -3.5);
+    json_writer_bool(&w, "valveOpen", false);
+    json_writer_begin_object_key(&w, "light");
+    json_writer_bool(&w, "enabled", true);
+    json_writer_string(&w, "startTime", "06:00");
+    json_writer_end_object(&w);
+    json_writer_bool(&w, "lightOn", true);
+    json_writer_end_object(&w);
+
+    TEST_ASSERT_NOT_NULL(json_writer_finish(&w));
+    TEST_ASSERT_EQUAL_STRING(expected, buf);
+    cJSON_free(expected);
+}
+
+void test_json_writer_arrays(void)
+{
+    char buf[128];
+    json_writer_t w;
+    json_writer_init(&w, buf, sizeof(buf));
+    json_writer_begin_object(&w);
+    json_writer_number(&w, "t0", 1728912345000.0);
+    json_writer_begin_array(&w, "f");
+    json_writer_string(&w, NULL, "dt");
+    json_writer_string(&w, NULL, "m");
+    json_writer_end_array(&w);
+    json_writer_begin_array(&w, "s");
+    json_writer_begin_array(&w, NULL);
+    json_writer_number(&w, NULL, 0);
+    json_writer_number(&w, NULL, 4720);
+    json_writer_end_array(&w);
+    json_writer_begin_array(&w, NULL);
+    json_writer_number(&w, NULL, -60);
+    json_writer_null(&w, NULL);
+    json_writer_end_array(&w);
+    json_writer_end_array(&w);
+    json_writer_bool(&w, "done", true);
+    json_writer_end_object(&w);
+
+    TEST_ASSERT_NOT_NULL(json_writer_finish(&w));
+    TEST_ASSERT_EQUAL_STRING(
+        "{\"t0\":1728912345000,\"f\":[\"dt\",\"m\"],\"s\":[[0,4720],[-60,null]],\"done\":true}", buf);
+}
+
+void test_json_writer_reports_overflow(void)
+{
+    char buf[16];
+    json_writer_t w;
+    json_writer_init(&w, buf, sizeof(buf));
+    json_writer_begin_object(&w);
+    json_writer_string(&w, "potId", "pot-with-a-long-id");
+    json_writer_end_object(&w);
+
+    TEST_ASSERT_NULL(json_writer_finish(&w));
+}
+
 void app_main(void)
 {
     UNITY_BEGIN();
@@ -81,5 +566,26 @@ void app_main(void)
     RUN_TEST(test_parse_pump_override_command);
     RUN_TEST(test_parse_ignores_invalid_json);
     RUN_TEST(test_parse_truncates_long_request_id);
+    RUN_TEST(test_parse_schedule_update);
+    RUN_TEST(test_parse_schedule_windows);
+    RUN_TEST(test_parse_report_policy_update);
+    RUN_TEST(test_parse_decodes_escaped_device_name);
+    RUN_TEST(test_parse_rejects_token_flood);
+    RUN_TEST(test_parse_uses_payload_length_not_terminator);
+    RUN_TEST(test_parse_rejects_trailing_bytes);
+    RUN_TEST(test_parse_payload_encoding);
+    RUN_TEST(test_sensor_window_aggregates);
+    RUN_TEST(test_soil_filter_rejects_glitch);
+    RUN_TEST(test_parse_measurement_interval);
+    RUN_TEST(test_parse_closed_loop_watering);
+    RUN_TEST(test_parse_history_query);
+    RUN_TEST(test_actuator_state_snapshot_and_notify);
+    RUN_TEST(test_lanes_off_overtakes_and_cancels_pending_on);
+    RUN_TEST(test_lanes_merge_config_updates);
+    RUN_TEST(test_lanes_report_superseded_ids);
+    RUN_TEST(test_json_writer_matches_cjson);
+    RUN_TEST(test_json_writer_arrays);
+    RUN_TEST(test_encode_reading_binary_layout);
+    RUN_TEST(test_json_writer_reports_overflow);
     UNITY_END();
 }